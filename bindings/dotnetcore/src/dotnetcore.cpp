@@ -3,6 +3,10 @@
 
 #include <cstring>
 #include <cstdbool>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <fstream>
 
 #include "module.h"
 #include "message.h"
@@ -11,12 +15,7 @@
 #include "dynamic_library.h"
 #include "dotnetcore.h"
 
-#include <memory>
-#include <stdio.h>
-
 #include <parson.h>
-#include <string>
-#include <fstream>
 #include "dotnetcore_common.h"
 #include "dotnetcore_utils.h"
 
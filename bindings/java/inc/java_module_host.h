@@ -21,6 +21,11 @@
 #define JAVA_MODULE_JVM_OPTIONS_DEBUG_PORT_KEY "debug.port"
 #define JAVA_MODULE_JVM_OPTIONS_VERBOSE_KEY "verbose"
 #define JAVA_MODULE_JVM_OPTIONS_ADDITIONAL_OPTIONS_KEY "additional.options"
+#define JAVA_MODULE_JVM_OPTIONS_CDS_ARCHIVE_KEY "cds.archive"
+#define JAVA_MODULE_JVM_OPTIONS_TIERED_STOP_AT_LEVEL_KEY "tiered.stop.at.level"
+#define JAVA_MODULE_JVM_OPTIONS_INITIAL_HEAP_KEY "heap.initial.mb"
+#define JAVA_MODULE_JVM_OPTIONS_MAX_HEAP_KEY "heap.max.mb"
+#define JAVA_MODULE_JVM_OPTIONS_PARALLEL_STARTUP_KEY "parallel.startup"
 
 #ifdef __cplusplus
 extern "C"
@@ -36,6 +41,11 @@ typedef struct JVM_OPTIONS_TAG
     int debug_port;
     bool verbose;
     VECTOR_HANDLE additional_options;
+    const char* cds_archive;
+    int tiered_stop_at_level;
+    int initial_heap_mb;
+    int max_heap_mb;
+    bool parallel_startup;
 } JVM_OPTIONS;
 
 typedef struct JAVA_MODULE_HOST_CONFIG_TAG
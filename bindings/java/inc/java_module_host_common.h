@@ -20,5 +20,7 @@
 #define DEBUG_PORT_DEFAULT 9876
 #define DEBUG_PORT_MAX_VALUE 65535
 #define DEBUG_OPTIONS_STR_SIZE 64
+#define TIERED_STOP_AT_LEVEL_MAX_VALUE 4
+#define SIZE_OPTIONS_STR_SIZE 16
 
 #endif /*JAVA_MODULE_HOST_COMMON_H*/
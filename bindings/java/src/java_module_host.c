@@ -56,6 +56,9 @@ typedef signed char jbyte;
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "java_module_host_manager.h"
 #include "module_access.h"
 
@@ -79,6 +82,12 @@ typedef struct JAVA_MODULE_HANDLE_DATA_TAG
     jobject module;
     char* moduleName;
     JAVA_MODULE_HOST_MANAGER_HANDLE manager;
+    BROKER_HANDLE broker;
+    char* class_name_copy;
+    char* configuration_json;
+    LOCK_HANDLE startup_lock;
+    THREAD_HANDLE startup_thread;
+    TICK_COUNTER_HANDLE startup_timer;
 }JAVA_MODULE_HANDLE_DATA;
 
 static int JVM_Create(JavaVM** jvm, JNIEnv** env, JVM_OPTIONS* options);
@@ -89,6 +98,11 @@ static void deinit_vm_options(JavaVMInitArgs* jvm_args, VECTOR_HANDLE options_st
 static jobject NewObjectInternal(JNIEnv* env, jclass clazz, jmethodID methodID, int args_count, ...);
 static void CallVoidMethodInternal(JNIEnv* env, jobject obj, jmethodID methodID, int args_count, ...);
 static jmethodID get_module_method(JAVA_MODULE_HANDLE_DATA* module, const char* method_name, const char* method_descriptor);
+static int construct_module(JAVA_MODULE_HANDLE_DATA* module, JNIEnv* env, BROKER_HANDLE broker, const char* configuration_json);
+static int start_construction(JAVA_MODULE_HANDLE_DATA* module, const JAVA_MODULE_HOST_CONFIG* config);
+static bool module_is_constructed(JAVA_MODULE_HANDLE_DATA* module);
+static void report_startup_time(JAVA_MODULE_HANDLE_DATA* module);
+static int add_vm_option(JavaVMInitArgs* jvm_args, VECTOR_HANDLE options_strings, int* options_count, const char* option_key, const char* option_value);
 
 static MODULE_HANDLE JavaModuleHost_Create(BROKER_HANDLE broker, const void* configuration)
 {
@@ -124,7 +138,20 @@ static MODULE_HANDLE JavaModuleHost_Create(BROKER_HANDLE broker, const void* con
                 //TODO: Requirements for this
                 result->env = NULL;
                 result->jvm = NULL;
+                result->module = NULL;
                 result->moduleName = (char*)config->class_name;
+                result->class_name_copy = NULL;
+                result->configuration_json = NULL;
+                result->broker = broker;
+                result->startup_lock = NULL;
+                result->startup_thread = NULL;
+
+                /*Codes_SRS_JAVA_MODULE_HOST_26_007: [ This function shall start timing the module's startup, and shall continue if the timer cannot be created. ]*/
+                result->startup_timer = tickcounter_create();
+                if (result->startup_timer == NULL)
+                {
+                    LogInfo("Startup time of %s will not be reported.", result->moduleName);
+                }
 
                 /*Codes_SRS_JAVA_MODULE_HOST_14_037: [This function shall get a singleton instance of a JavaModuleHostManager. ]*/
                 result->manager = JavaModuleHostManager_Create(config);
@@ -155,165 +182,187 @@ static MODULE_HANDLE JavaModuleHost_Create(BROKER_HANDLE broker, const void* con
                         }
                         else
                         {
-                            /*Codes_SRS_JAVA_MODULE_HOST_14_014: [This function shall find the Broker Java class, get the constructor, and create a Broker Java object.]*/
-                            jclass jBroker_class = JNIFunc(result->env, FindClass, BROKER_CLASS_NAME);
-                            jthrowable exception = JNIFunc(result->env, ExceptionOccurred);
-                            if (jBroker_class == NULL || exception)
+                            if (config->options != NULL && config->options->parallel_startup)
+                            {
+                                /*Codes_SRS_JAVA_MODULE_HOST_26_003: [ If configuration->options->parallel_startup is true, this function shall copy the class name and configuration and construct the Java module on a startup thread, so the gateway can create the next module while this one loads. ]*/
+                                if (start_construction(result, config) != 0)
+                                {
+                                    /*Codes_SRS_JAVA_MODULE_HOST_14_004: [This function shall return NULL upon any underlying API call failure.]*/
+                                    LogError("Failed to start the construction of %s.", result->moduleName);
+                                    destroy_module_internal(result, true);
+                                    result = NULL;
+                                }
+                            }
+                            else if (construct_module(result, result->env, broker, config->configuration_json) != 0)
                             {
-                                /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
-                                /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
-                                LogError("Could not find class (%s).", BROKER_CLASS_NAME);
-                                JNIFunc(result->env, ExceptionDescribe);
-                                JNIFunc(result->env, ExceptionClear);
                                 destroy_module_internal(result, true);
                                 result = NULL;
                             }
                             else
                             {
-                                jmethodID jBroker_constructor = JNIFunc(result->env, GetMethodID, jBroker_class, CONSTRUCTOR_METHOD_NAME, BROKER_CONSTRUCTOR_DESCRIPTOR);
-                                exception = JNIFunc(result->env, ExceptionOccurred);
-                                if (jBroker_constructor == NULL || exception)
+                                report_startup_time(result);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static int construct_module(JAVA_MODULE_HANDLE_DATA* module, JNIEnv* env, BROKER_HANDLE broker, const char* configuration_json)
+{
+    int result;
+    /*Codes_SRS_JAVA_MODULE_HOST_14_014: [This function shall find the Broker Java class, get the constructor, and create a Broker Java object.]*/
+    jclass jBroker_class = JNIFunc(env, FindClass, BROKER_CLASS_NAME);
+    jthrowable exception = JNIFunc(env, ExceptionOccurred);
+    if (jBroker_class == NULL || exception)
+    {
+        /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
+        /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
+        LogError("Could not find class (%s).", BROKER_CLASS_NAME);
+        JNIFunc(env, ExceptionDescribe);
+        JNIFunc(env, ExceptionClear);
+        result = __LINE__;
+    }
+    else
+    {
+        jmethodID jBroker_constructor = JNIFunc(env, GetMethodID, jBroker_class, CONSTRUCTOR_METHOD_NAME, BROKER_CONSTRUCTOR_DESCRIPTOR);
+        exception = JNIFunc(env, ExceptionOccurred);
+        if (jBroker_constructor == NULL || exception)
+        {
+            /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
+            /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
+            LogError("Failed to find the %s constructor.", BROKER_CLASS_NAME);
+            JNIFunc(env, ExceptionDescribe);
+            JNIFunc(env, ExceptionClear);
+            result = __LINE__;
+        }
+        else
+        {
+            jobject jBroker_object = NewObjectInternal(env, jBroker_class, jBroker_constructor, 1, (jlong)broker);
+            exception = JNIFunc(env, ExceptionOccurred);
+            if (jBroker_object == NULL || exception)
+            {
+                /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
+                /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
+                LogError("Failed to create the %s object.", BROKER_CLASS_NAME);
+                JNIFunc(env, ExceptionDescribe);
+                JNIFunc(env, ExceptionClear);
+                result = __LINE__;
+            }
+            else
+            {
+                /*Codes_SRS_JAVA_MODULE_HOST_14_015: [This function shall find the user-defined Java module class using configuration->class_name, get the constructor, and create an instance of this module object.]*/
+                jclass jModule_class = JNIFunc(env, FindClass, module->moduleName);
+                exception = JNIFunc(env, ExceptionOccurred);
+                if (jModule_class == NULL || exception)
+                {
+                    /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
+                    /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
+                    LogError("Could not find class (%s).", module->moduleName);
+                    JNIFunc(env, ExceptionDescribe);
+                    JNIFunc(env, ExceptionClear);
+                    result = __LINE__;
+                }
+                else
+                {
+                    jmethodID jModule_constructor = JNIFunc(env, GetMethodID, jModule_class, CONSTRUCTOR_METHOD_NAME, MODULE_CONSTRUCTOR_DESCRIPTOR);
+                    exception = JNIFunc(env, ExceptionOccurred);
+                    bool noargsConstructor = false;
+                    /*Codes_SRS_JAVA_MODULE_HOST_24_059: [If the constructor with three parameters was not found in the Java module class, this function shall find no-argument constructor, create an instance of the module and call `create` method from the module.]*/
+                    if (jModule_constructor == NULL || exception)
+                    {
+                        noargsConstructor = true;
+                        JNIFunc(env, ExceptionClear);
+                        jModule_constructor = JNIFunc(env, GetMethodID, jModule_class, CONSTRUCTOR_METHOD_NAME, MODULE_EMPTY_CONSTRUCTOR_DESCRIPTOR);
+                        exception = JNIFunc(env, ExceptionOccurred);
+                    }
+
+                    if (noargsConstructor && (jModule_constructor == NULL || exception))
+                    {
+                        /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
+                        /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
+                        LogError("Failed to find the %s constructor.", module->moduleName);
+                        JNIFunc(env, ExceptionDescribe);
+                        JNIFunc(env, ExceptionClear);
+                        result = __LINE__;
+                    }
+                    else
+                    {
+                        jstring jModule_configuration = JNIFunc(env, NewStringUTF, configuration_json);
+                        exception = JNIFunc(env, ExceptionOccurred);
+                        if (jModule_configuration == NULL || exception)
+                        {
+                            /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
+                            /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
+                            LogError("Failed to create a new Java String.");
+                            JNIFunc(env, ExceptionDescribe);
+                            JNIFunc(env, ExceptionClear);
+                            result = __LINE__;
+                        }
+                        else
+                        {
+                            jobject jModule_object;
+                            if (noargsConstructor)
+                            {
+                                jModule_object = NewObjectInternal(env, jModule_class, jModule_constructor, 0);
+                                exception = JNIFunc(env, ExceptionOccurred);
+
+                                if (jModule_object == NULL || exception)
                                 {
-                                    /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
-                                    /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
-                                    LogError("Failed to find the %s constructor.", BROKER_CLASS_NAME);
-                                    JNIFunc(result->env, ExceptionDescribe);
-                                    JNIFunc(result->env, ExceptionClear);
-                                    destroy_module_internal(result, true);
-                                    result = NULL;
+                                    jModule_object = NULL;
                                 }
                                 else
                                 {
-                                    jobject jBroker_object = NewObjectInternal(result->env, jBroker_class, jBroker_constructor, 1, (jlong)broker);
-                                    exception = JNIFunc(result->env, ExceptionOccurred);
-                                    if (jBroker_object == NULL || exception)
+                                    jmethodID jModule_create = JNIFunc(env, GetMethodID, jModule_class, MODULE_CREATE_METHOD_NAME, MODULE_CREATE_DESCRIPTOR);
+                                    exception = JNIFunc(env, ExceptionOccurred);
+                                    if (jModule_create == NULL || exception)
                                     {
-                                        /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
-                                        /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
-                                        LogError("Failed to create the %s object.", BROKER_CLASS_NAME);
-                                        JNIFunc(result->env, ExceptionDescribe);
-                                        JNIFunc(result->env, ExceptionClear);
-                                        destroy_module_internal(result, true);
-                                        result = NULL;
+                                        jModule_object = NULL;
                                     }
                                     else
                                     {
-                                        /*Codes_SRS_JAVA_MODULE_HOST_14_015: [This function shall find the user-defined Java module class using configuration->class_name, get the constructor, and create an instance of this module object.]*/
-                                        jclass jModule_class = JNIFunc(result->env, FindClass, result->moduleName);
-                                        exception = JNIFunc(result->env, ExceptionOccurred);
-                                        if (jModule_class == NULL || exception)
-                                        {
-                                            /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
-                                            /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
-                                            LogError("Could not find class (%s).", result->moduleName);
-                                            JNIFunc(result->env, ExceptionDescribe);
-                                            JNIFunc(result->env, ExceptionClear);
-                                            destroy_module_internal(result, true);
-                                            result = NULL;
-                                        }
-                                        else
+                                        CallVoidMethodInternal(env, jModule_object, jModule_create, 3, (jlong)module, jBroker_object, jModule_configuration);
+                                        exception = JNIFunc(env, ExceptionOccurred);
+                                        if (exception)
                                         {
-                                            jmethodID jModule_constructor = JNIFunc(result->env, GetMethodID, jModule_class, CONSTRUCTOR_METHOD_NAME, MODULE_CONSTRUCTOR_DESCRIPTOR);
-                                            exception = JNIFunc(result->env, ExceptionOccurred);
-                                            bool noargsConstructor = false;
-                                            /*Codes_SRS_JAVA_MODULE_HOST_24_059: [If the constructor with three parameters was not found in the Java module class, this function shall find no-argument constructor, create an instance of the module and call `create` method from the module.]*/
-                                            if (jModule_constructor == NULL || exception)
-                                            {
-                                                noargsConstructor = true;
-                                                JNIFunc(result->env, ExceptionClear);
-                                                jModule_constructor = JNIFunc(result->env, GetMethodID, jModule_class, CONSTRUCTOR_METHOD_NAME, MODULE_EMPTY_CONSTRUCTOR_DESCRIPTOR);
-                                                exception = JNIFunc(result->env, ExceptionOccurred);
-                                            }
-
-                                            if (noargsConstructor && (jModule_constructor == NULL || exception))
-                                            {
-                                                /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
-                                                /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
-                                                LogError("Failed to find the %s constructor.", result->moduleName);
-                                                JNIFunc(result->env, ExceptionDescribe);
-                                                JNIFunc(result->env, ExceptionClear);
-                                                destroy_module_internal(result, true);
-                                                result = NULL;
-                                            }
-                                            else
-                                            {
-                                                jstring jModule_configuration = JNIFunc(result->env, NewStringUTF, config->configuration_json);
-                                                exception = JNIFunc(result->env, ExceptionOccurred);
-                                                if (jModule_configuration == NULL || exception)
-                                                {
-                                                    /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
-                                                    /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
-                                                    LogError("Failed to create a new Java String.");
-                                                    JNIFunc(result->env, ExceptionDescribe);
-                                                    JNIFunc(result->env, ExceptionClear);
-                                                    destroy_module_internal(result, true);
-                                                    result = NULL;
-                                                }
-                                                else
-                                                {
-                                                    jobject jModule_object;
-                                                    if (noargsConstructor)
-                                                    {
-                                                        jModule_object = NewObjectInternal(result->env, jModule_class, jModule_constructor, 0);
-                                                        exception = JNIFunc(result->env, ExceptionOccurred);
-
-                                                        if (jModule_object == NULL || exception)
-                                                        {
-                                                            jModule_object = NULL;
-                                                        }
-                                                        else
-                                                        {
-                                                            jmethodID jModule_create = JNIFunc(result->env, GetMethodID, jModule_class, MODULE_CREATE_METHOD_NAME, MODULE_CREATE_DESCRIPTOR);
-                                                            exception = JNIFunc(result->env, ExceptionOccurred);
-                                                            if (jModule_create == NULL || exception)
-                                                            {
-                                                                jModule_object = NULL;
-                                                            }
-                                                            else
-                                                            {
-                                                                CallVoidMethodInternal(result->env, jModule_object, jModule_create, 3, (jlong)result, jBroker_object, jModule_configuration);
-                                                                exception = JNIFunc(result->env, ExceptionOccurred);
-                                                                if (exception)
-                                                                {
-                                                                    jModule_object = NULL;
-                                                                }
-                                                            }
-                                                        }
-                                                    }
-                                                    else
-                                                    {
-                                                        jModule_object = NewObjectInternal(result->env, jModule_class, jModule_constructor, 3, (jlong)result, jBroker_object, jModule_configuration);
-                                                        exception = JNIFunc(result->env, ExceptionOccurred);
-                                                    }
-
-                                                    if (jModule_object == NULL || exception)
-                                                    {
-                                                        /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
-                                                        /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
-                                                        LogError("Failed to create the %s object.", result->moduleName);
-                                                        JNIFunc(result->env, ExceptionDescribe);
-                                                        JNIFunc(result->env, ExceptionClear);
-                                                        destroy_module_internal(result, true);
-                                                        result = NULL;
-                                                    }
-                                                    else
-                                                    {
-                                                        /*Codes_SRS_JAVA_MODULE_HOST_14_005: [This function shall return a non-NULL MODULE_HANDLE when successful.]*/
-                                                        /*Codes_SRS_JAVA_MODULE_HOST_14_018: [The function shall save a new global reference to the Java module object in JAVA_MODULE_HANDLE_DATA->module.]*/
-                                                        result->module = JNIFunc(result->env, NewGlobalRef, jModule_object);
-                                                        if (result->module == NULL)
-                                                        {
-                                                            LogError("Failed to get a global reference to the module Java object (%s). System ran out of memory.", result->moduleName);
-                                                            destroy_module_internal(result, true);
-                                                            result = NULL;
-                                                        }
-                                                    }
-                                                }
-                                            }
+                                            jModule_object = NULL;
                                         }
                                     }
                                 }
                             }
+                            else
+                            {
+                                jModule_object = NewObjectInternal(env, jModule_class, jModule_constructor, 3, (jlong)module, jBroker_object, jModule_configuration);
+                                exception = JNIFunc(env, ExceptionOccurred);
+                            }
+
+                            if (jModule_object == NULL || exception)
+                            {
+                                /*Codes_SRS_JAVA_MODULE_HOST_14_016: [This function shall return NULL if any returned jclass, jmethodID, or jobject is NULL.]*/
+                                /*Codes_SRS_JAVA_MODULE_HOST_14_017: [This function shall return NULL if any JNI function fails.]*/
+                                LogError("Failed to create the %s object.", module->moduleName);
+                                JNIFunc(env, ExceptionDescribe);
+                                JNIFunc(env, ExceptionClear);
+                                result = __LINE__;
+                            }
+                            else
+                            {
+                                /*Codes_SRS_JAVA_MODULE_HOST_14_005: [This function shall return a non-NULL MODULE_HANDLE when successful.]*/
+                                /*Codes_SRS_JAVA_MODULE_HOST_14_018: [The function shall save a new global reference to the Java module object in JAVA_MODULE_HANDLE_DATA->module.]*/
+                                module->module = JNIFunc(env, NewGlobalRef, jModule_object);
+                                if (module->module == NULL)
+                                {
+                                    LogError("Failed to get a global reference to the module Java object (%s). System ran out of memory.", module->moduleName);
+                                    result = __LINE__;
+                                }
+                                else
+                                {
+                                    result = 0;
+                                }
+                            }
                         }
                     }
                 }
@@ -330,48 +379,57 @@ static void JavaModuleHost_Destroy(MODULE_HANDLE module)
     {
         JAVA_MODULE_HANDLE_DATA* moduleHandle = (JAVA_MODULE_HANDLE_DATA *)module;
 
-        /*Codes_SRS_JAVA_MODULE_HOST_14_039: [This function shall attach the JVM to the current thread. ]*/
-        jint jni_result = JNIFunc(moduleHandle->jvm, AttachCurrentThread, (void**)(&(moduleHandle->env)), NULL);
-        if (jni_result != JNI_OK)
+        if (!module_is_constructed(moduleHandle))
         {
-            /*Codes_SRS_JAVA_MODULE_HOST_14_041: [ This function shall exit if any JNI function fails. ]*/
-            LogError("Could not attach the current thread to the JVM. (Result: %i)", jni_result);
+            /*Codes_SRS_JAVA_MODULE_HOST_26_010: [ If the Java module object could not be constructed, this function shall free all resources associated with this module. ]*/
+            LogError("%s was not constructed; releasing its resources.", moduleHandle->moduleName);
+            destroy_module_internal(moduleHandle, true);
         }
         else
         {
-            /*Codes_SRS_JAVA_MODULE_HOST_14_038: [This function shall find get the user-defined Java module class using the module parameter and get the destroy(). ]*/
-            /*Codes_SRS_JAVA_MODULE_HOST_14_041: [ This function shall exit if any JNI function fails. ]*/
-            jmethodID jModule_destroy = get_module_method(moduleHandle, MODULE_DESTROY_METHOD_NAME, MODULE_DESTROY_DESCRIPTOR);
-            if (jModule_destroy == NULL)
+            /*Codes_SRS_JAVA_MODULE_HOST_14_039: [This function shall attach the JVM to the current thread. ]*/
+            jint jni_result = JNIFunc(moduleHandle->jvm, AttachCurrentThread, (void**)(&(moduleHandle->env)), NULL);
+            if (jni_result != JNI_OK)
             {
                 /*Codes_SRS_JAVA_MODULE_HOST_14_041: [ This function shall exit if any JNI function fails. ]*/
-                LogError("Failed to get the %s destroy() method.", moduleHandle->moduleName);
+                LogError("Could not attach the current thread to the JVM. (Result: %i)", jni_result);
             }
             else
             {
-                /*Codes_SRS_JAVA_MODULE_HOST_14_020: [This function shall call the void destroy() method of the Java module object and delete the global reference to this object.]*/
-                //Destruction will continue even if there is an exception in the Java destroy method
-                CallVoidMethodInternal(moduleHandle->env, moduleHandle->module, jModule_destroy, 0);
-                jthrowable exception = JNIFunc(moduleHandle->env, ExceptionOccurred);
-                if (exception)
+                /*Codes_SRS_JAVA_MODULE_HOST_14_038: [This function shall find get the user-defined Java module class using the module parameter and get the destroy(). ]*/
+                /*Codes_SRS_JAVA_MODULE_HOST_14_041: [ This function shall exit if any JNI function fails. ]*/
+                jmethodID jModule_destroy = get_module_method(moduleHandle, MODULE_DESTROY_METHOD_NAME, MODULE_DESTROY_DESCRIPTOR);
+                if (jModule_destroy == NULL)
                 {
-                    LogError("Exception occurred in destroy() of %s.", moduleHandle->moduleName);
-                    JNIFunc(moduleHandle->env, ExceptionDescribe);
-                    JNIFunc(moduleHandle->env, ExceptionClear);
+                    /*Codes_SRS_JAVA_MODULE_HOST_14_041: [ This function shall exit if any JNI function fails. ]*/
+                    LogError("Failed to get the %s destroy() method.", moduleHandle->moduleName);
                 }
+                else
+                {
+                    /*Codes_SRS_JAVA_MODULE_HOST_14_020: [This function shall call the void destroy() method of the Java module object and delete the global reference to this object.]*/
+                    //Destruction will continue even if there is an exception in the Java destroy method
+                    CallVoidMethodInternal(moduleHandle->env, moduleHandle->module, jModule_destroy, 0);
+                    jthrowable exception = JNIFunc(moduleHandle->env, ExceptionOccurred);
+                    if (exception)
+                    {
+                        LogError("Exception occurred in destroy() of %s.", moduleHandle->moduleName);
+                        JNIFunc(moduleHandle->env, ExceptionDescribe);
+                        JNIFunc(moduleHandle->env, ExceptionClear);
+                    }
 
-                JNIFunc(moduleHandle->env, DeleteGlobalRef, moduleHandle->module);
+                    JNIFunc(moduleHandle->env, DeleteGlobalRef, moduleHandle->module);
 
-                /*Codes_SRS_JAVA_MODULE_HOST_14_040: [This function shall detach the JVM from the current thread.]*/
-                jni_result = JNIFunc(moduleHandle->jvm, DetachCurrentThread);
-                if (jni_result != JNI_OK)
-                {
-                    LogError("Could not detach the current thread from the JVM. (Result: %i)", jni_result);
-                }
+                    /*Codes_SRS_JAVA_MODULE_HOST_14_040: [This function shall detach the JVM from the current thread.]*/
+                    jni_result = JNIFunc(moduleHandle->jvm, DetachCurrentThread);
+                    if (jni_result != JNI_OK)
+                    {
+                        LogError("Could not detach the current thread from the JVM. (Result: %i)", jni_result);
+                    }
 
-                /*Codes_SRS_JAVA_MODULE_HOST_14_029: [This function shall destroy the JVM if it the last module to be disconnected from the gateway.]*/
-                /*Codes_SRS_JAVA_MODULE_HOST_14_021: [This function shall free all resources associated with this module.]*/
-                destroy_module_internal(moduleHandle, true);
+                    /*Codes_SRS_JAVA_MODULE_HOST_14_029: [This function shall destroy the JVM if it the last module to be disconnected from the gateway.]*/
+                    /*Codes_SRS_JAVA_MODULE_HOST_14_021: [This function shall free all resources associated with this module.]*/
+                    destroy_module_internal(moduleHandle, true);
+                }
             }
         }
     }
@@ -380,7 +438,8 @@ static void JavaModuleHost_Destroy(MODULE_HANDLE module)
 static void JavaModuleHost_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
 {
     /*Codes_SRS_JAVA_MODULE_HOST_14_022: [This function shall do nothing if module or message is NULL.]*/
-    if (module != NULL && message != NULL)
+    /*Codes_SRS_JAVA_MODULE_HOST_26_009: [ This function shall do nothing if the Java module object could not be constructed. ]*/
+    if (module != NULL && message != NULL && module_is_constructed((JAVA_MODULE_HANDLE_DATA*)module))
     {
         JAVA_MODULE_HANDLE_DATA* moduleHandle = (JAVA_MODULE_HANDLE_DATA*)module;
 
@@ -465,7 +524,8 @@ static void JavaModuleHost_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
 static void JavaModuleHost_Start(MODULE_HANDLE module)
 {
     /*Codes_SRS_JAVA_MODULE_HOST_14_049: [This function shall do nothing if module is NULL.]*/
-    if (module != NULL)
+    /*Codes_SRS_JAVA_MODULE_HOST_26_009: [ This function shall do nothing if the Java module object could not be constructed. ]*/
+    if (module != NULL && module_is_constructed((JAVA_MODULE_HANDLE_DATA*)module))
     {
         JAVA_MODULE_HANDLE_DATA* moduleHandle = (JAVA_MODULE_HANDLE_DATA*)module;
 
@@ -624,6 +684,120 @@ static jmethodID get_module_method(JAVA_MODULE_HANDLE_DATA* module, const char*
     return jModule_method;
 }
 
+static int module_startup_thread(void* param)
+{
+    JAVA_MODULE_HANDLE_DATA* module = (JAVA_MODULE_HANDLE_DATA*)param;
+    JNIEnv* env = NULL;
+    int result;
+
+    /*Codes_SRS_JAVA_MODULE_HOST_26_004: [ The startup thread shall attach itself to the JVM, construct the Java module, detach from the JVM and report the module's startup time. ]*/
+    jint jni_result = JNIFunc(module->jvm, AttachCurrentThread, (void**)(&env), NULL);
+    if (jni_result != JNI_OK)
+    {
+        LogError("Could not attach the startup thread of %s to the JVM. (Result: %i)", module->moduleName, jni_result);
+        result = __LINE__;
+    }
+    else
+    {
+        result = construct_module(module, env, module->broker, module->configuration_json);
+        if (result != 0)
+        {
+            LogError("Failed to construct %s on its startup thread.", module->moduleName);
+        }
+        else
+        {
+            report_startup_time(module);
+        }
+
+        jni_result = JNIFunc(module->jvm, DetachCurrentThread);
+        if (jni_result != JNI_OK)
+        {
+            LogError("Could not detach the startup thread of %s from the JVM. (Result: %i)", module->moduleName, jni_result);
+        }
+    }
+
+    return result;
+}
+
+static int start_construction(JAVA_MODULE_HANDLE_DATA* module, const JAVA_MODULE_HOST_CONFIG* config)
+{
+    int result;
+
+    //The gateway frees the module configuration once Module_Create returns
+    if (mallocAndStrcpy_s(&module->class_name_copy, config->class_name) != 0)
+    {
+        LogError("Failed to copy the class name.");
+        module->class_name_copy = NULL;
+        result = __LINE__;
+    }
+    else if (config->configuration_json != NULL && mallocAndStrcpy_s(&module->configuration_json, config->configuration_json) != 0)
+    {
+        LogError("Failed to copy the configuration of %s.", config->class_name);
+        module->configuration_json = NULL;
+        result = __LINE__;
+    }
+    else if ((module->startup_lock = Lock_Init()) == NULL)
+    {
+        LogError("Failed to create the startup lock of %s.", config->class_name);
+        result = __LINE__;
+    }
+    else
+    {
+        module->moduleName = module->class_name_copy;
+        if (ThreadAPI_Create(&module->startup_thread, module_startup_thread, module) != THREADAPI_OK)
+        {
+            /*Codes_SRS_JAVA_MODULE_HOST_26_006: [ If the copies, the startup lock or the startup thread cannot be created, this function shall fail and return NULL. ]*/
+            LogError("Failed to start the startup thread of %s.", module->moduleName);
+            module->startup_thread = NULL;
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static bool module_is_constructed(JAVA_MODULE_HANDLE_DATA* module)
+{
+    if (module->startup_lock != NULL)
+    {
+        /*Codes_SRS_JAVA_MODULE_HOST_26_005: [ Destroy, Receive and Start shall wait for the startup thread to finish before they use the Java module object. ]*/
+        if (Lock(module->startup_lock) != LOCK_OK)
+        {
+            LogError("Could not lock the startup lock of %s.", module->moduleName);
+        }
+        else
+        {
+            if (module->startup_thread != NULL)
+            {
+                int thread_result;
+                if (ThreadAPI_Join(module->startup_thread, &thread_result) != THREADAPI_OK)
+                {
+                    LogError("Could not join the startup thread of %s.", module->moduleName);
+                }
+                module->startup_thread = NULL;
+            }
+            (void)Unlock(module->startup_lock);
+        }
+    }
+
+    return module->module != NULL;
+}
+
+static void report_startup_time(JAVA_MODULE_HANDLE_DATA* module)
+{
+    tickcounter_ms_t elapsed;
+
+    /*Codes_SRS_JAVA_MODULE_HOST_26_008: [ Once the Java module object is constructed, the startup time of the module shall be logged. ]*/
+    if (module->startup_timer != NULL && tickcounter_get_current_ms(module->startup_timer, &elapsed) == 0)
+    {
+        LogInfo("Java module %s started in %lu ms.", module->moduleName, (unsigned long)elapsed);
+    }
+}
+
 static int JVM_Create(JavaVM** jvm, JNIEnv** env, JVM_OPTIONS* options)
 {
     /*Codes_SRS_JAVA_MODULE_HOST_14_007: [This function shall initialize a JavaVMInitArgs structure using the JVM_OPTIONS structure configuration->options.]*/
@@ -699,6 +873,10 @@ static int init_vm_options(JavaVMInitArgs* jvm_args, VECTOR_HANDLE* options_stri
             options_count += (jvm_options->library_path != NULL ? 1 : 0);
             options_count += (jvm_options->debug == true ? 3 : 0);
             options_count += (jvm_options->verbose == true ? 1 : 0);
+            options_count += (jvm_options->cds_archive != NULL ? 2 : 0);
+            options_count += (jvm_options->tiered_stop_at_level > 0 && jvm_options->tiered_stop_at_level <= TIERED_STOP_AT_LEVEL_MAX_VALUE ? 1 : 0);
+            options_count += (jvm_options->initial_heap_mb > 0 ? 1 : 0);
+            options_count += (jvm_options->max_heap_mb > 0 ? 1 : 0);
 
             if (jvm_options->additional_options != NULL)
             {
@@ -882,6 +1060,57 @@ static int init_vm_options(JavaVMInitArgs* jvm_args, VECTOR_HANDLE* options_stri
                         }
                     }
                 }
+                if (jvm_options->cds_archive != NULL && result == 0)
+                {
+                    /*Codes_SRS_JAVA_MODULE_HOST_26_002: [ If configuration->options->cds_archive is set, the function shall add the -Xshare:auto and -XX:SharedArchiveFile options so the JVM maps the class data sharing archive, and falls back to loading classes if the archive cannot be used. ]*/
+                    result = add_vm_option(jvm_args, *options_strings, &options_count, "-Xshare:auto", NULL);
+                    if (result == 0)
+                    {
+                        result = add_vm_option(jvm_args, *options_strings, &options_count, "-XX:SharedArchiveFile=", jvm_options->cds_archive);
+                    }
+                }
+                if (jvm_options->tiered_stop_at_level > 0 && jvm_options->tiered_stop_at_level <= TIERED_STOP_AT_LEVEL_MAX_VALUE && result == 0)
+                {
+                    char level_str[SIZE_OPTIONS_STR_SIZE];
+                    /*Codes_SRS_JAVA_MODULE_HOST_26_011: [ If configuration->options->tiered_stop_at_level is between 1 and 4, the function shall add the -XX:TieredStopAtLevel option. ]*/
+                    if (sprintf_s(level_str, SIZE_OPTIONS_STR_SIZE, "%i", jvm_options->tiered_stop_at_level) < 0)
+                    {
+                        LogError("sprintf failed.");
+                        result = __LINE__;
+                    }
+                    else
+                    {
+                        result = add_vm_option(jvm_args, *options_strings, &options_count, "-XX:TieredStopAtLevel=", level_str);
+                    }
+                }
+                if (jvm_options->initial_heap_mb > 0 && result == 0)
+                {
+                    char heap_str[SIZE_OPTIONS_STR_SIZE];
+                    /*Codes_SRS_JAVA_MODULE_HOST_26_012: [ If configuration->options->initial_heap_mb or configuration->options->max_heap_mb is positive, the function shall add the matching -Xms or -Xmx option in megabytes. ]*/
+                    if (sprintf_s(heap_str, SIZE_OPTIONS_STR_SIZE, "%im", jvm_options->initial_heap_mb) < 0)
+                    {
+                        LogError("sprintf failed.");
+                        result = __LINE__;
+                    }
+                    else
+                    {
+                        result = add_vm_option(jvm_args, *options_strings, &options_count, "-Xms", heap_str);
+                    }
+                }
+                if (jvm_options->max_heap_mb > 0 && result == 0)
+                {
+                    char heap_str[SIZE_OPTIONS_STR_SIZE];
+                    /*Codes_SRS_JAVA_MODULE_HOST_26_012: [ If configuration->options->initial_heap_mb or configuration->options->max_heap_mb is positive, the function shall add the matching -Xms or -Xmx option in megabytes. ]*/
+                    if (sprintf_s(heap_str, SIZE_OPTIONS_STR_SIZE, "%im", jvm_options->max_heap_mb) < 0)
+                    {
+                        LogError("sprintf failed.");
+                        result = __LINE__;
+                    }
+                    else
+                    {
+                        result = add_vm_option(jvm_args, *options_strings, &options_count, "-Xmx", heap_str);
+                    }
+                }
                 if (jvm_options->additional_options != NULL && result == 0) {
                     for (size_t opt_index = 0; opt_index < VECTOR_size(jvm_options->additional_options) && result == 0; ++opt_index) {
                         STRING_HANDLE* s = (STRING_HANDLE*)VECTOR_element(jvm_options->additional_options, opt_index);
@@ -930,6 +1159,40 @@ static int init_vm_options(JavaVMInitArgs* jvm_args, VECTOR_HANDLE* options_stri
     return result;
 }
 
+static int add_vm_option(JavaVMInitArgs* jvm_args, VECTOR_HANDLE options_strings, int* options_count, const char* option_key, const char* option_value)
+{
+    int result;
+
+    /*Codes_SRS_JAVA_MODULE_HOST_14_032:[ The function shall construct a new STRING_HANDLE for each option. ]*/
+    STRING_HANDLE option = STRING_construct(option_key);
+    if (option == NULL)
+    {
+        LogError("String_construct failed.");
+        result = __LINE__;
+    }
+    /*Codes_SRS_JAVA_MODULE_HOST_14_033:[The function shall concatenate the user supplied options to the option key names.]*/
+    else if (option_value != NULL && STRING_concat(option, option_value) != 0)
+    {
+        LogError("String_concat failed.");
+        STRING_delete(option);
+        result = __LINE__;
+    }
+    /*Codes_SRS_JAVA_MODULE_HOST_14_034:[ The function shall push the new STRING_HANDLE onto the newly created vector. ]*/
+    else if (VECTOR_push_back(options_strings, &option, 1) != 0)
+    {
+        LogError("Failed to push option (%s) onto vector.", option_key);
+        STRING_delete(option);
+        result = __LINE__;
+    }
+    else
+    {
+        (*jvm_args).options[--(*options_count)].optionString = (char*)STRING_c_str(option);
+        result = 0;
+    }
+
+    return result;
+}
+
 static void deinit_vm_options(JavaVMInitArgs* jvm_args, VECTOR_HANDLE options_strings)
 {
     if (options_strings != NULL)
@@ -964,6 +1227,23 @@ static void destroy_module_internal(JAVA_MODULE_HANDLE_DATA* module, bool decref
         JVM_Destroy(&(module->jvm));
     }
     JavaModuleHostManager_Destroy(module->manager);
+
+    if (module->startup_lock != NULL)
+    {
+        Lock_Deinit(module->startup_lock);
+    }
+    if (module->startup_timer != NULL)
+    {
+        tickcounter_destroy(module->startup_timer);
+    }
+    if (module->class_name_copy != NULL)
+    {
+        free(module->class_name_copy);
+    }
+    if (module->configuration_json != NULL)
+    {
+        free(module->configuration_json);
+    }
     free(module);
 }
 
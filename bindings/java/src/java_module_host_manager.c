@@ -21,6 +21,7 @@ static JAVA_MODULE_HOST_CONFIG* config_copy(JAVA_MODULE_HOST_CONFIG* config);
 static void config_destroy(JAVA_MODULE_HOST_CONFIG* config);
 static JVM_OPTIONS* options_copy(JVM_OPTIONS* options);
 static int VECTOR_compare(VECTOR_HANDLE vector1, VECTOR_HANDLE vector2);
+static int optional_string_compare(const char* string1, const char* string2);
 static VECTOR_HANDLE VECTOR_copy(VECTOR_HANDLE vector);
 
 JAVA_MODULE_HOST_MANAGER_HANDLE JavaModuleHostManager_Create(JAVA_MODULE_HOST_CONFIG* config)
@@ -303,10 +304,28 @@ static JVM_OPTIONS* options_copy(JVM_OPTIONS* options)
                 }
                 else
                 {
-                    new_options->debug = options->debug;
-                    new_options->debug_port = options->debug_port;
-                    new_options->verbose = options->verbose;
-                    new_options->version = options->version;
+                    //Copy the class data sharing archive path, if any
+                    new_options->cds_archive = NULL;
+                    if (options->cds_archive != NULL && mallocAndStrcpy_s((char**)(&new_options->cds_archive), options->cds_archive) != 0)
+                    {
+                        LogError("Failed to allocate cds_archive.");
+                        free((void*)new_options->class_path);
+                        free((void*)new_options->library_path);
+                        VECTOR_destroy(new_options->additional_options);
+                        free(new_options);
+                        new_options = NULL;
+                    }
+                    else
+                    {
+                        new_options->debug = options->debug;
+                        new_options->debug_port = options->debug_port;
+                        new_options->verbose = options->verbose;
+                        new_options->version = options->version;
+                        new_options->tiered_stop_at_level = options->tiered_stop_at_level;
+                        new_options->initial_heap_mb = options->initial_heap_mb;
+                        new_options->max_heap_mb = options->max_heap_mb;
+                        new_options->parallel_startup = options->parallel_startup;
+                    }
                 }
             }
         }
@@ -322,6 +341,10 @@ static void config_destroy(JAVA_MODULE_HOST_CONFIG* config)
     {
         free((void*)config->options->class_path);
         free((void*)config->options->library_path);
+        if (config->options->cds_archive != NULL)
+        {
+            free((void*)config->options->cds_archive);
+        }
         VECTOR_destroy(config->options->additional_options);
         free(config->options);
     }
@@ -368,6 +391,11 @@ static int config_options_compare(JAVA_MODULE_HOST_CONFIG* config1, JAVA_MODULE_
             options1->debug == options2->debug &&
             options1->debug_port == options2->debug_port &&
             options1->verbose == options2->verbose &&
+            optional_string_compare(options1->cds_archive, options2->cds_archive) == 0 &&
+            options1->tiered_stop_at_level == options2->tiered_stop_at_level &&
+            options1->initial_heap_mb == options2->initial_heap_mb &&
+            options1->max_heap_mb == options2->max_heap_mb &&
+            options1->parallel_startup == options2->parallel_startup &&
             VECTOR_compare(options1->additional_options, options2->additional_options) == 0
             )
         {
@@ -383,6 +411,20 @@ static int config_options_compare(JAVA_MODULE_HOST_CONFIG* config1, JAVA_MODULE_
     return result;
 }
 
+static int optional_string_compare(const char* string1, const char* string2)
+{
+    int result;
+    if (string1 == NULL || string2 == NULL)
+    {
+        result = (string1 == string2) ? 0 : __LINE__;
+    }
+    else
+    {
+        result = strcmp(string1, string2);
+    }
+    return result;
+}
+
 static VECTOR_HANDLE VECTOR_copy(VECTOR_HANDLE vector)
 {
     VECTOR_HANDLE new_vector = VECTOR_create(sizeof(STRING_HANDLE));
@@ -209,6 +209,11 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     global_config->options->verbose = false;
     global_config->options->version = 1;
     global_config->options->additional_options = VECTOR_create(1);
+    global_config->options->cds_archive = NULL;
+    global_config->options->tiered_stop_at_level = 0;
+    global_config->options->initial_heap_mb = 0;
+    global_config->options->max_heap_mb = 0;
+    global_config->options->parallel_startup = false;
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -661,6 +666,88 @@ TEST_FUNCTION(JavaModuleHostManager_Create_multiple_config_not_match_failure_add
     VECTOR_destroy((&config2)->options->additional_options);
 }
 
+/*Tests_SRS_JAVA_MODULE_HOST_MANAGER_14_031: [The function shall return NULL if the JAVA_MODULE_HOST_CONFIG structures do not match.]*/
+TEST_FUNCTION(JavaModuleHostManager_Create_multiple_config_not_match_failure_cds_archive)
+{
+    //Arrange
+
+    VECTOR_HANDLE additional_options = VECTOR_create(1);
+
+    JVM_OPTIONS options =
+    {
+        "cp",
+        "lp",
+        1,
+        true,
+        1234,
+        false,
+        additional_options,
+        "app.jsa"
+    };
+
+    JAVA_MODULE_HOST_CONFIG config2 =
+    {
+        "foo",
+        "{\"hello\": \"world\"}",
+        &options
+    };
+
+    //Act
+    JAVA_MODULE_HOST_MANAGER_HANDLE manager = JavaModuleHostManager_Create(global_config);
+    JAVA_MODULE_HOST_MANAGER_HANDLE manager2 = JavaModuleHostManager_Create(&config2);
+
+    //Assert
+    ASSERT_IS_NULL(manager2);
+
+    //Cleanup
+    JavaModuleHostManager_Destroy(manager);
+
+    VECTOR_destroy((&config2)->options->additional_options);
+}
+
+/*Tests_SRS_JAVA_MODULE_HOST_MANAGER_14_031: [The function shall return NULL if the JAVA_MODULE_HOST_CONFIG structures do not match.]*/
+TEST_FUNCTION(JavaModuleHostManager_Create_multiple_config_not_match_failure_parallel_startup)
+{
+    //Arrange
+
+    VECTOR_HANDLE additional_options = VECTOR_create(1);
+
+    JVM_OPTIONS options =
+    {
+        "cp",
+        "lp",
+        1,
+        true,
+        1234,
+        false,
+        additional_options,
+        NULL,
+        0,
+        0,
+        0,
+        true
+    };
+
+    JAVA_MODULE_HOST_CONFIG config2 =
+    {
+        "foo",
+        "{\"hello\": \"world\"}",
+        &options
+    };
+
+    //Act
+    JAVA_MODULE_HOST_MANAGER_HANDLE manager = JavaModuleHostManager_Create(global_config);
+    JAVA_MODULE_HOST_MANAGER_HANDLE manager2 = JavaModuleHostManager_Create(&config2);
+
+    //Assert
+    ASSERT_IS_NULL(manager2);
+
+    //Cleanup
+    JavaModuleHostManager_Destroy(manager);
+
+    VECTOR_destroy((&config2)->options->additional_options);
+}
+
 /*Tests_SRS_JAVA_MODULE_HOST_MANAGER_14_014: [ The function shall return MANAGER_ERROR if handle is NULL. ]*/
 TEST_FUNCTION(JavaModuleHostManager_Add_NULL)
 {
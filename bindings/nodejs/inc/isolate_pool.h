@@ -0,0 +1,181 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef NODEJS_ISOLATE_POOL_H
+#define NODEJS_ISOLATE_POOL_H
+
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+#include <functional>
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#endif
+#include "v8.h"
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/condition.h"
+
+#include "lock.h"
+
+namespace nodejs_module
+{
+    /**
+     * A v8 isolate with a single context that runs callbacks on its own
+     * thread. Modules assigned to the same isolate share that thread, so
+     * a module never runs concurrently with itself.
+     */
+    class IsolateWorker
+    {
+    private:
+        size_t m_isolate_id;
+        THREAD_HANDLE m_thread;
+        std::queue<std::function<void()>> m_callbacks;
+        Lock m_lock;
+        COND_HANDLE m_condition;
+        std::promise<bool> m_started;
+
+    public:
+        explicit IsolateWorker(size_t isolate_id);
+        ~IsolateWorker();
+
+        /**
+         * Starts the worker thread and waits for the isolate to be created.
+         */
+        bool Start();
+
+        /**
+         * Object lock/unlock methods.
+         */
+        void AcquireLock() const;
+        void ReleaseLock() const;
+
+        /**
+         * Add callbacks to be invoked on the isolate's thread with the
+         * isolate and its context entered.
+         */
+        template <typename TCallback>
+        void AddCallback(TCallback callback);
+
+    private:
+        bool GetNextCallback(std::function<void()>& callback);
+        int Run();
+
+        static int RunInternal(void* user_data);
+    };
+
+    /**
+     * The isolates that Node JS modules with a non-zero isolate ID run in.
+     * Isolates are created the first time a module is assigned to them and,
+     * like Node's own thread, run until the process exits.
+     *
+     * Isolates do not host a Node environment: modules running in them
+     * must be self-contained scripts that only use the module interface
+     * and 'console'.
+     */
+    class IsolatePool
+    {
+    private:
+        /**
+         * The isolates, keyed by isolate ID.
+         */
+        std::map<size_t, std::unique_ptr<IsolateWorker>> m_workers;
+
+        /**
+         * Compiled code of each module script, keyed by main path, so that
+         * a module loaded in several isolates is only compiled once.
+         */
+        std::map<std::string, std::vector<uint8_t>> m_code_cache;
+
+        /**
+         * Lock used to protect access to members of this object.
+         */
+        Lock m_lock;
+
+        /**
+         * Private constructor to enforce singleton instance.
+         */
+        IsolatePool();
+
+    public:
+        ~IsolatePool();
+
+        /**
+         * Gets a pointer to the singleton instance of IsolatePool.
+         * Lazily creates an instance.
+         */
+        static IsolatePool* Get();
+
+        /**
+         * Object lock/unlock methods.
+         */
+        void AcquireLock() const;
+        void ReleaseLock() const;
+
+        /**
+         * Runs 'callback' on the thread of the isolate 'isolate_id', starting
+         * the isolate if this is the first callback for it.
+         */
+        template <typename TCallback>
+        bool AddCallback(size_t isolate_id, TCallback callback);
+
+        /**
+         * Compiles and runs the script at 'main_path' in the current isolate
+         * and returns its 'module.exports'. The compiled code is cached and,
+         * when 'code_cache_path' is not empty, persisted to that file so the
+         * next start of the gateway skips compilation.
+         */
+        v8::Local<v8::Value> LoadModule(
+            v8::Isolate* isolate,
+            v8::Local<v8::Context> context,
+            const std::string& main_path,
+            const std::string& code_cache_path
+        );
+
+    private:
+        IsolateWorker* GetWorker(size_t isolate_id);
+        bool GetCodeCache(const std::string& main_path, const std::string& code_cache_path, std::vector<uint8_t>& data);
+        void SetCodeCache(const std::string& main_path, const std::string& code_cache_path, const uint8_t* data, int length);
+        void DropCodeCache(const std::string& main_path);
+    };
+
+    template <typename TCallback>
+    void IsolateWorker::AddCallback(TCallback callback)
+    {
+        LockGuard<IsolateWorker> lock_guard{ *this };
+        m_callbacks.push(callback);
+        (void)Condition_Post(m_condition);
+    }
+
+    template <typename TCallback>
+    bool IsolatePool::AddCallback(size_t isolate_id, TCallback callback)
+    {
+        bool result;
+        LockGuard<IsolatePool> lock_guard{ *this };
+
+        auto worker = GetWorker(isolate_id);
+        if (worker == nullptr)
+        {
+            LogError("Could not start isolate %zu", isolate_id);
+            result = false;
+        }
+        else
+        {
+            worker->AddCallback(callback);
+            result = true;
+        }
+
+        return result;
+    }
+};
+
+#endif // NODEJS_ISOLATE_POOL_H
@@ -6,6 +6,12 @@
 
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+
+// the class below names its own Lock and Unlock, so it calls the profiler explicitly
+#define LOCK_PROFILE_NO_REDIRECT
+#include "lock_profile.h"
+#undef LOCK_PROFILE_NO_REDIRECT
 
 namespace nodejs_module
 {
@@ -13,9 +19,14 @@ namespace nodejs_module
     {
     private:
         LOCK_HANDLE m_lock;
+        const char* m_site;
 
     public:
-        Lock()
+        /**
+         * site names this lock in the lock profile when the gateway is built
+         * with enable_lock_profiling.
+         */
+        explicit Lock(const char* site = "nodejs lock") : m_site(site)
         {
             m_lock = ::Lock_Init();
             if (m_lock == nullptr)
@@ -36,7 +47,11 @@ namespace nodejs_module
         void AcquireLock() const
         {
             LOCK_RESULT result;
+#ifdef LOCK_PROFILE_ENABLED
+            result = ::LockProfile_Lock(m_lock, m_site);
+#else
             result = ::Lock(m_lock);
+#endif
             if (result != LOCK_OK)
             {
                 LogError("Lock() failed");
@@ -46,13 +61,38 @@ namespace nodejs_module
 
         void ReleaseLock() const
         {
+#ifdef LOCK_PROFILE_ENABLED
+            LOCK_RESULT result = ::LockProfile_Unlock(m_lock);
+#else
             LOCK_RESULT result = ::Unlock(m_lock);
+#endif
             if (result != LOCK_OK)
             {
                 LogError("Unlock() failed");
                 throw result;
             }
         }
+
+        /**
+         * Waits on condition, which must be used with this lock. The lock
+         * must be held.
+         */
+        COND_RESULT Wait(COND_HANDLE condition, int timeout_milliseconds) const
+        {
+#ifdef LOCK_PROFILE_ENABLED
+            return ::LockProfile_ConditionWait(condition, m_lock, timeout_milliseconds);
+#else
+            return ::Condition_Wait(condition, m_lock, timeout_milliseconds);
+#endif
+        }
+
+        /**
+         * The underlying handle, for use with Condition_Wait.
+         */
+        LOCK_HANDLE GetHandle() const
+        {
+            return m_lock;
+        }
     };
 
     template <typename T>
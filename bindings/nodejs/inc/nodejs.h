@@ -16,6 +16,8 @@ typedef struct NODEJS_MODULE_CONFIG_TAG
 {
     STRING_HANDLE main_path;
     STRING_HANDLE configuration_json;
+    size_t isolate;
+    STRING_HANDLE code_cache_path;
 }NODEJS_MODULE_CONFIG;
 
 MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(NODEJS_MODULE)(MODULE_API_VERSION gateway_api_version);
@@ -38,7 +38,8 @@ struct NODEJS_MODULE_HANDLE_DATA
         v8_isolate(nullptr),
         module_id(0),
         on_module_start(nullptr),
-        module_state(NodeModuleState::error)
+        module_state(NodeModuleState::error),
+        isolate_id(0)
     {
     }
 
@@ -46,7 +47,9 @@ struct NODEJS_MODULE_HANDLE_DATA
         BROKER_HANDLE broker,
         const char* path,
         const char* config,
-        PFNMODULE_START module_start)
+        PFNMODULE_START module_start,
+        size_t isolate_id = 0,
+        const char* code_cache_path = nullptr)
         :
         broker(broker),
         main_path(path),
@@ -54,7 +57,9 @@ struct NODEJS_MODULE_HANDLE_DATA
         v8_isolate(nullptr),
         module_id(0),
         on_module_start(module_start),
-        module_state(NodeModuleState::error)
+        module_state(NodeModuleState::error),
+        isolate_id(isolate_id),
+        code_cache_path(code_cache_path == nullptr ? "" : code_cache_path)
     {
     }
 
@@ -67,6 +72,8 @@ struct NODEJS_MODULE_HANDLE_DATA
         on_module_start = rhs.on_module_start;
         module_id = rhs.module_id;
         module_state = rhs.module_state;
+        isolate_id = rhs.isolate_id;
+        code_cache_path = rhs.code_cache_path;
 
 
         if (v8_isolate != nullptr && rhs.module_object.IsEmpty() == false)
@@ -85,6 +92,8 @@ struct NODEJS_MODULE_HANDLE_DATA
         on_module_start = rhs.on_module_start;
         module_id = rhs.module_id;
         module_state = rhs.module_state;
+        isolate_id = rhs.isolate_id;
+        code_cache_path = rhs.code_cache_path;
 
 
         if (v8_isolate != nullptr && rhs.module_object.IsEmpty() == false)
@@ -102,6 +111,8 @@ struct NODEJS_MODULE_HANDLE_DATA
         on_module_start = rhs.on_module_start;
         this->module_id = module_id;
         module_state = rhs.module_state;
+        isolate_id = rhs.isolate_id;
+        code_cache_path = rhs.code_cache_path;
 
         if (v8_isolate != nullptr && rhs.module_object.IsEmpty() == false)
         {
@@ -139,6 +150,8 @@ struct NODEJS_MODULE_HANDLE_DATA
     size_t module_id;
     PFNMODULE_START on_module_start;
     NodeModuleState module_state;
+    size_t isolate_id;
+    std::string code_cache_path;
     nodejs_module::Lock object_lock;
 
     /*
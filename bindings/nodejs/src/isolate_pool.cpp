@@ -0,0 +1,486 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <sstream>
+
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "lock.h"
+#include "nodejs_utils.h"
+#include "isolate_pool.h"
+
+using namespace nodejs_module;
+
+// Wraps a module script the way Node wraps a CommonJS module; the wrapper
+// does not depend on the module so its compiled code can be shared by every
+// isolate that loads the same script.
+#define ISOLATE_MODULE_PREFIX                                \
+    "(function () {"                                         \
+    "  var module = { exports: {} };"                        \
+    "  (function (exports, module) {\n"
+#define ISOLATE_MODULE_SUFFIX                                \
+    "\n  })(module.exports, module);"                        \
+    "  return module.exports;"                               \
+    "})();"
+
+namespace
+{
+    class ArrayBufferAllocator : public v8::ArrayBuffer::Allocator
+    {
+    public:
+        virtual void* Allocate(size_t length)
+        {
+            return calloc(length, 1);
+        }
+
+        virtual void* AllocateUninitialized(size_t length)
+        {
+            return malloc(length);
+        }
+
+        virtual void Free(void* data, size_t length)
+        {
+            (void)length;
+            free(data);
+        }
+    };
+
+    std::string join_arguments(const v8::FunctionCallbackInfo<v8::Value>& info)
+    {
+        std::string result;
+        for (int i = 0; i < info.Length(); i++)
+        {
+            v8::String::Utf8Value value(info[i]);
+            if (i > 0)
+            {
+                result += ' ';
+            }
+            result += (*value == nullptr) ? "<invalid>" : *value;
+        }
+        return result;
+    }
+
+    void console_log(const v8::FunctionCallbackInfo<v8::Value>& info)
+    {
+        LogInfo("%s", join_arguments(info).c_str());
+    }
+
+    void console_error(const v8::FunctionCallbackInfo<v8::Value>& info)
+    {
+        LogError("%s", join_arguments(info).c_str());
+    }
+
+    bool add_console(v8::Isolate* isolate, v8::Local<v8::Context> context)
+    {
+        bool result;
+        auto console = v8::Object::New(isolate);
+        auto console_name = v8::String::NewFromUtf8(isolate, "console");
+        if (console.IsEmpty() == true || console_name.IsEmpty() == true)
+        {
+            LogError("Could not instantiate the console object");
+            result = false;
+        }
+        else
+        {
+            const struct
+            {
+                const char* name;
+                v8::FunctionCallback callback;
+            } methods[] =
+            {
+                { "log", console_log },
+                { "info", console_log },
+                { "warn", console_error },
+                { "error", console_error }
+            };
+
+            result = true;
+            for (const auto& method : methods)
+            {
+                auto method_name = v8::String::NewFromUtf8(isolate, method.name);
+                v8::Local<v8::Function> function;
+                if (
+                    method_name.IsEmpty() == true ||
+                    v8::Function::New(context, method.callback).ToLocal(&function) == false ||
+                    console->Set(context, method_name, function).FromMaybe(false) == false
+                   )
+                {
+                    LogError("Could not add console.%s", method.name);
+                    result = false;
+                    break;
+                }
+            }
+
+            if (result == true && context->Global()->Set(context, console_name, console).FromMaybe(false) == false)
+            {
+                LogError("Could not add the console object to the global context");
+                result = false;
+            }
+        }
+
+        return result;
+    }
+}
+
+IsolateWorker::IsolateWorker(size_t isolate_id) :
+    m_isolate_id(isolate_id),
+    m_thread(nullptr),
+    m_condition(Condition_Init())
+{
+    if (m_condition == nullptr)
+    {
+        LogError("Condition_Init() failed");
+        throw LOCK_ERROR;
+    }
+}
+
+IsolateWorker::~IsolateWorker()
+{
+    // Like Node's thread, the isolate thread runs until the process exits,
+    // so there is nothing to join here.
+    Condition_Deinit(m_condition);
+}
+
+void IsolateWorker::AcquireLock() const
+{
+    m_lock.AcquireLock();
+}
+
+void IsolateWorker::ReleaseLock() const
+{
+    m_lock.ReleaseLock();
+}
+
+bool IsolateWorker::Start()
+{
+    bool result;
+    auto started = m_started.get_future();
+
+    if (ThreadAPI_Create(&m_thread, IsolateWorker::RunInternal, reinterpret_cast<void*>(this)) != THREADAPI_OK)
+    {
+        LogError("ThreadAPI_Create failed");
+        m_thread = nullptr;
+        result = false;
+    }
+    else
+    {
+        result = started.get();
+    }
+
+    return result;
+}
+
+bool IsolateWorker::GetNextCallback(std::function<void()>& callback)
+{
+    LockGuard<IsolateWorker> lock_guard{ *this };
+    while (m_callbacks.empty() == true)
+    {
+        (void)m_lock.Wait(m_condition, 0);
+    }
+
+    callback = m_callbacks.front();
+    m_callbacks.pop();
+    return true;
+}
+
+int IsolateWorker::Run()
+{
+    int result;
+    ArrayBufferAllocator allocator;
+    v8::Isolate::CreateParams create_params;
+    create_params.array_buffer_allocator = &allocator;
+
+    v8::Isolate* isolate = v8::Isolate::New(create_params);
+    if (isolate == nullptr)
+    {
+        LogError("Could not create v8 isolate %zu", m_isolate_id);
+        m_started.set_value(false);
+        result = __LINE__;
+    }
+    else
+    {
+        {
+            // Node takes a v8::Locker on its own isolate, after which v8
+            // requires one on every isolate that is entered.
+            v8::Locker locker(isolate);
+            v8::Isolate::Scope isolate_scope(isolate);
+            v8::HandleScope handle_scope(isolate);
+
+            auto context = v8::Context::New(isolate);
+            if (context.IsEmpty() == true)
+            {
+                LogError("Could not create a context for v8 isolate %zu", m_isolate_id);
+                m_started.set_value(false);
+                result = __LINE__;
+            }
+            else
+            {
+                v8::Context::Scope context_scope(context);
+                if (add_console(isolate, context) == false)
+                {
+                    m_started.set_value(false);
+                    result = __LINE__;
+                }
+                else
+                {
+                    m_started.set_value(true);
+
+                    std::function<void()> callback;
+                    while (GetNextCallback(callback) == true)
+                    {
+                        v8::HandleScope callback_scope(isolate);
+                        callback();
+                    }
+
+                    result = 0;
+                }
+            }
+        }
+
+        isolate->Dispose();
+    }
+
+    return result;
+}
+
+int IsolateWorker::RunInternal(void* user_data)
+{
+    return reinterpret_cast<IsolateWorker*>(user_data)->Run();
+}
+
+IsolatePool::IsolatePool()
+{}
+
+IsolatePool::~IsolatePool()
+{
+    // This instance lives as long as the process, as does ModulesManager.
+}
+
+IsolatePool* IsolatePool::Get()
+{
+    static IsolatePool* instance = nullptr;
+    static LOCK_HANDLE lock = Lock_Init();
+
+    if (lock == nullptr)
+    {
+        LogError("Could not instantiate LOCK_HANDLE");
+        // 'instance' is already NULL
+    }
+    else if (instance == nullptr)
+    {
+        if (::Lock(lock) == LOCK_OK)
+        {
+            if (instance == nullptr)
+            {
+                try
+                {
+                    instance = new IsolatePool();
+                }
+                catch (std::bad_alloc& err)
+                {
+                    LogError("new operator failed with %s", err.what());
+                    instance = nullptr;
+                }
+            }
+
+            if (::Unlock(lock) != LOCK_OK)
+            {
+                LogError("Could not unlock LOCK_HANDLE");
+                delete instance;
+                instance = nullptr;
+            }
+        }
+        else
+        {
+            LogError("Could not lock LOCK_HANDLE");
+            // 'instance' is already NULL
+        }
+    }
+
+    return instance;
+}
+
+void IsolatePool::AcquireLock() const
+{
+    m_lock.AcquireLock();
+}
+
+void IsolatePool::ReleaseLock() const
+{
+    m_lock.ReleaseLock();
+}
+
+IsolateWorker* IsolatePool::GetWorker(size_t isolate_id)
+{
+    // The caller of this method would have already acquired an
+    // object lock.
+    IsolateWorker* result;
+    auto entry = m_workers.find(isolate_id);
+    if (entry != m_workers.end())
+    {
+        result = entry->second.get();
+    }
+    else
+    {
+        try
+        {
+            std::unique_ptr<IsolateWorker> worker(new IsolateWorker(isolate_id));
+            if (worker->Start() == false)
+            {
+                LogError("Could not start the thread of isolate %zu", isolate_id);
+                result = nullptr;
+            }
+            else
+            {
+                result = worker.get();
+                m_workers[isolate_id] = std::move(worker);
+            }
+        }
+        catch (std::bad_alloc& err)
+        {
+            LogError("Memory allocation error occurred with %s", err.what());
+            result = nullptr;
+        }
+        catch (LOCK_RESULT err)
+        {
+            LogError("A lock API error occurred when creating isolate %zu - %d", isolate_id, err);
+            result = nullptr;
+        }
+    }
+
+    return result;
+}
+
+bool IsolatePool::GetCodeCache(const std::string& main_path, const std::string& code_cache_path, std::vector<uint8_t>& data)
+{
+    LockGuard<IsolatePool> lock_guard{ *this };
+
+    auto entry = m_code_cache.find(main_path);
+    if (entry == m_code_cache.end() && code_cache_path.empty() == false)
+    {
+        std::ifstream stream(code_cache_path, std::ios::binary);
+        if (stream)
+        {
+            std::vector<uint8_t> file_data{ std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+            if (file_data.empty() == false)
+            {
+                entry = m_code_cache.insert(std::make_pair(main_path, std::move(file_data))).first;
+            }
+        }
+    }
+
+    bool result = entry != m_code_cache.end();
+    if (result == true)
+    {
+        data = entry->second;
+    }
+
+    return result;
+}
+
+void IsolatePool::SetCodeCache(const std::string& main_path, const std::string& code_cache_path, const uint8_t* data, int length)
+{
+    LockGuard<IsolatePool> lock_guard{ *this };
+
+    m_code_cache[main_path].assign(data, data + length);
+    if (code_cache_path.empty() == false)
+    {
+        std::ofstream stream(code_cache_path, std::ios::binary | std::ios::trunc);
+        if (!stream || !stream.write(reinterpret_cast<const char*>(data), length))
+        {
+            // not fatal; the module is compiled again on the next start
+            LogError("Could not write the code cache of '%s' to '%s'", main_path.c_str(), code_cache_path.c_str());
+        }
+    }
+}
+
+void IsolatePool::DropCodeCache(const std::string& main_path)
+{
+    LockGuard<IsolatePool> lock_guard{ *this };
+    m_code_cache.erase(main_path);
+}
+
+v8::Local<v8::Value> IsolatePool::LoadModule(
+    v8::Isolate* isolate,
+    v8::Local<v8::Context> context,
+    const std::string& main_path,
+    const std::string& code_cache_path
+)
+{
+    v8::Local<v8::Value> result;
+
+    std::ifstream stream(main_path);
+    if (!stream)
+    {
+        LogError("Could not read the JavaScript file at path '%s'", main_path.c_str());
+    }
+    else
+    {
+        std::stringstream script_text;
+        script_text << ISOLATE_MODULE_PREFIX << stream.rdbuf() << ISOLATE_MODULE_SUFFIX;
+
+        auto script_source = v8::String::NewFromUtf8(isolate, script_text.str().c_str());
+        auto script_name = v8::String::NewFromUtf8(isolate, main_path.c_str());
+        if (script_source.IsEmpty() == true || script_name.IsEmpty() == true)
+        {
+            LogError("Could not instantiate v8 string for JS script source - %s", main_path.c_str());
+        }
+        else
+        {
+            v8::ScriptOrigin origin(script_name);
+            std::vector<uint8_t> code_cache;
+            bool has_code_cache = GetCodeCache(main_path, code_cache_path, code_cache);
+
+            // the source owns the cached data object but not its buffer
+            v8::ScriptCompiler::Source source(
+                script_source,
+                origin,
+                has_code_cache == true ?
+                    new v8::ScriptCompiler::CachedData(code_cache.data(), static_cast<int>(code_cache.size())) :
+                    nullptr
+            );
+
+            v8::Local<v8::Script> script;
+            if (v8::ScriptCompiler::Compile(
+                    context,
+                    &source,
+                    has_code_cache == true ? v8::ScriptCompiler::kConsumeCodeCache : v8::ScriptCompiler::kProduceCodeCache
+                ).ToLocal(&script) == false)
+            {
+                LogError("Could not compile JS script - %s", main_path.c_str());
+            }
+            else
+            {
+                auto cached_data = source.GetCachedData();
+                if (has_code_cache == true)
+                {
+                    if (cached_data != nullptr && cached_data->rejected == true)
+                    {
+                        // the script or the v8 version changed; the script was
+                        // compiled from source and the next load produces new code
+                        LogInfo("Code cache of '%s' is out of date", main_path.c_str());
+                        DropCodeCache(main_path);
+                    }
+                }
+                else if (cached_data != nullptr && cached_data->length > 0)
+                {
+                    SetCodeCache(main_path, code_cache_path, cached_data->data, cached_data->length);
+                }
+
+                if (script->Run(context).ToLocal(&result) == false)
+                {
+                    LogError("Could not run JS script - %s", main_path.c_str());
+                }
+            }
+        }
+    }
+
+    return result;
+}
@@ -10,6 +10,7 @@
 #include "nodejs_utils.h"
 #include "modules_manager.h"
 #include "nodejs_idle.h"
+#include "isolate_pool.h"
 
 #include "node.h"
 
@@ -350,7 +351,7 @@ bool ModulesManager::StartModule(size_t module_id)
     }
     else
     {
-        NodeJSIdle::Get()->AddCallback([module_id, this]() {
+        auto callback = [module_id, this]() {
             // it is possible that the module has been deleted by the time
             // we get here; so we check that the module exists before we
             // do anything
@@ -365,9 +366,28 @@ bool ModulesManager::StartModule(size_t module_id)
             {
                 LogError("Module has already been deleted");
             }
-        });
+        };
 
-        result = true;
+        auto isolate_id = m_modules[module_id].isolate_id;
+        if (isolate_id == 0)
+        {
+            NodeJSIdle::Get()->AddCallback(callback);
+            result = true;
+        }
+        else
+        {
+            /*Codes_SRS_NODEJS_MODULES_MGR_26_001: [ If the module's isolate_id is not zero, StartModule shall schedule the callback on the thread of that isolate in the IsolatePool instead of on Node's thread. ]*/
+            auto isolate_pool = IsolatePool::Get();
+            if (isolate_pool == nullptr)
+            {
+                LogError("Could not get an instance of the isolate pool");
+                result = false;
+            }
+            else
+            {
+                result = isolate_pool->AddCallback(isolate_id, callback);
+            }
+        }
     }
 
     return result;
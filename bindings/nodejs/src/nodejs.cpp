@@ -26,6 +26,7 @@
 #include "nodejs_utils.h"
 #include "nodejs_idle.h"
 #include "modules_manager.h"
+#include "isolate_pool.h"
 
 #include "node.h"
 
@@ -102,7 +103,9 @@ static MODULE_HANDLE NODEJS_Create(BROKER_HANDLE broker, const void* configurati
                 broker,
                 STRING_c_str(module_config->main_path),
                 STRING_c_str(module_config->configuration_json),
-                on_module_start
+                on_module_start,
+                module_config->isolate,
+                module_config->code_cache_path == NULL ? nullptr : STRING_c_str(module_config->code_cache_path)
             );
 
             try
@@ -839,17 +842,20 @@ static void register_module(const v8::FunctionCallbackInfo<v8::Value>& info)
 
 static bool create_gateway_host(v8::Isolate* isolate, v8::Local<v8::Context> context)
 {
-    // This function is always called from a libuv thread - so we are guaranteed to
-    // be thread-safe. The gateway host object should be setup only once - the first
-    // time that a node module is created. We track this via a static bool.
-    (void)isolate;
-    (void)context;
-    static bool gateway_host_created = false;
+    // This function is always called from the thread that owns the isolate - so we
+    // are guaranteed to be thread-safe. The gateway host object should be setup only
+    // once per context - the first time that a node module is created in it.
     bool result;
+    auto gateway_host_name = v8::String::NewFromUtf8(isolate, "gatewayHost");
 
-    if (gateway_host_created == true)
+    if (gateway_host_name.IsEmpty() == true)
     {
-        result = gateway_host_created;
+        LogError("Could not instantiate a v8 string for the constant 'gatewayHost'");
+        result = false;
+    }
+    else if (context->Global()->Has(context, gateway_host_name).FromMaybe(false) == true)
+    {
+        result = true;
     }
     else
     {
@@ -864,10 +870,56 @@ static bool create_gateway_host(v8::Isolate* isolate, v8::Local<v8::Context> con
             result = nodejs_module::NodeJSUtils::AddObjectToGlobalContext("gatewayHost", gateway_host);
             gateway_host.Reset();
         }
+    }
+
+    return result;
+}
 
-        // save the creation status so we don't attempt this again
-        // if this was successful
-        gateway_host_created = result;
+static v8::Local<v8::Value> register_pooled_module(
+    v8::Isolate* isolate,
+    v8::Local<v8::Context> context,
+    NODEJS_MODULE_HANDLE_DATA* handle_data
+)
+{
+    // this is an 'empty' value by default
+    v8::Local<v8::Value> result;
+
+    auto exports = nodejs_module::IsolatePool::Get()->LoadModule(
+        isolate, context, handle_data->main_path, handle_data->code_cache_path
+    );
+    auto gateway_host_name = v8::String::NewFromUtf8(isolate, "gatewayHost");
+    auto register_method_name = v8::String::NewFromUtf8(isolate, "registerModule");
+    auto module_id_value = v8::Uint32::NewFromUnsigned(isolate, static_cast<uint32_t>(handle_data->module_id));
+    if (exports.IsEmpty() == true)
+    {
+        LogError("Could not load the JS module at path '%s'", handle_data->main_path.c_str());
+    }
+    else if (gateway_host_name.IsEmpty() == true || register_method_name.IsEmpty() == true || module_id_value.IsEmpty() == true)
+    {
+        LogError("Could not instantiate the v8 values to register the module with");
+    }
+    else
+    {
+        // the gateway host was created in this context by on_module_start
+        v8::Local<v8::Value> gateway_host;
+        v8::Local<v8::Value> register_method;
+        if (
+            context->Global()->Get(context, gateway_host_name).ToLocal(&gateway_host) == false ||
+            gateway_host->IsObject() == false ||
+            gateway_host.As<v8::Object>()->Get(context, register_method_name).ToLocal(&register_method) == false ||
+            register_method->IsFunction() == false
+           )
+        {
+            LogError("gatewayHost.registerModule is not available in the isolate");
+        }
+        else
+        {
+            v8::Local<v8::Value> argv[] = { exports, module_id_value };
+            if (register_method.As<v8::Function>()->Call(context, gateway_host, 2, argv).ToLocal(&result) == false)
+            {
+                LogError("gatewayHost.registerModule threw an exception for module '%s'", handle_data->main_path.c_str());
+            }
+        }
     }
 
     return result;
@@ -906,21 +958,31 @@ static void on_module_start(NODEJS_MODULE_HANDLE_DATA* handle_data)
             }
             else
             {
-                // build the piece of javascript we are going to run:
-                //  gatewayHost.registerModule(require('<<js_main_path>>'), <<module_id>>);
                 try
                 {
-                    std::stringstream script_str;
-                    NODE_LOAD_SCRIPT(
-                        script_str,
-                        handle_data->main_path,
-                        handle_data->module_id
-                    );
-
-                    /*SRS_NODEJS_13_012: [ The following JavaScript is then executed supplying the contents of NODEJS_MODULE_HANDLE_DATA::main_path for the placeholder variable js_main_path:
-                        gatewayHost.registerModule(require(js_main_path));
-                    */
-                    auto result = nodejs_module::NodeJSUtils::RunScript(isolate, context, script_str.str());
+                    v8::Local<v8::Value> result;
+                    if (handle_data->isolate_id == 0)
+                    {
+                        // build the piece of javascript we are going to run:
+                        //  gatewayHost.registerModule(require('<<js_main_path>>'), <<module_id>>);
+                        std::stringstream script_str;
+                        NODE_LOAD_SCRIPT(
+                            script_str,
+                            handle_data->main_path,
+                            handle_data->module_id
+                        );
+
+                        /*SRS_NODEJS_13_012: [ The following JavaScript is then executed supplying the contents of NODEJS_MODULE_HANDLE_DATA::main_path for the placeholder variable js_main_path:
+                            gatewayHost.registerModule(require(js_main_path));
+                        */
+                        result = nodejs_module::NodeJSUtils::RunScript(isolate, context, script_str.str());
+                    }
+                    else
+                    {
+                        /*Codes_SRS_NODEJS_26_001: [ If NODEJS_MODULE_HANDLE_DATA::isolate_id is not zero, the script at main_path shall be compiled in the isolate's context, using the code cache when one is available, and gatewayHost.registerModule shall be invoked with its module.exports and the module ID. ]*/
+                        result = register_pooled_module(isolate, context, handle_data);
+                    }
+
                     if (result.IsEmpty() == true)
                     {
                         handle_data->create_complete.set_value(NodeModuleState::error);
@@ -1143,6 +1205,30 @@ static void on_run_receive_message(
     Message_Destroy(message);
 }
 
+template <typename TCallback>
+static bool run_on_module_thread(size_t isolate_id, TCallback callback)
+{
+    bool result;
+    if (isolate_id == 0)
+    {
+        // run on node's event thread
+        nodejs_module::NodeJSIdle::Get()->AddCallback([callback]() {
+            nodejs_module::NodeJSUtils::RunWithNodeContext(callback);
+        });
+        result = true;
+    }
+    else
+    {
+        // run on the thread of the module's isolate
+        auto isolate_pool = nodejs_module::IsolatePool::Get();
+        result = isolate_pool != nullptr && isolate_pool->AddCallback(isolate_id, [callback]() {
+            nodejs_module::NodeJSUtils::RunWithNodeContext(callback);
+        });
+    }
+
+    return result;
+}
+
 void NODEJS_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
 {
     /*Codes_SRS_NODEJS_13_020: [ NodeJS_Receive shall do nothing if module is NULL. ]*/
@@ -1166,12 +1252,14 @@ void NODEJS_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
             // inc ref the message handle
             message = Message_Clone(message);
 
-            // run on node's event thread
-            nodejs_module::NodeJSIdle::Get()->AddCallback([module, message]() {
-                nodejs_module::NodeJSUtils::RunWithNodeContext([module, message](v8::Isolate* isolate, v8::Local<v8::Context> context) {
+            /*Codes_SRS_NODEJS_26_002: [ NodeJS_Receive shall deliver the message on the thread of the module's isolate: Node's thread when isolate_id is zero, otherwise the IsolatePool thread. ]*/
+            if (run_on_module_thread(handle_data->isolate_id, [module, message](v8::Isolate* isolate, v8::Local<v8::Context> context) {
                     on_run_receive_message(isolate, context, module, message);
-                });
-            });
+                }) == false)
+            {
+                LogError("Could not schedule the message on the module's isolate");
+                Message_Destroy(message);
+            }
         }
     }
 }
@@ -1248,13 +1336,14 @@ static void NODEJS_Destroy(MODULE_HANDLE module)
     else
     {
         auto module_id = reinterpret_cast<NODEJS_MODULE_HANDLE_DATA *>(module)->module_id;
+        auto isolate_id = reinterpret_cast<NODEJS_MODULE_HANDLE_DATA *>(module)->isolate_id;
 
-        // run on node's event thread
-        nodejs_module::NodeJSIdle::Get()->AddCallback([module_id]() {
-            nodejs_module::NodeJSUtils::RunWithNodeContext([module_id](v8::Isolate* isolate, v8::Local<v8::Context> context) {
+        if (run_on_module_thread(isolate_id, [module_id](v8::Isolate* isolate, v8::Local<v8::Context> context) {
                 on_quit_node(isolate, context, module_id);
-            });
-        });
+            }) == false)
+        {
+            LogError("Could not schedule the destruction of the module on its isolate");
+        }
 
         // Spin for a bit waiting for libuv to call on_quit_node
         time_t start_time = get_time(nullptr);
@@ -1331,12 +1420,12 @@ void call_start_on_module(NODEJS_MODULE_HANDLE_DATA* handle_data)
 {
     auto module_id = handle_data->module_id;
 
-    // run on node's event thread
-    nodejs_module::NodeJSIdle::Get()->AddCallback([module_id]() {
-        nodejs_module::NodeJSUtils::RunWithNodeContext([module_id](v8::Isolate* isolate, v8::Local<v8::Context> context) {
+    if (run_on_module_thread(handle_data->isolate_id, [module_id](v8::Isolate* isolate, v8::Local<v8::Context> context) {
             on_start_callback(isolate, context, module_id);
-        });
-    });
+        }) == false)
+    {
+        LogError("Could not schedule the start of the module on its isolate");
+    }
 }
 
 void NODEJS_Start(MODULE_HANDLE module)
@@ -12,6 +12,7 @@
 using namespace nodejs_module;
 
 NodeJSIdle::NodeJSIdle() :
+    m_lock("nodejs idle lock"),
     m_initialized(false)
 {}
 
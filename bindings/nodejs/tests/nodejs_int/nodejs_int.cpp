@@ -1453,4 +1453,79 @@ BEGIN_TEST_SUITE(nodejs_int)
         STRING_delete(config.main_path);
     }
 
+    TEST_FUNCTION(nodejs_module_in_isolate_pool_receives_and_publishes)
+    {
+        ///arrange
+        const char* ECHO_JS_MODULE = ""                                     \
+            "'use strict';"                                                 \
+            "module.exports = {"                                            \
+            "    broker: null,"                                             \
+            "    create: function (broker, configuration) {"                \
+            "        this.broker = broker;"                                 \
+            "        return typeof require === 'undefined';"                \
+            "    },"                                                        \
+            "    receive: function(message) {"                              \
+            "        console.log('pooled module is echoing a message');"    \
+            "        this.broker.publish({"                                 \
+            "            properties: message.properties,"                   \
+            "            content: message.content"                          \
+            "        });"                                                   \
+            "    },"                                                        \
+            "    destroy: function() {"                                     \
+            "    }"                                                         \
+            "};";
+
+        TempFile js_file;
+        js_file.Write(ECHO_JS_MODULE);
+
+        NODEJS_MODULE_CONFIG config = {
+            STRING_construct(js_file.js_file_path.c_str()),
+            STRING_construct("{}"),
+            1,
+            NULL
+        };
+
+        ///act
+        auto result = NODEJS_Create(g_broker, &config);
+        const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
+
+        MODULE module = {
+            apis,
+            result
+        };
+        Broker_AddModule(g_broker, &module);
+        BROKER_LINK_DATA broker_data =
+        {
+            result,
+            g_module.module_handle
+        };
+        Broker_AddLink(g_broker, &broker_data);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(size_t, 1, reinterpret_cast<NODEJS_MODULE_HANDLE_DATA*>(result)->isolate_id);
+
+        MAP_HANDLE message_properties = Map_Create(NULL);
+        Map_Add(message_properties, "p1", "v1");
+        unsigned char buffer[] = { 0xaa, 0xbb };
+        MESSAGE_CONFIG message_config = { sizeof(buffer), buffer, message_properties };
+        MESSAGE_HANDLE message = Message_Create(&message_config);
+        NODEJS_Receive(result, message);
+
+        // wait for 15 seconds for the echo to reach
+        // our fake module
+        wait_for_predicate(15, []() {
+            return g_mock_module.get_received_message();
+        });
+        ASSERT_IS_TRUE(g_mock_module.get_received_message() == true);
+
+        ///cleanup
+        Message_Destroy(message);
+        Map_Destroy(message_properties);
+        Broker_RemoveModule(g_broker, &module);
+        NODEJS_Destroy(result);
+        STRING_delete(config.configuration_json);
+        STRING_delete(config.main_path);
+    }
+
     END_TEST_SUITE(nodejs_int)
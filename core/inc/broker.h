@@ -41,6 +41,137 @@ typedef struct BROKER_LINK_DATA_TAG {
     MODULE_HANDLE module_sink_handle;
 } BROKER_LINK_DATA;
 
+#define BROKER_QUEUE_VALUES \
+    BROKER_QUEUE_FIFO, \
+    BROKER_QUEUE_CONFLATE
+
+/** @brief    Enumeration describing how messages waiting for a module are
+*            queued.
+*/
+DEFINE_ENUM(BROKER_QUEUE, BROKER_QUEUE_VALUES);
+
+#define BROKER_STALL_POLICY_VALUES \
+    BROKER_STALL_LOG, \
+    BROKER_STALL_SHED
+
+/** @brief    Enumeration describing what the broker does when a module's
+*            Module_Receive runs longer than its @c stall_ms.
+*/
+DEFINE_ENUM(BROKER_STALL_POLICY, BROKER_STALL_POLICY_VALUES);
+
+/** @brief    Describes how the broker delivers messages to a module.
+*/
+typedef struct BROKER_MODULE_DELIVERY_TAG {
+    /** @brief    The number of threads from which the module's
+    *            Module_Receive may be called at once. 0 or 1 delivers every
+    *            message from a single thread, in the order it was published.
+    */
+    size_t concurrency;
+    /** @brief    The name of a message property. When @c concurrency is
+    *            greater than 1, messages with the same value of this property
+    *            are delivered from the same thread, in the order they were
+    *            published. It may be a string or a typed property.
+    *            (optional, may be NULL)
+    */
+    const char* order_by;
+    /** @brief    The number of times the module's worker polls for a message
+    *            without blocking, with a CPU pause between polls, before it
+    *            starts yielding. 0 skips the spin phase.
+    */
+    size_t spin_count;
+    /** @brief    The number of times the worker polls for a message without
+    *            blocking, yielding its time slice between polls, before it
+    *            parks in a blocking receive. 0 skips the yield phase.
+    */
+    size_t yield_count;
+    /** @brief    #BROKER_QUEUE_FIFO delivers every message.
+    *            #BROKER_QUEUE_CONFLATE keeps at most one waiting message per
+    *            key: a newer message with the same key replaces it in place.
+    *            This suits sinks that only need the latest reading.
+    */
+    BROKER_QUEUE queue;
+    /** @brief    Names of the message properties that make up the key of a
+    *            conflated message, separated by '+', such as
+    *            "macAddress+characteristicUUID". Messages without one of
+    *            them are never replaced. They may be string or typed
+    *            properties. NULL gives every message the same key.
+    *            (optional, may be NULL)
+    */
+    const char* conflate_by;
+    /** @brief    The longest a single call to the module's Module_Receive may
+    *            run, in milliseconds, before the broker's watchdog reports
+    *            the module as stalled. 0 does not watch the module.
+    */
+    unsigned int stall_ms;
+    /** @brief    #BROKER_STALL_LOG logs and counts a stalled receive.
+    *            #BROKER_STALL_SHED also drops the messages that waited for
+    *            the module while it was stalled, instead of delivering them
+    *            late.
+    */
+    BROKER_STALL_POLICY stall_policy;
+    /** @brief    Name of the module in the watchdog's log messages.
+    *            (optional, may be NULL)
+    */
+    const char* name;
+    /** @brief    The most messages that may wait on one lane of a module
+    *            with a @c concurrency above 1 or a #BROKER_QUEUE_CONFLATE
+    *            queue. Such a module's worker takes every message off its
+    *            socket at once, so a message that arrives at a full lane is
+    *            dropped and counted instead. 0 uses
+    *            #BROKER_DEFAULT_MAX_QUEUED.
+    */
+    size_t max_queued;
+} BROKER_MODULE_DELIVERY;
+
+/** @brief    Lane capacity of a module added with a @c max_queued of 0. */
+#define BROKER_DEFAULT_MAX_QUEUED 1024
+
+/** @brief    Messages waiting for a module on its delivery lanes. */
+typedef struct BROKER_QUEUE_STATS_TAG {
+    /** @brief    Messages waiting now, over all of the module's lanes. */
+    size_t queued;
+    /** @brief    Capacity of each lane. */
+    size_t max_queued;
+    /** @brief    Messages dropped because their lane was full. */
+    uint64_t dropped;
+} BROKER_QUEUE_STATS;
+
+/** @brief    Number of buckets in a #BROKER_LATENCY_HISTOGRAM. */
+#define BROKER_LATENCY_BUCKETS 32
+
+/** @brief    Time from Broker_Publish to the module's worker receiving the
+*            message, in nanoseconds.
+*/
+typedef struct BROKER_LATENCY_HISTOGRAM_TAG {
+    /** @brief    Bucket @c i counts the messages whose latency was at least
+    *            2^i and below 2^(i+1) nanoseconds. The last bucket also
+    *            counts every longer latency.
+    */
+    uint64_t buckets[BROKER_LATENCY_BUCKETS];
+    /** @brief    Number of messages measured. */
+    uint64_t count;
+    /** @brief    Sum of the latencies measured, to compute the mean. */
+    uint64_t total_ns;
+    /** @brief    Longest latency measured. */
+    uint64_t max_ns;
+} BROKER_LATENCY_HISTOGRAM;
+
+/** @brief    What the broker's watchdog has seen of a module added with a
+*            @c stall_ms.
+*/
+typedef struct BROKER_STALL_STATS_TAG {
+    /** @brief    Receives that ran longer than @c stall_ms. */
+    uint64_t stalls;
+    /** @brief    Messages dropped by #BROKER_STALL_SHED. */
+    uint64_t shed;
+    /** @brief    Longest stalled receive that has returned, in
+    *            milliseconds.
+    */
+    uint64_t longest_ms;
+    /** @brief    Receives that are stalled now. */
+    size_t stalled;
+} BROKER_STALL_STATS;
+
 #define BROKER_RESULT_VALUES \
     BROKER_OK, \
     BROKER_ERROR, \
@@ -53,6 +184,40 @@ typedef struct BROKER_LINK_DATA_TAG {
 */
 DEFINE_ENUM(BROKER_RESULT, BROKER_RESULT_VALUES);
 
+/** @brief    Name of the property ::Broker_Request adds to a request, which
+*            ::Broker_Reply reads to route the reply back to the requester.
+*/
+#define BROKER_CORRELATION_ID_PROPERTY "correlationId"
+
+#define BROKER_REQUEST_RESULT_VALUES \
+    BROKER_REQUEST_REPLIED, \
+    BROKER_REQUEST_TIMEOUT, \
+    BROKER_REQUEST_CANCELLED, \
+    BROKER_REQUEST_ERROR
+
+/** @brief    Enumeration describing how a request made with ::Broker_Request
+*            completed.
+*/
+DEFINE_ENUM(BROKER_REQUEST_RESULT, BROKER_REQUEST_RESULT_VALUES);
+
+/** @brief    Called once for every request ::Broker_Request accepted.
+*
+*    @details    Replies and timeouts are delivered on the requesting module's
+*                worker thread, like its messages. Requests still pending when
+*                the requesting module is removed, or the broker destroyed,
+*                complete with #BROKER_REQUEST_CANCELLED on the thread
+*                removing it, and a reply ::Broker_Reply cannot send
+*                completes with #BROKER_REQUEST_ERROR on the replying thread.
+*
+*    @param        context     The @c context passed to ::Broker_Request.
+*    @param        result      How the request completed.
+*    @param        reply       The reply when @c result is
+*                            #BROKER_REQUEST_REPLIED, NULL otherwise. The
+*                            broker destroys it once the callback returns;
+*                            clone it to keep it.
+*/
+typedef void(*BROKER_REPLY_CALLBACK)(void* context, BROKER_REQUEST_RESULT result, MESSAGE_HANDLE reply);
+
 /** @brief        Creates a new message broker.
 *   
 *    @return        A valid #BROKER_HANDLE upon success, or @c NULL upon failure.
@@ -96,6 +261,67 @@ GATEWAY_EXPORT void Broker_DecRef(BROKER_HANDLE broker);
 */
 GATEWAY_EXPORT BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE message);
 
+/** @brief        Publishes several messages to the message broker at once.
+*
+*    @details    Each message is published in order as ::Broker_Publish would,
+*                but the broker takes its lock once for the whole batch and
+*                does not clone the messages. Sources that read many small
+*                messages at a time, such as a socket reader, use it to cut
+*                the per-message cost of publishing. The caller still owns
+*                the messages.
+*
+*    @param        broker      The #BROKER_HANDLE onto which the messages will be
+*                            published.
+*    @param        source      The #MODULE_HANDLE from which the messages will be
+*                            published.
+*    @param        messages    The messages to publish.
+*    @param        count       Number of messages in @c messages. A batch of 0
+*                            messages does nothing.
+*
+*    @return        A #BROKER_RESULT describing the result of the function. On
+*                #BROKER_ERROR some of the messages may have been published.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_PublishBatch(BROKER_HANDLE broker, MODULE_HANDLE source, const MESSAGE_HANDLE* messages, size_t count);
+
+/** @brief        Sends a request to a single module and calls @c callback with
+*                its reply.
+*
+*    @details    The request is delivered to @c target only, whatever the links
+*                of @c source, with a #BROKER_CORRELATION_ID_PROPERTY property
+*                added. The target answers with ::Broker_Reply. Each
+*                pending request expires on a one-shot timer of the gateway
+*                timer service, @c timeout_ms milliseconds after it was sent.
+*
+*    @param        broker      The #BROKER_HANDLE both modules were added to.
+*    @param        source      The #MODULE_HANDLE of the requesting module. The
+*                            reply is delivered on its worker thread.
+*    @param        target      The #MODULE_HANDLE of the module to send the
+*                            request to.
+*    @param        message     The #MESSAGE_HANDLE of the request.
+*    @param        timeout_ms  Milliseconds to wait for the reply; must not be 0.
+*    @param        callback    Called once when the request completes, only
+*                            if the function returns #BROKER_OK.
+*    @param        context     Passed to @c callback. (optional, may be NULL)
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_Request(BROKER_HANDLE broker, MODULE_HANDLE source, MODULE_HANDLE target, MESSAGE_HANDLE message, unsigned int timeout_ms, BROKER_REPLY_CALLBACK callback, void* context);
+
+/** @brief        Replies to a request received from ::Broker_Request.
+*
+*    @details    The reply is delivered straight to the requesting module. It
+*                fails once the request has timed out, has already been
+*                replied to, or its requester was removed.
+*
+*    @param        broker      The #BROKER_HANDLE the request was sent through.
+*    @param        request     The #MESSAGE_HANDLE of the request, as received
+*                            by the module's Module_Receive.
+*    @param        reply       The #MESSAGE_HANDLE of the reply.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_Reply(BROKER_HANDLE broker, MESSAGE_HANDLE request, MESSAGE_HANDLE reply);
+
 /** @brief        Adds a module to the message broker.
 *
 *    @details    For details about threading with regard to the message broker
@@ -111,6 +337,103 @@ GATEWAY_EXPORT BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE
 */
 GATEWAY_EXPORT BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module);
 
+/** @brief        Adds a module to the message broker, choosing how many
+*                threads messages are delivered to it from.
+*
+*    @details    Broker_AddModule delivers to each module from a single
+*                thread. A module whose Module_Receive is thread safe can be
+*                added with a @c delivery->concurrency greater than 1 so that
+*                a slow Module_Receive does not hold up the messages behind
+*                it.
+*
+*    @param        broker          The #BROKER_HANDLE onto which the module will be
+*                                added.
+*    @param        module            The #MODULE for the module that will be added
+*                                to this message broker.
+*    @param        delivery        The #BROKER_MODULE_DELIVERY describing how
+*                                messages are delivered to the module.
+*                                (optional, may be NULL)
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_AddModuleWithDelivery(BROKER_HANDLE broker, const MODULE* module, const BROKER_MODULE_DELIVERY* delivery);
+
+/** @brief        Adds a module to the message broker that takes over from a
+*                module already attached to it.
+*
+*    @details    Links into @c module can be added while @c replaced still
+*                receives on its own links. Until @c replaced is removed with
+*                ::Broker_RemoveModule, @c module drops the messages it is
+*                sent, since @c replaced receives them. Removing @c replaced
+*                is the handoff: @c replaced delivers every message published
+*                before it, and @c module receives every message published
+*                after it, starting once @c replaced has delivered its last
+*                one. Each message is received by exactly one of them. The
+*                modules linked from @c replaced stop receiving from it once
+*                they have received the messages it published before it was
+*                removed, so @c replaced does not need its links removed.
+*
+*    @param        broker          The #BROKER_HANDLE onto which the module will be
+*                                added.
+*    @param        module          The #MODULE for the module that will be added
+*                                to this message broker.
+*    @param        delivery        The #BROKER_MODULE_DELIVERY describing how
+*                                messages are delivered to the module.
+*                                (optional, may be NULL)
+*    @param        replaced        The #MODULE of the module to take over from.
+*                                A module is replaced by one module at a time.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_AddReplacementModule(BROKER_HANDLE broker, const MODULE* module, const BROKER_MODULE_DELIVERY* delivery, const MODULE* replaced);
+
+/** @brief        Returns the publish-to-receive latencies of a module.
+*
+*    @details    Latencies are only measured when the gateway is built with
+*                @c enable_broker_latency_stats; otherwise the function
+*                returns #BROKER_ERROR. The histogram is read while messages
+*                are being delivered, so its fields may be off by the
+*                messages in flight.
+*
+*    @param        broker          The #BROKER_HANDLE the module was added to.
+*    @param        module          The #MODULE whose latencies are returned.
+*    @param        histogram       Receives the module's latencies.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_GetLatencyHistogram(BROKER_HANDLE broker, const MODULE* module, BROKER_LATENCY_HISTOGRAM* histogram);
+
+/** @brief        Returns what the broker's watchdog has seen of a module.
+*
+*    @details    Only a module added with a @c delivery->stall_ms is
+*                watched; for any other module the function returns
+*                #BROKER_ERROR. Deliveries over a fused link run on the
+*                publisher's thread and are not watched.
+*
+*    @param        broker          The #BROKER_HANDLE the module was added to.
+*    @param        module          The #MODULE whose stalls are returned.
+*    @param        stats           Receives the module's stall counters.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_GetStallStats(BROKER_HANDLE broker, const MODULE* module, BROKER_STALL_STATS* stats);
+
+/** @brief        Returns how many messages wait for a module and how many
+*                were dropped because its lanes were full.
+*
+*    @details    Only a module with delivery lanes, added with a
+*                @c delivery->concurrency above 1 or a
+*                #BROKER_QUEUE_CONFLATE queue, queues messages; for any
+*                other module the function returns #BROKER_ERROR.
+*
+*    @param        broker          The #BROKER_HANDLE the module was added to.
+*    @param        module          The #MODULE whose queue is returned.
+*    @param        stats           Receives the module's queue counters.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_GetQueueStats(BROKER_HANDLE broker, const MODULE* module, BROKER_QUEUE_STATS* stats);
+
 /** @brief        Removes a module from the message broker.
 *   
 *    @param        broker    The #BROKER_HANDLE from which the module will be removed.
@@ -135,6 +458,24 @@ GATEWAY_EXPORT BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MOD
 */
 GATEWAY_EXPORT BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link);
 
+/** @brief        Adds a route that is delivered without a broker hop.
+*
+*    @details    Messages the source publishes are passed to the sink's
+*                Module_Receive on the publishing thread, before
+*                ::Broker_Publish returns, instead of being serialized and
+*                received by the sink's worker thread. A module can be the
+*                source of one fused link and the sink of one fused link.
+*                The link is removed with ::Broker_RemoveLink.
+*
+*    @param        broker          The #BROKER_HANDLE onto which the link will be
+*                                added.
+*    @param        link            The #BROKER_LINK_DATA for the link that will be added
+*                                to this message broker.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_AddFusedLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link);
+
 /** @brief        Removes a route from the message broker.
 *
 *    @param        broker    The #BROKER_HANDLE from which the link will be removed.
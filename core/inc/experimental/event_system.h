@@ -70,6 +70,12 @@ typedef void* GATEWAY_EVENT_CTX;
  *              gateway events 
  *
  *  @c context may be NULL if the #GATEWAY_EVENT does not provide a context.
+ *
+ *  Callbacks are called one at a time on the gateway timer service thread,
+ *  which also times out broker requests, checks module watchdogs and polls
+ *  out-of-process modules, so a callback must not block. It may publish
+ *  messages and add or remove modules, but it must not call
+ *  @c Gateway_Destroy, which waits for the callbacks to return.
  */
 typedef void(*GATEWAY_CALLBACK)(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param);
 
@@ -78,8 +84,9 @@ void EventSystem_AddEventCallback(EVENTSYSTEM_HANDLE event_system, GATEWAY_EVENT
 void EventSystem_ReportEvent(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type);
 void EventSystem_Destroy(EVENTSYSTEM_HANDLE event_system);
 
-/** @brief      Registers a function to be called on a callback thread when_all
- *              #GATEWAY_EVENT happens
+/** @brief      Registers a function to be called on the gateway timer service
+ *              thread when a #GATEWAY_EVENT happens; see #GATEWAY_CALLBACK for
+ *              what it may do there
  *        
  *  @param      gw          Pointer to a #GATEWAY_HANDLE to which the callback
  *                          will be added
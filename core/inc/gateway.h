@@ -65,6 +65,13 @@ typedef struct GATEWAY_LINK_ENTRY_TAG
 
     /** @brief  The name of the module which is going to receive messages. */
     const char* module_sink;
+
+    /** @brief  Whether the sink should receive on the thread of the source,
+     *          without a broker hop. The link is only fused if the sink is
+     *          fusion-safe and the link is the sink's only input and the
+     *          source's only output; otherwise it is added as a regular link.
+     */
+    bool fuse;
 } GATEWAY_LINK_ENTRY;
 
 /** @brief      Struct representing a particular gateway. */
@@ -97,6 +104,12 @@ typedef struct GATEWAY_MODULES_ENTRY_TAG
 
     /** @brief  The user-defined configuration object for the module */
     const void* module_configuration;
+
+    /** @brief  How the broker delivers messages to the module. A
+     *          @c concurrency of 0 uses the concurrency the module
+     *          advertises in its #MODULE_API.
+     */
+    BROKER_MODULE_DELIVERY delivery;
 } GATEWAY_MODULES_ENTRY;
 
 /** @brief      Struct representing the properties that should be used when
@@ -241,6 +254,26 @@ GATEWAY_EXPORT void Gateway_RemoveModule(GATEWAY_HANDLE gw, MODULE_HANDLE module
  */
 GATEWAY_EXPORT int Gateway_RemoveModuleByName(GATEWAY_HANDLE gw, const char *module_name);
 
+/** @brief      Replaces a running module with a new instance without losing
+ *              messages.
+ *
+ *              The new module is created from @c entry, takes the name and
+ *              links of the module it replaces and is started (if the gateway
+ *              has been started) before the old one is removed. The old module
+ *              then receives the messages published before the switch and the
+ *              new one every message published after, each exactly once.
+ *              Fused links of the old module come back as regular links.
+ *
+ *  @param      gw          Pointer to a #GATEWAY_HANDLE holding the module.
+ *  @param      module_name The name of the module to be replaced.
+ *  @param      entry       Pointer to a #GATEWAY_MODULES_ENTRY describing the
+ *                          new module. Its @c module_name is ignored.
+ *
+ *  @return     The #MODULE_HANDLE of the new module, or @c NULL on failure,
+ *              in which case the old module is left running.
+ */
+GATEWAY_EXPORT MODULE_HANDLE Gateway_ReplaceModule(GATEWAY_HANDLE gw, const char* module_name, const GATEWAY_MODULES_ENTRY* entry);
+
 /** @brief      Adds a link to a gateway message broker.
  *
  *  @param      gw          Pointer to a #GATEWAY_HANDLE from which link is
@@ -261,6 +294,58 @@ GATEWAY_EXPORT GATEWAY_ADD_LINK_RESULT Gateway_AddLink(GATEWAY_HANDLE gw, const
  */
 GATEWAY_EXPORT void Gateway_RemoveLink(GATEWAY_HANDLE gw, const GATEWAY_LINK_ENTRY* entryLink);
 
+/** @brief      Returns the heap usage attributed to a module.
+ *
+ *  @details    Statistics are only collected when the gateway and modules
+ *              are built with @c enable_module_alloc_stats. See module_alloc.h.
+ *
+ *  @param      gw          #GATEWAY_HANDLE the module belongs to.
+ *  @param      module_name Name of the module.
+ *  @param      stats       Receives the module's statistics.
+ *
+ *  @return     0 on success and a non-zero value when an error occurs.
+ */
+GATEWAY_EXPORT int Gateway_GetModuleAllocStats(GATEWAY_HANDLE gw, const char* module_name, MODULE_ALLOC_STATS* stats);
+
+/** @brief      Sets a soft memory budget for a module. A module going over
+ *              its budget is logged once per overrun and counted in
+ *              #MODULE_ALLOC_STATS; its allocations do not fail.
+ *
+ *  @param      gw              #GATEWAY_HANDLE the module belongs to.
+ *  @param      module_name     Name of the module.
+ *  @param      budget_bytes    Budget in bytes, 0 to remove the budget.
+ *
+ *  @return     0 on success and a non-zero value when an error occurs.
+ */
+GATEWAY_EXPORT int Gateway_SetModuleAllocBudget(GATEWAY_HANDLE gw, const char* module_name, size_t budget_bytes);
+
+/** @brief      Returns how long messages took to reach a module, from
+ *              Broker_Publish to the module's worker receiving them.
+ *
+ *  @details    Latencies are only measured when the gateway is built with
+ *              @c enable_broker_latency_stats. Use it to compare the
+ *              "wait.spin" and "wait.yield" settings of a module.
+ *
+ *  @param      gw          #GATEWAY_HANDLE the module belongs to.
+ *  @param      module_name Name of the module.
+ *  @param      histogram   Receives the module's latencies.
+ *
+ *  @return     0 on success and a non-zero value when an error occurs.
+ */
+GATEWAY_EXPORT int Gateway_GetModuleLatencyHistogram(GATEWAY_HANDLE gw, const char* module_name, BROKER_LATENCY_HISTOGRAM* histogram);
+
+/** @brief      Returns how often a module's Module_Receive ran longer than
+ *              the module's "stall.ms", and how many messages it shed.
+ *
+ *  @param      gw          #GATEWAY_HANDLE the module belongs to.
+ *  @param      module_name Name of the module.
+ *  @param      stats       Receives the module's stall counters.
+ *
+ *  @return     0 on success and a non-zero value when an error occurs, or
+ *              when the module has no "stall.ms".
+ */
+GATEWAY_EXPORT int Gateway_GetModuleStallStats(GATEWAY_HANDLE gw, const char* module_name, BROKER_STALL_STATS* stats);
+
 #ifdef __cplusplus
 }
 #endif
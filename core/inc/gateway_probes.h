@@ -0,0 +1,44 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       gateway_probes.h
+ *  @brief      Static tracepoints on the gateway's message hot paths.
+ *
+ *  @details    When the gateway is built with @c enable_trace_probes, the
+ *              GATEWAY_PROBE macros emit USDT probes through sys/sdt.h under
+ *              the provider name @c iot_gateway. An unattached probe is a
+ *              single no-op instruction, so the probes can stay in production
+ *              builds and be attached with perf or bpftrace. Without the
+ *              option the macros expand to nothing and their arguments are
+ *              not evaluated.
+ *
+ *              The probes and their arguments are listed in
+ *              core/devdoc/trace_probes.md.
+ */
+
+#ifndef GATEWAY_PROBES_H
+#define GATEWAY_PROBES_H
+
+#ifdef GATEWAY_PROBES_ENABLED
+
+#include <sys/sdt.h>
+
+#define GATEWAY_PROBE1(name, a1) \
+    DTRACE_PROBE1(iot_gateway, name, a1)
+#define GATEWAY_PROBE2(name, a1, a2) \
+    DTRACE_PROBE2(iot_gateway, name, a1, a2)
+#define GATEWAY_PROBE3(name, a1, a2, a3) \
+    DTRACE_PROBE3(iot_gateway, name, a1, a2, a3)
+#define GATEWAY_PROBE4(name, a1, a2, a3, a4) \
+    DTRACE_PROBE4(iot_gateway, name, a1, a2, a3, a4)
+
+#else
+
+#define GATEWAY_PROBE1(name, a1)
+#define GATEWAY_PROBE2(name, a1, a2)
+#define GATEWAY_PROBE3(name, a1, a2, a3)
+#define GATEWAY_PROBE4(name, a1, a2, a3, a4)
+
+#endif /* GATEWAY_PROBES_ENABLED */
+
+#endif /* GATEWAY_PROBES_H */
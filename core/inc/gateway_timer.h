@@ -0,0 +1,114 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       gateway_timer.h
+*   @brief      The gateway timer service runs the periodic and delayed work of
+*               modules and gateway subsystems on a single thread.
+*
+*   @details    Instead of keeping a thread that sleeps and polls, a module
+*               schedules a callback with #GatewayTimer_Schedule. Every timer
+*               in the process is kept on one hierarchical timer wheel, served
+*               by one thread that sleeps until the next timer is due. On
+*               Linux the thread waits on a timerfd, which is re-armed by the
+*               thread that schedules a timer, so scheduling does not wake the
+*               service thread. When no timer is armed the thread does not
+*               wake at all, which #GatewayTimer_GetStats can confirm.
+*
+*               Callbacks run one at a time on the service thread and should
+*               return quickly; work that blocks belongs on a thread of its
+*               own.
+*/
+
+#ifndef GATEWAY_TIMER_H
+#define GATEWAY_TIMER_H
+
+#include "gateway_export.h"
+
+#ifdef __cplusplus
+#include <cstdint>
+extern "C"
+{
+#else
+#include <stdint.h>
+#include <stdbool.h>
+#endif // __cplusplus
+
+typedef struct GATEWAY_TIMER_TAG* GATEWAY_TIMER_HANDLE;
+
+/** @brief      Function called when a timer is due.
+ *
+ *  @param      context     The context given to #GatewayTimer_Schedule.
+ *
+ *  @return     @c false to stop a periodic timer; the value is ignored for a
+ *              one-shot timer.
+ */
+typedef bool(*GATEWAY_TIMER_CALLBACK)(void* context);
+
+/** @brief      What the timer service thread has done since the service was
+ *              started.
+ */
+typedef struct GATEWAY_TIMER_STATS_TAG
+{
+    /** @brief  Times the service thread woke up */
+    uint64_t wakeups;
+
+    /** @brief  Times the service thread woke up and found no timer due */
+    uint64_t idle_wakeups;
+
+    /** @brief  Callbacks the service thread called */
+    uint64_t callbacks;
+
+    /** @brief  Timers currently scheduled */
+    uint64_t armed;
+} GATEWAY_TIMER_STATS;
+
+/** @brief      Starts the timer service, or adds a reference to it if it is
+ *              already started. Each successful call must be matched by a
+ *              call to #GatewayTimer_Deinit.
+ *
+ *              This function and #GatewayTimer_Deinit may be called from
+ *              any thread, except that the last #GatewayTimer_Deinit must
+ *              not be called from a timer callback.
+ *
+ *  @return     0 on success, non-zero if the service cannot be started.
+ */
+GATEWAY_EXPORT int GatewayTimer_Init(void);
+
+/** @brief      Releases a reference to the timer service. The last release
+ *              stops the service thread. Timers must be cancelled first.
+ */
+GATEWAY_EXPORT void GatewayTimer_Deinit(void);
+
+/** @brief      Schedules @c callback to be called on the service thread.
+ *
+ *  @param      delay_ms    Milliseconds until the first call.
+ *  @param      period_ms   Milliseconds between calls, measured from when
+ *                          each call was due, or 0 for a one-shot timer.
+ *  @param      callback    The function to call.
+ *  @param      context     Passed to @c callback.
+ *
+ *  @return     A handle that must be released with #GatewayTimer_Cancel, or
+ *              @c NULL if the service is not started or the timer cannot be
+ *              allocated.
+ */
+GATEWAY_EXPORT GATEWAY_TIMER_HANDLE GatewayTimer_Schedule(unsigned int delay_ms, unsigned int period_ms, GATEWAY_TIMER_CALLBACK callback, void* context);
+
+/** @brief      Stops @c timer and releases it. If its callback is running on
+ *              the service thread, this waits for it to return, so a callback
+ *              must not cancel its own timer; it returns @c false instead.
+ *              Once this returns, the callback will not be called again.
+ */
+GATEWAY_EXPORT void GatewayTimer_Cancel(GATEWAY_TIMER_HANDLE timer);
+
+/** @brief      Copies the statistics of the timer service into @c stats.
+ *
+ *  @return     0 on success, non-zero if @c stats is @c NULL or the service
+ *              is not started.
+ */
+GATEWAY_EXPORT int GatewayTimer_GetStats(GATEWAY_TIMER_STATS* stats);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // GATEWAY_TIMER_H
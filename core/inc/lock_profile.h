@@ -0,0 +1,112 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       lock_profile.h
+ *  @brief      Measures contention on the gateway's locks, per call site.
+ *
+ *  @details    When the gateway is built with @c enable_lock_profiling, every
+ *              translation unit that includes this header after lock.h has
+ *              Lock, Unlock and Condition_Wait routed through the functions
+ *              below. Each Lock call site is counted on its own, with the
+ *              time spent waiting for the lock and the time it was held until
+ *              the matching Unlock. An acquisition that waits longer than a
+ *              microsecond is counted as contended, since an uncontended lock
+ *              is taken in tens of nanoseconds.
+ *
+ *              Counters are kept per thread, so profiling adds no shared
+ *              writes to the locks it measures. The gateway logs the
+ *              statistics when it is destroyed; on POSIX platforms they are
+ *              also logged after the process receives SIGUSR2, unless the host
+ *              handles that signal itself.
+ */
+
+#ifndef LOCK_PROFILE_H
+#define LOCK_PROFILE_H
+
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "gateway_export.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C"
+{
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+/** @brief  Lock statistics of one call site. */
+typedef struct LOCK_PROFILE_STATS_TAG
+{
+    /** @brief  The call site: file, line and the lock expression. */
+    const char* site;
+    /** @brief  Number of times the lock was acquired at this site. */
+    uint64_t acquisitions;
+    /** @brief  Number of those acquisitions that had to wait. */
+    uint64_t contended_acquisitions;
+    /** @brief  Total time spent waiting for the lock, in nanoseconds. */
+    uint64_t total_wait_ns;
+    /** @brief  Longest wait for the lock, in nanoseconds. */
+    uint64_t max_wait_ns;
+    /** @brief  Total time the lock was held, in nanoseconds. */
+    uint64_t total_hold_ns;
+    /** @brief  Longest time the lock was held, in nanoseconds. */
+    uint64_t max_hold_ns;
+} LOCK_PROFILE_STATS;
+
+/** @brief      Initializes the profiler. Calls are reference counted. Locks
+ *              taken before the first call are not profiled.
+ *
+ *  @return     0 on success, non-zero otherwise.
+ */
+GATEWAY_EXPORT int LockProfile_Init(void);
+
+/** @brief      Stops profiling and discards the statistics once every
+ *              ::LockProfile_Init has been matched. Threads may still be
+ *              taking profiled locks, so the profiler keeps its lock and
+ *              each thread's counters until the process exits, and reuses
+ *              them if it is initialized again.
+ */
+GATEWAY_EXPORT void LockProfile_Deinit(void);
+
+/** @brief      Copies the statistics of up to @c count call sites into
+ *              @c stats. Counters of a thread that is taking locks may be
+ *              read mid-update.
+ *
+ *  @return     The number of call sites profiled, which may be more than
+ *              @c count.
+ */
+GATEWAY_EXPORT size_t LockProfile_GetStats(LOCK_PROFILE_STATS* stats, size_t count);
+
+/** @brief      Logs the statistics of every call site, longest total wait
+ *              first.
+ */
+GATEWAY_EXPORT void LockProfile_Dump(void);
+
+/** @brief      Asks for the statistics to be logged by the next profiled
+ *              Unlock. Safe to call from a signal handler.
+ */
+GATEWAY_EXPORT void LockProfile_RequestDump(void);
+
+GATEWAY_EXPORT LOCK_RESULT LockProfile_Lock(LOCK_HANDLE handle, const char* site);
+GATEWAY_EXPORT LOCK_RESULT LockProfile_Unlock(LOCK_HANDLE handle);
+GATEWAY_EXPORT COND_RESULT LockProfile_ConditionWait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds);
+
+#ifdef __cplusplus
+}
+#endif
+
+#if defined(LOCK_PROFILE_ENABLED) && !defined(LOCK_PROFILE_NO_REDIRECT)
+#define LOCK_PROFILE_STRINGIFY(x) #x
+#define LOCK_PROFILE_LINE(x) LOCK_PROFILE_STRINGIFY(x)
+#undef Lock
+#undef Unlock
+#undef Condition_Wait
+#define Lock(handle) LockProfile_Lock((handle), __FILE__ ":" LOCK_PROFILE_LINE(__LINE__) " " #handle)
+#define Unlock(handle) LockProfile_Unlock(handle)
+#define Condition_Wait(handle, lock, timeout_milliseconds) LockProfile_ConditionWait((handle), (lock), (timeout_milliseconds))
+#endif
+
+#endif /* LOCK_PROFILE_H */
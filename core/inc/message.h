@@ -9,7 +9,8 @@
  *
  *  @details    A message essentially has two components:
  *              - Properties represented as key/value pairs where both the
- *                key and value are strings
+ *                key and value are strings, or where the value is a number
+ *                or a byte array (typed properties)
  *              - The content of the message which is simply a memory buffer
  *                (a @c BUFFER_HANDLE)
  *
@@ -87,6 +88,95 @@ typedef struct MESSAGE_BUFFER_CONFIG_TAG
     MAP_HANDLE sourceProperties;
 }MESSAGE_BUFFER_CONFIG;
 
+/** @brief  A bounds-checked window onto the content of a message.
+ *
+ *  @details    A view references the message's @c CONSTBUFFER instead of
+ *              copying it, so it remains valid after the message is destroyed
+ *              and must be released with #MessageContentView_Release. The
+ *              bytes of the view are @c buffer[0] to @c buffer[size - 1]; a
+ *              language binding may wrap them directly for as long as it holds
+ *              the view.
+ */
+typedef struct MESSAGE_CONTENT_VIEW_TAG
+{
+    /** @brief  The content the view was taken from. */
+    CONSTBUFFER_HANDLE content;
+
+    /** @brief  Offset of the first byte of the view within the content. */
+    size_t offset;
+
+    /** @brief  The first byte of the view, or @c NULL when @c size is 0. */
+    const unsigned char* buffer;
+
+    /** @brief  The number of bytes in the view. */
+    size_t size;
+}MESSAGE_CONTENT_VIEW;
+
+/** @brief  Struct defining the changes a derived message makes to the
+ *          properties of the message it is derived from.
+ */
+typedef struct MESSAGE_DERIVE_CONFIG_TAG
+{
+    /** @brief  Properties to add to, or replace in, the derived message. This
+     *          may be @c NULL when no property is set.
+     */
+    MAP_HANDLE setProperties;
+
+    /** @brief  Names of the properties to remove from the derived message.
+     *          This may be @c NULL when @c removePropertiesCount is zero.
+     */
+    const char* const* removeProperties;
+
+    /** @brief  The number of names in @c removeProperties. */
+    size_t removePropertiesCount;
+}MESSAGE_DERIVE_CONFIG;
+
+/** @brief  The types of value a typed message property can have. */
+#define MESSAGE_PROPERTY_TYPE_VALUES \
+    MESSAGE_PROPERTY_INT64, \
+    MESSAGE_PROPERTY_DOUBLE, \
+    MESSAGE_PROPERTY_BYTES
+
+/** @brief  Enumeration specifying the type of a typed message property. */
+DEFINE_ENUM(MESSAGE_PROPERTY_TYPE, MESSAGE_PROPERTY_TYPE_VALUES);
+
+/** @brief  A message property whose value is a number or a byte array
+ *          instead of a string.
+ *
+ *  @details    Typed properties let modules attach numeric metadata, such as
+ *              timestamps and sequence numbers, without formatting it on
+ *              publish and parsing it on receive. #Message_GetProperties and
+ *              #Message_ToByteArray render them as strings for modules and
+ *              language bindings that only know string properties.
+ */
+typedef struct MESSAGE_TYPED_PROPERTY_TAG
+{
+    /** @brief  The name of the property. */
+    const char* name;
+
+    /** @brief  Which member of @c value holds the value of the property. */
+    MESSAGE_PROPERTY_TYPE type;
+
+    /** @brief  The value of the property. */
+    union
+    {
+        /** @brief  The value of a #MESSAGE_PROPERTY_INT64 property. */
+        int64_t int64Value;
+
+        /** @brief  The value of a #MESSAGE_PROPERTY_DOUBLE property. */
+        double doubleValue;
+
+        /** @brief  The value of a #MESSAGE_PROPERTY_BYTES property. The
+         *          buffer can be @c NULL when @c size is zero.
+         */
+        struct
+        {
+            const unsigned char* buffer;
+            size_t size;
+        } bytesValue;
+    } value;
+}MESSAGE_TYPED_PROPERTY;
+
 #include "azure_c_shared_utility/umock_c_prod.h"
 
 /** @brief      Creates a new reference counted message from a #MESSAGE_CONFIG
@@ -105,6 +195,25 @@ typedef struct MESSAGE_BUFFER_CONFIG_TAG
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG *, cfg);
 
+/** @brief      Creates a new reference counted message from a #MESSAGE_CONFIG
+ *              structure and an array of typed properties.
+ *
+ *  @details    The typed properties, including their names and byte array
+ *              values, are copied into the message. A typed property must not
+ *              have the same name as another typed property or as a property
+ *              in @c cfg->sourceProperties.
+ *
+ *  @param      cfg                     Pointer to a #MESSAGE_CONFIG structure.
+ *  @param      typedProperties         Array of typed properties. This may be
+ *                                      @c NULL when @c typedPropertiesCount
+ *                                      is zero.
+ *  @param      typedPropertiesCount    The number of typed properties.
+ *
+ *  @return     A non-NULL #MESSAGE_HANDLE for the newly created message, or
+ *              NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateWithTypedProperties, const MESSAGE_CONFIG *, cfg, const MESSAGE_TYPED_PROPERTY*, typedProperties, size_t, typedPropertiesCount);
+
 /** @brief      Creates a new reference counted message from a byte array
  *              containing the serialized form of a message.
  *
@@ -136,6 +245,27 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateFromByteArray,
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char *, buf, int32_t, size);
 
+/** @brief      Creates a byte array representation of a MESSAGE_HANDLE that
+ *              keeps the type of its typed properties.
+ *
+ *  @details    Works like #Message_ToByteArray, except that typed properties
+ *              are serialized as numbers and byte arrays instead of strings.
+ *              #Message_CreateFromByteArray reads both representations, but
+ *              the language bindings and remote modules only read the one
+ *              #Message_ToByteArray creates, so this one is meant for
+ *              transports that stay within the gateway process.
+ *
+ *  @param      messageHandle   A #MESSAGE_HANDLE. Must not be NULL.
+ *  @param      buf             A pointer to a byte array in memory, or NULL.
+ *  @param      size            An int32_t that specifies the size of buf.
+ *
+ *  @return     An int32_t that specifies the size of the serialized message
+ *              written when "buf" is not NULL. If "buf" is NULL, returns the
+ *              size required for a full successful serialization. Returns a
+ *              negative value when an error occurs.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int32_t, Message_ToTypedByteArray, MESSAGE_HANDLE, messageHandle, unsigned char *, buf, int32_t, size);
+
 /** @brief      Creates a new message from a @c CONSTBUFFER source and
  *              @c MAP_HANDLE.
  *
@@ -165,10 +295,30 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateFromBuffer, con
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message);
 
+/** @brief      Creates a new message that shares the content and properties of
+ *              @c parent, with the property changes in @c cfg.
+ *
+ *  @details    Neither the content nor the properties of @c parent are copied:
+ *              the derived message references them and keeps only the
+ *              properties @c cfg sets or removes. Properties set in @c cfg
+ *              take precedence over properties it removes. A message derived
+ *              from a derived message still references the properties of the
+ *              original message. The new message is reference counted like
+ *              any other and must be destroyed with #Message_Destroy.
+ *
+ *  @param      parent  The #MESSAGE_HANDLE to derive the new message from.
+ *  @param      cfg     Pointer to a #MESSAGE_DERIVE_CONFIG structure.
+ *
+ *  @return     A non-NULL #MESSAGE_HANDLE for the derived message, or @c NULL
+ *              upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_Derive, MESSAGE_HANDLE, parent, const MESSAGE_DERIVE_CONFIG*, cfg);
+
 /** @brief      Gets the properties of a message.
  *
  *  @details    The returned @c CONSTMAP handle should be destroyed when no 
- *              longer needed.
+ *              longer needed. Typed properties are included as strings:
+ *              numbers in decimal and byte arrays in lowercase hexadecimal.
  *
  *  @param      message     The #MESSAGE_HANDLE from which properties will be
  *                          fetched.
@@ -179,6 +329,42 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message);
 
+/** @brief      Gets the value of a single property of a message.
+ *
+ *  @details    Unlike #Message_GetProperties, this does not build a map of
+ *              the properties of a derived message. The returned string is
+ *              owned by the message and is valid for as long as the caller
+ *              holds @c message. Typed properties are not rendered: read them
+ *              with #Message_GetPropertyInt64, #Message_GetPropertyDouble or
+ *              #Message_GetPropertyBytes.
+ *
+ *  @param      message     The #MESSAGE_HANDLE from which the property will be
+ *                          fetched.
+ *  @param      key         The name of the property.
+ *
+ *  @return     The value of the property, or @c NULL if the message has no
+ *              such property or upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT const char*, Message_GetProperty, MESSAGE_HANDLE, message, const char*, key);
+
+/** @brief      Typed reads of a single property of a message.
+ *
+ *  @details    Each reads a typed property of the matching type. The int64
+ *              and double functions also parse a string property holding a
+ *              decimal number, so a module can read a value whether the
+ *              publisher set it as a typed property or as a string. The
+ *              buffer returned by #Message_GetPropertyBytes is owned by the
+ *              message and is valid for as long as the caller holds
+ *              @c message.
+ *
+ *  @return     0 on success, or a non-zero value if the message has no such
+ *              property or it does not hold a value of the requested type,
+ *              in which case the output parameters are not modified.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, Message_GetPropertyInt64, MESSAGE_HANDLE, message, const char*, key, int64_t*, value);
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, Message_GetPropertyDouble, MESSAGE_HANDLE, message, const char*, key, double*, value);
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, Message_GetPropertyBytes, MESSAGE_HANDLE, message, const char*, key, const unsigned char**, buffer, size_t*, size);
+
 /** @brief      Gets the content of a message.
  *
  *  @details    The returned @c CONSTBUFFER need not be freed by the caller.
@@ -204,6 +390,56 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT const CONSTBUFFER *, Message_GetContent, MESS
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT CONSTBUFFER_HANDLE, Message_GetContentHandle, MESSAGE_HANDLE, message);
 
+/** @brief      Gets a view of the whole content of a message.
+ *
+ *  @param      message     The #MESSAGE_HANDLE from which the content will be
+ *                          fetched.
+ *  @param      view        Receives the view. It must be released with
+ *                          #MessageContentView_Release.
+ *
+ *  @return     0 on success, a non-zero value otherwise.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, Message_GetContentView, MESSAGE_HANDLE, message, MESSAGE_CONTENT_VIEW*, view);
+
+/** @brief      Gets a view of @c size bytes starting at @c offset within
+ *              another view, without copying them.
+ *
+ *  @param      view        The view to slice.
+ *  @param      offset      Offset of the slice, relative to @c view.
+ *  @param      size        The number of bytes in the slice.
+ *  @param      slice       Receives the slice. It must be released with
+ *                          #MessageContentView_Release.
+ *
+ *  @return     0 on success, or a non-zero value if the slice does not fit
+ *              within @c view.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MessageContentView_Slice, const MESSAGE_CONTENT_VIEW*, view, size_t, offset, size_t, size, MESSAGE_CONTENT_VIEW*, slice);
+
+/** @brief      Releases the reference a view holds on the message content.
+ *
+ *  @param      view        The view to release. It is empty afterwards.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, MessageContentView_Release, MESSAGE_CONTENT_VIEW*, view);
+
+/** @brief      Typed reads from a view. Each reads the value at @c offset,
+ *              relative to the view, in little (LE) or big (BE) endian byte
+ *              order.
+ *
+ *  @return     0 on success, or a non-zero value if the value does not fit
+ *              within @c view, in which case @c value is not modified.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MessageContentView_ReadUInt8, const MESSAGE_CONTENT_VIEW*, view, size_t, offset, uint8_t*, value);
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MessageContentView_ReadUInt16LE, const MESSAGE_CONTENT_VIEW*, view, size_t, offset, uint16_t*, value);
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MessageContentView_ReadUInt16BE, const MESSAGE_CONTENT_VIEW*, view, size_t, offset, uint16_t*, value);
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MessageContentView_ReadUInt32LE, const MESSAGE_CONTENT_VIEW*, view, size_t, offset, uint32_t*, value);
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MessageContentView_ReadUInt32BE, const MESSAGE_CONTENT_VIEW*, view, size_t, offset, uint32_t*, value);
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MessageContentView_ReadUInt64LE, const MESSAGE_CONTENT_VIEW*, view, size_t, offset, uint64_t*, value);
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MessageContentView_ReadUInt64BE, const MESSAGE_CONTENT_VIEW*, view, size_t, offset, uint64_t*, value);
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MessageContentView_ReadFloatLE, const MESSAGE_CONTENT_VIEW*, view, size_t, offset, float*, value);
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MessageContentView_ReadFloatBE, const MESSAGE_CONTENT_VIEW*, view, size_t, offset, float*, value);
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MessageContentView_ReadDoubleLE, const MESSAGE_CONTENT_VIEW*, view, size_t, offset, double*, value);
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, MessageContentView_ReadDoubleBE, const MESSAGE_CONTENT_VIEW*, view, size_t, offset, double*, value);
+
 /** @brief      Disposes of resources allocated by the message.
  *       
  *  @param      message     The #MESSAGE_HANDLE to be destroyed.
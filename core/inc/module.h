@@ -31,6 +31,9 @@ typedef struct MODULE_API_TAG MODULE_API;
 #include "broker.h"
 #include "message.h"
 
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
 
 #ifdef __cplusplus
 extern "C"
@@ -121,11 +124,13 @@ extern "C"
     /** @brief  Module API version. */
     typedef enum MODULE_API_VERSION_TAG
     {
-        MODULE_API_VERSION_1
+        MODULE_API_VERSION_1,
+        MODULE_API_VERSION_2,
+        MODULE_API_VERSION_3
     } MODULE_API_VERSION;
 
     /** @brief  Current gateway module API version */
-    static const MODULE_API_VERSION Module_ApiGatewayVersion = MODULE_API_VERSION_1;
+    static const MODULE_API_VERSION Module_ApiGatewayVersion = MODULE_API_VERSION_3;
 
     /** @brief  Structure returned by ::Module_GetApi containing the API
      *          version. By convention, the module returns a compound structure 
@@ -171,6 +176,89 @@ extern "C"
         pfModule_Start Module_Start;
     } MODULE_API_1;
 
+    /** @brief  The module interface, version 2. It is version 1 followed by
+     *          the capabilities the module advertises to the broker.
+     */
+    typedef struct MODULE_API_2_TAG
+    {
+        /** @brief  Always the first element on a Module's API*/
+        MODULE_API base;
+
+        /** @brief  Function pointer to the #Module_ParseConfigurationFromJson
+         *          function. */
+        pfModule_ParseConfigurationFromJson Module_ParseConfigurationFromJson;
+
+        /** @brief  Function pointer to the #Module_FreeConfiguration
+         *          function. */
+        pfModule_FreeConfiguration Module_FreeConfiguration;
+
+        /** @brief  Function pointer to the #Module_Create function. */
+        pfModule_Create Module_Create;
+
+        /** @brief  Function pointer to the #Module_Destroy function. */
+        pfModule_Destroy Module_Destroy;
+
+        /** @brief  Function pointer to the #Module_Receive function. */
+        pfModule_Receive Module_Receive;
+
+        /** @brief  Function pointer to the #Module_Start function (optional).
+         */
+        pfModule_Start Module_Start;
+
+        /** @brief  The number of threads that may call #Module_Receive at the
+         *          same time. 0 or 1 means messages are delivered one at a
+         *          time, in order. A module configuration's "concurrency"
+         *          overrides this value.
+         */
+        size_t Module_ReceiveConcurrency;
+    } MODULE_API_2;
+
+    /** @brief  The module interface, version 3. It is version 2 followed by
+     *          whether the module may be fused with its producer.
+     */
+    typedef struct MODULE_API_3_TAG
+    {
+        /** @brief  Always the first element on a Module's API*/
+        MODULE_API base;
+
+        /** @brief  Function pointer to the #Module_ParseConfigurationFromJson
+         *          function. */
+        pfModule_ParseConfigurationFromJson Module_ParseConfigurationFromJson;
+
+        /** @brief  Function pointer to the #Module_FreeConfiguration
+         *          function. */
+        pfModule_FreeConfiguration Module_FreeConfiguration;
+
+        /** @brief  Function pointer to the #Module_Create function. */
+        pfModule_Create Module_Create;
+
+        /** @brief  Function pointer to the #Module_Destroy function. */
+        pfModule_Destroy Module_Destroy;
+
+        /** @brief  Function pointer to the #Module_Receive function. */
+        pfModule_Receive Module_Receive;
+
+        /** @brief  Function pointer to the #Module_Start function (optional).
+         */
+        pfModule_Start Module_Start;
+
+        /** @brief  The number of threads that may call #Module_Receive at the
+         *          same time. 0 or 1 means messages are delivered one at a
+         *          time, in order. A module configuration's "concurrency"
+         *          overrides this value.
+         */
+        size_t Module_ReceiveConcurrency;
+
+        /** @brief  Whether #Module_Receive may be called on the thread of the
+         *          module publishing to it, from within its Broker_Publish.
+         *          Such a module returns from #Module_Receive quickly and
+         *          does not wait for messages it publishes to be received.
+         *          A link configured with "fuse" is only fused into a module
+         *          that sets this.
+         */
+        bool Module_ReceiveFusionSafe;
+    } MODULE_API_3;
+
     /** @brief  This is the only function exported by a module. Using the
      *          exported function, the caller learns the functions for the 
      *          particular module.
@@ -204,4 +292,6 @@ MODULE_EXPORT const MODULE_API* Module_GetApi(MODULE_API_VERSION gateway_api_ver
 }
 #endif
 
+#include "module_alloc.h"
+
 #endif // MODULE_H
@@ -36,6 +36,35 @@ extern "C"
 /** @brief  Macro to get the Module_Receive from a MODULES_API pointer */
 #define MODULE_RECEIVE(module_api_ptr) (((const MODULE_API_1*)(module_api_ptr))->Module_Receive)
 
+/** @brief  Macro to get the number of threads that may call Module_Receive at the same time from a MODULES_API pointer; modules older than MODULE_API_VERSION_2 receive on a single thread */
+#define MODULE_RECEIVE_CONCURRENCY(module_api_ptr) \
+    (((module_api_ptr)->version >= MODULE_API_VERSION_2) ? ((const MODULE_API_2*)(module_api_ptr))->Module_ReceiveConcurrency : (size_t)1)
+
+/** @brief  Macro to get whether Module_Receive may run on the publisher's thread from a MODULES_API pointer; modules older than MODULE_API_VERSION_3 are never fused */
+#define MODULE_RECEIVE_FUSION_SAFE(module_api_ptr) \
+    (((module_api_ptr)->version >= MODULE_API_VERSION_3) ? ((const MODULE_API_3*)(module_api_ptr))->Module_ReceiveFusionSafe : false)
+
+/** @brief  Flat dispatch record for a module. It is resolved once, when the
+ *          module is added, so that delivering a message is a single
+ *          indirect call instead of a walk through the module's MODULE_API.
+ */
+typedef struct MODULE_DISPATCH_TAG
+{
+    /** @brief  The module's #Module_Receive function. */
+    pfModule_Receive receive;
+
+    /** @brief  The module instance passed to @c receive. */
+    MODULE_HANDLE module_handle;
+} MODULE_DISPATCH;
+
+/** @brief  Macro to fill a MODULE_DISPATCH record from a MODULES_API pointer and a module handle */
+#define MODULE_DISPATCH_INIT(dispatch, module_api_ptr, handle) \
+    ((dispatch).receive = MODULE_RECEIVE(module_api_ptr), (dispatch).module_handle = (handle))
+
+/** @brief  Macro to deliver a message through a MODULE_DISPATCH record */
+#define MODULE_DISPATCH_RECEIVE(dispatch, message_handle) \
+    ((dispatch).receive((dispatch).module_handle, (message_handle)))
+
 #ifdef __cplusplus
 }
 #endif
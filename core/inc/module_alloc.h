@@ -0,0 +1,133 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       module_alloc.h
+ *  @brief      Attributes heap allocations to the module that made them.
+ *
+ *  @details    When the gateway is built with @c enable_module_alloc_stats,
+ *              every translation unit that includes module.h has malloc,
+ *              calloc, realloc and free routed through the functions below.
+ *              Each allocation is charged to the #MODULE_ALLOC_TAG of the
+ *              calling thread. The gateway sets the tag while it creates,
+ *              starts and destroys a module, and the broker sets it on the
+ *              module's delivery thread, so Module_Receive is charged to the
+ *              receiving module. A free is credited back to the tag that made
+ *              the allocation, regardless of the thread it happens on.
+ *
+ *              As with gballoc.h, standard library headers must be included
+ *              before module.h when the option is enabled. In C++ this is
+ *              easy to get wrong: <cstdlib>, which most standard headers pull
+ *              in, undefines malloc and free, so a C++ file that includes
+ *              <memory> or <string> after module.h silently allocates without
+ *              attribution. Memory from operator new is never attributed.
+ *              C++ modules that need accounting must include module.h last and
+ *              route their allocations through ModuleAlloc_Malloc and
+ *              ModuleAlloc_Free.
+ *
+ *              ModuleAlloc_Deinit stops the accounting and releases the tags,
+ *              but the locks stay valid, so modules' own threads can keep
+ *              freeing memory through the redirected functions afterwards.
+ */
+
+#ifndef MODULE_ALLOC_H
+#define MODULE_ALLOC_H
+
+#include "gateway_export.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+/** @brief  Handle to the allocation accounting of one module. */
+typedef struct MODULE_ALLOC_TAG_DATA_TAG* MODULE_ALLOC_TAG;
+
+/** @brief  Heap usage attributed to one module. */
+typedef struct MODULE_ALLOC_STATS_TAG
+{
+    /** @brief  Bytes currently allocated by the module. */
+    size_t current_bytes;
+    /** @brief  Highest value @c current_bytes has reached. */
+    size_t peak_bytes;
+    /** @brief  Number of allocations made by the module. */
+    size_t allocation_count;
+    /** @brief  Number of the module's allocations that have been freed. */
+    size_t free_count;
+    /** @brief  Soft memory budget in bytes, 0 when there is none. */
+    size_t budget_bytes;
+    /** @brief  Number of times @c current_bytes went over the budget. */
+    size_t budget_exceeded_count;
+} MODULE_ALLOC_STATS;
+
+/** @brief      Initializes the allocation table. Calls are reference counted.
+ *
+ *  @return     0 on success, non-zero otherwise.
+ */
+GATEWAY_EXPORT int ModuleAlloc_Init(void);
+
+/** @brief      Releases the allocation table once every ::ModuleAlloc_Init
+ *              has been matched.
+ */
+GATEWAY_EXPORT void ModuleAlloc_Deinit(void);
+
+/** @brief      Creates a tag to charge allocations to.
+ *
+ *  @param      name    Module name, used when reporting budget overruns.
+ *
+ *  @return     A non-NULL #MODULE_ALLOC_TAG on success, @c NULL otherwise.
+ */
+GATEWAY_EXPORT MODULE_ALLOC_TAG ModuleAlloc_CreateTag(const char* name);
+
+/** @brief      Retires a tag. The tag is released once every allocation
+ *              charged to it has been freed.
+ */
+GATEWAY_EXPORT void ModuleAlloc_DestroyTag(MODULE_ALLOC_TAG tag);
+
+/** @brief      Sets the tag allocations on the calling thread are charged to.
+ *
+ *  @return     The tag that was previously set, so it can be restored.
+ */
+GATEWAY_EXPORT MODULE_ALLOC_TAG ModuleAlloc_SetThreadTag(MODULE_ALLOC_TAG tag);
+
+/** @brief      Returns the tag set on the calling thread, or @c NULL. Modules
+ *              that start their own threads can pass it on to them.
+ */
+GATEWAY_EXPORT MODULE_ALLOC_TAG ModuleAlloc_GetThreadTag(void);
+
+/** @brief      Copies the current statistics of @c tag into @c stats.
+ *
+ *  @return     0 on success, non-zero otherwise.
+ */
+GATEWAY_EXPORT int ModuleAlloc_GetStats(MODULE_ALLOC_TAG tag, MODULE_ALLOC_STATS* stats);
+
+/** @brief      Sets a soft memory budget. Going over the budget is logged
+ *              once per overrun and counted; allocations do not fail.
+ *
+ *  @param      budget_bytes    Budget in bytes, 0 to remove the budget.
+ */
+GATEWAY_EXPORT void ModuleAlloc_SetBudget(MODULE_ALLOC_TAG tag, size_t budget_bytes);
+
+GATEWAY_EXPORT void* ModuleAlloc_Malloc(size_t size);
+GATEWAY_EXPORT void* ModuleAlloc_Calloc(size_t nmemb, size_t size);
+GATEWAY_EXPORT void* ModuleAlloc_Realloc(void* ptr, size_t size);
+GATEWAY_EXPORT void ModuleAlloc_Free(void* ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#if defined(MODULE_ALLOC_STATS_ENABLED) && !defined(MODULE_ALLOC_NO_REDIRECT)
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+#define malloc ModuleAlloc_Malloc
+#define calloc ModuleAlloc_Calloc
+#define realloc ModuleAlloc_Realloc
+#define free ModuleAlloc_Free
+#endif
+
+#endif /* MODULE_ALLOC_H */
@@ -27,6 +27,10 @@ extern "C"
 typedef struct NODE_LOADER_ENTRYPOINT_TAG
 {
     STRING_HANDLE mainPath;
+    /** @brief The v8 isolate the module runs in; 0 is Node's own isolate */
+    size_t isolate;
+    /** @brief File the compiled code of the module is cached in, or NULL */
+    STRING_HANDLE codeCachePath;
 } NODE_LOADER_ENTRYPOINT;
 
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT const MODULE_LOADER*, NodeLoader_Get);
@@ -0,0 +1,84 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       static_loader.h
+ *  @brief      Library for loading gateway modules that are statically linked
+ *              into the gateway executable.
+ *
+ *  @details    The application declares, at compile time, a table that maps
+ *              module names to the MODULE_STATIC_GETAPI function of each
+ *              statically linked module and hands it to the loader with
+ *              ::StaticLoader_SetRegistry before the gateway is created. The
+ *              gateway JSON then selects a module by name:
+ *
+ *                  "loader": {
+ *                      "name": "static",
+ *                      "entrypoint": {
+ *                          "module.name": "logger"
+ *                      }
+ *                  }
+ */
+
+#ifndef STATIC_LOADER_H
+#define STATIC_LOADER_H
+
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#include "module.h"
+#include "module_loader.h"
+#include "gateway_export.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+#define STATIC_LOADER_NAME "static"
+
+/** @brief Structure to load a statically linked module */
+typedef struct STATIC_LOADER_ENTRYPOINT_TAG
+{
+    /** @brief name of the module in the static module registry */
+    STRING_HANDLE moduleName;
+} STATIC_LOADER_ENTRYPOINT;
+
+/** @brief An entry in the static module registry */
+typedef struct STATIC_LOADER_MODULE_TAG
+{
+    /** @brief name used by "module.name" in the gateway JSON */
+    const char* name;
+
+    /** @brief the module's MODULE_STATIC_GETAPI function */
+    pfModule_GetApi getApi;
+} STATIC_LOADER_MODULE;
+
+/** @brief      Builds a registry entry for a module that was compiled with
+ *              BUILD_MODULE_TYPE_STATIC and exports
+ *              MODULE_STATIC_GETAPI(MODULE_NAME).
+ */
+#define STATIC_LOADER_MODULE_ENTRY(name, MODULE_NAME) { name, MODULE_STATIC_GETAPI(MODULE_NAME) }
+
+/** @brief      Sets the table of statically linked modules the loader can
+ *              load. The table is not copied and must outlive every gateway
+ *              that uses the loader.
+ *
+ *  @param      modules     Array of registry entries, may be NULL when
+ *                          @c count is 0.
+ *  @param      count       Number of entries in @c modules.
+ *
+ *  @return     0 on success, non-zero otherwise.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, StaticLoader_SetRegistry, const STATIC_LOADER_MODULE*, modules, size_t, count);
+
+/** @brief      The API for the statically linked module loader. */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT const MODULE_LOADER*, StaticLoader_Get);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STATIC_LOADER_H
@@ -2,17 +2,33 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <inttypes.h>
+#ifdef BROKER_LATENCY_STATS_ENABLED
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#endif
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/refcount.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/uniqueid.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/tickcounter.h"
 
 #include "nanomsg/nn.h"
 #include "nanomsg/pubsub.h"
@@ -21,6 +37,9 @@
 #include "module.h"
 #include "module_access.h"
 #include "broker.h"
+#include "gateway_probes.h"
+#include "gateway_timer.h"
+#include "lock_profile.h"
 
 /* minimum size for a guid string, 36 characters + null terminator */
 #define BROKER_GUID_SIZE 37
@@ -28,6 +47,24 @@
 #define INPROC_URL_HEAD_SIZE 9
 #define URL_SIZE (INPROC_URL_HEAD_SIZE + BROKER_GUID_SIZE +1)
 
+/* a frame is the source module handle, the publish time when latencies are measured, then the message */
+#ifdef BROKER_LATENCY_STATS_ENABLED
+#define BROKER_FRAME_HEADER_SIZE (sizeof(MODULE_HANDLE) + sizeof(uint64_t))
+#else
+#define BROKER_FRAME_HEADER_SIZE sizeof(MODULE_HANDLE)
+#endif
+
+/* tells the core a spin-wait loop is running, so it can back off and let a sibling hyperthread run */
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define BROKER_CPU_RELAX() _mm_pause()
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+#define BROKER_CPU_RELAX() __builtin_ia32_pause()
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__aarch64__) || defined(__arm__))
+#define BROKER_CPU_RELAX() __asm__ __volatile__("yield")
+#else
+#define BROKER_CPU_RELAX() ((void)0)
+#endif
+
 /*The structure backing the message broker handle*/
 typedef struct BROKER_HANDLE_DATA_TAG
 {
@@ -35,14 +72,146 @@ typedef struct BROKER_HANDLE_DATA_TAG
     LOCK_HANDLE             modules_lock;
     int                     publish_socket;
     STRING_HANDLE           url;
+    /** Requests waiting for a reply, created by the first Broker_Request */
+    struct BROKER_REQUESTS_TAG* requests;
+    /** Number of fused links, so that Broker_Publish only looks up the
+     *  source module when there is one
+     */
+    size_t                  fused_link_count;
 }BROKER_HANDLE_DATA;
 
 DEFINE_REFCOUNT_TYPE(BROKER_HANDLE_DATA);
 
+/** A message waiting to be delivered by one of a module's delivery threads */
+typedef struct BROKER_DELIVERY_TAG
+{
+    MESSAGE_HANDLE message;
+    /** Size of the serialized message, for the receive probes */
+    size_t size;
+    /** Conflation key of the message, or NULL if it is never replaced */
+    char* key;
+    size_t key_size;
+    size_t key_hash;
+    struct BROKER_DELIVERY_TAG* next;
+    /** Next delivery in the same bucket of the lane's conflation index */
+    struct BROKER_DELIVERY_TAG* index_next;
+} BROKER_DELIVERY;
+
+/** Most buckets in the conflation index of a lane */
+#define BROKER_CONFLATE_INDEX_MAX 4096
+
+/** A queue of messages that one or more delivery threads take turns on */
+typedef struct BROKER_DELIVERY_LANE_TAG
+{
+    COND_HANDLE      condition;
+    BROKER_DELIVERY* head;
+    BROKER_DELIVERY* tail;
+    size_t           count;
+    /** The deliveries with a conflation key, by the hash of the key. NULL
+     *  unless the module conflates its messages.
+     */
+    BROKER_DELIVERY** index;
+    size_t           index_size;
+} BROKER_DELIVERY_LANE;
+
+typedef struct BROKER_DELIVERY_THREAD_TAG
+{
+    struct BROKER_MODULEINFO_TAG* module_info;
+    BROKER_DELIVERY_LANE* lane;
+    /** Slot of the thread in the module's watchdog */
+    size_t index;
+    THREAD_HANDLE thread;
+} BROKER_DELIVERY_THREAD;
+
+/** A link whose sink's Module_Receive is called by Broker_Publish on the
+ *  publishing thread. Broker_Publish holds a reference on it while it
+ *  delivers, so a removed link lives until that delivery returns.
+ */
+typedef struct BROKER_FUSED_LINK_TAG
+{
+    /** Receive function and handle of the sink */
+    MODULE_DISPATCH sink;
+    /** Held across each delivery, so that the sink receives one message at
+     *  a time and removing the link waits for the delivery in progress
+     */
+    LOCK_HANDLE     lock;
+    /** Set when the link is removed; deliveries that start later are dropped */
+    bool            removed;
+    /** Modules at both ends of the link while it is attached, protected by
+     *  modules_lock
+     */
+    struct BROKER_MODULEINFO_TAG* source_info;
+    struct BROKER_MODULEINFO_TAG* sink_info;
+#ifdef MODULE_ALLOC_STATS_ENABLED
+    /** Allocation tag of the sink, set on the publishing thread while the
+     *  sink receives
+     */
+    MODULE_ALLOC_TAG alloc_tag;
+#endif
+} BROKER_FUSED_LINK;
+
+DEFINE_REFCOUNT_TYPE(BROKER_FUSED_LINK);
+
+/** The receive in progress on one of a watched module's receiving threads */
+typedef struct BROKER_RECEIVE_WATCH_TAG
+{
+    bool receiving;
+    tickcounter_ms_t started_ms;
+    /** Set once the watchdog has reported the receive as stalled */
+    bool stalled;
+} BROKER_RECEIVE_WATCH;
+
+/** Times the receives of a module added with a stall_ms. A timer on the
+ *  gateway timer service checks them every half stall_ms, so a stall is
+ *  reported between stall_ms and one and a half stall_ms after it started.
+ */
+typedef struct BROKER_WATCHDOG_TAG
+{
+    /** Lock protecting watches and stats */
+    LOCK_HANDLE lock;
+    TICK_COUNTER_HANDLE tick_counter;
+    GATEWAY_TIMER_HANDLE timer;
+    unsigned int stall_ms;
+    BROKER_STALL_POLICY policy;
+    /** Name of the module, or NULL */
+    char* name;
+    /** One watch for the worker thread, or one per delivery thread */
+    BROKER_RECEIVE_WATCH* watches;
+    size_t watch_count;
+    BROKER_STALL_STATS stats;
+} BROKER_WATCHDOG;
+
+/** Lets a module take over from the module it replaces. The replaced
+ *  module's quit frame is the handoff: the replaced module delivers the
+ *  frames published before it, and the replacement the frames after it.
+ */
+typedef struct BROKER_HANDOFF_TAG
+{
+    /** Copy of the replaced module's quit_message_guid */
+    STRING_HANDLE guid;
+    /** Module being replaced, protected by modules_lock; NULL once either
+     *  module is removed
+     */
+    struct BROKER_MODULEINFO_TAG* replaced;
+    /** Lock protecting released */
+    LOCK_HANDLE lock;
+    COND_HANDLE condition;
+    /** Set once the replaced module has stopped, or the replacement is removed */
+    bool released;
+    /** Set on the replacement's worker thread once it has received the
+     *  handoff frame
+     */
+    bool taken_over;
+} BROKER_HANDOFF;
+
 typedef struct BROKER_MODULEINFO_TAG
 {
     /** Handle to the module that's associated with the broker */
     MODULE*         module;
+    /** Receive function and handle of the module, resolved once when the
+     *  module is added so delivery does not go through its MODULE_API
+     */
+    MODULE_DISPATCH dispatch;
     /** Handle to the thread on which this module's message processing loop is
      *  running
      */
@@ -53,9 +222,124 @@ typedef struct BROKER_MODULEINFO_TAG
     LOCK_HANDLE     socket_lock;
     /** Guid sent to module worker thread to close task */
     STRING_HANDLE   quit_message_guid;
+    /** Number of threads calling the module's Module_Receive; when it is
+     *  above 1 the worker thread only receives messages and hands them to
+     *  delivery_threads through lanes
+     */
+    size_t          concurrency;
+    /** Property that selects the lane of a message, or NULL when all
+     *  delivery threads share a single lane
+     */
+    STRING_HANDLE   order_by;
+    /** Whether a message replaces the message waiting on its lane that has
+     *  the same key. conflate_by holds the names of the properties making up
+     *  that key, each followed by a '\0', or is NULL for a single key.
+     */
+    bool            conflate;
+    char*           conflate_by;
+    size_t          conflate_by_count;
+    BROKER_DELIVERY_LANE* lanes;
+    size_t          lane_count;
+    BROKER_DELIVERY_THREAD* delivery_threads;
+    /** Lock protecting lanes, lanes_stopping and dropped */
+    LOCK_HANDLE     lanes_lock;
+    bool            lanes_stopping;
+    /** Most messages that may wait on a lane */
+    size_t          max_queued;
+    /** Messages dropped because their lane was full, and whether the last
+     *  message was, so that an overrun is logged once
+     */
+    uint64_t        dropped;
+    bool            dropping;
+    /** Non-blocking polls, with a pause and then with a yield between them,
+     *  that module_worker makes before it blocks in nn_recv
+     */
+    size_t          spin_count;
+    size_t          yield_count;
+    /** Broker the module was added to, for the worker to complete requests */
+    BROKER_HANDLE_DATA* broker;
+    /** Whether receive_socket is subscribed to BROKER_REQUEST_TOPIC and
+     *  BROKER_REPLY_TOPIC, which happens on the first request to and from
+     *  the module
+     */
+    bool            request_subscribed;
+    bool            reply_subscribed;
+    /** Fused link the module publishes on and fused link it receives on,
+     *  or NULL
+     */
+    BROKER_FUSED_LINK* fused_out;
+    BROKER_FUSED_LINK* fused_in;
+    /** Number of links from the module that go through publish_socket; a
+     *  message only a fused link receives is not serialized
+     */
+    size_t          out_link_count;
+    /** Watchdog timing the module's receives, or NULL if it was added
+     *  without a stall_ms
+     */
+    BROKER_WATCHDOG* watchdog;
+    /** Set on the worker thread when a stalled receive returns and the
+     *  module sheds, until the messages that waited for it are dropped
+     */
+    bool            shedding;
+    /** Handoff from the module this one replaces, or NULL */
+    BROKER_HANDOFF* handoff;
+    /** Module replacing this one, protected by modules_lock, or NULL */
+    struct BROKER_MODULEINFO_TAG* successor;
+#ifdef BROKER_LATENCY_STATS_ENABLED
+    BROKER_LATENCY_HISTOGRAM latency;
+#endif
+#ifdef MODULE_ALLOC_STATS_ENABLED
+    /** Allocation tag of the module, set on the worker thread */
+    MODULE_ALLOC_TAG alloc_tag;
+#endif
 
 }BROKER_MODULEINFO;
 
+/* Requests and replies go to a single module rather than to the modules
+ * linked from the sender, so their frames start with a topic derived from
+ * the receiving module's BROKER_MODULEINFO address. No MODULE_HANDLE, which
+ * topics of published messages start with, can point at or into it.
+ */
+#define BROKER_REQUEST_TOPIC(module_info) ((void*)(module_info))
+#define BROKER_REPLY_TOPIC(module_info) ((void*)((unsigned char*)(module_info) + 1))
+
+/* Pending requests are found by id through BROKER_REQUEST_BUCKETS buckets and
+ * each expires on a one-shot timer of the gateway timer service, so adding,
+ * answering and expiring a request cost the same however many requests are
+ * in flight, and no broker thread wakes up while none are.
+ */
+#define BROKER_REQUEST_BUCKETS 1024
+
+struct BROKER_REQUESTS_TAG;
+
+typedef struct BROKER_REQUEST_TAG
+{
+    uint64_t id;
+    struct BROKER_REQUESTS_TAG* requests;
+    /** Module the reply is delivered to */
+    BROKER_MODULEINFO* requester;
+    BROKER_REPLY_CALLBACK callback;
+    void* context;
+    /** Expires the request; cancelled, outside the requests lock, before the
+     *  request is freed
+     */
+    GATEWAY_TIMER_HANDLE timer;
+    /** false once a reply or a timeout is on its way to the requester */
+    bool armed;
+    struct BROKER_REQUEST_TAG* bucket_next;
+} BROKER_REQUEST;
+
+typedef struct BROKER_REQUESTS_TAG
+{
+    /** Lock protecting every other member and the requests; taken after
+     *  modules_lock
+     */
+    LOCK_HANDLE lock;
+    int publish_socket;
+    uint64_t next_id;
+    BROKER_REQUEST* buckets[BROKER_REQUEST_BUCKETS];
+} BROKER_REQUESTS;
+
 static STRING_HANDLE construct_url()
 {
     STRING_HANDLE result;
@@ -103,6 +387,8 @@ BROKER_HANDLE Broker_Create(void)
     }
     else
     {
+        result->requests = NULL;
+        result->fused_link_count = 0;
         /*Codes_SRS_BROKER_13_007: [Broker_Create shall initialize BROKER_HANDLE_DATA::modules with a valid VECTOR_HANDLE.]*/
         result->modules = singlylinkedlist_create();
         if (result->modules == NULL)
@@ -188,679 +474,2938 @@ void Broker_IncRef(BROKER_HANDLE broker)
     }
 }
 
-/**
-* This function runs for each module. It receives a pointer to a MODULE_INFO
-* object that describes the module. Its job is to call the Receive function on
-* the associated module whenever it receives a message.
-*/
-static int module_worker(void * user_data)
+#ifdef BROKER_LATENCY_STATS_ENABLED
+static uint64_t get_time_ns(void)
 {
-    /*Codes_SRS_BROKER_13_026: [This function shall assign `user_data` to a local variable called `module_info` of type `BROKER_MODULEINFO*`.]*/
-    BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)user_data;
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    (void)QueryPerformanceCounter(&counter);
+    (void)QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)counter.QuadPart * 1000000000.0 / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
 
-    int should_continue = 1;
-    while (should_continue)
+static void record_latency(BROKER_LATENCY_HISTOGRAM* histogram, uint64_t published_ns)
+{
+    uint64_t now_ns = get_time_ns();
+    uint64_t latency_ns = (now_ns > published_ns) ? now_ns - published_ns : 0;
+    size_t bucket = 0;
+    while (bucket < BROKER_LATENCY_BUCKETS - 1 && (latency_ns >> (bucket + 1)) != 0)
     {
-        /*Codes_SRS_BROKER_13_089: [ This function shall acquire the lock on module_info->socket_lock. ]*/
-        if (Lock(module_info->socket_lock))
-        {
-            /*Codes_SRS_BROKER_02_004: [ If acquiring the lock fails, then module_worker shall return. ]*/
-            LogError("unable to Lock");
-            should_continue = 0;
-            break;
-        }
-        int nn_fd = module_info->receive_socket;
-        int nbytes;
-        unsigned char *buf = NULL;
+        bucket++;
+    }
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->total_ns += latency_ns;
+    if (latency_ns > histogram->max_ns)
+    {
+        histogram->max_ns = latency_ns;
+    }
+}
+#endif
 
-        /*Codes_SRS_BROKER_17_005: [ For every iteration of the loop, the function shall wait on the receive_socket for messages. ]*/
-        nbytes = nn_recv(nn_fd, (void *)&buf, NN_MSG, 0);
-        /*Codes_SRS_BROKER_13_091: [ The function shall unlock module_info->socket_lock. ]*/
-        if (Unlock(module_info->socket_lock) != LOCK_OK)
-        {
-            /*Codes_SRS_BROKER_17_016: [ If releasing the lock fails, then module_worker shall return. ]*/
-            should_continue = 0;
-            if (nbytes > 0)
-            {
-                /*Codes_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]*/
-                nn_freemsg(buf);
-            }
-            break;
-        }
+#define WATCHDOG_NAME(watchdog) (((watchdog)->name == NULL) ? "" : (watchdog)->name)
 
-        if (nbytes < 0)
-        {
-            /*Codes_SRS_BROKER_17_006: [ An error on receiving a message shall terminate the loop. ]*/
-            should_continue = 0;
-        }
-        else
+/*timer callback reporting, once each, the receives that have run longer than stall_ms*/
+static bool check_receives(void* context)
+{
+    BROKER_WATCHDOG* watchdog = (BROKER_WATCHDOG*)context;
+    tickcounter_ms_t now_ms;
+    if (Lock(watchdog->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the watchdog of module [%s]", WATCHDOG_NAME(watchdog));
+    }
+    else
+    {
+        if (tickcounter_get_current_ms(watchdog->tick_counter, &now_ms) == 0)
         {
-            if (nbytes == BROKER_GUID_SIZE &&
-                (strncmp(STRING_c_str(module_info->quit_message_guid), (const char *)buf, BROKER_GUID_SIZE-1)==0))
-            {
-                /*Codes_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_message_guid is sent to the thread. ]*/
-                /* received special quit message for this module */
-                should_continue = 0;
-            }
-            else
+            size_t i;
+            for (i = 0; i < watchdog->watch_count; i++)
             {
-                /*Codes_SRS_BROKER_17_024: [ The function shall strip off the topic from the message. ]*/
-                const unsigned char*buf_bytes = (const unsigned char*)buf;
-                buf_bytes += sizeof(MODULE_HANDLE);
-                /*Codes_SRS_BROKER_17_017: [ The function shall deserialize the message received. ]*/
-                MESSAGE_HANDLE msg = Message_CreateFromByteArray(buf_bytes, nbytes - sizeof(MODULE_HANDLE));
-                /*Codes_SRS_BROKER_17_018: [ If the deserialization is not successful, the message loop shall continue. ]*/
-                if (msg != NULL)
+                BROKER_RECEIVE_WATCH* watch = &watchdog->watches[i];
+                /*Codes_SRS_BROKER_26_043: [ When a receive of a watched module has run for `stall_ms` or longer, the watchdog shall log it once, with the module's name, and count it as a stall. ]*/
+                if (watch->receiving && !watch->stalled && now_ms - watch->started_ms >= watchdog->stall_ms)
                 {
-                    /*Codes_SRS_BROKER_13_092: [The function shall deliver the message to the module's callback function via module_info->module_apis. ]*/
-                    MODULE_RECEIVE(module_info->module->module_apis)(module_info->module->module_handle, msg);
-                    /*Codes_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]*/
-                    Message_Destroy(msg);
+                    watch->stalled = true;
+                    watchdog->stats.stalls++;
+                    watchdog->stats.stalled++;
+                    LogError("module [%s] has been in Module_Receive for %lu ms, longer than its stall_ms of %u ms",
+                        WATCHDOG_NAME(watchdog), (unsigned long)(now_ms - watch->started_ms), watchdog->stall_ms);
                 }
             }
-            /*Codes_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]*/
-            nn_freemsg(buf);
-        }    
+        }
+        (void)Unlock(watchdog->lock);
     }
-
-    return 0;
+    return true;
 }
 
-static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* module)
+static void watch_receive_start(BROKER_WATCHDOG* watchdog, size_t index)
 {
-    BROKER_RESULT result;
-
-    /*Codes_SRS_BROKER_13_107: The function shall assign the `module` handle to `BROKER_MODULEINFO::module`.*/
-    module_info->module = (MODULE*)malloc(sizeof(MODULE));
-    if (module_info->module == NULL)
+    if (Lock(watchdog->lock) == LOCK_OK)
     {
-        LogError("Allocate module failed");
-        result = BROKER_ERROR;
+        BROKER_RECEIVE_WATCH* watch = &watchdog->watches[index];
+        watch->receiving = (tickcounter_get_current_ms(watchdog->tick_counter, &watch->started_ms) == 0);
+        watch->stalled = false;
+        (void)Unlock(watchdog->lock);
     }
-    else
-    {
-        module_info->module->module_apis = module->module_apis;
-        module_info->module->module_handle = module->module_handle;
+}
 
-        /*Codes_SRS_BROKER_13_099: [The function shall initialize BROKER_MODULEINFO::socket_lock with a valid lock handle.]*/
-        module_info->socket_lock = Lock_Init();
-        if (module_info->socket_lock == NULL)
-        {
-            /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-            LogError("Lock_Init for socket lock failed");
-            result = BROKER_ERROR;
-        }
-        else
+/*returns whether the receive had been reported as stalled*/
+static bool watch_receive_end(BROKER_WATCHDOG* watchdog, size_t index)
+{
+    bool result = false;
+    if (Lock(watchdog->lock) == LOCK_OK)
+    {
+        BROKER_RECEIVE_WATCH* watch = &watchdog->watches[index];
+        tickcounter_ms_t now_ms;
+        if (watch->stalled && tickcounter_get_current_ms(watchdog->tick_counter, &now_ms) == 0)
         {
-            char uuid[BROKER_GUID_SIZE];
-            memset(uuid, 0, BROKER_GUID_SIZE);
-            /*Codes_SRS_BROKER_17_020: [ The function shall create a unique ID used as a quit signal. ]*/
-            if (UniqueId_Generate(uuid, BROKER_GUID_SIZE) != UNIQUEID_OK)
-            {
-                /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-                LogError("Lock_Init for socket lock failed");
-                Lock_Deinit(module_info->socket_lock);
-                result = BROKER_ERROR;
-            }
-            else
+            uint64_t stalled_ms = (uint64_t)(now_ms - watch->started_ms);
+            if (stalled_ms > watchdog->stats.longest_ms)
             {
-                module_info->quit_message_guid = STRING_construct(uuid);
-                if (module_info->quit_message_guid == NULL)
-                {
-                    /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-                    LogError("String construct failed for module guid");
-                    Lock_Deinit(module_info->socket_lock);
-                    result = BROKER_ERROR;
-                }
-                else
-                {
-                    result = BROKER_OK;
-                }
+                watchdog->stats.longest_ms = stalled_ms;
             }
+            LogInfo("module [%s] returned from Module_Receive after %lu ms", WATCHDOG_NAME(watchdog), (unsigned long)stalled_ms);
+        }
+        if (watch->stalled)
+        {
+            watchdog->stats.stalled--;
         }
+        result = watch->stalled;
+        watch->receiving = false;
+        watch->stalled = false;
+        (void)Unlock(watchdog->lock);
     }
     return result;
 }
 
-static void deinit_module(BROKER_MODULEINFO* module_info)
+/*counts a message dropped by BROKER_STALL_SHED; returns whether a message to the module is shed now*/
+static bool shed_message(BROKER_WATCHDOG* watchdog, bool shedding)
 {
-    /*Codes_SRS_BROKER_13_057: [The function shall free all members of the MODULE_INFO object.]*/
-    Lock_Deinit(module_info->socket_lock);
-    STRING_delete(module_info->quit_message_guid);
-    free(module_info->module);
+    bool result = false;
+    if (Lock(watchdog->lock) == LOCK_OK)
+    {
+        result = shedding || (watchdog->policy == BROKER_STALL_SHED && watchdog->stats.stalled > 0);
+        if (result)
+        {
+            watchdog->stats.shed++;
+        }
+        (void)Unlock(watchdog->lock);
+    }
+    return result;
 }
 
-static BROKER_RESULT start_module(BROKER_MODULEINFO* module_info, STRING_HANDLE url)
+/**
+* Waits for the next frame on the module's receive socket. A module with a
+* spin_count or yield_count polls the socket that many times before it blocks,
+* so a message published while it polls does not pay for a thread wakeup.
+*/
+static int receive_frame(BROKER_MODULEINFO* module_info, int nn_fd, unsigned char** buf)
 {
-    BROKER_RESULT result;
+    int nbytes = -1;
+    bool would_block = true;
+    size_t i;
 
-    /* Connect to pub/sub */
-    /*Codes_SRS_BROKER_17_013: [ The function shall create a nanomsg socket for reception. ]*/
-    module_info->receive_socket = nn_socket(AF_SP, NN_SUB);
-    if (module_info->receive_socket < 0)
+    if (module_info->shedding)
     {
-        /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-        LogError("module receive socket create failed");
-        result = BROKER_ERROR;
+        /*Codes_SRS_BROKER_26_046: [ While the module sheds, the function shall poll the receive_socket without blocking, and stop shedding once no frame is waiting. ]*/
+        nbytes = nn_recv(nn_fd, (void *)buf, NN_MSG, NN_DONTWAIT);
+        would_block = (nbytes < 0 && nn_errno() == EAGAIN);
+        if (would_block)
+        {
+            module_info->shedding = false;
+        }
     }
-    else
+
+    /*Codes_SRS_BROKER_26_011: [ If the module was added with a `spin_count`, the function shall first poll the receive_socket without blocking up to `spin_count` times, pausing the CPU between polls. ]*/
+    for (i = 0; would_block && i < module_info->spin_count; i++)
     {
-        /*Codes_SRS_BROKER_17_014: [ The function shall bind the socket to the the BROKER_HANDLE_DATA::url. ]*/
-        int connect_result = nn_connect(module_info->receive_socket, STRING_c_str(url));
-        if (connect_result < 0)
+        nbytes = nn_recv(nn_fd, (void *)buf, NN_MSG, NN_DONTWAIT);
+        would_block = (nbytes < 0 && nn_errno() == EAGAIN);
+        if (would_block)
         {
-            /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-            LogError("nn_connect failed");
-            nn_close(module_info->receive_socket);
-            module_info->receive_socket = -1;
-            result = BROKER_ERROR;
+            BROKER_CPU_RELAX();
         }
-        else
+    }
+
+    /*Codes_SRS_BROKER_26_012: [ If no message was received, and the module was added with a `yield_count`, the function shall then poll the receive_socket without blocking up to `yield_count` times, yielding the thread between polls. ]*/
+    for (i = 0; would_block && i < module_info->yield_count; i++)
+    {
+        nbytes = nn_recv(nn_fd, (void *)buf, NN_MSG, NN_DONTWAIT);
+        would_block = (nbytes < 0 && nn_errno() == EAGAIN);
+        if (would_block)
         {
-            /* Codes_SRS_BROKER_17_028: [ The function shall subscribe BROKER_MODULEINFO::receive_socket to the quit signal GUID. ]*/
-            if (nn_setsockopt(
-                module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, STRING_c_str(module_info->quit_message_guid), STRING_length(module_info->quit_message_guid)) < 0)
-            {
-                /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-                LogError("nn_setsockopt failed");
-                nn_close(module_info->receive_socket);
-                module_info->receive_socket = -1;
-                result = BROKER_ERROR;
-            }
-            else
-            {
-                /*Codes_SRS_BROKER_13_102: [The function shall create a new thread for the module by calling ThreadAPI_Create using module_worker as the thread callback and using the newly allocated BROKER_MODULEINFO object as the thread context.*/
-                if (ThreadAPI_Create(
-                    &(module_info->thread),
-                    module_worker,
-                    (void*)module_info
-                ) != THREADAPI_OK)
-                {
-                    /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-                    LogError("ThreadAPI_Create failed");
-                    nn_close(module_info->receive_socket);
-                    result = BROKER_ERROR;
-                }
-                else
-                {
-                    result = BROKER_OK;
-                }
-            }
+            ThreadAPI_Sleep(0);
         }
     }
 
-    return result;
+    if (would_block)
+    {
+        /*Codes_SRS_BROKER_26_013: [ If no message was received, the function shall block on the receive_socket. ]*/
+        nbytes = nn_recv(nn_fd, (void *)buf, NN_MSG, 0);
+    }
+    return nbytes;
 }
 
-/*stop module means: stop the thread that feeds messages to Module_Receive function + deletion of all queued messages */
-/*returns 0 if success, otherwise __LINE__*/
-static int stop_module(int publish_socket, BROKER_MODULEINFO* module_info)
-{
-    int  quit_result, close_result, thread_result, result;
+/*enough for any int64_t and a double with 17 significant digits*/
+#define BROKER_PROPERTY_VALUE_SIZE 32
 
-    /*Codes_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending BROKER_MODULEINFO::quit_message_guid to the publish_socket. ]*/
-    /* send the unique quite id for this module */
-    if ((quit_result = nn_send(publish_socket, STRING_c_str(module_info->quit_message_guid), BROKER_GUID_SIZE, 0)) < 0)
+/*gets the value of a property of msg: a string property, or a typed
+property rendered as Message_GetProperties renders it, so that a value has
+the same lane and conflation key whether it was published as a string or as
+a number. A byte array property is used as is. Returns non-zero if msg has no
+such property.*/
+static int get_property_value(MESSAGE_HANDLE msg, const char* name, char buffer[BROKER_PROPERTY_VALUE_SIZE], const unsigned char** value, size_t* size)
+{
+    int result;
+    const char* text = Message_GetProperty(msg, name);
+    int64_t int64_value;
+    double double_value;
+    if (text != NULL)
     {
-        /*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
-        /* at the cost of a data race, we will close the socket to terminate the thread */
-        nn_close(module_info->receive_socket);
-        LogError("unable to peacefully close thread for module [%p], nn_send error [%d], taking harsher methods", module_info, quit_result);
+        *value = (const unsigned char*)text;
+        *size = strlen(text);
+        result = 0;
+    }
+    else if (Message_GetPropertyInt64(msg, name, &int64_value) == 0)
+    {
+        *value = (const unsigned char*)buffer;
+        *size = (size_t)snprintf(buffer, BROKER_PROPERTY_VALUE_SIZE, "%" PRId64, int64_value);
+        result = 0;
+    }
+    else if (Message_GetPropertyDouble(msg, name, &double_value) == 0)
+    {
+        *value = (const unsigned char*)buffer;
+        *size = (size_t)snprintf(buffer, BROKER_PROPERTY_VALUE_SIZE, "%.17g", double_value);
+        result = 0;
+    }
+    else if (Message_GetPropertyBytes(msg, name, value, size) == 0)
+    {
+        result = 0;
     }
     else
     {
-        /*Codes_SRS_BROKER_02_001: [ Broker_RemoveModule shall lock BROKER_MODULEINFO::socket_lock. ]*/
-        if (Lock(module_info->socket_lock) != LOCK_OK)
-        {
-            /*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
+        result = __LINE__;
+    }
+    return result;
+}
+
+/*FNV-1a, so that a property value always maps to the same lane*/
+static size_t hash_property(const unsigned char* value, size_t size)
+{
+    size_t hash = 2166136261u;
+    size_t i;
+    for (i = 0; i < size; i++)
+    {
+        hash = (hash ^ value[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static BROKER_DELIVERY_LANE* select_lane(BROKER_MODULEINFO* module_info, MESSAGE_HANDLE msg)
+{
+    BROKER_DELIVERY_LANE* result;
+    if (module_info->lane_count == 1)
+    {
+        result = &module_info->lanes[0];
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_26_008: [ If the module was added with an `order_by` property, the lane shall be chosen from the value of that property so that messages with the same value are delivered in order; messages without the property shall use the first lane. ]*/
+        /*Codes_SRS_BROKER_26_069: [ The `order_by` and `conflate_by` properties may be string or typed properties; a number shall select the same lane and key as the same number set as a string. ]*/
+        char buffer[BROKER_PROPERTY_VALUE_SIZE];
+        const unsigned char* value;
+        size_t size;
+        result = (get_property_value(msg, STRING_c_str(module_info->order_by), buffer, &value, &size) != 0) ?
+            &module_info->lanes[0] :
+            &module_info->lanes[hash_property(value, size) % module_info->lane_count];
+    }
+    return result;
+}
+
+/*builds the conflation key of msg: the size and bytes of the value of each
+of the conflate_by properties. Returns 0 and sets *key to NULL if msg lacks
+one of the properties.*/
+static int get_conflation_key(BROKER_MODULEINFO* module_info, MESSAGE_HANDLE msg, char** key, size_t* key_size)
+{
+    int result;
+    char buffer[BROKER_PROPERTY_VALUE_SIZE];
+    const unsigned char* value;
+    size_t size;
+    const char* name = module_info->conflate_by;
+    size_t i;
+    *key_size = 0;
+    for (i = 0; i < module_info->conflate_by_count; i++)
+    {
+        if (get_property_value(msg, name, buffer, &value, &size) != 0)
+        {
+            break;
+        }
+        *key_size += sizeof(size_t) + size;
+        name += strlen(name) + 1;
+    }
+
+    if (i < module_info->conflate_by_count)
+    {
+        /*Codes_SRS_BROKER_26_035: [ A message that lacks one of the `conflate_by` properties shall be queued without replacing any message. ]*/
+        *key = NULL;
+        result = 0;
+    }
+    else if ((*key = (char*)malloc(*key_size + 1)) == NULL)
+    {
+        LogError("unable to allocate the conflation key of a message for module [%p]", module_info->dispatch.module_handle);
+        result = __LINE__;
+    }
+    else
+    {
+        char* next = *key;
+        name = module_info->conflate_by;
+        for (i = 0; i < module_info->conflate_by_count; i++)
+        {
+            (void)get_property_value(msg, name, buffer, &value, &size);
+            (void)memcpy(next, &size, sizeof(size_t));
+            next += sizeof(size_t);
+            (void)memcpy(next, value, size);
+            next += size;
+            name += strlen(name) + 1;
+        }
+        result = 0;
+    }
+    return result;
+}
+
+/*returns the delivery waiting on lane with the given key, or NULL if there is none*/
+static BROKER_DELIVERY* find_conflated_delivery(BROKER_DELIVERY_LANE* lane, const char* key, size_t key_size, size_t key_hash)
+{
+    BROKER_DELIVERY* result = lane->index[key_hash % lane->index_size];
+    while (result != NULL &&
+        (result->key_hash != key_hash || result->key_size != key_size || memcmp(result->key, key, key_size) != 0))
+    {
+        result = result->index_next;
+    }
+    return result;
+}
+
+/*removes a delivery that is leaving its lane from the lane's conflation index*/
+static void unindex_delivery(BROKER_DELIVERY_LANE* lane, BROKER_DELIVERY* delivery)
+{
+    BROKER_DELIVERY** link = &lane->index[delivery->key_hash % lane->index_size];
+    while (*link != delivery)
+    {
+        link = &(*link)->index_next;
+    }
+    *link = delivery->index_next;
+}
+
+/*takes ownership of msg*/
+static void queue_delivery(BROKER_MODULEINFO* module_info, MESSAGE_HANDLE msg, size_t size)
+{
+    BROKER_DELIVERY_LANE* lane = select_lane(module_info, msg);
+    char* key = NULL;
+    size_t key_size = 0;
+    BROKER_DELIVERY* delivery;
+    if (module_info->watchdog != NULL && shed_message(module_info->watchdog, false))
+    {
+        /*Codes_SRS_BROKER_26_047: [ While a delivery thread of a module added with `BROKER_STALL_SHED` is stalled, the function shall destroy the messages to the module instead of queuing them. ]*/
+        Message_Destroy(msg);
+    }
+    else if ((delivery = (BROKER_DELIVERY*)malloc(sizeof(BROKER_DELIVERY))) == NULL)
+    {
+        /*Codes_SRS_BROKER_26_009: [ If queuing the message fails, the function shall destroy the message and continue. ]*/
+        LogError("unable to allocate a delivery for module [%p]", module_info->dispatch.module_handle);
+        Message_Destroy(msg);
+    }
+    else if (module_info->conflate && get_conflation_key(module_info, msg, &key, &key_size) != 0)
+    {
+        /*Codes_SRS_BROKER_26_009: [ If queuing the message fails, the function shall destroy the message and continue. ]*/
+        free(delivery);
+        Message_Destroy(msg);
+    }
+    else if (Lock(module_info->lanes_lock) != LOCK_OK)
+    {
+        /*Codes_SRS_BROKER_26_009: [ If queuing the message fails, the function shall destroy the message and continue. ]*/
+        LogError("unable to lock the delivery lanes of module [%p]", module_info->dispatch.module_handle);
+        free(key);
+        free(delivery);
+        Message_Destroy(msg);
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_26_071: [ The function shall find the message waiting with the same key through an index of the lane's messages by key, without scanning the lane. ]*/
+        size_t key_hash = (key == NULL) ? 0 : hash_property((const unsigned char*)key, key_size);
+        BROKER_DELIVERY* waiting = (key == NULL) ? NULL : find_conflated_delivery(lane, key, key_size, key_hash);
+        if (waiting != NULL)
+        {
+            /*Codes_SRS_BROKER_26_034: [ If the module was added with the `BROKER_QUEUE_CONFLATE` queue, a message shall replace the message with the same key waiting on its lane, keeping that message's place, and the replaced message shall be destroyed. ]*/
+            MESSAGE_HANDLE replaced = waiting->message;
+            waiting->message = msg;
+            waiting->size = size;
+            (void)Unlock(module_info->lanes_lock);
+            GATEWAY_PROBE2(module_conflate, module_info->dispatch.module_handle, replaced);
+            Message_Destroy(replaced);
+            free(key);
+            free(delivery);
+        }
+        else if (lane->count >= module_info->max_queued)
+        {
+            /*the worker takes every frame off the socket, so the socket's buffer no longer bounds what waits for a slow module*/
+            /*Codes_SRS_BROKER_26_065: [ If the message's lane already holds `max_queued` messages, the function shall destroy the message and count it as dropped, logging the first message dropped after one was queued. ]*/
+            bool log_drop = !module_info->dropping;
+            module_info->dropping = true;
+            module_info->dropped++;
+            (void)Unlock(module_info->lanes_lock);
+            if (log_drop)
+            {
+                LogError("a delivery lane of module [%p] is full (%lu messages), dropping messages until it drains",
+                    module_info->dispatch.module_handle, (unsigned long)module_info->max_queued);
+            }
+            Message_Destroy(msg);
+            free(key);
+            free(delivery);
+        }
+        else
+        {
+            module_info->dropping = false;
+            delivery->message = msg;
+            delivery->size = size;
+            delivery->key = key;
+            delivery->key_size = key_size;
+            delivery->key_hash = key_hash;
+            delivery->next = NULL;
+            if (key != NULL)
+            {
+                BROKER_DELIVERY** bucket = &lane->index[key_hash % lane->index_size];
+                delivery->index_next = *bucket;
+                *bucket = delivery;
+            }
+            if (lane->tail == NULL)
+            {
+                lane->head = delivery;
+            }
+            else
+            {
+                lane->tail->next = delivery;
+            }
+            lane->tail = delivery;
+            lane->count++;
+            (void)Condition_Post(lane->condition);
+            (void)Unlock(module_info->lanes_lock);
+        }
+    }
+}
+
+/*returns NULL once the lane is stopped and empty*/
+static BROKER_DELIVERY* get_next_delivery(BROKER_MODULEINFO* module_info, BROKER_DELIVERY_LANE* lane)
+{
+    BROKER_DELIVERY* result;
+    if (Lock(module_info->lanes_lock) != LOCK_OK)
+    {
+        LogError("unable to lock the delivery lanes of module [%p]", module_info->dispatch.module_handle);
+        result = NULL;
+    }
+    else
+    {
+        while (lane->head == NULL && !module_info->lanes_stopping)
+        {
+            (void)Condition_Wait(lane->condition, module_info->lanes_lock, 0);
+        }
+
+        result = lane->head;
+        if (result != NULL)
+        {
+            lane->count--;
+            lane->head = result->next;
+            if (result->key != NULL)
+            {
+                unindex_delivery(lane, result);
+            }
+            if (lane->head == NULL)
+            {
+                lane->tail = NULL;
+            }
+        }
+        (void)Unlock(module_info->lanes_lock);
+    }
+    return result;
+}
+
+/**
+* This function runs on each delivery thread of a module added with a
+* concurrency greater than 1. It delivers the messages module_worker queues
+* on its lane.
+*/
+static int delivery_worker(void* user_data)
+{
+    BROKER_DELIVERY_THREAD* delivery_thread = (BROKER_DELIVERY_THREAD*)user_data;
+    BROKER_MODULEINFO* module_info = delivery_thread->module_info;
+    BROKER_DELIVERY* delivery;
+
+#ifdef MODULE_ALLOC_STATS_ENABLED
+    (void)ModuleAlloc_SetThreadTag(module_info->alloc_tag);
+#endif
+
+    /*Codes_SRS_BROKER_26_010: [ Each delivery thread shall deliver the messages on its lane via module_info->dispatch and destroy them, until the module is removed and its lane is empty. ]*/
+    while ((delivery = get_next_delivery(module_info, delivery_thread->lane)) != NULL)
+    {
+        GATEWAY_PROBE3(module_receive_start, module_info->dispatch.module_handle, delivery->message, delivery->size);
+        if (module_info->watchdog != NULL)
+        {
+            /*Codes_SRS_BROKER_26_042: [ If the module was added with a `stall_ms`, each receiving thread shall record when it calls and returns from the module's Module_Receive. ]*/
+            watch_receive_start(module_info->watchdog, delivery_thread->index);
+            MODULE_DISPATCH_RECEIVE(module_info->dispatch, delivery->message);
+            (void)watch_receive_end(module_info->watchdog, delivery_thread->index);
+        }
+        else
+        {
+            MODULE_DISPATCH_RECEIVE(module_info->dispatch, delivery->message);
+        }
+        GATEWAY_PROBE2(module_receive_end, module_info->dispatch.module_handle, delivery->message);
+        Message_Destroy(delivery->message);
+        free(delivery->key);
+        free(delivery);
+    }
+
+    return 0;
+}
+
+/**
+* Sends a frame that starts with `topic`, followed by `id` and the serialized
+* `message` when they are not NULL. Requests carry a message, replies an id
+* and a message, and timeouts only an id.
+*/
+static int send_frame(int publish_socket, void* topic, const uint64_t* id, MESSAGE_HANDLE message)
+{
+    int result;
+    int32_t msg_size = (message == NULL) ? 0 : Message_ToTypedByteArray(message, NULL, 0);
+    if (msg_size < 0)
+    {
+        LogError("unable to serialize a message [%p]", message);
+        result = __LINE__;
+    }
+    else
+    {
+        int32_t buf_size = (int32_t)BROKER_FRAME_HEADER_SIZE + ((id == NULL) ? 0 : (int32_t)sizeof(uint64_t)) + msg_size;
+        void* nn_msg = nn_allocmsg(buf_size, 0);
+        if (nn_msg == NULL)
+        {
+            LogError("unable to allocate a frame of %d bytes", (int)buf_size);
+            result = __LINE__;
+        }
+        else
+        {
+            unsigned char *nn_msg_bytes = (unsigned char *)nn_msg;
+            memcpy(nn_msg_bytes, &topic, sizeof(MODULE_HANDLE));
+#ifdef BROKER_LATENCY_STATS_ENABLED
+            uint64_t published_ns = get_time_ns();
+            memcpy(nn_msg_bytes + sizeof(MODULE_HANDLE), &published_ns, sizeof(uint64_t));
+#endif
+            nn_msg_bytes += BROKER_FRAME_HEADER_SIZE;
+            if (id != NULL)
+            {
+                memcpy(nn_msg_bytes, id, sizeof(uint64_t));
+                nn_msg_bytes += sizeof(uint64_t);
+            }
+            if (message != NULL)
+            {
+                (void)Message_ToTypedByteArray(message, nn_msg_bytes, msg_size);
+            }
+
+            if (nn_send(publish_socket, &nn_msg, NN_MSG, 0) != buf_size)
+            {
+                LogError("unable to send a frame of %d bytes", (int)buf_size);
+                nn_freemsg(nn_msg);
+                result = __LINE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+    }
+    return result;
+}
+
+/*returns the link in its bucket that points at the request `id`, or at NULL if there is none*/
+static BROKER_REQUEST** find_request(BROKER_REQUESTS* requests, uint64_t id)
+{
+    BROKER_REQUEST** link = &requests->buckets[id % BROKER_REQUEST_BUCKETS];
+    while (*link != NULL && (*link)->id != id)
+    {
+        link = &(*link)->bucket_next;
+    }
+    return link;
+}
+
+/*called by the gateway timer service when the request has been pending for its timeout*/
+static bool expire_request(void* context)
+{
+    BROKER_REQUEST* request = (BROKER_REQUEST*)context;
+    BROKER_REQUESTS* requests = request->requests;
+
+    /* the request cannot be freed before this returns, since its timer is cancelled first */
+    if (Lock(requests->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the pending requests");
+    }
+    else
+    {
+        if (request->armed)
+        {
+            /*Codes_SRS_BROKER_26_026: [ When a request has been pending for `timeout_ms`, its timer shall send its id to the requesting module, whose worker shall call the request's callback with BROKER_REQUEST_TIMEOUT. ]*/
+            /* the request stays in its bucket until the requester's worker takes it */
+            request->armed = false;
+            if (send_frame(requests->publish_socket, BROKER_REPLY_TOPIC(request->requester), &request->id, NULL) != 0)
+            {
+                LogError("unable to send the timeout of a request");
+            }
+        }
+        (void)Unlock(requests->lock);
+    }
+
+    return false;
+}
+
+/*cancels the timer of a request no longer in the pending requests and frees it; called without requests->lock held*/
+static void free_request(BROKER_REQUEST* request)
+{
+    if (request->timer != NULL)
+    {
+        /*Codes_SRS_BROKER_26_074: [ A request's timer shall be cancelled before the request is freed, without holding the lock of the pending requests. ]*/
+        GatewayTimer_Cancel(request->timer);
+    }
+    free(request);
+}
+
+static BROKER_REQUESTS* create_requests(int publish_socket)
+{
+    BROKER_REQUESTS* result = (BROKER_REQUESTS*)malloc(sizeof(BROKER_REQUESTS));
+    if (result == NULL)
+    {
+        LogError("unable to allocate the pending requests");
+    }
+    else
+    {
+        memset(result, 0, sizeof(BROKER_REQUESTS));
+        result->publish_socket = publish_socket;
+        result->next_id = 1;
+        result->lock = Lock_Init();
+        if (result->lock == NULL)
+        {
+            LogError("Lock_Init failed");
+            free(result);
+            result = NULL;
+        }
+        else if (GatewayTimer_Init() != 0)
+        {
+            LogError("unable to start the gateway timer service for the pending requests");
+            Lock_Deinit(result->lock);
+            free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+/*completes every pending request of `requester`, or every pending request if it is NULL, with BROKER_REQUEST_CANCELLED*/
+static void cancel_requests(BROKER_REQUESTS* requests, BROKER_MODULEINFO* requester)
+{
+    BROKER_REQUEST* cancelled = NULL;
+
+    if (Lock(requests->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the pending requests");
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < BROKER_REQUEST_BUCKETS; i++)
+        {
+            BROKER_REQUEST** link = &requests->buckets[i];
+            while (*link != NULL)
+            {
+                BROKER_REQUEST* request = *link;
+                if (requester == NULL || request->requester == requester)
+                {
+                    *link = request->bucket_next;
+                    request->armed = false;
+                    request->bucket_next = cancelled;
+                    cancelled = request;
+                }
+                else
+                {
+                    link = &request->bucket_next;
+                }
+            }
+        }
+        (void)Unlock(requests->lock);
+    }
+
+    while (cancelled != NULL)
+    {
+        BROKER_REQUEST* request = cancelled;
+        cancelled = request->bucket_next;
+        request->callback(request->context, BROKER_REQUEST_CANCELLED, NULL);
+        free_request(request);
+    }
+}
+
+static void destroy_requests(BROKER_REQUESTS* requests)
+{
+    cancel_requests(requests, NULL);
+    GatewayTimer_Deinit();
+    Lock_Deinit(requests->lock);
+    free(requests);
+}
+
+/**
+* Calls the callback of the request whose reply, or timeout, the module's
+* worker received: `payload` holds the request id, followed by the reply
+* unless the request timed out.
+*/
+static void complete_request(BROKER_MODULEINFO* module_info, const unsigned char* payload, int32_t size)
+{
+    BROKER_REQUESTS* requests = module_info->broker->requests;
+    BROKER_REQUEST* request = NULL;
+    uint64_t id;
+
+    memcpy(&id, payload, sizeof(uint64_t));
+    if (Lock(requests->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the pending requests");
+    }
+    else
+    {
+        BROKER_REQUEST** link = find_request(requests, id);
+        if (*link != NULL && (*link)->requester == module_info && !(*link)->armed)
+        {
+            request = *link;
+            *link = request->bucket_next;
+        }
+        (void)Unlock(requests->lock);
+    }
+
+    if (request == NULL)
+    {
+        LogError("dropping the reply to a request that is no longer pending");
+    }
+    else
+    {
+        if (size == (int32_t)sizeof(uint64_t))
+        {
+            request->callback(request->context, BROKER_REQUEST_TIMEOUT, NULL);
+        }
+        else
+        {
+            /*Codes_SRS_BROKER_26_024: [ When the requesting module's worker receives the reply, it shall deserialize it, call the request's callback with BROKER_REQUEST_REPLIED and the reply, and destroy the reply. ]*/
+            MESSAGE_HANDLE reply = Message_CreateFromByteArray(payload + sizeof(uint64_t), size - (int32_t)sizeof(uint64_t));
+            if (reply == NULL)
+            {
+                LogError("unable to deserialize the reply to a request");
+                request->callback(request->context, BROKER_REQUEST_ERROR, NULL);
+            }
+            else
+            {
+                request->callback(request->context, BROKER_REQUEST_REPLIED, reply);
+                Message_Destroy(reply);
+            }
+        }
+        free_request(request);
+    }
+}
+
+/**
+* This function runs for each module. It receives a pointer to a MODULE_INFO
+* object that describes the module. Its job is to call the Receive function on
+* the associated module whenever it receives a message.
+*/
+/* Drops the frames a replacement receives before the handoff, since the
+ * module it replaces delivers them. On the handoff frame it waits until that
+ * module has stopped, so that the frames after the handoff are delivered
+ * after every frame before it. Replies to the replacement are not dropped.
+ */
+static bool drop_before_handoff(BROKER_MODULEINFO* module_info, const unsigned char* buf, int nbytes)
+{
+    bool result;
+    BROKER_HANDOFF* handoff = module_info->handoff;
+    void* reply_topic = BROKER_REPLY_TOPIC(module_info);
+    if (handoff->taken_over ||
+        (nbytes >= (int)sizeof(MODULE_HANDLE) && memcmp(buf, &reply_topic, sizeof(MODULE_HANDLE)) == 0))
+    {
+        result = false;
+    }
+    else
+    {
+        if (nbytes == BROKER_GUID_SIZE &&
+            (strncmp(STRING_c_str(handoff->guid), (const char *)buf, BROKER_GUID_SIZE - 1) == 0))
+        {
+            if (Lock(handoff->lock) != LOCK_OK)
+            {
+                LogError("unable to wait for the replaced module to stop");
+            }
+            else
+            {
+                while (!handoff->released)
+                {
+                    (void)Condition_Wait(handoff->condition, handoff->lock, 0);
+                }
+                Unlock(handoff->lock);
+            }
+            handoff->taken_over = true;
+        }
+        result = true;
+    }
+    return result;
+}
+
+/* A frame of just a topic retires that topic: the module it came from was
+ * replaced, and the receiving module unsubscribes from it after the frames
+ * that module published before it.
+ */
+static void retire_topic(BROKER_MODULEINFO* module_info, const unsigned char* buf)
+{
+    if (Lock(module_info->socket_lock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+    }
+    else
+    {
+        if (nn_setsockopt(module_info->receive_socket, NN_SUB, NN_SUB_UNSUBSCRIBE, buf, sizeof(MODULE_HANDLE)) < 0)
+        {
+            LogError("unable to unsubscribe from a replaced module");
+        }
+        (void)Unlock(module_info->socket_lock);
+    }
+}
+
+static int module_worker(void * user_data)
+{
+    /*Codes_SRS_BROKER_13_026: [This function shall assign `user_data` to a local variable called `module_info` of type `BROKER_MODULEINFO*`.]*/
+    BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)user_data;
+
+#ifdef MODULE_ALLOC_STATS_ENABLED
+    /* everything allocated while delivering to this module is charged to it */
+    (void)ModuleAlloc_SetThreadTag(module_info->alloc_tag);
+#endif
+
+    int should_continue = 1;
+    while (should_continue)
+    {
+        /*Codes_SRS_BROKER_13_089: [ This function shall acquire the lock on module_info->socket_lock. ]*/
+        if (Lock(module_info->socket_lock))
+        {
+            /*Codes_SRS_BROKER_02_004: [ If acquiring the lock fails, then module_worker shall return. ]*/
+            LogError("unable to Lock");
+            should_continue = 0;
+            break;
+        }
+        int nn_fd = module_info->receive_socket;
+        int nbytes;
+        unsigned char *buf = NULL;
+
+        /*Codes_SRS_BROKER_17_005: [ For every iteration of the loop, the function shall wait on the receive_socket for messages. ]*/
+        nbytes = receive_frame(module_info, nn_fd, &buf);
+        /*Codes_SRS_BROKER_13_091: [ The function shall unlock module_info->socket_lock. ]*/
+        if (Unlock(module_info->socket_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_016: [ If releasing the lock fails, then module_worker shall return. ]*/
+            should_continue = 0;
+            if (nbytes > 0)
+            {
+                /*Codes_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]*/
+                nn_freemsg(buf);
+            }
+            break;
+        }
+
+        if (nbytes < 0)
+        {
+            /*Codes_SRS_BROKER_17_006: [ An error on receiving a message shall terminate the loop. ]*/
+            should_continue = 0;
+        }
+        else
+        {
+            if (nbytes == BROKER_GUID_SIZE &&
+                (strncmp(STRING_c_str(module_info->quit_message_guid), (const char *)buf, BROKER_GUID_SIZE-1)==0))
+            {
+                /*Codes_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_message_guid is sent to the thread. ]*/
+                /* received special quit message for this module */
+                should_continue = 0;
+            }
+            else if (module_info->handoff != NULL && drop_before_handoff(module_info, buf, nbytes))
+            {
+                /*Codes_SRS_BROKER_26_060: [ The worker of a module added with Broker_AddReplacementModule shall drop the frames it receives, other than replies to it, until it receives the replaced module's quit signal, then wait until the replaced module has stopped before it delivers the frames after it. ]*/
+            }
+            else if (nbytes == (int)BROKER_FRAME_HEADER_SIZE)
+            {
+                /*Codes_SRS_BROKER_26_062: [ When the worker receives a frame made of a topic only, it shall unsubscribe the module's receive_socket from that topic. ]*/
+                retire_topic(module_info, buf);
+            }
+            else
+            {
+                /* the subscriber socket does not expose its backlog, so dequeue reports a depth of -1 */
+                GATEWAY_PROBE3(module_dequeue, module_info->dispatch.module_handle, nbytes, -1);
+                /*Codes_SRS_BROKER_17_024: [ The function shall strip off the topic from the message. ]*/
+                const unsigned char*buf_bytes = (const unsigned char*)buf;
+#ifdef BROKER_LATENCY_STATS_ENABLED
+                uint64_t published_ns;
+                memcpy(&published_ns, buf_bytes + sizeof(MODULE_HANDLE), sizeof(uint64_t));
+                record_latency(&module_info->latency, published_ns);
+#endif
+                buf_bytes += BROKER_FRAME_HEADER_SIZE;
+                void* reply_topic = BROKER_REPLY_TOPIC(module_info);
+                if (nbytes >= (int)(BROKER_FRAME_HEADER_SIZE + sizeof(uint64_t)) && memcmp(buf, &reply_topic, sizeof(MODULE_HANDLE)) == 0)
+                {
+                    /*Codes_SRS_BROKER_26_025: [ If the frame starts with the module's reply topic, the function shall complete the request it answers instead of delivering it to the module. ]*/
+                    complete_request(module_info, buf_bytes, nbytes - (int)BROKER_FRAME_HEADER_SIZE);
+                }
+                else if (module_info->shedding && shed_message(module_info->watchdog, true))
+                {
+                    /*Codes_SRS_BROKER_26_045: [ While the module sheds, the function shall drop the frames it receives instead of delivering them, and count them as shed. ]*/
+                }
+                else
+                {
+                    /*Codes_SRS_BROKER_17_017: [ The function shall deserialize the message received. ]*/
+                    MESSAGE_HANDLE msg = Message_CreateFromByteArray(buf_bytes, nbytes - BROKER_FRAME_HEADER_SIZE);
+                    /*Codes_SRS_BROKER_17_018: [ If the deserialization is not successful, the message loop shall continue. ]*/
+                    if (msg != NULL)
+                    {
+                        if (module_info->lanes != NULL)
+                        {
+                            /*Codes_SRS_BROKER_26_007: [ If the module was added with a `concurrency` greater than 1, the function shall queue the message on a lane of the module's delivery threads instead of delivering it. ]*/
+                            queue_delivery(module_info, msg, nbytes - BROKER_FRAME_HEADER_SIZE);
+                        }
+                        else
+                        {
+                            /*Codes_SRS_BROKER_13_092: [The function shall deliver the message to the module's callback function via module_info->dispatch. ]*/
+                            GATEWAY_PROBE3(module_receive_start, module_info->dispatch.module_handle, msg, nbytes - BROKER_FRAME_HEADER_SIZE);
+                            if (module_info->watchdog != NULL)
+                            {
+                                /*Codes_SRS_BROKER_26_042: [ If the module was added with a `stall_ms`, each receiving thread shall record when it calls and returns from the module's Module_Receive. ]*/
+                                watch_receive_start(module_info->watchdog, 0);
+                                MODULE_DISPATCH_RECEIVE(module_info->dispatch, msg);
+                                /*Codes_SRS_BROKER_26_044: [ When a stalled receive returns and the module was added with `BROKER_STALL_SHED`, the function shall start shedding the messages that waited for the module during the stall. ]*/
+                                module_info->shedding = watch_receive_end(module_info->watchdog, 0) && module_info->watchdog->policy == BROKER_STALL_SHED;
+                            }
+                            else
+                            {
+                                MODULE_DISPATCH_RECEIVE(module_info->dispatch, msg);
+                            }
+                            GATEWAY_PROBE2(module_receive_end, module_info->dispatch.module_handle, msg);
+                            /*Codes_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]*/
+                            Message_Destroy(msg);
+                        }
+                    }
+                }
+            }
+            /*Codes_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]*/
+            nn_freemsg(buf);
+        }
+    }
+
+    return 0;
+}
+
+static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* module)
+{
+    BROKER_RESULT result;
+
+    /*Codes_SRS_BROKER_13_107: The function shall assign the `module` handle to `BROKER_MODULEINFO::module`.*/
+    module_info->module = (MODULE*)malloc(sizeof(MODULE));
+    if (module_info->module == NULL)
+    {
+        LogError("Allocate module failed");
+        result = BROKER_ERROR;
+    }
+    else
+    {
+        module_info->module->module_apis = module->module_apis;
+        module_info->module->module_handle = module->module_handle;
+        module_info->concurrency = 1;
+        module_info->order_by = NULL;
+        module_info->conflate = false;
+        module_info->conflate_by = NULL;
+        module_info->conflate_by_count = 0;
+        module_info->lanes = NULL;
+        module_info->lane_count = 0;
+        module_info->delivery_threads = NULL;
+        module_info->lanes_lock = NULL;
+        module_info->lanes_stopping = false;
+        module_info->max_queued = BROKER_DEFAULT_MAX_QUEUED;
+        module_info->dropped = 0;
+        module_info->dropping = false;
+        module_info->spin_count = 0;
+        module_info->yield_count = 0;
+        module_info->broker = NULL;
+        module_info->request_subscribed = false;
+        module_info->reply_subscribed = false;
+        module_info->fused_out = NULL;
+        module_info->fused_in = NULL;
+        module_info->out_link_count = 0;
+        module_info->watchdog = NULL;
+        module_info->shedding = false;
+        module_info->handoff = NULL;
+        module_info->successor = NULL;
+#ifdef BROKER_LATENCY_STATS_ENABLED
+        memset(&module_info->latency, 0, sizeof(BROKER_LATENCY_HISTOGRAM));
+#endif
+        /*Codes_SRS_BROKER_26_001: [ The function shall resolve the module's `Module_Receive` function and handle into `BROKER_MODULEINFO::dispatch`. ]*/
+        MODULE_DISPATCH_INIT(module_info->dispatch, module->module_apis, module->module_handle);
+#ifdef MODULE_ALLOC_STATS_ENABLED
+        /* the gateway adds a module with that module's tag set on the calling thread */
+        module_info->alloc_tag = ModuleAlloc_GetThreadTag();
+#endif
+
+        /*Codes_SRS_BROKER_13_099: [The function shall initialize BROKER_MODULEINFO::socket_lock with a valid lock handle.]*/
+        module_info->socket_lock = Lock_Init();
+        if (module_info->socket_lock == NULL)
+        {
+            /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+            LogError("Lock_Init for socket lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            char uuid[BROKER_GUID_SIZE];
+            memset(uuid, 0, BROKER_GUID_SIZE);
+            /*Codes_SRS_BROKER_17_020: [ The function shall create a unique ID used as a quit signal. ]*/
+            if (UniqueId_Generate(uuid, BROKER_GUID_SIZE) != UNIQUEID_OK)
+            {
+                /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                LogError("Lock_Init for socket lock failed");
+                Lock_Deinit(module_info->socket_lock);
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                module_info->quit_message_guid = STRING_construct(uuid);
+                if (module_info->quit_message_guid == NULL)
+                {
+                    /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                    LogError("String construct failed for module guid");
+                    Lock_Deinit(module_info->socket_lock);
+                    result = BROKER_ERROR;
+                }
+                else
+                {
+                    result = BROKER_OK;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static void deinit_delivery(BROKER_MODULEINFO* module_info)
+{
+    size_t i;
+    for (i = 0; i < module_info->lane_count; i++)
+    {
+        while (module_info->lanes[i].head != NULL)
+        {
+            BROKER_DELIVERY* delivery = module_info->lanes[i].head;
+            module_info->lanes[i].head = delivery->next;
+            Message_Destroy(delivery->message);
+            free(delivery->key);
+            free(delivery);
+        }
+        Condition_Deinit(module_info->lanes[i].condition);
+        free(module_info->lanes[i].index);
+    }
+    module_info->lane_count = 0;
+
+    if (module_info->lanes != NULL)
+    {
+        free(module_info->lanes);
+        module_info->lanes = NULL;
+    }
+    if (module_info->delivery_threads != NULL)
+    {
+        free(module_info->delivery_threads);
+        module_info->delivery_threads = NULL;
+    }
+    if (module_info->lanes_lock != NULL)
+    {
+        Lock_Deinit(module_info->lanes_lock);
+        module_info->lanes_lock = NULL;
+    }
+    if (module_info->order_by != NULL)
+    {
+        STRING_delete(module_info->order_by);
+        module_info->order_by = NULL;
+    }
+    if (module_info->conflate_by != NULL)
+    {
+        free(module_info->conflate_by);
+        module_info->conflate_by = NULL;
+    }
+}
+
+/*copies the '+'-separated property names of conflate_by, splitting them at the '+'*/
+static char* split_conflate_by(const char* conflate_by, size_t* count)
+{
+    size_t length = strlen(conflate_by) + 1;
+    char* result = (char*)malloc(length);
+    if (result != NULL)
+    {
+        size_t i;
+        (void)memcpy(result, conflate_by, length);
+        *count = 1;
+        for (i = 0; i < length - 1; i++)
+        {
+            if (result[i] == '+')
+            {
+                result[i] = '\0';
+                (*count)++;
+            }
+        }
+    }
+    return result;
+}
+
+static BROKER_RESULT init_delivery(BROKER_MODULEINFO* module_info, const BROKER_MODULE_DELIVERY* delivery)
+{
+    BROKER_RESULT result;
+    if (delivery != NULL)
+    {
+        /*Codes_SRS_BROKER_26_014: [ The function shall use `delivery->spin_count` and `delivery->yield_count` to wait for the module's messages. ]*/
+        module_info->spin_count = delivery->spin_count;
+        module_info->yield_count = delivery->yield_count;
+    }
+
+    if (delivery == NULL || (delivery->concurrency <= 1 && delivery->queue != BROKER_QUEUE_CONFLATE))
+    {
+        /*Codes_SRS_BROKER_26_003: [ If `delivery` is NULL, or `delivery->concurrency` is 0 or 1 and `delivery->queue` is `BROKER_QUEUE_FIFO`, the module shall receive every message on its worker thread, in order. ]*/
+        result = BROKER_OK;
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_26_004: [ Otherwise, the function shall create one lane shared by `delivery->concurrency` delivery threads, or one lane per delivery thread if `delivery->order_by` is not NULL. ]*/
+        /*Codes_SRS_BROKER_26_036: [ A module added with the `BROKER_QUEUE_CONFLATE` queue and a `delivery->concurrency` of 0 or 1 shall get a single delivery thread, so that messages wait on its lane while the module is busy. ]*/
+        size_t concurrency = (delivery->concurrency <= 1) ? 1 : delivery->concurrency;
+        size_t lane_count = (delivery->order_by == NULL) ? 1 : concurrency;
+        module_info->lanes = (BROKER_DELIVERY_LANE*)malloc(lane_count * sizeof(BROKER_DELIVERY_LANE));
+        module_info->delivery_threads = (BROKER_DELIVERY_THREAD*)malloc(concurrency * sizeof(BROKER_DELIVERY_THREAD));
+        module_info->lanes_lock = Lock_Init();
+        module_info->order_by = (delivery->order_by == NULL) ? NULL : STRING_construct(delivery->order_by);
+        module_info->conflate = (delivery->queue == BROKER_QUEUE_CONFLATE);
+        module_info->conflate_by = (!module_info->conflate || delivery->conflate_by == NULL) ? NULL : split_conflate_by(delivery->conflate_by, &module_info->conflate_by_count);
+        if (module_info->lanes == NULL ||
+            module_info->delivery_threads == NULL ||
+            module_info->lanes_lock == NULL ||
+            (delivery->order_by != NULL && module_info->order_by == NULL) ||
+            (module_info->conflate && delivery->conflate_by != NULL && module_info->conflate_by == NULL))
+        {
+            /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+            LogError("unable to allocate the delivery lanes of module [%p]", module_info->dispatch.module_handle);
+            deinit_delivery(module_info);
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_BROKER_26_064: [ Each lane shall hold at most `delivery->max_queued` messages, or `BROKER_DEFAULT_MAX_QUEUED` if it is 0. ]*/
+            module_info->max_queued = (delivery->max_queued == 0) ? BROKER_DEFAULT_MAX_QUEUED : delivery->max_queued;
+            while (module_info->lane_count < lane_count)
+            {
+                BROKER_DELIVERY_LANE* lane = &module_info->lanes[module_info->lane_count];
+                lane->head = NULL;
+                lane->tail = NULL;
+                lane->count = 0;
+                lane->index = NULL;
+                lane->index_size = 0;
+                if (module_info->conflate)
+                {
+                    /*Codes_SRS_BROKER_26_072: [ If the module was added with the `BROKER_QUEUE_CONFLATE` queue, the function shall allocate an index of each lane's messages by key. ]*/
+                    size_t i;
+                    lane->index_size = (module_info->max_queued < BROKER_CONFLATE_INDEX_MAX) ? module_info->max_queued : BROKER_CONFLATE_INDEX_MAX;
+                    lane->index = (BROKER_DELIVERY**)malloc(lane->index_size * sizeof(BROKER_DELIVERY*));
+                    if (lane->index == NULL)
+                    {
+                        break;
+                    }
+                    for (i = 0; i < lane->index_size; i++)
+                    {
+                        lane->index[i] = NULL;
+                    }
+                }
+                lane->condition = Condition_Init();
+                if (lane->condition == NULL)
+                {
+                    free(lane->index);
+                    break;
+                }
+                module_info->lane_count++;
+            }
+
+            if (module_info->lane_count < lane_count)
+            {
+                /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                LogError("unable to create a delivery lane");
+                deinit_delivery(module_info);
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                module_info->concurrency = concurrency;
+                result = BROKER_OK;
+            }
+        }
+    }
+    return result;
+}
+
+/*stops and joins the first thread_count delivery threads, once they have emptied their lanes*/
+static void stop_delivery(BROKER_MODULEINFO* module_info, size_t thread_count)
+{
+    size_t i;
+    int thread_result;
+    bool locked = (Lock(module_info->lanes_lock) == LOCK_OK);
+    if (!locked)
+    {
+        LogError("unable to lock the delivery lanes of module [%p], stopping its delivery threads anyway", module_info->dispatch.module_handle);
+    }
+
+    module_info->lanes_stopping = true;
+    for (i = 0; i < thread_count; i++)
+    {
+        (void)Condition_Post(module_info->delivery_threads[i].lane->condition);
+    }
+
+    if (locked)
+    {
+        (void)Unlock(module_info->lanes_lock);
+    }
+
+    for (i = 0; i < thread_count; i++)
+    {
+        if (ThreadAPI_Join(module_info->delivery_threads[i].thread, &thread_result) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join() returned an error for a delivery thread.");
+        }
+    }
+}
+
+static BROKER_RESULT start_delivery(BROKER_MODULEINFO* module_info)
+{
+    BROKER_RESULT result;
+    size_t i;
+    for (i = 0; i < module_info->concurrency; i++)
+    {
+        BROKER_DELIVERY_THREAD* delivery_thread = &module_info->delivery_threads[i];
+        delivery_thread->module_info = module_info;
+        delivery_thread->lane = &module_info->lanes[i % module_info->lane_count];
+        delivery_thread->index = i;
+        /*Codes_SRS_BROKER_26_005: [ The function shall create the module's delivery threads, using delivery_worker as the thread callback, before its worker thread. ]*/
+        if (ThreadAPI_Create(&delivery_thread->thread, delivery_worker, delivery_thread) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Create failed for a delivery thread");
+            break;
+        }
+    }
+
+    if (i < module_info->concurrency)
+    {
+        /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+        stop_delivery(module_info, i);
+        result = BROKER_ERROR;
+    }
+    else
+    {
+        result = BROKER_OK;
+    }
+    return result;
+}
+
+static void destroy_watchdog(BROKER_WATCHDOG* watchdog)
+{
+    if (watchdog->timer != NULL)
+    {
+        GatewayTimer_Cancel(watchdog->timer);
+        GatewayTimer_Deinit();
+    }
+    if (watchdog->tick_counter != NULL)
+    {
+        tickcounter_destroy(watchdog->tick_counter);
+    }
+    if (watchdog->lock != NULL)
+    {
+        Lock_Deinit(watchdog->lock);
+    }
+    free(watchdog->watches);
+    free(watchdog->name);
+    free(watchdog);
+}
+
+static BROKER_RESULT init_watchdog(BROKER_MODULEINFO* module_info, const BROKER_MODULE_DELIVERY* delivery)
+{
+    BROKER_RESULT result;
+    if (delivery == NULL || delivery->stall_ms == 0)
+    {
+        /*Codes_SRS_BROKER_26_048: [ If `delivery` is NULL or `delivery->stall_ms` is 0, the module's receives shall not be watched. ]*/
+        result = BROKER_OK;
+    }
+    else
+    {
+        BROKER_WATCHDOG* watchdog = (BROKER_WATCHDOG*)malloc(sizeof(BROKER_WATCHDOG));
+        if (watchdog == NULL)
+        {
+            /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+            LogError("unable to allocate the watchdog of module [%p]", module_info->dispatch.module_handle);
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            size_t name_size = (delivery->name == NULL) ? 0 : strlen(delivery->name) + 1;
+            size_t i;
+
+            memset(&watchdog->stats, 0, sizeof(BROKER_STALL_STATS));
+            watchdog->stall_ms = delivery->stall_ms;
+            watchdog->policy = delivery->stall_policy;
+            watchdog->timer = NULL;
+            /* the worker thread receives for a module without delivery threads */
+            watchdog->watch_count = module_info->concurrency;
+            watchdog->watches = (BROKER_RECEIVE_WATCH*)malloc(watchdog->watch_count * sizeof(BROKER_RECEIVE_WATCH));
+            watchdog->name = (name_size == 0) ? NULL : (char*)malloc(name_size);
+            watchdog->lock = Lock_Init();
+            watchdog->tick_counter = tickcounter_create();
+            if (watchdog->watches == NULL ||
+                (name_size != 0 && watchdog->name == NULL) ||
+                watchdog->lock == NULL ||
+                watchdog->tick_counter == NULL)
+            {
+                /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                LogError("unable to create the watchdog of module [%p]", module_info->dispatch.module_handle);
+                destroy_watchdog(watchdog);
+                result = BROKER_ERROR;
+            }
+            else if (GatewayTimer_Init() != 0)
+            {
+                /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                LogError("unable to start the gateway timer service for the watchdog of module [%p]", module_info->dispatch.module_handle);
+                destroy_watchdog(watchdog);
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                for (i = 0; i < watchdog->watch_count; i++)
+                {
+                    watchdog->watches[i].receiving = false;
+                    watchdog->watches[i].started_ms = 0;
+                    watchdog->watches[i].stalled = false;
+                }
+                if (name_size != 0)
+                {
+                    (void)memcpy(watchdog->name, delivery->name, name_size);
+                }
+
+                /*Codes_SRS_BROKER_26_049: [ Otherwise, the function shall start the gateway timer service and schedule a timer that checks the module's receives every half `stall_ms`. ]*/
+                watchdog->timer = GatewayTimer_Schedule((watchdog->stall_ms + 1) / 2, (watchdog->stall_ms + 1) / 2, check_receives, watchdog);
+                if (watchdog->timer == NULL)
+                {
+                    /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                    LogError("unable to schedule the watchdog of module [%p]", module_info->dispatch.module_handle);
+                    GatewayTimer_Deinit();
+                    destroy_watchdog(watchdog);
+                    result = BROKER_ERROR;
+                }
+                else
+                {
+                    module_info->watchdog = watchdog;
+                    result = BROKER_OK;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static BROKER_RESULT init_handoff(BROKER_MODULEINFO* module_info, BROKER_MODULEINFO* replaced_info)
+{
+    BROKER_RESULT result;
+    BROKER_HANDOFF* handoff = (BROKER_HANDOFF*)malloc(sizeof(BROKER_HANDOFF));
+    if (handoff == NULL)
+    {
+        LogError("unable to allocate the module's handoff");
+        result = BROKER_ERROR;
+    }
+    else
+    {
+        handoff->guid = STRING_clone(replaced_info->quit_message_guid);
+        if (handoff->guid == NULL)
+        {
+            LogError("unable to copy the replaced module's quit signal");
+            free(handoff);
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            handoff->lock = Lock_Init();
+            if (handoff->lock == NULL)
+            {
+                LogError("Lock_Init for the handoff failed");
+                STRING_delete(handoff->guid);
+                free(handoff);
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                handoff->condition = Condition_Init();
+                if (handoff->condition == NULL)
+                {
+                    LogError("Condition_Init for the handoff failed");
+                    Lock_Deinit(handoff->lock);
+                    STRING_delete(handoff->guid);
+                    free(handoff);
+                    result = BROKER_ERROR;
+                }
+                else
+                {
+                    handoff->replaced = replaced_info;
+                    handoff->released = false;
+                    handoff->taken_over = false;
+                    module_info->handoff = handoff;
+                    result = BROKER_OK;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static void release_handoff(BROKER_HANDOFF* handoff)
+{
+    if (Lock(handoff->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the handoff");
+        handoff->released = true;
+    }
+    else
+    {
+        handoff->released = true;
+        (void)Condition_Post(handoff->condition);
+        Unlock(handoff->lock);
+    }
+}
+
+static void deinit_module(BROKER_MODULEINFO* module_info)
+{
+    /*Codes_SRS_BROKER_13_057: [The function shall free all members of the MODULE_INFO object.]*/
+    if (module_info->watchdog != NULL)
+    {
+        /* the watchdog's timer is cancelled before the watches it reads are freed */
+        destroy_watchdog(module_info->watchdog);
+        module_info->watchdog = NULL;
+    }
+    deinit_delivery(module_info);
+    if (module_info->handoff != NULL)
+    {
+        Condition_Deinit(module_info->handoff->condition);
+        Lock_Deinit(module_info->handoff->lock);
+        STRING_delete(module_info->handoff->guid);
+        free(module_info->handoff);
+        module_info->handoff = NULL;
+    }
+    Lock_Deinit(module_info->socket_lock);
+    STRING_delete(module_info->quit_message_guid);
+    free(module_info->module);
+}
+
+static BROKER_RESULT start_module(BROKER_MODULEINFO* module_info, STRING_HANDLE url)
+{
+    BROKER_RESULT result;
+
+    /* Connect to pub/sub */
+    /*Codes_SRS_BROKER_17_013: [ The function shall create a nanomsg socket for reception. ]*/
+    module_info->receive_socket = nn_socket(AF_SP, NN_SUB);
+    if (module_info->receive_socket < 0)
+    {
+        /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+        LogError("module receive socket create failed");
+        result = BROKER_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_17_014: [ The function shall bind the socket to the the BROKER_HANDLE_DATA::url. ]*/
+        int connect_result = nn_connect(module_info->receive_socket, STRING_c_str(url));
+        if (connect_result < 0)
+        {
+            /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+            LogError("nn_connect failed");
+            nn_close(module_info->receive_socket);
+            module_info->receive_socket = -1;
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            /* Codes_SRS_BROKER_17_028: [ The function shall subscribe BROKER_MODULEINFO::receive_socket to the quit signal GUID. ]*/
+            if (nn_setsockopt(
+                module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, STRING_c_str(module_info->quit_message_guid), STRING_length(module_info->quit_message_guid)) < 0)
+            {
+                /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                LogError("nn_setsockopt failed");
+                nn_close(module_info->receive_socket);
+                module_info->receive_socket = -1;
+                result = BROKER_ERROR;
+            }
+            /*Codes_SRS_BROKER_26_059: [ Broker_AddReplacementModule shall subscribe the module's receive_socket to the quit signal of `replaced`, which is the handoff. ]*/
+            else if (module_info->handoff != NULL &&
+                nn_setsockopt(module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, STRING_c_str(module_info->handoff->guid), STRING_length(module_info->handoff->guid)) < 0)
+            {
+                /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                LogError("nn_setsockopt failed");
+                nn_close(module_info->receive_socket);
+                module_info->receive_socket = -1;
+                result = BROKER_ERROR;
+            }
+            else if (module_info->lanes != NULL && start_delivery(module_info) != BROKER_OK)
+            {
+                /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                LogError("unable to start the delivery threads");
+                nn_close(module_info->receive_socket);
+                module_info->receive_socket = -1;
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BROKER_13_102: [The function shall create a new thread for the module by calling ThreadAPI_Create using module_worker as the thread callback and using the newly allocated BROKER_MODULEINFO object as the thread context.*/
+                if (ThreadAPI_Create(
+                    &(module_info->thread),
+                    module_worker,
+                    (void*)module_info
+                ) != THREADAPI_OK)
+                {
+                    /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                    LogError("ThreadAPI_Create failed");
+                    if (module_info->lanes != NULL)
+                    {
+                        stop_delivery(module_info, module_info->concurrency);
+                    }
+                    nn_close(module_info->receive_socket);
+                    result = BROKER_ERROR;
+                }
+                else
+                {
+                    result = BROKER_OK;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/*stop module means: stop the thread that feeds messages to Module_Receive function + deletion of all queued messages */
+/*returns 0 if success, otherwise __LINE__*/
+static int stop_module(int publish_socket, BROKER_MODULEINFO* module_info)
+{
+    int  quit_result, close_result, thread_result, result;
+
+    /*Codes_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending BROKER_MODULEINFO::quit_message_guid to the publish_socket. ]*/
+    /* send the unique quite id for this module */
+    if ((quit_result = nn_send(publish_socket, STRING_c_str(module_info->quit_message_guid), BROKER_GUID_SIZE, 0)) < 0)
+    {
+        /*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
+        /* at the cost of a data race, we will close the socket to terminate the thread */
+        nn_close(module_info->receive_socket);
+        LogError("unable to peacefully close thread for module [%p], nn_send error [%d], taking harsher methods", module_info, quit_result);
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_02_001: [ Broker_RemoveModule shall lock BROKER_MODULEINFO::socket_lock. ]*/
+        if (Lock(module_info->socket_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
             /* at the cost of a data race, we will close the socket to terminate the thread */
             nn_close(module_info->receive_socket);
             LogError("unable to peacefully close thread for module [%p], Lock error, taking harsher methods", module_info );
         }
         else
         {
-            /*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
-            close_result = nn_close(module_info->receive_socket);
-            if (close_result < 0)
+            /*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
+            close_result = nn_close(module_info->receive_socket);
+            if (close_result < 0)
+            {
+                LogError("Receive socket close failed for module at  item [%p] failed", module_info);
+            }
+            else
+            {
+                /*all is fine, thread will eventually stop and be joined*/
+            }
+            /*Codes_SRS_BROKER_02_003: [ After closing the socket, Broker_RemoveModule shall unlock BROKER_MODULEINFO::info_lock. ]*/
+            if (Unlock(module_info->socket_lock) != LOCK_OK)
+            {
+                LogError("unable to unlock socket lock");
+            }
+        }
+    }
+    /*Codes_SRS_BROKER_13_104: [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]*/
+    if (ThreadAPI_Join(module_info->thread, &thread_result) != THREADAPI_OK)
+    {
+        result = __LINE__;
+        LogError("ThreadAPI_Join() returned an error.");
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+BROKER_MODULEINFO* broker_locate_handle(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE handle);
+
+static BROKER_RESULT add_module(BROKER_HANDLE broker, const MODULE* module, const BROKER_MODULE_DELIVERY* delivery, const MODULE* replaced)
+{
+    BROKER_RESULT result;
+
+    /*Codes_SRS_BROKER_99_013: [If `broker` or `module` is NULL the function shall return BROKER_INVALIDARG.]*/
+    if (broker == NULL || module == NULL)
+    {
+        result = BROKER_INVALIDARG;
+        LogError("invalid parameter (NULL).");
+    }
+    /*Codes_SRS_BROKER_26_056: [ If `replaced` or its `module_handle` is NULL, or it is `module`, Broker_AddReplacementModule shall return BROKER_INVALIDARG. ]*/
+    else if (replaced != NULL && (replaced->module_handle == NULL || replaced->module_handle == module->module_handle))
+    {
+        result = BROKER_INVALIDARG;
+        LogError("invalid replaced module [%p]", replaced->module_handle);
+    }
+    /*Codes_SRS_BROKER_99_014: [If `module_handle` or `module_apis` are `NULL` the function shall return `BROKER_INVALIDARG`.]*/
+    else if (module->module_apis == NULL || module->module_handle == NULL)
+    {
+        result = BROKER_INVALIDARG;
+        LogError("invalid parameter (NULL).");
+    }
+    else
+    {
+        BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)malloc(sizeof(BROKER_MODULEINFO));
+        if (module_info == NULL)
+        {
+            LogError("Allocate module info failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            if (init_module(module_info, module) != BROKER_OK)
+            {
+                /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                LogError("start_module failed");
+                free(module_info->module);
+                free(module_info);
+                result = BROKER_ERROR;
+            }
+            else if (init_delivery(module_info, delivery) != BROKER_OK ||
+                init_watchdog(module_info, delivery) != BROKER_OK)
+            {
+                /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                deinit_module(module_info);
+                free(module_info);
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BROKER_13_039: [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]*/
+                BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+                if (Lock(broker_data->modules_lock) != LOCK_OK)
+                {
+                    /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                    LogError("Lock on broker_data->modules_lock failed");
+                    deinit_module(module_info);
+                    free(module_info);
+                    result = BROKER_ERROR;
+                }
+                else
+                {
+                    BROKER_MODULEINFO* replaced_info = (replaced == NULL) ? NULL : broker_locate_handle(broker_data, replaced->module_handle);
+                    if (replaced != NULL && (replaced_info == NULL || replaced_info->successor != NULL))
+                    {
+                        /*Codes_SRS_BROKER_26_058: [ Broker_AddReplacementModule shall return BROKER_ERROR if `replaced` is not attached to the broker or another module is replacing it. ]*/
+                        LogError("the replaced module is not attached to the broker or is already being replaced");
+                        deinit_module(module_info);
+                        free(module_info);
+                        result = BROKER_ERROR;
+                    }
+                    else if (replaced_info != NULL && init_handoff(module_info, replaced_info) != BROKER_OK)
+                    {
+                        /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                        deinit_module(module_info);
+                        free(module_info);
+                        result = BROKER_ERROR;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_BROKER_13_045: [Broker_AddModule shall append the new instance of BROKER_MODULEINFO to BROKER_HANDLE_DATA::modules.]*/
+                        LIST_ITEM_HANDLE moduleListItem = singlylinkedlist_add(broker_data->modules, module_info);
+                        if (moduleListItem == NULL)
+                        {
+                            /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                            LogError("singlylinkedlist_add failed");
+                            deinit_module(module_info);
+                            free(module_info);
+                            result = BROKER_ERROR;
+                        }
+                        else
+                        {
+                            module_info->broker = broker_data;
+                            if (start_module(module_info, broker_data->url) != BROKER_OK)
+                            {
+                                LogError("start_module failed");
+                                deinit_module(module_info);
+                                singlylinkedlist_remove(broker_data->modules, moduleListItem);
+                                free(module_info);
+                                result = BROKER_ERROR;
+                            }
+                            else
+                            {
+                                if (replaced_info != NULL)
+                                {
+                                    replaced_info->successor = module_info;
+                                }
+                                /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                                result = BROKER_OK;
+                            }
+                        }
+                    }
+
+                    /*Codes_SRS_BROKER_13_046: [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]*/
+                    Unlock(broker_data->modules_lock);
+                }
+            }
+
+        }
+    }
+
+    return result;
+}
+
+BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
+{
+    return add_module(broker, module, NULL, NULL);
+}
+
+BROKER_RESULT Broker_AddModuleWithDelivery(BROKER_HANDLE broker, const MODULE* module, const BROKER_MODULE_DELIVERY* delivery)
+{
+    /*Codes_SRS_BROKER_26_002: [ Broker_AddModuleWithDelivery shall meet all the requirements of Broker_AddModule. ]*/
+    return add_module(broker, module, delivery, NULL);
+}
+
+BROKER_RESULT Broker_AddReplacementModule(BROKER_HANDLE broker, const MODULE* module, const BROKER_MODULE_DELIVERY* delivery, const MODULE* replaced)
+{
+    BROKER_RESULT result;
+    if (replaced == NULL)
+    {
+        /*Codes_SRS_BROKER_26_056: [ If `replaced` or its `module_handle` is NULL, or it is `module`, Broker_AddReplacementModule shall return BROKER_INVALIDARG. ]*/
+        LogError("invalid parameter (NULL).");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_26_057: [ Otherwise Broker_AddReplacementModule shall meet all the requirements of Broker_AddModuleWithDelivery. ]*/
+        result = add_module(broker, module, delivery, replaced);
+    }
+    return result;
+}
+
+static bool find_module_predicate(LIST_ITEM_HANDLE list_item, const void* value)
+{
+    BROKER_MODULEINFO* element = (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(list_item);
+    return element->module->module_handle == ((MODULE*)value)->module_handle;
+}
+
+/* called with modules_lock held */
+static void detach_fused_link(BROKER_HANDLE_DATA* broker_data, BROKER_FUSED_LINK* fused_link)
+{
+    fused_link->source_info->fused_out = NULL;
+    fused_link->sink_info->fused_in = NULL;
+    fused_link->source_info = NULL;
+    fused_link->sink_info = NULL;
+    broker_data->fused_link_count--;
+}
+
+static void release_fused_link(BROKER_FUSED_LINK* fused_link)
+{
+    if (DEC_REF(BROKER_FUSED_LINK, fused_link) == DEC_RETURN_ZERO)
+    {
+        Lock_Deinit(fused_link->lock);
+        free(fused_link);
+    }
+}
+
+/* called without modules_lock, since the sink may be publishing; once this
+ * returns the sink is not called on the link again
+ */
+static void remove_fused_link(BROKER_FUSED_LINK* fused_link)
+{
+    if (Lock(fused_link->lock) != LOCK_OK)
+    {
+        LogError("unable to wait for a fused delivery to return");
+        fused_link->removed = true;
+    }
+    else
+    {
+        fused_link->removed = true;
+        Unlock(fused_link->lock);
+    }
+    release_fused_link(fused_link);
+}
+
+/* Sends a frame of just the module's topic, after the frames the module
+ * published from its worker. Each module still linked from it unsubscribes
+ * when it receives the frame, so the links of a replaced module are removed
+ * without dropping the messages it published before it stopped.
+ */
+static void retire_module(BROKER_HANDLE_DATA* broker_data, BROKER_MODULEINFO* module_info)
+{
+    unsigned char frame[BROKER_FRAME_HEADER_SIZE];
+    memset(frame, 0, sizeof(frame));
+    memcpy(frame, &(module_info->module->module_handle), sizeof(MODULE_HANDLE));
+    if (nn_send(broker_data->publish_socket, frame, sizeof(frame), 0) != (int)sizeof(frame))
+    {
+        LogError("unable to retire the links from module [%p]", module_info->module->module_handle);
+    }
+}
+
+BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
+{
+    /*Codes_SRS_BROKER_13_048: [If `broker` or `module` is NULL the function shall return BROKER_INVALIDARG.]*/
+    BROKER_RESULT result;
+    if (broker == NULL || module == NULL)
+    {
+        /*Codes_SRS_BROKER_13_053: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+        result = BROKER_INVALIDARG;
+        LogError("invalid parameter (NULL).");
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_13_088: [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]*/
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        BROKER_FUSED_LINK* fused_out = NULL;
+        BROKER_FUSED_LINK* fused_in = NULL;
+        BROKER_MODULEINFO* removed_info = NULL;
+        bool stopped = false;
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+            LogError("Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_BROKER_13_049: [Broker_RemoveModule shall perform a linear search for module in BROKER_HANDLE_DATA::modules.]*/
+            LIST_ITEM_HANDLE module_info_item = singlylinkedlist_find(broker_data->modules, find_module_predicate, module);
+
+            if (module_info_item == NULL)
+            {
+                /*Codes_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]*/
+                LogError("Supplied module is not attached to the broker");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(module_info_item);
+
+                if (module_info->handoff != NULL)
+                {
+                    /*Codes_SRS_BROKER_26_063: [ If the module was added with Broker_AddReplacementModule, Broker_RemoveModule shall stop it from waiting for the handoff, and let another module replace the module it was replacing if that module is still attached. ]*/
+                    if (module_info->handoff->replaced != NULL)
+                    {
+                        module_info->handoff->replaced->successor = NULL;
+                        module_info->handoff->replaced = NULL;
+                    }
+                    release_handoff(module_info->handoff);
+                }
+
+                /*Codes_SRS_BROKER_26_041: [ Broker_RemoveModule shall remove the fused links from and into the module, and wait for a delivery in progress on them to return after it unlocks modules_lock. ]*/
+                fused_out = module_info->fused_out;
+                if (fused_out != NULL)
+                {
+                    detach_fused_link(broker_data, fused_out);
+                }
+                fused_in = module_info->fused_in;
+                if (fused_in != NULL)
+                {
+                    detach_fused_link(broker_data, fused_in);
+                }
+
+                stopped = (stop_module(broker_data->publish_socket, module_info) == 0);
+                if (stopped && module_info->successor != NULL)
+                {
+                    retire_module(broker_data, module_info);
+                }
+
+                if (module_info->successor != NULL)
+                {
+                    /*Codes_SRS_BROKER_26_061: [ If another module is replacing the module, Broker_RemoveModule shall, once the module's worker has stopped, send a frame of the module's topic only and let the replacing module deliver the frames it received after the module's quit signal. ]*/
+                    module_info->successor->handoff->replaced = NULL;
+                    release_handoff(module_info->successor->handoff);
+                }
+
+                if (broker_data->requests != NULL)
+                {
+                    /*Codes_SRS_BROKER_26_027: [ Broker_RemoveModule shall complete every pending request of the module with BROKER_REQUEST_CANCELLED once its worker thread has stopped. ]*/
+                    cancel_requests(broker_data->requests, module_info);
+                }
+
+                /*Codes_SRS_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]*/
+                singlylinkedlist_remove(broker_data->modules, module_info_item);
+                removed_info = module_info;
+
+                /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                result = BROKER_OK;
+            }
+
+            /*Codes_SRS_BROKER_13_054: [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]*/
+            Unlock(broker_data->modules_lock);
+
+            if (fused_out != NULL)
+            {
+                remove_fused_link(fused_out);
+            }
+            if (fused_in != NULL)
+            {
+                remove_fused_link(fused_in);
+            }
+
+            if (removed_info != NULL)
+            {
+                if (removed_info->lanes != NULL)
+                {
+                    /*Codes_SRS_BROKER_26_006: [ Once it has released modules_lock, the function shall stop the module's delivery threads, once they have delivered the messages already queued on their lanes, and join them before it frees the module. ]*/
+                    stop_delivery(removed_info, removed_info->concurrency);
+                }
+                if (stopped)
+                {
+                    deinit_module(removed_info);
+                }
+                else
+                {
+                    LogError("unable to stop module");
+                }
+                free(removed_info);
+            }
+        }
+    }
+
+    return result;
+}
+
+BROKER_RESULT Broker_GetLatencyHistogram(BROKER_HANDLE broker, const MODULE* module, BROKER_LATENCY_HISTOGRAM* histogram)
+{
+    BROKER_RESULT result;
+    if (broker == NULL || module == NULL || histogram == NULL)
+    {
+        /*Codes_SRS_BROKER_26_015: [ If `broker`, `module` or `histogram` is NULL the function shall return BROKER_INVALIDARG. ]*/
+        LogError("invalid parameter broker=[%p], module=[%p], histogram=[%p]", broker, module, histogram);
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+#ifdef BROKER_LATENCY_STATS_ENABLED
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_26_017: [ The function shall return BROKER_ERROR if the module is not attached to the broker or an underlying API call fails. ]*/
+            LogError("Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            LIST_ITEM_HANDLE module_info_item = singlylinkedlist_find(broker_data->modules, find_module_predicate, module);
+            if (module_info_item == NULL)
+            {
+                /*Codes_SRS_BROKER_26_017: [ The function shall return BROKER_ERROR if the module is not attached to the broker or an underlying API call fails. ]*/
+                LogError("Supplied module is not attached to the broker");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BROKER_26_016: [ The function shall copy the module's publish-to-receive latency histogram into `histogram`. ]*/
+                BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(module_info_item);
+                *histogram = module_info->latency;
+                result = BROKER_OK;
+            }
+            Unlock(broker_data->modules_lock);
+        }
+#else
+        /*Codes_SRS_BROKER_26_018: [ The function shall return BROKER_ERROR if the broker was built without `enable_broker_latency_stats`. ]*/
+        LogError("latency histograms are not available, build the gateway with enable_broker_latency_stats");
+        result = BROKER_ERROR;
+#endif
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_GetStallStats(BROKER_HANDLE broker, const MODULE* module, BROKER_STALL_STATS* stats)
+{
+    BROKER_RESULT result;
+    if (broker == NULL || module == NULL || stats == NULL)
+    {
+        /*Codes_SRS_BROKER_26_050: [ If `broker`, `module` or `stats` is NULL the function shall return BROKER_INVALIDARG. ]*/
+        LogError("invalid parameter broker=[%p], module=[%p], stats=[%p]", broker, module, stats);
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_26_052: [ The function shall return BROKER_ERROR if the module is not attached to the broker, was added without a `stall_ms`, or an underlying API call fails. ]*/
+            LogError("Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            LIST_ITEM_HANDLE module_info_item = singlylinkedlist_find(broker_data->modules, find_module_predicate, module);
+            BROKER_MODULEINFO* module_info = (module_info_item == NULL) ? NULL : (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(module_info_item);
+            if (module_info == NULL || module_info->watchdog == NULL)
+            {
+                /*Codes_SRS_BROKER_26_052: [ The function shall return BROKER_ERROR if the module is not attached to the broker, was added without a `stall_ms`, or an underlying API call fails. ]*/
+                LogError("Supplied module is not attached to the broker or is not watched");
+                result = BROKER_ERROR;
+            }
+            else if (Lock(module_info->watchdog->lock) != LOCK_OK)
+            {
+                /*Codes_SRS_BROKER_26_052: [ The function shall return BROKER_ERROR if the module is not attached to the broker, was added without a `stall_ms`, or an underlying API call fails. ]*/
+                LogError("unable to lock the watchdog of the module");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BROKER_26_051: [ The function shall copy the stall counters of the module's watchdog into `stats`. ]*/
+                *stats = module_info->watchdog->stats;
+                (void)Unlock(module_info->watchdog->lock);
+                result = BROKER_OK;
+            }
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_GetQueueStats(BROKER_HANDLE broker, const MODULE* module, BROKER_QUEUE_STATS* stats)
+{
+    BROKER_RESULT result;
+    if (broker == NULL || module == NULL || stats == NULL)
+    {
+        /*Codes_SRS_BROKER_26_066: [ If `broker`, `module` or `stats` is NULL the function shall return BROKER_INVALIDARG. ]*/
+        LogError("invalid parameter broker=[%p], module=[%p], stats=[%p]", broker, module, stats);
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_26_068: [ The function shall return BROKER_ERROR if the module is not attached to the broker, has no delivery lanes, or an underlying API call fails. ]*/
+            LogError("Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            LIST_ITEM_HANDLE module_info_item = singlylinkedlist_find(broker_data->modules, find_module_predicate, module);
+            BROKER_MODULEINFO* module_info = (module_info_item == NULL) ? NULL : (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(module_info_item);
+            if (module_info == NULL || module_info->lanes == NULL)
+            {
+                /*Codes_SRS_BROKER_26_068: [ The function shall return BROKER_ERROR if the module is not attached to the broker, has no delivery lanes, or an underlying API call fails. ]*/
+                LogError("Supplied module is not attached to the broker or has no delivery lanes");
+                result = BROKER_ERROR;
+            }
+            else if (Lock(module_info->lanes_lock) != LOCK_OK)
+            {
+                /*Codes_SRS_BROKER_26_068: [ The function shall return BROKER_ERROR if the module is not attached to the broker, has no delivery lanes, or an underlying API call fails. ]*/
+                LogError("unable to lock the delivery lanes of the module");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BROKER_26_067: [ The function shall set `stats->queued` to the messages waiting on the module's lanes, `stats->max_queued` to the most that may wait on one lane and `stats->dropped` to the messages dropped because their lane was full. ]*/
+                size_t i;
+                stats->queued = 0;
+                for (i = 0; i < module_info->lane_count; i++)
+                {
+                    stats->queued += module_info->lanes[i].count;
+                }
+                stats->max_queued = module_info->max_queued;
+                stats->dropped = module_info->dropped;
+                (void)Unlock(module_info->lanes_lock);
+                result = BROKER_OK;
+            }
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
+BROKER_MODULEINFO* broker_locate_handle(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE handle)
+{
+    BROKER_MODULEINFO* result;
+    MODULE module;
+    module.module_apis = NULL;
+    module.module_handle = handle;
+
+    LIST_ITEM_HANDLE module_info_item = singlylinkedlist_find(broker_data->modules, find_module_predicate, &module);
+    if (module_info_item == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(module_info_item);
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_17_029: [ If broker or link are NULL, Broker_AddLink shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || link == NULL || link->module_sink_handle == NULL || link->module_source_handle == NULL)
+    {
+        LogError("Broker_AddLink, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BROKER_17_030: [ Broker_AddLink shall lock the modules_lock. ]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
+            LogError("Broker_AddLink, Lock on broker_data->modules_lock failed");
+            result = BROKER_ADD_LINK_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_BROKER_17_031: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->sink. ]*/
+            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, link->module_sink_handle);
+
+            if (module_info == NULL)
+            {
+                /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
+                LogError("Link->sink is not attached to the broker");
+                result = BROKER_ADD_LINK_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BROKER_17_041: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->module_source_handle. ]*/
+                BROKER_MODULEINFO* source_module = broker_locate_handle(broker_data, link->module_source_handle);
+
+                if (source_module == NULL)
+                {
+                    LogError("Link->source is not attached to the broker");
+                    result = BROKER_ADD_LINK_ERROR;
+                }
+                else
+                {
+                    /*Codes_SRS_BROKER_17_032: [ Broker_AddLink shall subscribe module_info->receive_socket to the link->source module handle. ]*/
+                    if (nn_setsockopt(
+                        module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, &(link->module_source_handle), sizeof(MODULE_HANDLE)) < 0)
+                    {
+                        /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
+                        LogError("Unable to make link in Broker");
+                        result = BROKER_ADD_LINK_ERROR;
+                    }
+                    else
+                    {
+                        source_module->out_link_count++;
+                        result = BROKER_OK;
+                    }
+                }
+            }
+            /*Codes_SRS_BROKER_17_033: [ Broker_AddLink shall unlock the modules_lock. ]*/
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_AddFusedLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_26_037: [ If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_AddFusedLink shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || link == NULL || link->module_sink_handle == NULL || link->module_source_handle == NULL)
+    {
+        LogError("Broker_AddFusedLink, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_26_038: [ Broker_AddFusedLink shall return BROKER_ADD_LINK_ERROR if the source or the sink is not attached, they are the same module, the source already publishes on a fused link, the sink already receives on one, or an underlying API call fails. ]*/
+            LogError("Broker_AddFusedLink, Lock on broker_data->modules_lock failed");
+            result = BROKER_ADD_LINK_ERROR;
+        }
+        else
+        {
+            BROKER_MODULEINFO* sink_info = broker_locate_handle(broker_data, link->module_sink_handle);
+            BROKER_MODULEINFO* source_info = (sink_info == NULL) ? NULL : broker_locate_handle(broker_data, link->module_source_handle);
+            if (sink_info == NULL || source_info == NULL)
+            {
+                /*Codes_SRS_BROKER_26_038: [ Broker_AddFusedLink shall return BROKER_ADD_LINK_ERROR if the source or the sink is not attached, they are the same module, the source already publishes on a fused link, the sink already receives on one, or an underlying API call fails. ]*/
+                LogError("Link->source or link->sink is not attached to the broker");
+                result = BROKER_ADD_LINK_ERROR;
+            }
+            else if (sink_info == source_info || source_info->fused_out != NULL || sink_info->fused_in != NULL)
+            {
+                /*Codes_SRS_BROKER_26_038: [ Broker_AddFusedLink shall return BROKER_ADD_LINK_ERROR if the source or the sink is not attached, they are the same module, the source already publishes on a fused link, the sink already receives on one, or an underlying API call fails. ]*/
+                LogError("a module is the source of one fused link and the sink of one fused link at most");
+                result = BROKER_ADD_LINK_ERROR;
+            }
+            else
+            {
+                BROKER_FUSED_LINK* fused_link = REFCOUNT_TYPE_CREATE(BROKER_FUSED_LINK);
+                if (fused_link == NULL)
+                {
+                    LogError("unable to allocate a fused link");
+                    result = BROKER_ADD_LINK_ERROR;
+                }
+                else
+                {
+                    fused_link->lock = Lock_Init();
+                    if (fused_link->lock == NULL)
+                    {
+                        LogError("Lock_Init for fused link failed");
+                        free(fused_link);
+                        result = BROKER_ADD_LINK_ERROR;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_BROKER_26_039: [ Broker_AddFusedLink shall make Broker_Publish call the sink's Module_Receive with each message the source publishes, on the publishing thread and before it returns, without serializing the message unless the source has other links. ]*/
+                        fused_link->sink = sink_info->dispatch;
+                        fused_link->removed = false;
+                        fused_link->source_info = source_info;
+                        fused_link->sink_info = sink_info;
+#ifdef MODULE_ALLOC_STATS_ENABLED
+                        fused_link->alloc_tag = sink_info->alloc_tag;
+#endif
+                        source_info->fused_out = fused_link;
+                        sink_info->fused_in = fused_link;
+                        broker_data->fused_link_count++;
+                        result = BROKER_OK;
+                    }
+                }
+            }
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_17_035: [ If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_RemoveLink shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || link == NULL || link->module_sink_handle == NULL || link->module_source_handle == NULL)
+    {
+        LogError("Broker_AddLink, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        BROKER_FUSED_LINK* fused_link = NULL;
+        /*Codes_SRS_BROKER_17_036: [ Broker_RemoveLink shall lock the modules_lock. ]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
+            LogError("Broker_AddLink, Lock on broker_data->modules_lock failed");
+            result = BROKER_REMOVE_LINK_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_BROKER_17_037: [ Broker_RemoveLink shall find the module_info for link->module_sink_handle. ]*/
+            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, link->module_sink_handle);
+
+            if (module_info == NULL)
             {
-                LogError("Receive socket close failed for module at  item [%p] failed", module_info);
+                /*Codes_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
+                LogError("Link->sink is not attached to the broker");
+                result = BROKER_REMOVE_LINK_ERROR;
             }
             else
             {
-                /*all is fine, thread will eventually stop and be joined*/
+                /*Codes_SRS_BROKER_17_042: [ Broker_RemoveLink shall find the module_info for link->module_source_handle. ]*/
+                BROKER_MODULEINFO* source_module_info = broker_locate_handle(broker_data, link->module_source_handle);
+                if (source_module_info == NULL)
+                {
+                    LogError("Link->source is not attached to the broker");
+                    result = BROKER_REMOVE_LINK_ERROR;
+                }
+                else if (source_module_info->fused_out != NULL && source_module_info->fused_out->sink_info == module_info)
+                {
+                    /*Codes_SRS_BROKER_26_040: [ If the link is fused, Broker_RemoveLink shall detach it instead of unsubscribing, and wait for a delivery in progress on it to return after it unlocks modules_lock. ]*/
+                    fused_link = source_module_info->fused_out;
+                    detach_fused_link(broker_data, fused_link);
+                    result = BROKER_OK;
+                }
+                else
+                {
+                    /*Codes_SRS_BROKER_17_038: [ Broker_RemoveLink shall unsubscribe module_info->receive_socket from the link->module_source_handle module handle. ]*/
+                    if (nn_setsockopt(
+                        module_info->receive_socket, NN_SUB, NN_SUB_UNSUBSCRIBE, &(link->module_source_handle), sizeof(MODULE_HANDLE)) < 0)
+                    {
+                        /*Codes_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
+                        LogError("Unable to make link in Broker");
+                        result = BROKER_REMOVE_LINK_ERROR;
+                    }
+                    else
+                    {
+                        if (source_module_info->out_link_count > 0)
+                        {
+                            source_module_info->out_link_count--;
+                        }
+                        result = BROKER_OK;
+                    }
+                }
             }
-            /*Codes_SRS_BROKER_02_003: [ After closing the socket, Broker_RemoveModule shall unlock BROKER_MODULEINFO::info_lock. ]*/
-            if (Unlock(module_info->socket_lock) != LOCK_OK)
+            /*Codes_SRS_BROKER_17_039: [ Broker_RemoveLink shall unlock the modules_lock. ]*/
+            Unlock(broker_data->modules_lock);
+
+            if (fused_link != NULL)
             {
-                LogError("unable to unlock socket lock");
+                remove_fused_link(fused_link);
             }
         }
     }
-    /*Codes_SRS_BROKER_13_104: [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]*/
-    if (ThreadAPI_Join(module_info->thread, &thread_result) != THREADAPI_OK)
+    return result;
+}
+
+static void broker_decrement_ref(BROKER_HANDLE broker)
+{
+    /*Codes_SRS_BROKER_13_058: [If `broker` is NULL the function shall do nothing.]*/
+    if (broker != NULL)
+    {
+        /*Codes_SRS_BROKER_13_111: [Otherwise, Broker_Destroy shall decrement the internal ref count of the message.]*/
+        /*Codes_SRS_BROKER_13_112: [If the ref count is zero then the allocated resources are freed.]*/
+        if (DEC_REF(BROKER_HANDLE_DATA, broker) == DEC_RETURN_ZERO)
+        {
+            BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+            if (singlylinkedlist_get_head_item(broker_data->modules) != NULL)
+            {
+                LogError("WARNING: There are still active modules attached to the broker and the broker is being destroyed.");
+            }
+            if (broker_data->requests != NULL)
+            {
+                /*Codes_SRS_BROKER_26_028: [ Broker_Destroy shall complete every pending request with BROKER_REQUEST_CANCELLED and release the gateway timer service. ]*/
+                destroy_requests(broker_data->requests);
+            }
+            /* May want to do nn_shutdown first for cleanliness. */
+            nn_close(broker_data->publish_socket);
+            STRING_delete(broker_data->url);
+            singlylinkedlist_destroy(broker_data->modules);
+            Lock_Deinit(broker_data->modules_lock);
+            free(broker_data);
+        }
+    }
+    else
+    {
+        LogError("broker handle is NULL");
+    }
+}
+
+extern void Broker_Destroy(BROKER_HANDLE broker)
+{
+    broker_decrement_ref(broker);
+}
+
+extern void Broker_DecRef(BROKER_HANDLE broker)
+{
+    /*Codes_SRS_BROKER_13_113: [This function shall implement all the requirements of the Broker_Destroy API.]*/
+    broker_decrement_ref(broker);
+}
+
+/* delivers messages on a fused link the caller holds a reference on, and releases it */
+static int deliver_fused(BROKER_FUSED_LINK* fused_link, MODULE_HANDLE source, const MESSAGE_HANDLE* messages, size_t count)
+{
+    int result;
+    if (Lock(fused_link->lock) != LOCK_OK)
     {
+        LogError("unable to lock a fused link, %zu message(s) not delivered", count);
         result = __LINE__;
-        LogError("ThreadAPI_Join() returned an error.");
     }
     else
     {
+        if (!fused_link->removed)
+        {
+            size_t i;
+#ifdef MODULE_ALLOC_STATS_ENABLED
+            MODULE_ALLOC_TAG publisher_tag = ModuleAlloc_SetThreadTag(fused_link->alloc_tag);
+#endif
+            for (i = 0; i < count; i++)
+            {
+                GATEWAY_PROBE3(broker_publish_fused, source, fused_link->sink.module_handle, messages[i]);
+                MODULE_DISPATCH_RECEIVE(fused_link->sink, messages[i]);
+            }
+#ifdef MODULE_ALLOC_STATS_ENABLED
+            (void)ModuleAlloc_SetThreadTag(publisher_tag);
+#endif
+        }
+        Unlock(fused_link->lock);
         result = 0;
     }
+    release_fused_link(fused_link);
     return result;
 }
 
-BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
+/* looks up the fused link of source, if any, and takes a reference on it; the caller holds modules_lock */
+static BROKER_FUSED_LINK* acquire_fused_out(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE source, bool* send_message)
 {
-    BROKER_RESULT result;
+    BROKER_FUSED_LINK* result = NULL;
+    *send_message = true;
+    if (broker_data->fused_link_count > 0)
+    {
+        BROKER_MODULEINFO* source_info = broker_locate_handle(broker_data, source);
+        if (source_info != NULL && source_info->fused_out != NULL)
+        {
+            /*Codes_SRS_BROKER_26_039: [ Broker_AddFusedLink shall make Broker_Publish call the sink's Module_Receive with each message the source publishes, on the publishing thread and before it returns, without serializing the message unless the source has other links. ]*/
+            result = source_info->fused_out;
+            INC_REF(BROKER_FUSED_LINK, result);
+            *send_message = (source_info->out_link_count > 0);
+        }
+    }
+    return result;
+}
 
-    /*Codes_SRS_BROKER_99_013: [If `broker` or `module` is NULL the function shall return BROKER_INVALIDARG.]*/
-    if (broker == NULL || module == NULL)
+/* serializes message behind the source handle and sends the frame on the publish socket; the caller holds modules_lock */
+static BROKER_RESULT publish_frame(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE source, MESSAGE_HANDLE message)
+{
+    BROKER_RESULT result;
+    int32_t msg_size;
+    int32_t buf_size;
+    /*Codes_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message with Message_ToTypedByteArray, which keeps the type of its typed properties. ]*/
+    msg_size = Message_ToTypedByteArray(message, NULL, 0);
+    if (msg_size < 0)
     {
-        result = BROKER_INVALIDARG;
-        LogError("invalid parameter (NULL).");
+        /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+        LogError("unable to serialize a message [%p]", message);
+        result = BROKER_ERROR;
     }
-    /*Codes_SRS_BROKER_99_014: [If `module_handle` or `module_apis` are `NULL` the function shall return `BROKER_INVALIDARG`.]*/
-    else if (module->module_apis == NULL || module->module_handle == NULL)
+    else
+    {
+        /*Codes_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ]*/
+        buf_size = msg_size + BROKER_FRAME_HEADER_SIZE;
+        void* nn_msg = nn_allocmsg(buf_size, 0);
+        if (nn_msg == NULL)
+        {
+            /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+            LogError("unable to serialize a message [%p]", message);
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_BROKER_17_026: [ Broker_Publish shall copy source into the beginning of the nanomsg buffer. ]*/
+            unsigned char *nn_msg_bytes = (unsigned char *)nn_msg;
+            memcpy(nn_msg_bytes, &source, sizeof(MODULE_HANDLE));
+#ifdef BROKER_LATENCY_STATS_ENABLED
+            uint64_t published_ns = get_time_ns();
+            memcpy(nn_msg_bytes + sizeof(MODULE_HANDLE), &published_ns, sizeof(uint64_t));
+#endif
+            /*Codes_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ]*/
+            nn_msg_bytes += BROKER_FRAME_HEADER_SIZE;
+            Message_ToTypedByteArray(message, nn_msg_bytes, msg_size);
+
+            /*Codes_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ]*/
+            int nbytes = nn_send(broker_data->publish_socket, &nn_msg, NN_MSG, 0);
+            GATEWAY_PROBE3(broker_publish_send, source, buf_size, nbytes);
+            if (nbytes != buf_size)
+            {
+                /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                LogError("unable to send a message [%p]", message);
+                /*Codes_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ]*/
+                nn_freemsg(nn_msg);
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                result = BROKER_OK;
+            }
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE message)
+{
+    BROKER_RESULT result;
+    GATEWAY_PROBE3(broker_publish_entry, broker, source, message);
+    /*Codes_SRS_BROKER_13_030: [If broker or message is NULL the function shall return BROKER_INVALIDARG.]*/
+    if (broker == NULL || source == NULL || message == NULL)
     {
         result = BROKER_INVALIDARG;
-        LogError("invalid parameter (NULL).");
+        LogError("Broker handle, source, and/or message handle is NULL");
     }
     else
     {
-        BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)malloc(sizeof(BROKER_MODULEINFO));
-        if (module_info == NULL)
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BROKER_17_022: [ Broker_Publish shall Lock the modules lock. ]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
         {
-            LogError("Allocate module info failed");
+            /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+            LogError("Lock on broker_data->modules_lock failed");
             result = BROKER_ERROR;
         }
         else
         {
-            if (init_module(module_info, module) != BROKER_OK)
+            bool send_message;
+            BROKER_FUSED_LINK* fused_link = acquire_fused_out(broker_data, source, &send_message);
+
+            if (!send_message)
             {
-                /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                LogError("start_module failed");
-                free(module_info->module);
-                free(module_info);
-                result = BROKER_ERROR;
+                result = BROKER_OK;
             }
             else
             {
-                /*Codes_SRS_BROKER_13_039: [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]*/
-                BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
-                if (Lock(broker_data->modules_lock) != LOCK_OK)
+                /*Codes_SRS_BROKER_17_007: [ Broker_Publish shall clone the message. ]*/
+                MESSAGE_HANDLE msg = Message_Clone(message);
+                result = publish_frame(broker_data, source, message);
+                /*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
+                Message_Destroy(msg);
+            }
+            /*Codes_SRS_BROKER_17_023: [ Broker_Publish shall Unlock the modules lock. ]*/
+            Unlock(broker_data->modules_lock);
+
+            /* the sink may publish in turn, so it is called once modules_lock is released */
+            if (fused_link != NULL && deliver_fused(fused_link, source, &message, 1) != 0 && result == BROKER_OK)
+            {
+                /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                result = BROKER_ERROR;
+            }
+        }
+
+    }
+    GATEWAY_PROBE3(broker_publish_return, broker, source, (int)result);
+    /*Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+    return result;
+}
+
+/* fires the entry and return probes of each message of a batch that was not published */
+static void probe_unpublished_batch(BROKER_HANDLE broker, MODULE_HANDLE source, const MESSAGE_HANDLE* messages, size_t count, BROKER_RESULT result)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        GATEWAY_PROBE3(broker_publish_entry, broker, source, (messages == NULL) ? NULL : messages[i]);
+        GATEWAY_PROBE3(broker_publish_return, broker, source, (int)result);
+    }
+    (void)broker;
+    (void)source;
+    (void)messages;
+    (void)result;
+}
+
+BROKER_RESULT Broker_PublishBatch(BROKER_HANDLE broker, MODULE_HANDLE source, const MESSAGE_HANDLE* messages, size_t count)
+{
+    BROKER_RESULT result;
+    size_t i;
+    /*Codes_SRS_BROKER_26_053: [ If `broker` or `source` is NULL, `messages` is NULL and `count` is not 0, or any of the `count` messages is NULL, Broker_PublishBatch shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || source == NULL || (messages == NULL && count > 0))
+    {
+        LogError("Broker handle, source, and/or messages is NULL");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        result = BROKER_OK;
+        for (i = 0; i < count; i++)
+        {
+            if (messages[i] == NULL)
+            {
+                LogError("message %zu of the batch is NULL", i);
+                result = BROKER_INVALIDARG;
+                break;
+            }
+        }
+    }
+
+    /* each message fires the entry and return probes Broker_Publish fires, whatever the path, so that tracing scripts can pair them */
+    if (result != BROKER_OK)
+    {
+        probe_unpublished_batch(broker, source, messages, count, result);
+    }
+    else if (count > 0)
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BROKER_26_054: [ Broker_PublishBatch shall publish each of the `count` messages, in order, as Broker_Publish does, locking the modules lock and looking up the source's fused link once for the whole batch and without cloning the messages. ]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_26_055: [ Broker_PublishBatch shall return BROKER_ERROR if an underlying API call fails, after trying to publish the rest of the batch, or BROKER_OK otherwise. ]*/
+            LogError("Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+            probe_unpublished_batch(broker, source, messages, count, result);
+        }
+        else
+        {
+            bool send_message;
+            BROKER_FUSED_LINK* fused_link = acquire_fused_out(broker_data, source, &send_message);
+
+            for (i = 0; i < count; i++)
+            {
+                BROKER_RESULT message_result = BROKER_OK;
+                GATEWAY_PROBE3(broker_publish_entry, broker, source, messages[i]);
+                if (send_message)
                 {
-                    /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                    LogError("Lock on broker_data->modules_lock failed");
-                    deinit_module(module_info);
-                    free(module_info);
-                    result = BROKER_ERROR;
+                    message_result = publish_frame(broker_data, source, messages[i]);
                 }
-                else
+                GATEWAY_PROBE3(broker_publish_return, broker, source, (int)message_result);
+                if (message_result != BROKER_OK)
                 {
-                    /*Codes_SRS_BROKER_13_045: [Broker_AddModule shall append the new instance of BROKER_MODULEINFO to BROKER_HANDLE_DATA::modules.]*/
-                    LIST_ITEM_HANDLE moduleListItem = singlylinkedlist_add(broker_data->modules, module_info);
-                    if (moduleListItem == NULL)
-                    {
-                        /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                        LogError("singlylinkedlist_add failed");
-                        deinit_module(module_info);
-                        free(module_info);
-                        result = BROKER_ERROR;
-                    }
-                    else
-                    {
-                        if (start_module(module_info, broker_data->url) != BROKER_OK)
-                        {
-                            LogError("start_module failed");
-                            deinit_module(module_info);
-                            singlylinkedlist_remove(broker_data->modules, moduleListItem);
-                            free(module_info);
-                            result = BROKER_ERROR;
-                        }
-                        else
-                        {
-                            /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                            result = BROKER_OK;
-                        }
-                    }
-
-                    /*Codes_SRS_BROKER_13_046: [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]*/
-                    Unlock(broker_data->modules_lock);
+                    /*Codes_SRS_BROKER_26_055: [ Broker_PublishBatch shall return BROKER_ERROR if an underlying API call fails, after trying to publish the rest of the batch, or BROKER_OK otherwise. ]*/
+                    result = BROKER_ERROR;
                 }
             }
+            Unlock(broker_data->modules_lock);
 
+            /* the sink may publish in turn, so it is called once modules_lock is released */
+            if (fused_link != NULL && deliver_fused(fused_link, source, messages, count) != 0)
+            {
+                /*Codes_SRS_BROKER_26_055: [ Broker_PublishBatch shall return BROKER_ERROR if an underlying API call fails, after trying to publish the rest of the batch, or BROKER_OK otherwise. ]*/
+                result = BROKER_ERROR;
+            }
         }
     }
-
     return result;
 }
 
-static bool find_module_predicate(LIST_ITEM_HANDLE list_item, const void* value)
+static int subscribe_once(BROKER_MODULEINFO* module_info, bool* subscribed, void* topic)
+{
+    int result;
+    if (*subscribed)
+    {
+        result = 0;
+    }
+    else if (nn_setsockopt(module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, &topic, sizeof(MODULE_HANDLE)) < 0)
+    {
+        LogError("unable to subscribe module [%p] to its requests", module_info);
+        result = __LINE__;
+    }
+    else
+    {
+        *subscribed = true;
+        result = 0;
+    }
+    return result;
+}
+
+/*correlation ids are request ids in decimal*/
+#define BROKER_CORRELATION_ID_SIZE 21
+
+static void format_correlation_id(uint64_t id, char correlation_id[BROKER_CORRELATION_ID_SIZE])
 {
-    BROKER_MODULEINFO* element = (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(list_item);
-    return element->module->module_handle == ((MODULE*)value)->module_handle;
+    size_t length = 0;
+    size_t i;
+
+    /* least significant digit first, then reversed */
+    do
+    {
+        correlation_id[length++] = (char)('0' + (id % 10));
+        id /= 10;
+    } while (id != 0);
+    correlation_id[length] = '\0';
+    for (i = 0; i < length / 2; i++)
+    {
+        char digit = correlation_id[i];
+        correlation_id[i] = correlation_id[length - 1 - i];
+        correlation_id[length - 1 - i] = digit;
+    }
 }
 
-BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
+static int parse_correlation_id(const char* correlation_id, uint64_t* id)
 {
-    /*Codes_SRS_BROKER_13_048: [If `broker` or `module` is NULL the function shall return BROKER_INVALIDARG.]*/
-    BROKER_RESULT result;
-    if (broker == NULL || module == NULL)
+    int result;
+    if (correlation_id == NULL || *correlation_id == '\0')
     {
-        /*Codes_SRS_BROKER_13_053: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-        result = BROKER_INVALIDARG;
-        LogError("invalid parameter (NULL).");
+        result = __LINE__;
     }
     else
     {
-        /*Codes_SRS_BROKER_13_088: [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]*/
-        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
-        if (Lock(broker_data->modules_lock) != LOCK_OK)
-        {
-            /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-            LogError("Lock on broker_data->modules_lock failed");
-            result = BROKER_ERROR;
-        }
-        else
+        result = 0;
+        *id = 0;
+        for (; result == 0 && *correlation_id != '\0'; correlation_id++)
         {
-            /*Codes_SRS_BROKER_13_049: [Broker_RemoveModule shall perform a linear search for module in BROKER_HANDLE_DATA::modules.]*/
-            LIST_ITEM_HANDLE module_info_item = singlylinkedlist_find(broker_data->modules, find_module_predicate, module);
-
-            if (module_info_item == NULL)
+            if (*correlation_id < '0' || *correlation_id > '9')
             {
-                /*Codes_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]*/
-                LogError("Supplied module is not attached to the broker");
-                result = BROKER_ERROR;
+                result = __LINE__;
             }
             else
             {
-                BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(module_info_item);
-                if (stop_module(broker_data->publish_socket, module_info) == 0)
-                {
-                    deinit_module(module_info);
-                }
-                else
-                {
-                    LogError("unable to stop module");
-                }
-
-                /*Codes_SRS_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]*/
-                singlylinkedlist_remove(broker_data->modules, module_info_item);
-                free(module_info);
-
-                /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                result = BROKER_OK;
+                *id = (*id * 10) + (uint64_t)(*correlation_id - '0');
             }
-
-            /*Codes_SRS_BROKER_13_054: [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]*/
-            Unlock(broker_data->modules_lock);
         }
     }
-
     return result;
 }
 
-BROKER_MODULEINFO* broker_locate_handle(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE handle)
+/*reads the correlation id of a request: the string property the broker sets
+or, in a request a module rebuilt with typed properties, an int64 property*/
+static int get_correlation_id(MESSAGE_HANDLE request, uint64_t* id)
 {
-    BROKER_MODULEINFO* result;
-    MODULE module;
-    module.module_apis = NULL;
-    module.module_handle = handle;
+    int result;
+    const char* correlation_id = Message_GetProperty(request, BROKER_CORRELATION_ID_PROPERTY);
+    int64_t typed_id;
+    if (correlation_id != NULL)
+    {
+        result = parse_correlation_id(correlation_id, id);
+    }
+    else if (Message_GetPropertyInt64(request, BROKER_CORRELATION_ID_PROPERTY, &typed_id) != 0 || typed_id < 0)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        *id = (uint64_t)typed_id;
+        result = 0;
+    }
+    return result;
+}
 
-    LIST_ITEM_HANDLE module_info_item = singlylinkedlist_find(broker_data->modules, find_module_predicate, &module);
-    if (module_info_item == NULL)
+/*removes the request `id` from the pending requests and returns it, or NULL if it is not pending; free it with free_request*/
+static BROKER_REQUEST* take_request(BROKER_REQUESTS* requests, uint64_t id)
+{
+    BROKER_REQUEST* result = NULL;
+    if (Lock(requests->lock) != LOCK_OK)
     {
-        result = NULL;
+        LogError("unable to lock the pending requests");
     }
     else
     {
-        result = (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(module_info_item);
+        BROKER_REQUEST** link = find_request(requests, id);
+        if (*link != NULL)
+        {
+            result = *link;
+            *link = result->bucket_next;
+            result->armed = false;
+        }
+        (void)Unlock(requests->lock);
     }
     return result;
 }
 
-BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
+/*sends `message` to `target` with the id of the request as its BROKER_CORRELATION_ID_PROPERTY*/
+static int send_request(BROKER_HANDLE_DATA* broker_data, BROKER_MODULEINFO* target, uint64_t id, MESSAGE_HANDLE message)
 {
-    BROKER_RESULT result;
-    /*Codes_SRS_BROKER_17_029: [ If broker or link are NULL, Broker_AddLink shall return BROKER_INVALIDARG. ]*/
-    if (broker == NULL || link == NULL || link->module_sink_handle == NULL || link->module_source_handle == NULL)
+    int result;
+    char correlation_id[BROKER_CORRELATION_ID_SIZE];
+    format_correlation_id(id, correlation_id);
+
+    MAP_HANDLE properties = Map_Create(NULL);
+    if (properties == NULL)
     {
-        LogError("Broker_AddLink, input is NULL.");
-        result = BROKER_INVALIDARG;
+        LogError("Map_Create failed");
+        result = __LINE__;
     }
     else
     {
-        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
-        /*Codes_SRS_BROKER_17_030: [ Broker_AddLink shall lock the modules_lock. ]*/
-        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        if (Map_AddOrUpdate(properties, BROKER_CORRELATION_ID_PROPERTY, correlation_id) != MAP_OK)
         {
-            /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
-            LogError("Broker_AddLink, Lock on broker_data->modules_lock failed");
-            result = BROKER_ADD_LINK_ERROR;
+            LogError("unable to set the correlation id of a request");
+            result = __LINE__;
         }
         else
         {
-            /*Codes_SRS_BROKER_17_031: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->sink. ]*/
-            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, link->module_sink_handle);
-
-            if (module_info == NULL)
+            MESSAGE_DERIVE_CONFIG derive_config = { properties, NULL, 0 };
+            MESSAGE_HANDLE request = Message_Derive(message, &derive_config);
+            if (request == NULL)
             {
-                /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
-                LogError("Link->sink is not attached to the broker");
-                result = BROKER_ADD_LINK_ERROR;
+                LogError("unable to add the correlation id to a request");
+                result = __LINE__;
             }
             else
             {
-                /*Codes_SRS_BROKER_17_041: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->module_source_handle. ]*/
-                BROKER_MODULEINFO* source_module = broker_locate_handle(broker_data, link->module_source_handle);
-
-                if (source_module == NULL)
-                {
-                    LogError("Link->source is not attached to the broker");
-                    result = BROKER_ADD_LINK_ERROR;
-                }
-                else
-                {
-                    /*Codes_SRS_BROKER_17_032: [ Broker_AddLink shall subscribe module_info->receive_socket to the link->source module handle. ]*/
-                    if (nn_setsockopt(
-                        module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, &(link->module_source_handle), sizeof(MODULE_HANDLE)) < 0)
-                    {
-                        /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
-                        LogError("Unable to make link in Broker");
-                        result = BROKER_ADD_LINK_ERROR;
-                    }
-                    else
-                    {
-                        result = BROKER_OK;
-                    }
-                }
+                result = send_frame(broker_data->publish_socket, BROKER_REQUEST_TOPIC(target), NULL, request);
+                Message_Destroy(request);
             }
-            /*Codes_SRS_BROKER_17_033: [ Broker_AddLink shall unlock the modules_lock. ]*/
-            Unlock(broker_data->modules_lock);
         }
+        Map_Destroy(properties);
     }
     return result;
 }
 
-BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
+BROKER_RESULT Broker_Request(BROKER_HANDLE broker, MODULE_HANDLE source, MODULE_HANDLE target, MESSAGE_HANDLE message, unsigned int timeout_ms, BROKER_REPLY_CALLBACK callback, void* context)
 {
     BROKER_RESULT result;
-    /*Codes_SRS_BROKER_17_035: [ If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_RemoveLink shall return BROKER_INVALIDARG. ]*/
-    if (broker == NULL || link == NULL || link->module_sink_handle == NULL || link->module_source_handle == NULL)
+    if (broker == NULL || source == NULL || target == NULL || message == NULL || timeout_ms == 0 || callback == NULL)
     {
-        LogError("Broker_AddLink, input is NULL.");
+        /*Codes_SRS_BROKER_26_019: [ If `broker`, `source`, `target`, `message` or `callback` is NULL, or `timeout_ms` is 0, Broker_Request shall return BROKER_INVALIDARG. ]*/
+        LogError("invalid parameter broker=[%p], source=[%p], target=[%p], message=[%p], timeout_ms=%u, callback=[%p]", broker, source, target, message, timeout_ms, callback);
         result = BROKER_INVALIDARG;
     }
     else
     {
         BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
-        /*Codes_SRS_BROKER_17_036: [ Broker_RemoveLink shall lock the modules_lock. ]*/
         if (Lock(broker_data->modules_lock) != LOCK_OK)
         {
-            /*Codes_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
-            LogError("Broker_AddLink, Lock on broker_data->modules_lock failed");
-            result = BROKER_REMOVE_LINK_ERROR;
+            /*Codes_SRS_BROKER_26_023: [ Broker_Request shall return BROKER_ERROR if either module is not attached to the broker or an underlying API call fails, and shall not call `callback` then. ]*/
+            LogError("Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
         }
         else
         {
-            /*Codes_SRS_BROKER_17_037: [ Broker_RemoveLink shall find the module_info for link->module_sink_handle. ]*/
-            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, link->module_sink_handle);
-
-            if (module_info == NULL)
+            BROKER_MODULEINFO* requester = broker_locate_handle(broker_data, source);
+            BROKER_MODULEINFO* responder = broker_locate_handle(broker_data, target);
+            if (requester == NULL || responder == NULL)
             {
-                /*Codes_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
-                LogError("Link->sink is not attached to the broker");
-                result = BROKER_REMOVE_LINK_ERROR;
+                /*Codes_SRS_BROKER_26_023: [ Broker_Request shall return BROKER_ERROR if either module is not attached to the broker or an underlying API call fails, and shall not call `callback` then. ]*/
+                LogError("source [%p] or target [%p] is not attached to the broker", source, target);
+                result = BROKER_ERROR;
+            }
+            /*Codes_SRS_BROKER_26_020: [ The first call to Broker_Request shall create the broker's table of pending requests and start the gateway timer service. ]*/
+            else if (broker_data->requests == NULL && (broker_data->requests = create_requests(broker_data->publish_socket)) == NULL)
+            {
+                result = BROKER_ERROR;
+            }
+            /*Codes_SRS_BROKER_26_021: [ The first time a module sends or receives a request, Broker_Request shall subscribe the module's receive_socket to its reply or request topic, so that requests and replies reach that module only, whatever its links. ]*/
+            else if (subscribe_once(responder, &responder->request_subscribed, BROKER_REQUEST_TOPIC(responder)) != 0 ||
+                subscribe_once(requester, &requester->reply_subscribed, BROKER_REPLY_TOPIC(requester)) != 0)
+            {
+                result = BROKER_ERROR;
             }
             else
             {
-                /*Codes_SRS_BROKER_17_042: [ Broker_RemoveLink shall find the module_info for link->module_source_handle. ]*/
-                BROKER_MODULEINFO* source_module_info = broker_locate_handle(broker_data, link->module_source_handle);
-                if (source_module_info == NULL)
+                BROKER_REQUESTS* requests = broker_data->requests;
+                BROKER_REQUEST* request = (BROKER_REQUEST*)malloc(sizeof(BROKER_REQUEST));
+                if (request == NULL)
                 {
-                    LogError("Link->source is not attached to the broker");
-                    result = BROKER_REMOVE_LINK_ERROR;
+                    LogError("unable to allocate a request");
+                    result = BROKER_ERROR;
+                }
+                else if (Lock(requests->lock) != LOCK_OK)
+                {
+                    LogError("unable to lock the pending requests");
+                    free(request);
+                    result = BROKER_ERROR;
                 }
                 else
                 {
-                    /*Codes_SRS_BROKER_17_038: [ Broker_RemoveLink shall unsubscribe module_info->receive_socket from the link->module_source_handle module handle. ]*/
-                    if (nn_setsockopt(
-                        module_info->receive_socket, NN_SUB, NN_SUB_UNSUBSCRIBE, &(link->module_source_handle), sizeof(MODULE_HANDLE)) < 0)
+                    /*Codes_SRS_BROKER_26_022: [ Broker_Request shall give the request a new id, add it to the pending requests and arm its timeout before sending `message` to `target`, with the id as its `correlationId` property. ]*/
+                    BROKER_REQUEST** link;
+                    uint64_t id = requests->next_id++;
+                    request->id = id;
+                    request->requests = requests;
+                    request->requester = requester;
+                    request->callback = callback;
+                    request->context = context;
+                    request->armed = true;
+                    link = find_request(requests, request->id);
+                    request->bucket_next = NULL;
+                    *link = request;
+                    /*Codes_SRS_BROKER_26_073: [ Broker_Request shall arm the timeout of the request by scheduling a one-shot gateway timer of `timeout_ms`. ]*/
+                    /* the timer cannot expire the request before the lock is released */
+                    request->timer = GatewayTimer_Schedule(timeout_ms, 0, expire_request, request);
+                    if (request->timer == NULL)
                     {
-                        /*Codes_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
-                        LogError("Unable to make link in Broker");
-                        result = BROKER_REMOVE_LINK_ERROR;
+                        /*Codes_SRS_BROKER_26_023: [ Broker_Request shall return BROKER_ERROR if either module is not attached to the broker or an underlying API call fails, and shall not call `callback` then. ]*/
+                        LogError("unable to schedule the timeout of a request");
+                        *link = NULL;
+                        (void)Unlock(requests->lock);
+                        free(request);
+                        result = BROKER_ERROR;
                     }
                     else
                     {
-                        result = BROKER_OK;
+                        (void)Unlock(requests->lock);
+
+                        /* once the lock is released, the request may complete at any time, so only its id is used */
+                        if (send_request(broker_data, responder, id, message) != 0)
+                        {
+                            /*Codes_SRS_BROKER_26_023: [ Broker_Request shall return BROKER_ERROR if either module is not attached to the broker or an underlying API call fails, and shall not call `callback` then. ]*/
+                            BROKER_REQUEST* failed = take_request(requests, id);
+                            if (failed != NULL)
+                            {
+                                free_request(failed);
+                            }
+                            result = BROKER_ERROR;
+                        }
+                        else
+                        {
+                            result = BROKER_OK;
+                        }
                     }
                 }
             }
-            /*Codes_SRS_BROKER_17_039: [ Broker_RemoveLink shall unlock the modules_lock. ]*/
             Unlock(broker_data->modules_lock);
         }
     }
     return result;
 }
 
-static void broker_decrement_ref(BROKER_HANDLE broker)
+BROKER_RESULT Broker_Reply(BROKER_HANDLE broker, MESSAGE_HANDLE request, MESSAGE_HANDLE reply)
 {
-    /*Codes_SRS_BROKER_13_058: [If `broker` is NULL the function shall do nothing.]*/
-    if (broker != NULL)
-    {
-        /*Codes_SRS_BROKER_13_111: [Otherwise, Broker_Destroy shall decrement the internal ref count of the message.]*/
-        /*Codes_SRS_BROKER_13_112: [If the ref count is zero then the allocated resources are freed.]*/
-        if (DEC_REF(BROKER_HANDLE_DATA, broker) == DEC_RETURN_ZERO)
-        {
-            BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker; 
-            if (singlylinkedlist_get_head_item(broker_data->modules) != NULL)
-            {
-                LogError("WARNING: There are still active modules attached to the broker and the broker is being destroyed.");
-            }
-            /* May want to do nn_shutdown first for cleanliness. */
-            nn_close(broker_data->publish_socket);
-            STRING_delete(broker_data->url);
-            singlylinkedlist_destroy(broker_data->modules);
-            Lock_Deinit(broker_data->modules_lock);
-            free(broker_data);
-        }
-    }
-    else
+    BROKER_RESULT result;
+    uint64_t id;
+    if (broker == NULL || request == NULL || reply == NULL)
     {
-        LogError("broker handle is NULL");
+        /*Codes_SRS_BROKER_26_029: [ If `broker`, `request` or `reply` is NULL, Broker_Reply shall return BROKER_INVALIDARG. ]*/
+        LogError("invalid parameter broker=[%p], request=[%p], reply=[%p]", broker, request, reply);
+        result = BROKER_INVALIDARG;
     }
-}
-
-extern void Broker_Destroy(BROKER_HANDLE broker)
-{
-    broker_decrement_ref(broker);
-}
-
-extern void Broker_DecRef(BROKER_HANDLE broker)
-{
-    /*Codes_SRS_BROKER_13_113: [This function shall implement all the requirements of the Broker_Destroy API.]*/
-    broker_decrement_ref(broker);
-}
-
-BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE message)
-{
-    BROKER_RESULT result;
-    /*Codes_SRS_BROKER_13_030: [If broker or message is NULL the function shall return BROKER_INVALIDARG.]*/
-    if (broker == NULL || source == NULL || message == NULL)
+    /*Codes_SRS_BROKER_26_030: [ Broker_Reply shall return BROKER_INVALIDARG if `request` has no valid `correlationId` property. ]*/
+    /*Codes_SRS_BROKER_26_070: [ Broker_Reply shall read the `correlationId` of `request` from its string property or, if it has none, from a typed int64 property. ]*/
+    else if (get_correlation_id(request, &id) != 0)
     {
+        LogError("the request has no valid %s property", BROKER_CORRELATION_ID_PROPERTY);
         result = BROKER_INVALIDARG;
-        LogError("Broker handle, source, and/or message handle is NULL");
     }
     else
     {
         BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
-        /*Codes_SRS_BROKER_17_022: [ Broker_Publish shall Lock the modules lock. ]*/
         if (Lock(broker_data->modules_lock) != LOCK_OK)
         {
-            /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
             LogError("Lock on broker_data->modules_lock failed");
             result = BROKER_ERROR;
         }
         else
         {
-            int32_t msg_size;
-            int32_t buf_size;
-            /*Codes_SRS_BROKER_17_007: [ Broker_Publish shall clone the message. ]*/
-            MESSAGE_HANDLE msg = Message_Clone(message);
-            /*Codes_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ]*/
-            msg_size = Message_ToByteArray(message, NULL, 0);
-            if (msg_size < 0)
+            BROKER_REQUESTS* requests = broker_data->requests;
+            BROKER_MODULEINFO* requester = NULL;
+            if (requests == NULL)
             {
-                /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                LogError("unable to serialize a message [%p]", msg);
-                Message_Destroy(msg);
-                result = BROKER_ERROR;
+                LogError("no request was sent through the broker");
+            }
+            else if (Lock(requests->lock) != LOCK_OK)
+            {
+                LogError("unable to lock the pending requests");
             }
             else
             {
-                /*Codes_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ]*/
-                buf_size = msg_size + sizeof(MODULE_HANDLE);
-                void* nn_msg = nn_allocmsg(buf_size, 0);
-                if (nn_msg == NULL)
+                BROKER_REQUEST* pending = *find_request(requests, id);
+                if (pending != NULL && pending->armed)
                 {
-                    /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                    LogError("unable to serialize a message [%p]", msg);
-                    result = BROKER_ERROR;
+                    /* a disarmed request cannot time out, and no other reply is accepted for it */
+                    pending->armed = false;
+                    requester = pending->requester;
                 }
-                else
-                {
-                    /*Codes_SRS_BROKER_17_026: [ Broker_Publish shall copy source into the beginning of the nanomsg buffer. ]*/
-                    unsigned char *nn_msg_bytes = (unsigned char *)nn_msg;
-                    memcpy(nn_msg_bytes, &source, sizeof(MODULE_HANDLE));
-                    /*Codes_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ]*/
-                    nn_msg_bytes += sizeof(MODULE_HANDLE);
-                    Message_ToByteArray(message, nn_msg_bytes, msg_size);
+                (void)Unlock(requests->lock);
+            }
 
-                    /*Codes_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ]*/
-                    int nbytes = nn_send(broker_data->publish_socket, &nn_msg, NN_MSG, 0);
-                    if (nbytes != buf_size)
-                    {
-                        /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                        LogError("unable to send a message [%p]", msg);
-                        /*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
-                        nn_freemsg(nn_msg);
-                        result = BROKER_ERROR;
-                    }
-                    else
-                    {
-                        result = BROKER_OK;
-                    }
+            if (requester == NULL)
+            {
+                /*Codes_SRS_BROKER_26_031: [ Broker_Reply shall return BROKER_ERROR if the request is no longer pending because it timed out, was already replied to or its requester was removed. ]*/
+                LogError("the request is no longer pending");
+                result = BROKER_ERROR;
+            }
+            /*Codes_SRS_BROKER_26_032: [ Broker_Reply shall send the request id and `reply` to the requesting module only. ]*/
+            else if (send_frame(broker_data->publish_socket, BROKER_REPLY_TOPIC(requester), &id, reply) != 0)
+            {
+                /*Codes_SRS_BROKER_26_033: [ If the reply cannot be sent, Broker_Reply shall complete the request with BROKER_REQUEST_ERROR and return BROKER_ERROR. ]*/
+                BROKER_REQUEST* failed = take_request(requests, id);
+                if (failed != NULL)
+                {
+                    failed->callback(failed->context, BROKER_REQUEST_ERROR, NULL);
+                    free_request(failed);
                 }
-                /*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
-                Message_Destroy(msg);
-                /*Codes_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ]*/
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                result = BROKER_OK;
             }
-            /*Codes_SRS_BROKER_17_023: [ Broker_Publish shall Unlock the modules lock. ]*/
             Unlock(broker_data->modules_lock);
         }
-
     }
-    /*Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
     return result;
-}
\ No newline at end of file
+}
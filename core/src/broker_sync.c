@@ -0,0 +1,675 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/*
+ * A broker that implements broker.h without threads, sockets or queues:
+ * Broker_Publish calls the Module_Receive of every module linked from the
+ * source, in link order, on the publishing thread, and records how long each
+ * call took in the module's BROKER_LATENCY_HISTOGRAM. Benchmarks use it to
+ * measure what a module costs without the noise of the threaded broker.
+ *
+ * The gateway is built with it instead of broker.c when `use_sync_broker` is
+ * ON, and module_bench links it ahead of the gateway library.
+ *
+ * It is not thread safe: modules must publish from their Module_Receive or
+ * from the thread that drives the broker, and must not be added or removed
+ * while a message is being delivered.
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/refcount.h"
+#include "azure_c_shared_utility/map.h"
+
+#include "message.h"
+#include "module.h"
+#include "module_access.h"
+#include "broker.h"
+
+typedef struct SYNC_BROKER_MODULE_TAG
+{
+    MODULE_DISPATCH dispatch;
+    /** Time spent in Module_Receive, per message */
+    BROKER_LATENCY_HISTOGRAM receive_time;
+    /** Module this one replaces, until that module is removed; messages
+     *  are not delivered to this one before then
+     */
+    struct SYNC_BROKER_MODULE_TAG* replaces;
+    struct SYNC_BROKER_MODULE_TAG* next;
+} SYNC_BROKER_MODULE;
+
+typedef struct SYNC_BROKER_LINK_TAG
+{
+    MODULE_HANDLE source;
+    SYNC_BROKER_MODULE* sink;
+} SYNC_BROKER_LINK;
+
+/** A request whose target's Module_Receive is running */
+typedef struct SYNC_BROKER_REQUEST_TAG
+{
+    uint64_t id;
+    bool replied;
+    BROKER_REPLY_CALLBACK callback;
+    void* context;
+    /** Request being delivered when this one was made, from Module_Receive */
+    struct SYNC_BROKER_REQUEST_TAG* outer;
+} SYNC_BROKER_REQUEST;
+
+typedef struct BROKER_HANDLE_DATA_TAG
+{
+    SYNC_BROKER_MODULE* modules;
+    /** Links in the order they were added, which is the delivery order */
+    SYNC_BROKER_LINK* links;
+    size_t link_count;
+    SYNC_BROKER_REQUEST* requests;
+    uint64_t next_request_id;
+} BROKER_HANDLE_DATA;
+
+DEFINE_REFCOUNT_TYPE(BROKER_HANDLE_DATA);
+
+/*correlation ids are request ids in decimal, as in broker.c*/
+#define SYNC_BROKER_CORRELATION_ID_SIZE 21
+
+static uint64_t get_time_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    (void)QueryPerformanceCounter(&counter);
+    (void)QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)counter.QuadPart * 1000000000.0 / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static void record_receive_time(BROKER_LATENCY_HISTOGRAM* histogram, uint64_t elapsed_ns)
+{
+    size_t bucket = 0;
+    uint64_t remaining = elapsed_ns;
+    while (remaining > 1 && bucket < BROKER_LATENCY_BUCKETS - 1)
+    {
+        remaining >>= 1;
+        bucket++;
+    }
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->total_ns += elapsed_ns;
+    if (elapsed_ns > histogram->max_ns)
+    {
+        histogram->max_ns = elapsed_ns;
+    }
+}
+
+static void deliver(SYNC_BROKER_MODULE* sink, MESSAGE_HANDLE message)
+{
+    /*Codes_SRS_BROKER_SYNC_26_004: [ `Broker_Publish` shall add the time each `Module_Receive` call took to the receiving module's latency histogram. ]*/
+    uint64_t start_ns = get_time_ns();
+    MODULE_DISPATCH_RECEIVE(sink->dispatch, message);
+    record_receive_time(&sink->receive_time, get_time_ns() - start_ns);
+}
+
+static SYNC_BROKER_MODULE* find_module(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE handle)
+{
+    SYNC_BROKER_MODULE* module = broker_data->modules;
+    while (module != NULL && module->dispatch.module_handle != handle)
+    {
+        module = module->next;
+    }
+    return module;
+}
+
+BROKER_HANDLE Broker_Create(void)
+{
+    /*Codes_SRS_BROKER_SYNC_26_001: [ `Broker_Create` shall return `NULL` if it cannot allocate the broker, or a broker with no modules and no links otherwise. ]*/
+    BROKER_HANDLE_DATA* result = REFCOUNT_TYPE_CREATE(BROKER_HANDLE_DATA);
+    if (result == NULL)
+    {
+        LogError("malloc returned NULL");
+    }
+    else
+    {
+        result->modules = NULL;
+        result->links = NULL;
+        result->link_count = 0;
+        result->requests = NULL;
+        result->next_request_id = 1;
+    }
+    return result;
+}
+
+void Broker_IncRef(BROKER_HANDLE broker)
+{
+    if (broker == NULL)
+    {
+        LogError("invalid arg: broker is NULL");
+    }
+    else
+    {
+        INC_REF(BROKER_HANDLE_DATA, broker);
+    }
+}
+
+static void broker_decrement_ref(BROKER_HANDLE broker)
+{
+    if (broker == NULL)
+    {
+        LogError("broker handle is NULL");
+    }
+    else if (DEC_REF(BROKER_HANDLE_DATA, broker) == DEC_RETURN_ZERO)
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        if (broker_data->modules != NULL)
+        {
+            LogError("WARNING: There are still active modules attached to the broker and the broker is being destroyed.");
+        }
+        while (broker_data->modules != NULL)
+        {
+            SYNC_BROKER_MODULE* module = broker_data->modules;
+            broker_data->modules = module->next;
+            free(module);
+        }
+        free(broker_data->links);
+        free(broker_data);
+    }
+}
+
+void Broker_Destroy(BROKER_HANDLE broker)
+{
+    broker_decrement_ref(broker);
+}
+
+void Broker_DecRef(BROKER_HANDLE broker)
+{
+    broker_decrement_ref(broker);
+}
+
+BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE message)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_SYNC_26_002: [ If `broker`, `source`, or `message` is `NULL` the function shall return `BROKER_INVALIDARG`. ]*/
+    if (broker == NULL || source == NULL || message == NULL)
+    {
+        LogError("Broker handle, source, and/or message handle is NULL");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        size_t i;
+        /*Codes_SRS_BROKER_SYNC_26_003: [ `Broker_Publish` shall call `Module_Receive` of every module linked from `source` with `message`, on the calling thread, in the order the links were added, and return `BROKER_OK` once every call has returned. ]*/
+        /* the message is immutable, so every sink receives the publisher's handle rather than a copy */
+        for (i = 0; i < broker_data->link_count; i++)
+        {
+            /*Codes_SRS_BROKER_SYNC_26_017: [ `Broker_Publish` shall not deliver to a module added with `Broker_AddReplacementModule` until the module it replaces is removed. ]*/
+            if (broker_data->links[i].source == source && broker_data->links[i].sink->replaces == NULL)
+            {
+                deliver(broker_data->links[i].sink, message);
+            }
+        }
+        result = BROKER_OK;
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_PublishBatch(BROKER_HANDLE broker, MODULE_HANDLE source, const MESSAGE_HANDLE* messages, size_t count)
+{
+    BROKER_RESULT result;
+    if (broker == NULL || source == NULL || (messages == NULL && count > 0))
+    {
+        LogError("Broker handle, source, and/or messages is NULL");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        size_t i;
+        result = BROKER_OK;
+        /*Codes_SRS_BROKER_SYNC_26_015: [ `Broker_PublishBatch` shall return `BROKER_INVALIDARG` without publishing if any of the `count` messages is NULL, and call `Broker_Publish` with each of them in order otherwise. ]*/
+        for (i = 0; i < count; i++)
+        {
+            if (messages[i] == NULL)
+            {
+                LogError("message %zu of the batch is NULL", i);
+                result = BROKER_INVALIDARG;
+                break;
+            }
+        }
+        for (i = 0; i < count && result == BROKER_OK; i++)
+        {
+            result = Broker_Publish(broker, source, messages[i]);
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
+{
+    return Broker_AddModuleWithDelivery(broker, module, NULL);
+}
+
+BROKER_RESULT Broker_AddModuleWithDelivery(BROKER_HANDLE broker, const MODULE* module, const BROKER_MODULE_DELIVERY* delivery)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_SYNC_26_005: [ `Broker_AddModuleWithDelivery` shall ignore `delivery` and attach `module` as `Broker_AddModule` does. ]*/
+    /* every message is delivered on the publishing thread, so `delivery` does not apply */
+    (void)delivery;
+    if (broker == NULL || module == NULL || module->module_apis == NULL || module->module_handle == NULL)
+    {
+        LogError("invalid parameter (NULL).");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        SYNC_BROKER_MODULE* sync_module = (SYNC_BROKER_MODULE*)malloc(sizeof(SYNC_BROKER_MODULE));
+        if (sync_module == NULL)
+        {
+            LogError("Allocate module info failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            MODULE_DISPATCH_INIT(sync_module->dispatch, module->module_apis, module->module_handle);
+            memset(&sync_module->receive_time, 0, sizeof(BROKER_LATENCY_HISTOGRAM));
+            sync_module->replaces = NULL;
+            sync_module->next = broker_data->modules;
+            broker_data->modules = sync_module;
+            result = BROKER_OK;
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_AddReplacementModule(BROKER_HANDLE broker, const MODULE* module, const BROKER_MODULE_DELIVERY* delivery, const MODULE* replaced)
+{
+    BROKER_RESULT result;
+    if (broker == NULL || module == NULL || replaced == NULL || replaced->module_handle == NULL || replaced->module_handle == module->module_handle)
+    {
+        LogError("invalid parameter broker=[%p], module=[%p], replaced=[%p]", broker, module, replaced);
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        SYNC_BROKER_MODULE* replaced_module = find_module(broker_data, replaced->module_handle);
+        SYNC_BROKER_MODULE* other = broker_data->modules;
+        while (other != NULL && other->replaces != replaced_module)
+        {
+            other = other->next;
+        }
+
+        /*Codes_SRS_BROKER_SYNC_26_016: [ `Broker_AddReplacementModule` shall return `BROKER_ERROR` if `replaced` is not attached or another module is replacing it, and otherwise attach `module` as `Broker_AddModule` does. ]*/
+        if (replaced_module == NULL || other != NULL)
+        {
+            LogError("the replaced module is not attached to the broker or is already being replaced");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            result = Broker_AddModuleWithDelivery(broker, module, delivery);
+            if (result == BROKER_OK)
+            {
+                /* Broker_AddModuleWithDelivery puts the module at the head of the list */
+                broker_data->modules->replaces = replaced_module;
+            }
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_GetLatencyHistogram(BROKER_HANDLE broker, const MODULE* module, BROKER_LATENCY_HISTOGRAM* histogram)
+{
+    BROKER_RESULT result;
+    if (broker == NULL || module == NULL || histogram == NULL)
+    {
+        LogError("invalid parameter broker=[%p], module=[%p], histogram=[%p]", broker, module, histogram);
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_SYNC_26_006: [ `Broker_GetLatencyHistogram` shall copy the histogram of the time spent in `module`'s `Module_Receive` into `histogram`, or return `BROKER_ERROR` if `module` is not attached. ]*/
+        SYNC_BROKER_MODULE* sync_module = find_module((BROKER_HANDLE_DATA*)broker, module->module_handle);
+        if (sync_module == NULL)
+        {
+            LogError("Supplied module is not attached to the broker");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            /* there is no publish-to-receive latency here, only the time spent in Module_Receive */
+            *histogram = sync_module->receive_time;
+            result = BROKER_OK;
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_GetStallStats(BROKER_HANDLE broker, const MODULE* module, BROKER_STALL_STATS* stats)
+{
+    BROKER_RESULT result;
+    if (broker == NULL || module == NULL || stats == NULL)
+    {
+        LogError("invalid parameter broker=[%p], module=[%p], stats=[%p]", broker, module, stats);
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_SYNC_26_014: [ `Broker_GetStallStats` shall return `BROKER_ERROR`, since a stalled `Module_Receive` stalls the publisher rather than a watched thread. ]*/
+        LogError("the synchronous broker does not watch receives");
+        result = BROKER_ERROR;
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_GetQueueStats(BROKER_HANDLE broker, const MODULE* module, BROKER_QUEUE_STATS* stats)
+{
+    BROKER_RESULT result;
+    if (broker == NULL || module == NULL || stats == NULL)
+    {
+        LogError("invalid parameter broker=[%p], module=[%p], stats=[%p]", broker, module, stats);
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_SYNC_26_019: [ `Broker_GetQueueStats` shall return `BROKER_ERROR`, since messages are delivered by the publisher and never wait on a lane. ]*/
+        LogError("the synchronous broker does not queue deliveries");
+        result = BROKER_ERROR;
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
+{
+    BROKER_RESULT result;
+    if (broker == NULL || module == NULL)
+    {
+        LogError("invalid parameter (NULL).");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        SYNC_BROKER_MODULE** link = &broker_data->modules;
+        while (*link != NULL && (*link)->dispatch.module_handle != module->module_handle)
+        {
+            link = &(*link)->next;
+        }
+
+        if (*link == NULL)
+        {
+            LogError("Supplied module is not attached to the broker");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            SYNC_BROKER_MODULE* removed = *link;
+            SYNC_BROKER_MODULE* successor = broker_data->modules;
+            size_t kept = 0;
+            size_t i;
+            while (successor != NULL && successor->replaces != removed)
+            {
+                successor = successor->next;
+            }
+            /*Codes_SRS_BROKER_SYNC_26_007: [ `Broker_RemoveModule` shall detach `module` and remove every link into it. ]*/
+            /*Codes_SRS_BROKER_SYNC_26_018: [ If another module is replacing `module`, `Broker_RemoveModule` shall also remove every link from `module`, and deliver to the replacing module from then on. ]*/
+            /* drop the links into the module, as closing its socket does in broker.c, and
+               the links from a replaced module, as its retire frame does */
+            for (i = 0; i < broker_data->link_count; i++)
+            {
+                if (broker_data->links[i].sink != removed &&
+                    (successor == NULL || broker_data->links[i].source != removed->dispatch.module_handle))
+                {
+                    broker_data->links[kept++] = broker_data->links[i];
+                }
+            }
+            broker_data->link_count = kept;
+            if (successor != NULL)
+            {
+                successor->replaces = NULL;
+            }
+            *link = removed->next;
+            free(removed);
+            result = BROKER_OK;
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
+{
+    BROKER_RESULT result;
+    if (broker == NULL || link == NULL || link->module_sink_handle == NULL || link->module_source_handle == NULL)
+    {
+        LogError("Broker_AddLink, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        SYNC_BROKER_MODULE* sink = find_module(broker_data, link->module_sink_handle);
+        /*Codes_SRS_BROKER_SYNC_26_008: [ `Broker_AddLink` shall return `BROKER_ADD_LINK_ERROR` if the source or the sink of `link` is not attached to the broker. ]*/
+        if (sink == NULL || find_module(broker_data, link->module_source_handle) == NULL)
+        {
+            LogError("Link->sink or link->source is not attached to the broker");
+            result = BROKER_ADD_LINK_ERROR;
+        }
+        else
+        {
+            SYNC_BROKER_LINK* links = (SYNC_BROKER_LINK*)realloc(broker_data->links, (broker_data->link_count + 1) * sizeof(SYNC_BROKER_LINK));
+            if (links == NULL)
+            {
+                LogError("Unable to make link in Broker");
+                result = BROKER_ADD_LINK_ERROR;
+            }
+            else
+            {
+                links[broker_data->link_count].source = link->module_source_handle;
+                links[broker_data->link_count].sink = sink;
+                broker_data->links = links;
+                broker_data->link_count++;
+                result = BROKER_OK;
+            }
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_AddFusedLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
+{
+    /*Codes_SRS_BROKER_SYNC_26_013: [ `Broker_AddFusedLink` shall add `link` as `Broker_AddLink` does, since every link already delivers on the publishing thread. ]*/
+    return Broker_AddLink(broker, link);
+}
+
+BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
+{
+    BROKER_RESULT result;
+    if (broker == NULL || link == NULL || link->module_sink_handle == NULL || link->module_source_handle == NULL)
+    {
+        LogError("Broker_RemoveLink, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        SYNC_BROKER_MODULE* sink = find_module(broker_data, link->module_sink_handle);
+        if (sink == NULL || find_module(broker_data, link->module_source_handle) == NULL)
+        {
+            LogError("Link->sink or link->source is not attached to the broker");
+            result = BROKER_REMOVE_LINK_ERROR;
+        }
+        else
+        {
+            size_t kept = 0;
+            size_t i;
+            for (i = 0; i < broker_data->link_count; i++)
+            {
+                if (broker_data->links[i].source != link->module_source_handle || broker_data->links[i].sink != sink)
+                {
+                    broker_data->links[kept++] = broker_data->links[i];
+                }
+            }
+            broker_data->link_count = kept;
+            result = BROKER_OK;
+        }
+    }
+    return result;
+}
+
+static void format_correlation_id(uint64_t id, char correlation_id[SYNC_BROKER_CORRELATION_ID_SIZE])
+{
+    size_t length = 0;
+    size_t i;
+
+    do
+    {
+        correlation_id[length++] = (char)('0' + (id % 10));
+        id /= 10;
+    } while (id != 0);
+    correlation_id[length] = '\0';
+    for (i = 0; i < length / 2; i++)
+    {
+        char digit = correlation_id[i];
+        correlation_id[i] = correlation_id[length - 1 - i];
+        correlation_id[length - 1 - i] = digit;
+    }
+}
+
+static MESSAGE_HANDLE derive_request(MESSAGE_HANDLE message, uint64_t id)
+{
+    MESSAGE_HANDLE result;
+    char correlation_id[SYNC_BROKER_CORRELATION_ID_SIZE];
+    MAP_HANDLE properties = Map_Create(NULL);
+
+    format_correlation_id(id, correlation_id);
+    if (properties == NULL)
+    {
+        LogError("Map_Create failed");
+        result = NULL;
+    }
+    else
+    {
+        if (Map_AddOrUpdate(properties, BROKER_CORRELATION_ID_PROPERTY, correlation_id) != MAP_OK)
+        {
+            LogError("unable to set the correlation id of a request");
+            result = NULL;
+        }
+        else
+        {
+            MESSAGE_DERIVE_CONFIG derive_config = { properties, NULL, 0 };
+            result = Message_Derive(message, &derive_config);
+        }
+        Map_Destroy(properties);
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_Request(BROKER_HANDLE broker, MODULE_HANDLE source, MODULE_HANDLE target, MESSAGE_HANDLE message, unsigned int timeout_ms, BROKER_REPLY_CALLBACK callback, void* context)
+{
+    BROKER_RESULT result;
+    if (broker == NULL || source == NULL || target == NULL || message == NULL || timeout_ms == 0 || callback == NULL)
+    {
+        LogError("invalid parameter broker=[%p], source=[%p], target=[%p], message=[%p], timeout_ms=%u, callback=[%p]", broker, source, target, message, timeout_ms, callback);
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        SYNC_BROKER_MODULE* responder = find_module(broker_data, target);
+        if (responder == NULL || find_module(broker_data, source) == NULL)
+        {
+            LogError("source [%p] or target [%p] is not attached to the broker", source, target);
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            SYNC_BROKER_REQUEST request;
+            MESSAGE_HANDLE derived;
+            /*Codes_SRS_BROKER_SYNC_26_009: [ `Broker_Request` shall derive a message from `message` with a new `correlationId` property and call `target`'s `Module_Receive` with it on the calling thread. ]*/
+            request.id = broker_data->next_request_id++;
+            derived = derive_request(message, request.id);
+            if (derived == NULL)
+            {
+                LogError("unable to add the correlation id to a request");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                request.replied = false;
+                request.callback = callback;
+                request.context = context;
+                request.outer = broker_data->requests;
+                broker_data->requests = &request;
+                deliver(responder, derived);
+                broker_data->requests = request.outer;
+                Message_Destroy(derived);
+
+                /*Codes_SRS_BROKER_SYNC_26_010: [ If `target` has not replied when its `Module_Receive` returns, `Broker_Request` shall call `callback` with `BROKER_REQUEST_TIMEOUT` before returning, without waiting for `timeout_ms`. ]*/
+                /* the target replies from its Module_Receive or not at all, so there is no need to wait for timeout_ms */
+                if (!request.replied)
+                {
+                    callback(context, BROKER_REQUEST_TIMEOUT, NULL);
+                }
+                result = BROKER_OK;
+            }
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_Reply(BROKER_HANDLE broker, MESSAGE_HANDLE request, MESSAGE_HANDLE reply)
+{
+    BROKER_RESULT result;
+    const char* correlation_id;
+    if (broker == NULL || request == NULL || reply == NULL)
+    {
+        LogError("invalid parameter broker=[%p], request=[%p], reply=[%p]", broker, request, reply);
+        result = BROKER_INVALIDARG;
+    }
+    else if ((correlation_id = Message_GetProperty(request, BROKER_CORRELATION_ID_PROPERTY)) == NULL)
+    {
+        LogError("the request has no %s property", BROKER_CORRELATION_ID_PROPERTY);
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        SYNC_BROKER_REQUEST* pending = broker_data->requests;
+        char expected[SYNC_BROKER_CORRELATION_ID_SIZE];
+        while (pending != NULL)
+        {
+            format_correlation_id(pending->id, expected);
+            if (strcmp(expected, correlation_id) == 0)
+            {
+                break;
+            }
+            pending = pending->outer;
+        }
+
+        /*Codes_SRS_BROKER_SYNC_26_012: [ `Broker_Reply` shall return `BROKER_ERROR` if no request being delivered matches or the request was already replied to. ]*/
+        if (pending == NULL || pending->replied)
+        {
+            LogError("the request is no longer pending");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_BROKER_SYNC_26_011: [ `Broker_Reply` shall call the callback of the request being delivered whose `correlationId` matches `request`'s with `BROKER_REQUEST_REPLIED` and `reply` before returning. ]*/
+            pending->replied = true;
+            pending->callback(pending->context, BROKER_REQUEST_REPLIED, reply);
+            result = BROKER_OK;
+        }
+    }
+    return result;
+}
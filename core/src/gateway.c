@@ -186,10 +186,17 @@ GATEWAY_START_RESULT Gateway_Start(GATEWAY_HANDLE gw)
             pfModule_Start pfStart = MODULE_START((*module_data)->module_loader->api->GetApi((*module_data)->module_loader, (*module_data)->module_library_handle));
             if (pfStart != NULL)
             {
+#ifdef MODULE_ALLOC_STATS_ENABLED
+                MODULE_ALLOC_TAG previous_alloc_tag = ModuleAlloc_SetThreadTag((*module_data)->alloc_tag);
+#endif
                 /*Codes_SRS_GATEWAY_17_010: [ This function shall call Module_Start for every module which defines the start function. ]*/
                 (pfStart)((*module_data)->module);
+#ifdef MODULE_ALLOC_STATS_ENABLED
+                (void)ModuleAlloc_SetThreadTag(previous_alloc_tag);
+#endif
             }
         }
+        gateway_handle->started = true;
         /*Codes_SRS_GATEWAY_17_012: [ This function shall report a GATEWAY_STARTED event. ]*/
         EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_STARTED);
         /*Codes_SRS_GATEWAY_17_013: [ This function shall return GATEWAY_START_SUCCESS upon completion. ]*/
@@ -248,8 +255,14 @@ extern void Gateway_StartModule(GATEWAY_HANDLE gw, MODULE_HANDLE module)
             pfModule_Start pfStart = MODULE_START((*module_data)->module_loader->api->GetApi((*module_data)->module_loader, (*module_data)->module_library_handle));
             if (pfStart != NULL)
             {
+#ifdef MODULE_ALLOC_STATS_ENABLED
+                MODULE_ALLOC_TAG previous_alloc_tag = ModuleAlloc_SetThreadTag((*module_data)->alloc_tag);
+#endif
                 /*Codes_SRS_GATEWAY_17_008: [ When module is found, if the Module_Start function is defined for this module, the Module_Start function shall be called. ]*/
                 (pfStart)((*module_data)->module);
+#ifdef MODULE_ALLOC_STATS_ENABLED
+                (void)ModuleAlloc_SetThreadTag(previous_alloc_tag);
+#endif
             }
         }
         else
@@ -293,6 +306,41 @@ void Gateway_RemoveModule(GATEWAY_HANDLE gw, MODULE_HANDLE module)
     }
 }
 
+MODULE_HANDLE Gateway_ReplaceModule(GATEWAY_HANDLE gw, const char* module_name, const GATEWAY_MODULES_ENTRY* entry)
+{
+    MODULE_HANDLE module;
+    /*Codes_SRS_GATEWAY_26_027: [ If `gw`, `module_name` or `entry` is NULL, the function shall return NULL. ]*/
+    if (gw != NULL && module_name != NULL && entry != NULL)
+    {
+        MODULE_DATA **module_data = (MODULE_DATA**)VECTOR_find_if(gw->modules, module_name_find, module_name);
+        if (module_data != NULL)
+        {
+            module = gateway_replacemodule_internal(gw, module_data, entry);
+            if (module == NULL)
+            {
+                LogError("Gateway_ReplaceModule(): Unable to replace module '%s'.", module_name);
+            }
+            else
+            {
+                /*Codes_SRS_GATEWAY_26_038: [ The function shall report `GATEWAY_MODULE_LIST_CHANGED` event after successfully replacing the module, and return the new module's MODULE_HANDLE. ]*/
+                EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_MODULE_LIST_CHANGED);
+            }
+        }
+        else
+        {
+            /*Codes_SRS_GATEWAY_26_028: [ If no module is named `module_name`, the function shall return NULL. ]*/
+            module = NULL;
+            LogError("Gateway_ReplaceModule(): Couldn't find module with the specified name");
+        }
+    }
+    else
+    {
+        module = NULL;
+        LogError("Gateway_ReplaceModule(): invalid argument gw = %p, module_name = %p, entry = %p.", gw, module_name, entry);
+    }
+    return module;
+}
+
 int Gateway_RemoveModuleByName(GATEWAY_HANDLE gw, const char *module_name)
 {
     int result;
@@ -322,6 +370,119 @@ int Gateway_RemoveModuleByName(GATEWAY_HANDLE gw, const char *module_name)
     return result;
 }
 
+int Gateway_GetModuleAllocStats(GATEWAY_HANDLE gw, const char* module_name, MODULE_ALLOC_STATS* stats)
+{
+    int result;
+    if (gw == NULL || module_name == NULL || stats == NULL)
+    {
+        LogError("invalid argument gw=%p, module_name=%p, stats=%p", gw, module_name, stats);
+        result = __LINE__;
+    }
+    else
+    {
+        MODULE_DATA **module_data = (MODULE_DATA**)VECTOR_find_if(gw->modules, module_name_find, module_name);
+        if (module_data == NULL)
+        {
+            LogError("Couldn't find module with the specified name");
+            result = __LINE__;
+        }
+        else if ((*module_data)->alloc_tag == NULL)
+        {
+            LogError("allocation statistics are not available, build the gateway with enable_module_alloc_stats");
+            result = __LINE__;
+        }
+        else
+        {
+            result = ModuleAlloc_GetStats((*module_data)->alloc_tag, stats);
+        }
+    }
+    return result;
+}
+
+int Gateway_SetModuleAllocBudget(GATEWAY_HANDLE gw, const char* module_name, size_t budget_bytes)
+{
+    int result;
+    if (gw == NULL || module_name == NULL)
+    {
+        LogError("invalid argument gw=%p, module_name=%p", gw, module_name);
+        result = __LINE__;
+    }
+    else
+    {
+        MODULE_DATA **module_data = (MODULE_DATA**)VECTOR_find_if(gw->modules, module_name_find, module_name);
+        if (module_data == NULL)
+        {
+            LogError("Couldn't find module with the specified name");
+            result = __LINE__;
+        }
+        else if ((*module_data)->alloc_tag == NULL)
+        {
+            LogError("allocation statistics are not available, build the gateway with enable_module_alloc_stats");
+            result = __LINE__;
+        }
+        else
+        {
+            ModuleAlloc_SetBudget((*module_data)->alloc_tag, budget_bytes);
+            result = 0;
+        }
+    }
+    return result;
+}
+
+int Gateway_GetModuleLatencyHistogram(GATEWAY_HANDLE gw, const char* module_name, BROKER_LATENCY_HISTOGRAM* histogram)
+{
+    int result;
+    if (gw == NULL || module_name == NULL || histogram == NULL)
+    {
+        LogError("invalid argument gw=%p, module_name=%p, histogram=%p", gw, module_name, histogram);
+        result = __LINE__;
+    }
+    else
+    {
+        MODULE_DATA **module_data = (MODULE_DATA**)VECTOR_find_if(gw->modules, module_name_find, module_name);
+        if (module_data == NULL)
+        {
+            LogError("Couldn't find module with the specified name");
+            result = __LINE__;
+        }
+        else
+        {
+            MODULE module;
+            module.module_apis = NULL;
+            module.module_handle = (*module_data)->module;
+            result = (Broker_GetLatencyHistogram(gw->broker, &module, histogram) == BROKER_OK) ? 0 : __LINE__;
+        }
+    }
+    return result;
+}
+
+int Gateway_GetModuleStallStats(GATEWAY_HANDLE gw, const char* module_name, BROKER_STALL_STATS* stats)
+{
+    int result;
+    if (gw == NULL || module_name == NULL || stats == NULL)
+    {
+        LogError("invalid argument gw=%p, module_name=%p, stats=%p", gw, module_name, stats);
+        result = __LINE__;
+    }
+    else
+    {
+        MODULE_DATA **module_data = (MODULE_DATA**)VECTOR_find_if(gw->modules, module_name_find, module_name);
+        if (module_data == NULL)
+        {
+            LogError("Couldn't find module with the specified name");
+            result = __LINE__;
+        }
+        else
+        {
+            MODULE module;
+            module.module_apis = NULL;
+            module.module_handle = (*module_data)->module;
+            result = (Broker_GetStallStats(gw->broker, &module, stats) == BROKER_OK) ? 0 : __LINE__;
+        }
+    }
+    return result;
+}
+
 GATEWAY_ADD_LINK_RESULT Gateway_AddLink(GATEWAY_HANDLE gw, const GATEWAY_LINK_ENTRY* entryLink)
 {
     GATEWAY_ADD_LINK_RESULT result;
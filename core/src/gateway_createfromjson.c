@@ -2,6 +2,8 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/macro_utils.h"
@@ -20,10 +22,23 @@
 #define LOADER_ENTRYPOINT_KEY "entrypoint"
 #define MODULE_PATH_KEY "module.path"
 #define ARG_KEY "args"
+#define CONCURRENCY_KEY "concurrency"
+#define ORDER_BY_KEY "order.by"
+#define WAIT_SPIN_KEY "wait.spin"
+#define WAIT_YIELD_KEY "wait.yield"
+#define QUEUE_KEY "queue"
+#define QUEUE_FIFO "fifo"
+#define QUEUE_CONFLATE "conflate"
+#define CONFLATE_BY_KEY "conflate.by"
+#define STALL_MS_KEY "stall.ms"
+#define STALL_POLICY_KEY "stall.policy"
+#define STALL_POLICY_LOG "log"
+#define STALL_POLICY_SHED "shed"
 
 #define LINKS_KEY "links"
 #define SOURCE_KEY "source"
 #define SINK_KEY "sink"
+#define FUSE_KEY "fuse"
 
 #define PARSE_JSON_RESULT_VALUES \
     PARSE_JSON_SUCCESS, \
@@ -36,6 +51,9 @@ DEFINE_ENUM(PARSE_JSON_RESULT, PARSE_JSON_RESULT_VALUES);
 
 GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, bool use_json);
 static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties, JSON_Value *root);
+static bool get_count(const JSON_Object* module, const char* name, size_t* count);
+static bool get_queue(const JSON_Object* module, BROKER_MODULE_DELIVERY* delivery);
+static bool get_stall(const JSON_Object* module, BROKER_MODULE_DELIVERY* delivery);
 static void destroy_properties_internal(GATEWAY_PROPERTIES* properties);
 void gateway_destroy_internal(GATEWAY_HANDLE gw);
 
@@ -501,8 +519,53 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
                                         args_str
                                     };
 
+                                    /*Codes_SRS_GATEWAY_JSON_26_001: [ The function shall set `delivery.concurrency` of the module entry to the module's "concurrency" number, or 0 if it is not present. ]*/
+                                    /*Codes_SRS_GATEWAY_JSON_26_004: [ The function shall set `delivery.spin_count` and `delivery.yield_count` of the module entry to the module's "wait.spin" and "wait.yield" numbers, or 0 if they are not present. ]*/
+                                    bool counts_valid =
+                                        get_count(module, CONCURRENCY_KEY, &entry.delivery.concurrency) &&
+                                        get_count(module, WAIT_SPIN_KEY, &entry.delivery.spin_count) &&
+                                        get_count(module, WAIT_YIELD_KEY, &entry.delivery.yield_count);
+                                    entry.delivery.order_by = NULL;
+                                    entry.delivery.queue = BROKER_QUEUE_FIFO;
+                                    entry.delivery.conflate_by = NULL;
+                                    entry.delivery.stall_ms = 0;
+                                    entry.delivery.stall_policy = BROKER_STALL_LOG;
+                                    entry.delivery.name = NULL;
+                                    if (counts_valid && entry.delivery.concurrency > 1)
+                                    {
+                                        /*Codes_SRS_GATEWAY_JSON_26_002: [ If "concurrency" is greater than 1, the function shall set `delivery.order_by` of the module entry to the module's "order.by" string, or NULL if it is not present. ]*/
+                                        entry.delivery.order_by = json_object_get_string(module, ORDER_BY_KEY);
+                                    }
+
+                                    if (!counts_valid)
+                                    {
+                                        /*Codes_SRS_GATEWAY_JSON_26_003: [ The function shall return NULL if "concurrency", "wait.spin" or "wait.yield" is negative or not a whole number. ]*/
+                                        loader_info.loader->api->FreeEntrypoint(loader_info.loader, loader_info.entrypoint);
+                                        json_free_serialized_string(args_str);
+                                        result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+                                        LogError("\"concurrency\", \"wait.spin\" and \"wait.yield\" of module [%s] must be positive whole numbers.", module_name);
+                                        break;
+                                    }
+                                    else if (!get_queue(module, &entry.delivery))
+                                    {
+                                        /*Codes_SRS_GATEWAY_JSON_26_006: [ The function shall return NULL if "queue" is present and is neither "fifo" nor "conflate". ]*/
+                                        loader_info.loader->api->FreeEntrypoint(loader_info.loader, loader_info.entrypoint);
+                                        json_free_serialized_string(args_str);
+                                        result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+                                        LogError("\"queue\" of module [%s] must be \"fifo\" or \"conflate\".", module_name);
+                                        break;
+                                    }
+                                    else if (!get_stall(module, &entry.delivery))
+                                    {
+                                        /*Codes_SRS_GATEWAY_JSON_26_009: [ The function shall return NULL if "stall.ms" is negative, not a whole number or too large, or "stall.policy" is present and is neither "log" nor "shed". ]*/
+                                        loader_info.loader->api->FreeEntrypoint(loader_info.loader, loader_info.entrypoint);
+                                        json_free_serialized_string(args_str);
+                                        result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+                                        LogError("\"stall.ms\" of module [%s] must be a positive whole number and \"stall.policy\" \"log\" or \"shed\".", module_name);
+                                        break;
+                                    }
                                     /*Codes_SRS_GATEWAY_JSON_14_006: [The function shall return NULL if the JSON_Value contains incomplete information.]*/
-                                    if (VECTOR_push_back(out_properties->gateway_modules, &entry, 1) == 0)
+                                    else if (VECTOR_push_back(out_properties->gateway_modules, &entry, 1) == 0)
                                     {
                                         result = PARSE_JSON_SUCCESS;
                                     }
@@ -558,9 +621,11 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
 
                                 if (module_source != NULL && module_sink != NULL)
                                 {
+                                    /*Codes_SRS_GATEWAY_JSON_26_007: [ The function shall set a link's `fuse` to true if the link's "fuse" value is the JSON boolean true, and to false otherwise. ]*/
                                     GATEWAY_LINK_ENTRY entry = {
                                         module_source,
-                                        module_sink
+                                        module_sink,
+                                        json_object_get_boolean(route, FUSE_KEY) == 1
                                     };
 
                                     /* Codes_SRS_GATEWAY_JSON_04_002: [ The function shall add all modules source and sink to GATEWAY_PROPERTIES inside gateway_links. ] */
@@ -623,3 +688,64 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
     }
     return result;
 }
+
+/*reads an optional non-negative whole number, 0 when it is not present*/
+static bool get_count(const JSON_Object* module, const char* name, size_t* count)
+{
+    double value = json_object_get_number(module, name);
+    *count = (value < 0) ? 0 : (size_t)value;
+    return (value >= 0 && (double)*count == value);
+}
+
+static bool get_queue(const JSON_Object* module, BROKER_MODULE_DELIVERY* delivery)
+{
+    bool result;
+    const char* queue = json_object_get_string(module, QUEUE_KEY);
+    if (queue == NULL || strcmp(queue, QUEUE_FIFO) == 0)
+    {
+        result = true;
+    }
+    else if (strcmp(queue, QUEUE_CONFLATE) == 0)
+    {
+        /*Codes_SRS_GATEWAY_JSON_26_005: [ If the module's "queue" string is "conflate", the function shall set `delivery.queue` of the module entry to `BROKER_QUEUE_CONFLATE` and `delivery.conflate_by` to the module's "conflate.by" string, or NULL if it is not present. ]*/
+        delivery->queue = BROKER_QUEUE_CONFLATE;
+        delivery->conflate_by = json_object_get_string(module, CONFLATE_BY_KEY);
+        result = true;
+    }
+    else
+    {
+        result = false;
+    }
+    return result;
+}
+
+static bool get_stall(const JSON_Object* module, BROKER_MODULE_DELIVERY* delivery)
+{
+    bool result;
+    size_t stall_ms;
+    const char* policy = json_object_get_string(module, STALL_POLICY_KEY);
+    if (!get_count(module, STALL_MS_KEY, &stall_ms) || stall_ms > UINT_MAX)
+    {
+        result = false;
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_JSON_26_008: [ The function shall set `delivery.stall_ms` of the module entry to the module's "stall.ms" number, or 0 if it is not present, and `delivery.stall_policy` to `BROKER_STALL_SHED` if its "stall.policy" string is "shed", or `BROKER_STALL_LOG` otherwise. ]*/
+        delivery->stall_ms = (unsigned int)stall_ms;
+        if (policy == NULL || strcmp(policy, STALL_POLICY_LOG) == 0)
+        {
+            delivery->stall_policy = BROKER_STALL_LOG;
+            result = true;
+        }
+        else if (strcmp(policy, STALL_POLICY_SHED) == 0)
+        {
+            delivery->stall_policy = BROKER_STALL_SHED;
+            result = true;
+        }
+        else
+        {
+            result = false;
+        }
+    }
+    return result;
+}
@@ -12,6 +12,7 @@
 #include "experimental/event_system.h"
 #include "broker.h"
 #include "module_access.h"
+#include "lock_profile.h"
 #ifdef OUTPROCESS_ENABLED
   #include "module_loaders/outprocess_loader.h"
 #endif
@@ -84,6 +85,67 @@ static int remove_one_link_from_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODU
     return result;
 }
 
+/* A link is only fused when the sink's Module_Receive may run on another
+ * module's thread, nothing else publishes to the sink and the source
+ * publishes to nothing else, and it does not close a loop of fused links.
+ */
+static bool can_fuse_link(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* source, MODULE_DATA* sink)
+{
+    bool result;
+    if (source == sink || !sink->fusion_safe)
+    {
+        result = false;
+    }
+    else
+    {
+        size_t link;
+        size_t num_links = VECTOR_size(gateway_handle->links);
+        MODULE_DATA* upstream;
+        result = true;
+        for (link = 0; link < num_links; link++)
+        {
+            LINK_DATA* link_data = (LINK_DATA*)VECTOR_element(gateway_handle->links, link);
+            if (link_data->module_sink == sink ||
+                (link_data->from_any_source ? link_data->module_sink != source : link_data->module_source == source))
+            {
+                result = false;
+                break;
+            }
+        }
+        for (upstream = source->fused_source; result && upstream != NULL; upstream = upstream->fused_source)
+        {
+            result = (upstream != sink);
+        }
+    }
+    return result;
+}
+
+/* Turns the fused link into sink back into a regular link, since another
+ * module is about to publish to the sink. The regular link is added before
+ * the fused one is removed, so a message published in between may be
+ * received twice but none is lost.
+ */
+static void unfuse_link_into(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* sink)
+{
+    size_t link;
+    size_t num_links = VECTOR_size(gateway_handle->links);
+    for (link = 0; link < num_links; link++)
+    {
+        LINK_DATA* link_data = (LINK_DATA*)VECTOR_element(gateway_handle->links, link);
+        if (link_data->fused && link_data->module_sink == sink)
+        {
+            if (add_one_link_to_broker(gateway_handle, link_data->module_source->module, sink->module) != 0 ||
+                remove_one_link_from_broker(gateway_handle, link_data->module_source->module, sink->module) != 0)
+            {
+                LogError("Unable to unfuse the link [%s] -> [%s]", link_data->module_source->module_name, sink->module_name);
+            }
+            link_data->fused = false;
+            break;
+        }
+    }
+    sink->fused_source = NULL;
+}
+
 static int add_regular_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry)
 {
     int result;
@@ -107,7 +169,27 @@ static int add_regular_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_L
         }
         else
         {
-            if (add_one_link_to_broker(gateway_handle, (*module_source_handle)->module, (*module_sink_handle)->module) != 0)
+            BROKER_LINK_DATA broker_link_entry =
+            {
+                (*module_source_handle)->module,
+                (*module_sink_handle)->module
+            };
+            /*Codes_SRS_GATEWAY_26_023: [ If `entryLink->fuse` is true, the sink's MODULE_API marks it fusion-safe, no other link has the sink as its sink or the source as its source, and the link does not close a loop of fused links, the function shall add the link using a call to Broker_AddFusedLink instead of Broker_AddLink. ]*/
+            bool fused = link_entry->fuse && can_fuse_link(gateway_handle, *module_source_handle, *module_sink_handle);
+            if (link_entry->fuse && !fused)
+            {
+                LogInfo("The link [%s] -> [%s] cannot be fused and is added as a regular link.", link_entry->module_source, link_entry->module_sink);
+            }
+
+            /*Codes_SRS_GATEWAY_26_024: [ Before it adds a link into a sink that receives on a fused link, the function shall turn that fused link into a regular one. ]*/
+            if ((*module_sink_handle)->fused_source != NULL)
+            {
+                unfuse_link_into(gateway_handle, *module_sink_handle);
+            }
+
+            if ((fused ?
+                    Broker_AddFusedLink(gateway_handle->broker, &broker_link_entry) :
+                    Broker_AddLink(gateway_handle->broker, &broker_link_entry)) != BROKER_OK)
             {
                 LogError("Unable to add link to Broker.");
                 result = __LINE__;
@@ -118,7 +200,8 @@ static int add_regular_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_L
                 {
                     false,
                     *module_source_handle,
-                    *module_sink_handle
+                    *module_sink_handle,
+                    fused
                 };
 
                 /*Codes_SRS_GATEWAY_04_012: [ This function shall add the entryLink to the gw->links ] */
@@ -130,6 +213,10 @@ static int add_regular_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_L
                 }
                 else
                 {
+                    if (fused)
+                    {
+                        (*module_sink_handle)->fused_source = *module_source_handle;
+                    }
                     result = 0;
                 }
             }
@@ -149,6 +236,16 @@ GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, boo
         /* For freeing up NULL ptrs in case of create failure */
         memset(gateway, 0, sizeof(GATEWAY_HANDLE_DATA));
 
+#ifdef MODULE_ALLOC_STATS_ENABLED
+        /* failing to set up allocation accounting only disables the statistics */
+        gateway->alloc_stats_initialized = (ModuleAlloc_Init() == 0);
+#endif
+
+#ifdef LOCK_PROFILE_ENABLED
+        /* before Broker_Create, so that the broker's locks are profiled from the start */
+        gateway->lock_profile_initialized = (LockProfile_Init() == 0);
+#endif
+
         /*Codes_SRS_GATEWAY_14_003: [This function shall create a new BROKER_HANDLE for the gateway representing this gateway's message broker. ]*/
         gateway->broker = Broker_Create();
         if (gateway->broker == NULL)
@@ -325,6 +422,22 @@ void gateway_destroy_internal(GATEWAY_HANDLE gw)
             Broker_Destroy(gateway_handle->broker);
         }
 
+#ifdef MODULE_ALLOC_STATS_ENABLED
+        if (gateway_handle->alloc_stats_initialized)
+        {
+            ModuleAlloc_Deinit();
+        }
+#endif
+
+#ifdef LOCK_PROFILE_ENABLED
+        if (gateway_handle->lock_profile_initialized)
+        {
+            /* the modules and the broker are gone, so every profiled lock has been released */
+            LockProfile_Dump();
+            LockProfile_Deinit();
+        }
+#endif
+
         free(gateway_handle);
     }
     else
@@ -340,6 +453,230 @@ bool checkIfModuleExists(GATEWAY_HANDLE_DATA* gateway_handle, const char* module
     return module_data == NULL ? false : true;
 }
 
+/* Loads and creates the module described by module_entry and attaches it to
+ * the broker, in place of replaced when that is not NULL. On failure, including
+ * when the broker refuses the module, the module is destroyed, its library is
+ * unloaded, its allocation tag is released and the function returns NULL.
+ */
+static MODULE_DATA* create_module(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_MODULES_ENTRY* module_entry, bool use_json, const MODULE_DATA* replaced, const MODULE_API** module_apis_result)
+{
+    MODULE_DATA* result;
+    MODULE_DATA * new_module_data = (MODULE_DATA*)malloc(sizeof(MODULE_DATA));
+    if (new_module_data == NULL)
+    {
+        /*Codes_SRS_GATEWAY_14_031: [If unsuccessful, the function shall return NULL.]*/
+        result = NULL;
+        LogError("Failed to add module because it could not allocate memory.");
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_14_012: [The function shall load the module located at GATEWAY_MODULES_ENTRY's module_path into a MODULE_LIBRARY_HANDLE. ]*/
+        /*Codes_SRS_GATEWAY_17_015: [ The function shall use the module's specified loader and the module's entrypoint to get each module's MODULE_LIBRARY_HANDLE. ]*/
+        MODULE_LIBRARY_HANDLE module_library_handle = module_entry->module_loader_info.loader->api->Load(
+            module_entry->module_loader_info.loader,
+            module_entry->module_loader_info.entrypoint
+        );
+
+        /*Codes_SRS_GATEWAY_14_031: [If unsuccessful, the function shall return NULL.]*/
+        if (module_library_handle == NULL)
+        {
+            free(new_module_data);
+            result = NULL;
+            LogError("Failed to add module because the module could not be loaded.");
+        }
+        else
+        {
+#ifdef MODULE_ALLOC_STATS_ENABLED
+            /* everything the module allocates from here until it is attached to the broker is charged to it */
+            MODULE_ALLOC_TAG alloc_tag = ModuleAlloc_CreateTag(module_entry->module_name);
+            MODULE_ALLOC_TAG previous_alloc_tag = ModuleAlloc_SetThreadTag(alloc_tag);
+#endif
+            //Should always be a safe call.
+            /*Codes_SRS_GATEWAY_14_013: [The function shall get the const MODULE_API* from the MODULE_LIBRARY_HANDLE.]*/
+            const MODULE_API* module_apis = module_entry->module_loader_info.loader->api->GetApi(module_entry->module_loader_info.loader, module_library_handle);
+
+            // parse module args if needed
+            const void* module_configuration = module_entry->module_configuration;
+            const void* transformed_module_configuration;
+            if (use_json)
+            {
+                module_configuration = MODULE_PARSE_CONFIGURATION_FROM_JSON(module_apis)(
+                    (const char *)(module_entry->module_configuration)
+                );
+            }
+
+            // request the loader to transform the module configuration to what the module expects
+            /*Codes_SRS_GATEWAY_17_018: [ The function shall construct module configuration from module's entrypoint and module's module_configuration. ]*/
+            /*Codes_SRS_GATEWAY_17_021: [ The function shall construct module configuration from module's entrypoint and module's module_configuration. ]*/
+            /*Codes_SRS_GATEWAY_JSON_17_011: [ The function shall the loader's BuildModuleConfiguration to construct module input from module's "args" and "loader.entrypoint". ]*/
+            transformed_module_configuration = module_entry->module_loader_info.loader->api->BuildModuleConfiguration(
+                module_entry->module_loader_info.loader,
+                module_entry->module_loader_info.entrypoint,
+                module_configuration
+            );
+
+            /*Codes_SRS_GATEWAY_14_015: [The function shall use the MODULE_API to create a MODULE_HANDLE using the GATEWAY_MODULES_ENTRY's module_configuration. ]*/
+            MODULE_HANDLE module_handle = MODULE_CREATE(module_apis)(gateway_handle->broker, transformed_module_configuration);
+
+            // free the configurations
+            /*Codes_SRS_GATEWAY_17_020: [ The function shall clean up any constructed resources. ]*/
+            /*Codes_SRS_GATEWAY_17_022: [ The function shall clean up any constructed resources. ]*/
+            if (use_json)
+            {
+                MODULE_FREE_CONFIGURATION(module_apis)((void*)module_configuration);
+            }
+            module_entry->module_loader_info.loader->api->FreeModuleConfiguration(module_entry->module_loader_info.loader, transformed_module_configuration);
+
+            /*Codes_SRS_GATEWAY_14_016: [If the module creation is unsuccessful, the function shall return NULL.]*/
+            if (module_handle == NULL)
+            {
+                free(new_module_data);
+                result = NULL;
+                module_entry->module_loader_info.loader->api->Unload(module_entry->module_loader_info.loader, module_library_handle);
+                LogError("Module_Create failed.");
+            }
+            else
+            {
+                BROKER_RESULT attach_result;
+
+                /*Codes_SRS_GATEWAY_99_011: [The function shall assign `module_apis` to `MODULE::module_apis`. ]*/
+                MODULE module;
+                module.module_apis = module_apis;
+                module.module_handle = module_handle;
+
+                /*Codes_SRS_GATEWAY_26_021: [ If the module entry's `delivery.concurrency` is 0, the function shall use the concurrency advertised by the module's MODULE_API. ]*/
+                BROKER_MODULE_DELIVERY delivery = module_entry->delivery;
+                if (delivery.concurrency == 0)
+                {
+                    delivery.concurrency = MODULE_RECEIVE_CONCURRENCY(module_apis);
+                }
+
+                /*Codes_SRS_GATEWAY_26_025: [ The function shall set `delivery.name` to the module's name, for the broker's watchdog to log. ]*/
+                delivery.name = module_entry->module_name;
+
+                if (replaced != NULL)
+                {
+                    /*Codes_SRS_GATEWAY_26_032: [ The function shall create the new module as Gateway_AddModule does, and attach it to the broker using a call to Broker_AddReplacementModule in place of the module being replaced. ]*/
+                    MODULE replaced_module;
+                    replaced_module.module_apis = NULL;
+                    replaced_module.module_handle = replaced->module;
+                    attach_result = Broker_AddReplacementModule(gateway_handle->broker, &module, &delivery, &replaced_module);
+                }
+                else
+                {
+                    /*Codes_SRS_GATEWAY_14_017: [The function shall attach the module to the GATEWAY_HANDLE_DATA's broker using a call to Broker_AddModule. ]*/
+                    /*Codes_SRS_GATEWAY_26_022: [ If that concurrency is greater than 1, or the entry sets `delivery.spin_count`, `delivery.yield_count` or a `delivery.queue` other than `BROKER_QUEUE_FIFO`, the function shall attach the module using a call to Broker_AddModuleWithDelivery instead. ]*/
+                    /*Codes_SRS_GATEWAY_26_026: [ If the entry sets `delivery.stall_ms`, the function shall attach the module using a call to Broker_AddModuleWithDelivery. ]*/
+                    attach_result = (delivery.concurrency > 1 || delivery.spin_count > 0 || delivery.yield_count > 0 || delivery.queue != BROKER_QUEUE_FIFO || delivery.stall_ms > 0 ?
+                        Broker_AddModuleWithDelivery(gateway_handle->broker, &module, &delivery) :
+                        Broker_AddModule(gateway_handle->broker, &module));
+                }
+
+                /*Codes_SRS_GATEWAY_14_018: [If the function cannot attach the module to the message broker, the function shall return NULL.]*/
+                if (attach_result != BROKER_OK)
+                {
+                    free(new_module_data);
+                    result = NULL;
+                    LogError("Failed to add module to the gateway's broker.");
+                }
+                else
+                {
+                    char* name_copied = NULL;
+                    /*Codes_SRS_GATEWAY_26_020: [ The function shall make a copy of the name of the module for internal use. ]*/
+                    mallocAndStrcpy_s(&name_copied, module_entry->module_name);
+                    if (name_copied == NULL)
+                    {
+                        free(new_module_data);
+                        result = NULL;
+                        if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
+                        {
+                            LogError("Failed to remove module [%p] from the gateway message broker. This module will remain attached.", &module);
+                        }
+                        LogError("Unable to malloc for module name");
+                    }
+                    else
+                    {
+                        strcpy(name_copied, module_entry->module_name);
+                        /*Codes_SRS_GATEWAY_14_039: [ The function shall increment the BROKER_HANDLE reference count if the MODULE_HANDLE was successfully added to the GATEWAY_HANDLE_DATA's broker. ]*/
+                        Broker_IncRef(gateway_handle->broker);
+                        /*Codes_SRS_GATEWAY_14_029: [ The function shall create a new MODULE_DATA containing the MODULE_HANDLE, MODULE_LOADER_API and MODULE_LIBRARY_HANDLE if the module was successfully linked to the message broker. ]*/
+                        MODULE_DATA module_data =
+                        {
+                            name_copied,
+                            module_library_handle,
+                            module_entry->module_loader_info.loader,
+                            module_handle
+                        };
+                        *new_module_data = module_data;
+#ifdef MODULE_ALLOC_STATS_ENABLED
+                        new_module_data->alloc_tag = alloc_tag;
+#endif
+                        new_module_data->fusion_safe = MODULE_RECEIVE_FUSION_SAFE(module_apis);
+                        *module_apis_result = module_apis;
+                        result = new_module_data;
+                    }
+                }
+
+                /*Codes_SRS_GATEWAY_14_030: [If any internal API call is unsuccessful after a module is created, the library will be unloaded and the module destroyed.]*/
+                if (result == NULL)
+                {
+                    MODULE_DESTROY(module_apis)(module_handle);
+                    module_entry->module_loader_info.loader->api->Unload(module_entry->module_loader_info.loader, module_library_handle);
+                }
+            }
+
+#ifdef MODULE_ALLOC_STATS_ENABLED
+            (void)ModuleAlloc_SetThreadTag(previous_alloc_tag);
+            if (result == NULL)
+            {
+                /* the module was destroyed above, so nothing it allocated is still charged to the tag */
+                ModuleAlloc_DestroyTag(alloc_tag);
+            }
+#endif
+        }
+    }
+
+    return result;
+}
+
+/* Detaches the module of module_data from the broker, destroys and unloads
+ * it and frees module_data. The module must no longer be in the gateway's
+ * links.
+ */
+static void destroy_module(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* module_data, const MODULE_API* module_apis)
+{
+    MODULE module;
+    module.module_apis = NULL;
+    module.module_handle = module_data->module;
+
+    free(module_data->module_name);
+
+#ifdef MODULE_ALLOC_STATS_ENABLED
+    MODULE_ALLOC_TAG previous_alloc_tag = ModuleAlloc_SetThreadTag(module_data->alloc_tag);
+#endif
+
+    /*Codes_SRS_GATEWAY_14_021: [ The function shall detach module from the GATEWAY_HANDLE_DATA's broker BROKER_HANDLE. ]*/
+    /*Codes_SRS_GATEWAY_14_022: [ If GATEWAY_HANDLE_DATA's broker cannot detach module, the function shall log the error and continue unloading the module from the GATEWAY_HANDLE. ]*/
+    if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
+    {
+        LogError("Failed to remove module [%p] from the message broker. This module will remain linked to the broker but will be removed from the gateway.", module_data->module);
+    }
+    /*Codes_SRS_GATEWAY_14_038: [ The function shall decrement the BROKER_HANDLE reference count. ]*/
+    Broker_DecRef(gateway_handle->broker);
+
+    MODULE_DESTROY(module_apis)(module_data->module);
+
+    /*Codes_SRS_GATEWAY_14_025: [The function shall unload MODULE_DATA's module_library_handle. ]*/
+    module_data->module_loader->api->Unload(module_data->module_loader, module_data->module_library_handle);
+
+#ifdef MODULE_ALLOC_STATS_ENABLED
+    (void)ModuleAlloc_SetThreadTag(previous_alloc_tag);
+    ModuleAlloc_DestroyTag(module_data->alloc_tag);
+#endif
+
+    free(module_data);
+}
+
 MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_MODULES_ENTRY* module_entry, bool use_json)
 {
     MODULE_HANDLE module_result;
@@ -376,166 +713,33 @@ MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, co
         bool moduleExist = checkIfModuleExists(gateway_handle, module_entry->module_name);
         if (!moduleExist)
         {
-            MODULE_DATA * new_module_data = (MODULE_DATA*)malloc(sizeof(MODULE_DATA));
+            const MODULE_API* module_apis;
+            MODULE_DATA * new_module_data = create_module(gateway_handle, module_entry, use_json, NULL, &module_apis);
             if (new_module_data == NULL)
             {
-                /*Codes_SRS_GATEWAY_14_031: [If unsuccessful, the function shall return NULL.]*/
                 module_result = NULL;
-                LogError("Failed to add module because it could not allocate memory.");
+            }
+            /*Codes_SRS_GATEWAY_14_032: [The function shall add the new MODULE_DATA to GATEWAY_HANDLE_DATA's modules if the module was successfully attached to the message broker. ]*/
+            else if (VECTOR_push_back(gateway_handle->modules, &new_module_data, 1) != 0)
+            {
+                /*Codes_SRS_GATEWAY_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
+                /*Codes_SRS_GATEWAY_14_030: [If any internal API call is unsuccessful after a module is created, the library will be unloaded and the module destroyed.]*/
+                module_result = NULL;
+                destroy_module(gateway_handle, new_module_data, module_apis);
+                LogError("Unable to add MODULE_DATA* to the gateway module vector.");
+            }
+            else if (add_module_to_any_source(gateway_handle, *(MODULE_DATA**)VECTOR_back(gateway_handle->modules)) != 0)
+            {
+                /*Codes_SRS_GATEWAY_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
+                module_result = NULL;
+                VECTOR_erase(gateway_handle->modules, VECTOR_back(gateway_handle->modules), 1);
+                destroy_module(gateway_handle, new_module_data, module_apis);
+                LogError("Unable to add MODULE_DATA* to existing broker links.");
             }
             else
             {
-                /*Codes_SRS_GATEWAY_14_012: [The function shall load the module located at GATEWAY_MODULES_ENTRY's module_path into a MODULE_LIBRARY_HANDLE. ]*/
-                /*Codes_SRS_GATEWAY_17_015: [ The function shall use the module's specified loader and the module's entrypoint to get each module's MODULE_LIBRARY_HANDLE. ]*/
-                MODULE_LIBRARY_HANDLE module_library_handle = module_entry->module_loader_info.loader->api->Load(
-                    module_entry->module_loader_info.loader,
-                    module_entry->module_loader_info.entrypoint
-                );
-
-                /*Codes_SRS_GATEWAY_14_031: [If unsuccessful, the function shall return NULL.]*/
-                if (module_library_handle == NULL)
-                {
-                    free(new_module_data);
-                    module_result = NULL;
-                    LogError("Failed to add module because the module could not be loaded.");
-                }
-                else
-                {
-                    //Should always be a safe call.
-                    /*Codes_SRS_GATEWAY_14_013: [The function shall get the const MODULE_API* from the MODULE_LIBRARY_HANDLE.]*/
-                    const MODULE_API* module_apis = module_entry->module_loader_info.loader->api->GetApi(module_entry->module_loader_info.loader, module_library_handle);
-
-                    // parse module args if needed
-                    const void* module_configuration = module_entry->module_configuration;
-                    const void* transformed_module_configuration;
-                    if (use_json)
-                    {
-                        module_configuration = MODULE_PARSE_CONFIGURATION_FROM_JSON(module_apis)(
-                            (const char *)(module_entry->module_configuration)
-                        );
-					}
-
-                    // request the loader to transform the module configuration to what the module expects
-                    /*Codes_SRS_GATEWAY_17_018: [ The function shall construct module configuration from module's entrypoint and module's module_configuration. ]*/
-                    /*Codes_SRS_GATEWAY_17_021: [ The function shall construct module configuration from module's entrypoint and module's module_configuration. ]*/
-                    /*Codes_SRS_GATEWAY_JSON_17_011: [ The function shall the loader's BuildModuleConfiguration to construct module input from module's "args" and "loader.entrypoint". ]*/
-                    transformed_module_configuration = module_entry->module_loader_info.loader->api->BuildModuleConfiguration(
-                        module_entry->module_loader_info.loader,
-                        module_entry->module_loader_info.entrypoint,
-                        module_configuration
-                    );
-
-                    /*Codes_SRS_GATEWAY_14_015: [The function shall use the MODULE_API to create a MODULE_HANDLE using the GATEWAY_MODULES_ENTRY's module_configuration. ]*/
-                    MODULE_HANDLE module_handle = MODULE_CREATE(module_apis)(gateway_handle->broker, transformed_module_configuration);
-
-                    // free the configurations
-                    /*Codes_SRS_GATEWAY_17_020: [ The function shall clean up any constructed resources. ]*/
-                    /*Codes_SRS_GATEWAY_17_022: [ The function shall clean up any constructed resources. ]*/
-                    if (use_json)
-                    {
-                        MODULE_FREE_CONFIGURATION(module_apis)((void*)module_configuration);
-                    }
-                    module_entry->module_loader_info.loader->api->FreeModuleConfiguration(module_entry->module_loader_info.loader, transformed_module_configuration);
-
-                    /*Codes_SRS_GATEWAY_14_016: [If the module creation is unsuccessful, the function shall return NULL.]*/
-                    if (module_handle == NULL)
-                    {
-                        free(new_module_data);
-                        module_result = NULL;
-                        module_entry->module_loader_info.loader->api->Unload(module_entry->module_loader_info.loader, module_library_handle);
-                        LogError("Module_Create failed.");
-                    }
-                    else
-                    {
-                        /*Codes_SRS_GATEWAY_99_011: [The function shall assign `module_apis` to `MODULE::module_apis`. ]*/
-                        MODULE module;
-                        module.module_apis = module_apis;
-                        module.module_handle = module_handle;
-
-                        /*Codes_SRS_GATEWAY_14_017: [The function shall attach the module to the GATEWAY_HANDLE_DATA's broker using a call to Broker_AddModule. ]*/
-                        /*Codes_SRS_GATEWAY_14_018: [If the function cannot attach the module to the message broker, the function shall return NULL.]*/
-                        if (Broker_AddModule(gateway_handle->broker, &module) != BROKER_OK)
-                        {
-                            free(new_module_data);
-                            module_result = NULL;
-                            LogError("Failed to add module to the gateway's broker.");
-                        }
-                        else
-                        {
-                            char* name_copied = NULL;
-                            /*Codes_SRS_GATEWAY_26_020: [ The function shall make a copy of the name of the module for internal use. ]*/
-                            mallocAndStrcpy_s(&name_copied, module_entry->module_name);
-                            if (name_copied == NULL)
-                            {
-                                free(new_module_data);
-                                module_result = NULL;
-                                if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
-                                {
-                                    LogError("Failed to remove module [%p] from the gateway message broker. This module will remain attached.", &module);
-                                }
-                                LogError("Unable to malloc for module name");
-                            }
-                            else
-                            {
-                                strcpy(name_copied, module_entry->module_name);
-                                /*Codes_SRS_GATEWAY_14_039: [ The function shall increment the BROKER_HANDLE reference count if the MODULE_HANDLE was successfully added to the GATEWAY_HANDLE_DATA's broker. ]*/
-                                Broker_IncRef(gateway_handle->broker);
-                                /*Codes_SRS_GATEWAY_14_029: [ The function shall create a new MODULE_DATA containing the MODULE_HANDLE, MODULE_LOADER_API and MODULE_LIBRARY_HANDLE if the module was successfully linked to the message broker. ]*/
-                                MODULE_DATA module_data =
-                                {
-                                    name_copied,
-                                    module_library_handle,
-                                    module_entry->module_loader_info.loader,
-                                    module_handle
-                                };
-                                *new_module_data = module_data;
-                                /*Codes_SRS_GATEWAY_14_032: [The function shall add the new MODULE_DATA to GATEWAY_HANDLE_DATA's modules if the module was successfully attached to the message broker. ]*/
-                                if (VECTOR_push_back(gateway_handle->modules, &new_module_data, 1) != 0)
-                                {
-                                    /*Codes_SRS_GATEWAY_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
-                                    Broker_DecRef(gateway_handle->broker);
-                                    free(new_module_data);
-                                    free(name_copied);
-                                    module_result = NULL;
-                                    if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
-                                    {
-                                        LogError("Failed to remove module [%p] from the gateway message broker. This module will remain attached.", &module);
-                                    }
-                                    LogError("Unable to add MODULE_DATA* to the gateway module vector.");
-                                }
-                                else
-                                {
-                                    if (add_module_to_any_source(gateway_handle, *(MODULE_DATA**)VECTOR_back(gateway_handle->modules)) != 0)
-                                    {
-                                        /*Codes_SRS_GATEWAY_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
-                                        Broker_DecRef(gateway_handle->broker);
-                                        module_result = NULL;
-                                        if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
-                                        {
-                                            LogError("Failed to remove module [%p] from the gateway message broker. This module will remain attached.", &module);
-                                        }
-                                        VECTOR_erase(gateway_handle->modules, VECTOR_back(gateway_handle->modules), 1);
-                                        free(new_module_data);
-                                        free(name_copied);
-                                        LogError("Unable to add MODULE_DATA* to existing broker links.");
-                                    }
-                                    else
-                                    {
-                                        /*Codes_SRS_GATEWAY_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
-                                        module_result = module_handle;
-                                    }
-                                }
-                            }
-                        }
-
-                        /*Codes_SRS_GATEWAY_14_030: [If any internal API call is unsuccessful after a module is created, the library will be unloaded and the module destroyed.]*/
-                        if (module_result == NULL)
-                        {
-                            MODULE_DESTROY(module_apis)(module_handle);
-                            module_entry->module_loader_info.loader->api->Unload(module_entry->module_loader_info.loader, module_library_handle);
-                        }
-                    }
-                }
+                /*Codes_SRS_GATEWAY_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
+                module_result = new_module_data->module;
             }
         }
         else
@@ -550,10 +754,6 @@ MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, co
 
 void gateway_removemodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA** module_data_pptr)
 {
-    MODULE module;
-    module.module_apis = NULL;
-    module.module_handle = (*module_data_pptr)->module;
-
     remove_module_from_any_source(gateway_handle, *module_data_pptr);
     /* Codes_SRS_GATEWAY_26_018: [ This function shall remove any links that contain the removed module either as a source or sink. ] */
     if (gateway_handle->links)
@@ -565,27 +765,207 @@ void gateway_removemodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_D
         }
     }
 
-    free((*module_data_pptr)->module_name);
+    /*Codes_SRS_GATEWAY_14_024: [ The function shall use the MODULE_DATA's module_library_handle to retrieve the MODULE_API and destroy module. ]*/
+    destroy_module(gateway_handle, *module_data_pptr, (*module_data_pptr)->module_loader->api->GetApi((*module_data_pptr)->module_loader, (*module_data_pptr)->module_library_handle));
 
-    /*Codes_SRS_GATEWAY_14_021: [ The function shall detach module from the GATEWAY_HANDLE_DATA's broker BROKER_HANDLE. ]*/
-    /*Codes_SRS_GATEWAY_14_022: [ If GATEWAY_HANDLE_DATA's broker cannot detach module, the function shall log the error and continue unloading the module from the GATEWAY_HANDLE. ]*/
-    if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
+    /*Codes_SRS_GATEWAY_14_026:[The function shall remove that MODULE_DATA from GATEWAY_HANDLE_DATA's modules. ]*/
+    VECTOR_erase(gateway_handle->modules, module_data_pptr, 1);
+}
+
+/* Turns the fused links into and out of module into regular links, so that
+ * the broker orders its last messages before the handoff to a replacement.
+ */
+static void unfuse_links_of(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* module)
+{
+    size_t link;
+    size_t num_links = VECTOR_size(gateway_handle->links);
+
+    if (module->fused_source != NULL)
     {
-        LogError("Failed to remove module [%p] from the message broker. This module will remain linked to the broker but will be removed from the gateway.", (*module_data_pptr)->module);
+        unfuse_link_into(gateway_handle, module);
     }
-    /*Codes_SRS_GATEWAY_14_038: [ The function shall decrement the BROKER_HANDLE reference count. ]*/
-    Broker_DecRef(gateway_handle->broker);
+    for (link = 0; link < num_links; link++)
+    {
+        LINK_DATA* link_data = (LINK_DATA*)VECTOR_element(gateway_handle->links, link);
+        if (link_data->fused && link_data->module_source == module)
+        {
+            unfuse_link_into(gateway_handle, link_data->module_sink);
+        }
+    }
+}
 
-    /*Codes_SRS_GATEWAY_14_024: [ The function shall use the MODULE_DATA's module_library_handle to retrieve the MODULE_API and destroy module. ]*/
-    MODULE_DESTROY((*module_data_pptr)->module_loader->api->GetApi((*module_data_pptr)->module_loader, (*module_data_pptr)->module_library_handle))((*module_data_pptr)->module);
+static int add_replacement_link(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_HANDLE source, MODULE_HANDLE sink, VECTOR_HANDLE added_links)
+{
+    int result;
+    BROKER_LINK_DATA broker_link = { source, sink };
 
-    /*Codes_SRS_GATEWAY_14_025: [The function shall unload MODULE_DATA's module_library_handle. ]*/
-    (*module_data_pptr)->module_loader->api->Unload((*module_data_pptr)->module_loader, (*module_data_pptr)->module_library_handle);
+    if (add_one_link_to_broker(gateway_handle, source, sink) != 0)
+    {
+        result = __LINE__;
+    }
+    else if (VECTOR_push_back(added_links, &broker_link, 1) != 0)
+    {
+        (void)remove_one_link_from_broker(gateway_handle, source, sink);
+        result = __LINE__;
+        LogError("Unable to record a link of the replacement module");
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
 
-    /*Codes_SRS_GATEWAY_14_026:[The function shall remove that MODULE_DATA from GATEWAY_HANDLE_DATA's modules. ]*/
-    MODULE_DATA * module_data_ptr = *module_data_pptr;
-    VECTOR_erase(gateway_handle->modules, module_data_pptr, 1);
-    free(module_data_ptr);
+/* Adds to the broker a copy of each link of replaced with module in its
+ * place, recording every link added in added_links. The gateway's own links
+ * are left untouched.
+ */
+static int add_replacement_links(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* replaced, MODULE_DATA* module, VECTOR_HANDLE added_links)
+{
+    int result = 0;
+    size_t link;
+    size_t num_links = VECTOR_size(gateway_handle->links);
+
+    for (link = 0; result == 0 && link < num_links; link++)
+    {
+        LINK_DATA* link_data = (LINK_DATA*)VECTOR_element(gateway_handle->links, link);
+        if (link_data->from_any_source)
+        {
+            if (link_data->module_sink == replaced)
+            {
+                size_t m;
+                size_t num_modules = VECTOR_size(gateway_handle->modules);
+                for (m = 0; result == 0 && m < num_modules; m++)
+                {
+                    MODULE_DATA* source = *(MODULE_DATA**)VECTOR_element(gateway_handle->modules, m);
+                    if (source != replaced)
+                    {
+                        result = add_replacement_link(gateway_handle, source->module, module->module, added_links);
+                    }
+                }
+            }
+            else
+            {
+                result = add_replacement_link(gateway_handle, module->module, link_data->module_sink->module, added_links);
+            }
+        }
+        else if (link_data->module_source == replaced || link_data->module_sink == replaced)
+        {
+            result = add_replacement_link(
+                gateway_handle,
+                (link_data->module_source == replaced) ? module->module : link_data->module_source->module,
+                (link_data->module_sink == replaced) ? module->module : link_data->module_sink->module,
+                added_links
+            );
+        }
+    }
+    return result;
+}
+
+MODULE_HANDLE gateway_replacemodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA** module_data_pptr, const GATEWAY_MODULES_ENTRY* module_entry)
+{
+    MODULE_HANDLE module_result;
+
+    /*Codes_SRS_GATEWAY_26_029: [ If `entry`'s loader, the loader's api or `entry`'s entrypoint is NULL, the function shall return NULL. ]*/
+    if (
+        module_entry->module_loader_info.loader == NULL ||
+        module_entry->module_loader_info.entrypoint == NULL ||
+        module_entry->module_loader_info.loader->api == NULL
+       )
+    {
+        module_result = NULL;
+        LogError("Failed to replace module because a required input parameter is NULL. loader = %p, entrypoint = %p.",
+            module_entry->module_loader_info.loader, module_entry->module_loader_info.entrypoint);
+    }
+    else
+    {
+        VECTOR_HANDLE added_links = VECTOR_create(sizeof(BROKER_LINK_DATA));
+        if (added_links == NULL)
+        {
+            module_result = NULL;
+            LogError("Failed to replace module because the vector of its links could not be created.");
+        }
+        else
+        {
+            MODULE_DATA* replaced = *module_data_pptr;
+            const MODULE_API* module_apis;
+            MODULE_DATA* new_module_data;
+
+            /*Codes_SRS_GATEWAY_26_030: [ The new module shall take the name of the module it replaces; `entry`'s `module_name` is ignored. ]*/
+            GATEWAY_MODULES_ENTRY entry = *module_entry;
+            entry.module_name = replaced->module_name;
+
+            new_module_data = create_module(gateway_handle, &entry, false, replaced, &module_apis);
+            if (new_module_data == NULL)
+            {
+                module_result = NULL;
+                LogError("Failed to create the replacement for module [%s].", replaced->module_name);
+            }
+            /*Codes_SRS_GATEWAY_26_033: [ The function shall add to the broker a copy of each link into or out of the module being replaced, including links from "*", with the new module in its place. ]*/
+            else if (add_replacement_links(gateway_handle, replaced, new_module_data, added_links) != 0)
+            {
+                /*Codes_SRS_GATEWAY_26_034: [ If the function fails after the new module is created, it shall remove the links it added, destroy the new module, leave the module being replaced as it was and return NULL. ]*/
+                size_t link;
+                size_t num_links = VECTOR_size(added_links);
+                for (link = 0; link < num_links; link++)
+                {
+                    BROKER_LINK_DATA* broker_link = (BROKER_LINK_DATA*)VECTOR_element(added_links, link);
+                    (void)remove_one_link_from_broker(gateway_handle, broker_link->module_source_handle, broker_link->module_sink_handle);
+                }
+                destroy_module(gateway_handle, new_module_data, module_apis);
+                module_result = NULL;
+                LogError("Failed to link the replacement for module [%s].", replaced->module_name);
+            }
+            else
+            {
+                size_t link;
+                size_t num_links;
+
+                /*Codes_SRS_GATEWAY_26_031: [ The function shall turn the fused links into and out of the module being replaced into regular links. ]*/
+                unfuse_links_of(gateway_handle, replaced);
+
+                /*Codes_SRS_GATEWAY_26_035: [ If the gateway has been started, the function shall call the new module's Module_Start, if defined, before the module being replaced is removed. ]*/
+                if (gateway_handle->started)
+                {
+                    pfModule_Start pfStart = MODULE_START(module_apis);
+                    if (pfStart != NULL)
+                    {
+#ifdef MODULE_ALLOC_STATS_ENABLED
+                        MODULE_ALLOC_TAG previous_alloc_tag = ModuleAlloc_SetThreadTag(new_module_data->alloc_tag);
+#endif
+                        (pfStart)(new_module_data->module);
+#ifdef MODULE_ALLOC_STATS_ENABLED
+                        (void)ModuleAlloc_SetThreadTag(previous_alloc_tag);
+#endif
+                    }
+                }
+
+                /*Codes_SRS_GATEWAY_26_036: [ The function shall put the new module in place of the module being replaced in the gateway's modules and links. ]*/
+                *module_data_pptr = new_module_data;
+                num_links = VECTOR_size(gateway_handle->links);
+                for (link = 0; link < num_links; link++)
+                {
+                    LINK_DATA* link_data = (LINK_DATA*)VECTOR_element(gateway_handle->links, link);
+                    if (link_data->module_source == replaced)
+                    {
+                        link_data->module_source = new_module_data;
+                    }
+                    if (link_data->module_sink == replaced)
+                    {
+                        link_data->module_sink = new_module_data;
+                    }
+                }
+
+                /*Codes_SRS_GATEWAY_26_037: [ The function shall then destroy the module being replaced; the broker delivers the messages published to it before the new module took over, and the new module receives every message published after. ]*/
+                destroy_module(gateway_handle, replaced, replaced->module_loader->api->GetApi(replaced->module_loader, replaced->module_library_handle));
+
+                module_result = new_module_data->module;
+            }
+            VECTOR_destroy(added_links);
+        }
+    }
+
+    return module_result;
 }
 
 bool gateway_addlink_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry)
@@ -651,6 +1031,10 @@ void gateway_removelink_internal(GATEWAY_HANDLE_DATA* gateway_handle, LINK_DATA*
         };
 
         Broker_RemoveLink(gateway_handle->broker, &broker_data);
+        if (link_data->fused)
+        {
+            link_data->module_sink->fused_source = NULL;
+        }
     }
 
     VECTOR_erase(gateway_handle->links, link_data, 1);
@@ -732,6 +1116,12 @@ int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_
     }
     else
     {
+        /*Codes_SRS_GATEWAY_26_024: [ Before it adds a link into a sink that receives on a fused link, the function shall turn that fused link into a regular one. ]*/
+        if ((*module_sink_data)->fused_source != NULL)
+        {
+            unfuse_link_into(gateway_handle, *module_sink_data);
+        }
+
         /*Codes_SRS_GATEWAY_17_004: [ The gateway shall accept a link containing "*" as entryLink->module_source, and a valid module name as a entryLink->module_sink. ]*/
         LINK_DATA link_data =
         {
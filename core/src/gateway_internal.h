@@ -26,6 +26,17 @@ typedef struct MODULE_DATA_TAG {
      *          broker.
      */
     MODULE_HANDLE module;
+
+    /** @brief  Allocation accounting for this module, NULL unless the gateway
+     *          is built with enable_module_alloc_stats.
+     */
+    MODULE_ALLOC_TAG alloc_tag;
+
+    /** @brief  Whether the module's MODULE_API marks it fusion-safe. */
+    bool fusion_safe;
+
+    /** @brief  Source of the fused link the module receives on, or NULL. */
+    struct MODULE_DATA_TAG* fused_source;
 } MODULE_DATA;
 
 typedef struct GATEWAY_HANDLE_DATA_TAG {
@@ -41,18 +52,31 @@ typedef struct GATEWAY_HANDLE_DATA_TAG {
 
     /** @brief  Vector of LINK_DATA links that the Gateway must track */
     VECTOR_HANDLE links;
+
+    /** @brief  True when this Gateway holds a reference on the module
+     *          allocation table.
+     */
+    bool alloc_stats_initialized;
+
+    /** @brief  True when this Gateway holds a reference on the lock profiler. */
+    bool lock_profile_initialized;
+
+    /** @brief  True once Gateway_Start has started the modules */
+    bool started;
 } GATEWAY_HANDLE_DATA;
 
 typedef struct LINK_DATA_TAG {
     bool from_any_source;
     MODULE_DATA *module_source;
     MODULE_DATA *module_sink;
+    bool fused;
 } LINK_DATA;
 
 GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, bool use_json);
 void gateway_destroy_internal(GATEWAY_HANDLE gw);
 MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_MODULES_ENTRY* entry, bool use_json);
 void gateway_removemodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA** module);
+MODULE_HANDLE gateway_replacemodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA** module, const GATEWAY_MODULES_ENTRY* entry);
 bool gateway_addlink_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry);
 void gateway_removelink_internal(GATEWAY_HANDLE_DATA* gateway_handle, LINK_DATA* link_data);
 int add_module_to_any_source(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* module);
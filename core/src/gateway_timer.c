@@ -0,0 +1,542 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#include "gateway_timer.h"
+#include "internal/timer_wheel.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/* sleep time of the service thread while no timer is armed */
+#define GATEWAY_TIMER_NOT_ARMED UINT64_MAX
+
+typedef struct GATEWAY_TIMER_TAG
+{
+    /** Must be first: the wheel hands back entries */
+    TIMER_WHEEL_ENTRY entry;
+    unsigned int period_ms;
+    GATEWAY_TIMER_CALLBACK callback;
+    void* context;
+    /** Taken off the wheel and waiting for its callback on the service thread */
+    bool pending;
+    /** Cancelled while pending or running; the service thread frees it */
+    bool cancelled;
+} GATEWAY_TIMER;
+
+typedef struct GATEWAY_TIMER_SERVICE_TAG
+{
+    size_t ref_count;
+    LOCK_HANDLE lock;
+    /** Signalled when a cancelled timer's callback returns */
+    COND_HANDLE callback_done;
+    TICK_COUNTER_HANDLE tick_counter;
+    TIMER_WHEEL_HANDLE wheel;
+    THREAD_HANDLE thread;
+#ifdef __linux__
+    int timer_fd;
+#else
+    /** Signalled when the service thread needs to wake earlier */
+    COND_HANDLE wakeup;
+#endif
+    /** The time the service thread will next wake up at */
+    uint64_t armed_ms;
+    /** The timer whose callback is running */
+    GATEWAY_TIMER* running;
+    bool stop;
+    GATEWAY_TIMER_STATS stats;
+} GATEWAY_TIMER_SERVICE;
+
+static GATEWAY_TIMER_SERVICE* g_timer_service = NULL;
+
+/*guards g_timer_service and its ref_count. It is created once and never
+destroyed, since Init and Deinit may race from any thread.*/
+static LOCK_HANDLE g_service_lock = NULL;
+#ifdef _WIN32
+static INIT_ONCE g_service_lock_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK create_service_lock(PINIT_ONCE once, PVOID parameter, PVOID* context)
+{
+    (void)once;
+    (void)parameter;
+    (void)context;
+    g_service_lock = Lock_Init();
+    return TRUE;
+}
+#else
+static pthread_once_t g_service_lock_once = PTHREAD_ONCE_INIT;
+
+static void create_service_lock(void)
+{
+    g_service_lock = Lock_Init();
+}
+#endif
+
+/*returns the locked service lock, or NULL if it cannot be created or locked*/
+static LOCK_HANDLE lock_service(void)
+{
+    LOCK_HANDLE result;
+#ifdef _WIN32
+    (void)InitOnceExecuteOnce(&g_service_lock_once, create_service_lock, NULL, NULL);
+#else
+    (void)pthread_once(&g_service_lock_once, create_service_lock);
+#endif
+    if (g_service_lock == NULL || Lock(g_service_lock) != LOCK_OK)
+    {
+        LogError("unable to lock the timer service");
+        result = NULL;
+    }
+    else
+    {
+        result = g_service_lock;
+    }
+    return result;
+}
+
+/*returns the started service, or NULL; the caller's reference keeps it alive*/
+static GATEWAY_TIMER_SERVICE* get_service(void)
+{
+    GATEWAY_TIMER_SERVICE* result;
+    LOCK_HANDLE service_lock = lock_service();
+    if (service_lock == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = g_timer_service;
+        (void)Unlock(service_lock);
+    }
+    return result;
+}
+
+static uint64_t get_now_ms(GATEWAY_TIMER_SERVICE* service)
+{
+    tickcounter_ms_t now;
+    if (tickcounter_get_current_ms(service->tick_counter, &now) != 0)
+    {
+        LogError("unable to read the tick counter");
+        now = 0;
+    }
+    return (uint64_t)now;
+}
+
+/*makes the service thread wake at wake_ms, or sleep until woken if it is GATEWAY_TIMER_NOT_ARMED; called with the lock held*/
+static void arm_service(GATEWAY_TIMER_SERVICE* service, uint64_t wake_ms, uint64_t now_ms)
+{
+    service->armed_ms = wake_ms;
+#ifdef __linux__
+    {
+        /*a zero it_value disarms the timer, so a time that has passed is armed one nanosecond out*/
+        struct itimerspec when = { { 0, 0 }, { 0, 0 } };
+        if (wake_ms != GATEWAY_TIMER_NOT_ARMED)
+        {
+            uint64_t delay_ms = (wake_ms > now_ms) ? wake_ms - now_ms : 0;
+            when.it_value.tv_sec = (time_t)(delay_ms / 1000);
+            when.it_value.tv_nsec = (long)((delay_ms % 1000) * 1000000);
+            if (delay_ms == 0)
+            {
+                when.it_value.tv_nsec = 1;
+            }
+        }
+        if (timerfd_settime(service->timer_fd, 0, &when, NULL) != 0)
+        {
+            LogError("unable to arm the timer service timerfd, errno=%d", errno);
+        }
+    }
+#else
+    (void)now_ms;
+    (void)Condition_Post(service->wakeup);
+#endif
+}
+
+/*blocks the service thread until it is armed to wake; called with the lock held and returns with it held*/
+static void wait_for_wakeup(GATEWAY_TIMER_SERVICE* service, uint64_t now_ms)
+{
+#ifdef __linux__
+    uint64_t expirations;
+    (void)now_ms;
+    (void)Unlock(service->lock);
+    while (read(service->timer_fd, &expirations, sizeof(expirations)) < 0 && errno == EINTR)
+    {
+    }
+    (void)Lock(service->lock);
+#else
+    int timeout_ms;
+    if (service->armed_ms == GATEWAY_TIMER_NOT_ARMED)
+    {
+        /*0 waits until the condition is signalled*/
+        timeout_ms = 0;
+    }
+    else if (service->armed_ms <= now_ms)
+    {
+        timeout_ms = 1;
+    }
+    else
+    {
+        timeout_ms = (service->armed_ms - now_ms > INT32_MAX) ? INT32_MAX : (int)(service->armed_ms - now_ms);
+    }
+    (void)Condition_Wait(service->wakeup, service->lock, timeout_ms);
+#endif
+    service->stats.wakeups++;
+}
+
+static void rearm_service(GATEWAY_TIMER_SERVICE* service, uint64_t now_ms)
+{
+    uint64_t next_ms;
+    arm_service(service, TimerWheel_GetNextTime(service->wheel, &next_ms) ? next_ms : GATEWAY_TIMER_NOT_ARMED, now_ms);
+}
+
+/*runs the callbacks of the timers in due; called with the lock held and returns with it held*/
+static void run_due_timers(GATEWAY_TIMER_SERVICE* service, TIMER_WHEEL_ENTRY* due)
+{
+    TIMER_WHEEL_ENTRY* entry;
+    for (entry = due; entry != NULL; entry = entry->next)
+    {
+        ((GATEWAY_TIMER*)entry)->pending = true;
+    }
+
+    entry = due;
+    while (entry != NULL)
+    {
+        GATEWAY_TIMER* timer = (GATEWAY_TIMER*)entry;
+        entry = entry->next;
+        timer->pending = false;
+        if (timer->cancelled)
+        {
+            free(timer);
+        }
+        else
+        {
+            bool keep;
+            service->running = timer;
+            (void)Unlock(service->lock);
+
+            /*Codes_SRS_GATEWAY_TIMER_26_005: [ The service thread shall call the callback of each timer that is due, one at a time, without holding the service lock. ]*/
+            keep = timer->callback(timer->context);
+
+            (void)Lock(service->lock);
+            service->running = NULL;
+            service->stats.callbacks++;
+            if (timer->cancelled)
+            {
+                free(timer);
+                (void)Condition_Post(service->callback_done);
+            }
+            /*Codes_SRS_GATEWAY_TIMER_26_006: [ A periodic timer shall be due again `period_ms` after it was last due, or `period_ms` from now if that has passed, unless its callback returned false. ]*/
+            else if (timer->period_ms != 0 && keep)
+            {
+                uint64_t now_ms = get_now_ms(service);
+                uint64_t next_ms = timer->entry.expires_ms + timer->period_ms;
+                TimerWheel_Add(service->wheel, &timer->entry, (next_ms > now_ms) ? next_ms : now_ms + timer->period_ms);
+            }
+            else
+            {
+                service->stats.armed--;
+            }
+        }
+    }
+}
+
+static int timer_service_thread(void* param)
+{
+    GATEWAY_TIMER_SERVICE* service = (GATEWAY_TIMER_SERVICE*)param;
+    bool woken = false;
+
+    (void)Lock(service->lock);
+    while (!service->stop)
+    {
+        uint64_t now_ms = get_now_ms(service);
+        TIMER_WHEEL_ENTRY* due = TimerWheel_Advance(service->wheel, now_ms);
+        if (due != NULL)
+        {
+            run_due_timers(service, due);
+            now_ms = get_now_ms(service);
+        }
+        /*Codes_SRS_GATEWAY_TIMER_26_008: [ The service shall count a wakeup of its thread in which no callback was due as an idle wakeup. ]*/
+        else if (woken)
+        {
+            service->stats.idle_wakeups++;
+        }
+
+        if (!service->stop)
+        {
+            /*Codes_SRS_GATEWAY_TIMER_26_007: [ The service thread shall sleep until the next timer is due, and shall not wake up while no timer is scheduled. ]*/
+            rearm_service(service, now_ms);
+            wait_for_wakeup(service, now_ms);
+            woken = true;
+        }
+    }
+    (void)Unlock(service->lock);
+    return 0;
+}
+
+static void destroy_service(GATEWAY_TIMER_SERVICE* service)
+{
+    if (service->wheel != NULL)
+    {
+        TimerWheel_Destroy(service->wheel);
+    }
+    if (service->tick_counter != NULL)
+    {
+        tickcounter_destroy(service->tick_counter);
+    }
+#ifdef __linux__
+    if (service->timer_fd >= 0)
+    {
+        (void)close(service->timer_fd);
+    }
+#else
+    if (service->wakeup != NULL)
+    {
+        Condition_Deinit(service->wakeup);
+    }
+#endif
+    if (service->callback_done != NULL)
+    {
+        Condition_Deinit(service->callback_done);
+    }
+    if (service->lock != NULL)
+    {
+        Lock_Deinit(service->lock);
+    }
+    free(service);
+}
+
+int GatewayTimer_Init(void)
+{
+    int result;
+    /*Codes_SRS_GATEWAY_TIMER_26_015: [ GatewayTimer_Init and GatewayTimer_Deinit shall start, reference and release the service under a lock that is created once, so that they can be called from any thread. ]*/
+    LOCK_HANDLE service_lock = lock_service();
+    if (service_lock == NULL)
+    {
+        result = __LINE__;
+    }
+    else if (g_timer_service != NULL)
+    {
+        /*Codes_SRS_GATEWAY_TIMER_26_002: [ If the service is already started, GatewayTimer_Init shall add a reference to it and return 0. ]*/
+        g_timer_service->ref_count++;
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_TIMER_26_001: [ GatewayTimer_Init shall create the timer wheel and start the service thread, and return non-zero if any step fails. ]*/
+        GATEWAY_TIMER_SERVICE* service = (GATEWAY_TIMER_SERVICE*)calloc(1, sizeof(GATEWAY_TIMER_SERVICE));
+        if (service == NULL)
+        {
+            LogError("unable to allocate the timer service");
+            result = __LINE__;
+        }
+        else
+        {
+#ifdef __linux__
+            service->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+#else
+            service->wakeup = Condition_Init();
+#endif
+            service->lock = Lock_Init();
+            service->callback_done = Condition_Init();
+            service->tick_counter = tickcounter_create();
+            service->wheel = (service->tick_counter == NULL) ? NULL : TimerWheel_Create(get_now_ms(service));
+            service->armed_ms = GATEWAY_TIMER_NOT_ARMED;
+            service->ref_count = 1;
+            if (service->lock == NULL ||
+                service->callback_done == NULL ||
+                service->wheel == NULL ||
+#ifdef __linux__
+                service->timer_fd < 0
+#else
+                service->wakeup == NULL
+#endif
+                )
+            {
+                LogError("unable to create the timer service");
+                destroy_service(service);
+                result = __LINE__;
+            }
+            else if (ThreadAPI_Create(&service->thread, timer_service_thread, service) != THREADAPI_OK)
+            {
+                LogError("unable to start the timer service thread");
+                destroy_service(service);
+                result = __LINE__;
+            }
+            else
+            {
+                g_timer_service = service;
+                result = 0;
+            }
+        }
+    }
+
+    if (service_lock != NULL)
+    {
+        (void)Unlock(service_lock);
+    }
+    return result;
+}
+
+void GatewayTimer_Deinit(void)
+{
+    GATEWAY_TIMER_SERVICE* stopped = NULL;
+    LOCK_HANDLE service_lock = lock_service();
+    if (service_lock != NULL)
+    {
+        GATEWAY_TIMER_SERVICE* service = g_timer_service;
+        /*Codes_SRS_GATEWAY_TIMER_26_004: [ GatewayTimer_Deinit shall do nothing if the service is not started. ]*/
+        if (service == NULL)
+        {
+            LogError("the timer service is not started");
+        }
+        /*Codes_SRS_GATEWAY_TIMER_26_003: [ GatewayTimer_Deinit shall release a reference, and the last release shall stop and join the service thread and free the service. ]*/
+        else if (--service->ref_count == 0)
+        {
+            g_timer_service = NULL;
+            stopped = service;
+        }
+        (void)Unlock(service_lock);
+    }
+
+    /*the service is joined without the service lock, so a callback that is
+    still running may schedule or cancel timers of a service started since*/
+    if (stopped != NULL)
+    {
+        int thread_result;
+
+        (void)Lock(stopped->lock);
+        stopped->stop = true;
+        arm_service(stopped, 0, 0);
+        (void)Unlock(stopped->lock);
+
+        if (ThreadAPI_Join(stopped->thread, &thread_result) != THREADAPI_OK)
+        {
+            LogError("unable to join the timer service thread");
+        }
+        if (stopped->stats.armed != 0)
+        {
+            LogError("%llu timers were not cancelled before the timer service stopped", (unsigned long long)stopped->stats.armed);
+        }
+        destroy_service(stopped);
+    }
+}
+
+GATEWAY_TIMER_HANDLE GatewayTimer_Schedule(unsigned int delay_ms, unsigned int period_ms, GATEWAY_TIMER_CALLBACK callback, void* context)
+{
+    GATEWAY_TIMER* result;
+    GATEWAY_TIMER_SERVICE* service = get_service();
+    /*Codes_SRS_GATEWAY_TIMER_26_009: [ GatewayTimer_Schedule shall return NULL if callback is NULL, the service is not started, or the timer cannot be allocated. ]*/
+    if (callback == NULL || service == NULL)
+    {
+        LogError("invalid arg callback=%p, or the timer service is not started", callback);
+        result = NULL;
+    }
+    else if ((result = (GATEWAY_TIMER*)calloc(1, sizeof(GATEWAY_TIMER))) == NULL)
+    {
+        LogError("unable to allocate a timer");
+    }
+    else
+    {
+        uint64_t now_ms;
+        uint64_t next_ms;
+        result->period_ms = period_ms;
+        result->callback = callback;
+        result->context = context;
+
+        (void)Lock(service->lock);
+        now_ms = get_now_ms(service);
+        /*Codes_SRS_GATEWAY_TIMER_26_010: [ GatewayTimer_Schedule shall put the timer on the wheel to be due `delay_ms` from now. ]*/
+        TimerWheel_Add(service->wheel, &result->entry, now_ms + delay_ms);
+        service->stats.armed++;
+        /*Codes_SRS_GATEWAY_TIMER_26_011: [ If the timer is due before the service thread would wake up, GatewayTimer_Schedule shall re-arm the service to wake earlier. ]*/
+        if (TimerWheel_GetNextTime(service->wheel, &next_ms) && next_ms < service->armed_ms)
+        {
+            arm_service(service, next_ms, now_ms);
+        }
+        (void)Unlock(service->lock);
+    }
+    return result;
+}
+
+void GatewayTimer_Cancel(GATEWAY_TIMER_HANDLE timer)
+{
+    GATEWAY_TIMER_SERVICE* service = get_service();
+    if (timer == NULL || service == NULL)
+    {
+        LogError("invalid arg timer=%p, or the timer service is not started", timer);
+    }
+    else
+    {
+        (void)Lock(service->lock);
+        if (timer->pending || service->running == timer)
+        {
+            /*Codes_SRS_GATEWAY_TIMER_26_013: [ If the timer's callback is due or running, GatewayTimer_Cancel shall leave it to the service thread to free, and wait for a running callback to return. ]*/
+            timer->cancelled = true;
+            service->stats.armed--;
+            while (service->running == timer)
+            {
+                (void)Condition_Wait(service->callback_done, service->lock, 0);
+            }
+        }
+        else
+        {
+            /*Codes_SRS_GATEWAY_TIMER_26_012: [ GatewayTimer_Cancel shall take the timer off the wheel and free it. ]*/
+            if (timer->entry.pprev != NULL)
+            {
+                TimerWheel_Remove(service->wheel, &timer->entry);
+                service->stats.armed--;
+                /*nothing left to wake up for*/
+                if (service->stats.armed == 0 && service->running == NULL)
+                {
+                    arm_service(service, GATEWAY_TIMER_NOT_ARMED, 0);
+                }
+            }
+            free(timer);
+        }
+        (void)Unlock(service->lock);
+    }
+}
+
+int GatewayTimer_GetStats(GATEWAY_TIMER_STATS* stats)
+{
+    int result;
+    /*the caller may hold no reference, so the service lock is held until the stats are copied*/
+    LOCK_HANDLE service_lock = lock_service();
+    GATEWAY_TIMER_SERVICE* service = (service_lock == NULL) ? NULL : g_timer_service;
+    if (stats == NULL || service == NULL)
+    {
+        LogError("invalid arg stats=%p, or the timer service is not started", stats);
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_TIMER_26_014: [ GatewayTimer_GetStats shall copy the service's wakeup, idle wakeup, callback and armed timer counts into stats. ]*/
+        (void)Lock(service->lock);
+        *stats = service->stats;
+        (void)Unlock(service->lock);
+        result = 0;
+    }
+
+    if (service_lock != NULL)
+    {
+        (void)Unlock(service_lock);
+    }
+    return result;
+}
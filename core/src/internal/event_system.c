@@ -6,12 +6,12 @@
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
-#include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
 #include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 
 #include "gateway.h"
+#include "gateway_timer.h"
 #include "experimental/event_system.h"
 
 #include <assert.h>
@@ -19,14 +19,15 @@
 
 struct EVENTSYSTEM_DATA {
     VECTOR_HANDLE event_callbacks[GATEWAY_EVENTS_COUNT];
-    /* Should some callback or thread creation fail all next event reports will be no-op */
+    /* Should some callback or timer scheduling fail all next event reports will be no-op */
     int is_errored;
-    /* @brief Decides whether the thread should have delayed shutdown or not */
-    int delay_when_queue_empty;
+    /* @brief Whether the event system holds a reference to the gateway timer service */
+    int timer_started;
+    /* @brief Set, under thread_queue_lock, while a drain of the queue is scheduled or running */
+    int draining;
 
-    THREAD_HANDLE callback_thread;
-    // The last thread that quit already and needs cleaning up of the handle
-    THREAD_HANDLE destroyed_thread;
+    /* @brief Timer of the last drain, released before the next one is scheduled */
+    GATEWAY_TIMER_HANDLE callback_timer;
     LOCK_HANDLE internal_change_lock;
     LOCK_HANDLE thread_queue_lock;
     COND_HANDLE thread_queue_condition;
@@ -45,15 +46,12 @@ typedef struct THREAD_QUEUE_ROW_TAG {
     GATEWAY_EVENT_CTX context;
 } THREAD_QUEUE_ROW;
 
-/** @brief How long should the thread stay alive before shutting down when the processing queue is empty */
-static const int THREAD_EMPTY_QUEUE_TIMEOUT_MS = 200;
-
 static void destroy_event_system(EVENTSYSTEM_HANDLE handle);
 static void callbacks_call(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, VECTOR_HANDLE callbacks, GATEWAY_EVENT_CTX context);
-static int add_to_thread_queue(EVENTSYSTEM_HANDLE event_system, THREAD_QUEUE_ROW* row);
-static THREAD_QUEUE_ROW* get_from_thread_queue(EVENTSYSTEM_HANDLE event_system, int timeout_ms);
+static int add_to_thread_queue(EVENTSYSTEM_HANDLE event_system, THREAD_QUEUE_ROW* row, int* schedule_drain);
+static THREAD_QUEUE_ROW* get_from_thread_queue(EVENTSYSTEM_HANDLE event_system);
 static void destroy_thread_row(THREAD_QUEUE_ROW* row);
-static int callback_thread_main_func(void* event_system_param);
+static bool drain_thread_queue(void* event_system_param);
 static GATEWAY_EVENT_CTX handle_module_list_update(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks);
 
 /** @brief This function assumes that the context is a #VECTOR_HANDLE and destroys it */
@@ -105,8 +103,6 @@ EVENTSYSTEM_HANDLE EventSystem_Init(void)
             /* callback creation might have failed */
             if (result != NULL)
             {
-                result->delay_when_queue_empty = 1;
-
                 result->thread_queue = singlylinkedlist_create();
                 /* Codes_SRS_EVENTSYSTEM_26_002: [ This function shall return NULL upon any internal error during event system creation. ] */
                 if (result->thread_queue == NULL)
@@ -115,6 +111,18 @@ EVENTSYSTEM_HANDLE EventSystem_Init(void)
                     destroy_event_system(result);
                     result = NULL;
                 }
+                /* Codes_SRS_EVENTSYSTEM_26_017: [ This function shall start the gateway timer service, on whose thread the callbacks are called. ] */
+                else if (GatewayTimer_Init() != 0)
+                {
+                    /* Codes_SRS_EVENTSYSTEM_26_002: [ This function shall return NULL upon any internal error during event system creation. ] */
+                    LogError("failed to start the gateway timer service during event system init");
+                    destroy_event_system(result);
+                    result = NULL;
+                }
+                else
+                {
+                    result->timer_started = 1;
+                }
             }
         }
     }
@@ -137,7 +145,7 @@ void EventSystem_AddEventCallback(EVENTSYSTEM_HANDLE event_system, GATEWAY_EVENT
         };
         if (VECTOR_push_back(event_system->event_callbacks[event_type], &closure, 1) != 0)
         {
-            /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+            /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the callback timer ever fail to be scheduled or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
             LogError("failed to register callback");
             event_system->is_errored = 1;
         }
@@ -151,7 +159,7 @@ void EventSystem_ReportEvent(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw,
     {
         LogError("null gateway handle or gateway event handle when reporting event");
     }
-    /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+    /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the callback timer ever fail to be scheduled or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
     else if (!event_system->is_errored)
     {
         /* Lock-avoiding mechanism, we get a probably-past state with previous if, then check synchronized state to be sure */
@@ -172,7 +180,7 @@ void EventSystem_ReportEvent(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw,
                 VECTOR_HANDLE call_queue = VECTOR_create(sizeof(CALLBACK_CLOSURE));
                 if (call_queue == NULL)
                 {
-                    /*Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+                    /*Codes_SRS_EVENTSYSTEM_26_013: [ Should the callback timer ever fail to be scheduled or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
                     LogError("Failed to create call queue during event report");
                     event_system->is_errored = 1;
                 }
@@ -180,7 +188,7 @@ void EventSystem_ReportEvent(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw,
                 {
                     if (VECTOR_push_back(call_queue, VECTOR_front(callbacks), vector_size) != 0)
                     {
-                        /*Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+                        /*Codes_SRS_EVENTSYSTEM_26_013: [ Should the callback timer ever fail to be scheduled or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
                         LogError("Failed to copy callback queue during event report");
                         event_system->is_errored = 1;
                         VECTOR_destroy(call_queue);
@@ -225,42 +233,41 @@ static void destroy_event_system(EVENTSYSTEM_HANDLE handle)
     {
         if (handle->thread_queue_lock != NULL && handle->thread_queue_condition != NULL)
         {
-            /* force the thread to not wait for new stuff on the queue and return as soon as the queue is empty */
             Lock(handle->thread_queue_lock);
 
-            /* in case the thread is still running callbacks, notify it that it shouldn't wait for new data later on */
-            handle->delay_when_queue_empty = 0;
-            /* in case the thread is already waiting and we want it to stop waiting */
-            Condition_Post(handle->thread_queue_condition);
+            /* Codes_SRS_EVENTSYSTEM_26_005: [ This function shall wait for all callbacks to finish before returning. ] */
+            /* the drain runs until the queue is empty, then posts the condition */
+            while (handle->draining)
+            {
+                Condition_Wait(handle->thread_queue_condition, handle->thread_queue_lock, 0);
+            }
 
             Unlock(handle->thread_queue_lock);
         }
 
-        THREAD_HANDLE callback_thread = NULL, destroyed_thread = NULL;
+        GATEWAY_TIMER_HANDLE callback_timer = NULL;
         if (handle->internal_change_lock != NULL)
         {
-            // The thread might be running, we want to wait for it to finish, but it might be moving the handles
-            // So we need to have a copy of those
             Lock(handle->internal_change_lock);
 
-            callback_thread = handle->callback_thread;
-            destroyed_thread = handle->destroyed_thread;
+            callback_timer = handle->callback_timer;
+            handle->callback_timer = NULL;
 
             Unlock(handle->internal_change_lock);
         }
 
-        int thread_res;
-        /* Codes_SRS_EVENTSYSTEM_26_005: [ This function shall wait for all callbacks to finish before returning. ] */
-        if (callback_thread != NULL)
-            ThreadAPI_Join(callback_thread, &thread_res);
-        if (destroyed_thread != NULL)
-            ThreadAPI_Join(destroyed_thread, &thread_res);
+        /* Codes_SRS_EVENTSYSTEM_26_019: [ This function shall release the timer of the last drain and the gateway timer service. ] */
+        /* waits for the last drain to return, if it is still returning */
+        if (callback_timer != NULL)
+            GatewayTimer_Cancel(callback_timer);
+        if (handle->timer_started)
+            GatewayTimer_Deinit();
         /* Codes_SRS_EVENTSYSTEM_26_003: [ This function shall destroy and free resources of the given event system. ] */
         Condition_Deinit(handle->thread_queue_condition);
         Lock_Deinit(handle->thread_queue_lock);
         Lock_Deinit(handle->internal_change_lock);
 
-        /* Something might have been left on the list if thread errored out */
+        /* Something might have been left on the list if the drain failed to be scheduled */
         LIST_ITEM_HANDLE node = NULL;
         while ((node = singlylinkedlist_get_head_item(handle->thread_queue)) != NULL)
         {
@@ -277,6 +284,7 @@ static void destroy_event_system(EVENTSYSTEM_HANDLE handle)
 
 static void callbacks_call(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, VECTOR_HANDLE callbacks, GATEWAY_EVENT_CTX context)
 {
+    int schedule_drain = 0;
     THREAD_QUEUE_ROW* row = (THREAD_QUEUE_ROW*)malloc(sizeof(THREAD_QUEUE_ROW));
     if (row == NULL)
     {
@@ -290,7 +298,7 @@ static void callbacks_call(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, G
         row->callbacks = callbacks;
         row->context = context;
         /* Failed to add to queue, we have allocated row which won't be freed during EventSystem destroy */
-        if (add_to_thread_queue(event_system, row))
+        if (add_to_thread_queue(event_system, row, &schedule_drain))
         {
             destroy_thread_row(row);
             row = NULL;
@@ -299,63 +307,71 @@ static void callbacks_call(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, G
 
     Lock(event_system->internal_change_lock);
 
-    // There's a thread to cleanup that was destroyed but has a floating handle
-    if (event_system->destroyed_thread != NULL)
-    {
-        int res;
-        ThreadAPI_Join(event_system->destroyed_thread, &res);
-        event_system->destroyed_thread = NULL;
-    }
-
-    /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+    /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the callback timer ever fail to be scheduled or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
     if (row == NULL)
     {
         event_system->is_errored = 1;
     }
-    else if (event_system->callback_thread == NULL)
+    else if (schedule_drain)
     {
+        // The last drain found the queue empty, so its timer has fired for good
+        if (event_system->callback_timer != NULL)
+            GatewayTimer_Cancel(event_system->callback_timer);
+
         /* Codes_SRS_EVENTSYSTEM_26_008: [ This function shall call all registered callbacks on a seperate thread. ] */
-        THREADAPI_RESULT result = ThreadAPI_Create(&event_system->callback_thread, callback_thread_main_func, (void*)event_system);
-        /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+        /* Codes_SRS_EVENTSYSTEM_26_018: [ This function shall call the callbacks from a one-shot timer of the gateway timer service, scheduled when an event is queued and no drain of the queue is scheduled or running. ] */
+        event_system->callback_timer = GatewayTimer_Schedule(0, 0, drain_thread_queue, (void*)event_system);
+        /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the callback timer ever fail to be scheduled or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
         /* Stuff on the queue will be deleted when destroying EventSystem */
-        if (result != THREADAPI_OK)
+        if (event_system->callback_timer == NULL)
+        {
+            LogError("failed to schedule the event system callbacks");
             event_system->is_errored = 1;
+
+            Lock(event_system->thread_queue_lock);
+            event_system->draining = 0;
+            Unlock(event_system->thread_queue_lock);
+        }
     }
 
     Unlock(event_system->internal_change_lock);
 }
 
-static int add_to_thread_queue(EVENTSYSTEM_HANDLE event_system, THREAD_QUEUE_ROW* row)
+/* Sets schedule_drain when no drain is scheduled or running to take the row */
+static int add_to_thread_queue(EVENTSYSTEM_HANDLE event_system, THREAD_QUEUE_ROW* row, int* schedule_drain)
 {
     Lock(event_system->thread_queue_lock);
 
     int errored = !singlylinkedlist_add(event_system->thread_queue, row);
-    Condition_Post(event_system->thread_queue_condition);
+    if (!errored && !event_system->draining)
+    {
+        event_system->draining = 1;
+        *schedule_drain = 1;
+    }
 
     Unlock(event_system->thread_queue_lock);
 
     return errored;
 }
 
-static THREAD_QUEUE_ROW* get_from_thread_queue(EVENTSYSTEM_HANDLE event_system, int timeout_ms)
+static THREAD_QUEUE_ROW* get_from_thread_queue(EVENTSYSTEM_HANDLE event_system)
 {
     THREAD_QUEUE_ROW* row = NULL;
     
     Lock(event_system->thread_queue_lock);
     
     LIST_ITEM_HANDLE node = singlylinkedlist_get_head_item(event_system->thread_queue);
-    if (node == NULL && event_system->delay_when_queue_empty)
-    {
-        Condition_Wait(event_system->thread_queue_condition, event_system->thread_queue_lock, timeout_ms);
-        node = singlylinkedlist_get_head_item(event_system->thread_queue);
-    }
-
-    /* Condition might have timed out or we don't have delayed destroy so the node can be NULL */
     if (node != NULL)
     {
         row = (THREAD_QUEUE_ROW*)singlylinkedlist_item_get_value(node);
         singlylinkedlist_remove(event_system->thread_queue, node);
     }
+    else
+    {
+        /* the next event schedules a new drain; wake EventSystem_Destroy if it waits for this one */
+        event_system->draining = 0;
+        Condition_Post(event_system->thread_queue_condition);
+    }
     
     Unlock(event_system->thread_queue_lock);
     
@@ -369,11 +385,12 @@ static void destroy_thread_row(THREAD_QUEUE_ROW* row)
     free(row);
 }
 
-static int callback_thread_main_func(void* event_system_param)
+/* Runs on the gateway timer service thread until the queue is empty */
+static bool drain_thread_queue(void* event_system_param)
 {
     EVENTSYSTEM_HANDLE event_system = (EVENTSYSTEM_HANDLE)event_system_param;
     THREAD_QUEUE_ROW* row;
-    while ((row = get_from_thread_queue(event_system, THREAD_EMPTY_QUEUE_TIMEOUT_MS)) != NULL)
+    while ((row = get_from_thread_queue(event_system)) != NULL)
     {
         size_t vector_size = VECTOR_size(row->callbacks);
         /* Codes_SRS_EVENTSYSTEM_26_006: [ This function shall call all registered callbacks for the given GATEWAY_EVENT. ] */
@@ -387,14 +404,7 @@ static int callback_thread_main_func(void* event_system_param)
         destroy_thread_row(row);
     }
 
-    Lock(event_system->internal_change_lock);
-
-    event_system->destroyed_thread = event_system->callback_thread;
-    event_system->callback_thread = NULL;
-
-    Unlock(event_system->internal_change_lock);
-
-    return THREADAPI_OK;
+    return false;
 }
 
 static GATEWAY_EVENT_CTX handle_module_list_update(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks)
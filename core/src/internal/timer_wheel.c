@@ -0,0 +1,244 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "timer_wheel.h"
+
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+/* the furthest an entry can be placed from the current time; entries further
+ * out are placed this far and placed again when their slot is reached */
+#define TIMER_WHEEL_SPAN (((uint64_t)1 << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+/* The wheel turns one millisecond at a time. Level 0 has a slot for each of
+ * the next TIMER_WHEEL_SLOTS milliseconds; a slot on level n covers
+ * TIMER_WHEEL_SLOTS^n milliseconds, and its entries are moved down a level
+ * when the wheel reaches the start of that span. Milliseconds in which
+ * nothing expires and nothing moves down are skipped, so turning the wheel
+ * over a long idle stretch costs no more than turning it once.
+ */
+typedef struct TIMER_WHEEL_TAG
+{
+    /** The next millisecond the wheel has not turned to */
+    uint64_t tick;
+
+    /** Number of entries on the wheel */
+    size_t count;
+
+    TIMER_WHEEL_ENTRY* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+} TIMER_WHEEL;
+
+static void place_entry(TIMER_WHEEL* wheel, TIMER_WHEEL_ENTRY* entry)
+{
+    uint64_t expires = (entry->expires_ms < wheel->tick) ? wheel->tick : entry->expires_ms;
+    uint64_t delta = expires - wheel->tick;
+    unsigned int level = 0;
+    TIMER_WHEEL_ENTRY** slot;
+
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= ((uint64_t)1 << (TIMER_WHEEL_SLOT_BITS * (level + 1))))
+    {
+        level++;
+    }
+    if (delta > TIMER_WHEEL_SPAN)
+    {
+        expires = wheel->tick + TIMER_WHEEL_SPAN;
+    }
+
+    slot = &wheel->slots[level][(expires >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK];
+    entry->next = *slot;
+    if (entry->next != NULL)
+    {
+        entry->next->pprev = &entry->next;
+    }
+    entry->pprev = slot;
+    *slot = entry;
+}
+
+static void unlink_entry(TIMER_WHEEL_ENTRY* entry)
+{
+    *entry->pprev = entry->next;
+    if (entry->next != NULL)
+    {
+        entry->next->pprev = entry->pprev;
+    }
+    entry->pprev = NULL;
+}
+
+/*moves the entries of a slot on a higher level down to where they belong now*/
+static void cascade_slot(TIMER_WHEEL* wheel, unsigned int level)
+{
+    TIMER_WHEEL_ENTRY** slot = &wheel->slots[level][(wheel->tick >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK];
+    TIMER_WHEEL_ENTRY* entry = *slot;
+    *slot = NULL;
+    while (entry != NULL)
+    {
+        TIMER_WHEEL_ENTRY* next = entry->next;
+        place_entry(wheel, entry);
+        entry = next;
+    }
+}
+
+static bool get_next_tick(const TIMER_WHEEL* wheel, uint64_t* next_tick)
+{
+    bool result;
+    if (wheel->count == 0)
+    {
+        result = false;
+    }
+    else
+    {
+        uint64_t next = UINT64_MAX;
+        unsigned int level;
+        unsigned int i;
+
+        /*entries on level 0 expire at the millisecond of their slot*/
+        for (i = 0; i < TIMER_WHEEL_SLOTS; i++)
+        {
+            if (wheel->slots[0][(wheel->tick + i) & TIMER_WHEEL_SLOT_MASK] != NULL)
+            {
+                next = wheel->tick + i;
+                break;
+            }
+        }
+
+        /*entries on higher levels need the wheel to turn to the start of their slot's span*/
+        for (level = 1; level < TIMER_WHEEL_LEVELS; level++)
+        {
+            unsigned int shift = TIMER_WHEEL_SLOT_BITS * level;
+            uint64_t first_span = (wheel->tick + ((uint64_t)1 << shift) - 1) >> shift;
+            for (i = 0; i < TIMER_WHEEL_SLOTS; i++)
+            {
+                if (wheel->slots[level][(first_span + i) & TIMER_WHEEL_SLOT_MASK] != NULL)
+                {
+                    uint64_t span_start = (first_span + i) << shift;
+                    if (span_start < next)
+                    {
+                        next = span_start;
+                    }
+                    break;
+                }
+            }
+        }
+
+        *next_tick = next;
+        result = true;
+    }
+    return result;
+}
+
+TIMER_WHEEL_HANDLE TimerWheel_Create(uint64_t now_ms)
+{
+    /*Codes_SRS_TIMER_WHEEL_26_001: [ TimerWheel_Create shall return NULL if it cannot allocate the wheel, or an empty wheel whose current time is now_ms otherwise. ]*/
+    TIMER_WHEEL* result = (TIMER_WHEEL*)calloc(1, sizeof(TIMER_WHEEL));
+    if (result == NULL)
+    {
+        LogError("unable to allocate a timer wheel");
+    }
+    else
+    {
+        result->tick = now_ms;
+    }
+    return result;
+}
+
+void TimerWheel_Destroy(TIMER_WHEEL_HANDLE wheel)
+{
+    free(wheel);
+}
+
+void TimerWheel_Add(TIMER_WHEEL_HANDLE wheel, TIMER_WHEEL_ENTRY* entry, uint64_t expires_ms)
+{
+    if (wheel == NULL || entry == NULL)
+    {
+        LogError("invalid arg wheel=%p, entry=%p", wheel, entry);
+    }
+    else
+    {
+        /*Codes_SRS_TIMER_WHEEL_26_002: [ TimerWheel_Add shall take entry off the wheel if it is on it, and put it back to expire at expires_ms. ]*/
+        if (entry->pprev != NULL)
+        {
+            unlink_entry(entry);
+        }
+        else
+        {
+            wheel->count++;
+        }
+        entry->expires_ms = expires_ms;
+        place_entry(wheel, entry);
+    }
+}
+
+void TimerWheel_Remove(TIMER_WHEEL_HANDLE wheel, TIMER_WHEEL_ENTRY* entry)
+{
+    /*Codes_SRS_TIMER_WHEEL_26_003: [ TimerWheel_Remove shall take entry off the wheel, and do nothing if it is not on it. ]*/
+    if (wheel != NULL && entry != NULL && entry->pprev != NULL)
+    {
+        unlink_entry(entry);
+        wheel->count--;
+    }
+}
+
+TIMER_WHEEL_ENTRY* TimerWheel_Advance(TIMER_WHEEL_HANDLE wheel, uint64_t now_ms)
+{
+    TIMER_WHEEL_ENTRY* result = NULL;
+    TIMER_WHEEL_ENTRY** tail = &result;
+    if (wheel != NULL)
+    {
+        uint64_t next;
+        /*Codes_SRS_TIMER_WHEEL_26_004: [ TimerWheel_Advance shall take off and return every entry whose expires_ms is not later than now_ms, chained through next in the order they expire. ]*/
+        /*Codes_SRS_TIMER_WHEEL_26_005: [ TimerWheel_Advance shall only visit the milliseconds in which an entry expires or moves down a level. ]*/
+        while (wheel->tick <= now_ms && get_next_tick(wheel, &next) && next <= now_ms)
+        {
+            unsigned int level;
+            TIMER_WHEEL_ENTRY** slot;
+
+            wheel->tick = next;
+            for (level = TIMER_WHEEL_LEVELS - 1; level > 0; level--)
+            {
+                if ((wheel->tick & (((uint64_t)1 << (TIMER_WHEEL_SLOT_BITS * level)) - 1)) == 0)
+                {
+                    cascade_slot(wheel, level);
+                }
+            }
+
+            slot = &wheel->slots[0][wheel->tick & TIMER_WHEEL_SLOT_MASK];
+            while (*slot != NULL)
+            {
+                TIMER_WHEEL_ENTRY* entry = *slot;
+                unlink_entry(entry);
+                wheel->count--;
+                entry->next = NULL;
+                *tail = entry;
+                tail = &entry->next;
+            }
+            wheel->tick++;
+        }
+
+        if (wheel->tick <= now_ms)
+        {
+            wheel->tick = now_ms + 1;
+        }
+    }
+    return result;
+}
+
+bool TimerWheel_GetNextTime(TIMER_WHEEL_HANDLE wheel, uint64_t* next_ms)
+{
+    bool result;
+    if (wheel == NULL || next_ms == NULL)
+    {
+        LogError("invalid arg wheel=%p, next_ms=%p", wheel, next_ms);
+        result = false;
+    }
+    else
+    {
+        /*Codes_SRS_TIMER_WHEEL_26_006: [ TimerWheel_GetNextTime shall return false if the wheel is empty, or set next_ms to a time no later than the earliest expiry on the wheel and return true otherwise. ]*/
+        result = get_next_tick(wheel, next_ms);
+    }
+    return result;
+}
@@ -0,0 +1,96 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       timer_wheel.h
+*   @brief      Internal hierarchical timer wheel used by the gateway timer
+*               service. It keeps no time of its own and starts no threads:
+*               the caller tells it the time when it adds entries and when it
+*               advances it. It is not thread safe.
+*/
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C"
+{
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#endif // __cplusplus
+
+/** @brief  Number of slots on each level of the wheel, as a power of 2 */
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+
+/** @brief  Number of levels. Level n holds entries that expire within
+ *          TIMER_WHEEL_SLOTS^(n+1) milliseconds; entries further out wait on
+ *          the last level and are placed again as the wheel turns.
+ */
+#define TIMER_WHEEL_LEVELS 4
+
+/** @brief  An entry on the wheel. The caller owns the memory and must keep it
+ *          alive until the entry expires or is removed.
+ */
+typedef struct TIMER_WHEEL_ENTRY_TAG
+{
+    /** @brief  Time, in milliseconds, at which the entry expires */
+    uint64_t expires_ms;
+
+    /** @brief  Next entry on the same slot, or in the list of expired
+     *          entries returned by #TimerWheel_Advance.
+     */
+    struct TIMER_WHEEL_ENTRY_TAG* next;
+
+    /** @brief  The pointer that points at this entry on its slot, or NULL
+     *          when the entry is not on the wheel.
+     */
+    struct TIMER_WHEEL_ENTRY_TAG** pprev;
+} TIMER_WHEEL_ENTRY;
+
+typedef struct TIMER_WHEEL_TAG* TIMER_WHEEL_HANDLE;
+
+/** @brief      Creates an empty wheel whose current time is @c now_ms.
+ *
+ *  @return     A wheel, or @c NULL if it cannot be allocated.
+ */
+TIMER_WHEEL_HANDLE TimerWheel_Create(uint64_t now_ms);
+
+/** @brief      Frees the wheel. Entries still on it are left as they are. */
+void TimerWheel_Destroy(TIMER_WHEEL_HANDLE wheel);
+
+/** @brief      Puts @c entry on the wheel to expire at @c expires_ms. An
+ *              entry that is already on the wheel is moved. An entry whose
+ *              time has passed expires at the next millisecond the wheel is
+ *              turned to.
+ *
+ *              @c entry->pprev must be NULL the first time an entry is added.
+ */
+void TimerWheel_Add(TIMER_WHEEL_HANDLE wheel, TIMER_WHEEL_ENTRY* entry, uint64_t expires_ms);
+
+/** @brief      Takes @c entry off the wheel, if it is on it. */
+void TimerWheel_Remove(TIMER_WHEEL_HANDLE wheel, TIMER_WHEEL_ENTRY* entry);
+
+/** @brief      Turns the wheel to @c now_ms and takes off every entry that
+ *              expired, in the order they expire.
+ *
+ *  @return     The expired entries, chained through @c next, or @c NULL.
+ */
+TIMER_WHEEL_ENTRY* TimerWheel_Advance(TIMER_WHEEL_HANDLE wheel, uint64_t now_ms);
+
+/** @brief      Gets the time at which the wheel next needs to turn. This is
+ *              never later than the earliest expiry on the wheel, and may be
+ *              earlier when an entry waits on a higher level.
+ *
+ *  @return     @c false, with @c next_ms untouched, when the wheel is empty.
+ */
+bool TimerWheel_GetNextTime(TIMER_WHEEL_HANDLE wheel, uint64_t* next_ms);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,658 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* this file implements the redirected functions, so it must call the real Lock and Unlock */
+#define LOCK_PROFILE_NO_REDIRECT
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <pthread.h>
+#endif
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+
+#include "lock_profile.h"
+
+#ifdef _MSC_VER
+#define LOCK_PROFILE_THREAD_LOCAL __declspec(thread)
+#else
+#define LOCK_PROFILE_THREAD_LOCAL __thread
+#endif
+
+/*a power of two, so a call site can be found with a mask*/
+#define LOCK_PROFILE_SITE_COUNT 256
+/*deepest nesting of profiled locks that a thread can hold and still have timed*/
+#define LOCK_PROFILE_HELD_DEPTH 16
+/*an uncontended Lock returns in well under this*/
+#define LOCK_PROFILE_CONTENDED_NS 1000
+
+typedef struct LOCK_PROFILE_COUNTERS_TAG
+{
+    uint64_t acquisitions;
+    uint64_t contended_acquisitions;
+    uint64_t total_wait_ns;
+    uint64_t max_wait_ns;
+    uint64_t total_hold_ns;
+    uint64_t max_hold_ns;
+} LOCK_PROFILE_COUNTERS;
+
+/*counters of one thread, indexed like sites; only that thread writes them.
+They are never freed, since a thread outside the gateway may be updating them
+while the profiler is torn down. When their thread exits they are added to
+retired and the block is given to the next new thread.*/
+typedef struct LOCK_PROFILE_THREAD_DATA_TAG
+{
+    LOCK_PROFILE_COUNTERS counters[LOCK_PROFILE_SITE_COUNT];
+    /*the profiling session the counters belong to, under registry_lock*/
+    size_t generation;
+    /*false once the thread has exited, under registry_lock*/
+    bool in_use;
+    struct LOCK_PROFILE_THREAD_DATA_TAG* next;
+} LOCK_PROFILE_THREAD_DATA;
+
+typedef struct LOCK_PROFILE_HELD_TAG
+{
+    LOCK_HANDLE handle;
+    LOCK_PROFILE_COUNTERS* counters;
+    uint64_t acquired_ns;
+} LOCK_PROFILE_HELD;
+
+/*created by the first successful Init and never destroyed, like the thread
+data, so that a profiled Lock racing with Deinit never uses a freed lock.
+init_count is read without it: a Lock that sees a stale count profiles one
+more or one fewer acquisition, and everything it touches stays valid.*/
+static LOCK_HANDLE volatile registry_lock = NULL;
+static volatile size_t init_count = 0;
+/*bumped by every Deinit that ends a session, so threads know to start over*/
+static volatile size_t generation = 0;
+static const char* volatile sites[LOCK_PROFILE_SITE_COUNT];
+static size_t site_count = 0;
+static bool sites_full_logged = false;
+static LOCK_PROFILE_THREAD_DATA* threads = NULL;
+/*the counters of the threads that exited during this session, under registry_lock*/
+static LOCK_PROFILE_THREAD_DATA retired;
+static volatile sig_atomic_t dump_requested = 0;
+
+/*created with registry_lock and never deleted; its destructor retires the
+counters of an exiting thread*/
+#ifdef _WIN32
+static DWORD exit_key = FLS_OUT_OF_INDEXES;
+#else
+static pthread_key_t exit_key;
+#endif
+static bool exit_key_created = false;
+
+static LOCK_PROFILE_THREAD_LOCAL LOCK_PROFILE_THREAD_DATA* thread_data = NULL;
+static LOCK_PROFILE_THREAD_LOCAL size_t thread_generation = 0;
+static LOCK_PROFILE_THREAD_LOCAL LOCK_PROFILE_HELD held[LOCK_PROFILE_HELD_DEPTH];
+static LOCK_PROFILE_THREAD_LOCAL size_t held_count = 0;
+
+#ifndef _WIN32
+static bool signal_installed = false;
+static struct sigaction previous_action;
+
+static void on_dump_signal(int signal_number)
+{
+    (void)signal_number;
+    LockProfile_RequestDump();
+}
+#endif
+
+static uint64_t get_time_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    (void)QueryPerformanceCounter(&counter);
+    (void)QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)counter.QuadPart * 1000000000.0 / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static size_t slot_of(const char* site)
+{
+    /*site names are string literals laid out next to each other, so their addresses differ in the low bits*/
+    uintptr_t address = (uintptr_t)site;
+    return (size_t)((address ^ (address >> 8)) & (LOCK_PROFILE_SITE_COUNT - 1));
+}
+
+/*returns the slot of site, registering it on first use, or LOCK_PROFILE_SITE_COUNT when the table is full*/
+static size_t find_site(const char* site)
+{
+    size_t result = LOCK_PROFILE_SITE_COUNT;
+    size_t slot = slot_of(site);
+    size_t probes;
+
+    /*sites are never removed while profiling, so a slot once filled keeps its site*/
+    for (probes = 0; probes < LOCK_PROFILE_SITE_COUNT; probes++)
+    {
+        const char* current = sites[slot];
+        if (current == site)
+        {
+            result = slot;
+            break;
+        }
+        else if (current == NULL)
+        {
+            break;
+        }
+        slot = (slot + 1) & (LOCK_PROFILE_SITE_COUNT - 1);
+    }
+
+    if (result == LOCK_PROFILE_SITE_COUNT && Lock(registry_lock) == LOCK_OK)
+    {
+        /*another thread may have registered it, or filled this slot, since the lookup above*/
+        slot = slot_of(site);
+        for (probes = 0; probes < LOCK_PROFILE_SITE_COUNT; probes++)
+        {
+            if (sites[slot] == site)
+            {
+                result = slot;
+                break;
+            }
+            else if (sites[slot] == NULL)
+            {
+                sites[slot] = site;
+                site_count++;
+                result = slot;
+                break;
+            }
+            slot = (slot + 1) & (LOCK_PROFILE_SITE_COUNT - 1);
+        }
+
+        if (result == LOCK_PROFILE_SITE_COUNT && !sites_full_logged)
+        {
+            sites_full_logged = true;
+            LogError("more than %d lock sites; '%s' and later sites are not profiled", LOCK_PROFILE_SITE_COUNT, site);
+        }
+        (void)Unlock(registry_lock);
+    }
+    return result;
+}
+
+static void add_counters(LOCK_PROFILE_COUNTERS* total, const LOCK_PROFILE_COUNTERS* counters)
+{
+    total->acquisitions += counters->acquisitions;
+    total->contended_acquisitions += counters->contended_acquisitions;
+    total->total_wait_ns += counters->total_wait_ns;
+    total->total_hold_ns += counters->total_hold_ns;
+    if (counters->max_wait_ns > total->max_wait_ns)
+    {
+        total->max_wait_ns = counters->max_wait_ns;
+    }
+    if (counters->max_hold_ns > total->max_hold_ns)
+    {
+        total->max_hold_ns = counters->max_hold_ns;
+    }
+}
+
+/*called when a thread that took a profiled lock exits*/
+#ifdef _WIN32
+static VOID WINAPI retire_thread_data(PVOID value)
+#else
+static void retire_thread_data(void* value)
+#endif
+{
+    LOCK_PROFILE_THREAD_DATA* data = (LOCK_PROFILE_THREAD_DATA*)value;
+    if (data != NULL && Lock(registry_lock) == LOCK_OK)
+    {
+        if (data->generation == generation)
+        {
+            size_t slot;
+            if (retired.generation != generation)
+            {
+                (void)memset(retired.counters, 0, sizeof(retired.counters));
+                retired.generation = generation;
+            }
+            for (slot = 0; slot < LOCK_PROFILE_SITE_COUNT; slot++)
+            {
+                add_counters(&retired.counters[slot], &data->counters[slot]);
+            }
+        }
+        data->in_use = false;
+        (void)Unlock(registry_lock);
+    }
+    /*a later thread exit destructor that takes a profiled lock starts over with another block*/
+    thread_data = NULL;
+    thread_generation = 0;
+    held_count = 0;
+}
+
+static bool create_exit_key(void)
+{
+#ifdef _WIN32
+    exit_key = FlsAlloc(retire_thread_data);
+    return (exit_key != FLS_OUT_OF_INDEXES);
+#else
+    return (pthread_key_create(&exit_key, retire_thread_data) == 0);
+#endif
+}
+
+static void set_exit_key(LOCK_PROFILE_THREAD_DATA* data)
+{
+    if (exit_key_created)
+    {
+#ifdef _WIN32
+        (void)FlsSetValue(exit_key, data);
+#else
+        (void)pthread_setspecific(exit_key, data);
+#endif
+    }
+}
+
+/*returns the block of a thread that has exited, or NULL; the caller holds registry_lock*/
+static LOCK_PROFILE_THREAD_DATA* reuse_thread_data(void)
+{
+    LOCK_PROFILE_THREAD_DATA* result = threads;
+    while (result != NULL && result->in_use)
+    {
+        result = result->next;
+    }
+    if (result != NULL)
+    {
+        (void)memset(result->counters, 0, sizeof(result->counters));
+    }
+    return result;
+}
+
+/*returns the counters of the calling thread, or NULL when they cannot be allocated*/
+static LOCK_PROFILE_THREAD_DATA* get_thread_data(void)
+{
+    size_t current = generation;
+    if (thread_data == NULL || thread_generation != current)
+    {
+        /*locks held since a previous profiling session are not timed*/
+        held_count = 0;
+        if (Lock(registry_lock) == LOCK_OK)
+        {
+            if (thread_data == NULL)
+            {
+                thread_data = reuse_thread_data();
+                if (thread_data == NULL)
+                {
+                    thread_data = (LOCK_PROFILE_THREAD_DATA*)calloc(1, sizeof(LOCK_PROFILE_THREAD_DATA));
+                    if (thread_data == NULL)
+                    {
+                        LogError("unable to allocate lock profile counters");
+                    }
+                    else
+                    {
+                        thread_data->next = threads;
+                        threads = thread_data;
+                    }
+                }
+
+                if (thread_data != NULL)
+                {
+                    thread_data->in_use = true;
+                    set_exit_key(thread_data);
+                }
+            }
+            else
+            {
+                /*the counters of a previous profiling session are reused*/
+                (void)memset(thread_data->counters, 0, sizeof(thread_data->counters));
+            }
+
+            if (thread_data != NULL)
+            {
+                thread_data->generation = current;
+                thread_generation = current;
+            }
+            (void)Unlock(registry_lock);
+        }
+    }
+    return thread_data;
+}
+
+static void charge_hold(LOCK_PROFILE_HELD* entry, uint64_t now)
+{
+    uint64_t hold_ns = now - entry->acquired_ns;
+    entry->counters->total_hold_ns += hold_ns;
+    if (hold_ns > entry->counters->max_hold_ns)
+    {
+        entry->counters->max_hold_ns = hold_ns;
+    }
+}
+
+/*returns the innermost entry of handle held by the calling thread, or NULL*/
+static LOCK_PROFILE_HELD* find_held(LOCK_HANDLE handle)
+{
+    LOCK_PROFILE_HELD* result = NULL;
+    size_t i = held_count;
+    while (i > 0)
+    {
+        i--;
+        if (held[i].handle == handle)
+        {
+            result = &held[i];
+            break;
+        }
+    }
+    return result;
+}
+
+static void add_stats(LOCK_PROFILE_STATS* stats, const LOCK_PROFILE_COUNTERS* counters)
+{
+    stats->acquisitions += counters->acquisitions;
+    stats->contended_acquisitions += counters->contended_acquisitions;
+    stats->total_wait_ns += counters->total_wait_ns;
+    stats->total_hold_ns += counters->total_hold_ns;
+    if (counters->max_wait_ns > stats->max_wait_ns)
+    {
+        stats->max_wait_ns = counters->max_wait_ns;
+    }
+    if (counters->max_hold_ns > stats->max_hold_ns)
+    {
+        stats->max_hold_ns = counters->max_hold_ns;
+    }
+}
+
+static size_t collect_stats(LOCK_PROFILE_STATS* all)
+{
+    size_t result = 0;
+    size_t slot;
+    for (slot = 0; slot < LOCK_PROFILE_SITE_COUNT; slot++)
+    {
+        if (sites[slot] != NULL)
+        {
+            size_t index;
+            const LOCK_PROFILE_THREAD_DATA* thread;
+
+            /*a header such as the Node.js binding's lock.h names its site once for every file that includes it*/
+            for (index = 0; index < result; index++)
+            {
+                if (strcmp(all[index].site, sites[slot]) == 0)
+                {
+                    break;
+                }
+            }
+            if (index == result)
+            {
+                (void)memset(&all[index], 0, sizeof(LOCK_PROFILE_STATS));
+                all[index].site = sites[slot];
+                result++;
+            }
+
+            for (thread = threads; thread != NULL; thread = thread->next)
+            {
+                if (!thread->in_use || thread->generation != generation)
+                {
+                    /*the thread has exited, or not taken a profiled lock since the last Deinit*/
+                    continue;
+                }
+                add_stats(&all[index], &thread->counters[slot]);
+            }
+            if (retired.generation == generation)
+            {
+                add_stats(&all[index], &retired.counters[slot]);
+            }
+        }
+    }
+    return result;
+}
+
+static int compare_total_wait(const void* left, const void* right)
+{
+    uint64_t left_wait = ((const LOCK_PROFILE_STATS*)left)->total_wait_ns;
+    uint64_t right_wait = ((const LOCK_PROFILE_STATS*)right)->total_wait_ns;
+    return (left_wait < right_wait) ? 1 : ((left_wait > right_wait) ? -1 : 0);
+}
+
+int LockProfile_Init(void)
+{
+    int result;
+    if (registry_lock == NULL)
+    {
+        registry_lock = Lock_Init();
+    }
+    if (registry_lock != NULL && !exit_key_created)
+    {
+        exit_key_created = create_exit_key();
+        if (!exit_key_created)
+        {
+            LogError("unable to create the lock profile thread exit key; the counters of exited threads are not reused");
+        }
+    }
+
+    if (registry_lock == NULL)
+    {
+        LogError("unable to initialize the lock profile lock");
+        result = __LINE__;
+    }
+    else
+    {
+#ifndef _WIN32
+        if (init_count == 0 &&
+            sigaction(SIGUSR2, NULL, &previous_action) == 0 &&
+            (previous_action.sa_flags & SA_SIGINFO) == 0 &&
+            previous_action.sa_handler == SIG_DFL)
+        {
+            /*the host did not claim SIGUSR2, so use it to ask for a dump*/
+            struct sigaction action;
+            (void)memset(&action, 0, sizeof(action));
+            action.sa_handler = on_dump_signal;
+            (void)sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_RESTART;
+            signal_installed = (sigaction(SIGUSR2, &action, NULL) == 0);
+        }
+#endif
+        init_count++;
+        result = 0;
+    }
+    return result;
+}
+
+void LockProfile_Deinit(void)
+{
+    if (init_count == 0)
+    {
+        LogError("LockProfile_Deinit called without LockProfile_Init");
+    }
+    else if (init_count > 1)
+    {
+        init_count--;
+    }
+    else
+    {
+#ifndef _WIN32
+        if (signal_installed)
+        {
+            (void)sigaction(SIGUSR2, &previous_action, NULL);
+            signal_installed = false;
+        }
+#endif
+        /*the thread data and registry_lock are kept: a thread outside the
+        gateway, such as a Node.js isolate, may still be in LockProfile_Lock*/
+        (void)Lock(registry_lock);
+        init_count = 0;
+        generation++;
+        (void)memset((void*)sites, 0, sizeof(sites));
+        site_count = 0;
+        sites_full_logged = false;
+        (void)Unlock(registry_lock);
+        dump_requested = 0;
+    }
+}
+
+LOCK_RESULT LockProfile_Lock(LOCK_HANDLE handle, const char* site)
+{
+    LOCK_RESULT result;
+    if (init_count == 0 || site == NULL)
+    {
+        result = Lock(handle);
+    }
+    else
+    {
+        size_t slot = find_site(site);
+        LOCK_PROFILE_THREAD_DATA* data = (slot == LOCK_PROFILE_SITE_COUNT) ? NULL : get_thread_data();
+        if (data == NULL)
+        {
+            result = Lock(handle);
+        }
+        else
+        {
+            uint64_t start = get_time_ns();
+            result = Lock(handle);
+            if (result == LOCK_OK)
+            {
+                uint64_t now = get_time_ns();
+                uint64_t wait_ns = now - start;
+                LOCK_PROFILE_COUNTERS* counters = &data->counters[slot];
+                counters->acquisitions++;
+                counters->total_wait_ns += wait_ns;
+                if (wait_ns >= LOCK_PROFILE_CONTENDED_NS)
+                {
+                    counters->contended_acquisitions++;
+                }
+                if (wait_ns > counters->max_wait_ns)
+                {
+                    counters->max_wait_ns = wait_ns;
+                }
+
+                if (held_count < LOCK_PROFILE_HELD_DEPTH)
+                {
+                    held[held_count].handle = handle;
+                    held[held_count].counters = counters;
+                    held[held_count].acquired_ns = now;
+                    held_count++;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+LOCK_RESULT LockProfile_Unlock(LOCK_HANDLE handle)
+{
+    LOCK_RESULT result;
+    LOCK_PROFILE_HELD* entry = (thread_generation == generation) ? find_held(handle) : NULL;
+    if (entry != NULL)
+    {
+        charge_hold(entry, get_time_ns());
+        /*locks are usually released innermost first, so this rarely moves anything*/
+        (void)memmove(entry, entry + 1, (size_t)((held + held_count) - (entry + 1)) * sizeof(LOCK_PROFILE_HELD));
+        held_count--;
+    }
+
+    result = Unlock(handle);
+
+    if (dump_requested != 0 && init_count != 0)
+    {
+        dump_requested = 0;
+        LockProfile_Dump();
+    }
+    return result;
+}
+
+COND_RESULT LockProfile_ConditionWait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    COND_RESULT result;
+    LOCK_PROFILE_HELD* entry = (thread_generation == generation) ? find_held(lock) : NULL;
+    if (entry != NULL)
+    {
+        /*the lock is released while waiting, so that time is not held time*/
+        charge_hold(entry, get_time_ns());
+    }
+
+    result = Condition_Wait(handle, lock, timeout_milliseconds);
+
+    if (entry != NULL)
+    {
+        entry->acquired_ns = get_time_ns();
+    }
+    return result;
+}
+
+size_t LockProfile_GetStats(LOCK_PROFILE_STATS* stats, size_t count)
+{
+    size_t result;
+    if (init_count == 0)
+    {
+        result = 0;
+    }
+    else if (Lock(registry_lock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+        result = 0;
+    }
+    else
+    {
+        LOCK_PROFILE_STATS* all = (LOCK_PROFILE_STATS*)malloc((site_count + 1) * sizeof(LOCK_PROFILE_STATS));
+        if (all == NULL)
+        {
+            LogError("unable to allocate lock profile statistics");
+            result = 0;
+        }
+        else
+        {
+            result = collect_stats(all);
+            if (stats != NULL)
+            {
+                (void)memcpy(stats, all, ((count < result) ? count : result) * sizeof(LOCK_PROFILE_STATS));
+            }
+            free(all);
+        }
+        (void)Unlock(registry_lock);
+    }
+    return result;
+}
+
+void LockProfile_Dump(void)
+{
+    if (init_count == 0)
+    {
+        LogError("LockProfile_Init has not been called");
+    }
+    else if (Lock(registry_lock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+    }
+    else
+    {
+        LOCK_PROFILE_STATS* all = (LOCK_PROFILE_STATS*)malloc((site_count + 1) * sizeof(LOCK_PROFILE_STATS));
+        if (all == NULL)
+        {
+            LogError("unable to allocate lock profile statistics");
+        }
+        else
+        {
+            size_t i;
+            size_t count = collect_stats(all);
+            qsort(all, count, sizeof(LOCK_PROFILE_STATS), compare_total_wait);
+            LogInfo("lock profile: %lu sites, longest total wait first", (unsigned long)count);
+            for (i = 0; i < count; i++)
+            {
+                LogInfo("  %s: %llu acquisitions, %llu contended, wait total %llu us max %llu us, hold total %llu us max %llu us",
+                    all[i].site,
+                    (unsigned long long)all[i].acquisitions,
+                    (unsigned long long)all[i].contended_acquisitions,
+                    (unsigned long long)(all[i].total_wait_ns / 1000),
+                    (unsigned long long)(all[i].max_wait_ns / 1000),
+                    (unsigned long long)(all[i].total_hold_ns / 1000),
+                    (unsigned long long)(all[i].max_hold_ns / 1000));
+            }
+            free(all);
+        }
+        (void)Unlock(registry_lock);
+    }
+}
+
+void LockProfile_RequestDump(void)
+{
+    dump_requested = 1;
+}
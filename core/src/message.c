@@ -3,10 +3,15 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
 #include <inttypes.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include "message.h"
+#include "gateway_probes.h"
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/map.h"
 #include "azure_c_shared_utility/constmap.h"
@@ -17,17 +22,162 @@
 #define FIRST_MESSAGE_BYTE 0xA1  /*0xA1 comes from (A)zure (I)oT*/
 #define SECOND_MESSAGE_BYTE 0x60 /*0x60 comes from (G)ateway*/
 
+#define TYPED_SECOND_MESSAGE_BYTE 0x61 /*the serialization carries typed properties*/
+
 #define MIN_MESSAGE_BUFFER_LENGTH 14 /*14 is the minimum message length that is still valid*/
 
+/*how typed properties are tagged in the serialization*/
+#define TYPED_PROPERTY_INT64 0x01
+#define TYPED_PROPERTY_DOUBLE 0x02
+#define TYPED_PROPERTY_BYTES 0x03
+#define MIN_TYPED_PROPERTY_LENGTH 6 /*an empty name, the tag and an empty byte array*/
+
+/*the typed properties of a message, copied into a single allocation. They are
+shared by the messages derived from it.*/
+typedef struct MESSAGE_TYPED_PROPERTIES_TAG
+{
+    size_t count;
+    MESSAGE_TYPED_PROPERTY* properties;
+}MESSAGE_TYPED_PROPERTIES;
+
+DEFINE_REFCOUNT_TYPE(MESSAGE_TYPED_PROPERTIES);
+
 typedef struct MESSAGE_HANDLE_DATA_TAG
 {
     CONSTMAP_HANDLE properties;
     CONSTBUFFER_HANDLE content;
+    /*a derived message shares properties with the message it was derived from and
+    keeps only what it changes: properties it adds or replaces in overrides and the
+    names of properties it removes in removed. Both are NULL for other messages.*/
+    CONSTMAP_HANDLE overrides;
+    CONSTMAP_HANDLE removed;
+    /*NULL when the message has no typed properties*/
+    MESSAGE_TYPED_PROPERTIES* typed;
 }MESSAGE_HANDLE_DATA;
 
 DEFINE_REFCOUNT_TYPE(MESSAGE_HANDLE_DATA);
 
-static MESSAGE_HANDLE_DATA* Message_CreateImpl(const MESSAGE_CONFIG * cfg)
+static MESSAGE_TYPED_PROPERTIES* create_typed_properties(const MESSAGE_TYPED_PROPERTY* source, size_t count)
+{
+    MESSAGE_TYPED_PROPERTIES* result;
+    size_t storage = count * sizeof(MESSAGE_TYPED_PROPERTY);
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        storage += strlen(source[i].name) + 1;
+        if (source[i].type == MESSAGE_PROPERTY_BYTES)
+        {
+            storage += source[i].value.bytesValue.size;
+        }
+    }
+
+    result = REFCOUNT_TYPE_CREATE(MESSAGE_TYPED_PROPERTIES);
+    if (result == NULL)
+    {
+        LogError("malloc returned NULL");
+    }
+    else if ((result->properties = (MESSAGE_TYPED_PROPERTY*)malloc(storage)) == NULL)
+    {
+        LogError("unable to allocate %zu bytes of typed properties", storage);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        /*names and byte arrays follow the array of properties*/
+        unsigned char* tail = (unsigned char*)(result->properties + count);
+        result->count = count;
+        for (i = 0; i < count; i++)
+        {
+            size_t nameLength = strlen(source[i].name) + 1;
+            result->properties[i] = source[i];
+            memcpy(tail, source[i].name, nameLength);
+            result->properties[i].name = (const char*)tail;
+            tail += nameLength;
+            if (source[i].type == MESSAGE_PROPERTY_BYTES)
+            {
+                size_t size = source[i].value.bytesValue.size;
+                if (size > 0)
+                {
+                    memcpy(tail, source[i].value.bytesValue.buffer, size);
+                }
+                result->properties[i].value.bytesValue.buffer = (size == 0) ? NULL : tail;
+                tail += size;
+            }
+        }
+    }
+    return result;
+}
+
+static void destroy_typed_properties(MESSAGE_TYPED_PROPERTIES* typed)
+{
+    if (DEC_REF(MESSAGE_TYPED_PROPERTIES, typed) == DEC_RETURN_ZERO)
+    {
+        free(typed->properties);
+        free(typed);
+    }
+}
+
+/*a typed property is hidden in a derived message that removes it or sets a string property with the same name*/
+static bool typed_property_is_visible(const MESSAGE_HANDLE_DATA* messageData, const char* name)
+{
+    return
+        (messageData->overrides == NULL) ||
+        (!ConstMap_ContainsKey(messageData->removed, name) && !ConstMap_ContainsKey(messageData->overrides, name));
+}
+
+static const MESSAGE_TYPED_PROPERTY* find_typed_property(const MESSAGE_HANDLE_DATA* messageData, const char* key)
+{
+    const MESSAGE_TYPED_PROPERTY* result = NULL;
+    if (messageData->typed != NULL)
+    {
+        size_t i;
+        for (i = 0; i < messageData->typed->count; i++)
+        {
+            if (strcmp(messageData->typed->properties[i].name, key) == 0)
+            {
+                result = typed_property_is_visible(messageData, key) ? &messageData->typed->properties[i] : NULL;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+/*renders the value of a typed property as Message_GetProperties returns it. The caller frees the string.*/
+static char* render_typed_property(const MESSAGE_TYPED_PROPERTY* property)
+{
+    size_t length = (property->type == MESSAGE_PROPERTY_BYTES) ?
+        (property->value.bytesValue.size * 2) + 1 :
+        32; /*enough for any int64_t and a double with 17 significant digits*/
+    char* result = (char*)malloc(length);
+    if (result == NULL)
+    {
+        LogError("unable to allocate %zu bytes to render property '%s'", length, property->name);
+    }
+    else if (property->type == MESSAGE_PROPERTY_INT64)
+    {
+        (void)snprintf(result, length, "%" PRId64, property->value.int64Value);
+    }
+    else if (property->type == MESSAGE_PROPERTY_DOUBLE)
+    {
+        (void)snprintf(result, length, "%.17g", property->value.doubleValue);
+    }
+    else
+    {
+        static const char hex[] = "0123456789abcdef";
+        size_t i;
+        for (i = 0; i < property->value.bytesValue.size; i++)
+        {
+            result[2 * i] = hex[property->value.bytesValue.buffer[i] >> 4];
+            result[(2 * i) + 1] = hex[property->value.bytesValue.buffer[i] & 0x0F];
+        }
+        result[2 * i] = '\0';
+    }
+    return result;
+}
+
+static MESSAGE_HANDLE_DATA* Message_CreateImpl(const MESSAGE_CONFIG * cfg, const MESSAGE_TYPED_PROPERTY* typedProperties, size_t typedPropertiesCount)
 {
     MESSAGE_HANDLE_DATA* result;
     /*Codes_SRS_MESSAGE_02_006: [Otherwise, Message_Create shall return a non-NULL handle and shall set the internal ref count to "1".]*/
@@ -39,6 +189,9 @@ static MESSAGE_HANDLE_DATA* Message_CreateImpl(const MESSAGE_CONFIG * cfg)
     }
     else
     {
+        result->overrides = NULL;
+        result->removed = NULL;
+        result->typed = NULL;
         /*Codes_SRS_MESSAGE_02_004: [Mesages shall be allowed to be created from zero-size content.]*/
         /*Codes_SRS_MESSAGE_02_015: [The MESSAGE_CONTENT's field size shall have the same value as the cfg's field size.]*/
         /*Codes_SRS_MESSAGE_17_003: [Message_Create shall copy the source to a readonly CONSTBUFFER.]*/
@@ -61,9 +214,18 @@ static MESSAGE_HANDLE_DATA* Message_CreateImpl(const MESSAGE_CONFIG * cfg)
                 free(result);
                 result = NULL;
             }
+            /*Codes_SRS_MESSAGE_26_031: [Message_CreateWithTypedProperties shall copy the typed properties, including their names and byte array values, into the message.]*/
+            else if (typedPropertiesCount > 0 && (result->typed = create_typed_properties(typedProperties, typedPropertiesCount)) == NULL)
+            {
+                ConstMap_Destroy(result->properties);
+                CONSTBUFFER_Destroy(result->content);
+                free(result);
+                result = NULL;
+            }
             else
             {
                 /*all is fine, return as is.*/
+                GATEWAY_PROBE2(message_create, result, cfg->size);
             }
         }
     }
@@ -88,7 +250,68 @@ MESSAGE_HANDLE Message_Create(const MESSAGE_CONFIG * cfg)
     else
     {
         /*delegate to internal function that does not do validation*/
-        result = Message_CreateImpl(cfg);
+        result = Message_CreateImpl(cfg, NULL, 0);
+    }
+    return (MESSAGE_HANDLE)result;
+}
+
+static int validate_typed_properties(MAP_HANDLE sourceProperties, const MESSAGE_TYPED_PROPERTY* typedProperties, size_t typedPropertiesCount)
+{
+    int result = 0;
+    size_t i;
+    for (i = 0; result == 0 && i < typedPropertiesCount; i++)
+    {
+        const MESSAGE_TYPED_PROPERTY* property = &typedProperties[i];
+        bool exists = false;
+        size_t j;
+        if (property->name == NULL ||
+            (property->type != MESSAGE_PROPERTY_INT64 && property->type != MESSAGE_PROPERTY_DOUBLE && property->type != MESSAGE_PROPERTY_BYTES) ||
+            (property->type == MESSAGE_PROPERTY_BYTES && property->value.bytesValue.size > 0 && property->value.bytesValue.buffer == NULL))
+        {
+            LogError("invalid typed property at index %zu", i);
+            result = __LINE__;
+        }
+        else if (Map_ContainsKey(sourceProperties, property->name, &exists) != MAP_OK || exists)
+        {
+            LogError("typed property '%s' is also a string property", property->name);
+            result = __LINE__;
+        }
+        else
+        {
+            for (j = 0; j < i; j++)
+            {
+                if (strcmp(typedProperties[j].name, property->name) == 0)
+                {
+                    LogError("typed property '%s' is set twice", property->name);
+                    result = __LINE__;
+                    break;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+MESSAGE_HANDLE Message_CreateWithTypedProperties(const MESSAGE_CONFIG * cfg, const MESSAGE_TYPED_PROPERTY* typedProperties, size_t typedPropertiesCount)
+{
+    MESSAGE_HANDLE_DATA* result;
+    if (cfg == NULL ||
+        ((cfg->size > 0) && (cfg->source == NULL)) ||
+        ((typedPropertiesCount > 0) && (typedProperties == NULL)))
+    {
+        /*Codes_SRS_MESSAGE_26_030: [If cfg is NULL, field source of cfg is NULL and size is not zero, or typedProperties is NULL and typedPropertiesCount is not zero, then Message_CreateWithTypedProperties shall fail and return NULL.]*/
+        LogError("invalid arg: cfg=%p, typedProperties=%p, typedPropertiesCount=%zu", cfg, typedProperties, typedPropertiesCount);
+        result = NULL;
+    }
+    else if (validate_typed_properties(cfg->sourceProperties, typedProperties, typedPropertiesCount) != 0)
+    {
+        /*Codes_SRS_MESSAGE_26_032: [If a typed property has a NULL name, an unknown type, a NULL byte array of non-zero size, or the same name as another typed property or a property in sourceProperties, then Message_CreateWithTypedProperties shall fail and return NULL.]*/
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_26_033: [Otherwise Message_CreateWithTypedProperties shall create the message as Message_Create does and return a non-NULL handle.]*/
+        result = Message_CreateImpl(cfg, typedProperties, typedPropertiesCount);
     }
     return (MESSAGE_HANDLE)result;
 }
@@ -126,6 +349,9 @@ MESSAGE_HANDLE Message_CreateFromBuffer(const MESSAGE_BUFFER_CONFIG* cfg)
         }
         else
         {
+            result->overrides = NULL;
+            result->removed = NULL;
+            result->typed = NULL;
             /*Codes_SRS_MESSAGE_17_013: [Message_CreateFromBuffer shall clone the CONSTBUFFER sourceBuffer.]*/
             result->content = CONSTBUFFER_Clone(cfg->sourceContent);
             if (result->content == NULL)
@@ -148,48 +374,472 @@ MESSAGE_HANDLE Message_CreateFromBuffer(const MESSAGE_BUFFER_CONFIG* cfg)
                 else
                 {
                     /*all is fine, return as is.*/
-				}
+                    GATEWAY_PROBE2(message_create, result, CONSTBUFFER_GetContent(result->content)->size);
+                }
+            }
+        }
+    }
+    return (MESSAGE_HANDLE)result;
+}
+
+/*applies the overlay of a derived message to a copy of the properties it shares*/
+static int apply_overlay(const MESSAGE_HANDLE_DATA* messageData, MAP_HANDLE merged)
+{
+    int result;
+    const char* const* keys;
+    const char* const* values;
+    size_t count;
+    size_t i;
+    if (ConstMap_GetInternals(messageData->removed, &keys, &values, &count) != CONSTMAP_OK)
+    {
+        LogError("unable to get the removed properties");
+        result = __LINE__;
+    }
+    else
+    {
+        for (i = 0; i < count; i++)
+        {
+            (void)Map_Delete(merged, keys[i]);
+        }
+
+        if (ConstMap_GetInternals(messageData->overrides, &keys, &values, &count) != CONSTMAP_OK)
+        {
+            LogError("unable to get the property overrides");
+            result = __LINE__;
+        }
+        else
+        {
+            for (i = 0; i < count; i++)
+            {
+                if (Map_AddOrUpdate(merged, keys[i], values[i]) != MAP_OK)
+                {
+                    LogError("unable to apply property override '%s'", keys[i]);
+                    break;
+                }
+            }
+
+            result = (i == count) ? 0 : __LINE__;
+        }
+    }
+    return result;
+}
+
+/*adds the typed properties of a message, rendered as strings, to a copy of its properties*/
+static int add_rendered_typed_properties(const MESSAGE_HANDLE_DATA* messageData, MAP_HANDLE merged)
+{
+    int result = 0;
+    size_t i;
+    for (i = 0; result == 0 && i < messageData->typed->count; i++)
+    {
+        const MESSAGE_TYPED_PROPERTY* property = &messageData->typed->properties[i];
+        if (typed_property_is_visible(messageData, property->name))
+        {
+            char* rendered = render_typed_property(property);
+            if (rendered == NULL)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                if (Map_AddOrUpdate(merged, property->name, rendered) != MAP_OK)
+                {
+                    LogError("unable to add typed property '%s'", property->name);
+                    result = __LINE__;
+                }
+                free(rendered);
+            }
+        }
+    }
+    return result;
+}
+
+/*builds the string properties of a message that was derived, has typed properties, or both.
+Typed properties are rendered as strings when render_typed is true and left out otherwise.*/
+static CONSTMAP_HANDLE merge_properties(const MESSAGE_HANDLE_DATA* messageData, bool render_typed)
+{
+    CONSTMAP_HANDLE result;
+    MAP_HANDLE merged = ConstMap_CloneWriteable(messageData->properties);
+    if (merged == NULL)
+    {
+        LogError("ConstMap_CloneWriteable failed");
+        result = NULL;
+    }
+    else
+    {
+        if (messageData->overrides != NULL && apply_overlay(messageData, merged) != 0)
+        {
+            result = NULL;
+        }
+        else if (render_typed && messageData->typed != NULL && add_rendered_typed_properties(messageData, merged) != 0)
+        {
+            result = NULL;
+        }
+        else
+        {
+            result = ConstMap_Create(merged);
+        }
+        Map_Destroy(merged);
+    }
+    return result;
+}
+
+/*gets a writeable copy of an overlay map of the parent, or an empty map if there is none*/
+static MAP_HANDLE clone_overlay(CONSTMAP_HANDLE overlay)
+{
+    return (overlay == NULL) ? Map_Create(NULL) : ConstMap_CloneWriteable(overlay);
+}
+
+/*applies the properties set and removed by cfg to the overlay of a derived message*/
+static int apply_derive_config(const MESSAGE_DERIVE_CONFIG* cfg, MAP_HANDLE overrides, MAP_HANDLE removed)
+{
+    int result = 0;
+    size_t i;
+    for (i = 0; result == 0 && i < cfg->removePropertiesCount; i++)
+    {
+        /*Codes_SRS_MESSAGE_26_016: [A property in removeProperties shall be removed even if it was added when parent was derived.]*/
+        (void)Map_Delete(overrides, cfg->removeProperties[i]);
+        if (Map_AddOrUpdate(removed, cfg->removeProperties[i], "") != MAP_OK)
+        {
+            LogError("unable to remove property '%s'", cfg->removeProperties[i]);
+            result = __LINE__;
+        }
+    }
+
+    if (result == 0 && cfg->setProperties != NULL)
+    {
+        const char* const* keys;
+        const char* const* values;
+        size_t count;
+        if (Map_GetInternals(cfg->setProperties, &keys, &values, &count) != MAP_OK)
+        {
+            LogError("unable to get the properties to set");
+            result = __LINE__;
+        }
+        else
+        {
+            for (i = 0; result == 0 && i < count; i++)
+            {
+                /*Codes_SRS_MESSAGE_26_017: [A property in setProperties shall be set even if it was removed, in removeProperties or when parent was derived.]*/
+                (void)Map_Delete(removed, keys[i]);
+                if (Map_AddOrUpdate(overrides, keys[i], values[i]) != MAP_OK)
+                {
+                    LogError("unable to set property '%s'", keys[i]);
+                    result = __LINE__;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+MESSAGE_HANDLE Message_Derive(MESSAGE_HANDLE parent, const MESSAGE_DERIVE_CONFIG* cfg)
+{
+    MESSAGE_HANDLE_DATA* result;
+    if (parent == NULL || cfg == NULL || (cfg->removePropertiesCount > 0 && cfg->removeProperties == NULL))
+    {
+        /*Codes_SRS_MESSAGE_26_015: [If parent or cfg is NULL, or cfg->removeProperties is NULL while cfg->removePropertiesCount is not zero, then Message_Derive shall fail and return NULL.]*/
+        LogError("invalid arg: parent=%p, cfg=%p", parent, cfg);
+        result = NULL;
+    }
+    else
+    {
+        MESSAGE_HANDLE_DATA* parentData = (MESSAGE_HANDLE_DATA*)parent;
+        /*Codes_SRS_MESSAGE_26_018: [Message_Derive shall start from the overlay of parent, if parent was itself derived, so that a chain of derived messages shares a single set of properties.]*/
+        MAP_HANDLE overrides = clone_overlay(parentData->overrides);
+        MAP_HANDLE removed = clone_overlay(parentData->removed);
+        if (overrides == NULL || removed == NULL)
+        {
+            /*Codes_SRS_MESSAGE_26_024: [If any underlying call fails, Message_Derive shall fail and return NULL.]*/
+            LogError("unable to create the property overlay");
+            result = NULL;
+        }
+        else if (apply_derive_config(cfg, overrides, removed) != 0)
+        {
+            /*Codes_SRS_MESSAGE_26_024: [If any underlying call fails, Message_Derive shall fail and return NULL.]*/
+            result = NULL;
+        }
+        else if ((result = REFCOUNT_TYPE_CREATE(MESSAGE_HANDLE_DATA)) == NULL)
+        {
+            /*Codes_SRS_MESSAGE_26_024: [If any underlying call fails, Message_Derive shall fail and return NULL.]*/
+            LogError("malloc returned NULL");
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_26_023: [Message_Derive shall share the content and properties of parent by cloning their handles, and keep only the properties cfg changes.]*/
+            result->overrides = ConstMap_Create(overrides);
+            result->removed = (result->overrides == NULL) ? NULL : ConstMap_Create(removed);
+            if (result->removed == NULL)
+            {
+                /*Codes_SRS_MESSAGE_26_024: [If any underlying call fails, Message_Derive shall fail and return NULL.]*/
+                LogError("ConstMap_Create failed");
+                if (result->overrides != NULL)
+                {
+                    ConstMap_Destroy(result->overrides);
+                }
+                free(result);
+                result = NULL;
+            }
+            else if ((result->properties = ConstMap_Clone(parentData->properties)) == NULL)
+            {
+                LogError("ConstMap_Clone failed");
+                ConstMap_Destroy(result->removed);
+                ConstMap_Destroy(result->overrides);
+                free(result);
+                result = NULL;
+            }
+            else if ((result->content = CONSTBUFFER_Clone(parentData->content)) == NULL)
+            {
+                LogError("CONSTBUFFER_Clone failed");
+                ConstMap_Destroy(result->properties);
+                ConstMap_Destroy(result->removed);
+                ConstMap_Destroy(result->overrides);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_MESSAGE_26_034: [Message_Derive shall share the typed properties of parent, hiding those that cfg removes or sets as string properties.]*/
+                result->typed = parentData->typed;
+                if (result->typed != NULL)
+                {
+                    INC_REF(MESSAGE_TYPED_PROPERTIES, result->typed);
+                }
+                /*Codes_SRS_MESSAGE_26_027: [Otherwise, Message_Derive shall return a non-NULL handle with a ref count of "1".]*/
+                GATEWAY_PROBE2(message_create, result, CONSTBUFFER_GetContent(result->content)->size);
+            }
+        }
+
+        if (overrides != NULL)
+        {
+            Map_Destroy(overrides);
+        }
+        if (removed != NULL)
+        {
+            Map_Destroy(removed);
+        }
+    }
+    return (MESSAGE_HANDLE)result;
+}
+
+MESSAGE_HANDLE Message_Clone(MESSAGE_HANDLE message)
+{
+    if (message == NULL)
+    {
+        LogError("invalid arg: message is NULL");
+        /*Codes_SRS_MESSAGE_02_007: [If messageHandle is NULL then Message_Clone shall return NULL.] */
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_02_008: [Otherwise, Message_Clone shall increment the internal ref count.] */
+        INC_REF(MESSAGE_HANDLE_DATA, message);
+        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
+        /*Codes_SRS_MESSAGE_17_001: [Message_Clone shall clone the CONSTMAP handle.]*/
+        (void)ConstMap_Clone(messageData->properties);
+        /*Codes_SRS_MESSAGE_17_004: [Message_Clone shall clone the CONSTBUFFER handle]*/
+        (void)CONSTBUFFER_Clone(messageData->content);
+        if (messageData->overrides != NULL)
+        {
+            /*Codes_SRS_MESSAGE_26_028: [Message_Clone shall clone the property overlay of a derived message.]*/
+            (void)ConstMap_Clone(messageData->overrides);
+            (void)ConstMap_Clone(messageData->removed);
+        }
+        if (messageData->typed != NULL)
+        {
+            /*Codes_SRS_MESSAGE_26_035: [Message_Clone shall share the typed properties of the message with the clone.]*/
+            INC_REF(MESSAGE_TYPED_PROPERTIES, messageData->typed);
+        }
+    }
+    /*Codes_SRS_MESSAGE_02_010: [Message_Clone shall return messageHandle.]*/
+    return message;
+}
+
+CONSTMAP_HANDLE Message_GetProperties(MESSAGE_HANDLE message)
+{
+    CONSTMAP_HANDLE result;
+    /*Codes_SRS_MESSAGE_02_011: [If message is NULL then Message_GetProperties shall return NULL.] */
+    if (message == NULL)
+    {
+        LogError("invalid arg: message is NULL");
+        result = NULL;
+    }
+    else
+    {
+        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
+        if (messageData->overrides == NULL && messageData->typed == NULL)
+        {
+            /*Codes_SRS_MESSAGE_02_012: [Otherwise, Message_GetProperties shall shall clone and return the CONSTMAP handle representing the properties of the message.]*/
+            result = ConstMap_Clone(messageData->properties);
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_26_025: [If message was derived, Message_GetProperties shall return a new CONSTMAP holding the properties it shares with its parent, less the removed ones, plus the overrides.]*/
+            /*Codes_SRS_MESSAGE_26_036: [If message has typed properties, Message_GetProperties shall return a new CONSTMAP that also holds each typed property that is not hidden, with int64 values in decimal, double values with 17 significant digits and byte arrays in lowercase hexadecimal.]*/
+            result = merge_properties(messageData, true);
+        }
+    }
+    return result;
+}
+
+const char* Message_GetProperty(MESSAGE_HANDLE message, const char* key)
+{
+    const char* result;
+    if (message == NULL || key == NULL)
+    {
+        /*Codes_SRS_MESSAGE_26_019: [If message or key is NULL then Message_GetProperty shall return NULL.]*/
+        LogError("invalid arg: message=%p, key=%p", message, key);
+        result = NULL;
+    }
+    else
+    {
+        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
+        if (messageData->removed != NULL && ConstMap_ContainsKey(messageData->removed, key))
+        {
+            /*Codes_SRS_MESSAGE_26_020: [If the property was removed when the message was derived, Message_GetProperty shall return NULL.]*/
+            result = NULL;
+        }
+        else if (messageData->overrides != NULL && (result = ConstMap_GetValue(messageData->overrides, key)) != NULL)
+        {
+            /*Codes_SRS_MESSAGE_26_021: [If the property was added or replaced when the message was derived, Message_GetProperty shall return its new value.]*/
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_26_022: [Otherwise Message_GetProperty shall return the value of the property in the message's own or shared properties, or NULL if there is no such property.]*/
+            result = ConstMap_GetValue(messageData->properties, key);
+        }
+    }
+    return result;
+}
+
+/*reads a typed property of the given type, or NULL if the message has no such typed property.
+*found is set when a typed property named key exists, whatever its type.*/
+static const MESSAGE_TYPED_PROPERTY* get_typed_property(MESSAGE_HANDLE message, const char* key, MESSAGE_PROPERTY_TYPE type, bool* found)
+{
+    const MESSAGE_TYPED_PROPERTY* result = find_typed_property((MESSAGE_HANDLE_DATA*)message, key);
+    *found = (result != NULL);
+    if (result != NULL && result->type != type)
+    {
+        /*Codes_SRS_MESSAGE_26_039: [If the typed property does not have the requested type, the Message_GetProperty typed functions shall fail and return a non-zero value.]*/
+        LogError("property '%s' is not of type %d", key, (int)type);
+        result = NULL;
+    }
+    return result;
+}
+
+int Message_GetPropertyInt64(MESSAGE_HANDLE message, const char* key, int64_t* value)
+{
+    int result;
+    if (message == NULL || key == NULL || value == NULL)
+    {
+        /*Codes_SRS_MESSAGE_26_037: [If message, key or any output parameter is NULL then the Message_GetProperty typed functions shall fail and return a non-zero value.]*/
+        LogError("invalid arg: message=%p, key=%p, value=%p", message, key, value);
+        result = __LINE__;
+    }
+    else
+    {
+        bool found;
+        const MESSAGE_TYPED_PROPERTY* property = get_typed_property(message, key, MESSAGE_PROPERTY_INT64, &found);
+        if (property != NULL)
+        {
+            /*Codes_SRS_MESSAGE_26_038: [The Message_GetProperty typed functions shall return the value of a typed property of the requested type that is not hidden, and return 0.]*/
+            *value = property->value.int64Value;
+            result = 0;
+        }
+        else if (found)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_26_040: [Otherwise Message_GetPropertyInt64 and Message_GetPropertyDouble shall parse the string property Message_GetProperty returns, and fail and return a non-zero value if there is none or it is not entirely a decimal number in range.]*/
+            const char* text = Message_GetProperty(message, key);
+            char* end;
+            long long parsed;
+            errno = 0;
+            if (text == NULL ||
+                (parsed = strtoll(text, &end, 10), end == text || *end != '\0' || errno == ERANGE))
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                *value = (int64_t)parsed;
+                result = 0;
             }
         }
     }
-    return (MESSAGE_HANDLE)result;
+    return result;
 }
 
-MESSAGE_HANDLE Message_Clone(MESSAGE_HANDLE message)
+int Message_GetPropertyDouble(MESSAGE_HANDLE message, const char* key, double* value)
 {
-    if (message == NULL)
+    int result;
+    if (message == NULL || key == NULL || value == NULL)
     {
-        LogError("invalid arg: message is NULL");
-        /*Codes_SRS_MESSAGE_02_007: [If messageHandle is NULL then Message_Clone shall return NULL.] */
+        /*Codes_SRS_MESSAGE_26_037: [If message, key or any output parameter is NULL then the Message_GetProperty typed functions shall fail and return a non-zero value.]*/
+        LogError("invalid arg: message=%p, key=%p, value=%p", message, key, value);
+        result = __LINE__;
     }
     else
     {
-        /*Codes_SRS_MESSAGE_02_008: [Otherwise, Message_Clone shall increment the internal ref count.] */
-        INC_REF(MESSAGE_HANDLE_DATA, message);
-        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        /*Codes_SRS_MESSAGE_17_001: [Message_Clone shall clone the CONSTMAP handle.]*/
-        (void)ConstMap_Clone(messageData->properties);
-        /*Codes_SRS_MESSAGE_17_004: [Message_Clone shall clone the CONSTBUFFER handle]*/
-        (void)CONSTBUFFER_Clone(messageData->content);
+        bool found;
+        const MESSAGE_TYPED_PROPERTY* property = get_typed_property(message, key, MESSAGE_PROPERTY_DOUBLE, &found);
+        if (property != NULL)
+        {
+            /*Codes_SRS_MESSAGE_26_038: [The Message_GetProperty typed functions shall return the value of a typed property of the requested type that is not hidden, and return 0.]*/
+            *value = property->value.doubleValue;
+            result = 0;
+        }
+        else if (found)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_26_040: [Otherwise Message_GetPropertyInt64 and Message_GetPropertyDouble shall parse the string property Message_GetProperty returns, and fail and return a non-zero value if there is none or it is not entirely a decimal number in range.]*/
+            const char* text = Message_GetProperty(message, key);
+            char* end;
+            double parsed;
+            errno = 0;
+            if (text == NULL ||
+                (parsed = strtod(text, &end), end == text || *end != '\0' || errno == ERANGE))
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                *value = parsed;
+                result = 0;
+            }
+        }
     }
-    /*Codes_SRS_MESSAGE_02_010: [Message_Clone shall return messageHandle.]*/
-    return message;
+    return result;
 }
 
-CONSTMAP_HANDLE Message_GetProperties(MESSAGE_HANDLE message)
+int Message_GetPropertyBytes(MESSAGE_HANDLE message, const char* key, const unsigned char** buffer, size_t* size)
 {
-    CONSTMAP_HANDLE result;
-    /*Codes_SRS_MESSAGE_02_011: [If message is NULL then Message_GetProperties shall return NULL.] */
-    if (message == NULL)
+    int result;
+    if (message == NULL || key == NULL || buffer == NULL || size == NULL)
     {
-        LogError("invalid arg: message is NULL");
-        result = NULL;
+        /*Codes_SRS_MESSAGE_26_037: [If message, key or any output parameter is NULL then the Message_GetProperty typed functions shall fail and return a non-zero value.]*/
+        LogError("invalid arg: message=%p, key=%p, buffer=%p, size=%p", message, key, buffer, size);
+        result = __LINE__;
     }
     else
     {
-        /*Codes_SRS_MESSAGE_02_012: [Otherwise, Message_GetProperties shall shall clone and return the CONSTMAP handle representing the properties of the message.]*/
-        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        result = ConstMap_Clone(messageData->properties);
+        bool found;
+        const MESSAGE_TYPED_PROPERTY* property = get_typed_property(message, key, MESSAGE_PROPERTY_BYTES, &found);
+        if (property == NULL)
+        {
+            /*Codes_SRS_MESSAGE_26_041: [Message_GetPropertyBytes shall fail and return a non-zero value if there is no byte array typed property named key.]*/
+            result = __LINE__;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_26_038: [The Message_GetProperty typed functions shall return the value of a typed property of the requested type that is not hidden, and return 0.]*/
+            *buffer = property->value.bytesValue.buffer;
+            *size = property->value.bytesValue.size;
+            result = 0;
+        }
     }
     return result;
 }
@@ -229,6 +879,176 @@ CONSTBUFFER_HANDLE Message_GetContentHandle(MESSAGE_HANDLE message)
     return result;
 }
 
+int Message_GetContentView(MESSAGE_HANDLE message, MESSAGE_CONTENT_VIEW* view)
+{
+    int result;
+    if (message == NULL || view == NULL)
+    {
+        /*Codes_SRS_MESSAGE_26_001: [If message or view is NULL then Message_GetContentView shall fail and return a non-zero value.]*/
+        LogError("invalid argument, message=%p, view=%p", message, view);
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_26_002: [Message_GetContentView shall clone the CONSTBUFFER_HANDLE representing the message content into view.]*/
+        CONSTBUFFER_HANDLE content = CONSTBUFFER_Clone(((MESSAGE_HANDLE_DATA*)message)->content);
+        if (content == NULL)
+        {
+            /*Codes_SRS_MESSAGE_26_003: [If cloning the content fails then Message_GetContentView shall fail and return a non-zero value.]*/
+            LogError("CONSTBUFFER_Clone failed");
+            result = __LINE__;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_26_004: [Message_GetContentView shall set the view to span the whole content and return 0.]*/
+            const CONSTBUFFER* buffer = CONSTBUFFER_GetContent(content);
+            view->content = content;
+            view->offset = 0;
+            view->size = buffer->size;
+            view->buffer = (buffer->size == 0) ? NULL : buffer->buffer;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*returns true if width bytes starting at offset are within view*/
+static bool view_contains(const MESSAGE_CONTENT_VIEW* view, size_t offset, size_t width)
+{
+    /*written so that offset + width cannot overflow*/
+    return offset <= view->size && width <= view->size - offset;
+}
+
+int MessageContentView_Slice(const MESSAGE_CONTENT_VIEW* view, size_t offset, size_t size, MESSAGE_CONTENT_VIEW* slice)
+{
+    int result;
+    if (view == NULL || view->content == NULL || slice == NULL)
+    {
+        /*Codes_SRS_MESSAGE_26_005: [If view is NULL, has been released or slice is NULL then MessageContentView_Slice shall fail and return a non-zero value.]*/
+        LogError("invalid argument, view=%p, slice=%p", view, slice);
+        result = __LINE__;
+    }
+    else if (!view_contains(view, offset, size))
+    {
+        /*Codes_SRS_MESSAGE_26_006: [If offset + size is greater than the size of view then MessageContentView_Slice shall fail and return a non-zero value.]*/
+        LogError("slice [%zu, %zu) is out of the bounds of a view of %zu bytes", offset, offset + size, view->size);
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_26_007: [MessageContentView_Slice shall clone the content of view into slice.]*/
+        CONSTBUFFER_HANDLE content = CONSTBUFFER_Clone(view->content);
+        if (content == NULL)
+        {
+            /*Codes_SRS_MESSAGE_26_008: [If cloning the content fails then MessageContentView_Slice shall fail and return a non-zero value.]*/
+            LogError("CONSTBUFFER_Clone failed");
+            result = __LINE__;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_26_009: [MessageContentView_Slice shall set slice to the size bytes at offset within view, without copying them, and return 0.]*/
+            slice->content = content;
+            slice->offset = view->offset + offset;
+            slice->size = size;
+            slice->buffer = (size == 0) ? NULL : view->buffer + offset;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+void MessageContentView_Release(MESSAGE_CONTENT_VIEW* view)
+{
+    if (view == NULL)
+    {
+        /*Codes_SRS_MESSAGE_26_010: [If view is NULL then MessageContentView_Release shall do nothing.]*/
+        LogError("invalid argument, view is NULL");
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_26_011: [MessageContentView_Release shall destroy the CONSTBUFFER_HANDLE held by view, if any, and empty the view.]*/
+        if (view->content != NULL)
+        {
+            CONSTBUFFER_Destroy(view->content);
+        }
+        view->content = NULL;
+        view->offset = 0;
+        view->buffer = NULL;
+        view->size = 0;
+    }
+}
+
+/*reads width bytes at offset within view as an unsigned integer in the given byte order*/
+static int read_uint(const MESSAGE_CONTENT_VIEW* view, size_t offset, size_t width, bool big_endian, uint64_t* value)
+{
+    int result;
+    if (view == NULL || value == NULL)
+    {
+        /*Codes_SRS_MESSAGE_26_012: [If view or value is NULL then the MessageContentView_Read functions shall fail and return a non-zero value.]*/
+        LogError("invalid argument, view=%p, value=%p", view, value);
+        result = __LINE__;
+    }
+    else if (!view_contains(view, offset, width))
+    {
+        /*Codes_SRS_MESSAGE_26_013: [If the value read would extend past the end of view then the MessageContentView_Read functions shall fail and return a non-zero value, leaving value unmodified.]*/
+        LogError("read of %zu bytes at offset %zu is out of the bounds of a view of %zu bytes", width, offset, view->size);
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_26_014: [The MessageContentView_Read functions shall read the value at offset within view, LE functions least significant byte first and BE functions most significant byte first, and return 0.]*/
+        const unsigned char* source = view->buffer + offset;
+        uint64_t read = 0;
+        size_t i;
+        for (i = 0; i < width; i++)
+        {
+            size_t shift = 8 * (big_endian ? (width - 1 - i) : i);
+            read |= (uint64_t)source[i] << shift;
+        }
+        *value = read;
+        result = 0;
+    }
+    return result;
+}
+
+#define DEFINE_READ_UINT(name, type, width, big_endian)                                     \
+int name(const MESSAGE_CONTENT_VIEW* view, size_t offset, type* value)                      \
+{                                                                                           \
+    uint64_t read;                                                                          \
+    int result = read_uint(view, offset, width, big_endian, value == NULL ? NULL : &read);  \
+    if (result == 0)                                                                        \
+    {                                                                                       \
+        *value = (type)read;                                                                \
+    }                                                                                       \
+    return result;                                                                          \
+}
+
+/*floating point values are read as integers of the same width and reinterpreted*/
+#define DEFINE_READ_FLOAT(name, type, uint_type, big_endian)                                            \
+int name(const MESSAGE_CONTENT_VIEW* view, size_t offset, type* value)                                  \
+{                                                                                                       \
+    uint64_t read;                                                                                      \
+    int result = read_uint(view, offset, sizeof(type), big_endian, value == NULL ? NULL : &read);       \
+    if (result == 0)                                                                                    \
+    {                                                                                                   \
+        uint_type bits = (uint_type)read;                                                               \
+        (void)memcpy(value, &bits, sizeof(type));                                                       \
+    }                                                                                                   \
+    return result;                                                                                      \
+}
+
+DEFINE_READ_UINT(MessageContentView_ReadUInt8, uint8_t, 1, false)
+DEFINE_READ_UINT(MessageContentView_ReadUInt16LE, uint16_t, 2, false)
+DEFINE_READ_UINT(MessageContentView_ReadUInt16BE, uint16_t, 2, true)
+DEFINE_READ_UINT(MessageContentView_ReadUInt32LE, uint32_t, 4, false)
+DEFINE_READ_UINT(MessageContentView_ReadUInt32BE, uint32_t, 4, true)
+DEFINE_READ_UINT(MessageContentView_ReadUInt64LE, uint64_t, 8, false)
+DEFINE_READ_UINT(MessageContentView_ReadUInt64BE, uint64_t, 8, true)
+DEFINE_READ_FLOAT(MessageContentView_ReadFloatLE, float, uint32_t, false)
+DEFINE_READ_FLOAT(MessageContentView_ReadFloatBE, float, uint32_t, true)
+DEFINE_READ_FLOAT(MessageContentView_ReadDoubleLE, double, uint64_t, false)
+DEFINE_READ_FLOAT(MessageContentView_ReadDoubleBE, double, uint64_t, true)
+
 void Message_Destroy(MESSAGE_HANDLE message)
 {
     /*Codes_SRS_MESSAGE_02_017: [If message is NULL then Message_Destroy shall do nothing.] */
@@ -243,10 +1063,22 @@ void Message_Destroy(MESSAGE_HANDLE message)
         ConstMap_Destroy(messageData->properties);
         /*Codes_SRS_MESSAGE_17_005: [Message_Destroy shall destroy the CONSTBUFFER.]*/
         CONSTBUFFER_Destroy(messageData->content);
+        if (messageData->overrides != NULL)
+        {
+            /*Codes_SRS_MESSAGE_26_029: [Message_Destroy shall destroy the property overlay of a derived message.]*/
+            ConstMap_Destroy(messageData->overrides);
+            ConstMap_Destroy(messageData->removed);
+        }
+        if (messageData->typed != NULL)
+        {
+            /*Codes_SRS_MESSAGE_26_042: [Message_Destroy shall release the typed properties of the message.]*/
+            destroy_typed_properties(messageData->typed);
+        }
         /*Codes_SRS_MESSAGE_02_020: [Otherwise, Message_Destroy shall decrement the internal ref count of the message.]*/
         if (DEC_REF(MESSAGE_HANDLE_DATA, message) == DEC_RETURN_ZERO)
         {
             /*Codes_SRS_MESSAGE_02_021: [If the ref count is zero then the allocated resources are freed.]*/
+            GATEWAY_PROBE1(message_destroy, message);
             free(message);
         }
     }
@@ -298,6 +1130,160 @@ static int parse_null_terminated_const_char(const unsigned char* source, int32_t
     return result;
 }
 
+static int parse_uint64_t(const unsigned char* source, int32_t sourceSize, int32_t position, int32_t *parsed, uint64_t* value)
+{
+    int result;
+    if (position + 8 > sourceSize)
+    {
+        /*Codes_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+        LogError("unable to parse a uint64_t because it would go past the end of the source");
+        result = __LINE__;
+    }
+    else
+    {
+        int i;
+        *parsed = 8;
+        *value = 0;
+        for (i = 0; i < 8; i++)
+        {
+            *value = (*value << 8) | source[position + i];
+        }
+        result = 0;
+    }
+    return result;
+}
+
+/*parses one typed property: a null terminated name, a 1 byte tag and the value*/
+static int parse_typed_property(const unsigned char* source, int32_t sourceSize, int32_t* position, MESSAGE_TYPED_PROPERTY* property)
+{
+    int result;
+    int32_t parsed;
+    if (parse_null_terminated_const_char(source, sourceSize, *position, &parsed, &property->name) != 0)
+    {
+        LogError("unable to parse the name of a typed property");
+        result = __LINE__;
+    }
+    else if (*position + parsed + 1 > sourceSize)
+    {
+        /*Codes_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+        LogError("unable to parse the type of typed property '%s'", property->name);
+        result = __LINE__;
+    }
+    else
+    {
+        unsigned char tag = source[*position + parsed];
+        uint64_t bits;
+        int32_t bytesSize;
+        *position += parsed + 1;
+        if (tag == TYPED_PROPERTY_INT64 || tag == TYPED_PROPERTY_DOUBLE)
+        {
+            if (parse_uint64_t(source, sourceSize, *position, &parsed, &bits) != 0)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                *position += parsed;
+                if (tag == TYPED_PROPERTY_INT64)
+                {
+                    property->type = MESSAGE_PROPERTY_INT64;
+                    property->value.int64Value = (int64_t)bits;
+                }
+                else
+                {
+                    property->type = MESSAGE_PROPERTY_DOUBLE;
+                    memcpy(&property->value.doubleValue, &bits, sizeof(double));
+                }
+                result = 0;
+            }
+        }
+        else if (tag == TYPED_PROPERTY_BYTES)
+        {
+            if (parse_int32_t(source, sourceSize, *position, &parsed, &bytesSize) != 0)
+            {
+                result = __LINE__;
+            }
+            else if (bytesSize < 0 || bytesSize > sourceSize - (*position + parsed))
+            {
+                /*Codes_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+                LogError("typed property '%s' has an invalid size %" PRId32, property->name, bytesSize);
+                result = __LINE__;
+            }
+            else
+            {
+                *position += parsed;
+                property->type = MESSAGE_PROPERTY_BYTES;
+                property->value.bytesValue.buffer = (bytesSize == 0) ? NULL : source + *position;
+                property->value.bytesValue.size = (size_t)bytesSize;
+                *position += bytesSize;
+                result = 0;
+            }
+        }
+        else
+        {
+            LogError("typed property '%s' has an unknown type %u", property->name, (unsigned int)tag);
+            result = __LINE__;
+        }
+    }
+    return result;
+}
+
+/*parses the typed properties of a typed serialization. On success the caller frees *typedProperties.
+Names and byte arrays point into source.*/
+static int parse_typed_properties(const unsigned char* source, int32_t sourceSize, int32_t* position, MESSAGE_TYPED_PROPERTY** typedProperties, int32_t* typedPropertiesCount)
+{
+    int result;
+    int32_t parsed;
+    int32_t count;
+    if (parse_int32_t(source, sourceSize, *position, &parsed, &count) != 0)
+    {
+        LogError("unable to parse the number of typed properties");
+        result = __LINE__;
+    }
+    else if (count < 0 || count > (sourceSize - (*position + parsed)) / MIN_TYPED_PROPERTY_LENGTH)
+    {
+        LogError("invalid message detected with wrong number of typed properties =%" PRId32, count);
+        result = __LINE__;
+    }
+    else if (count == 0)
+    {
+        *position += parsed;
+        *typedProperties = NULL;
+        *typedPropertiesCount = 0;
+        result = 0;
+    }
+    else if ((*typedProperties = (MESSAGE_TYPED_PROPERTY*)malloc(count * sizeof(MESSAGE_TYPED_PROPERTY))) == NULL)
+    {
+        LogError("unable to allocate %" PRId32 " typed properties", count);
+        result = __LINE__;
+    }
+    else
+    {
+        int32_t i;
+        *position += parsed;
+        for (i = 0; i < count; i++)
+        {
+            if (parse_typed_property(source, sourceSize, position, &(*typedProperties)[i]) != 0)
+            {
+                break;
+            }
+        }
+
+        if (i != count)
+        {
+            free(*typedProperties);
+            *typedProperties = NULL;
+            result = __LINE__;
+        }
+        else
+        {
+            *typedPropertiesCount = count;
+            result = 0;
+        }
+    }
+    return result;
+}
+
 /*creates a MESSAGE_HANDLE from a serialized byte array*/
 MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t size)
 {
@@ -314,10 +1300,10 @@ MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t
     }
     else
     {
-        /*Codes_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+        /*Codes_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 or 0xA1 0x61 then Message_CreateFromByteArray shall fail and return NULL. ]*/
         if (
             (source[0] != FIRST_MESSAGE_BYTE) ||
-            (source[1] != SECOND_MESSAGE_BYTE)
+            ((source[1] != SECOND_MESSAGE_BYTE) && (source[1] != TYPED_SECOND_MESSAGE_BYTE))
             )
         {
             LogError("byte array is not a gateway message serialization");
@@ -420,8 +1406,18 @@ MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t
 								{
 									/*all is fine*/
 									int32_t messageContentSize;
+									MESSAGE_TYPED_PROPERTY* typedProperties = NULL;
+									int32_t typedPropertiesCount = 0;
 
-									if (parse_int32_t(source, size, currentPosition, &parsed, &messageContentSize) != 0)
+									/*Codes_SRS_MESSAGE_26_043: [ If the first two bytes of source are 0xA1 0x61, Message_CreateFromByteArray shall parse the typed properties that follow the properties and add them to the message as Message_CreateWithTypedProperties does. ]*/
+									if (
+										(source[1] == TYPED_SECOND_MESSAGE_BYTE) &&
+										(parse_typed_properties(source, size, &currentPosition, &typedProperties, &typedPropertiesCount) != 0)
+										)
+									{
+										result = NULL;
+									}
+									else if (parse_int32_t(source, size, currentPosition, &parsed, &messageContentSize) != 0)
 									{
 										LogError("no space to read the number of bytes making the message");
 										result = NULL;
@@ -434,6 +1430,10 @@ MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t
 											LogError("the message content doesn't up to the message size %" PRId32 " %" PRId32 "\n", (int32_t)(currentPosition + messageContentSize), messageSize);
 											result = NULL;
 										}
+										else if (validate_typed_properties(configMap, typedProperties, (size_t)typedPropertiesCount) != 0)
+										{
+											result = NULL;
+										}
 										else
 										{
 											/*Codes_SRS_MESSAGE_02_028: [ A structure of type MESSAGE_CONFIG shall be populated with the MAP_HANDLE previously constructed and the message content ]*/
@@ -441,12 +1441,16 @@ MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t
 
 											/*Codes_SRS_MESSAGE_02_029: [ A MESSAGE_HANDLE shall be constructed from the MESSAGE_CONFIG. ]*/
 											/*Codes_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
-											result = Message_CreateImpl(&msgConfig);
+											result = Message_CreateImpl(&msgConfig, typedProperties, (size_t)typedPropertiesCount);
 
 											/*return as is*/
 
 										}
 									}
+									if (typedProperties != NULL)
+									{
+										free(typedProperties);
+									}
 								}
 							}
 						}
@@ -460,7 +1464,61 @@ MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t
 
 }
 
-extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char* buf, int32_t size)
+/*the size of a typed property in the typed serialization*/
+static size_t typed_property_serialized_size(const MESSAGE_TYPED_PROPERTY* property)
+{
+    return
+        (strlen(property->name) + 1) +
+        1 + /*type*/
+        ((property->type == MESSAGE_PROPERTY_BYTES) ? 4 + property->value.bytesValue.size : 8);
+}
+
+static size_t write_uint32(unsigned char* buf, uint32_t value)
+{
+    buf[0] = (value >> 24) & 0xFF;
+    buf[1] = (value >> 16) & 0xFF;
+    buf[2] = (value >> 8) & 0xFF;
+    buf[3] = value & 0xFF;
+    return 4;
+}
+
+static size_t write_typed_property(unsigned char* buf, const MESSAGE_TYPED_PROPERTY* property)
+{
+    size_t nameLength = strlen(property->name) + 1;/*the +1 will take care of copying '\0' too*/
+    size_t currentPosition = nameLength;
+    memcpy(buf, property->name, nameLength);
+    if (property->type == MESSAGE_PROPERTY_BYTES)
+    {
+        buf[currentPosition++] = TYPED_PROPERTY_BYTES;
+        currentPosition += write_uint32(buf + currentPosition, (uint32_t)property->value.bytesValue.size);
+        if (property->value.bytesValue.size > 0)
+        {
+            memcpy(buf + currentPosition, property->value.bytesValue.buffer, property->value.bytesValue.size);
+        }
+        currentPosition += property->value.bytesValue.size;
+    }
+    else
+    {
+        uint64_t bits;
+        if (property->type == MESSAGE_PROPERTY_INT64)
+        {
+            buf[currentPosition++] = TYPED_PROPERTY_INT64;
+            bits = (uint64_t)property->value.int64Value;
+        }
+        else
+        {
+            buf[currentPosition++] = TYPED_PROPERTY_DOUBLE;
+            memcpy(&bits, &property->value.doubleValue, sizeof(double));
+        }
+        currentPosition += write_uint32(buf + currentPosition, (uint32_t)(bits >> 32));
+        currentPosition += write_uint32(buf + currentPosition, (uint32_t)bits);
+    }
+    return currentPosition;
+}
+
+/*serializes a message. The typed serialization keeps typed properties apart from the
+string properties; the other one renders them as strings.*/
+static int32_t serialize_message(MESSAGE_HANDLE messageHandle, unsigned char* buf, int32_t size, bool typed)
 {
     int32_t result;
     if (messageHandle == NULL) 
@@ -496,8 +1554,21 @@ extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char*
         const char* const * values;
         size_t nProperties;
 
+        size_t nTypedProperties = 0;
+
+        /*Codes_SRS_MESSAGE_26_026: [ If messageHandle was derived, Message_ToByteArray shall serialize the properties Message_GetProperties would return. ]*/
+        /*Codes_SRS_MESSAGE_26_044: [ If messageHandle has typed properties, Message_ToByteArray shall serialize them as the strings Message_GetProperties returns. ]*/
+        CONSTMAP_HANDLE properties = (messageHandleData->overrides == NULL && (typed || messageHandleData->typed == NULL)) ?
+            messageHandleData->properties :
+            merge_properties(messageHandleData, !typed);
+
         /*Codes_SRS_MESSAGE_02_035: [ If any of the above steps fails then Message_ToByteArray shall fail and return -1. ]*/
-        if (ConstMap_GetInternals(messageHandleData->properties, &keys, &values, &nProperties) != CONSTMAP_OK)
+        if (properties == NULL)
+        {
+            LogError("failed to merge the properties of a derived message");
+            result = -1;
+        }
+        else if (ConstMap_GetInternals(properties, &keys, &values, &nProperties) != CONSTMAP_OK)
         {
             LogError("failed to get the keys and values from the message properties");
             result = -1;
@@ -511,6 +1582,23 @@ extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char*
                 byteArraySize += (strlen(keys[i]) + 1) + (strlen(values[i]) + 1);
             }
 
+            if (typed)
+            {
+                /*4 bytes for the number of typed properties, then the typed properties that are not hidden*/
+                byteArraySize += 4;
+                if (messageHandleData->typed != NULL)
+                {
+                    for (i = 0; i < messageHandleData->typed->count; i++)
+                    {
+                        if (typed_property_is_visible(messageHandleData, messageHandleData->typed->properties[i].name))
+                        {
+                            byteArraySize += typed_property_serialized_size(&messageHandleData->typed->properties[i]);
+                            nTypedProperties++;
+                        }
+                    }
+                }
+            }
+
             const CONSTBUFFER* messageContent = CONSTBUFFER_GetContent(messageHandleData->content);
             byteArraySize += messageContent->size;
             
@@ -532,7 +1620,7 @@ extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char*
                 size_t currentPosition; /*always points to the byte we are about to write*/
                 /*a header formed of the following hex characters in this order: 0xA1 0x60*/
                 buf[0] = FIRST_MESSAGE_BYTE;
-                buf[1] = SECOND_MESSAGE_BYTE;
+                buf[1] = typed ? TYPED_SECOND_MESSAGE_BYTE : SECOND_MESSAGE_BYTE;
                 /*4 bytes in MSB order representing the total size of the byte array. */
                 buf[2] = byteArraySize >> 24;
                 buf[3] = (byteArraySize >> 16) & 0xFF;
@@ -559,6 +1647,19 @@ extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char*
                     currentPosition += valueLength;
                 }
 
+                if (typed)
+                {
+                    /*4 bytes in MSB order representing the number of typed properties, then the typed properties*/
+                    currentPosition += write_uint32(buf + currentPosition, (uint32_t)nTypedProperties);
+                    for (i = 0; nTypedProperties > 0 && i < messageHandleData->typed->count; i++)
+                    {
+                        if (typed_property_is_visible(messageHandleData, messageHandleData->typed->properties[i].name))
+                        {
+                            currentPosition += write_typed_property(buf + currentPosition, &messageHandleData->typed->properties[i]);
+                        }
+                    }
+                }
+
                 /*4 bytes in MSB order representing the number of bytes in the message content array*/
                 buf[currentPosition++] = (messageContent->size) >> 24;
                 buf[currentPosition++] = ((messageContent->size) >> 16) & 0xFF;
@@ -572,6 +1673,22 @@ extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char*
                 result = byteArraySize;
             }
         }
+
+        if (properties != NULL && properties != messageHandleData->properties)
+        {
+            ConstMap_Destroy(properties);
+        }
     }
     return result;
-}
\ No newline at end of file
+}
+
+extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char* buf, int32_t size)
+{
+    return serialize_message(messageHandle, buf, size, false);
+}
+
+int32_t Message_ToTypedByteArray(MESSAGE_HANDLE messageHandle, unsigned char* buf, int32_t size)
+{
+    /*Codes_SRS_MESSAGE_26_045: [ Message_ToTypedByteArray shall serialize the message as Message_ToByteArray does, except that the header shall be 0xA1 0x61 and the typed properties that are not hidden shall follow the properties instead of being among them. ]*/
+    return serialize_message(messageHandle, buf, size, true);
+}
@@ -0,0 +1,659 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* this file implements the redirected functions, so it must call the real allocator */
+#define MODULE_ALLOC_NO_REDIRECT
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/lock.h"
+
+#include "module_alloc.h"
+
+#ifdef _MSC_VER
+#define MODULE_ALLOC_THREAD_LOCAL __declspec(thread)
+#else
+#define MODULE_ALLOC_THREAD_LOCAL __thread
+#endif
+
+/* allocations are spread over shards with a lock each, so modules allocating
+   on different threads rarely wait for each other */
+#define MODULE_ALLOC_SHARD_COUNT 64
+#define MODULE_ALLOC_BUCKET_COUNT 67
+
+typedef struct MODULE_ALLOC_TAG_DATA_TAG
+{
+    LOCK_HANDLE lock;
+    char* name;
+    MODULE_ALLOC_STATS stats;
+    bool over_budget;
+    bool retired;
+    struct MODULE_ALLOC_TAG_DATA_TAG* next;
+} MODULE_ALLOC_TAG_DATA;
+
+typedef struct MODULE_ALLOC_ENTRY_TAG
+{
+    void* ptr;
+    size_t size;
+    MODULE_ALLOC_TAG_DATA* tag;
+    struct MODULE_ALLOC_ENTRY_TAG* next;
+} MODULE_ALLOC_ENTRY;
+
+typedef struct MODULE_ALLOC_SHARD_TAG
+{
+    LOCK_HANDLE lock;
+    /* false outside of ModuleAlloc_Init/ModuleAlloc_Deinit, only changed with lock held */
+    bool enabled;
+    /* number of entries in buckets, read without the lock by ModuleAlloc_Free */
+    volatile size_t entry_count;
+    MODULE_ALLOC_ENTRY* buckets[MODULE_ALLOC_BUCKET_COUNT];
+    /* entries of freed blocks, reused so that tracking does not allocate */
+    MODULE_ALLOC_ENTRY* spare;
+} MODULE_ALLOC_SHARD;
+
+/* The locks are created by the first ModuleAlloc_Init and are never
+   destroyed: code outside the gateway, such as a module's own threads, may
+   still free memory after ModuleAlloc_Deinit, and must find valid locks. */
+static LOCK_HANDLE tags_lock = NULL;
+static MODULE_ALLOC_SHARD shards[MODULE_ALLOC_SHARD_COUNT];
+static volatile bool shards_created = false;
+static size_t init_count = 0;
+static MODULE_ALLOC_TAG_DATA* tags = NULL;
+static MODULE_ALLOC_THREAD_LOCAL MODULE_ALLOC_TAG_DATA* thread_tag = NULL;
+
+static MODULE_ALLOC_SHARD* shard_of(const void* ptr)
+{
+    /* low bits are always zero because of allocator alignment */
+    return &shards[((uintptr_t)ptr >> 4) % MODULE_ALLOC_SHARD_COUNT];
+}
+
+static size_t bucket_of(const void* ptr)
+{
+    return (size_t)((((uintptr_t)ptr >> 4) / MODULE_ALLOC_SHARD_COUNT) % MODULE_ALLOC_BUCKET_COUNT);
+}
+
+/* the following functions must be called with the shard's lock held */
+
+static MODULE_ALLOC_ENTRY* table_remove(MODULE_ALLOC_SHARD* shard, const void* ptr)
+{
+    MODULE_ALLOC_ENTRY** current = &shard->buckets[bucket_of(ptr)];
+    MODULE_ALLOC_ENTRY* result = NULL;
+    while (*current != NULL)
+    {
+        if ((*current)->ptr == ptr)
+        {
+            result = *current;
+            *current = result->next;
+            shard->entry_count--;
+            break;
+        }
+        current = &((*current)->next);
+    }
+    return result;
+}
+
+static void table_insert(MODULE_ALLOC_SHARD* shard, MODULE_ALLOC_ENTRY* entry)
+{
+    size_t bucket = bucket_of(entry->ptr);
+    entry->next = shard->buckets[bucket];
+    shard->buckets[bucket] = entry;
+    shard->entry_count++;
+}
+
+static void entry_recycle(MODULE_ALLOC_SHARD* shard, MODULE_ALLOC_ENTRY* entry)
+{
+    entry->next = shard->spare;
+    shard->spare = entry;
+}
+
+static MODULE_ALLOC_ENTRY* entry_get(MODULE_ALLOC_SHARD* shard)
+{
+    MODULE_ALLOC_ENTRY* result = shard->spare;
+    if (result != NULL)
+    {
+        shard->spare = result->next;
+    }
+    else
+    {
+        result = (MODULE_ALLOC_ENTRY*)malloc(sizeof(MODULE_ALLOC_ENTRY));
+    }
+    return result;
+}
+
+/* the following functions must be called with the tag's lock held */
+
+/* returns true when this change took the tag over its budget */
+static bool tag_update_usage(MODULE_ALLOC_TAG_DATA* tag)
+{
+    bool result = false;
+    if (tag->stats.current_bytes > tag->stats.peak_bytes)
+    {
+        tag->stats.peak_bytes = tag->stats.current_bytes;
+    }
+    if (tag->stats.budget_bytes == 0 || tag->stats.current_bytes <= tag->stats.budget_bytes)
+    {
+        tag->over_budget = false;
+    }
+    else if (!tag->over_budget)
+    {
+        tag->over_budget = true;
+        tag->stats.budget_exceeded_count++;
+        result = true;
+    }
+    return result;
+}
+
+/* returns true when the tag was retired and this was its last allocation */
+static bool tag_credit(MODULE_ALLOC_TAG_DATA* tag, size_t size)
+{
+    tag->stats.current_bytes -= size;
+    tag->stats.free_count++;
+    (void)tag_update_usage(tag);
+    return tag->retired && tag->stats.free_count == tag->stats.allocation_count;
+}
+
+static void tag_free(MODULE_ALLOC_TAG_DATA* tag)
+{
+    (void)Lock_Deinit(tag->lock);
+    free(tag->name);
+    free(tag);
+}
+
+/* must be called with tags_lock held; returns false when the tag was already released */
+static bool tag_unlink(MODULE_ALLOC_TAG_DATA* tag)
+{
+    bool result = false;
+    MODULE_ALLOC_TAG_DATA** current = &tags;
+    while (*current != NULL)
+    {
+        if (*current == tag)
+        {
+            *current = tag->next;
+            result = true;
+            break;
+        }
+        current = &((*current)->next);
+    }
+    return result;
+}
+
+static void tag_release(MODULE_ALLOC_TAG_DATA* tag)
+{
+    bool unlinked = false;
+    /* ModuleAlloc_Deinit may have released every tag in the meantime, so the
+       tag is only touched once it is known to still be in the list */
+    if (Lock(tags_lock) == LOCK_OK)
+    {
+        unlinked = tag_unlink(tag);
+        (void)Unlock(tags_lock);
+    }
+    if (unlinked)
+    {
+        tag_free(tag);
+    }
+}
+
+static void log_over_budget(const MODULE_ALLOC_TAG_DATA* tag, size_t current_bytes, size_t budget_bytes)
+{
+    LogError("module '%s' is over its memory budget: %lu bytes in use, budget is %lu bytes",
+        tag->name, (unsigned long)current_bytes, (unsigned long)budget_bytes);
+}
+
+/* must be called with the shard's lock held, so that ModuleAlloc_Deinit cannot release tag meanwhile */
+static void charge_tag(MODULE_ALLOC_TAG_DATA* tag, size_t size, size_t previous_size, bool is_new)
+{
+    if (Lock(tag->lock) == LOCK_OK)
+    {
+        bool over_budget;
+        size_t current_bytes;
+        size_t budget_bytes;
+        tag->stats.current_bytes = tag->stats.current_bytes - previous_size + size;
+        if (is_new)
+        {
+            tag->stats.allocation_count++;
+        }
+        over_budget = tag_update_usage(tag);
+        current_bytes = tag->stats.current_bytes;
+        budget_bytes = tag->stats.budget_bytes;
+        (void)Unlock(tag->lock);
+
+        if (over_budget)
+        {
+            log_over_budget(tag, current_bytes, budget_bytes);
+        }
+    }
+}
+
+/* returns true when the tag can be released, must be called with the shard's lock held */
+static bool credit_tag(MODULE_ALLOC_TAG_DATA* tag, size_t size)
+{
+    bool result = false;
+    if (Lock(tag->lock) == LOCK_OK)
+    {
+        result = tag_credit(tag, size);
+        (void)Unlock(tag->lock);
+    }
+    return result;
+}
+
+static void track_allocation(void* ptr, size_t size, MODULE_ALLOC_TAG_DATA* tag)
+{
+    MODULE_ALLOC_SHARD* shard = shard_of(ptr);
+    if (shards_created && Lock(shard->lock) == LOCK_OK)
+    {
+        MODULE_ALLOC_TAG_DATA* release = NULL;
+        if (shard->enabled)
+        {
+            MODULE_ALLOC_ENTRY* entry = entry_get(shard);
+            if (entry == NULL)
+            {
+                /* the allocation still succeeds, it is just not attributed */
+            }
+            else
+            {
+                /* an entry for the same address means the block was released by code
+                   that does not go through ModuleAlloc_Free, so drop it first */
+                MODULE_ALLOC_ENTRY* stale = table_remove(shard, ptr);
+                if (stale != NULL)
+                {
+                    if (credit_tag(stale->tag, stale->size))
+                    {
+                        release = stale->tag;
+                    }
+                    entry_recycle(shard, stale);
+                }
+
+                entry->ptr = ptr;
+                entry->size = size;
+                entry->tag = tag;
+                table_insert(shard, entry);
+                charge_tag(tag, size, 0, true);
+            }
+        }
+        (void)Unlock(shard->lock);
+
+        if (release != NULL)
+        {
+            tag_release(release);
+        }
+    }
+}
+
+/* creates the locks on first use, must not race with other calls */
+static int create_locks(void)
+{
+    int result;
+    if (tags_lock == NULL)
+    {
+        tags_lock = Lock_Init();
+    }
+
+    if (tags_lock == NULL)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < MODULE_ALLOC_SHARD_COUNT; i++)
+        {
+            if (shards[i].lock == NULL)
+            {
+                shards[i].lock = Lock_Init();
+                if (shards[i].lock == NULL)
+                {
+                    break;
+                }
+            }
+        }
+
+        if (i < MODULE_ALLOC_SHARD_COUNT)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            shards_created = true;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+int ModuleAlloc_Init(void)
+{
+    int result;
+    if (init_count == 0 && create_locks() != 0)
+    {
+        LogError("unable to initialize the module allocation locks");
+        result = __LINE__;
+    }
+    else
+    {
+        if (init_count == 0)
+        {
+            size_t i;
+            for (i = 0; i < MODULE_ALLOC_SHARD_COUNT; i++)
+            {
+                (void)Lock(shards[i].lock);
+                shards[i].enabled = true;
+                (void)Unlock(shards[i].lock);
+            }
+        }
+        init_count++;
+        result = 0;
+    }
+    return result;
+}
+
+void ModuleAlloc_Deinit(void)
+{
+    if (init_count == 0)
+    {
+        LogError("ModuleAlloc_Deinit called without ModuleAlloc_Init");
+    }
+    else
+    {
+        init_count--;
+        if (init_count == 0)
+        {
+            size_t i;
+            /* once a shard is disabled nothing new is charged to a tag through
+               it, and a thread that was charging one has finished, so after the
+               last shard the tags can go */
+            for (i = 0; i < MODULE_ALLOC_SHARD_COUNT; i++)
+            {
+                MODULE_ALLOC_SHARD* shard = &shards[i];
+                size_t j;
+                (void)Lock(shard->lock);
+                shard->enabled = false;
+                for (j = 0; j < MODULE_ALLOC_BUCKET_COUNT; j++)
+                {
+                    while (shard->buckets[j] != NULL)
+                    {
+                        MODULE_ALLOC_ENTRY* entry = shard->buckets[j];
+                        shard->buckets[j] = entry->next;
+                        free(entry);
+                    }
+                }
+                shard->entry_count = 0;
+                while (shard->spare != NULL)
+                {
+                    MODULE_ALLOC_ENTRY* entry = shard->spare;
+                    shard->spare = entry->next;
+                    free(entry);
+                }
+                (void)Unlock(shard->lock);
+            }
+
+            (void)Lock(tags_lock);
+            while (tags != NULL)
+            {
+                MODULE_ALLOC_TAG_DATA* tag = tags;
+                tags = tag->next;
+                tag_free(tag);
+            }
+            (void)Unlock(tags_lock);
+        }
+    }
+}
+
+MODULE_ALLOC_TAG ModuleAlloc_CreateTag(const char* name)
+{
+    MODULE_ALLOC_TAG_DATA* result;
+    if (name == NULL)
+    {
+        LogError("invalid argument name=NULL");
+        result = NULL;
+    }
+    else if (init_count == 0)
+    {
+        LogError("ModuleAlloc_Init has not been called");
+        result = NULL;
+    }
+    else
+    {
+        result = (MODULE_ALLOC_TAG_DATA*)calloc(1, sizeof(MODULE_ALLOC_TAG_DATA));
+        if (result == NULL)
+        {
+            LogError("unable to allocate module allocation tag");
+        }
+        else if (mallocAndStrcpy_s(&result->name, name) != 0)
+        {
+            LogError("unable to copy module name");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("unable to initialize the tag lock");
+            free(result->name);
+            free(result);
+            result = NULL;
+        }
+        else if (Lock(tags_lock) != LOCK_OK)
+        {
+            LogError("unable to Lock");
+            tag_free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->next = tags;
+            tags = result;
+            (void)Unlock(tags_lock);
+        }
+    }
+    return result;
+}
+
+void ModuleAlloc_DestroyTag(MODULE_ALLOC_TAG tag)
+{
+    if (tag != NULL && init_count != 0)
+    {
+        if (Lock(tag->lock) != LOCK_OK)
+        {
+            LogError("unable to Lock");
+        }
+        else
+        {
+            bool release;
+            tag->retired = true;
+            release = (tag->stats.free_count == tag->stats.allocation_count);
+            (void)Unlock(tag->lock);
+            if (release)
+            {
+                tag_release(tag);
+            }
+        }
+    }
+}
+
+MODULE_ALLOC_TAG ModuleAlloc_SetThreadTag(MODULE_ALLOC_TAG tag)
+{
+    MODULE_ALLOC_TAG result = thread_tag;
+    thread_tag = tag;
+    return result;
+}
+
+MODULE_ALLOC_TAG ModuleAlloc_GetThreadTag(void)
+{
+    return thread_tag;
+}
+
+int ModuleAlloc_GetStats(MODULE_ALLOC_TAG tag, MODULE_ALLOC_STATS* stats)
+{
+    int result;
+    if (tag == NULL || stats == NULL || init_count == 0)
+    {
+        LogError("invalid argument tag=%p, stats=%p", tag, stats);
+        result = __LINE__;
+    }
+    else if (Lock(tag->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock");
+        result = __LINE__;
+    }
+    else
+    {
+        *stats = tag->stats;
+        (void)Unlock(tag->lock);
+        result = 0;
+    }
+    return result;
+}
+
+void ModuleAlloc_SetBudget(MODULE_ALLOC_TAG tag, size_t budget_bytes)
+{
+    if (tag != NULL && init_count != 0)
+    {
+        if (Lock(tag->lock) != LOCK_OK)
+        {
+            LogError("unable to Lock");
+        }
+        else
+        {
+            tag->stats.budget_bytes = budget_bytes;
+            tag->over_budget = false;
+            (void)tag_update_usage(tag);
+            (void)Unlock(tag->lock);
+        }
+    }
+}
+
+void* ModuleAlloc_Malloc(size_t size)
+{
+    void* result = malloc(size);
+    MODULE_ALLOC_TAG_DATA* tag = thread_tag;
+    if (result != NULL && tag != NULL)
+    {
+        track_allocation(result, size, tag);
+    }
+    return result;
+}
+
+void* ModuleAlloc_Calloc(size_t nmemb, size_t size)
+{
+    void* result = calloc(nmemb, size);
+    MODULE_ALLOC_TAG_DATA* tag = thread_tag;
+    if (result != NULL && tag != NULL)
+    {
+        track_allocation(result, nmemb * size, tag);
+    }
+    return result;
+}
+
+void* ModuleAlloc_Realloc(void* ptr, size_t size)
+{
+    void* result;
+    MODULE_ALLOC_SHARD* shard = shard_of(ptr);
+    if (ptr == NULL)
+    {
+        result = ModuleAlloc_Malloc(size);
+    }
+    else if (!shards_created || (shard->entry_count == 0 && thread_tag == NULL))
+    {
+        /* no module could own the block and none is charged for the new one */
+        result = realloc(ptr, size);
+    }
+    else
+    {
+        MODULE_ALLOC_ENTRY* entry = NULL;
+        if (Lock(shard->lock) == LOCK_OK)
+        {
+            entry = table_remove(shard, ptr);
+            (void)Unlock(shard->lock);
+        }
+
+        result = realloc(ptr, size);
+        if (entry == NULL)
+        {
+            /* not a block we know about, charge the new block to the caller */
+            if (result != NULL && thread_tag != NULL)
+            {
+                track_allocation(result, size, thread_tag);
+            }
+        }
+        else
+        {
+            MODULE_ALLOC_SHARD* new_shard = shard_of((result == NULL) ? ptr : result);
+            if (Lock(new_shard->lock) != LOCK_OK)
+            {
+                free(entry);
+            }
+            else
+            {
+                MODULE_ALLOC_TAG_DATA* release = NULL;
+                if (!new_shard->enabled)
+                {
+                    /* ModuleAlloc_Deinit ran while the block was out of the table */
+                    free(entry);
+                }
+                else if (result == NULL && size != 0)
+                {
+                    /* the original block is untouched */
+                    table_insert(new_shard, entry);
+                }
+                else if (result == NULL)
+                {
+                    /* realloc to 0 released the block */
+                    if (credit_tag(entry->tag, entry->size))
+                    {
+                        release = entry->tag;
+                    }
+                    entry_recycle(new_shard, entry);
+                }
+                else
+                {
+                    /* a reallocated block stays with the module that allocated it */
+                    size_t previous_size = entry->size;
+                    entry->ptr = result;
+                    entry->size = size;
+                    table_insert(new_shard, entry);
+                    charge_tag(entry->tag, size, previous_size, false);
+                }
+                (void)Unlock(new_shard->lock);
+
+                if (release != NULL)
+                {
+                    tag_release(release);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void ModuleAlloc_Free(void* ptr)
+{
+    if (ptr != NULL)
+    {
+        MODULE_ALLOC_SHARD* shard = shard_of(ptr);
+        /* the block was handed to this thread after it was tracked, so an
+           empty shard cannot be hiding its entry */
+        if (shards_created && shard->entry_count != 0 && Lock(shard->lock) == LOCK_OK)
+        {
+            MODULE_ALLOC_TAG_DATA* release = NULL;
+            MODULE_ALLOC_ENTRY* entry = table_remove(shard, ptr);
+            if (entry != NULL)
+            {
+                if (credit_tag(entry->tag, entry->size))
+                {
+                    release = entry->tag;
+                }
+                entry_recycle(shard, entry);
+            }
+            (void)Unlock(shard->lock);
+
+            if (release != NULL)
+            {
+                tag_release(release);
+            }
+        }
+        free(ptr);
+    }
+}
@@ -16,6 +16,7 @@
 #include "module.h"
 #include "module_loader.h"
 #include "module_loaders/dynamic_loader.h"
+#include "module_loaders/static_loader.h"
 
 #ifdef OUTPROCESS_ENABLED
 #include "module_loaders/outprocess_loader.h"
@@ -90,6 +91,7 @@ MODULE_LOADER_RESULT ModuleLoader_Initialize(void)
                 const MODULE_LOADER* supported_loaders[] =
                 {
                     DynamicLoader_Get()
+                    , StaticLoader_Get()
 #ifdef NODE_BINDING_ENABLED
                     , NodeLoader_Get()
 #endif
@@ -509,6 +511,11 @@ MODULE_LOADER* ModuleLoader_GetDefaultLoaderForType(MODULE_LOADER_TYPE type)
         result = ModuleLoader_FindByName(DYNAMIC_LOADER_NAME);
         break;
 
+    case STATIC:
+        /*Codes_SRS_MODULE_LOADER_13_058: [ ModuleLoader_GetDefaultLoaderForType shall return a non-NULL MODULE_LOADER pointer when the loader type is a recongized type. ]*/
+        result = ModuleLoader_FindByName(STATIC_LOADER_NAME);
+        break;
+
 #ifdef NODE_BINDING_ENABLED
     case NODEJS:
         /*Codes_SRS_MODULE_LOADER_13_058: [ ModuleLoader_GetDefaultLoaderForType shall return a non-NULL MODULE_LOADER pointer when the loader type is a recongized type. ]*/
@@ -559,6 +566,9 @@ MODULE_LOADER_TYPE ModuleLoader_ParseType(const char* type)
     if (strcmp(type, "native") == 0)
         /*Codes_SRS_MODULE_LOADER_13_060: [ ModuleLoader_ParseType shall return a valid MODULE_LOADER_TYPE if type is a recognized module loader type string. ]*/
         loader_type = NATIVE;
+    else if (strcmp(type, "static") == 0)
+        /*Codes_SRS_MODULE_LOADER_13_060: [ ModuleLoader_ParseType shall return a valid MODULE_LOADER_TYPE if type is a recognized module loader type string. ]*/
+        loader_type = STATIC;
     else if (strcmp(type, "outprocess") == 0)
         /*Codes_SRS_MODULE_LOADER_13_060: [ ModuleLoader_ParseType shall return a valid MODULE_LOADER_TYPE if type is a recognized module loader type string. ]*/
         loader_type = OUTPROCESS;
@@ -585,6 +595,8 @@ bool ModuleLoader_IsDefaultLoader(const char* name)
 {
     /*Codes_SRS_MODULE_LOADER_13_061: [ ModuleLoader_IsDefaultLoader shall return true if name is the name of a default module loader and false otherwise. The default module loader names are 'native', 'node', 'java' , 'dotnet' and 'dotnetcore'. ]*/
     return strcmp(name, DYNAMIC_LOADER_NAME) == 0
+           ||
+           strcmp(name, STATIC_LOADER_NAME) == 0
            ||
            strcmp(name, "outprocess") == 0
            ||
@@ -40,6 +40,7 @@ typedef struct JAVA_MODULE_HANDLE_DATA_TAG
 } JAVA_MODULE_HANDLE_DATA;
 
 static JVM_OPTIONS* parse_jvm_config(JSON_Object*);
+static int parse_jvm_startup_options(JSON_Object*, JVM_OPTIONS*);
 static void free_jvm_config(JVM_OPTIONS*);
 static DYNAMIC_LIBRARY_HANDLE system_load_env(int, ...);
 static DYNAMIC_LIBRARY_HANDLE system_load_prefixes(int, ...);
@@ -649,6 +650,11 @@ static JAVA_LOADER_CONFIGURATION* create_default_config()
             default_options->debug_port = 0;
             default_options->verbose = false;
             default_options->additional_options = NULL;
+            default_options->cds_archive = NULL;
+            default_options->tiered_stop_at_level = 0;
+            default_options->initial_heap_mb = 0;
+            default_options->max_heap_mb = 0;
+            default_options->parallel_startup = false;
 
             
             result = (JAVA_LOADER_CONFIGURATION*)malloc(sizeof(JAVA_LOADER_CONFIGURATION));
@@ -780,12 +786,43 @@ static void free_jvm_config(JVM_OPTIONS* options)
             VECTOR_destroy(options->additional_options);
         }
 
+        if (options->cds_archive != NULL)
+        {
+            free((char*)(options->cds_archive));
+        }
+
         free((char*)(options->class_path));
         free((char*)(options->library_path));
         free(options);
     }
 }
 
+static int parse_jvm_startup_options(JSON_Object* object, JVM_OPTIONS* options)
+{
+    int result;
+
+    /*Codes_SRS_JAVA_MODULE_LOADER_26_001: [JavaModuleLoader_ParseConfigurationFromJson shall parse the jvm.options.cds.archive.]*/
+    const char* cds_archive = json_object_get_string(object, JAVA_MODULE_JVM_OPTIONS_CDS_ARCHIVE_KEY);
+    if (cds_archive != NULL && mallocAndStrcpy_s((char**)(&options->cds_archive), cds_archive) != 0)
+    {
+        options->cds_archive = NULL;
+        LogError("Failed to allocate cds.archive");
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_JAVA_MODULE_LOADER_26_002: [JavaModuleLoader_ParseConfigurationFromJson shall parse the jvm.options.tiered.stop.at.level, jvm.options.heap.initial.mb and jvm.options.heap.max.mb.]*/
+        options->tiered_stop_at_level = (int)json_object_get_number(object, JAVA_MODULE_JVM_OPTIONS_TIERED_STOP_AT_LEVEL_KEY);
+        options->initial_heap_mb = (int)json_object_get_number(object, JAVA_MODULE_JVM_OPTIONS_INITIAL_HEAP_KEY);
+        options->max_heap_mb = (int)json_object_get_number(object, JAVA_MODULE_JVM_OPTIONS_MAX_HEAP_KEY);
+        /*Codes_SRS_JAVA_MODULE_LOADER_26_003: [JavaModuleLoader_ParseConfigurationFromJson shall parse the jvm.options.parallel.startup.]*/
+        options->parallel_startup = json_object_get_boolean(object, JAVA_MODULE_JVM_OPTIONS_PARALLEL_STARTUP_KEY) == 1 ? true : false;
+        result = 0;
+    }
+
+    return result;
+}
+
 static JVM_OPTIONS* parse_jvm_config(JSON_Object* object)
 {
     JVM_OPTIONS* options;
@@ -797,8 +834,16 @@ static JVM_OPTIONS* parse_jvm_config(JSON_Object* object)
     }
     else
     {
-        int status = set_default_paths(options);
+        int status;
 
+        options->additional_options = NULL;
+        options->cds_archive = NULL;
+        options->tiered_stop_at_level = 0;
+        options->initial_heap_mb = 0;
+        options->max_heap_mb = 0;
+        options->parallel_startup = false;
+
+        status = set_default_paths(options);
         if (status != 0)
         {
             free(options);
@@ -885,6 +930,12 @@ static JVM_OPTIONS* parse_jvm_config(JSON_Object* object)
                             options = NULL;
                             LogError("Failed to properly create vector of additional options.");
                         }
+                        else if (parse_jvm_startup_options(object, options) != 0)
+                        {
+                            free_jvm_config(options);
+                            options = NULL;
+                            LogError("Failed to parse the JVM startup options.");
+                        }
                     }
                 }
             }
@@ -184,7 +184,9 @@ static void* NodeModuleLoader_ParseEntrypointFromJson(const MODULE_LOADER* loade
 
     // The input is a JSON object that looks like this:
     //  "entrypoint": {
-    //      "main.path": "path/to/module"
+    //      "main.path": "path/to/module",
+    //      "isolate": 1,                       (optional)
+    //      "code.cache": "path/to/cache/file"  (optional)
     //  }
     NODE_LOADER_ENTRYPOINT* config;
     if (json == NULL)
@@ -226,6 +228,8 @@ static void* NodeModuleLoader_ParseEntrypointFromJson(const MODULE_LOADER* loade
                     config = (NODE_LOADER_ENTRYPOINT*)malloc(sizeof(NODE_LOADER_ENTRYPOINT));
                     if (config != NULL)
                     {
+                        config->isolate = 0;
+                        config->codeCachePath = NULL;
                         config->mainPath = STRING_construct(mainPath);
                         if (config->mainPath == NULL)
                         {
@@ -236,9 +240,37 @@ static void* NodeModuleLoader_ParseEntrypointFromJson(const MODULE_LOADER* loade
                         }
                         else
                         {
-                            /**
-                             * Everything's good.
-                             */
+                            //Codes_SRS_NODE_MODULE_LOADER_26_001: [ NodeModuleLoader_ParseEntrypointFromJson shall read the optional number isolate, defaulting to 0 when it does not exist. ]
+                            double isolate = json_object_get_number(entrypoint, "isolate");
+                            //Codes_SRS_NODE_MODULE_LOADER_26_003: [ NodeModuleLoader_ParseEntrypointFromJson shall read the optional string code.cache. ]
+                            const char* codeCachePath = json_object_get_string(entrypoint, "code.cache");
+                            if (isolate < 0)
+                            {
+                                LogError("'isolate' must not be negative");
+                                STRING_delete(config->mainPath);
+                                free(config);
+                                //Codes_SRS_NODE_MODULE_LOADER_26_002: [ NodeModuleLoader_ParseEntrypointFromJson shall return NULL if isolate is negative. ]
+                                config = NULL;
+                            }
+                            else
+                            {
+                                config->isolate = (size_t)isolate;
+                                if (codeCachePath != NULL &&
+                                    (config->codeCachePath = STRING_construct(codeCachePath)) == NULL)
+                                {
+                                    LogError("STRING_construct failed");
+                                    STRING_delete(config->mainPath);
+                                    free(config);
+                                    //Codes_SRS_NODE_MODULE_LOADER_13_013: [ NodeModuleLoader_ParseEntrypointFromJson shall return NULL if an underlying platform call fails. ]
+                                    config = NULL;
+                                }
+                                else
+                                {
+                                    /**
+                                     * Everything's good.
+                                     */
+                                }
+                            }
                         }
                     }
                     else
@@ -264,6 +296,10 @@ static void NodeModuleLoader_FreeEntrypoint(const MODULE_LOADER* loader, void* e
         NODE_LOADER_ENTRYPOINT* ep = (NODE_LOADER_ENTRYPOINT*)entrypoint;
         //Codes_SRS_NODE_MODULE_LOADER_13_017: [NodeModuleLoader_FreeEntrypoint shall free resources allocated during NodeModuleLoader_ParseEntrypointFromJson.]
         STRING_delete(ep->mainPath);
+        if (ep->codeCachePath != NULL)
+        {
+            STRING_delete(ep->codeCachePath);
+        }
         free(ep);
     }
     else
@@ -382,9 +418,26 @@ static void* NodeModuleLoader_BuildModuleConfiguration(
                     }
                     else
                     {
-                        /**
-                         * Everything's good.
-                         */
+                        //Codes_SRS_NODE_MODULE_LOADER_26_004: [ NodeModuleLoader_BuildModuleConfiguration shall copy isolate and, when it is not NULL, clone codeCachePath from entrypoint. ]
+                        result->isolate = node_entrypoint->isolate;
+                        result->code_cache_path = (node_entrypoint->codeCachePath == NULL) ? NULL :
+                            STRING_clone(node_entrypoint->codeCachePath);
+
+                        if (node_entrypoint->codeCachePath != NULL && result->code_cache_path == NULL)
+                        {
+                            LogError("STRING_clone for codeCachePath failed.");
+                            STRING_delete(result->configuration_json);
+                            STRING_delete(result->main_path);
+                            free(result);
+                            //Codes_SRS_NODE_MODULE_LOADER_13_025: [ NodeModuleLoader_BuildModuleConfiguration shall return NULL if an underlying platform call fails. ]
+                            result = NULL;
+                        }
+                        else
+                        {
+                            /**
+                             * Everything's good.
+                             */
+                        }
                     }
                 }
             }
@@ -410,6 +463,10 @@ static void NodeModuleLoader_FreeModuleConfiguration(const MODULE_LOADER* loader
         //Codes_SRS_NODE_MODULE_LOADER_13_028: [ NodeModuleLoader_FreeModuleConfiguration shall free the NODEJS_MODULE_CONFIG object. ]
         STRING_delete(config->main_path);
         STRING_delete(config->configuration_json);
+        if (config->code_cache_path != NULL)
+        {
+            STRING_delete(config->code_cache_path);
+        }
         free(config);
     }
 }
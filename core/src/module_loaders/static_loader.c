@@ -0,0 +1,344 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include <string.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "parson.h"
+
+#include "module.h"
+#include "module_access.h"
+#include "module_loader.h"
+#include "module_loaders/static_loader.h"
+
+typedef struct STATIC_MODULE_HANDLE_DATA_TAG
+{
+    const MODULE_API* api;
+}STATIC_MODULE_HANDLE_DATA;
+
+static struct
+{
+    const STATIC_LOADER_MODULE* modules;
+    size_t count;
+} g_static_modules = { NULL, 0 };
+
+static pfModule_GetApi find_static_module(const char* name)
+{
+    pfModule_GetApi result = NULL;
+    size_t i;
+    for (i = 0; i < g_static_modules.count; i++)
+    {
+        if (g_static_modules.modules[i].name != NULL &&
+            strcmp(g_static_modules.modules[i].name, name) == 0)
+        {
+            result = g_static_modules.modules[i].getApi;
+            break;
+        }
+    }
+    return result;
+}
+
+int StaticLoader_SetRegistry(const STATIC_LOADER_MODULE* modules, size_t count)
+{
+    int result;
+    if (modules == NULL && count != 0)
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_26_001: [ StaticLoader_SetRegistry shall fail and return a non-zero value if modules is NULL and count is not 0. ]
+        LogError("invalid input - modules = NULL, count = %zu", count);
+        result = __LINE__;
+    }
+    else
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_26_002: [ StaticLoader_SetRegistry shall replace the registry with modules and return 0. ]
+        g_static_modules.modules = modules;
+        g_static_modules.count = count;
+        result = 0;
+    }
+    return result;
+}
+
+static MODULE_LIBRARY_HANDLE StaticModuleLoader_Load(const MODULE_LOADER* loader, const void* entrypoint)
+{
+    STATIC_MODULE_HANDLE_DATA* result;
+
+    if (loader == NULL || entrypoint == NULL)
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_26_003: [ StaticModuleLoader_Load shall return NULL if loader is NULL. ]
+        //Codes_SRS_STATIC_MODULE_LOADER_26_004: [ StaticModuleLoader_Load shall return NULL if entrypoint is NULL. ]
+        result = NULL;
+        LogError(
+            "invalid input - loader = %p, entrypoint = %p",
+            loader, entrypoint
+        );
+    }
+    else if (loader->type != STATIC)
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_26_005: [ StaticModuleLoader_Load shall return NULL if loader->type is not STATIC. ]
+        result = NULL;
+        LogError("loader->type is not STATIC");
+    }
+    else
+    {
+        const STATIC_LOADER_ENTRYPOINT* static_loader_entrypoint = (const STATIC_LOADER_ENTRYPOINT*)entrypoint;
+        if (static_loader_entrypoint->moduleName == NULL)
+        {
+            //Codes_SRS_STATIC_MODULE_LOADER_26_006: [ StaticModuleLoader_Load shall return NULL if entrypoint->moduleName is NULL. ]
+            result = NULL;
+            LogError("moduleName is NULL");
+        }
+        else
+        {
+            const char* module_name = STRING_c_str(static_loader_entrypoint->moduleName);
+
+            //Codes_SRS_STATIC_MODULE_LOADER_26_007: [ StaticModuleLoader_Load shall look up entrypoint->moduleName in the registry set by StaticLoader_SetRegistry. ]
+            pfModule_GetApi pfnGetAPI = find_static_module(module_name);
+            if (pfnGetAPI == NULL)
+            {
+                //Codes_SRS_STATIC_MODULE_LOADER_26_008: [ StaticModuleLoader_Load shall return NULL if the module is not in the registry. ]
+                result = NULL;
+                LogError("module %s is not in the static module registry", module_name);
+            }
+            else
+            {
+                result = (STATIC_MODULE_HANDLE_DATA*)malloc(sizeof(STATIC_MODULE_HANDLE_DATA));
+                if (result == NULL)
+                {
+                    //Codes_SRS_STATIC_MODULE_LOADER_26_009: [ StaticModuleLoader_Load shall return NULL if an underlying platform call fails. ]
+                    LogError("malloc(sizeof(STATIC_MODULE_HANDLE_DATA)) failed");
+                }
+                else
+                {
+                    //Codes_SRS_STATIC_MODULE_LOADER_26_010: [ StaticModuleLoader_Load shall call the module's MODULE_STATIC_GETAPI function to acquire the module API table. ]
+                    result->api = pfnGetAPI(Module_ApiGatewayVersion);
+
+                    /* if any of the required functions is NULL then we have a misbehaving module */
+                    if (result->api == NULL ||
+                        result->api->version > Module_ApiGatewayVersion ||
+                        MODULE_CREATE(result->api) == NULL ||
+                        MODULE_DESTROY(result->api) == NULL ||
+                        MODULE_RECEIVE(result->api) == NULL)
+                    {
+                        //Codes_SRS_STATIC_MODULE_LOADER_26_011: [ StaticModuleLoader_Load shall return NULL if the MODULE_API pointer returned by the module is NULL, its version is greater than Module_ApiGatewayVersion, or Module_Create, Module_Destroy or Module_Receive is NULL. ]
+                        free(result);
+                        result = NULL;
+                        LogError("MODULE_STATIC_GETAPI for module %s returned an invalid MODULE_API", module_name);
+                    }
+                }
+            }
+        }
+    }
+
+    //Codes_SRS_STATIC_MODULE_LOADER_26_012: [ StaticModuleLoader_Load shall return a non-NULL pointer of type MODULE_LIBRARY_HANDLE when successful. ]
+    return result;
+}
+
+static const MODULE_API* StaticModuleLoader_GetModuleApi(const MODULE_LOADER* loader, MODULE_LIBRARY_HANDLE moduleLibraryHandle)
+{
+    (void)loader;
+
+    const MODULE_API* result;
+
+    if (moduleLibraryHandle == NULL)
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_26_013: [ StaticModuleLoader_GetModuleApi shall return NULL if moduleLibraryHandle is NULL. ]
+        result = NULL;
+        LogError("moduleLibraryHandle is NULL");
+    }
+    else
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_26_014: [ StaticModuleLoader_GetModuleApi shall return a valid pointer to MODULE_API on success. ]
+        STATIC_MODULE_HANDLE_DATA* loader_data = moduleLibraryHandle;
+        result = loader_data->api;
+    }
+
+    return result;
+}
+
+static void StaticModuleLoader_Unload(const MODULE_LOADER* loader, MODULE_LIBRARY_HANDLE moduleLibraryHandle)
+{
+    (void)loader;
+
+    if (moduleLibraryHandle != NULL)
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_26_015: [ StaticModuleLoader_Unload shall deallocate memory for the structure MODULE_LIBRARY_HANDLE. ]
+        free(moduleLibraryHandle);
+    }
+    else
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_26_016: [ StaticModuleLoader_Unload shall do nothing if moduleLibraryHandle is NULL. ]
+        LogError("moduleLibraryHandle is NULL");
+    }
+}
+
+static void* StaticModuleLoader_ParseEntrypointFromJson(const MODULE_LOADER* loader, const JSON_Value* json)
+{
+    (void)loader;
+    // The input is a JSON object that looks like this:
+    //  "entrypoint": {
+    //      "module.name": "logger"
+    //  }
+    STATIC_LOADER_ENTRYPOINT* config;
+    if (json == NULL)
+    {
+        LogError("json is NULL");
+
+        //Codes_SRS_STATIC_MODULE_LOADER_26_017: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if json is NULL. ]
+        config = NULL;
+    }
+    else if (json_value_get_type(json) != JSONObject)
+    {
+        LogError("'json' is not an object value");
+
+        //Codes_SRS_STATIC_MODULE_LOADER_26_018: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if the root json entity is not an object. ]
+        config = NULL;
+    }
+    else
+    {
+        JSON_Object* entrypoint = json_value_get_object(json);
+        if (entrypoint == NULL)
+        {
+            LogError("json_value_get_object failed");
+
+            //Codes_SRS_STATIC_MODULE_LOADER_26_019: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if an underlying platform call fails. ]
+            config = NULL;
+        }
+        else
+        {
+            //Codes_SRS_STATIC_MODULE_LOADER_26_020: [ StaticModuleLoader_ParseEntrypointFromJson shall retrieve the name of the module by reading the value of the attribute module.name. ]
+            const char* moduleName = json_object_get_string(entrypoint, "module.name");
+            if (moduleName == NULL)
+            {
+                LogError("json_object_get_string for 'module.name' returned NULL");
+
+                //Codes_SRS_STATIC_MODULE_LOADER_26_021: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if module.name does not exist. ]
+                config = NULL;
+            }
+            else
+            {
+                config = (STATIC_LOADER_ENTRYPOINT*)malloc(sizeof(STATIC_LOADER_ENTRYPOINT));
+                if (config == NULL)
+                {
+                    //Codes_SRS_STATIC_MODULE_LOADER_26_019: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if an underlying platform call fails. ]
+                    LogError("malloc failed");
+                }
+                else
+                {
+                    config->moduleName = STRING_construct(moduleName);
+                    if (config->moduleName == NULL)
+                    {
+                        LogError("STRING_construct failed");
+                        free(config);
+
+                        //Codes_SRS_STATIC_MODULE_LOADER_26_019: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if an underlying platform call fails. ]
+                        config = NULL;
+                    }
+                }
+            }
+        }
+    }
+
+    //Codes_SRS_STATIC_MODULE_LOADER_26_022: [ StaticModuleLoader_ParseEntrypointFromJson shall return a non-NULL pointer to the parsed representation of the entrypoint when successful. ]
+    return (void*)config;
+}
+
+static void StaticModuleLoader_FreeEntrypoint(const MODULE_LOADER* loader, void* entrypoint)
+{
+    (void)loader;
+
+    if (entrypoint != NULL)
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_26_023: [ StaticModuleLoader_FreeEntrypoint shall free resources allocated during StaticModuleLoader_ParseEntrypointFromJson. ]
+        STATIC_LOADER_ENTRYPOINT* ep = (STATIC_LOADER_ENTRYPOINT*)entrypoint;
+        STRING_delete(ep->moduleName);
+        free(ep);
+    }
+    else
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_26_024: [ StaticModuleLoader_FreeEntrypoint shall do nothing if entrypoint is NULL. ]
+        LogError("entrypoint is NULL");
+    }
+}
+
+static MODULE_LOADER_BASE_CONFIGURATION* StaticModuleLoader_ParseConfigurationFromJson(const MODULE_LOADER* loader, const JSON_Value* json)
+{
+    (void)loader;
+    (void)json;
+
+    /**
+     * The static loader does not have any configuration so we always return NULL.
+     */
+    //Codes_SRS_STATIC_MODULE_LOADER_26_025: [ StaticModuleLoader_ParseConfigurationFromJson shall return NULL. ]
+    return NULL;
+}
+
+static void StaticModuleLoader_FreeConfiguration(const MODULE_LOADER* loader, MODULE_LOADER_BASE_CONFIGURATION* configuration)
+{
+    (void)loader;
+    (void)configuration;
+
+    /**
+     * Nothing to free.
+     */
+    //Codes_SRS_STATIC_MODULE_LOADER_26_026: [ StaticModuleLoader_FreeConfiguration shall do nothing. ]
+}
+
+static void* StaticModuleLoader_BuildModuleConfiguration(
+    const MODULE_LOADER* loader,
+    const void* entrypoint,
+    const void* module_configuration
+)
+{
+    (void)loader;
+    (void)entrypoint;
+
+    /**
+     * Statically linked modules are native modules, so the module
+     * configuration is passed through as is.
+     */
+    //Codes_SRS_STATIC_MODULE_LOADER_26_027: [ StaticModuleLoader_BuildModuleConfiguration shall return module_configuration. ]
+    return (void *)module_configuration;
+}
+
+static void StaticModuleLoader_FreeModuleConfiguration(const MODULE_LOADER* loader, const void* module_configuration)
+{
+    (void)loader;
+    (void)module_configuration;
+
+    /**
+     * Nothing to free.
+     */
+    //Codes_SRS_STATIC_MODULE_LOADER_26_028: [ StaticModuleLoader_FreeModuleConfiguration shall do nothing. ]
+}
+
+static MODULE_LOADER_API Static_Module_Loader_API =
+{
+    .Load = StaticModuleLoader_Load,
+    .Unload = StaticModuleLoader_Unload,
+    .GetApi = StaticModuleLoader_GetModuleApi,
+
+    .ParseEntrypointFromJson = StaticModuleLoader_ParseEntrypointFromJson,
+    .FreeEntrypoint = StaticModuleLoader_FreeEntrypoint,
+
+    .ParseConfigurationFromJson = StaticModuleLoader_ParseConfigurationFromJson,
+    .FreeConfiguration = StaticModuleLoader_FreeConfiguration,
+
+    .BuildModuleConfiguration = StaticModuleLoader_BuildModuleConfiguration,
+    .FreeModuleConfiguration = StaticModuleLoader_FreeModuleConfiguration
+};
+
+static MODULE_LOADER Static_Module_Loader =
+{
+    STATIC,
+    STATIC_LOADER_NAME,
+    NULL,
+    &Static_Module_Loader_API
+};
+
+const MODULE_LOADER* StaticLoader_Get(void)
+{
+    //Codes_SRS_STATIC_MODULE_LOADER_26_029: [ StaticLoader_Get shall return a non-NULL pointer to a MODULE_LOADER struct. ]
+    //Codes_SRS_STATIC_MODULE_LOADER_26_030: [ MODULE_LOADER::type shall be STATIC. ]
+    //Codes_SRS_STATIC_MODULE_LOADER_26_031: [ MODULE_LOADER::name shall be the string static. ]
+    return &Static_Module_Loader;
+}
@@ -0,0 +1,527 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdbool>
+#else
+#include <stdlib.h>
+#include <stdbool.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "azure_c_shared_utility/macro_utils.h"
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#define ENABLE_MOCKS
+#define GATEWAY_EXPORT_H
+#define GATEWAY_EXPORT
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/map.h"
+#include "message.h"
+#include "module.h"
+
+MOCKABLE_FUNCTION(, void, mock_Module_Receive, MODULE_HANDLE, moduleHandle, MESSAGE_HANDLE, messageHandle);
+#undef ENABLE_MOCKS
+
+#include "broker.h"
+
+#define TEST_MAP ((MAP_HANDLE)0x11)
+#define TEST_MESSAGE ((MESSAGE_HANDLE)0x21)
+#define TEST_DERIVED_MESSAGE ((MESSAGE_HANDLE)0x22)
+#define TEST_REPLY ((MESSAGE_HANDLE)0x23)
+#define TEST_SOURCE ((MODULE_HANDLE)0x31)
+#define TEST_SINK ((MODULE_HANDLE)0x32)
+#define TEST_OTHER_SINK ((MODULE_HANDLE)0x33)
+#define TEST_REPLACEMENT ((MODULE_HANDLE)0x34)
+
+static MODULE_API_1 test_module_apis =
+{
+    { MODULE_API_VERSION_1 },
+
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    mock_Module_Receive,
+    NULL
+};
+
+static MODULE test_source = { (const MODULE_API*)&test_module_apis, TEST_SOURCE };
+static MODULE test_sink = { (const MODULE_API*)&test_module_apis, TEST_SINK };
+static MODULE test_other_sink = { (const MODULE_API*)&test_module_apis, TEST_OTHER_SINK };
+static MODULE test_replacement = { (const MODULE_API*)&test_module_apis, TEST_REPLACEMENT };
+
+/*the broker the replying sink answers through*/
+static BROKER_HANDLE g_reply_broker;
+static BROKER_RESULT g_reply_result;
+
+static void replying_Module_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    (void)moduleHandle;
+    g_reply_result = Broker_Reply(g_reply_broker, messageHandle, TEST_REPLY);
+}
+
+static size_t g_reply_callback_count;
+static BROKER_REQUEST_RESULT g_reply_callback_result;
+static MESSAGE_HANDLE g_reply_callback_message;
+
+static void test_reply_callback(void* context, BROKER_REQUEST_RESULT result, MESSAGE_HANDLE reply)
+{
+    (void)context;
+    g_reply_callback_count++;
+    g_reply_callback_result = result;
+    g_reply_callback_message = reply;
+}
+
+static BROKER_HANDLE create_broker_with_modules(void)
+{
+    BROKER_HANDLE broker = Broker_Create();
+    (void)Broker_AddModule(broker, &test_source);
+    (void)Broker_AddModule(broker, &test_sink);
+    (void)Broker_AddModule(broker, &test_other_sink);
+    return broker;
+}
+
+static void remove_modules_and_destroy(BROKER_HANDLE broker)
+{
+    (void)Broker_RemoveModule(broker, &test_other_sink);
+    (void)Broker_RemoveModule(broker, &test_sink);
+    (void)Broker_RemoveModule(broker, &test_source);
+    Broker_Destroy(broker);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+BEGIN_TEST_SUITE(broker_sync_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_stdint_register_types();
+    umocktypes_bool_register_types();
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Map_Create, TEST_MAP);
+    REGISTER_GLOBAL_MOCK_RETURN(Map_AddOrUpdate, MAP_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Message_Derive, TEST_DERIVED_MESSAGE);
+    REGISTER_GLOBAL_MOCK_RETURN(Message_GetProperty, "1");
+
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_FILTER_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const MESSAGE_DERIVE_CONFIG*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MODULE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    REGISTER_GLOBAL_MOCK_HOOK(mock_Module_Receive, NULL);
+    g_reply_broker = NULL;
+    g_reply_result = BROKER_ERROR;
+    g_reply_callback_count = 0;
+    g_reply_callback_result = BROKER_REQUEST_ERROR;
+    g_reply_callback_message = NULL;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_BROKER_SYNC_26_001: [ `Broker_Create` shall return `NULL` if it cannot allocate the broker, or a broker with no modules and no links otherwise. ]*/
+TEST_FUNCTION(Broker_Create_returns_NULL_when_malloc_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    ///act
+    BROKER_HANDLE broker = Broker_Create();
+
+    ///assert
+    ASSERT_IS_NULL(broker);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_BROKER_SYNC_26_002: [ If `broker`, `source`, or `message` is `NULL` the function shall return `BROKER_INVALIDARG`. ]*/
+TEST_FUNCTION(Broker_Publish_with_NULL_message_fails)
+{
+    ///arrange
+    BROKER_HANDLE broker = create_broker_with_modules();
+    umock_c_reset_all_calls();
+
+    ///act
+    BROKER_RESULT result = Broker_Publish(broker, TEST_SOURCE, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, BROKER_INVALIDARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    remove_modules_and_destroy(broker);
+}
+
+/*Tests_SRS_BROKER_SYNC_26_003: [ `Broker_Publish` shall call `Module_Receive` of every module linked from `source` with `message`, on the calling thread, in the order the links were added, and return `BROKER_OK` once every call has returned. ]*/
+TEST_FUNCTION(Broker_Publish_calls_linked_sinks_in_link_order)
+{
+    ///arrange
+    BROKER_HANDLE broker = create_broker_with_modules();
+    BROKER_LINK_DATA other_link = { TEST_SOURCE, TEST_OTHER_SINK };
+    BROKER_LINK_DATA link = { TEST_SOURCE, TEST_SINK };
+    (void)Broker_AddLink(broker, &other_link);
+    (void)Broker_AddLink(broker, &link);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(mock_Module_Receive(TEST_OTHER_SINK, TEST_MESSAGE));
+    STRICT_EXPECTED_CALL(mock_Module_Receive(TEST_SINK, TEST_MESSAGE));
+
+    ///act
+    BROKER_RESULT result = Broker_Publish(broker, TEST_SOURCE, TEST_MESSAGE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    remove_modules_and_destroy(broker);
+}
+
+/*Tests_SRS_BROKER_SYNC_26_015: [ `Broker_PublishBatch` shall return `BROKER_INVALIDARG` without publishing if any of the `count` messages is NULL, and call `Broker_Publish` with each of them in order otherwise. ]*/
+TEST_FUNCTION(Broker_PublishBatch_publishes_each_message_in_order)
+{
+    ///arrange
+    BROKER_HANDLE broker = create_broker_with_modules();
+    BROKER_LINK_DATA link = { TEST_SOURCE, TEST_SINK };
+    MESSAGE_HANDLE messages[] = { TEST_MESSAGE, TEST_DERIVED_MESSAGE };
+    MESSAGE_HANDLE bad_messages[] = { TEST_MESSAGE, NULL };
+    (void)Broker_AddLink(broker, &link);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(mock_Module_Receive(TEST_SINK, TEST_MESSAGE));
+    STRICT_EXPECTED_CALL(mock_Module_Receive(TEST_SINK, TEST_DERIVED_MESSAGE));
+
+    ///act
+    BROKER_RESULT result = Broker_PublishBatch(broker, TEST_SOURCE, messages, 2);
+    BROKER_RESULT bad_result = Broker_PublishBatch(broker, TEST_SOURCE, bad_messages, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(int, BROKER_INVALIDARG, bad_result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    remove_modules_and_destroy(broker);
+}
+
+/*Tests_SRS_BROKER_SYNC_26_013: [ `Broker_AddFusedLink` shall add `link` as `Broker_AddLink` does, since every link already delivers on the publishing thread. ]*/
+TEST_FUNCTION(Broker_AddFusedLink_delivers_like_a_link)
+{
+    ///arrange
+    BROKER_HANDLE broker = create_broker_with_modules();
+    BROKER_LINK_DATA link = { TEST_SOURCE, TEST_SINK };
+    BROKER_RESULT add_result = Broker_AddFusedLink(broker, &link);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(mock_Module_Receive(TEST_SINK, TEST_MESSAGE));
+
+    ///act
+    BROKER_RESULT result = Broker_Publish(broker, TEST_SOURCE, TEST_MESSAGE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, BROKER_OK, add_result);
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    remove_modules_and_destroy(broker);
+}
+
+/*Tests_SRS_BROKER_SYNC_26_004: [ `Broker_Publish` shall add the time each `Module_Receive` call took to the receiving module's latency histogram. ]*/
+/*Tests_SRS_BROKER_SYNC_26_006: [ `Broker_GetLatencyHistogram` shall copy the histogram of the time spent in `module`'s `Module_Receive` into `histogram`, or return `BROKER_ERROR` if `module` is not attached. ]*/
+TEST_FUNCTION(Broker_Publish_records_receive_time_per_sink)
+{
+    ///arrange
+    BROKER_HANDLE broker = create_broker_with_modules();
+    BROKER_LINK_DATA link = { TEST_SOURCE, TEST_SINK };
+    BROKER_LATENCY_HISTOGRAM sink_histogram;
+    BROKER_LATENCY_HISTOGRAM other_histogram;
+    (void)Broker_AddLink(broker, &link);
+    (void)Broker_Publish(broker, TEST_SOURCE, TEST_MESSAGE);
+    (void)Broker_Publish(broker, TEST_SOURCE, TEST_MESSAGE);
+    umock_c_reset_all_calls();
+
+    ///act
+    BROKER_RESULT sink_result = Broker_GetLatencyHistogram(broker, &test_sink, &sink_histogram);
+    BROKER_RESULT other_result = Broker_GetLatencyHistogram(broker, &test_other_sink, &other_histogram);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, BROKER_OK, sink_result);
+    ASSERT_ARE_EQUAL(int, BROKER_OK, other_result);
+    ASSERT_ARE_EQUAL(uint64_t, 2, sink_histogram.count);
+    ASSERT_ARE_EQUAL(uint64_t, 0, other_histogram.count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    remove_modules_and_destroy(broker);
+}
+
+/*Tests_SRS_BROKER_SYNC_26_007: [ `Broker_RemoveModule` shall detach `module` and remove every link into it. ]*/
+TEST_FUNCTION(Broker_RemoveModule_removes_links_into_the_module)
+{
+    ///arrange
+    BROKER_HANDLE broker = create_broker_with_modules();
+    BROKER_LINK_DATA link = { TEST_SOURCE, TEST_SINK };
+    BROKER_LINK_DATA other_link = { TEST_SOURCE, TEST_OTHER_SINK };
+    (void)Broker_AddLink(broker, &link);
+    (void)Broker_AddLink(broker, &other_link);
+    (void)Broker_RemoveModule(broker, &test_sink);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(mock_Module_Receive(TEST_OTHER_SINK, TEST_MESSAGE));
+
+    ///act
+    BROKER_RESULT result = Broker_Publish(broker, TEST_SOURCE, TEST_MESSAGE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    remove_modules_and_destroy(broker);
+}
+
+/*Tests_SRS_BROKER_SYNC_26_016: [ `Broker_AddReplacementModule` shall return `BROKER_ERROR` if `replaced` is not attached or another module is replacing it, and otherwise attach `module` as `Broker_AddModule` does. ]*/
+/*Tests_SRS_BROKER_SYNC_26_017: [ `Broker_Publish` shall not deliver to a module added with `Broker_AddReplacementModule` until the module it replaces is removed. ]*/
+/*Tests_SRS_BROKER_SYNC_26_018: [ If another module is replacing `module`, `Broker_RemoveModule` shall also remove every link from `module`, and deliver to the replacing module from then on. ]*/
+TEST_FUNCTION(Broker_AddReplacementModule_takes_over_when_replaced_module_is_removed)
+{
+    ///arrange
+    BROKER_HANDLE broker = create_broker_with_modules();
+    BROKER_LINK_DATA link = { TEST_SOURCE, TEST_SINK };
+    BROKER_LINK_DATA replacement_link = { TEST_SOURCE, TEST_REPLACEMENT };
+    (void)Broker_AddLink(broker, &link);
+    ASSERT_ARE_EQUAL(int, BROKER_OK, Broker_AddReplacementModule(broker, &test_replacement, NULL, &test_sink));
+    (void)Broker_AddLink(broker, &replacement_link);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(mock_Module_Receive(TEST_SINK, TEST_MESSAGE));
+    STRICT_EXPECTED_CALL(mock_Module_Receive(TEST_REPLACEMENT, TEST_MESSAGE));
+
+    ///act
+    BROKER_RESULT before = Broker_Publish(broker, TEST_SOURCE, TEST_MESSAGE);
+    (void)Broker_RemoveModule(broker, &test_sink);
+    BROKER_RESULT after = Broker_Publish(broker, TEST_SOURCE, TEST_MESSAGE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, BROKER_OK, before);
+    ASSERT_ARE_EQUAL(int, BROKER_OK, after);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    (void)Broker_RemoveModule(broker, &test_replacement);
+    remove_modules_and_destroy(broker);
+}
+
+/*Tests_SRS_BROKER_SYNC_26_018: [ If another module is replacing `module`, `Broker_RemoveModule` shall also remove every link from `module`, and deliver to the replacing module from then on. ]*/
+TEST_FUNCTION(Broker_RemoveModule_of_replaced_module_removes_links_from_it)
+{
+    ///arrange
+    BROKER_HANDLE broker = create_broker_with_modules();
+    BROKER_LINK_DATA link = { TEST_SINK, TEST_OTHER_SINK };
+    (void)Broker_AddLink(broker, &link);
+    (void)Broker_AddReplacementModule(broker, &test_replacement, NULL, &test_sink);
+    (void)Broker_RemoveModule(broker, &test_sink);
+    umock_c_reset_all_calls();
+
+    ///act
+    BROKER_RESULT result = Broker_Publish(broker, TEST_SINK, TEST_MESSAGE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    (void)Broker_RemoveModule(broker, &test_replacement);
+    remove_modules_and_destroy(broker);
+}
+
+/*Tests_SRS_BROKER_SYNC_26_016: [ `Broker_AddReplacementModule` shall return `BROKER_ERROR` if `replaced` is not attached or another module is replacing it, and otherwise attach `module` as `Broker_AddModule` does. ]*/
+TEST_FUNCTION(Broker_AddReplacementModule_fails_when_replaced_is_not_attached)
+{
+    ///arrange
+    BROKER_HANDLE broker = create_broker_with_modules();
+    MODULE not_attached = { (const MODULE_API*)&test_module_apis, (MODULE_HANDLE)0x99 };
+    umock_c_reset_all_calls();
+
+    ///act
+    BROKER_RESULT result = Broker_AddReplacementModule(broker, &test_replacement, NULL, &not_attached);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, BROKER_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    remove_modules_and_destroy(broker);
+}
+
+/*Tests_SRS_BROKER_SYNC_26_008: [ `Broker_AddLink` shall return `BROKER_ADD_LINK_ERROR` if the source or the sink of `link` is not attached to the broker. ]*/
+TEST_FUNCTION(Broker_AddLink_fails_when_sink_is_not_attached)
+{
+    ///arrange
+    BROKER_HANDLE broker = create_broker_with_modules();
+    BROKER_LINK_DATA link = { TEST_SOURCE, (MODULE_HANDLE)0x99 };
+    umock_c_reset_all_calls();
+
+    ///act
+    BROKER_RESULT result = Broker_AddLink(broker, &link);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, BROKER_ADD_LINK_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    remove_modules_and_destroy(broker);
+}
+
+/*Tests_SRS_BROKER_SYNC_26_009: [ `Broker_Request` shall derive a message from `message` with a new `correlationId` property and call `target`'s `Module_Receive` with it on the calling thread. ]*/
+/*Tests_SRS_BROKER_SYNC_26_010: [ If `target` has not replied when its `Module_Receive` returns, `Broker_Request` shall call `callback` with `BROKER_REQUEST_TIMEOUT` before returning, without waiting for `timeout_ms`. ]*/
+TEST_FUNCTION(Broker_Request_without_reply_times_out_before_returning)
+{
+    ///arrange
+    BROKER_HANDLE broker = create_broker_with_modules();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Create(NULL));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP, BROKER_CORRELATION_ID_PROPERTY, "1"));
+    STRICT_EXPECTED_CALL(Message_Derive(TEST_MESSAGE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP));
+    STRICT_EXPECTED_CALL(mock_Module_Receive(TEST_SINK, TEST_DERIVED_MESSAGE));
+    STRICT_EXPECTED_CALL(Message_Destroy(TEST_DERIVED_MESSAGE));
+
+    ///act
+    BROKER_RESULT result = Broker_Request(broker, TEST_SOURCE, TEST_SINK, TEST_MESSAGE, 1000, test_reply_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_reply_callback_count);
+    ASSERT_ARE_EQUAL(int, BROKER_REQUEST_TIMEOUT, g_reply_callback_result);
+    ASSERT_IS_NULL(g_reply_callback_message);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    remove_modules_and_destroy(broker);
+}
+
+/*Tests_SRS_BROKER_SYNC_26_011: [ `Broker_Reply` shall call the callback of the request being delivered whose `correlationId` matches `request`'s with `BROKER_REQUEST_REPLIED` and `reply` before returning. ]*/
+TEST_FUNCTION(Broker_Reply_from_Module_Receive_completes_the_request)
+{
+    ///arrange
+    BROKER_HANDLE broker = create_broker_with_modules();
+    g_reply_broker = broker;
+    REGISTER_GLOBAL_MOCK_HOOK(mock_Module_Receive, replying_Module_Receive);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Create(NULL));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP, BROKER_CORRELATION_ID_PROPERTY, "1"));
+    STRICT_EXPECTED_CALL(Message_Derive(TEST_MESSAGE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP));
+    STRICT_EXPECTED_CALL(mock_Module_Receive(TEST_SINK, TEST_DERIVED_MESSAGE));
+    STRICT_EXPECTED_CALL(Message_GetProperty(TEST_DERIVED_MESSAGE, BROKER_CORRELATION_ID_PROPERTY));
+    STRICT_EXPECTED_CALL(Message_Destroy(TEST_DERIVED_MESSAGE));
+
+    ///act
+    BROKER_RESULT result = Broker_Request(broker, TEST_SOURCE, TEST_SINK, TEST_MESSAGE, 1000, test_reply_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(int, BROKER_OK, g_reply_result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_reply_callback_count);
+    ASSERT_ARE_EQUAL(int, BROKER_REQUEST_REPLIED, g_reply_callback_result);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_REPLY, g_reply_callback_message);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    remove_modules_and_destroy(broker);
+}
+
+/*Tests_SRS_BROKER_SYNC_26_012: [ `Broker_Reply` shall return `BROKER_ERROR` if no request being delivered matches or the request was already replied to. ]*/
+TEST_FUNCTION(Broker_Reply_fails_when_no_request_is_pending)
+{
+    ///arrange
+    BROKER_HANDLE broker = create_broker_with_modules();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Message_GetProperty(TEST_MESSAGE, BROKER_CORRELATION_ID_PROPERTY));
+
+    ///act
+    BROKER_RESULT result = Broker_Reply(broker, TEST_MESSAGE, TEST_REPLY);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, BROKER_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 0, g_reply_callback_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    remove_modules_and_destroy(broker);
+}
+
+END_TEST_SUITE(broker_sync_ut)
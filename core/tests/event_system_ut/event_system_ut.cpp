@@ -11,12 +11,12 @@
 #include "micromock.h"
 #include "micromockcharstararenullterminatedstrings.h"
 #include "azure_c_shared_utility/lock.h"
-#include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/vector_types_internal.h"
 
+#include "gateway_timer.h"
 #include "experimental/event_system.h"
 
 #define GBALLOC_H
@@ -51,13 +51,16 @@ static std::vector<GATEWAY_HANDLE> *callback_gw_history;
 static int callback_per_event_count[GATEWAY_EVENTS_COUNT];
 static int helper_counter;
 
-static THREAD_START_FUNC last_thread_func;
-static void* last_thread_arg;
-static int last_thread_result;
+static GATEWAY_TIMER_CALLBACK last_timer_callback;
+static void* last_timer_context;
 
 static void* last_context;
 static void* last_user_param;
 
+static int timer_cancel_count;
+static int timer_deinit_count;
+static EVENTSYSTEM_HANDLE reporting_event_system;
+
 static VECTOR_HANDLE module_list;
 
 struct ListNode
@@ -166,19 +169,20 @@ public:
     MOCK_METHOD_END(LOCK_RESULT, LOCK_OK);
 
 
-    MOCK_STATIC_METHOD_3(, THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg);
-        last_thread_func = func;
-        last_thread_arg = arg;
-        (*threadHandle) = (THREAD_HANDLE*)BASEIMPLEMENTATION::gballoc_malloc(1);
-    MOCK_METHOD_END(THREADAPI_RESULT, THREADAPI_OK);
+    MOCK_STATIC_METHOD_0(, int, GatewayTimer_Init);
+    MOCK_METHOD_END(int, 0);
+
+    MOCK_STATIC_METHOD_0(, void, GatewayTimer_Deinit);
+        timer_deinit_count++;
+    MOCK_VOID_METHOD_END();
 
-    MOCK_STATIC_METHOD_2(, THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res);
-        (*res) = last_thread_result;
-        BASEIMPLEMENTATION::gballoc_free(threadHandle);
-    MOCK_METHOD_END(THREADAPI_RESULT, THREADAPI_OK);
+    MOCK_STATIC_METHOD_4(, GATEWAY_TIMER_HANDLE, GatewayTimer_Schedule, unsigned int, delay_ms, unsigned int, period_ms, GATEWAY_TIMER_CALLBACK, callback, void*, context);
+        last_timer_callback = callback;
+        last_timer_context = context;
+    MOCK_METHOD_END(GATEWAY_TIMER_HANDLE, (GATEWAY_TIMER_HANDLE)0x43);
 
-    MOCK_STATIC_METHOD_1(, void, ThreadAPI_Exit, int, res)
-        last_thread_result = res;
+    MOCK_STATIC_METHOD_1(, void, GatewayTimer_Cancel, GATEWAY_TIMER_HANDLE, timer);
+        timer_cancel_count++;
     MOCK_VOID_METHOD_END();
 
 
@@ -189,6 +193,13 @@ public:
     MOCK_METHOD_END(COND_RESULT, COND_OK);
 
     MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
+        // simulate the timer service running the scheduled drain while EventSystem_Destroy waits
+        if (last_timer_callback != NULL)
+        {
+            GATEWAY_TIMER_CALLBACK callback = last_timer_callback;
+            last_timer_callback = NULL;
+            (void)callback(last_timer_context);
+        }
     MOCK_METHOD_END(COND_RESULT, COND_OK);
 
     MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle);
@@ -230,9 +241,10 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , LOCK_RESULT, Lock, LOCK_HANDLE
 DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , LOCK_RESULT, Unlock, LOCK_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle)
 
-DECLARE_GLOBAL_MOCK_METHOD_3(CEventSystemMocks, , THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg);
-DECLARE_GLOBAL_MOCK_METHOD_2(CEventSystemMocks, , THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res);
-DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , void, ThreadAPI_Exit, int, res)
+DECLARE_GLOBAL_MOCK_METHOD_0(CEventSystemMocks, , int, GatewayTimer_Init);
+DECLARE_GLOBAL_MOCK_METHOD_0(CEventSystemMocks, , void, GatewayTimer_Deinit);
+DECLARE_GLOBAL_MOCK_METHOD_4(CEventSystemMocks, , GATEWAY_TIMER_HANDLE, GatewayTimer_Schedule, unsigned int, delay_ms, unsigned int, period_ms, GATEWAY_TIMER_CALLBACK, callback, void*, context);
+DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , void, GatewayTimer_Cancel, GATEWAY_TIMER_HANDLE, timer);
 
 DECLARE_GLOBAL_MOCK_METHOD_0(CEventSystemMocks, , COND_HANDLE, Condition_Init);
 DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
@@ -242,14 +254,17 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , void, Condition_Deinit, COND_H
 DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , VECTOR_HANDLE, Gateway_GetModuleList, GATEWAY_HANDLE, gw);
 DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , void, Gateway_DestroyModuleList, VECTOR_HANDLE, vec);
 
-static void expectEventSystemDestroy(CEventSystemMocks &mocks, bool started_thread, int nodes_in_queue)
+static void expectEventSystemDestroy(CEventSystemMocks &mocks, bool scheduled_timer, int nodes_in_queue, bool started_timer_service = true)
 {
     EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)).ExpectedAtLeastTimes(2);
-    EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG)).ExpectedAtLeastTimes(2);
-    if (started_thread)
+    if (scheduled_timer)
     {
-        EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        EXPECTED_CALL(mocks, GatewayTimer_Cancel(IGNORED_PTR_ARG));
+    }
+    if (started_timer_service)
+    {
+        EXPECTED_CALL(mocks, GatewayTimer_Deinit());
     }
     EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
@@ -287,6 +302,15 @@ static void catch_context_callback(GATEWAY_HANDLE gw, GATEWAY_EVENT event_type,
     last_user_param = user_param;
 }
 
+/* reports what Gateway_RemoveModule reports when a callback removes a module */
+static void removing_module_callback(GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX ctx, void* user_param)
+{
+    (void)event_type;
+    (void)ctx;
+    (void)user_param;
+    EventSystem_ReportEvent(reporting_event_system, gw, GATEWAY_MODULE_LIST_CHANGED);
+}
+
 BEGIN_TEST_SUITE(event_system_ut)
 
 TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -318,11 +342,13 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     for (int i = 0; i < GATEWAY_EVENTS_COUNT; i++)
         callback_per_event_count[i] = 0;
     helper_counter = 0;
-    last_thread_result = THREADAPI_ERROR;
-    last_thread_arg = NULL;
-    last_thread_func = NULL;
+    last_timer_context = NULL;
+    last_timer_callback = NULL;
     module_list = NULL;
     last_context = NULL;
+    timer_cancel_count = 0;
+    timer_deinit_count = 0;
+    reporting_event_system = NULL;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -334,6 +360,7 @@ TEST_FUNCTION_CLEANUP(TestMethodCleanup)
 }
 
 /* Tests_SRS_EVENTSYSTEM_26_001: [ This function shall create EVENTSYSTEM_HANDLE representing the created event system. ] */
+/* Tests_SRS_EVENTSYSTEM_26_017: [ This function shall start the gateway timer service, on whose thread the callbacks are called. ] */
 TEST_FUNCTION(EventSystem_Init_Basic)
 {
     // Arrange
@@ -347,6 +374,7 @@ TEST_FUNCTION(EventSystem_Init_Basic)
     EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
         .ExpectedTimesExactly(GATEWAY_EVENTS_COUNT);
     EXPECTED_CALL(mocks, singlylinkedlist_create());
+    EXPECTED_CALL(mocks, GatewayTimer_Init());
 
     // Act
     EVENTSYSTEM_HANDLE event_system = EventSystem_Init();
@@ -389,7 +417,7 @@ TEST_FUNCTION(EventSystem_Init_Fail_Vector)
     EXPECTED_CALL(mocks, Condition_Init());
     EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
         .SetFailReturn((VECTOR_HANDLE)NULL);
-    expectEventSystemDestroy(mocks, false, 0);
+    expectEventSystemDestroy(mocks, false, 0, false);
 
     // Act
     EVENTSYSTEM_HANDLE event_system = EventSystem_Init();
@@ -483,7 +511,34 @@ TEST_FUNCTION(EventSystem_Init_Fail_List)
     EXPECTED_CALL(mocks, singlylinkedlist_create())
         .SetFailReturn((SINGLYLINKEDLIST_HANDLE)NULL);
 
-    expectEventSystemDestroy(mocks, false, 0);
+    expectEventSystemDestroy(mocks, false, 0, false);
+
+    // Act
+    EVENTSYSTEM_HANDLE event_system = EventSystem_Init();
+
+    // Assert
+    ASSERT_IS_NULL(event_system);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/* Tests_SRS_EVENTSYSTEM_26_002: [ This function shall return NULL upon any internal error during event system creation. ] */
+TEST_FUNCTION(EventSystem_Init_Fail_Timer_Service)
+{
+    // Arrange
+    CEventSystemMocks mocks;
+
+    // Expectations
+    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, Lock_Init())
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, Condition_Init());
+    EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+        .ExpectedTimesExactly(GATEWAY_EVENTS_COUNT);
+    EXPECTED_CALL(mocks, singlylinkedlist_create());
+    EXPECTED_CALL(mocks, GatewayTimer_Init())
+        .SetFailReturn(1);
+
+    expectEventSystemDestroy(mocks, false, 0, false);
 
     // Act
     EVENTSYSTEM_HANDLE event_system = EventSystem_Init();
@@ -529,7 +584,8 @@ TEST_FUNCTION(EventSystem_Destroy_Give_Null)
 
 
 /* Tests_SRS_EVENTSYSTEM_26_005: [ This function shall wait for all callbacks to finish before returning. ] */
-TEST_FUNCTION(EventSystem_Joins_Thread)
+/* Tests_SRS_EVENTSYSTEM_26_019: [ This function shall release the timer of the last drain and the gateway timer service. ] */
+TEST_FUNCTION(EventSystem_Destroy_Waits_For_Callbacks)
 {
     // Arrange
     CEventSystemMocks mocks;
@@ -540,18 +596,44 @@ TEST_FUNCTION(EventSystem_Joins_Thread)
     mocks.ResetAllCalls();
 
     // Expectations
-    // checks for threadapi_join
-    expectEventSystemDestroy(mocks, true, 1);
+    EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)).ExpectedAtLeastTimes(2);
+    EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG)).ExpectedAtLeastTimes(2);
+    // the drain runs while destroy waits
+    EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, GatewayTimer_Cancel(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, GatewayTimer_Deinit());
+    EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+
+    EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(3);
+    EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(1);
+    EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(1);
+
+    EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG));
+
+    EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(GATEWAY_EVENTS_COUNT + 1);
+    EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
 
     // Act
     EventSystem_Destroy(handle);
 
     // Assert
+    ASSERT_ARE_EQUAL(size_t, callback_gw_history->size(), 2);
     mocks.AssertActualAndExpectedCalls();
 }
 
-/* Tests_SRS_EVENTSYSTEM_26_003: [ This function shall destroy and free resources of the given event system. ] */
-TEST_FUNCTION(EventSystem_Destroy_Clears_Queue)
+/* Tests_SRS_EVENTSYSTEM_26_005: [ This function shall wait for all callbacks to finish before returning. ] */
+TEST_FUNCTION(EventSystem_Destroy_Drains_Queue)
 {
     // Arrange
     CEventSystemMocks mocks;
@@ -565,15 +647,47 @@ TEST_FUNCTION(EventSystem_Destroy_Clears_Queue)
     mocks.ResetAllCalls();
 
     // Expectations
-    expectEventSystemDestroy(mocks, true, 2);
+    EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)).ExpectedAtLeastTimes(2);
+    EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG)).ExpectedAtLeastTimes(2);
+    EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .ExpectedTimesExactly(3);
+    // both events share one drain
+    EXPECTED_CALL(mocks, GatewayTimer_Cancel(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, GatewayTimer_Deinit());
+    EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+
+    EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(4);
+    EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+
+    EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG));
+
+    EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(GATEWAY_EVENTS_COUNT + 2);
+    EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(3);
 
     // Act
     EventSystem_Destroy(handle);
+
+    // Assert
+    ASSERT_ARE_EQUAL(size_t, callback_gw_history->size(), 3);
+    mocks.AssertActualAndExpectedCalls();
 }
 
 /* Tests_SRS_EVENTSYSTEM_26_006: [ This function shall call all registered callbacks for the given GATEWAY_EVENT. ] */
 /* Tests_SRS_EVENTSYSTEM_26_007: [ This function shan't call any callbacks registered for any other GATEWAY_EVENT other than the one given as parameter. ] */
 /* Tests_SRS_EVENTSYSTEM_26_008: [ This function shall call all registered callbacks on a seperate thread. ] */
+/* Tests_SRS_EVENTSYSTEM_26_018: [ This function shall call the callbacks from a one-shot timer of the gateway timer service, scheduled when an event is queued and no drain of the queue is scheduled or running. ] */
 /* Tests_SRS_EVENTSYSTEM_26_010: [ The given GATEWAY_CALLBACK function shall be called with proper GATEWAY_HANDLE and GATEWAY_EVENT as function parameters coresponding to the gateway and the event that occured. ] */
 /* Tests_SRS_EVENTSYSTEM_26_011: [ This function shall register given GATEWAY_CALLBACK and call it when given GATEWAY_EVENT event happens inside of the gateway. ] */
 TEST_FUNCTION(EventSystem_Report_CallAllRegistered)
@@ -592,8 +706,8 @@ TEST_FUNCTION(EventSystem_Report_CallAllRegistered)
     EventSystem_ReportEvent(event_system, gw, GATEWAY_STARTED);
     // check that they weren't run in this thread
     ASSERT_IS_TRUE(callback_gw_history->empty());
-    // simulate the thread running
-    last_thread_func(last_thread_arg);
+    // simulate the timer service running the drain
+    last_timer_callback(last_timer_context);
 
     // Assert
     ASSERT_ARE_EQUAL(size_t, callback_gw_history->size(), 3);
@@ -607,8 +721,8 @@ TEST_FUNCTION(EventSystem_Report_CallAllRegistered)
     EventSystem_Destroy(event_system);
 }
 
-/* Tests_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
-TEST_FUNCTION(EventSystem_Thread_Creation_Fails)
+/* Tests_SRS_EVENTSYSTEM_26_013: [ Should the callback timer ever fail to be scheduled or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+TEST_FUNCTION(EventSystem_Timer_Schedule_Fails)
 {
     // Arrange
     CEventSystemMocks mocks;
@@ -618,21 +732,20 @@ TEST_FUNCTION(EventSystem_Thread_Creation_Fails)
 
     // Expect
     EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .ExpectedTimesExactly(5);
+        .ExpectedTimesExactly(6);
     EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .ExpectedTimesExactly(5);
+        .ExpectedTimesExactly(6);
     EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, VECTOR_front(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
-        .ExpectedTimesExactly(2);
-    EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .SetFailReturn(THREADAPI_ERROR)
+    EXPECTED_CALL(mocks, GatewayTimer_Schedule(0, 0, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetFailReturn((GATEWAY_TIMER_HANDLE)NULL)
         .ExpectedTimesExactly(1);
-    // notice only one thing was added to the queue because we don't try to create thread again later
+    // notice only one thing was added to the queue because we don't try to schedule the drain again later
+    EXPECTED_CALL(mocks, GatewayTimer_Deinit());
     EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .ExpectedTimesExactly(2);
@@ -658,10 +771,11 @@ TEST_FUNCTION(EventSystem_Thread_Creation_Fails)
 
     // Assert
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_TRUE(callback_gw_history->empty());
 }
 
-/* Checks that even if the thread quits after finishing the job, that another thread is created properly */
-TEST_FUNCTION(EventSystem_Recreates_Thread_When_Quit)
+/* Checks that once a drain has emptied the queue, the next event schedules another one */
+TEST_FUNCTION(EventSystem_Reschedules_Timer_After_Drain)
 {
     // Arrange
     CEventSystemMocks mocks;
@@ -670,29 +784,37 @@ TEST_FUNCTION(EventSystem_Recreates_Thread_When_Quit)
     EventSystem_AddEventCallback(handle, GATEWAY_STARTED, countingCallback, NULL);
 
     // Act
-    ASSERT_IS_NULL((void*)last_thread_func);
+    ASSERT_IS_NULL((void*)last_timer_callback);
     
     EventSystem_ReportEvent(handle, NULL, GATEWAY_STARTED);
     
-    ASSERT_IS_NOT_NULL((void*)last_thread_func);
+    ASSERT_IS_NOT_NULL((void*)last_timer_callback);
     ASSERT_ARE_EQUAL(int, callback_gw_history->size(), 0);
-    last_thread_func(last_thread_arg);
+    last_timer_callback(last_timer_context);
     ASSERT_ARE_EQUAL(int, callback_gw_history->size(), 2);
-    last_thread_func = NULL;
-    
+    last_timer_callback = NULL;
+    mocks.ResetAllCalls();
+
+    // the timer of the finished drain is released before the next one is scheduled
+    EXPECTED_CALL(mocks, GatewayTimer_Cancel(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, GatewayTimer_Schedule(0, 0, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    mocks.SetIgnoreUnexpectedCalls(true);
+
     EventSystem_ReportEvent(handle, NULL, GATEWAY_STARTED);
-    
-    ASSERT_IS_NOT_NULL((void*)last_thread_func);
-    last_thread_func(last_thread_arg);
+
+    mocks.AssertActualAndExpectedCalls();
+    mocks.SetIgnoreUnexpectedCalls(false);
+    ASSERT_IS_NOT_NULL((void*)last_timer_callback);
+    last_timer_callback(last_timer_context);
     ASSERT_ARE_EQUAL(int, callback_gw_history->size(), 4);
 
     mocks.ResetAllCalls();
 
     // All callbacks should already be consumed
     EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)).ExpectedAtLeastTimes(2);
-    EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG)).ExpectedAtLeastTimes(2);
-    EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, GatewayTimer_Cancel(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, GatewayTimer_Deinit());
     EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .ExpectedTimesExactly(2);
@@ -716,6 +838,37 @@ TEST_FUNCTION(EventSystem_Recreates_Thread_When_Quit)
     mocks.AssertActualAndExpectedCalls();
 }
 
+/* Tests_SRS_EVENTSYSTEM_26_020: [ An event reported by a callback shall be queued and its callbacks called by the drain that is running, without scheduling or cancelling a timer. ] */
+TEST_FUNCTION(EventSystem_Callback_Removing_A_Module_Is_Called_Back_By_The_Same_Drain)
+{
+    // Arrange
+    CEventSystemMocks mocks;
+    mocks.SetIgnoreUnexpectedCalls(true);
+    module_list = (VECTOR_HANDLE)0x44;
+    EVENTSYSTEM_HANDLE event_system = EventSystem_Init();
+    reporting_event_system = event_system;
+    EventSystem_AddEventCallback(event_system, GATEWAY_STARTED, removing_module_callback, NULL);
+    EventSystem_AddEventCallback(event_system, GATEWAY_MODULE_LIST_CHANGED, countingCallback, NULL);
+    EventSystem_ReportEvent(event_system, NULL, GATEWAY_STARTED);
+    GATEWAY_TIMER_CALLBACK drain = last_timer_callback;
+    last_timer_callback = NULL;
+
+    // Act
+    // simulate the timer service
+    bool periodic = drain(last_timer_context);
+
+    // Assert
+    ASSERT_IS_FALSE(periodic);
+    ASSERT_ARE_EQUAL(int, 1, callback_per_event_count[GATEWAY_MODULE_LIST_CHANGED]);
+    ASSERT_IS_NULL((void*)last_timer_callback);
+    ASSERT_ARE_EQUAL(int, 0, timer_cancel_count);
+    ASSERT_ARE_EQUAL(int, 0, timer_deinit_count);
+
+    // Cleanup
+    EventSystem_Destroy(event_system);
+    mocks.ResetAllCalls();
+}
+
 /* Tests_SRS_EVENTSYSTEM_26_009: [ This function shall call all registered callbacks in First-In-First-Out order in terms registration. ] */
 TEST_FUNCTION(EventSystem_Report_CallOrder)
 {
@@ -755,8 +908,8 @@ TEST_FUNCTION(EventSystem_Report_CallOrder)
 
     // Act
     EventSystem_ReportEvent(event_system, gw, GATEWAY_STARTED);
-    // simulate the thread
-    last_thread_func(last_thread_arg);
+    // simulate the timer service
+    last_timer_callback(last_timer_context);
     // Cleanup to force multi-threaded callbacks to finish
     free(gw);
     EventSystem_Destroy(event_system);
@@ -810,7 +963,7 @@ TEST_FUNCTION(EventSystem_AddEventCallback_NULLs)
     EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .ExpectedTimesExactly(4);
     // Destroy ( + 1 lock/unlock above)
-    EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, GatewayTimer_Deinit());
     EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .ExpectedTimesExactly(2);
@@ -988,7 +1141,6 @@ TEST_FUNCTION(EventSystem_ReportEvent_singlylinkedlist_add_fail)
     EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetFailReturn((LIST_ITEM_HANDLE)NULL);
     EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
         .ExpectedTimesExactly(1);
 
@@ -1016,9 +1168,9 @@ TEST_FUNCTION(EventSystem_ReportEvent_Modules_Proper_List_Given)
 
     // Expect
     EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .ExpectedTimesExactly(6);
+        .ExpectedTimesExactly(5);
     EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .ExpectedTimesExactly(6);
+        .ExpectedTimesExactly(5);
     EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .ExpectedTimesExactly(2);
     EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG));
@@ -1028,11 +1180,11 @@ TEST_FUNCTION(EventSystem_ReportEvent_Modules_Proper_List_Given)
     EXPECTED_CALL(mocks, Gateway_GetModuleList(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, GatewayTimer_Schedule(0, 0, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    // simulated drain
     EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    // simulated thread
     EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
-        .ExpectedTimesExactly(3);
+        .ExpectedTimesExactly(2);
     EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
@@ -1041,12 +1193,11 @@ TEST_FUNCTION(EventSystem_ReportEvent_Modules_Proper_List_Given)
         .ExpectedTimesExactly(1);
     EXPECTED_CALL(mocks, Gateway_DestroyModuleList(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
 
     // Act
     EventSystem_ReportEvent(handle, NULL, GATEWAY_MODULE_LIST_CHANGED);
-    // simulate the thread running
-    last_thread_func(last_thread_arg);
+    // simulate the timer service running the drain
+    last_timer_callback(last_timer_context);
 
     // Assert
     ASSERT_IS_TRUE(module_list == (VECTOR_HANDLE)last_context);
@@ -1133,8 +1284,8 @@ TEST_FUNCTION(EventSystem_ReportEvent_user_param_is_passed)
 
     // Act
     EventSystem_ReportEvent(handle, NULL, GATEWAY_MODULE_LIST_CHANGED);
-    // simulate the thread running
-    last_thread_func(last_thread_arg);
+    // simulate the timer service running the drain
+    last_timer_callback(last_timer_context);
 
     // Assert
     ASSERT_IS_TRUE(last_user_param == (void*)0x42);
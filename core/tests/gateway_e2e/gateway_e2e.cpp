@@ -207,9 +207,11 @@ BEGIN_TEST_SUITE(gateway_e2e)
 
         links[0].module_source = "E2ETest";
         links[0].module_sink = GW_IDMAP_MODULE;
+        links[0].fuse = false;
 
         links[1].module_source = GW_IDMAP_MODULE;
         links[1].module_sink = "IoTHub";
+        links[1].fuse = false;
         
         GATEWAY_PROPERTIES m6GatewayProperties;
         VECTOR_HANDLE gatewayProps = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
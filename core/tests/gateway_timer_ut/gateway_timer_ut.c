@@ -0,0 +1,514 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+static bool calloc_will_fail = false;
+
+void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void* my_gballoc_calloc(size_t nmemb, size_t size)
+{
+    return calloc_will_fail ? NULL : calloc(nmemb, size);
+}
+
+void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#undef ENABLE_MOCKS
+
+#include "gateway_timer.h"
+#include "internal/timer_wheel.h"
+
+//=============================================================================
+//Globals
+//=============================================================================
+
+#ifdef WIN32
+static TEST_MUTEX_HANDLE g_dllByDll;
+#endif
+static TEST_MUTEX_HANDLE g_testByTest;
+
+static uint64_t test_now_ms;
+
+void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)my_gballoc_malloc(1);
+}
+
+LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    my_gballoc_free(handle);
+    return LOCK_OK;
+}
+
+COND_HANDLE my_Condition_Init(void)
+{
+    return (COND_HANDLE)my_gballoc_malloc(1);
+}
+
+void my_Condition_Deinit(COND_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+TICK_COUNTER_HANDLE my_tickcounter_create(void)
+{
+    return (TICK_COUNTER_HANDLE)my_gballoc_malloc(1);
+}
+
+void my_tickcounter_destroy(TICK_COUNTER_HANDLE tick_counter)
+{
+    my_gballoc_free(tick_counter);
+}
+
+int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = (tickcounter_ms_t)test_now_ms;
+    return 0;
+}
+
+/*the service thread is never run; the tests drive the wheel and the API directly*/
+THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    (void)func;
+    (void)arg;
+    *threadHandle = (THREAD_HANDLE)0x4242;
+    return THREADAPI_OK;
+}
+
+static bool test_callback(void* context)
+{
+    (void)context;
+    return true;
+}
+
+static TIMER_WHEEL_ENTRY make_entry(void)
+{
+    TIMER_WHEEL_ENTRY entry = { 0, NULL, NULL };
+    return entry;
+}
+
+static size_t count_entries(const TIMER_WHEEL_ENTRY* list)
+{
+    size_t result = 0;
+    for (; list != NULL; list = list->next)
+    {
+        result++;
+    }
+    return result;
+}
+
+BEGIN_TEST_SUITE(gateway_timer_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_stdint_register_types();
+    umocktypes_bool_register_types();
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(tickcounter_ms_t*, void*);
+
+    // malloc/free hooks
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_calloc, my_gballoc_calloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Init, my_Condition_Init);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Deinit, my_Condition_Deinit);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_create, my_tickcounter_create);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_destroy, my_tickcounter_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    calloc_will_fail = false;
+    test_now_ms = 1000;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_TIMER_WHEEL_26_001: [ TimerWheel_Create shall return NULL if it cannot allocate the wheel, or an empty wheel whose current time is now_ms otherwise. ]*/
+TEST_FUNCTION(TimerWheel_Create_fails_when_calloc_fails)
+{
+    ///arrange
+    calloc_will_fail = true;
+
+    ///act
+    TIMER_WHEEL_HANDLE wheel = TimerWheel_Create(0);
+
+    ///assert
+    ASSERT_IS_NULL(wheel);
+}
+
+/*Tests_SRS_TIMER_WHEEL_26_006: [ TimerWheel_GetNextTime shall return false if the wheel is empty, or set next_ms to a time no later than the earliest expiry on the wheel and return true otherwise. ]*/
+TEST_FUNCTION(TimerWheel_GetNextTime_returns_false_when_empty)
+{
+    ///arrange
+    TIMER_WHEEL_HANDLE wheel = TimerWheel_Create(1000);
+    uint64_t next_ms = 42;
+
+    ///act
+    bool result = TimerWheel_GetNextTime(wheel, &next_ms);
+
+    ///assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(uint64_t, 42, next_ms);
+
+    ///cleanup
+    TimerWheel_Destroy(wheel);
+}
+
+/*Tests_SRS_TIMER_WHEEL_26_004: [ TimerWheel_Advance shall take off and return every entry whose expires_ms is not later than now_ms, chained through next in the order they expire. ]*/
+TEST_FUNCTION(TimerWheel_Advance_returns_entries_when_they_are_due)
+{
+    ///arrange
+    TIMER_WHEEL_HANDLE wheel = TimerWheel_Create(1000);
+    TIMER_WHEEL_ENTRY near_entry = make_entry();
+    TIMER_WHEEL_ENTRY mid_entry = make_entry();
+    TIMER_WHEEL_ENTRY far_entry = make_entry();
+    TimerWheel_Add(wheel, &near_entry, 1005);
+    TimerWheel_Add(wheel, &mid_entry, 1000 + 5000);
+    TimerWheel_Add(wheel, &far_entry, 1000 + 300000);
+
+    ///act
+    TIMER_WHEEL_ENTRY* before_near = TimerWheel_Advance(wheel, 1004);
+    TIMER_WHEEL_ENTRY* at_near = TimerWheel_Advance(wheel, 1005);
+    TIMER_WHEEL_ENTRY* before_mid = TimerWheel_Advance(wheel, 5999);
+    TIMER_WHEEL_ENTRY* at_mid = TimerWheel_Advance(wheel, 6000);
+    TIMER_WHEEL_ENTRY* before_far = TimerWheel_Advance(wheel, 300999);
+    TIMER_WHEEL_ENTRY* at_far = TimerWheel_Advance(wheel, 301000);
+
+    ///assert
+    ASSERT_IS_NULL(before_near);
+    ASSERT_ARE_EQUAL(void_ptr, &near_entry, at_near);
+    ASSERT_IS_NULL(at_near->next);
+    ASSERT_IS_NULL(before_mid);
+    ASSERT_ARE_EQUAL(void_ptr, &mid_entry, at_mid);
+    ASSERT_IS_NULL(before_far);
+    ASSERT_ARE_EQUAL(void_ptr, &far_entry, at_far);
+    ASSERT_IS_NULL(far_entry.pprev);
+
+    ///cleanup
+    TimerWheel_Destroy(wheel);
+}
+
+/*Tests_SRS_TIMER_WHEEL_26_004: [ TimerWheel_Advance shall take off and return every entry whose expires_ms is not later than now_ms, chained through next in the order they expire. ]*/
+TEST_FUNCTION(TimerWheel_Advance_returns_entries_in_the_order_they_expire)
+{
+    ///arrange
+    TIMER_WHEEL_HANDLE wheel = TimerWheel_Create(0);
+    TIMER_WHEEL_ENTRY entries[3] = { make_entry(), make_entry(), make_entry() };
+    TimerWheel_Add(wheel, &entries[0], 30000);
+    TimerWheel_Add(wheel, &entries[1], 10);
+    TimerWheel_Add(wheel, &entries[2], 2000);
+
+    ///act
+    TIMER_WHEEL_ENTRY* due = TimerWheel_Advance(wheel, 100000);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 3, count_entries(due));
+    ASSERT_ARE_EQUAL(void_ptr, &entries[1], due);
+    ASSERT_ARE_EQUAL(void_ptr, &entries[2], due->next);
+    ASSERT_ARE_EQUAL(void_ptr, &entries[0], due->next->next);
+
+    ///cleanup
+    TimerWheel_Destroy(wheel);
+}
+
+/*Tests_SRS_TIMER_WHEEL_26_004: [ TimerWheel_Advance shall take off and return every entry whose expires_ms is not later than now_ms, chained through next in the order they expire. ]*/
+TEST_FUNCTION(TimerWheel_Advance_returns_an_entry_beyond_the_span_of_the_wheel)
+{
+    ///arrange
+    uint64_t expires_ms = 7 + ((uint64_t)1 << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) * 3;
+    TIMER_WHEEL_HANDLE wheel = TimerWheel_Create(7);
+    TIMER_WHEEL_ENTRY entry = make_entry();
+    TimerWheel_Add(wheel, &entry, expires_ms);
+
+    ///act
+    TIMER_WHEEL_ENTRY* early = TimerWheel_Advance(wheel, expires_ms - 1);
+    TIMER_WHEEL_ENTRY* due = TimerWheel_Advance(wheel, expires_ms);
+
+    ///assert
+    ASSERT_IS_NULL(early);
+    ASSERT_ARE_EQUAL(void_ptr, &entry, due);
+
+    ///cleanup
+    TimerWheel_Destroy(wheel);
+}
+
+/*Tests_SRS_TIMER_WHEEL_26_002: [ TimerWheel_Add shall take entry off the wheel if it is on it, and put it back to expire at expires_ms. ]*/
+TEST_FUNCTION(TimerWheel_Add_moves_an_entry_that_is_on_the_wheel)
+{
+    ///arrange
+    TIMER_WHEEL_HANDLE wheel = TimerWheel_Create(0);
+    TIMER_WHEEL_ENTRY entry = make_entry();
+    TimerWheel_Add(wheel, &entry, 50);
+
+    ///act
+    TimerWheel_Add(wheel, &entry, 70000);
+
+    ///assert
+    ASSERT_IS_NULL(TimerWheel_Advance(wheel, 69999));
+    ASSERT_ARE_EQUAL(void_ptr, &entry, TimerWheel_Advance(wheel, 70000));
+    ASSERT_IS_NULL(entry.next);
+
+    ///cleanup
+    TimerWheel_Destroy(wheel);
+}
+
+/*Tests_SRS_TIMER_WHEEL_26_002: [ TimerWheel_Add shall take entry off the wheel if it is on it, and put it back to expire at expires_ms. ]*/
+TEST_FUNCTION(TimerWheel_Add_expires_a_time_that_has_passed_at_the_next_millisecond)
+{
+    ///arrange
+    TIMER_WHEEL_HANDLE wheel = TimerWheel_Create(0);
+    TIMER_WHEEL_ENTRY entry = make_entry();
+    (void)TimerWheel_Advance(wheel, 500);
+
+    ///act
+    TimerWheel_Add(wheel, &entry, 100);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, &entry, TimerWheel_Advance(wheel, 501));
+
+    ///cleanup
+    TimerWheel_Destroy(wheel);
+}
+
+/*Tests_SRS_TIMER_WHEEL_26_003: [ TimerWheel_Remove shall take entry off the wheel, and do nothing if it is not on it. ]*/
+TEST_FUNCTION(TimerWheel_Remove_takes_an_entry_off_the_wheel)
+{
+    ///arrange
+    TIMER_WHEEL_HANDLE wheel = TimerWheel_Create(0);
+    TIMER_WHEEL_ENTRY removed = make_entry();
+    TIMER_WHEEL_ENTRY kept = make_entry();
+    TimerWheel_Add(wheel, &removed, 20);
+    TimerWheel_Add(wheel, &kept, 20);
+
+    ///act
+    TimerWheel_Remove(wheel, &removed);
+    TimerWheel_Remove(wheel, &removed);
+
+    ///assert
+    ASSERT_IS_NULL(removed.pprev);
+    ASSERT_ARE_EQUAL(void_ptr, &kept, TimerWheel_Advance(wheel, 20));
+    ASSERT_IS_NULL(kept.next);
+
+    ///cleanup
+    TimerWheel_Destroy(wheel);
+}
+
+/*Tests_SRS_TIMER_WHEEL_26_006: [ TimerWheel_GetNextTime shall return false if the wheel is empty, or set next_ms to a time no later than the earliest expiry on the wheel and return true otherwise. ]*/
+TEST_FUNCTION(TimerWheel_GetNextTime_is_not_later_than_the_earliest_expiry)
+{
+    ///arrange
+    TIMER_WHEEL_HANDLE wheel = TimerWheel_Create(100);
+    TIMER_WHEEL_ENTRY entry = make_entry();
+    TIMER_WHEEL_ENTRY near_entry = make_entry();
+    uint64_t far_next_ms;
+    uint64_t near_next_ms;
+    TimerWheel_Add(wheel, &entry, 100000);
+
+    ///act
+    bool far_result = TimerWheel_GetNextTime(wheel, &far_next_ms);
+    TimerWheel_Add(wheel, &near_entry, 130);
+    bool near_result = TimerWheel_GetNextTime(wheel, &near_next_ms);
+
+    ///assert
+    ASSERT_IS_TRUE(far_result);
+    ASSERT_IS_TRUE(far_next_ms > 100);
+    ASSERT_IS_TRUE(far_next_ms <= 100000);
+    ASSERT_IS_TRUE(near_result);
+    ASSERT_ARE_EQUAL(uint64_t, 130, near_next_ms);
+
+    ///cleanup
+    TimerWheel_Destroy(wheel);
+}
+
+/*Tests_SRS_GATEWAY_TIMER_26_009: [ GatewayTimer_Schedule shall return NULL if callback is NULL, the service is not started, or the timer cannot be allocated. ]*/
+TEST_FUNCTION(GatewayTimer_Schedule_fails_before_Init)
+{
+    ///act
+    GATEWAY_TIMER_HANDLE timer = GatewayTimer_Schedule(10, 0, test_callback, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(timer);
+}
+
+/*Tests_SRS_GATEWAY_TIMER_26_001: [ GatewayTimer_Init shall create the timer wheel and start the service thread, and return non-zero if any step fails. ]*/
+TEST_FUNCTION(GatewayTimer_Init_fails_when_the_thread_cannot_start)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(THREADAPI_ERROR);
+
+    ///act
+    int result = GatewayTimer_Init();
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(GatewayTimer_Schedule(10, 0, test_callback, NULL));
+}
+
+/*Tests_SRS_GATEWAY_TIMER_26_002: [ If the service is already started, GatewayTimer_Init shall add a reference to it and return 0. ]*/
+/*Tests_SRS_GATEWAY_TIMER_26_003: [ GatewayTimer_Deinit shall release a reference, and the last release shall stop and join the service thread and free the service. ]*/
+/*Tests_SRS_GATEWAY_TIMER_26_015: [ GatewayTimer_Init and GatewayTimer_Deinit shall start, reference and release the service under a lock that is created once, so that they can be called from any thread. ]*/
+TEST_FUNCTION(GatewayTimer_Init_adds_a_reference_to_a_started_service)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, GatewayTimer_Init());
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    ///act
+    int result = GatewayTimer_Init();
+    GatewayTimer_Deinit();
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    STRICT_EXPECTED_CALL(ThreadAPI_Join((THREAD_HANDLE)0x4242, IGNORED_PTR_ARG));
+    GatewayTimer_Deinit();
+}
+
+/*Tests_SRS_GATEWAY_TIMER_26_009: [ GatewayTimer_Schedule shall return NULL if callback is NULL, the service is not started, or the timer cannot be allocated. ]*/
+TEST_FUNCTION(GatewayTimer_Schedule_fails_with_NULL_callback)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, GatewayTimer_Init());
+
+    ///act
+    GATEWAY_TIMER_HANDLE timer = GatewayTimer_Schedule(10, 0, NULL, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(timer);
+
+    ///cleanup
+    GatewayTimer_Deinit();
+}
+
+/*Tests_SRS_GATEWAY_TIMER_26_010: [ GatewayTimer_Schedule shall put the timer on the wheel to be due `delay_ms` from now. ]*/
+/*Tests_SRS_GATEWAY_TIMER_26_012: [ GatewayTimer_Cancel shall take the timer off the wheel and free it. ]*/
+/*Tests_SRS_GATEWAY_TIMER_26_014: [ GatewayTimer_GetStats shall copy the service's wakeup, idle wakeup, callback and armed timer counts into stats. ]*/
+TEST_FUNCTION(GatewayTimer_Schedule_arms_a_timer_until_it_is_cancelled)
+{
+    ///arrange
+    GATEWAY_TIMER_STATS scheduled;
+    GATEWAY_TIMER_STATS cancelled;
+    ASSERT_ARE_EQUAL(int, 0, GatewayTimer_Init());
+
+    ///act
+    GATEWAY_TIMER_HANDLE timer = GatewayTimer_Schedule(10, 250, test_callback, NULL);
+    int scheduled_result = GatewayTimer_GetStats(&scheduled);
+    GatewayTimer_Cancel(timer);
+    int cancelled_result = GatewayTimer_GetStats(&cancelled);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(timer);
+    ASSERT_ARE_EQUAL(int, 0, scheduled_result);
+    ASSERT_ARE_EQUAL(uint64_t, 1, scheduled.armed);
+    ASSERT_ARE_EQUAL(int, 0, cancelled_result);
+    ASSERT_ARE_EQUAL(uint64_t, 0, cancelled.armed);
+    ASSERT_ARE_EQUAL(uint64_t, 0, cancelled.callbacks);
+
+    ///cleanup
+    GatewayTimer_Deinit();
+}
+
+/*Tests_SRS_GATEWAY_TIMER_26_014: [ GatewayTimer_GetStats shall copy the service's wakeup, idle wakeup, callback and armed timer counts into stats. ]*/
+TEST_FUNCTION(GatewayTimer_GetStats_fails_with_NULL_stats)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, GatewayTimer_Init());
+
+    ///act
+    int result = GatewayTimer_GetStats(NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    ///cleanup
+    GatewayTimer_Deinit();
+}
+
+END_TEST_SUITE(gateway_timer_ut)
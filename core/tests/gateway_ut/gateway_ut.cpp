@@ -56,6 +56,8 @@ static size_t whenShallmalloc_fail;
 
 static size_t currentBroker_AddModule_call;
 static size_t whenShallBroker_AddModule_fail;
+static size_t currentBroker_AddReplacementModule_call;
+static size_t whenShallBroker_AddReplacementModule_fail;
 static size_t currentBroker_RemoveModule_call;
 static size_t whenShallBroker_RemoveModule_fail;
 static size_t currentBroker_Create_call;
@@ -75,6 +77,8 @@ static size_t currentVECTOR_find_if_call;
 static size_t whenShallVECTOR_find_if_fail;
 
 static MODULE_API_1 dummyAPIs;
+static MODULE_API_3 dummyFusionSafeAPIs;
+static bool useFusionSafeAPIs;
 
 TYPED_MOCK_CLASS(CGatewayLLMocks, CGlobalMock)
 {
@@ -156,6 +160,30 @@ public:
         }
     MOCK_METHOD_END(BROKER_RESULT, result1);
 
+    MOCK_STATIC_METHOD_3(, BROKER_RESULT, Broker_AddModuleWithDelivery, BROKER_HANDLE, handle, const MODULE*, module, const BROKER_MODULE_DELIVERY*, delivery)
+        BROKER_RESULT result1 = BROKER_ERROR;
+        if (handle != NULL && module != NULL && delivery != NULL)
+        {
+            ++currentBroker_module_count;
+            result1 = BROKER_OK;
+        }
+    MOCK_METHOD_END(BROKER_RESULT, result1);
+
+    MOCK_STATIC_METHOD_4(, BROKER_RESULT, Broker_AddReplacementModule, BROKER_HANDLE, handle, const MODULE*, module, const BROKER_MODULE_DELIVERY*, delivery, const MODULE*, replaced)
+        currentBroker_AddReplacementModule_call++;
+        BROKER_RESULT result1 = BROKER_ERROR;
+        if (handle != NULL && module != NULL && delivery != NULL && replaced != NULL && whenShallBroker_AddReplacementModule_fail != currentBroker_AddReplacementModule_call)
+        {
+            ++currentBroker_module_count;
+            result1 = BROKER_OK;
+        }
+    MOCK_METHOD_END(BROKER_RESULT, result1);
+
+    MOCK_STATIC_METHOD_3(, BROKER_RESULT, Broker_GetLatencyHistogram, BROKER_HANDLE, broker, const MODULE*, module, BROKER_LATENCY_HISTOGRAM*, histogram)
+    MOCK_METHOD_END(BROKER_RESULT, BROKER_OK);
+    MOCK_STATIC_METHOD_3(, BROKER_RESULT, Broker_GetStallStats, BROKER_HANDLE, broker, const MODULE*, module, BROKER_STALL_STATS*, stats)
+    MOCK_METHOD_END(BROKER_RESULT, BROKER_OK);
+
     MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_RemoveModule, BROKER_HANDLE, handle, const MODULE*, module)
         currentBroker_RemoveModule_call++;
         BROKER_RESULT result1 = BROKER_ERROR;
@@ -169,6 +197,9 @@ public:
     MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_AddLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link)
     MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
 
+    MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_AddFusedLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link)
+    MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
+
     MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_RemoveLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link)
     MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
 
@@ -182,7 +213,9 @@ public:
     MOCK_METHOD_END(MODULE_LIBRARY_HANDLE, handle);
 
     MOCK_STATIC_METHOD_2(, const MODULE_API*, DynamicModuleLoader_GetModuleApi, const struct MODULE_LOADER_TAG*, loader, MODULE_LIBRARY_HANDLE, module_library_handle)
-        const MODULE_API* apis = reinterpret_cast<const MODULE_API*>(&dummyAPIs);
+        const MODULE_API* apis = useFusionSafeAPIs ?
+            reinterpret_cast<const MODULE_API*>(&dummyFusionSafeAPIs) :
+            reinterpret_cast<const MODULE_API*>(&dummyAPIs);
     MOCK_METHOD_END(const MODULE_API*, apis);
 
     MOCK_STATIC_METHOD_2(, void, DynamicModuleLoader_Unload, const struct MODULE_LOADER_TAG*, loader, MODULE_LIBRARY_HANDLE, moduleLibraryHandle)
@@ -326,6 +359,12 @@ public:
     MOCK_STATIC_METHOD_2(, void*, gballoc_calloc, size_t, num, size_t, size)
     MOCK_METHOD_END(void*, BASEIMPLEMENTATION::gballoc_calloc(num, size));
 
+    MOCK_STATIC_METHOD_2(, int, ModuleAlloc_GetStats, MODULE_ALLOC_TAG, tag, MODULE_ALLOC_STATS*, stats)
+    MOCK_METHOD_END(int, 0);
+
+    MOCK_STATIC_METHOD_2(, void, ModuleAlloc_SetBudget, MODULE_ALLOC_TAG, tag, size_t, budget_bytes)
+    MOCK_VOID_METHOD_END();
+
     MOCK_STATIC_METHOD_2(, int, mallocAndStrcpy_s, char**, destination, const char*, source)
         (*destination) = (char*)malloc(strlen(source) + 1);
         strcpy(*destination, source);
@@ -342,8 +381,13 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, mock_Module_Start, MODULE_
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayLLMocks, , BROKER_HANDLE, Broker_Create);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, Broker_Destroy, BROKER_HANDLE, broker);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_AddModule, BROKER_HANDLE, handle, const MODULE*, module);
+DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , BROKER_RESULT, Broker_AddModuleWithDelivery, BROKER_HANDLE, handle, const MODULE*, module, const BROKER_MODULE_DELIVERY*, delivery);
+DECLARE_GLOBAL_MOCK_METHOD_4(CGatewayLLMocks, , BROKER_RESULT, Broker_AddReplacementModule, BROKER_HANDLE, handle, const MODULE*, module, const BROKER_MODULE_DELIVERY*, delivery, const MODULE*, replaced);
+DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , BROKER_RESULT, Broker_GetLatencyHistogram, BROKER_HANDLE, broker, const MODULE*, module, BROKER_LATENCY_HISTOGRAM*, histogram);
+DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , BROKER_RESULT, Broker_GetStallStats, BROKER_HANDLE, broker, const MODULE*, module, BROKER_STALL_STATS*, stats);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_RemoveModule, BROKER_HANDLE, handle, const MODULE*, module);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_AddLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_AddFusedLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_RemoveLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, Broker_IncRef, BROKER_HANDLE, broker);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, Broker_DecRef, BROKER_HANDLE, broker);
@@ -382,6 +426,9 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , void*, gballoc_realloc, void*, p
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, gballoc_free, void*, ptr)
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , void*, gballoc_calloc, size_t, num, size_t, size)
 
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , int, ModuleAlloc_GetStats, MODULE_ALLOC_TAG, tag, MODULE_ALLOC_STATS*, stats);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , void, ModuleAlloc_SetBudget, MODULE_ALLOC_TAG, tag, size_t, budget_bytes);
+
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , int, mallocAndStrcpy_s, char**, destination, const char*, source);
 
 static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
@@ -472,6 +519,8 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 
     currentBroker_AddModule_call = 0;
     whenShallBroker_AddModule_fail = 0;
+    currentBroker_AddReplacementModule_call = 0;
+    whenShallBroker_AddReplacementModule_fail = 0;
     currentBroker_RemoveModule_call = 0;
     whenShallBroker_RemoveModule_fail = 0;
     currentBroker_Create_call = 0;
@@ -502,7 +551,20 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
         mock_Module_Start
     };
 
+    dummyFusionSafeAPIs =
+    {
+        {MODULE_API_VERSION_3},
 
+        mock_Module_ParseConfigurationFromJson,
+        mock_Module_FreeConfiguration,
+        mock_Module_Create,
+        mock_Module_Destroy,
+        mock_Module_Receive,
+        mock_Module_Start,
+        1,
+        true
+    };
+    useFusionSafeAPIs = false;
 
     GATEWAY_MODULES_ENTRY dummyEntry = {
         "dummy module",
@@ -1964,6 +2026,117 @@ TEST_FUNCTION(Gateway_AddModule_Loads_Module_From_Library_Path)
     Gateway_Destroy(gw);
 }
 
+/*Tests_SRS_GATEWAY_26_022: [ If that concurrency is greater than 1, or the entry sets `delivery.spin_count`, `delivery.yield_count` or a `delivery.queue` other than `BROKER_QUEUE_FIFO`, the function shall attach the module using a call to Broker_AddModuleWithDelivery instead. ]*/
+TEST_FUNCTION(Gateway_AddModule_with_concurrency_uses_Broker_AddModuleWithDelivery)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+
+    GATEWAY_HANDLE gw = Gateway_Create(NULL);
+    GATEWAY_MODULES_ENTRY entry = *(GATEWAY_MODULES_ENTRY*)BASEIMPLEMENTATION::VECTOR_front(dummyProps->gateway_modules);
+    entry.delivery.concurrency = 4;
+    entry.delivery.order_by = "deviceId";
+    mocks.ResetAllCalls();
+
+    //Expectations
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_Load(IGNORED_PTR_ARG, dummyLoaderInfo.entrypoint))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_GetModuleApi(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_BuildModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_FreeModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithDelivery(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_LIST_CHANGED))
+        .IgnoreArgument(1);
+
+    //Act
+    MODULE_HANDLE handle = Gateway_AddModule(gw, &entry);
+
+    //Assert
+    ASSERT_IS_NOT_NULL(handle);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_26_026: [ If the entry sets `delivery.stall_ms`, the function shall attach the module using a call to Broker_AddModuleWithDelivery. ]*/
+TEST_FUNCTION(Gateway_AddModule_with_stall_ms_uses_Broker_AddModuleWithDelivery)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+
+    GATEWAY_HANDLE gw = Gateway_Create(NULL);
+    GATEWAY_MODULES_ENTRY entry = *(GATEWAY_MODULES_ENTRY*)BASEIMPLEMENTATION::VECTOR_front(dummyProps->gateway_modules);
+    entry.delivery.stall_ms = 500;
+    mocks.ResetAllCalls();
+
+    //Expectations
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_Load(IGNORED_PTR_ARG, dummyLoaderInfo.entrypoint))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_GetModuleApi(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_BuildModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_FreeModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithDelivery(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_LIST_CHANGED))
+        .IgnoreArgument(1);
+
+    //Act
+    MODULE_HANDLE handle = Gateway_AddModule(gw, &entry);
+
+    //Assert
+    ASSERT_IS_NOT_NULL(handle);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
 /*Tests_SRS_GATEWAY_14_031: [ If unsuccessful, the function shall return NULL. ]*/
 TEST_FUNCTION(Gateway_AddModule_Malloc_data_Fails)
 {
@@ -3244,21 +3417,23 @@ TEST_FUNCTION(Gateway_AddLink_Succeeds)
     Gateway_Destroy(gateway);
 }
 
-TEST_FUNCTION(Gateway_AddLink_pushback_fails)
+/*Tests_SRS_GATEWAY_26_023: [ If `entryLink->fuse` is true, the sink's MODULE_API marks it fusion-safe, no other link has the sink as its sink or the source as its source, and the link does not close a loop of fused links, the function shall add the link using a call to Broker_AddFusedLink instead of Broker_AddLink. ]*/
+TEST_FUNCTION(Gateway_AddLink_fuses_a_link_into_a_fusion_safe_sink)
 {
     //Arrange
     CGatewayLLMocks mocks;
+    useFusionSafeAPIs = true;
 
-    //Add another entry to the properties
     GATEWAY_MODULES_ENTRY dummyEntry2 = {
         "dummy module 2",
-		dummyLoaderInfo,
+        dummyLoaderInfo,
         NULL
     };
 
     GATEWAY_LINK_ENTRY dummyLink = {
         "dummy module",
-        "dummy module 2"
+        "dummy module 2",
+        true
     };
 
     BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
@@ -3266,47 +3441,50 @@ TEST_FUNCTION(Gateway_AddLink_pushback_fails)
     GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
     mocks.ResetAllCalls();
 
-    //Act
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check link
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check Source Module.
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check Sink Module.
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);//Check the other links.
+    STRICT_EXPECTED_CALL(mocks, Broker_AddFusedLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn(100);
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    //Act
     GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink);
 
     //Assert
-    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_ERROR, result);
-
+    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_SUCCESS, result);
     mocks.AssertActualAndExpectedCalls();
 
     //Cleanup
     Gateway_Destroy(gateway);
 }
 
-TEST_FUNCTION(Gateway_AddLink_broker_add_fails)
+/*Tests_SRS_GATEWAY_26_023: [ If `entryLink->fuse` is true, the sink's MODULE_API marks it fusion-safe, no other link has the sink as its sink or the source as its source, and the link does not close a loop of fused links, the function shall add the link using a call to Broker_AddFusedLink instead of Broker_AddLink. ]*/
+TEST_FUNCTION(Gateway_AddLink_does_not_fuse_into_a_sink_that_is_not_fusion_safe)
 {
     //Arrange
     CGatewayLLMocks mocks;
 
-    //Add another entry to the properties
     GATEWAY_MODULES_ENTRY dummyEntry2 = {
         "dummy module 2",
-		dummyLoaderInfo,
+        dummyLoaderInfo,
         NULL
     };
 
     GATEWAY_LINK_ENTRY dummyLink = {
         "dummy module",
-        "dummy module 2"
+        "dummy module 2",
+        true
     };
 
     BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
@@ -3314,7 +3492,6 @@ TEST_FUNCTION(Gateway_AddLink_broker_add_fails)
     GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
     mocks.ResetAllCalls();
 
-    //Act
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check link
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -3322,108 +3499,96 @@ TEST_FUNCTION(Gateway_AddLink_broker_add_fails)
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check Sink Module.
     STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetFailReturn(BROKER_ADD_LINK_ERROR);
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
 
-     GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink);
+    //Act
+    GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink);
 
     //Assert
-    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_ERROR, result);
-
+    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_SUCCESS, result);
     mocks.AssertActualAndExpectedCalls();
 
     //Cleanup
     Gateway_Destroy(gateway);
 }
 
-TEST_FUNCTION(Gateway_AddLink_star_2nd_addbroker_fails)
+/*Tests_SRS_GATEWAY_26_024: [ Before it adds a link into a sink that receives on a fused link, the function shall turn that fused link into a regular one. ]*/
+TEST_FUNCTION(Gateway_AddLink_unfuses_the_link_into_a_sink_that_gets_another_source)
 {
     //Arrange
     CGatewayLLMocks mocks;
+    useFusionSafeAPIs = true;
 
-    //Add another entry to the properties
     GATEWAY_MODULES_ENTRY dummyEntry2 = {
         "dummy module 2",
-		dummyLoaderInfo,
+        dummyLoaderInfo,
         NULL
     };
     GATEWAY_MODULES_ENTRY dummyEntry3 = {
         "dummy module 3",
-		dummyLoaderInfo,
+        dummyLoaderInfo,
         NULL
     };
 
-    GATEWAY_LINK_ENTRY dummyLink1 = {
-        "*",
-        "dummy module 2"
+    GATEWAY_LINK_ENTRY fusedLink = {
+        "dummy module",
+        "dummy module 2",
+        true
     };
-    GATEWAY_LINK_ENTRY dummyLink2 = {
-        "*",
-        "dummy module 3"
+    GATEWAY_LINK_ENTRY secondLink = {
+        "dummy module 3",
+        "dummy module 2",
+        false
     };
 
     BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
     BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry3, 1);
 
     GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
-
-    GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink1);
-
+    (void)Gateway_AddLink(gateway, &fusedLink);
     mocks.ResetAllCalls();
 
-    //Act
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check link
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check Source Module.
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check Sink Module.
-    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2); // Add link to links vector
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); // for each module.
+        .IgnoreArgument(1);//Find the fused link.
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetFailReturn(BROKER_ADD_LINK_ERROR);
-
-    //Remove link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); // for each module.
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 2))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
+        .IgnoreAllArguments();//Unfused link.
     STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreAllArguments();//Fused link.
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//New link.
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
 
-    result = Gateway_AddLink(gateway, &dummyLink2);
+    //Act
+    GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &secondLink);
 
     //Assert
-    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_ERROR, result);
-
+    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_SUCCESS, result);
     mocks.AssertActualAndExpectedCalls();
 
     //Cleanup
     Gateway_Destroy(gateway);
 }
 
-TEST_FUNCTION(Gateway_AddLink_star_2nd_add_push_fails)
+TEST_FUNCTION(Gateway_AddLink_pushback_fails)
 {
     //Arrange
     CGatewayLLMocks mocks;
@@ -3434,41 +3599,220 @@ TEST_FUNCTION(Gateway_AddLink_star_2nd_add_push_fails)
 		dummyLoaderInfo,
         NULL
     };
-    GATEWAY_MODULES_ENTRY dummyEntry3 = {
-        "dummy module 3",
-		dummyLoaderInfo,
-        NULL
-    };
 
-    GATEWAY_LINK_ENTRY dummyLink1 = {
-        "*",
+    GATEWAY_LINK_ENTRY dummyLink = {
+        "dummy module",
         "dummy module 2"
     };
-    GATEWAY_LINK_ENTRY dummyLink2 = {
-        "*",
-        "dummy module 3"
-    };
 
     BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
-    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry3, 1);
 
     GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
-
-    GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink1);
-
     mocks.ResetAllCalls();
 
     //Act
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check link
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check Source Module.
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check Sink Module.
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
-        .SetFailReturn(1); // Add link to links vector
-
-    result = Gateway_AddLink(gateway, &dummyLink2);
+        .SetFailReturn(100);
+    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink);
+
+    //Assert
+    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_ERROR, result);
+
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gateway);
+}
+
+TEST_FUNCTION(Gateway_AddLink_broker_add_fails)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+
+    //Add another entry to the properties
+    GATEWAY_MODULES_ENTRY dummyEntry2 = {
+        "dummy module 2",
+		dummyLoaderInfo,
+        NULL
+    };
+
+    GATEWAY_LINK_ENTRY dummyLink = {
+        "dummy module",
+        "dummy module 2"
+    };
+
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
+
+    GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Act
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check link
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check Source Module.
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check Sink Module.
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetFailReturn(BROKER_ADD_LINK_ERROR);
+
+     GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink);
+
+    //Assert
+    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_ERROR, result);
+
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gateway);
+}
+
+TEST_FUNCTION(Gateway_AddLink_star_2nd_addbroker_fails)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+
+    //Add another entry to the properties
+    GATEWAY_MODULES_ENTRY dummyEntry2 = {
+        "dummy module 2",
+		dummyLoaderInfo,
+        NULL
+    };
+    GATEWAY_MODULES_ENTRY dummyEntry3 = {
+        "dummy module 3",
+		dummyLoaderInfo,
+        NULL
+    };
+
+    GATEWAY_LINK_ENTRY dummyLink1 = {
+        "*",
+        "dummy module 2"
+    };
+    GATEWAY_LINK_ENTRY dummyLink2 = {
+        "*",
+        "dummy module 3"
+    };
+
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry3, 1);
+
+    GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
+
+    GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink1);
+
+    mocks.ResetAllCalls();
+
+    //Act
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check link
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check Sink Module.
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2); // Add link to links vector
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); // for each module.
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetFailReturn(BROKER_ADD_LINK_ERROR);
+
+    //Remove link
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1); // for each module.
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 2))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    result = Gateway_AddLink(gateway, &dummyLink2);
+
+    //Assert
+    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_ERROR, result);
+
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gateway);
+}
+
+TEST_FUNCTION(Gateway_AddLink_star_2nd_add_push_fails)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+
+    //Add another entry to the properties
+    GATEWAY_MODULES_ENTRY dummyEntry2 = {
+        "dummy module 2",
+		dummyLoaderInfo,
+        NULL
+    };
+    GATEWAY_MODULES_ENTRY dummyEntry3 = {
+        "dummy module 3",
+		dummyLoaderInfo,
+        NULL
+    };
+
+    GATEWAY_LINK_ENTRY dummyLink1 = {
+        "*",
+        "dummy module 2"
+    };
+    GATEWAY_LINK_ENTRY dummyLink2 = {
+        "*",
+        "dummy module 3"
+    };
+
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry3, 1);
+
+    GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
+
+    GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink1);
+
+    mocks.ResetAllCalls();
+
+    //Act
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check link
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check Sink Module.
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetFailReturn(1); // Add link to links vector
+
+    result = Gateway_AddLink(gateway, &dummyLink2);
 
     //Assert
     ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_ERROR, result);
@@ -5047,6 +5391,374 @@ TEST_FUNCTION(Gateway_RemoveModuleByName_success)
     Gateway_Destroy(gw);
 }
 
+/*Tests_SRS_GATEWAY_26_027: [ If `gw`, `module_name` or `entry` is NULL, the function shall return NULL. ]*/
+TEST_FUNCTION(Gateway_ReplaceModule_Null_gw)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+
+    //Expect
+    //Nothing!
+
+    //Act
+    MODULE_HANDLE result = Gateway_ReplaceModule(NULL, "dummy module", (GATEWAY_MODULES_ENTRY*)BASEIMPLEMENTATION::VECTOR_front(dummyProps->gateway_modules));
+
+    //Assert
+    ASSERT_IS_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_26_027: [ If `gw`, `module_name` or `entry` is NULL, the function shall return NULL. ]*/
+TEST_FUNCTION(Gateway_ReplaceModule_Null_entry)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    auto gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Expect
+    //Nothing!
+
+    //Act
+    MODULE_HANDLE result = Gateway_ReplaceModule(gw, "dummy module", NULL);
+
+    //Assert
+    ASSERT_IS_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_26_028: [ If no module is named `module_name`, the function shall return NULL. ]*/
+TEST_FUNCTION(Gateway_ReplaceModule_not_existing)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    auto gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Expect
+    EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //Act
+    MODULE_HANDLE result = Gateway_ReplaceModule(gw, "foo", (GATEWAY_MODULES_ENTRY*)BASEIMPLEMENTATION::VECTOR_front(dummyProps->gateway_modules));
+
+    //Assert
+    ASSERT_IS_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_26_030: [ The new module shall take the name of the module it replaces; `entry`'s `module_name` is ignored. ]*/
+/*Tests_SRS_GATEWAY_26_032: [ The function shall create the new module as Gateway_AddModule does, and attach it to the broker using a call to Broker_AddReplacementModule in place of the module being replaced. ]*/
+/*Tests_SRS_GATEWAY_26_036: [ The function shall put the new module in place of the module being replaced in the gateway's modules and links. ]*/
+/*Tests_SRS_GATEWAY_26_037: [ The function shall then destroy the module being replaced; the broker delivers the messages published to it before the new module took over, and the new module receives every message published after. ]*/
+/*Tests_SRS_GATEWAY_26_038: [ The function shall report `GATEWAY_MODULE_LIST_CHANGED` event after successfully replacing the module, and return the new module's MODULE_HANDLE. ]*/
+TEST_FUNCTION(Gateway_ReplaceModule_success)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(NULL);
+    MODULE_HANDLE old_handle = Gateway_AddModule(gw, (GATEWAY_MODULES_ENTRY*)BASEIMPLEMENTATION::VECTOR_front(dummyProps->gateway_modules));
+    GATEWAY_MODULES_ENTRY entry = *(GATEWAY_MODULES_ENTRY*)BASEIMPLEMENTATION::VECTOR_front(dummyProps->gateway_modules);
+    entry.module_name = "ignored";
+    mocks.ResetAllCalls();
+
+    //Expect
+    EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, DynamicModuleLoader_Load(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, DynamicModuleLoader_GetModuleApi(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, DynamicModuleLoader_BuildModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, DynamicModuleLoader_FreeModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Broker_AddReplacementModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, "dummy module"));
+    EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(3);
+    EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, Broker_RemoveModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, Broker_DecRef(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, mock_Module_Destroy(old_handle));
+    EXPECTED_CALL(mocks, DynamicModuleLoader_Unload(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED));
+
+    //Act
+    MODULE_HANDLE result = Gateway_ReplaceModule(gw, "dummy module", &entry);
+
+    //Assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, old_handle, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_26_034: [ If the function fails after the new module is created, it shall remove the links it added, destroy the new module, leave the module being replaced as it was and return NULL. ]*/
+TEST_FUNCTION(Gateway_ReplaceModule_Broker_AddReplacementModule_fails_keeps_module)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(NULL);
+    MODULE_HANDLE old_handle = Gateway_AddModule(gw, (GATEWAY_MODULES_ENTRY*)BASEIMPLEMENTATION::VECTOR_front(dummyProps->gateway_modules));
+    mocks.ResetAllCalls();
+
+    whenShallBroker_AddReplacementModule_fail = 1;
+
+    //Expect
+    EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, DynamicModuleLoader_Load(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, DynamicModuleLoader_GetModuleApi(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, DynamicModuleLoader_BuildModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, DynamicModuleLoader_FreeModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Broker_AddReplacementModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, mock_Module_Destroy(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, DynamicModuleLoader_Unload(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG));
+
+    //Act
+    MODULE_HANDLE result = Gateway_ReplaceModule(gw, "dummy module", (GATEWAY_MODULES_ENTRY*)BASEIMPLEMENTATION::VECTOR_front(dummyProps->gateway_modules));
+
+    //Assert
+    ASSERT_IS_NULL(result);
+    ASSERT_IS_NOT_NULL(old_handle);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+TEST_FUNCTION(Gateway_GetModuleAllocStats_Null_gw)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    MODULE_ALLOC_STATS stats;
+
+    //Expect
+    //Nothing!
+
+    //Act
+    int result = Gateway_GetModuleAllocStats(NULL, "dummy module", &stats);
+
+    //Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+TEST_FUNCTION(Gateway_GetModuleAllocStats_Null_stats)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    auto gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Expect
+    //Nothing!
+
+    //Act
+    int result = Gateway_GetModuleAllocStats(gw, "dummy module", NULL);
+
+    //Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+TEST_FUNCTION(Gateway_GetModuleAllocStats_not_existing)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    MODULE_ALLOC_STATS stats;
+    auto gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Expect
+    EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //Act
+    int result = Gateway_GetModuleAllocStats(gw, "foo", &stats);
+
+    //Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+TEST_FUNCTION(Gateway_GetModuleAllocStats_fails_when_stats_are_not_collected)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    MODULE_ALLOC_STATS stats;
+    auto gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Expect
+    EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //Act
+    int result = Gateway_GetModuleAllocStats(gw, "dummy module", &stats);
+
+    //Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+TEST_FUNCTION(Gateway_GetModuleLatencyHistogram_Null_histogram)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    auto gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Expect
+    //Nothing!
+
+    //Act
+    int result = Gateway_GetModuleLatencyHistogram(gw, "dummy module", NULL);
+
+    //Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+TEST_FUNCTION(Gateway_GetModuleLatencyHistogram_not_existing)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    BROKER_LATENCY_HISTOGRAM histogram;
+    auto gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Expect
+    EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //Act
+    int result = Gateway_GetModuleLatencyHistogram(gw, "foo", &histogram);
+
+    //Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+TEST_FUNCTION(Gateway_GetModuleLatencyHistogram_gets_the_histogram_from_the_broker)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    BROKER_LATENCY_HISTOGRAM histogram;
+    auto gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Expect
+    EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Broker_GetLatencyHistogram(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &histogram))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    //Act
+    int result = Gateway_GetModuleLatencyHistogram(gw, "dummy module", &histogram);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+TEST_FUNCTION(Gateway_GetModuleStallStats_gets_the_stats_from_the_broker)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    BROKER_STALL_STATS stats;
+    auto gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Expect
+    EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, Broker_GetStallStats(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &stats))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    //Act
+    int result = Gateway_GetModuleStallStats(gw, "dummy module", &stats);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+TEST_FUNCTION(Gateway_SetModuleAllocBudget_Null_name)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    auto gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Expect
+    //Nothing!
+
+    //Act
+    int result = Gateway_SetModuleAllocBudget(gw, NULL, 1024);
+
+    //Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+TEST_FUNCTION(Gateway_SetModuleAllocBudget_fails_when_stats_are_not_collected)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    auto gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Expect
+    EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //Act
+    int result = Gateway_SetModuleAllocBudget(gw, "dummy module", 1024);
+
+    //Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
 /* Tests_SRS_GATEWAY_26_018: [ This function shall remove any links that contain the removed module either as a source or sink. ] */
 TEST_FUNCTION(Gateway_RemoveModule_removes_links)
 {
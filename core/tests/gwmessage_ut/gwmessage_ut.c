@@ -7,6 +7,7 @@
 #include "testrunnerswitcher.h"
 #include "umock_c.h"
 #include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
 
 #define ENABLE_MOCKS
 #include "azure_c_shared_utility/lock.h"
@@ -286,7 +287,7 @@ static const unsigned char fail_____firstByteNot0xA1[] =
 
 static const unsigned char fail____secondByteNot0x60[] =
 {
-    0xA1, 0x61,             /*header - wrong*/
+    0xA1, 0x62,             /*header - wrong*/
     0x00, 0x00, 0x00, 64,   /*size of this array*/
     0x00, 0x00, 0x00, 0x02, /*two properties*/
     'B','l','e','e','d','i','n','g','E','d','g','e','\0','r','o','c','k','s','\0',
@@ -332,7 +333,30 @@ static const unsigned char fail_whenThereIsOnly1ByteOfcontentSize[] =
     0x00                    /*not enough bytes for contentSize*/
 };
 
+static const unsigned char notFail__typed_1Int64Property_0bytes[] =
+{
+    0xA1, 0x61,             /*header - with typed properties*/
+    0x00, 0x00, 0x00, 29,   /*size of this array*/
+    0x00, 0x00, 0x00, 0x00, /*zero properties*/
+    0x00, 0x00, 0x00, 0x01, /*one typed property*/
+    'n', '\0', 0x01,        /*int64 named "n"*/
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE, /*-2*/
+    0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+};
+
+static const unsigned char fail_typedPropertyWithUnknownType[] =
+{
+    0xA1, 0x61,             /*header - with typed properties*/
+    0x00, 0x00, 0x00, 29,   /*size of this array*/
+    0x00, 0x00, 0x00, 0x00, /*zero properties*/
+    0x00, 0x00, 0x00, 0x01, /*one typed property*/
+    'n', '\0', 0x07,        /*unknown type*/
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+};
+
 #define TEST_MAP_HANDLE ((MAP_HANDLE)(1))
+#define TEST_REMOVED_MAP_HANDLE ((MAP_HANDLE)(2))
 #define TEST_CONSTBUFFER_HANDLE ((CONSTBUFFER_HANDLE)2)
 #define TEST_CONSTMAP_HANDLE ((CONSTMAP_HANDLE)3)
 #define TEST_MESSAGE_HANDLE ((MESSAGE_HANDLE)4)
@@ -355,6 +379,8 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         int result = umocktypes_charptr_register_types();
         ASSERT_ARE_EQUAL(int, 0, result);
+        result = umocktypes_bool_register_types();
+        ASSERT_ARE_EQUAL(int, 0, result);
 
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
@@ -380,6 +406,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         REGISTER_UMOCK_ALIAS_TYPE(const unsigned char*, void*);
         REGISTER_UMOCK_ALIAS_TYPE(const char* const*, void*);
         REGISTER_UMOCK_ALIAS_TYPE(const char* const* *, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(bool*, void*);
         //
 
     }
@@ -1137,6 +1164,231 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         CONSTBUFFER_Destroy(content);
     }
 
+    /*Tests_SRS_MESSAGE_26_001: [If message or view is NULL then Message_GetContentView shall fail and return a non-zero value.]*/
+    TEST_FUNCTION(Message_GetContentView_with_NULL_message_fails)
+    {
+        ///arrange
+        MESSAGE_CONTENT_VIEW view;
+
+        ///act
+        int result = Message_GetContentView(NULL, &view);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_26_003: [If cloning the content fails then Message_GetContentView shall fail and return a non-zero value.]*/
+    TEST_FUNCTION(Message_GetContentView_fails_when_CONSTBUFFER_Clone_fails)
+    {
+        ///arrange
+        char t = '3';
+        MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        MESSAGE_CONTENT_VIEW view;
+        umock_c_reset_all_calls();
+
+        whenShallCONSTBUFFER_Clone_fail = currentCONSTBUFFER_Clone_call + 1;
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        int result = Message_GetContentView(msg, &view);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_26_002: [Message_GetContentView shall clone the CONSTBUFFER_HANDLE representing the message content into view.]*/
+    /*Tests_SRS_MESSAGE_26_004: [Message_GetContentView shall set the view to span the whole content and return 0.]*/
+    /*Tests_SRS_MESSAGE_26_011: [MessageContentView_Release shall destroy the CONSTBUFFER_HANDLE held by view, if any, and empty the view.]*/
+    TEST_FUNCTION(Message_GetContentView_references_the_content_beyond_the_message)
+    {
+        ///arrange
+        const unsigned char bytes[] = { 0x01, 0x02, 0x03 };
+        MESSAGE_CONFIG c = { sizeof(bytes), bytes, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        MESSAGE_CONTENT_VIEW view;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        int result = Message_GetContentView(msg, &view);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        Message_Destroy(msg);
+        ASSERT_ARE_EQUAL(size_t, 0, view.offset);
+        ASSERT_ARE_EQUAL(size_t, sizeof(bytes), view.size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(view.buffer, bytes, sizeof(bytes)));
+        ASSERT_ARE_EQUAL(size_t, 1, currentCONSTBUFFER_refCount);
+
+        ///cleanup
+        MessageContentView_Release(&view);
+        ASSERT_IS_NULL(view.content);
+        ASSERT_ARE_EQUAL(size_t, 0, currentCONSTBUFFER_refCount);
+    }
+
+    /*Tests_SRS_MESSAGE_26_006: [If offset + size is greater than the size of view then MessageContentView_Slice shall fail and return a non-zero value.]*/
+    TEST_FUNCTION(MessageContentView_Slice_out_of_bounds_fails)
+    {
+        ///arrange
+        const unsigned char bytes[] = { 0x01, 0x02, 0x03, 0x04 };
+        MESSAGE_CONFIG c = { sizeof(bytes), bytes, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        MESSAGE_CONTENT_VIEW view;
+        MESSAGE_CONTENT_VIEW slice;
+        (void)Message_GetContentView(msg, &view);
+        umock_c_reset_all_calls();
+
+        ///act
+        int result1 = MessageContentView_Slice(&view, 2, 3, &slice);
+        int result2 = MessageContentView_Slice(&view, 5, 0, &slice);
+        int result3 = MessageContentView_Slice(&view, 1, (size_t)-1, &slice);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result3);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        MessageContentView_Release(&view);
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_26_007: [MessageContentView_Slice shall clone the content of view into slice.]*/
+    /*Tests_SRS_MESSAGE_26_009: [MessageContentView_Slice shall set slice to the size bytes at offset within view, without copying them, and return 0.]*/
+    TEST_FUNCTION(MessageContentView_Slice_of_a_slice_succeeds)
+    {
+        ///arrange
+        const unsigned char bytes[] = { 0x01, 0x02, 0x03, 0x04, 0x05 };
+        MESSAGE_CONFIG c = { sizeof(bytes), bytes, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        MESSAGE_CONTENT_VIEW view;
+        MESSAGE_CONTENT_VIEW slice1;
+        MESSAGE_CONTENT_VIEW slice2;
+        (void)Message_GetContentView(msg, &view);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        int result1 = MessageContentView_Slice(&view, 1, 4, &slice1);
+        int result2 = MessageContentView_Slice(&slice1, 2, 2, &slice2);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result1);
+        ASSERT_ARE_EQUAL(int, 0, result2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 3, slice2.offset);
+        ASSERT_ARE_EQUAL(size_t, 2, slice2.size);
+        ASSERT_IS_TRUE(slice2.buffer == view.buffer + 3);
+
+        ///cleanup
+        MessageContentView_Release(&slice2);
+        MessageContentView_Release(&slice1);
+        MessageContentView_Release(&view);
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_26_014: [The MessageContentView_Read functions shall read the value at offset within view, LE functions least significant byte first and BE functions most significant byte first, and return 0.]*/
+    TEST_FUNCTION(MessageContentView_Read_functions_honor_byte_order)
+    {
+        ///arrange
+        const unsigned char bytes[] =
+        {
+            0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+            0x00, 0x00, 0xC0, 0x3F /*1.5f, little endian*/
+        };
+        MESSAGE_CONFIG c = { sizeof(bytes), bytes, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        MESSAGE_CONTENT_VIEW view;
+        (void)Message_GetContentView(msg, &view);
+        uint8_t u8;
+        uint16_t u16le, u16be;
+        uint32_t u32le, u32be;
+        uint64_t u64le, u64be;
+        float f32le, f32be;
+        umock_c_reset_all_calls();
+
+        ///act
+        int result =
+            MessageContentView_ReadUInt8(&view, 8, &u8) +
+            MessageContentView_ReadUInt16LE(&view, 1, &u16le) +
+            MessageContentView_ReadUInt16BE(&view, 1, &u16be) +
+            MessageContentView_ReadUInt32LE(&view, 1, &u32le) +
+            MessageContentView_ReadUInt32BE(&view, 1, &u32be) +
+            MessageContentView_ReadUInt64LE(&view, 1, &u64le) +
+            MessageContentView_ReadUInt64BE(&view, 1, &u64be) +
+            MessageContentView_ReadFloatLE(&view, 9, &f32le) +
+            MessageContentView_ReadFloatBE(&view, 9, &f32be);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(int, 0x08, (int)u8);
+        ASSERT_ARE_EQUAL(int, 0x0201, (int)u16le);
+        ASSERT_ARE_EQUAL(int, 0x0102, (int)u16be);
+        ASSERT_IS_TRUE(u32le == 0x04030201);
+        ASSERT_IS_TRUE(u32be == 0x01020304);
+        ASSERT_IS_TRUE(u64le == 0x0807060504030201ULL);
+        ASSERT_IS_TRUE(u64be == 0x0102030405060708ULL);
+        ASSERT_IS_TRUE(f32le == 1.5f);
+        ASSERT_IS_TRUE(f32be != 1.5f);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        MessageContentView_Release(&view);
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_26_013: [If the value read would extend past the end of view then the MessageContentView_Read functions shall fail and return a non-zero value, leaving value unmodified.]*/
+    TEST_FUNCTION(MessageContentView_Read_past_the_end_fails)
+    {
+        ///arrange
+        const unsigned char bytes[] = { 0x01, 0x02, 0x03, 0x04 };
+        MESSAGE_CONFIG c = { sizeof(bytes), bytes, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        MESSAGE_CONTENT_VIEW view;
+        MESSAGE_CONTENT_VIEW slice;
+        (void)Message_GetContentView(msg, &view);
+        (void)MessageContentView_Slice(&view, 0, 2, &slice);
+        uint32_t u32 = 42;
+        uint16_t u16 = 42;
+        umock_c_reset_all_calls();
+
+        ///act
+        int result1 = MessageContentView_ReadUInt32LE(&view, 1, &u32);
+        int result2 = MessageContentView_ReadUInt16BE(&slice, 1, &u16);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+        ASSERT_IS_TRUE(u32 == 42);
+        ASSERT_IS_TRUE(u16 == 42);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        MessageContentView_Release(&slice);
+        MessageContentView_Release(&view);
+        Message_Destroy(msg);
+    }
+
     /*Tests_SRS_MESSAGE_02_017: [If message is NULL then Message_Destroy shall do nothing.] */
     TEST_FUNCTION(Message_Destroy_with_NULL_argument_does_nothing)
     {
@@ -1483,7 +1735,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         Message_Destroy(handle);
     }
 
-    /*Tests_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    /*Tests_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 or 0xA1 0x61 then Message_CreateFromByteArray shall fail and return NULL. ]*/
     TEST_FUNCTION(Message_CreateFromByteArray_when_first_byte_is_not_0xA1_fails)
     {
 
@@ -1499,8 +1751,8 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         ///cleanup
     }
 
-    /*Tests_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_when_second_byte_is_not_0x60_fails)
+    /*Tests_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 or 0xA1 0x61 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_when_second_byte_is_not_0x60_or_0x61_fails)
     {
 
         ///arrange
@@ -2152,4 +2404,697 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         Message_Destroy(messageHandle);
     }
 
+    /*derives a message from parent that neither sets nor removes properties*/
+    static MESSAGE_HANDLE derive_test_message(MESSAGE_HANDLE parent)
+    {
+        MESSAGE_DERIVE_CONFIG cfg = { NULL, NULL, 0 };
+        STRICT_EXPECTED_CALL(Map_Create(NULL))
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Create(NULL))
+            .SetReturn(TEST_REMOVED_MAP_HANDLE);
+        MESSAGE_HANDLE result = Message_Derive(parent, &cfg);
+        ASSERT_IS_NOT_NULL(result);
+        umock_c_reset_all_calls();
+        return result;
+    }
+
+    /*Tests_SRS_MESSAGE_26_015: [If parent or cfg is NULL, or cfg->removeProperties is NULL while cfg->removePropertiesCount is not zero, then Message_Derive shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_Derive_with_NULL_parent_fails)
+    {
+        ///arrange
+        MESSAGE_DERIVE_CONFIG cfg = { NULL, NULL, 0 };
+
+        ///act
+        MESSAGE_HANDLE result = Message_Derive(NULL, &cfg);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MESSAGE_26_015: [If parent or cfg is NULL, or cfg->removeProperties is NULL while cfg->removePropertiesCount is not zero, then Message_Derive shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_Derive_with_NULL_removeProperties_and_nonzero_count_fails)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_DERIVE_CONFIG cfg = { NULL, NULL, 1 };
+        umock_c_reset_all_calls();
+
+        ///act
+        MESSAGE_HANDLE result = Message_Derive(parent, &cfg);
+        MESSAGE_HANDLE result2 = Message_Derive(parent, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        ASSERT_IS_NULL(result2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_26_016: [A property in removeProperties shall be removed even if it was added when parent was derived.]*/
+    /*Tests_SRS_MESSAGE_26_017: [A property in setProperties shall be set even if it was removed, in removeProperties or when parent was derived.]*/
+    /*Tests_SRS_MESSAGE_26_023: [Message_Derive shall share the content and properties of parent by cloning their handles, and keep only the properties cfg changes.]*/
+    /*Tests_SRS_MESSAGE_26_027: [Otherwise, Message_Derive shall return a non-NULL handle with a ref count of "1".]*/
+    /*Tests_SRS_MESSAGE_26_029: [Message_Destroy shall destroy the property overlay of a derived message.]*/
+    TEST_FUNCTION(Message_Derive_happy_path)
+    {
+        ///arrange
+        char t = '3';
+        MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        const char* removeProperties[] = { "old" };
+        MESSAGE_DERIVE_CONFIG cfg = { (MAP_HANDLE)&cfg, removeProperties, 1 };
+        size_t one = 1;
+        const char* keys[] = { "new" };
+        const char* values[] = { "value" };
+        const char* const* *pkeys = (const char* const* *)&keys;
+        const char* const* *pvalues = (const char* const* *)&values;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Map_Create(NULL))
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Create(NULL))
+            .SetReturn(TEST_REMOVED_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Delete(TEST_MAP_HANDLE, "old"));
+        STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_REMOVED_MAP_HANDLE, "old", ""));
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&cfg, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
+            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
+            .CopyOutArgumentBuffer(4, &one, sizeof(one));
+        STRICT_EXPECTED_CALL(Map_Delete(TEST_REMOVED_MAP_HANDLE, "new"));
+        STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, "new", "value"));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_REMOVED_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_REMOVED_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE result = Message_Derive(parent, &cfg);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 2, currentCONSTBUFFER_refCount);
+
+        ///cleanup
+        Message_Destroy(parent);
+        Message_Destroy(result);
+        ASSERT_ARE_EQUAL(size_t, 0, currentCONSTBUFFER_refCount);
+    }
+
+    /*Tests_SRS_MESSAGE_26_018: [Message_Derive shall start from the overlay of parent, if parent was itself derived, so that a chain of derived messages shares a single set of properties.]*/
+    /*Tests_SRS_MESSAGE_26_028: [Message_Clone shall clone the property overlay of a derived message.]*/
+    TEST_FUNCTION(Message_Derive_from_a_derived_message_starts_from_its_overlay)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_HANDLE derived = derive_test_message(parent);
+        MESSAGE_DERIVE_CONFIG cfg = { NULL, NULL, 0 };
+
+        STRICT_EXPECTED_CALL(ConstMap_CloneWriteable(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(ConstMap_CloneWriteable(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .SetReturn(TEST_REMOVED_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_REMOVED_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_REMOVED_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG)) /*this is for Message_Clone*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE result = Message_Derive(derived, &cfg);
+        MESSAGE_HANDLE clone = Message_Clone(result);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(void_ptr, result, clone);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(clone);
+        Message_Destroy(result);
+        Message_Destroy(derived);
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_26_024: [If any underlying call fails, Message_Derive shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_Derive_fails_when_ConstMap_Create_fails)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_DERIVE_CONFIG cfg = { NULL, NULL, 0 };
+        umock_c_reset_all_calls();
+
+        whenShallConstMap_Create_fail = currentConstMap_Create_call + 2;
+        STRICT_EXPECTED_CALL(Map_Create(NULL))
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Create(NULL))
+            .SetReturn(TEST_REMOVED_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_REMOVED_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_REMOVED_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE result = Message_Derive(parent, &cfg);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_26_024: [If any underlying call fails, Message_Derive shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_Derive_fails_when_Map_Create_fails)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_DERIVE_CONFIG cfg = { NULL, NULL, 0 };
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Map_Create(NULL))
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Create(NULL))
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE result = Message_Derive(parent, &cfg);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_26_019: [If message or key is NULL then Message_GetProperty shall return NULL.]*/
+    TEST_FUNCTION(Message_GetProperty_with_NULL_message_fails)
+    {
+        ///act
+        const char* result = Message_GetProperty(NULL, "key");
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MESSAGE_26_022: [Otherwise Message_GetProperty shall return the value of the property in the message's own or shared properties, or NULL if there is no such property.]*/
+    TEST_FUNCTION(Message_GetProperty_of_a_message_reads_its_properties)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(ConstMap_GetValue(IGNORED_PTR_ARG, "key"))
+            .IgnoreArgument(1)
+            .SetReturn("value");
+
+        ///act
+        const char* result = Message_GetProperty(msg, "key");
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, "value", result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_26_020: [If the property was removed when the message was derived, Message_GetProperty shall return NULL.]*/
+    TEST_FUNCTION(Message_GetProperty_of_a_removed_property_returns_NULL)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_HANDLE derived = derive_test_message(parent);
+
+        STRICT_EXPECTED_CALL(ConstMap_ContainsKey(IGNORED_PTR_ARG, "key"))
+            .IgnoreArgument(1)
+            .SetReturn(true);
+
+        ///act
+        const char* result = Message_GetProperty(derived, "key");
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(derived);
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_26_021: [If the property was added or replaced when the message was derived, Message_GetProperty shall return its new value.]*/
+    TEST_FUNCTION(Message_GetProperty_of_an_overridden_property_returns_the_override)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_HANDLE derived = derive_test_message(parent);
+
+        STRICT_EXPECTED_CALL(ConstMap_ContainsKey(IGNORED_PTR_ARG, "key"))
+            .IgnoreArgument(1)
+            .SetReturn(false);
+        STRICT_EXPECTED_CALL(ConstMap_GetValue(IGNORED_PTR_ARG, "key"))
+            .IgnoreArgument(1)
+            .SetReturn("override");
+
+        ///act
+        const char* result = Message_GetProperty(derived, "key");
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, "override", result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(derived);
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_26_022: [Otherwise Message_GetProperty shall return the value of the property in the message's own or shared properties, or NULL if there is no such property.]*/
+    TEST_FUNCTION(Message_GetProperty_of_an_unchanged_property_reads_the_shared_properties)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_HANDLE derived = derive_test_message(parent);
+
+        STRICT_EXPECTED_CALL(ConstMap_ContainsKey(IGNORED_PTR_ARG, "key"))
+            .IgnoreArgument(1)
+            .SetReturn(false);
+        STRICT_EXPECTED_CALL(ConstMap_GetValue(IGNORED_PTR_ARG, "key"))
+            .IgnoreArgument(1)
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(ConstMap_GetValue(IGNORED_PTR_ARG, "key"))
+            .IgnoreArgument(1)
+            .SetReturn("shared");
+
+        ///act
+        const char* result = Message_GetProperty(derived, "key");
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, "shared", result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(derived);
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_26_025: [If message was derived, Message_GetProperties shall return a new CONSTMAP holding the properties it shares with its parent, less the removed ones, plus the overrides.]*/
+    TEST_FUNCTION(Message_GetProperties_of_a_derived_message_merges_the_overlay)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_HANDLE derived = derive_test_message(parent);
+        size_t one = 1;
+        const char* removedKeys[] = { "old" };
+        const char* removedValues[] = { "" };
+        const char* overrideKeys[] = { "new" };
+        const char* overrideValues[] = { "value" };
+        const char* const* *pRemovedKeys = (const char* const* *)&removedKeys;
+        const char* const* *pRemovedValues = (const char* const* *)&removedValues;
+        const char* const* *pOverrideKeys = (const char* const* *)&overrideKeys;
+        const char* const* *pOverrideValues = (const char* const* *)&overrideValues;
+
+        STRICT_EXPECTED_CALL(ConstMap_CloneWriteable(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pRemovedKeys, sizeof(char**))
+            .CopyOutArgumentBuffer(3, &pRemovedValues, sizeof(char**))
+            .CopyOutArgumentBuffer(4, &one, sizeof(one));
+        STRICT_EXPECTED_CALL(Map_Delete(TEST_MAP_HANDLE, "old"));
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pOverrideKeys, sizeof(char**))
+            .CopyOutArgumentBuffer(3, &pOverrideValues, sizeof(char**))
+            .CopyOutArgumentBuffer(4, &one, sizeof(one));
+        STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, "new", "value"));
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        CONSTMAP_HANDLE result = Message_GetProperties(derived);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        ConstMap_Destroy(result);
+        Message_Destroy(derived);
+        Message_Destroy(parent);
+    }
+
+    static MESSAGE_HANDLE create_typed_test_message(MESSAGE_CONFIG* c)
+    {
+        static const unsigned char raw[] = { 0x0A, 0xFF };
+        MESSAGE_TYPED_PROPERTY typed[3];
+        MESSAGE_HANDLE result;
+        typed[0].name = "seq";
+        typed[0].type = MESSAGE_PROPERTY_INT64;
+        typed[0].value.int64Value = -42;
+        typed[1].name = "temperature";
+        typed[1].type = MESSAGE_PROPERTY_DOUBLE;
+        typed[1].value.doubleValue = 21.5;
+        typed[2].name = "raw";
+        typed[2].type = MESSAGE_PROPERTY_BYTES;
+        typed[2].value.bytesValue.buffer = raw;
+        typed[2].value.bytesValue.size = sizeof(raw);
+        result = Message_CreateWithTypedProperties(c, typed, 3);
+        umock_c_reset_all_calls();
+        return result;
+    }
+
+    /*Tests_SRS_MESSAGE_26_030: [If cfg is NULL, field source of cfg is NULL and size is not zero, or typedProperties is NULL and typedPropertiesCount is not zero, then Message_CreateWithTypedProperties shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_CreateWithTypedProperties_with_NULL_typedProperties_and_nonzero_count_fails)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+
+        ///act
+        MESSAGE_HANDLE result = Message_CreateWithTypedProperties(&c, NULL, 1);
+        MESSAGE_HANDLE result2 = Message_CreateWithTypedProperties(NULL, NULL, 0);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        ASSERT_IS_NULL(result2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MESSAGE_26_032: [If a typed property has a NULL name, an unknown type, a NULL byte array of non-zero size, or the same name as another typed property or a property in sourceProperties, then Message_CreateWithTypedProperties shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_CreateWithTypedProperties_fails_when_a_typed_property_is_also_a_string_property)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_TYPED_PROPERTY typed;
+        bool exists = true;
+        typed.name = "seq";
+        typed.type = MESSAGE_PROPERTY_INT64;
+        typed.value.int64Value = 1;
+
+        STRICT_EXPECTED_CALL(Map_ContainsKey((MAP_HANDLE)&c, "seq", IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(3, &exists, sizeof(exists));
+
+        ///act
+        MESSAGE_HANDLE result = Message_CreateWithTypedProperties(&c, &typed, 1);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MESSAGE_26_031: [Message_CreateWithTypedProperties shall copy the typed properties, including their names and byte array values, into the message.]*/
+    /*Tests_SRS_MESSAGE_26_033: [Otherwise Message_CreateWithTypedProperties shall create the message as Message_Create does and return a non-NULL handle.]*/
+    /*Tests_SRS_MESSAGE_26_038: [The Message_GetProperty typed functions shall return the value of a typed property of the requested type that is not hidden, and return 0.]*/
+    /*Tests_SRS_MESSAGE_26_042: [Message_Destroy shall release the typed properties of the message.]*/
+    TEST_FUNCTION(Message_CreateWithTypedProperties_happy_path)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        char name[] = "seq";
+        unsigned char raw[] = { 1, 2, 3 };
+        MESSAGE_TYPED_PROPERTY typed[2];
+        int64_t seq;
+        const unsigned char* buffer;
+        size_t size;
+        typed[0].name = name;
+        typed[0].type = MESSAGE_PROPERTY_INT64;
+        typed[0].value.int64Value = INT64_MIN;
+        typed[1].name = "raw";
+        typed[1].type = MESSAGE_PROPERTY_BYTES;
+        typed[1].value.bytesValue.buffer = raw;
+        typed[1].value.bytesValue.size = sizeof(raw);
+
+        STRICT_EXPECTED_CALL(Map_ContainsKey((MAP_HANDLE)&c, "seq", IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Map_ContainsKey((MAP_HANDLE)&c, "raw", IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(NULL, 0));
+        STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&c));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE result = Message_CreateWithTypedProperties(&c, typed, 2);
+        name[0] = 'x';
+        raw[0] = 0;
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, 0, Message_GetPropertyInt64(result, "seq", &seq));
+        ASSERT_IS_TRUE(seq == INT64_MIN);
+        ASSERT_ARE_EQUAL(int, 0, Message_GetPropertyBytes(result, "raw", &buffer, &size));
+        ASSERT_ARE_EQUAL(size_t, sizeof(raw), size);
+        ASSERT_ARE_EQUAL(int, 1, (int)buffer[0]);
+
+        ///cleanup
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        Message_Destroy(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MESSAGE_26_039: [If the typed property does not have the requested type, the Message_GetProperty typed functions shall fail and return a non-zero value.]*/
+    TEST_FUNCTION(Message_GetPropertyDouble_of_an_int64_property_fails)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = create_typed_test_message(&c);
+        double value = 1.0;
+        const unsigned char* buffer;
+        size_t size;
+
+        ///act
+        int result = Message_GetPropertyDouble(msg, "seq", &value);
+        int result2 = Message_GetPropertyBytes(msg, "temperature", &buffer, &size);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+        ASSERT_IS_TRUE(value == 1.0);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_26_040: [Otherwise Message_GetPropertyInt64 and Message_GetPropertyDouble shall parse the string property Message_GetProperty returns, and fail and return a non-zero value if there is none or it is not entirely a decimal number in range.]*/
+    TEST_FUNCTION(Message_GetPropertyInt64_parses_a_string_property)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        int64_t value = 0;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(ConstMap_GetValue(IGNORED_PTR_ARG, "seq"))
+            .IgnoreArgument(1)
+            .SetReturn("1234567890123");
+        STRICT_EXPECTED_CALL(ConstMap_GetValue(IGNORED_PTR_ARG, "seq"))
+            .IgnoreArgument(1)
+            .SetReturn("12x");
+        STRICT_EXPECTED_CALL(ConstMap_GetValue(IGNORED_PTR_ARG, "seq"))
+            .IgnoreArgument(1)
+            .SetReturn("99999999999999999999");
+
+        ///act
+        int result = Message_GetPropertyInt64(msg, "seq", &value);
+        int result2 = Message_GetPropertyInt64(msg, "seq", &value);
+        int result3 = Message_GetPropertyInt64(msg, "seq", &value);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_IS_TRUE(value == 1234567890123LL);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result3);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_26_036: [If message has typed properties, Message_GetProperties shall return a new CONSTMAP that also holds each typed property that is not hidden, with int64 values in decimal, double values with 17 significant digits and byte arrays in lowercase hexadecimal.]*/
+    TEST_FUNCTION(Message_GetProperties_renders_typed_properties_as_strings)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = create_typed_test_message(&c);
+
+        STRICT_EXPECTED_CALL(ConstMap_CloneWriteable(IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, "seq", "-42"));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, "temperature", "21.5"));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, "raw", "0aff"));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        CONSTMAP_HANDLE result = Message_GetProperties(msg);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        ConstMap_Destroy(result);
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_26_045: [ Message_ToTypedByteArray shall serialize the message as Message_ToByteArray does, except that the header shall be 0xA1 0x61 and the typed properties that are not hidden shall follow the properties instead of being among them. ]*/
+    TEST_FUNCTION(Message_ToTypedByteArray_serializes_typed_properties)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_TYPED_PROPERTY typed;
+        MESSAGE_HANDLE msg;
+        unsigned char buf[sizeof(notFail__typed_1Int64Property_0bytes)];
+        size_t zero = 0;
+        const CONSTBUFFER bufferContent = { NULL, 0 };
+        typed.name = "n";
+        typed.type = MESSAGE_PROPERTY_INT64;
+        typed.value.int64Value = -2;
+        msg = Message_CreateWithTypedProperties(&c, &typed, 1);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .CopyOutArgumentBuffer(4, &zero, sizeof(zero));
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+
+        ///act
+        int32_t nbytes = Message_ToTypedByteArray(msg, buf, sizeof(buf));
+
+        ///assert
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__typed_1Int64Property_0bytes), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail__typed_1Int64Property_0bytes, sizeof(buf)));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_26_043: [ If the first two bytes of source are 0xA1 0x61, Message_CreateFromByteArray shall parse the typed properties that follow the properties and add them to the message as Message_CreateWithTypedProperties does. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_notFail__typed_1Int64Property_0bytes)
+    {
+        ///arrange
+        int64_t value;
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(Map_ContainsKey(TEST_MAP_HANDLE, "n", IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
+            .IgnoreArgument_source();
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__typed_1Int64Property_0bytes, sizeof(notFail__typed_1Int64Property_0bytes));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, 0, Message_GetPropertyInt64(handle, "n", &value));
+        ASSERT_IS_TRUE(value == -2);
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_with_a_typed_property_of_unknown_type_fails)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_typedPropertyWithUnknownType, sizeof(fail_typedPropertyWithUnknownType));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
 END_TEST_SUITE(gwmessage_ut)
@@ -1477,6 +1477,12 @@ TEST_FUNCTION(JavaModuleLoader_ParseConfigurationFromJson_failure_tests)
         .IgnoreArgument(1)
         .IgnoreArgument(2)
         .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_CDS_ARCHIVE_KEY))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_TIERED_STOP_AT_LEVEL_KEY));
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_INITIAL_HEAP_KEY));
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_MAX_HEAP_KEY));
+    STRICT_EXPECTED_CALL(json_object_get_boolean((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_PARALLEL_STARTUP_KEY));
     STRICT_EXPECTED_CALL(ModuleLoader_ParseBaseConfigurationFromJson(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
@@ -1500,7 +1506,12 @@ TEST_FUNCTION(JavaModuleLoader_ParseConfigurationFromJson_failure_tests)
             i != 24 && 
             i != 25 && 
             i != 26 && 
-            i != 27 )
+            i != 27 &&
+            i != 35 &&
+            i != 36 &&
+            i != 37 &&
+            i != 38 &&
+            i != 39 )
         {
             //arrange
             umock_c_negative_tests_reset();
@@ -1633,6 +1644,16 @@ TEST_FUNCTION(JavaModuleLoader_ParseConfigurationFromJson_sets_missing_fields)
         .SetReturn(NULL);
     STRICT_EXPECTED_CALL(json_array_get_count(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_CDS_ARCHIVE_KEY))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_TIERED_STOP_AT_LEVEL_KEY))
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_INITIAL_HEAP_KEY))
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_MAX_HEAP_KEY))
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(json_object_get_boolean((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_PARALLEL_STARTUP_KEY))
+        .SetReturn(-1);
     STRICT_EXPECTED_CALL(ModuleLoader_ParseBaseConfigurationFromJson(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
@@ -1662,6 +1683,11 @@ TEST_FUNCTION(JavaModuleLoader_ParseConfigurationFromJson_sets_missing_fields)
     ASSERT_IS_TRUE(options->debug == false);
     ASSERT_ARE_EQUAL(int, 0, options->debug_port);
     ASSERT_IS_TRUE(options->verbose == false);
+    ASSERT_IS_NULL(options->cds_archive);
+    ASSERT_ARE_EQUAL(int, 0, options->tiered_stop_at_level);
+    ASSERT_ARE_EQUAL(int, 0, options->initial_heap_mb);
+    ASSERT_ARE_EQUAL(int, 0, options->max_heap_mb);
+    ASSERT_IS_TRUE(options->parallel_startup == false);
 
     //Cleanup
     JavaModuleLoader_FreeConfiguration(IGNORED_PTR_ARG, result);
@@ -1762,6 +1788,18 @@ TEST_FUNCTION(JavaModuleLoader_ParseConfigurationFromJson_success)
     STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_CDS_ARCHIVE_KEY))
+        .SetReturn("app.jsa");
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, "app.jsa"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_TIERED_STOP_AT_LEVEL_KEY))
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_INITIAL_HEAP_KEY))
+        .SetReturn(64);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_MAX_HEAP_KEY))
+        .SetReturn(256);
+    STRICT_EXPECTED_CALL(json_object_get_boolean((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_PARALLEL_STARTUP_KEY))
+        .SetReturn(true);
     STRICT_EXPECTED_CALL(ModuleLoader_ParseBaseConfigurationFromJson(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
@@ -1781,6 +1819,11 @@ TEST_FUNCTION(JavaModuleLoader_ParseConfigurationFromJson_success)
     ASSERT_IS_TRUE(options->debug == true);
     ASSERT_ARE_EQUAL(int, 99, options->debug_port);
     ASSERT_IS_TRUE(options->verbose == true);
+    ASSERT_IS_NOT_NULL(options->cds_archive);
+    ASSERT_ARE_EQUAL(int, 1, options->tiered_stop_at_level);
+    ASSERT_ARE_EQUAL(int, 64, options->initial_heap_mb);
+    ASSERT_ARE_EQUAL(int, 256, options->max_heap_mb);
+    ASSERT_IS_TRUE(options->parallel_startup == true);
 
     //Cleanup
     JavaModuleLoader_FreeConfiguration(IGNORED_PTR_ARG, result);
@@ -1884,6 +1927,12 @@ TEST_FUNCTION(JavaModuleLoader_FreeConfiguration_frees_resources)
     STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_CDS_ARCHIVE_KEY))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_TIERED_STOP_AT_LEVEL_KEY));
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_INITIAL_HEAP_KEY));
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_MAX_HEAP_KEY));
+    STRICT_EXPECTED_CALL(json_object_get_boolean((const JSON_Object*)0x42, JAVA_MODULE_JVM_OPTIONS_PARALLEL_STARTUP_KEY));
     STRICT_EXPECTED_CALL(ModuleLoader_ParseBaseConfigurationFromJson(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
@@ -0,0 +1,492 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <pthread.h>
+#endif
+
+static size_t calloc_count = 0;
+
+void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void* my_gballoc_calloc(size_t nmemb, size_t size)
+{
+    calloc_count++;
+    return calloc(nmemb, size);
+}
+
+void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/gballoc.h"
+
+#undef ENABLE_MOCKS
+
+#include "lock_profile.h"
+
+//=============================================================================
+//Globals
+//=============================================================================
+
+#ifdef WIN32
+static TEST_MUTEX_HANDLE g_dllByDll;
+#endif
+static TEST_MUTEX_HANDLE g_testByTest;
+
+static const char SITE_A[] = "a.c:10 handle_lock";
+static const char SITE_B[] = "b.c:20 socket_lock";
+
+/* how long the mocked Lock and Condition_Wait take, to stand in for another thread */
+static unsigned int lock_delay_ms = 0;
+static unsigned int wait_delay_ms = 0;
+
+void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+static void sleep_ms(unsigned int milliseconds)
+{
+#ifdef WIN32
+    Sleep(milliseconds);
+#else
+    struct timespec duration;
+    duration.tv_sec = milliseconds / 1000;
+    duration.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+    (void)nanosleep(&duration, NULL);
+#endif
+}
+
+LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)my_gballoc_malloc(1);
+}
+
+LOCK_RESULT my_Lock(LOCK_HANDLE handle)
+{
+    if (lock_delay_ms != 0)
+    {
+        sleep_ms(lock_delay_ms);
+    }
+    return (handle != NULL) ? LOCK_OK : LOCK_ERROR;
+}
+
+LOCK_RESULT my_Unlock(LOCK_HANDLE handle)
+{
+    return (handle != NULL) ? LOCK_OK : LOCK_ERROR;
+}
+
+LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    LOCK_RESULT result = LOCK_ERROR;
+    if (handle != NULL)
+    {
+        my_gballoc_free(handle);
+        result = LOCK_OK;
+    }
+    return result;
+}
+
+COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    (void)handle;
+    (void)lock;
+    (void)timeout_milliseconds;
+    if (wait_delay_ms != 0)
+    {
+        sleep_ms(wait_delay_ms);
+    }
+    return COND_OK;
+}
+
+/* returns the statistics of site, failing the test when it was not profiled */
+static LOCK_PROFILE_STATS get_stats(const char* site)
+{
+    LOCK_PROFILE_STATS stats[8];
+    LOCK_PROFILE_STATS result;
+    size_t count = LockProfile_GetStats(stats, sizeof(stats) / sizeof(stats[0]));
+    size_t i;
+
+    ASSERT_IS_TRUE(count <= sizeof(stats) / sizeof(stats[0]));
+    (void)memset(&result, 0, sizeof(result));
+    for (i = 0; i < count; i++)
+    {
+        if (strcmp(stats[i].site, site) == 0)
+        {
+            result = stats[i];
+            break;
+        }
+    }
+    ASSERT_IS_NOT_NULL(result.site);
+    return result;
+}
+
+BEGIN_TEST_SUITE(lock_profile_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_stdint_register_types();
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+
+    // malloc/free hooks
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_calloc, my_gballoc_calloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    // Lock hooks
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock, my_Lock);
+    REGISTER_GLOBAL_MOCK_HOOK(Unlock, my_Unlock);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    lock_delay_ms = 0;
+    wait_delay_ms = 0;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(LockProfile_Lock_before_Init_only_locks)
+{
+    ///arrange
+    LOCK_HANDLE lock = (LOCK_HANDLE)0x42;
+    STRICT_EXPECTED_CALL(Lock(lock));
+    STRICT_EXPECTED_CALL(Unlock(lock));
+
+    ///act
+    LOCK_RESULT lock_result = LockProfile_Lock(lock, SITE_A);
+    LOCK_RESULT unlock_result = LockProfile_Unlock(lock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, LOCK_OK, lock_result);
+    ASSERT_ARE_EQUAL(int, LOCK_OK, unlock_result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, LockProfile_GetStats(NULL, 0));
+}
+
+/* runs before any successful LockProfile_Init: the profiler's lock is only created once */
+TEST_FUNCTION(LockProfile_Init_fails_when_Lock_Init_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(Lock_Init())
+        .SetReturn(NULL);
+
+    ///act
+    int result = LockProfile_Init();
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(LockProfile_Lock_counts_acquisitions_per_site)
+{
+    ///arrange
+    LOCK_HANDLE lock = (LOCK_HANDLE)0x42;
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+
+    ///act
+    (void)LockProfile_Lock(lock, SITE_A);
+    (void)LockProfile_Unlock(lock);
+    (void)LockProfile_Lock(lock, SITE_A);
+    (void)LockProfile_Unlock(lock);
+    (void)LockProfile_Lock(lock, SITE_B);
+    (void)LockProfile_Unlock(lock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, LockProfile_GetStats(NULL, 0));
+    ASSERT_ARE_EQUAL(uint64_t, 2, get_stats(SITE_A).acquisitions);
+    ASSERT_ARE_EQUAL(uint64_t, 1, get_stats(SITE_B).acquisitions);
+    ASSERT_ARE_EQUAL(uint64_t, 0, get_stats(SITE_A).contended_acquisitions);
+
+    ///cleanup
+    LockProfile_Deinit();
+}
+
+TEST_FUNCTION(LockProfile_GetStats_merges_sites_with_the_same_name)
+{
+    ///arrange
+    static const char same_site_1[] = "lock.h nodejs lock";
+    static const char same_site_2[] = "lock.h nodejs lock";
+    LOCK_HANDLE lock = (LOCK_HANDLE)0x42;
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+
+    ///act
+    (void)LockProfile_Lock(lock, same_site_1);
+    (void)LockProfile_Unlock(lock);
+    (void)LockProfile_Lock(lock, same_site_2);
+    (void)LockProfile_Unlock(lock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, LockProfile_GetStats(NULL, 0));
+    ASSERT_ARE_EQUAL(uint64_t, 2, get_stats(same_site_1).acquisitions);
+
+    ///cleanup
+    LockProfile_Deinit();
+}
+
+TEST_FUNCTION(LockProfile_Lock_does_not_count_a_failed_acquisition)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+
+    ///act
+    LOCK_RESULT result = LockProfile_Lock(NULL, SITE_A);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, LOCK_ERROR, result);
+    ASSERT_ARE_EQUAL(uint64_t, 0, get_stats(SITE_A).acquisitions);
+
+    ///cleanup
+    LockProfile_Deinit();
+}
+
+TEST_FUNCTION(LockProfile_Lock_counts_a_slow_acquisition_as_contended)
+{
+    ///arrange
+    LOCK_HANDLE lock = (LOCK_HANDLE)0x42;
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+    lock_delay_ms = 2;
+
+    ///act
+    (void)LockProfile_Lock(lock, SITE_A);
+    (void)LockProfile_Unlock(lock);
+
+    ///assert
+    LOCK_PROFILE_STATS stats = get_stats(SITE_A);
+    ASSERT_ARE_EQUAL(uint64_t, 1, stats.contended_acquisitions);
+    ASSERT_IS_TRUE(stats.max_wait_ns >= 2000000);
+    ASSERT_ARE_EQUAL(uint64_t, stats.max_wait_ns, stats.total_wait_ns);
+
+    ///cleanup
+    LockProfile_Deinit();
+}
+
+TEST_FUNCTION(LockProfile_Unlock_charges_hold_time_to_the_locking_site)
+{
+    ///arrange
+    LOCK_HANDLE lock = (LOCK_HANDLE)0x42;
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+
+    ///act
+    (void)LockProfile_Lock(lock, SITE_A);
+    sleep_ms(2);
+    (void)LockProfile_Unlock(lock);
+
+    ///assert
+    LOCK_PROFILE_STATS stats = get_stats(SITE_A);
+    ASSERT_IS_TRUE(stats.max_hold_ns >= 2000000);
+    ASSERT_ARE_EQUAL(uint64_t, stats.max_hold_ns, stats.total_hold_ns);
+
+    ///cleanup
+    LockProfile_Deinit();
+}
+
+TEST_FUNCTION(LockProfile_ConditionWait_does_not_count_the_wait_as_held)
+{
+    ///arrange
+    LOCK_HANDLE lock = (LOCK_HANDLE)0x42;
+    COND_HANDLE condition = (COND_HANDLE)0x43;
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+    (void)LockProfile_Lock(lock, SITE_A);
+    wait_delay_ms = 50;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Condition_Wait(condition, lock, 10));
+
+    ///act
+    COND_RESULT result = LockProfile_ConditionWait(condition, lock, 10);
+    (void)LockProfile_Unlock(lock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, COND_OK, result);
+    ASSERT_IS_TRUE(get_stats(SITE_A).total_hold_ns < 50000000);
+
+    ///cleanup
+    LockProfile_Deinit();
+}
+
+TEST_FUNCTION(LockProfile_Deinit_discards_the_statistics)
+{
+    ///arrange
+    LOCK_HANDLE lock = (LOCK_HANDLE)0x42;
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+    (void)LockProfile_Lock(lock, SITE_A);
+    (void)LockProfile_Unlock(lock);
+
+    ///act
+    LockProfile_Deinit();
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, LockProfile_GetStats(NULL, 0));
+
+    ///cleanup
+    LockProfile_Deinit();
+}
+
+TEST_FUNCTION(LockProfile_Deinit_keeps_the_statistics_until_the_last_reference)
+{
+    ///arrange
+    LOCK_HANDLE lock = (LOCK_HANDLE)0x42;
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+    (void)LockProfile_Lock(lock, SITE_A);
+    (void)LockProfile_Unlock(lock);
+
+    ///act
+    LockProfile_Deinit();
+
+    ///assert
+    ASSERT_ARE_EQUAL(uint64_t, 1, get_stats(SITE_A).acquisitions);
+
+    ///cleanup
+    LockProfile_Deinit();
+}
+
+TEST_FUNCTION(LockProfile_Deinit_keeps_a_lock_taken_before_it_valid)
+{
+    ///arrange
+    LOCK_HANDLE lock = (LOCK_HANDLE)0x42;
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+    (void)LockProfile_Lock(lock, SITE_A);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    ///act
+    LockProfile_Deinit();
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, LOCK_OK, LockProfile_Unlock(lock));
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+    (void)LockProfile_Lock(lock, SITE_A);
+    (void)LockProfile_Unlock(lock);
+    ASSERT_ARE_EQUAL(uint64_t, 1, get_stats(SITE_A).acquisitions);
+
+    ///cleanup
+    LockProfile_Deinit();
+}
+
+TEST_FUNCTION(LockProfile_GetStats_copies_at_most_count_sites)
+{
+    ///arrange
+    LOCK_PROFILE_STATS stats[2];
+    LOCK_HANDLE lock = (LOCK_HANDLE)0x42;
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+    (void)LockProfile_Lock(lock, SITE_A);
+    (void)LockProfile_Unlock(lock);
+    (void)LockProfile_Lock(lock, SITE_B);
+    (void)LockProfile_Unlock(lock);
+    (void)memset(stats, 0, sizeof(stats));
+
+    ///act
+    size_t result = LockProfile_GetStats(stats, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, result);
+    ASSERT_IS_NOT_NULL(stats[0].site);
+    ASSERT_IS_NULL(stats[1].site);
+
+    ///cleanup
+    LockProfile_Deinit();
+}
+
+#ifndef WIN32
+static void* lock_once_on_a_thread(void* lock)
+{
+    (void)LockProfile_Lock((LOCK_HANDLE)lock, SITE_A);
+    (void)LockProfile_Unlock((LOCK_HANDLE)lock);
+    return NULL;
+}
+
+static void run_thread_that_locks_once(LOCK_HANDLE lock)
+{
+    pthread_t thread;
+    ASSERT_ARE_EQUAL(int, 0, pthread_create(&thread, NULL, lock_once_on_a_thread, (void*)lock));
+    ASSERT_ARE_EQUAL(int, 0, pthread_join(thread, NULL));
+}
+
+TEST_FUNCTION(LockProfile_keeps_the_counters_of_an_exited_thread_and_reuses_its_block)
+{
+    ///arrange
+    LOCK_HANDLE lock = (LOCK_HANDLE)0x42;
+    ASSERT_ARE_EQUAL(int, 0, LockProfile_Init());
+    run_thread_that_locks_once(lock);
+    calloc_count = 0;
+
+    ///act
+    run_thread_that_locks_once(lock);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, calloc_count);
+    ASSERT_ARE_EQUAL(uint64_t, 2, get_stats(SITE_A).acquisitions);
+
+    ///cleanup
+    LockProfile_Deinit();
+}
+#endif
+
+END_TEST_SUITE(lock_profile_ut)
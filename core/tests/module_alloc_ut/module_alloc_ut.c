@@ -0,0 +1,477 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+static bool malloc_will_fail = false;
+static size_t malloc_fail_count = 0;
+static size_t malloc_count = 0;
+
+void* my_gballoc_malloc(size_t size)
+{
+    ++malloc_count;
+
+    void* result;
+    if (malloc_will_fail == true && malloc_count == malloc_fail_count)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = malloc(size);
+    }
+
+    return result;
+}
+
+void* my_gballoc_calloc(size_t nmemb, size_t size)
+{
+    return calloc(nmemb, size);
+}
+
+void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+
+#undef ENABLE_MOCKS
+
+#include "module_alloc.h"
+
+//=============================================================================
+//Globals
+//=============================================================================
+
+#ifdef WIN32
+static TEST_MUTEX_HANDLE g_dllByDll;
+#endif
+static TEST_MUTEX_HANDLE g_testByTest;
+
+void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)my_gballoc_malloc(1);
+}
+
+LOCK_RESULT my_Lock(LOCK_HANDLE handle)
+{
+    return (handle != NULL) ? LOCK_OK : LOCK_ERROR;
+}
+
+LOCK_RESULT my_Unlock(LOCK_HANDLE handle)
+{
+    return (handle != NULL) ? LOCK_OK : LOCK_ERROR;
+}
+
+LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    LOCK_RESULT result = LOCK_ERROR;
+    if (handle != NULL)
+    {
+        my_gballoc_free(handle);
+        result = LOCK_OK;
+    }
+    return result;
+}
+
+int my_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    *destination = (char*)my_gballoc_malloc(strlen(source) + 1);
+    strcpy(*destination, source);
+    return 0;
+}
+
+static MODULE_ALLOC_STATS get_stats(MODULE_ALLOC_TAG tag)
+{
+    MODULE_ALLOC_STATS stats;
+    int result = ModuleAlloc_GetStats(tag, &stats);
+    ASSERT_ARE_EQUAL(int, 0, result);
+    return stats;
+}
+
+BEGIN_TEST_SUITE(module_alloc_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_stdint_register_types();
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+
+    // malloc/free hooks
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_calloc, my_gballoc_calloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    // Lock hooks
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock, my_Lock);
+    REGISTER_GLOBAL_MOCK_HOOK(Unlock, my_Unlock);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    malloc_will_fail = false;
+    malloc_fail_count = 0;
+    malloc_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    (void)ModuleAlloc_SetThreadTag(NULL);
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* runs first: the locks are only created by the first successful ModuleAlloc_Init */
+TEST_FUNCTION(ModuleAlloc_Init_fails_when_Lock_Init_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(Lock_Init())
+        .SetReturn(NULL);
+
+    ///act
+    int result = ModuleAlloc_Init();
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(ModuleAlloc_CreateTag_fails_before_Init)
+{
+    ///act
+    MODULE_ALLOC_TAG tag = ModuleAlloc_CreateTag("module");
+
+    ///assert
+    ASSERT_IS_NULL(tag);
+}
+
+TEST_FUNCTION(ModuleAlloc_CreateTag_fails_with_NULL_name)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, ModuleAlloc_Init());
+
+    ///act
+    MODULE_ALLOC_TAG tag = ModuleAlloc_CreateTag(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(tag);
+
+    ///cleanup
+    ModuleAlloc_Deinit();
+}
+
+TEST_FUNCTION(ModuleAlloc_SetThreadTag_returns_previous_tag)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, ModuleAlloc_Init());
+    MODULE_ALLOC_TAG tag1 = ModuleAlloc_CreateTag("module1");
+    MODULE_ALLOC_TAG tag2 = ModuleAlloc_CreateTag("module2");
+
+    ///act
+    MODULE_ALLOC_TAG previous1 = ModuleAlloc_SetThreadTag(tag1);
+    MODULE_ALLOC_TAG previous2 = ModuleAlloc_SetThreadTag(tag2);
+
+    ///assert
+    ASSERT_IS_NULL(previous1);
+    ASSERT_ARE_EQUAL(void_ptr, tag1, previous2);
+    ASSERT_ARE_EQUAL(void_ptr, tag2, ModuleAlloc_GetThreadTag());
+
+    ///cleanup
+    (void)ModuleAlloc_SetThreadTag(NULL);
+    ModuleAlloc_DestroyTag(tag1);
+    ModuleAlloc_DestroyTag(tag2);
+    ModuleAlloc_Deinit();
+}
+
+TEST_FUNCTION(ModuleAlloc_Malloc_without_thread_tag_is_not_tracked)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, ModuleAlloc_Init());
+    MODULE_ALLOC_TAG tag = ModuleAlloc_CreateTag("module");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(10));
+
+    ///act
+    void* ptr = ModuleAlloc_Malloc(10);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(ptr);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, get_stats(tag).allocation_count);
+
+    ///cleanup
+    ModuleAlloc_Free(ptr);
+    ModuleAlloc_DestroyTag(tag);
+    ModuleAlloc_Deinit();
+}
+
+TEST_FUNCTION(ModuleAlloc_Malloc_charges_thread_tag)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, ModuleAlloc_Init());
+    MODULE_ALLOC_TAG tag = ModuleAlloc_CreateTag("module");
+    (void)ModuleAlloc_SetThreadTag(tag);
+
+    ///act
+    void* ptr1 = ModuleAlloc_Malloc(10);
+    void* ptr2 = ModuleAlloc_Calloc(4, 5);
+
+    ///assert
+    MODULE_ALLOC_STATS stats = get_stats(tag);
+    ASSERT_ARE_EQUAL(size_t, 30, stats.current_bytes);
+    ASSERT_ARE_EQUAL(size_t, 30, stats.peak_bytes);
+    ASSERT_ARE_EQUAL(size_t, 2, stats.allocation_count);
+    ASSERT_ARE_EQUAL(size_t, 0, stats.free_count);
+
+    ///cleanup
+    ModuleAlloc_Free(ptr1);
+    ModuleAlloc_Free(ptr2);
+    (void)ModuleAlloc_SetThreadTag(NULL);
+    ModuleAlloc_DestroyTag(tag);
+    ModuleAlloc_Deinit();
+}
+
+TEST_FUNCTION(ModuleAlloc_Free_credits_allocating_tag_from_any_thread_tag)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, ModuleAlloc_Init());
+    MODULE_ALLOC_TAG tag1 = ModuleAlloc_CreateTag("module1");
+    MODULE_ALLOC_TAG tag2 = ModuleAlloc_CreateTag("module2");
+    (void)ModuleAlloc_SetThreadTag(tag1);
+    void* ptr = ModuleAlloc_Malloc(10);
+    (void)ModuleAlloc_SetThreadTag(tag2);
+
+    ///act
+    ModuleAlloc_Free(ptr);
+
+    ///assert
+    MODULE_ALLOC_STATS stats1 = get_stats(tag1);
+    MODULE_ALLOC_STATS stats2 = get_stats(tag2);
+    ASSERT_ARE_EQUAL(size_t, 0, stats1.current_bytes);
+    ASSERT_ARE_EQUAL(size_t, 10, stats1.peak_bytes);
+    ASSERT_ARE_EQUAL(size_t, 1, stats1.free_count);
+    ASSERT_ARE_EQUAL(size_t, 0, stats2.free_count);
+
+    ///cleanup
+    (void)ModuleAlloc_SetThreadTag(NULL);
+    ModuleAlloc_DestroyTag(tag1);
+    ModuleAlloc_DestroyTag(tag2);
+    ModuleAlloc_Deinit();
+}
+
+TEST_FUNCTION(ModuleAlloc_Free_of_untracked_pointer_frees_it_without_locking)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, ModuleAlloc_Init());
+    void* ptr = my_gballoc_malloc(10);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(ptr));
+
+    ///act
+    ModuleAlloc_Free(ptr);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    ModuleAlloc_Deinit();
+}
+
+TEST_FUNCTION(ModuleAlloc_Realloc_keeps_allocating_tag)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, ModuleAlloc_Init());
+    MODULE_ALLOC_TAG tag1 = ModuleAlloc_CreateTag("module1");
+    MODULE_ALLOC_TAG tag2 = ModuleAlloc_CreateTag("module2");
+    (void)ModuleAlloc_SetThreadTag(tag1);
+    void* ptr = ModuleAlloc_Malloc(10);
+    (void)ModuleAlloc_SetThreadTag(tag2);
+
+    ///act
+    ptr = ModuleAlloc_Realloc(ptr, 100);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(ptr);
+    MODULE_ALLOC_STATS stats1 = get_stats(tag1);
+    MODULE_ALLOC_STATS stats2 = get_stats(tag2);
+    ASSERT_ARE_EQUAL(size_t, 100, stats1.current_bytes);
+    ASSERT_ARE_EQUAL(size_t, 100, stats1.peak_bytes);
+    ASSERT_ARE_EQUAL(size_t, 1, stats1.allocation_count);
+    ASSERT_ARE_EQUAL(size_t, 0, stats2.allocation_count);
+
+    ///cleanup
+    ModuleAlloc_Free(ptr);
+    (void)ModuleAlloc_SetThreadTag(NULL);
+    ModuleAlloc_DestroyTag(tag1);
+    ModuleAlloc_DestroyTag(tag2);
+    ModuleAlloc_Deinit();
+}
+
+TEST_FUNCTION(ModuleAlloc_budget_overrun_is_counted_once)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, ModuleAlloc_Init());
+    MODULE_ALLOC_TAG tag = ModuleAlloc_CreateTag("module");
+    ModuleAlloc_SetBudget(tag, 15);
+    (void)ModuleAlloc_SetThreadTag(tag);
+
+    ///act
+    void* ptr1 = ModuleAlloc_Malloc(10);
+    void* ptr2 = ModuleAlloc_Malloc(10);
+    void* ptr3 = ModuleAlloc_Malloc(10);
+
+    ///assert
+    MODULE_ALLOC_STATS stats = get_stats(tag);
+    ASSERT_ARE_EQUAL(size_t, 15, stats.budget_bytes);
+    ASSERT_ARE_EQUAL(size_t, 1, stats.budget_exceeded_count);
+
+    ///cleanup
+    ModuleAlloc_Free(ptr1);
+    ModuleAlloc_Free(ptr2);
+    ModuleAlloc_Free(ptr3);
+    (void)ModuleAlloc_SetThreadTag(NULL);
+    ModuleAlloc_DestroyTag(tag);
+    ModuleAlloc_Deinit();
+}
+
+TEST_FUNCTION(ModuleAlloc_budget_overrun_is_counted_again_after_recovering)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, ModuleAlloc_Init());
+    MODULE_ALLOC_TAG tag = ModuleAlloc_CreateTag("module");
+    ModuleAlloc_SetBudget(tag, 15);
+    (void)ModuleAlloc_SetThreadTag(tag);
+    void* ptr1 = ModuleAlloc_Malloc(20);
+    ModuleAlloc_Free(ptr1);
+
+    ///act
+    void* ptr2 = ModuleAlloc_Malloc(20);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, get_stats(tag).budget_exceeded_count);
+
+    ///cleanup
+    ModuleAlloc_Free(ptr2);
+    (void)ModuleAlloc_SetThreadTag(NULL);
+    ModuleAlloc_DestroyTag(tag);
+    ModuleAlloc_Deinit();
+}
+
+TEST_FUNCTION(ModuleAlloc_Malloc_succeeds_when_tracking_fails)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, ModuleAlloc_Init());
+    MODULE_ALLOC_TAG tag = ModuleAlloc_CreateTag("module");
+    (void)ModuleAlloc_SetThreadTag(tag);
+    malloc_will_fail = true;
+    malloc_fail_count = malloc_count + 2;
+
+    ///act
+    void* ptr = ModuleAlloc_Malloc(10);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(ptr);
+    ASSERT_ARE_EQUAL(size_t, 0, get_stats(tag).allocation_count);
+
+    ///cleanup
+    malloc_will_fail = false;
+    ModuleAlloc_Free(ptr);
+    (void)ModuleAlloc_SetThreadTag(NULL);
+    ModuleAlloc_DestroyTag(tag);
+    ModuleAlloc_Deinit();
+}
+
+TEST_FUNCTION(ModuleAlloc_Free_after_Deinit_frees_tracked_pointer)
+{
+    ///arrange
+    ASSERT_ARE_EQUAL(int, 0, ModuleAlloc_Init());
+    MODULE_ALLOC_TAG tag = ModuleAlloc_CreateTag("module");
+    (void)ModuleAlloc_SetThreadTag(tag);
+    void* ptr = ModuleAlloc_Malloc(10);
+    (void)ModuleAlloc_SetThreadTag(NULL);
+    ModuleAlloc_Deinit();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(ptr));
+
+    ///act
+    ModuleAlloc_Free(ptr);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(ModuleAlloc_GetStats_fails_with_NULL_arguments)
+{
+    ///arrange
+    MODULE_ALLOC_STATS stats;
+    ASSERT_ARE_EQUAL(int, 0, ModuleAlloc_Init());
+    MODULE_ALLOC_TAG tag = ModuleAlloc_CreateTag("module");
+
+    ///act
+    int result1 = ModuleAlloc_GetStats(NULL, &stats);
+    int result2 = ModuleAlloc_GetStats(tag, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+
+    ///cleanup
+    ModuleAlloc_DestroyTag(tag);
+    ModuleAlloc_Deinit();
+}
+
+END_TEST_SUITE(module_alloc_ut)
@@ -71,6 +71,7 @@ MOCKABLE_FUNCTION(, JSON_Value_Type, json_value_get_type, const JSON_Value*, val
 static const size_t g_enabled_loaders[] =
 {
     1       // native loader
+    , 1     // static loader
 #ifdef NODE_BINDING_ENABLED
     , 1
 #endif
@@ -212,6 +213,24 @@ MOCK_FUNCTION_END(&Dynamic_Module_Loader)
 }
 #endif
 
+static MODULE_LOADER Static_Module_Loader =
+{
+    STATIC,
+    "static",
+    NULL,
+    &Fake_Module_Loader_API
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+MOCK_FUNCTION_WITH_CODE(, const MODULE_LOADER*, StaticLoader_Get)
+MOCK_FUNCTION_END(&Static_Module_Loader)
+#ifdef __cplusplus
+}
+#endif
+
 static MODULE_LOADER Outprocess_Module_Loader =
 {
 	OUTPROCESS,
@@ -525,6 +544,7 @@ TEST_FUNCTION(ModuleLoader_Initialize_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(VECTOR_create(sizeof(MODULE_LOADER*)));
 	STRICT_EXPECTED_CALL(DynamicLoader_Get());
+    STRICT_EXPECTED_CALL(StaticLoader_Get());
 #ifdef NODE_BINDING_ENABLED
     STRICT_EXPECTED_CALL(NodeLoader_Get());
 #endif
@@ -1301,6 +1321,7 @@ TEST_FUNCTION(ModuleLoader_GetDefaultLoaderForType_succeeds)
     MODULE_LOADER_TYPE inputs[] =
     {
         NATIVE
+        , STATIC
 #ifdef JAVA_BINDING_ENABLED
         , JAVA
 #endif
@@ -1358,8 +1379,8 @@ TEST_FUNCTION(ModuleLoader_ParseType_returns_UNKNOWN_for_unknown_loader_type)
 TEST_FUNCTION(ModuleLoader_ParseType_succeeds)
 {
     // arrange
-    char* inputs[] = { "native", "node", "java", "dotnet", "dotnetcore", "outprocess" };
-    MODULE_LOADER_TYPE expected[] = { NATIVE, NODEJS, JAVA, DOTNET, DOTNETCORE, OUTPROCESS };
+    char* inputs[] = { "native", "node", "java", "dotnet", "dotnetcore", "outprocess", "static" };
+    MODULE_LOADER_TYPE expected[] = { NATIVE, NODEJS, JAVA, DOTNET, DOTNETCORE, OUTPROCESS, STATIC };
 
     for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
     {
@@ -1375,8 +1396,8 @@ TEST_FUNCTION(ModuleLoader_ParseType_succeeds)
 TEST_FUNCTION(ModuleLoader_IsDefaultLoader_succeeds)
 {
     // arrange
-    char* inputs[] = { "native", "node", "java", "dotnet", "dotnetcore", "outprocess", "boo" };
-    bool expected[] = { true, true, true, true, true, true, false };
+    char* inputs[] = { "native", "node", "java", "dotnet", "dotnetcore", "outprocess", "static", "boo" };
+    bool expected[] = { true, true, true, true, true, true, true, false };
 
     for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
     {
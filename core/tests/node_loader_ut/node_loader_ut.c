@@ -801,6 +801,10 @@ TEST_FUNCTION(NodeModuleLoader_ParseEntrypointFromJson_succeeds)
         .SetReturn("foo.js");
     STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(NODE_LOADER_ENTRYPOINT)));
     STRICT_EXPECTED_CALL(STRING_construct("foo.js"));
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x43, "isolate"))
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x43, "code.cache"))
+        .SetReturn(NULL);
 
     // act
     void* result = NodeModuleLoader_ParseEntrypointFromJson(IGNORED_PTR_ARG, (const JSON_Value*)0x42);
@@ -813,6 +817,67 @@ TEST_FUNCTION(NodeModuleLoader_ParseEntrypointFromJson_succeeds)
     NodeModuleLoader_FreeEntrypoint(IGNORED_PTR_ARG, result);
 }
 
+//Tests_SRS_NODE_MODULE_LOADER_26_001: [ NodeModuleLoader_ParseEntrypointFromJson shall read the optional number isolate, defaulting to 0 when it does not exist. ]
+//Tests_SRS_NODE_MODULE_LOADER_26_003: [ NodeModuleLoader_ParseEntrypointFromJson shall read the optional string code.cache. ]
+TEST_FUNCTION(NodeModuleLoader_ParseEntrypointFromJson_parses_isolate_and_code_cache)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(json_value_get_type((const JSON_Value*)0x42))
+        .SetReturn(JSONObject);
+    STRICT_EXPECTED_CALL(json_value_get_object((const JSON_Value*)0x42))
+        .SetReturn((JSON_Object*)0x43);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x43, "main.path"))
+        .SetReturn("foo.js");
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(NODE_LOADER_ENTRYPOINT)));
+    STRICT_EXPECTED_CALL(STRING_construct("foo.js"));
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x43, "isolate"))
+        .SetReturn(2);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x43, "code.cache"))
+        .SetReturn("foo.cache");
+    STRICT_EXPECTED_CALL(STRING_construct("foo.cache"));
+
+    // act
+    NODE_LOADER_ENTRYPOINT* result = (NODE_LOADER_ENTRYPOINT*)NodeModuleLoader_ParseEntrypointFromJson(IGNORED_PTR_ARG, (const JSON_Value*)0x42);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 2, result->isolate);
+    ASSERT_ARE_EQUAL(char_ptr, "foo.cache", real_STRING_c_str(result->codeCachePath));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    NodeModuleLoader_FreeEntrypoint(IGNORED_PTR_ARG, result);
+}
+
+//Tests_SRS_NODE_MODULE_LOADER_26_002: [ NodeModuleLoader_ParseEntrypointFromJson shall return NULL if isolate is negative. ]
+TEST_FUNCTION(NodeModuleLoader_ParseEntrypointFromJson_returns_NULL_when_isolate_is_negative)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(json_value_get_type((const JSON_Value*)0x42))
+        .SetReturn(JSONObject);
+    STRICT_EXPECTED_CALL(json_value_get_object((const JSON_Value*)0x42))
+        .SetReturn((JSON_Object*)0x43);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x43, "main.path"))
+        .SetReturn("foo.js");
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(NODE_LOADER_ENTRYPOINT)));
+    STRICT_EXPECTED_CALL(STRING_construct("foo.js"));
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x43, "isolate"))
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x43, "code.cache"))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // act
+    void* result = NodeModuleLoader_ParseEntrypointFromJson(IGNORED_PTR_ARG, (const JSON_Value*)0x42);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 //Tests_SRS_NODE_MODULE_LOADER_13_016: [ NodeModuleLoader_FreeEntrypoint shall do nothing if entrypoint is NULL. ]
 TEST_FUNCTION(NodeModuleLoader_FreeEntrypoint_does_nothing_when_entrypoint_is_NULL)
 {
@@ -835,6 +900,10 @@ TEST_FUNCTION(NodeModuleLoader_FreeEntrypoint_frees_resources)
         .SetReturn("foo.js");
     STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(NODE_LOADER_ENTRYPOINT)));
     STRICT_EXPECTED_CALL(STRING_construct("foo.js"));
+    STRICT_EXPECTED_CALL(json_object_get_number((const JSON_Object*)0x43, "isolate"))
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x43, "code.cache"))
+        .SetReturn(NULL);
 
     void* entrypoint = NodeModuleLoader_ParseEntrypointFromJson(IGNORED_PTR_ARG, (const JSON_Value*)0x42);
     ASSERT_IS_NOT_NULL(entrypoint);
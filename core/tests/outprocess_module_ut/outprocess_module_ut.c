@@ -47,6 +47,7 @@ void my_gballoc_free(void* ptr)
 #include <nanomsg/reqrep.h>
 
 #include "message.h"
+#include "gateway_timer.h"
 #include "real_strings.h"
 
 
@@ -203,6 +204,24 @@ MOCK_FUNCTION_WITH_CODE(, int, nn_freemsg, void *, msg)
 my_gballoc_free(msg);
 MOCK_FUNCTION_END(free_result)
 
+// gateway timer mocks
+static GATEWAY_TIMER_CALLBACK control_poll_to_call;
+static void* control_poll_context;
+
+MOCK_FUNCTION_WITH_CODE(, int, GatewayTimer_Init)
+MOCK_FUNCTION_END(0)
+
+MOCK_FUNCTION_WITH_CODE(, void, GatewayTimer_Deinit)
+MOCK_FUNCTION_END()
+
+MOCK_FUNCTION_WITH_CODE(, GATEWAY_TIMER_HANDLE, GatewayTimer_Schedule, unsigned int, delay_ms, unsigned int, period_ms, GATEWAY_TIMER_CALLBACK, callback, void*, context)
+	control_poll_to_call = callback;
+	control_poll_context = context;
+MOCK_FUNCTION_END((GATEWAY_TIMER_HANDLE)0x43)
+
+MOCK_FUNCTION_WITH_CODE(, void, GatewayTimer_Cancel, GATEWAY_TIMER_HANDLE, timer)
+MOCK_FUNCTION_END()
+
 //Thread API mocks
 #define NUMMOCKTHREADS 6
 static THREAD_START_FUNC thread_func_to_call[NUMMOCKTHREADS];
@@ -372,6 +391,8 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_UMOCK_ALIAS_TYPE(MODULE_API_VERSION, int);
 	REGISTER_UMOCK_ALIAS_TYPE(BROKER_RESULT, int);
 	REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+	REGISTER_UMOCK_ALIAS_TYPE(GATEWAY_TIMER_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(GATEWAY_TIMER_CALLBACK, void*);
 
 	// STRING
 	REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, real_STRING_construct);
@@ -459,6 +480,9 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 		call_thread_function_on_join[t] = 0;
 	}
 
+	control_poll_to_call = NULL;
+	control_poll_context = NULL;
+
 	memset(&global_control_msg, 0, sizeof(CONTROL_MESSAGE_MODULE_CREATE));
 }
 
@@ -2441,7 +2465,7 @@ TEST_FUNCTION(Outprocess_Start_does_nothing_with_null)
 /*Tests_SRS_OUTPROCESS_MODULE_17_017: [ This function shall ensure thread safety on execution. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_018: [ This function shall create a thread to handle receiving messages from module host. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_043: [ This function shall create a thread to handle outgoing gateway messages to the module host. ]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_044: [ This function shall create a thread to handle receiving messages from module host. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_044: [ This function shall schedule a poll of the control channel every 250 ms on the gateway timer service. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_019: [ This function shall send a Start Message on the control channel. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_021: [ This function shall free any resources created. ]*/
 TEST_FUNCTION(Outprocess_Start_success)
@@ -2460,8 +2484,10 @@ TEST_FUNCTION(Outprocess_Start_success)
 		.IgnoreAllArguments();
 	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
-	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(GatewayTimer_Init());
+	STRICT_EXPECTED_CALL(GatewayTimer_Schedule(250, 250, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3)
+		.IgnoreArgument(4);
 	setup_start_or_destroy_message();
 	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
 
@@ -2493,8 +2519,10 @@ TEST_FUNCTION(Outprocess_Start_nn_send_fail)
 		.IgnoreAllArguments();
 	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
-	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(GatewayTimer_Init());
+	STRICT_EXPECTED_CALL(GatewayTimer_Schedule(250, 250, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3)
+		.IgnoreArgument(4);
 	setup_start_or_destroy_message();
 	should_nn_send_fail = true;
 	STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, 0))
@@ -2514,7 +2542,7 @@ TEST_FUNCTION(Outprocess_Start_nn_send_fail)
 }
 
 /*Tests_SRS_OUTPROCESS_MODULE_17_021: [ This function shall free any resources created. ]*/
-TEST_FUNCTION(Outprocess_Start_thread3_create_fails)
+TEST_FUNCTION(Outprocess_Start_control_poll_schedule_fails)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
@@ -2530,10 +2558,43 @@ TEST_FUNCTION(Outprocess_Start_thread3_create_fails)
 		.IgnoreAllArguments();
 	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
-	currentThreadAPI_Create_call = 0;
-	whenShallThreadAPI_Create_fail = 3;
+	STRICT_EXPECTED_CALL(GatewayTimer_Init());
+	STRICT_EXPECTED_CALL(GatewayTimer_Schedule(250, 250, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3)
+		.IgnoreArgument(4)
+		.SetReturn((GATEWAY_TIMER_HANDLE)NULL);
+	STRICT_EXPECTED_CALL(GatewayTimer_Deinit());
+
+	///act
+	Module_Start(module);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_021: [ This function shall free any resources created. ]*/
+TEST_FUNCTION(Outprocess_Start_timer_service_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
 	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(GatewayTimer_Init())
+		.SetReturn(1);
 
 	///act
 	Module_Start(module);
@@ -2635,6 +2696,12 @@ static void teardown_a_thread(bool needs_join, bool lock_fail)
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
 }
 
+static void teardown_control_timer(void)
+{
+	STRICT_EXPECTED_CALL(GatewayTimer_Cancel((GATEWAY_TIMER_HANDLE)0x43));
+	STRICT_EXPECTED_CALL(GatewayTimer_Deinit());
+}
+
 /*Tests_SRS_OUTPROCESS_MODULE_17_027: [ This function shall ensure thread safety on execution. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_028: [ This function shall construct a Destroy Message. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_029: [ This function shall send the Destroy Message on the control channel. ]*/
@@ -2646,7 +2713,8 @@ static void teardown_a_thread(bool needs_join, bool lock_fail)
 /*Tests_SRS_OUTPROCESS_MODULE_17_049: [ This function shall signal the outgoing gateway message thread to close. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_050: [ This function shall signal the control thread to close. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_051: [ This function shall wait for the outgoing gateway message thread to complete. ]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_052: [ This function shall wait for the control thread to complete. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_052: [ This function shall wait for any reattach thread of the control poll to complete. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_065: [ This function shall cancel the control poll timer and release the gateway timer service before waiting for any reattach thread. ]*/
 TEST_FUNCTION(Outprocess_Destroy_success)
 {
 	OUTPROCESS_MODULE_CONFIG config;
@@ -2668,11 +2736,10 @@ TEST_FUNCTION(Outprocess_Destroy_success)
 	STRICT_EXPECTED_CALL(nn_close(1));
 	STRICT_EXPECTED_CALL(nn_close(2));
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	//thread_create order: async, msg_rec, msg_send, control
-	//thread join order: async, msg_rec, msg_send, control, async
+	//thread_create order: async, msg_rec, msg_send
+	//thread join order: async, msg_rec, msg_send; the control poll is a timer
 	call_thread_function_on_join[2] = 2;
 	call_thread_function_on_join[3] = 3;
-	call_thread_function_on_join[4] = 4;
 	//teardown_a_thread(true, false);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -2693,15 +2760,8 @@ TEST_FUNCTION(Outprocess_Destroy_success)
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	//teardown_a_thread(true, false);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	teardown_control_timer();
+	teardown_a_thread(false, false); //no reattach thread
 	teardown_a_thread(false, false); //async should be closed and NULL
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -2762,7 +2822,8 @@ TEST_FUNCTION(Outprocess_Destroy_send_lock_join_fails)
 	thread_join_result[3] = THREADAPI_ERROR;
 	teardown_a_thread(true, true);
 	teardown_a_thread(true, true);
-	teardown_a_thread(true, true);
+	teardown_control_timer();
+	teardown_a_thread(false, true);
 	teardown_a_thread(true, true); //async won't be closed.
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -2807,7 +2868,8 @@ TEST_FUNCTION(Outprocess_Destroy_destroy_message_alloc_fails)
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	teardown_a_thread(true, false);
 	teardown_a_thread(true, false);
-	teardown_a_thread(true, false);
+	teardown_control_timer();
+	teardown_a_thread(false, false);
 	teardown_a_thread(false, false);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -2849,7 +2911,8 @@ TEST_FUNCTION(Outprocess_Destroy_destroy_message_to_array_fails)
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	teardown_a_thread(true, false);
 	teardown_a_thread(true, false);
-	teardown_a_thread(true, false);
+	teardown_control_timer();
+	teardown_a_thread(false, false);
 	teardown_a_thread(false, false);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -3437,10 +3500,11 @@ TEST_FUNCTION(Outprocess_control_thread_does_nothing_with_nothing)
 
 
 	// act
-	//fourth thread created is control thread
-	thread_func_to_call[4](NULL);
+	//the control poll is scheduled on the gateway timer
+	bool result = control_poll_to_call(NULL);
 
 	// assert 
+	ASSERT_IS_FALSE(result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//ablution
@@ -3472,15 +3536,12 @@ TEST_FUNCTION(Outprocess_control_thread_success)
 		.IgnoreAllArguments();
 	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(250));
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(LOCK_ERROR);
 
 	// act
-	//fourth thread created is control message thread
-	thread_func_to_call[4](thread_func_args[4]);
+	bool result = control_poll_to_call(control_poll_context);
 
 	// assert 
+	ASSERT_IS_TRUE(result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//ablution
@@ -3492,6 +3553,8 @@ TEST_FUNCTION(Outprocess_control_thread_success)
 /*Tests_SRS_OUTPROCESS_MODULE_17_059 : [If a Module Reply message has been received, and the status indicates the module has failed or has been terminated, this thread shall attempt to restart communications with module host process.]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_060 : [Once the control channel has been restarted, it shall follow the same process in Outprocess_Create to send a Create Message to the module host.]*/
 /*Tests_SRS_OUTPROCESS_MODULE_24_061: [ Once the control channel has been restarted and Create Message was sent, it shall send a Start Message to the module host. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_062: [ The reattach shall run on a thread of its own, so that waiting on the module host does not hold up the gateway timer service. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_063: [ Once the reattach attempt completes, the next poll shall join the reattach thread, and shall start a new attempt if the previous one failed. ]*/
 TEST_FUNCTION(Outprocess_control_thread_restart_success)
 {
 	// arrange
@@ -3510,7 +3573,7 @@ TEST_FUNCTION(Outprocess_control_thread_restart_success)
 	Module_Start(module);
 	umock_c_reset_all_calls();
 
-	//1st pass: status is bad
+	//1st poll: status is bad
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -3520,12 +3583,15 @@ TEST_FUNCTION(Outprocess_control_thread_restart_success)
 		.IgnoreAllArguments()
 		.SetReturn((CONTROL_MESSAGE*)&remote_died);
 	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(250));
-	// 2nd pass:needs_to_attach is set.
+	// 2nd poll: needs_to_attach is set, spawn the reattach thread.
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	// resend create message
+	// reattach thread: resend create message
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	setup_create_create_message(&config);
@@ -3544,15 +3610,31 @@ TEST_FUNCTION(Outprocess_control_thread_restart_success)
 		.IgnoreArgument(1);
     setup_start_or_destroy_message();
     STRICT_EXPECTED_CALL(nn_send(2, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
-	//bail out
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(LOCK_ERROR);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	// 3rd poll: join the reattach thread and go back to receiving
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	when_shall_nn_recv_fail = current_nn_recv_index + 3;
+	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(nn_errno()).SetReturn(EAGAIN);
 
 	// act
-	//fourth thread created is control message thread
-	thread_func_to_call[4](thread_func_args[4]);
+	bool result1 = control_poll_to_call(control_poll_context);
+	bool result2 = control_poll_to_call(control_poll_context);
+	//fourth thread created is the reattach thread
+	int thread_result = thread_func_to_call[4](thread_func_args[4]);
+	bool result3 = control_poll_to_call(control_poll_context);
 
 	// assert 
+	ASSERT_IS_TRUE(result1);
+	ASSERT_IS_TRUE(result2);
+	ASSERT_ARE_EQUAL(int, 0, thread_result);
+	ASSERT_IS_TRUE(result3);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//ablution
@@ -3563,6 +3645,7 @@ TEST_FUNCTION(Outprocess_control_thread_restart_success)
 /*Tests_SRS_OUTPROCESS_MODULE_17_058 : [If a message has been received, it shall look for a Module Reply message.]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_059 : [If a Module Reply message has been received, and the status indicates the module has failed or has been terminated, this thread shall attempt to restart communications with module host process.]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_060 : [Once the control channel has been restarted, it shall follow the same process in Outprocess_Create to send a Create Message to the module host.]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_063: [ Once the reattach attempt completes, the next poll shall join the reattach thread, and shall start a new attempt if the previous one failed. ]*/
 TEST_FUNCTION(Outprocess_control_thread_restart_fails_bad_msg_then_reconnect_fails)
 {
 	// arrange
@@ -3581,7 +3664,7 @@ TEST_FUNCTION(Outprocess_control_thread_restart_fails_bad_msg_then_reconnect_fai
 	Module_Start(module);
 	umock_c_reset_all_calls();
 
-	//1st pass: status is bad
+	//1st poll: status is bad
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -3591,12 +3674,15 @@ TEST_FUNCTION(Outprocess_control_thread_restart_fails_bad_msg_then_reconnect_fai
 		.IgnoreAllArguments()
 		.SetReturn((CONTROL_MESSAGE*)&remote_died);
 	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(250));
-	// 2nd pass:needs_to_attach is set, get bad message.
+	// 2nd poll: needs_to_attach is set, spawn the reattach thread.
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	// resend create message
+	// reattach thread: resend create message, get bad message.
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	setup_create_create_message(&config);
@@ -3612,29 +3698,117 @@ TEST_FUNCTION(Outprocess_control_thread_restart_fails_bad_msg_then_reconnect_fai
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(ControlMessage_Destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	when_shall_nn_recv_fail = current_nn_recv_index +3;
-	STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
-		.IgnoreArgument(1).IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(nn_errno()).SetReturn(EAGAIN);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(250));
-	//3rd pass: reset_channel fails (needs attach is still 1)
+	//3rd poll: join the failed reattach and start another (needs attach is still 1)
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	//restart control channel gets called and we bail right after
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
 
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
+	// act
+	bool result1 = control_poll_to_call(control_poll_context);
+	bool result2 = control_poll_to_call(control_poll_context);
+	//fourth thread created is the reattach thread
+	int thread_result = thread_func_to_call[4](thread_func_args[4]);
+	bool result3 = control_poll_to_call(control_poll_context);
+
+	// assert
+	ASSERT_IS_TRUE(result1);
+	ASSERT_IS_TRUE(result2);
+	ASSERT_ARE_EQUAL(int, 0, thread_result);
+	ASSERT_IS_TRUE(result3);
+	ASSERT_IS_NOT_NULL(thread_func_to_call[5]);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_062: [ The reattach shall run on a thread of its own, so that waiting on the module host does not hold up the gateway timer service. ]*/
+TEST_FUNCTION(Outprocess_control_thread_skips_receive_while_reattaching)
+{
+	// arrange
+	CONTROL_MESSAGE_MODULE_REPLY remote_died =
+	{
+		{ CONTROL_MESSAGE_VERSION_CURRENT,  CONTROL_MESSAGE_TYPE_MODULE_REPLY },
+		(uint8_t)-1
+	};
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+		.IgnoreAllArguments()
+		.SetReturn((CONTROL_MESSAGE*)&remote_died);
+	(void)control_poll_to_call(control_poll_context);
+	(void)control_poll_to_call(control_poll_context);
+	umock_c_reset_all_calls();
+
+	//reattach thread has not finished
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	bool result = control_poll_to_call(control_poll_context);
+
+	// assert
+	ASSERT_IS_TRUE(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
 
+/*Tests_SRS_OUTPROCESS_MODULE_17_063: [ Once the reattach attempt completes, the next poll shall join the reattach thread, and shall start a new attempt if the previous one failed. ]*/
+TEST_FUNCTION(Outprocess_control_thread_reattach_thread_create_fails)
+{
+	// arrange
+	CONTROL_MESSAGE_MODULE_REPLY remote_died =
+	{
+		{ CONTROL_MESSAGE_VERSION_CURRENT,  CONTROL_MESSAGE_TYPE_MODULE_REPLY },
+		(uint8_t)-1
+	};
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+		.IgnoreAllArguments()
+		.SetReturn((CONTROL_MESSAGE*)&remote_died);
+	(void)control_poll_to_call(control_poll_context);
+	umock_c_reset_all_calls();
+
+	whenShallThreadAPI_Create_fail = currentThreadAPI_Create_call + 1;
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	//next poll tries again
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
 	// act
-	//fourth thread created is control message thread
-	thread_func_to_call[4](thread_func_args[4]);
+	bool result1 = control_poll_to_call(control_poll_context);
+	bool result2 = control_poll_to_call(control_poll_context);
 
 	// assert 
+	ASSERT_IS_TRUE(result1);
+	ASSERT_IS_TRUE(result2);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//ablution
@@ -3659,10 +3833,10 @@ TEST_FUNCTION(Outprocess_control_thread_dies_on_1st_unlock)
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
 
 	// act
-	//fourth thread created is control message thread
-	thread_func_to_call[4](thread_func_args[4]);
+	bool result = control_poll_to_call(control_poll_context);
 
 	// assert 
+	ASSERT_IS_FALSE(result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//ablution
@@ -3689,10 +3863,10 @@ TEST_FUNCTION(Outprocess_control_thread_dies_on_2nd_unlock)
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
 
 	// act
-	//fourth thread created is control message thread
-	thread_func_to_call[4](thread_func_args[4]);
+	bool result = control_poll_to_call(control_poll_context);
 
 	// assert 
+	ASSERT_IS_FALSE(result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//ablution
@@ -3700,6 +3874,7 @@ TEST_FUNCTION(Outprocess_control_thread_dies_on_2nd_unlock)
 	cleanup_create_config(&config);
 }
 
+/*Tests_SRS_OUTPROCESS_MODULE_17_064: [ Once the control thread has been signalled to close, or the control channel receive fails, the poll shall not run again. ]*/
 TEST_FUNCTION(Outprocess_control_thread_dies_nn_recv_unexpected_error)
 {
 	// arrange
@@ -3721,13 +3896,12 @@ TEST_FUNCTION(Outprocess_control_thread_dies_nn_recv_unexpected_error)
 	when_shall_nn_recv_fail = current_nn_recv_index +1;
 	STRICT_EXPECTED_CALL(nn_recv(2, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT)).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(nn_errno()).SetReturn(100);
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(250));
 
 	// act
-	//fourth thread created is control message thread
-	thread_func_to_call[4](thread_func_args[4]);
+	bool result = control_poll_to_call(control_poll_context);
 
 	// assert 
+	ASSERT_IS_FALSE(result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//ablution
@@ -0,0 +1,27 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "module.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct CAPTURE_MODULE_CONFIG_TAG
+{
+    char * filename;
+    char * source;
+} CAPTURE_MODULE_CONFIG;
+
+
+MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(CAPTURE_MODULE)(MODULE_API_VERSION gateway_api_version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*CAPTURE_H*/
@@ -11,6 +11,16 @@ extern "C"
 {
 #endif
 
+/** @brief  Name of the function returning the number of messages received
+ *          by all metrics modules in the process, for lookup with
+ *          DynamicLibrary_FindSymbol.
+ */
+#define METRICS_GET_TOTAL_MESSAGES_RECEIVED_NAME "MetricsModule_GetTotalMessagesReceived"
+
+typedef long long (*pfMetricsModule_GetTotalMessagesReceived)(void);
+
+MODULE_EXPORT long long MetricsModule_GetTotalMessagesReceived(void);
+
 MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(METRICS_MODULE)(MODULE_API_VERSION gateway_api_version);
 
 #ifdef __cplusplus
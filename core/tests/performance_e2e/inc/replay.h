@@ -0,0 +1,29 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "module.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct REPLAY_MODULE_CONFIG_TAG
+{
+    char * filename;
+    char * source;
+    double speed;
+    size_t repeat;
+} REPLAY_MODULE_CONFIG;
+
+
+MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(REPLAY_MODULE)(MODULE_API_VERSION gateway_api_version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*REPLAY_H*/
@@ -0,0 +1,46 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef SOAK_H
+#define SOAK_H
+
+#include <cstddef>
+
+typedef struct SOAK_CONFIG_TAG
+{
+    /*total run time, in seconds*/
+    unsigned int duration;
+    /*time between samples, in seconds*/
+    unsigned int interval;
+    /*time series output, NULL to skip the CSV file*/
+    const char * csv_filename;
+    /*metrics module library used to read message counts, NULL to skip throughput*/
+    const char * metrics_library;
+    /*memory growth, in KB per hour, above which the run fails*/
+    double max_growth_kb_per_hour;
+    /*throughput drop, in percent of the early throughput, above which the run fails*/
+    double max_throughput_decay;
+} SOAK_CONFIG;
+
+typedef struct SOAK_SAMPLE_TAG
+{
+    double elapsed;
+    long long rss;
+    long long gballoc_current;
+    long long gballoc_maximum;
+    long long thread_count;
+    long long socket_count;
+    long long messages_received;
+    double interval_throughput;
+} SOAK_SAMPLE;
+
+/**
+ * Samples process resources every config->interval seconds while the gateway
+ * runs, writes each sample to the CSV file and prints a pass/fail summary.
+ * Values that cannot be read on this platform are reported as -1.
+ *
+ * Returns 0 if no memory growth or throughput decay was detected.
+ */
+int Soak_Run(const SOAK_CONFIG * config);
+
+#endif /*SOAK_H*/
@@ -0,0 +1,80 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+/*
+ * Binary trace format shared by the capture and replay modules.
+ *
+ * A trace starts with a header:
+ *   8 bytes  magic "AIGTRACE"
+ *   4 bytes  format version, MSB order
+ *
+ * followed by any number of records:
+ *   8 bytes  microseconds since capture start (monotonic clock), MSB order
+ *   2 bytes  length of the source name, MSB order
+ *   n bytes  source name (not null terminated)
+ *   4 bytes  length of the serialized message, MSB order
+ *   m bytes  message, as produced by Message_ToByteArray
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#define TRACE_FILE_MAGIC "AIGTRACE"
+#define TRACE_FILE_MAGIC_SIZE 8
+#define TRACE_FILE_VERSION_1 1
+#define TRACE_FILE_VERSION_CURRENT TRACE_FILE_VERSION_1
+#define TRACE_FILE_MAX_SOURCE_NAME 0xFFFF
+
+static inline bool trace_write_uint(FILE* fout, uint64_t value, size_t size)
+{
+    unsigned char bytes[8];
+    for (size_t i = 0; i < size; i++)
+    {
+        bytes[i] = (unsigned char)((value >> (8 * (size - 1 - i))) & 0xFF);
+    }
+    return fwrite(bytes, 1, size, fout) == size;
+}
+
+static inline bool trace_read_uint(FILE* fin, uint64_t* value, size_t size)
+{
+    unsigned char bytes[8];
+    bool result;
+    if (fread(bytes, 1, size, fin) != size)
+    {
+        result = false;
+    }
+    else
+    {
+        *value = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            *value = (*value << 8) | bytes[i];
+        }
+        result = true;
+    }
+    return result;
+}
+
+static inline bool trace_write_header(FILE* fout)
+{
+    return
+        (fwrite(TRACE_FILE_MAGIC, 1, TRACE_FILE_MAGIC_SIZE, fout) == TRACE_FILE_MAGIC_SIZE) &&
+        trace_write_uint(fout, TRACE_FILE_VERSION_CURRENT, 4);
+}
+
+static inline bool trace_read_header(FILE* fin)
+{
+    char magic[TRACE_FILE_MAGIC_SIZE];
+    uint64_t version;
+    return
+        (fread(magic, 1, TRACE_FILE_MAGIC_SIZE, fin) == TRACE_FILE_MAGIC_SIZE) &&
+        (memcmp(magic, TRACE_FILE_MAGIC, TRACE_FILE_MAGIC_SIZE) == 0) &&
+        trace_read_uint(fin, &version, 4) &&
+        (version == TRACE_FILE_VERSION_CURRENT);
+}
+
+#endif /*TRACE_FILE_H*/
@@ -0,0 +1,292 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <parson.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "message.h"
+#include "module.h"
+
+#include "capture.h"
+#include "trace_file.h"
+
+using SteadyClock = std::chrono::steady_clock;
+using MicroSeconds = std::chrono::microseconds;
+
+typedef struct CAPTURE_MODULE_HANDLE_TAG
+{
+    BROKER_HANDLE broker;
+    FILE * fout;
+    char * source;
+    size_t source_length;
+    SteadyClock::time_point start_time;
+    unsigned char * serialize_buffer;
+    int32_t serialize_buffer_size;
+    long long messages_captured;
+    long long capture_errors;
+} CAPTURE_MODULE_HANDLE;
+
+
+static void* CaptureModule_ParseConfigurationFromJson(const char* configuration)
+{
+    CAPTURE_MODULE_CONFIG * result;
+    if (configuration == NULL)
+    {
+        LogError("Capture module expects configuration");
+        result = NULL;
+    }
+    else
+    {
+        JSON_Value* json = json_parse_string((const char*)configuration);
+        if (json == NULL)
+        {
+            LogError("unable to json_parse_string");
+            result = NULL;
+        }
+        else
+        {
+            JSON_Object* obj = json_value_get_object(json);
+            if (obj == NULL)
+            {
+                LogError("unable to json_value_get_object");
+                result = NULL;
+            }
+            else
+            {
+                const char* filenameValue = json_object_get_string(obj, "filename");
+                const char* sourceValue = json_object_get_string(obj, "source");
+                if (filenameValue == NULL)
+                {
+                    LogError("filename is a required field in configuration");
+                    result = NULL;
+                }
+                else
+                {
+                    result = (CAPTURE_MODULE_CONFIG *)malloc(sizeof(CAPTURE_MODULE_CONFIG));
+                    if (result == NULL)
+                    {
+                        LogError("Could not allocated Module data");
+                    }
+                    else if (mallocAndStrcpy_s(&(result->filename), filenameValue) != 0)
+                    {
+                        LogError("could not allocate memory for filename string");
+                        free(result);
+                        result = NULL;
+                    }
+                    else if (mallocAndStrcpy_s(&(result->source), (sourceValue == NULL) ? "" : sourceValue) != 0)
+                    {
+                        LogError("could not allocate memory for source string");
+                        free(result->filename);
+                        free(result);
+                        result = NULL;
+                    }
+                    else
+                    {
+                        /*all is fine, return as is*/
+                    }
+                }
+            }
+            json_value_free(json);
+        }
+    }
+    return result;
+}
+
+static void CaptureModule_FreeConfiguration(void* configuration)
+{
+    if (configuration != NULL)
+    {
+        CAPTURE_MODULE_CONFIG * conf = (CAPTURE_MODULE_CONFIG*)configuration;
+        free(conf->filename);
+        free(conf->source);
+        free(conf);
+    }
+}
+
+static MODULE_HANDLE CaptureModule_Create(BROKER_HANDLE broker, const void* configuration)
+{
+    CAPTURE_MODULE_HANDLE * module;
+
+    if ((broker == NULL) ||
+        (configuration == NULL))
+    {
+        LogError("Capture had a null input. broker: [%p], configuration: [%p]", broker, configuration);
+        module = NULL;
+    }
+    else
+    {
+        CAPTURE_MODULE_CONFIG * conf = (CAPTURE_MODULE_CONFIG *)configuration;
+        size_t source_length = (conf->source == NULL) ? 0 : strlen(conf->source);
+        if (conf->filename == NULL || source_length > TRACE_FILE_MAX_SOURCE_NAME)
+        {
+            LogError("Capture configuration is invalid");
+            module = NULL;
+        }
+        else
+        {
+            module = (CAPTURE_MODULE_HANDLE*)malloc(sizeof(CAPTURE_MODULE_HANDLE));
+            if (module == NULL)
+            {
+                LogError("Could not allocate memory for module handle");
+            }
+            else if (mallocAndStrcpy_s(&(module->source), (conf->source == NULL) ? "" : conf->source) != 0)
+            {
+                LogError("could not allocate memory for source string");
+                free(module);
+                module = NULL;
+            }
+            else
+            {
+                module->fout = fopen(conf->filename, "wb");
+                if (module->fout == NULL)
+                {
+                    LogError("unable to open trace file %s", conf->filename);
+                    free(module->source);
+                    free(module);
+                    module = NULL;
+                }
+                else if (!trace_write_header(module->fout))
+                {
+                    LogError("unable to write trace header to %s", conf->filename);
+                    (void)fclose(module->fout);
+                    free(module->source);
+                    free(module);
+                    module = NULL;
+                }
+                else
+                {
+                    module->broker = broker;
+                    module->source_length = source_length;
+                    module->start_time = SteadyClock::now();
+                    module->serialize_buffer = NULL;
+                    module->serialize_buffer_size = 0;
+                    module->messages_captured = 0;
+                    module->capture_errors = 0;
+                }
+            }
+        }
+    }
+    return (MODULE_HANDLE)module;
+}
+
+static void CaptureModule_Start(MODULE_HANDLE moduleHandle)
+{
+    if (moduleHandle != NULL)
+    {
+        /*timestamps are relative to the moment the gateway started delivering*/
+        CAPTURE_MODULE_HANDLE * module = (CAPTURE_MODULE_HANDLE *)moduleHandle;
+        module->start_time = SteadyClock::now();
+    }
+}
+
+static void CaptureModule_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    if (moduleHandle != NULL && messageHandle != NULL)
+    {
+        CAPTURE_MODULE_HANDLE * module = (CAPTURE_MODULE_HANDLE *)moduleHandle;
+        MicroSeconds offset = std::chrono::duration_cast<MicroSeconds>(SteadyClock::now() - module->start_time);
+
+        int32_t message_size = Message_ToByteArray(messageHandle, NULL, 0);
+        if (message_size < 0)
+        {
+            LogError("unable to get serialized message size");
+            module->capture_errors++;
+        }
+        else
+        {
+            /*the serialization buffer only ever grows, so steady state capture does not allocate*/
+            if (message_size > module->serialize_buffer_size)
+            {
+                unsigned char * new_buffer = (unsigned char *)realloc(module->serialize_buffer, message_size);
+                if (new_buffer == NULL)
+                {
+                    LogError("unable to allocate serialization buffer");
+                }
+                else
+                {
+                    module->serialize_buffer = new_buffer;
+                    module->serialize_buffer_size = message_size;
+                }
+            }
+
+            if (message_size > module->serialize_buffer_size)
+            {
+                module->capture_errors++;
+            }
+            else if (Message_ToByteArray(messageHandle, module->serialize_buffer, message_size) != message_size)
+            {
+                LogError("unable to serialize message");
+                module->capture_errors++;
+            }
+            else if (!(
+                trace_write_uint(module->fout, (uint64_t)offset.count(), 8) &&
+                trace_write_uint(module->fout, (uint64_t)module->source_length, 2) &&
+                (fwrite(module->source, 1, module->source_length, module->fout) == module->source_length) &&
+                trace_write_uint(module->fout, (uint64_t)message_size, 4) &&
+                (fwrite(module->serialize_buffer, 1, message_size, module->fout) == (size_t)message_size)
+                ))
+            {
+                LogError("unable to write trace record");
+                module->capture_errors++;
+            }
+            else
+            {
+                module->messages_captured++;
+            }
+        }
+    }
+}
+
+static void CaptureModule_Destroy(MODULE_HANDLE moduleHandle)
+{
+    if (moduleHandle == NULL)
+    {
+        LogError("Destroying a NULL module");
+    }
+    else
+    {
+        CAPTURE_MODULE_HANDLE * module = (CAPTURE_MODULE_HANDLE *)moduleHandle;
+        if (fclose(module->fout) != 0)
+        {
+            LogError("unable to close trace file");
+        }
+        std::cout
+            << "Capture Metrics:" << std::endl
+            << "----------------" << std::endl
+            << "Source: " << module->source << std::endl
+            << "Messages captured: " << module->messages_captured << std::endl
+            << "Capture errors: " << module->capture_errors << std::endl;
+        free(module->serialize_buffer);
+        free(module->source);
+        free(module);
+    }
+}
+
+static const MODULE_API_1 CAPTURE_APIS_all =
+{
+    {MODULE_API_VERSION_1},
+
+    CaptureModule_ParseConfigurationFromJson,
+    CaptureModule_FreeConfiguration,
+    CaptureModule_Create,
+    CaptureModule_Destroy,
+    CaptureModule_Receive,
+    CaptureModule_Start
+};
+
+#ifdef BUILD_MODULE_TYPE_STATIC
+MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(CAPTURE_MODULE)(MODULE_API_VERSION gateway_api_version)
+#else
+MODULE_EXPORT const MODULE_API* Module_GetApi(MODULE_API_VERSION gateway_api_version)
+#endif
+{
+    (void)gateway_api_version;
+    return reinterpret_cast< const MODULE_API *>(&CAPTURE_APIS_all);
+}
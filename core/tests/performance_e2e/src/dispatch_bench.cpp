@@ -0,0 +1,125 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures the cost of delivering a message to a no-op module through the
+// module loader on every message (the native module host's old path) against
+// a MODULE_DISPATCH record resolved once at create time.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "module.h"
+#include "module_access.h"
+#include "module_loader.h"
+
+using SteadyClock = std::chrono::steady_clock;
+
+#define DISPATCH_BENCH_DEFAULT_ITERATIONS 50000000UL
+
+static volatile unsigned long noop_receive_count = 0;
+
+static void NoOp_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    (void)moduleHandle;
+    (void)messageHandle;
+    noop_receive_count = noop_receive_count + 1;
+}
+
+static MODULE_API_1 noop_module_api =
+{
+    { MODULE_API_VERSION_1 },
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NoOp_Receive,
+    NULL
+};
+
+/*the dynamic loader returns the MODULE_API it stored when the library was loaded*/
+static const MODULE_API* bench_loader_GetApi(const MODULE_LOADER* loader, MODULE_LIBRARY_HANDLE handle)
+{
+    (void)loader;
+    return *(const MODULE_API* volatile*)handle;
+}
+
+static MODULE_LOADER_API bench_loader_api =
+{
+    NULL,
+    NULL,
+    bench_loader_GetApi,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+static MODULE_LOADER bench_loader =
+{
+    NATIVE,
+    "dispatch_bench",
+    NULL,
+    &bench_loader_api
+};
+
+static double ns_per_message(SteadyClock::time_point start, SteadyClock::time_point end, unsigned long iterations)
+{
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long iterations = DISPATCH_BENCH_DEFAULT_ITERATIONS;
+    if (argc > 1)
+    {
+        iterations = strtoul(argv[1], NULL, 10);
+        if (iterations == 0)
+        {
+            printf("usage: %s [iterations]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const MODULE_API* library = (const MODULE_API*)&noop_module_api;
+    MODULE_LIBRARY_HANDLE library_handle = (MODULE_LIBRARY_HANDLE)&library;
+    const MODULE_LOADER* volatile module_loader = &bench_loader;
+    MODULE_HANDLE module_handle = (MODULE_HANDLE)&noop_module_api;
+    MESSAGE_HANDLE message = (MESSAGE_HANDLE)&noop_receive_count;
+
+    /*per-message path: ask the loader for the MODULE_API, then look up Module_Receive*/
+    SteadyClock::time_point start = SteadyClock::now();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        const MODULE_API* module_apis = module_loader->api->GetApi(module_loader, library_handle);
+        if (module_apis != NULL)
+        {
+            pfModule_Receive pfReceive = MODULE_RECEIVE(module_apis);
+            if (pfReceive != NULL)
+            {
+                (pfReceive)(module_handle, message);
+            }
+        }
+    }
+    SteadyClock::time_point lookup_end = SteadyClock::now();
+
+    /*create-time path: resolve once, then a single indirect call per message*/
+    MODULE_DISPATCH dispatch;
+    MODULE_DISPATCH_INIT(dispatch, module_loader->api->GetApi(module_loader, library_handle), module_handle);
+    /*read through a volatile pointer, as the broker reads module_info->dispatch, so the call is not devirtualized*/
+    MODULE_DISPATCH* volatile dispatch_record = &dispatch;
+    SteadyClock::time_point dispatch_start = SteadyClock::now();
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        MODULE_DISPATCH_RECEIVE(*dispatch_record, message);
+    }
+    SteadyClock::time_point dispatch_end = SteadyClock::now();
+
+    printf("no-op module, %lu messages\n", iterations);
+    printf("  loader lookup per message: %8.2f ns/msg\n", ns_per_message(start, lookup_end, iterations));
+    printf("  cached dispatch record:    %8.2f ns/msg\n", ns_per_message(dispatch_start, dispatch_end, iterations));
+
+    return (noop_receive_count == 2 * iterations) ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures what link fusion saves on a chain of two no-op modules, source ->
+// forward -> sink, driven through the gateway's broker. The chain is run
+// once with regular links, where every hop goes through the broker's socket
+// and the receiving module's thread, and once with fused links, where
+// forward and sink run on the publishing thread.
+//
+// Messages are published one at a time and each is waited for at the sink,
+// so the figures are end-to-end latencies and no message is dropped by a
+// full socket.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "azure_c_shared_utility/map.h"
+
+#include "broker.h"
+#include "message.h"
+#include "module.h"
+
+using SteadyClock = std::chrono::steady_clock;
+
+#define FUSION_BENCH_DEFAULT_MESSAGES 100000UL
+#define FUSION_BENCH_DEFAULT_SIZE 256UL
+#define FUSION_BENCH_TIMEOUT std::chrono::seconds(5)
+
+static BROKER_HANDLE broker;
+static int source_handle;
+static int forward_handle;
+static int sink_handle;
+static std::atomic<unsigned long> received_count(0);
+
+static void Forward_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    (void)Broker_Publish(broker, moduleHandle, messageHandle);
+}
+
+static void Sink_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    (void)moduleHandle;
+    (void)messageHandle;
+    received_count++;
+}
+
+static MODULE_API_3 forward_module_api =
+{
+    { MODULE_API_VERSION_3 },
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    Forward_Receive,
+    NULL,
+    1,
+    true
+};
+
+static MODULE_API_3 sink_module_api =
+{
+    { MODULE_API_VERSION_3 },
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    Sink_Receive,
+    NULL,
+    1,
+    true
+};
+
+/*returns the mean ns per message, or a negative number if a message was lost*/
+static double run_chain(bool fused, MESSAGE_HANDLE message, unsigned long messages)
+{
+    double result = -1.0;
+    MODULE source = { (const MODULE_API*)&sink_module_api, (MODULE_HANDLE)&source_handle };
+    MODULE forward = { (const MODULE_API*)&forward_module_api, (MODULE_HANDLE)&forward_handle };
+    MODULE sink = { (const MODULE_API*)&sink_module_api, (MODULE_HANDLE)&sink_handle };
+    BROKER_LINK_DATA first = { source.module_handle, forward.module_handle };
+    BROKER_LINK_DATA second = { forward.module_handle, sink.module_handle };
+
+    broker = Broker_Create();
+    received_count = 0;
+    if (broker == NULL ||
+        Broker_AddModule(broker, &source) != BROKER_OK ||
+        Broker_AddModule(broker, &forward) != BROKER_OK ||
+        Broker_AddModule(broker, &sink) != BROKER_OK ||
+        (fused ? Broker_AddFusedLink(broker, &first) : Broker_AddLink(broker, &first)) != BROKER_OK ||
+        (fused ? Broker_AddFusedLink(broker, &second) : Broker_AddLink(broker, &second)) != BROKER_OK)
+    {
+        printf("unable to set up the %s chain\n", fused ? "fused" : "regular");
+    }
+    else
+    {
+        bool lost = false;
+        SteadyClock::time_point start = SteadyClock::now();
+        for (unsigned long i = 0; i < messages && !lost; i++)
+        {
+            SteadyClock::time_point deadline = SteadyClock::now() + FUSION_BENCH_TIMEOUT;
+            (void)Broker_Publish(broker, source.module_handle, message);
+            while (received_count.load() <= i)
+            {
+                if (SteadyClock::now() > deadline)
+                {
+                    printf("message %lu did not reach the sink\n", i);
+                    lost = true;
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+        SteadyClock::time_point end = SteadyClock::now();
+        if (!lost)
+        {
+            result = std::chrono::duration<double, std::nano>(end - start).count() / messages;
+        }
+    }
+
+    if (broker != NULL)
+    {
+        (void)Broker_RemoveModule(broker, &sink);
+        (void)Broker_RemoveModule(broker, &forward);
+        (void)Broker_RemoveModule(broker, &source);
+        Broker_Destroy(broker);
+        broker = NULL;
+    }
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long messages = (argc > 1) ? strtoul(argv[1], NULL, 10) : FUSION_BENCH_DEFAULT_MESSAGES;
+    unsigned long message_size = (argc > 2) ? strtoul(argv[2], NULL, 10) : FUSION_BENCH_DEFAULT_SIZE;
+    if (messages == 0)
+    {
+        printf("usage: %s [messages] [message size]\n", argv[0]);
+        return 1;
+    }
+
+    int result = 1;
+    std::vector<unsigned char> content(message_size, 'x');
+    MAP_HANDLE properties = Map_Create(NULL);
+    (void)Map_AddOrUpdate(properties, "source", "fusion_bench");
+    MESSAGE_CONFIG message_config = { content.size(), content.data(), properties };
+    MESSAGE_HANDLE message = Message_Create(&message_config);
+    Map_Destroy(properties);
+
+    if (message == NULL)
+    {
+        printf("unable to create a %lu byte message\n", message_size);
+    }
+    else
+    {
+        double regular_ns = run_chain(false, message, messages);
+        double fused_ns = run_chain(true, message, messages);
+        Message_Destroy(message);
+
+        if (regular_ns > 0.0 && fused_ns > 0.0)
+        {
+            printf("source -> forward -> sink, %lu messages of %lu bytes\n", messages, message_size);
+            printf("  regular links: %10.2f ns/msg %12.0f msg/s\n", regular_ns, 1e9 / regular_ns);
+            printf("  fused links:   %10.2f ns/msg %12.0f msg/s\n", fused_ns, 1e9 / fused_ns);
+            result = 0;
+        }
+    }
+
+    return result;
+}
@@ -8,24 +8,102 @@
 #include "azure_c_shared_utility/threadapi.h"
 #include <nanomsg/nn.h>
 
+#include "soak.h"
+
+extern "C" int gballoc_init(void);
+extern "C" void gballoc_deinit(void);
+
+#ifdef _WIN32
+#define DEFAULT_METRICS_LIBRARY "metrics.dll"
+#else
+#define DEFAULT_METRICS_LIBRARY "libmetrics.so"
+#endif
+
+static void print_usage(void)
+{
+    std::cout
+        << "usage: performance_sample configFile [duration] [--soak interval] [--csv file] [--metrics library] [--max-growth kb] [--max-decay percent]" << std::endl
+        << "where configFile is the name of the file that contains the gateway configuration" << std::endl
+        << "where duration is the length of time in seconds for the test to run" << std::endl
+        << "where --soak samples process resources every interval seconds and checks for drift" << std::endl
+        << "where --csv is the soak time series output file (default soak.csv)" << std::endl
+        << "where --metrics is the metrics module library used to read message counts (default " DEFAULT_METRICS_LIBRARY ")" << std::endl
+        << "where --max-growth is the allowed memory growth in KB per hour (default 1024)" << std::endl
+        << "where --max-decay is the allowed throughput decay in percent (default 10)" << std::endl;
+}
+
 int main(int argc, char** argv)
 {
+    int result = 0;
     int sleep_in_ms = 5000;
+    bool soak = false;
+    bool arguments_valid = (argc >= 2);
+    SOAK_CONFIG soak_config;
     GATEWAY_HANDLE gateway;
-    if (argc != 2 && argc != 3)
+
+    soak_config.interval = 10;
+    soak_config.csv_filename = "soak.csv";
+    soak_config.metrics_library = DEFAULT_METRICS_LIBRARY;
+    soak_config.max_growth_kb_per_hour = 1024;
+    soak_config.max_throughput_decay = 10;
+
+    for (int i = 2; arguments_valid && i < argc; i++)
+    {
+        std::string argument(argv[i]);
+        if (argument.compare(0, 2, "--") != 0)
+        {
+            if (i == 2)
+            {
+                sleep_in_ms = std::stoi(argument) * 1000;
+            }
+            else
+            {
+                arguments_valid = false;
+            }
+        }
+        else if (i + 1 >= argc)
+        {
+            arguments_valid = false;
+        }
+        else if (argument == "--soak")
+        {
+            soak = true;
+            soak_config.interval = std::stoi(argv[++i]);
+        }
+        else if (argument == "--csv")
+        {
+            soak_config.csv_filename = argv[++i];
+        }
+        else if (argument == "--metrics")
+        {
+            soak_config.metrics_library = argv[++i];
+        }
+        else if (argument == "--max-growth")
+        {
+            soak_config.max_growth_kb_per_hour = std::stod(argv[++i]);
+        }
+        else if (argument == "--max-decay")
+        {
+            soak_config.max_throughput_decay = std::stod(argv[++i]);
+        }
+        else
+        {
+            arguments_valid = false;
+        }
+    }
+
+    if (!arguments_valid)
     {
-        std::cout 
-            << "usage: performance_sample configFile [duration]" << std::endl 
-            << "where configFile is the name of the file that contains the gateway configuration" << std::endl
-            << "where duration is the length of time in seconds for the test to run" << std::endl;
+        print_usage();
     }
     else
     {
-        if (argc==3)
+        if (soak)
         {
-            sleep_in_ms = std::stoi(argv[2]) * 1000;
+            /*gballoc only accounts for allocations once initialized*/
+            (void)gballoc_init();
         }
-        
+
         if ((gateway = Gateway_CreateFromJson(argv[1])) == NULL)
         {
             std::cout << "failed to create the gateway from JSON" << std::endl;
@@ -35,10 +113,23 @@ int main(int argc, char** argv)
             
             std::cout << "gateway successfully created from JSON" << std::endl;
             std::cout << "gateway shall run for " << sleep_in_ms/1000 << " seconds" << std::endl;
-            ThreadAPI_Sleep(sleep_in_ms);
+            if (soak)
+            {
+                soak_config.duration = sleep_in_ms / 1000;
+                result = Soak_Run(&soak_config);
+            }
+            else
+            {
+                ThreadAPI_Sleep(sleep_in_ms);
+            }
             
             Gateway_Destroy(gateway);
         }
+
+        if (soak)
+        {
+            gballoc_deinit();
+        }
     }
-    return 0;
+    return result;
 }
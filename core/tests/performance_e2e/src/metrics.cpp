@@ -4,6 +4,7 @@
 #include <string>
 #include <map>
 #include <exception>
+#include <atomic>
 
 #include <parson.h>
 
@@ -15,6 +16,7 @@
 #include "module.h"
 
 #include "simulator.h"
+#include "metrics.h"
 
 using HrClock = std::chrono::high_resolution_clock;
 using MicroSeconds = std::chrono::microseconds;
@@ -86,6 +88,9 @@ typedef struct METRICS_MODULE_HANDLE_TAG
     PerDeviceMap *per_device_metrics;
 } METRICS_MODULE_HANDLE;
 
+/*messages received by all metrics modules in this process, sampled by the soak test*/
+static std::atomic<Counter> total_messages_received(0);
+
 
 static void* MetricsModule_ParseConfigurationFromJson(const char* configuration)
 {
@@ -149,61 +154,47 @@ static void MetricsModule_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE mes
         HrTime received_time = std::chrono::time_point_cast<MicroSeconds>(HrClock::now());
         METRICS_MODULE_HANDLE * module = (METRICS_MODULE_HANDLE *)moduleHandle;
         module->all_messages_received++;
+        total_messages_received.fetch_add(1, std::memory_order_relaxed);
 
-        CONSTMAP_HANDLE message_properties = Message_GetProperties(messageHandle);
-        if (message_properties == NULL)
+        int64_t timestamp_property;
+        int64_t seq_num_property;
+        const char * deviceId_property = Message_GetProperty(messageHandle, "deviceId");
+        if ((deviceId_property == NULL) ||
+            (Message_GetPropertyInt64(messageHandle, "timestamp", &timestamp_property) != 0) ||
+            (Message_GetPropertyInt64(messageHandle, "sequence number", &seq_num_property) != 0))
         {
             module->non_conforming_messages++;
         }
         else
         {
-            const char * timestamp_property = ConstMap_GetValue(message_properties, "timestamp");
-            const char * seq_num_property = ConstMap_GetValue(message_properties, "sequence number");
-            const char * deviceId_property = ConstMap_GetValue(message_properties, "deviceId");
-            if ((timestamp_property == NULL) || (seq_num_property == NULL) || (deviceId_property == NULL))
-            {
-                module->non_conforming_messages++;
-            }
-            else
+            MicroSeconds timestamp_duration(timestamp_property);
+            HrTime timestamp(timestamp_duration);
+            MicroSeconds current_latency = received_time - timestamp;
+            module->latency.add(current_latency);
+
+            try
             {
-                try
-                {
-                    MicroSeconds timestamp_duration(std::stoll(timestamp_property));
-                    HrTime timestamp(timestamp_duration);
-                    MicroSeconds current_latency = received_time - timestamp;
-                    module->latency.add(current_latency);
+                std::string deviceId(deviceId_property);
+                METRICS_PER_DEVICE& per_device = (*module->per_device_metrics)[deviceId];
+                per_device.messages_received++;
+                per_device.seqence_number++;
 
-                    if (deviceId_property == NULL)
-                    {
-                        module->non_conforming_messages++;
-                    }
-                    else
+                Counter sequence_number(seq_num_property);
+                if (sequence_number != per_device.seqence_number)
+                {
+                    per_device.out_of_sequence_messages++;
+                    if (sequence_number > per_device.seqence_number)
                     {
-                        std::string deviceId(deviceId_property);
-                        METRICS_PER_DEVICE& per_device = (*module->per_device_metrics)[deviceId];
-                        per_device.messages_received++;
-                        per_device.seqence_number++;
-
-                        Counter sequence_number(std::stoll(seq_num_property));
-                        if (sequence_number != per_device.seqence_number)
-                        {
-                            per_device.out_of_sequence_messages++;
-                            if (sequence_number > per_device.seqence_number)
-                            {
-                                per_device.messages_lost += (sequence_number - per_device.seqence_number);
-                            }
-                            per_device.seqence_number = sequence_number;
-                        }
+                        per_device.messages_lost += (sequence_number - per_device.seqence_number);
                     }
-                }
-                catch (std::exception & e)
-                {
-                    LogError("non-conforming message: exception caught: %s", e.what());
-                    module->non_conforming_messages++;
+                    per_device.seqence_number = sequence_number;
                 }
             }
-
-            ConstMap_Destroy(message_properties);
+            catch (std::exception & e)
+            {
+                LogError("non-conforming message: exception caught: %s", e.what());
+                module->non_conforming_messages++;
+            }
         }
     }
 }
@@ -248,6 +239,11 @@ static void MetricsModule_Destroy(MODULE_HANDLE moduleHandle)
 
 
 
+MODULE_EXPORT long long MetricsModule_GetTotalMessagesReceived(void)
+{
+    return total_messages_received.load(std::memory_order_relaxed);
+}
+
 static const MODULE_API_1 METRICS_APIS_all =
 {
     {MODULE_API_VERSION_1},
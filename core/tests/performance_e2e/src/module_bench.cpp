@@ -0,0 +1,195 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures what a module costs per message. The module is loaded from a
+// shared library with the native loader and driven through the synchronous
+// broker (broker_sync.c), so every message is delivered on this thread and
+// no time is spent in queues, sockets or context switches. Anything the
+// module publishes is delivered to a no-op sink and counted.
+//
+// Run it under `perf record` to profile a module on its own:
+//
+//     perf record -g ./module_bench ./libidentity_map.so '[{...}]' 10000000
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/strings.h"
+
+#include "broker.h"
+#include "message.h"
+#include "module.h"
+#include "module_access.h"
+#include "module_loader.h"
+#include "module_loaders/dynamic_loader.h"
+
+using SteadyClock = std::chrono::steady_clock;
+
+#define MODULE_BENCH_DEFAULT_MESSAGES 1000000UL
+#define MODULE_BENCH_DEFAULT_SIZE 256UL
+
+static unsigned long published_count = 0;
+
+static void Sink_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    (void)moduleHandle;
+    (void)messageHandle;
+    published_count++;
+}
+
+static MODULE_API_1 sink_module_api =
+{
+    { MODULE_API_VERSION_1 },
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    Sink_Receive,
+    NULL
+};
+
+static int source_handle;
+static int sink_handle;
+
+static double ns_per_message(SteadyClock::time_point start, SteadyClock::time_point end, unsigned long messages)
+{
+    return std::chrono::duration<double, std::nano>(end - start).count() / messages;
+}
+
+static void print_histogram(const char* name, const BROKER_LATENCY_HISTOGRAM* histogram)
+{
+    printf("%s: %llu calls, mean %.2f ns, max %llu ns\n",
+        name,
+        (unsigned long long)histogram->count,
+        histogram->count == 0 ? 0.0 : (double)histogram->total_ns / histogram->count,
+        (unsigned long long)histogram->max_ns);
+    for (size_t i = 0; i < BROKER_LATENCY_BUCKETS; i++)
+    {
+        if (histogram->buckets[i] != 0)
+        {
+            printf("  < %12llu ns: %llu\n", 2ULL << i, (unsigned long long)histogram->buckets[i]);
+        }
+    }
+}
+
+/*loads the module the way the gateway does, minus the gateway*/
+static MODULE_HANDLE create_module(const MODULE_LOADER* loader, MODULE_LIBRARY_HANDLE library, const void* entrypoint, BROKER_HANDLE broker, const char* args)
+{
+    const MODULE_API* module_apis = loader->api->GetApi(loader, library);
+    const void* module_configuration = MODULE_PARSE_CONFIGURATION_FROM_JSON(module_apis)(args);
+    void* transformed_configuration = loader->api->BuildModuleConfiguration(loader, entrypoint, module_configuration);
+    MODULE_HANDLE result = MODULE_CREATE(module_apis)(broker, transformed_configuration);
+    MODULE_FREE_CONFIGURATION(module_apis)((void*)module_configuration);
+    loader->api->FreeModuleConfiguration(loader, transformed_configuration);
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("usage: %s <module library> [args json] [messages] [message size]\n", argv[0]);
+        return 1;
+    }
+
+    const char* args = (argc > 2) ? argv[2] : "null";
+    unsigned long messages = (argc > 3) ? strtoul(argv[3], NULL, 10) : MODULE_BENCH_DEFAULT_MESSAGES;
+    unsigned long message_size = (argc > 4) ? strtoul(argv[4], NULL, 10) : MODULE_BENCH_DEFAULT_SIZE;
+    if (messages == 0)
+    {
+        printf("usage: %s <module library> [args json] [messages] [message size]\n", argv[0]);
+        return 1;
+    }
+
+    int result = 1;
+    const MODULE_LOADER* loader = DynamicLoader_Get();
+    DYNAMIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct(argv[1]) };
+    BROKER_HANDLE broker = Broker_Create();
+    MODULE_LIBRARY_HANDLE library = (entrypoint.moduleLibraryFileName == NULL) ? NULL : loader->api->Load(loader, &entrypoint);
+    if (broker == NULL || library == NULL)
+    {
+        printf("unable to load %s\n", argv[1]);
+    }
+    else
+    {
+        MODULE module;
+        module.module_apis = loader->api->GetApi(loader, library);
+        module.module_handle = create_module(loader, library, &entrypoint, broker, args);
+
+        MODULE source = { (const MODULE_API*)&sink_module_api, (MODULE_HANDLE)&source_handle };
+        MODULE sink = { (const MODULE_API*)&sink_module_api, (MODULE_HANDLE)&sink_handle };
+        BROKER_LINK_DATA input = { source.module_handle, NULL };
+        BROKER_LINK_DATA output = { NULL, sink.module_handle };
+
+        if (module.module_handle == NULL)
+        {
+            printf("Module_Create failed for %s with args %s\n", argv[1], args);
+        }
+        else
+        {
+            input.module_sink_handle = module.module_handle;
+            output.module_source_handle = module.module_handle;
+            if (Broker_AddModule(broker, &source) != BROKER_OK ||
+                Broker_AddModule(broker, &module) != BROKER_OK ||
+                Broker_AddModule(broker, &sink) != BROKER_OK ||
+                Broker_AddLink(broker, &input) != BROKER_OK ||
+                Broker_AddLink(broker, &output) != BROKER_OK)
+            {
+                printf("unable to attach the module to the broker\n");
+            }
+            else
+            {
+                pfModule_Start pfStart = MODULE_START(module.module_apis);
+                if (pfStart != NULL)
+                {
+                    (pfStart)(module.module_handle);
+                }
+
+                std::vector<unsigned char> content(message_size, 'x');
+                MAP_HANDLE properties = Map_Create(NULL);
+                (void)Map_AddOrUpdate(properties, "source", "module_bench");
+                MESSAGE_CONFIG message_config = { content.size(), content.data(), properties };
+                MESSAGE_HANDLE message = Message_Create(&message_config);
+                Map_Destroy(properties);
+
+                if (message == NULL)
+                {
+                    printf("unable to create a %lu byte message\n", message_size);
+                }
+                else
+                {
+                    SteadyClock::time_point start = SteadyClock::now();
+                    for (unsigned long i = 0; i < messages; i++)
+                    {
+                        (void)Broker_Publish(broker, source.module_handle, message);
+                    }
+                    SteadyClock::time_point end = SteadyClock::now();
+                    Message_Destroy(message);
+
+                    BROKER_LATENCY_HISTOGRAM histogram;
+                    printf("%s, %lu messages of %lu bytes, %lu published by the module\n", argv[1], messages, message_size, published_count);
+                    printf("  publish to return: %8.2f ns/msg\n", ns_per_message(start, end, messages));
+                    if (Broker_GetLatencyHistogram(broker, &module, &histogram) == BROKER_OK)
+                    {
+                        print_histogram("  Module_Receive", &histogram);
+                        result = (histogram.count == messages) ? 0 : 1;
+                    }
+                }
+            }
+
+            (void)Broker_RemoveModule(broker, &sink);
+            (void)Broker_RemoveModule(broker, &module);
+            (void)Broker_RemoveModule(broker, &source);
+            MODULE_DESTROY(module.module_apis)(module.module_handle);
+        }
+        loader->api->Unload(loader, library);
+    }
+
+    STRING_delete(entrypoint.moduleLibraryFileName);
+    Broker_Destroy(broker);
+    return result;
+}
@@ -84,6 +84,7 @@ TEST_FUNCTION(Performance_e2e_5_second_run)
 
         links[0].module_source = "simulator1";
         links[0].module_sink = "metrics1";
+        links[0].fuse = false;
 
         GATEWAY_PROPERTIES performance_gw_properties;
         VECTOR_HANDLE gatewayProps = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
@@ -153,6 +154,7 @@ TEST_FUNCTION(Performance_e2e_10_second_run)
 
         links[0].module_source = "simulator1";
         links[0].module_sink = "metrics1";
+        links[0].fuse = false;
 
         GATEWAY_PROPERTIES performance_gw_properties;
         VECTOR_HANDLE gatewayProps = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
@@ -0,0 +1,92 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cstdlib>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "broker.h"
+#include "message.h"
+#include "module.h"
+
+#include "relay.h"
+
+typedef struct RELAY_MODULE_HANDLE_TAG
+{
+    BROKER_HANDLE broker;
+} RELAY_MODULE_HANDLE;
+
+static void* RelayModule_ParseConfigurationFromJson(const char* configuration)
+{
+    (void)configuration;
+    return NULL;
+}
+
+static void RelayModule_FreeConfiguration(void* configuration)
+{
+    (void)configuration;
+}
+
+static MODULE_HANDLE RelayModule_Create(BROKER_HANDLE broker, const void* configuration)
+{
+    RELAY_MODULE_HANDLE * module;
+    (void)configuration;
+
+    if (broker == NULL)
+    {
+        LogError("Relay had a null broker");
+        module = NULL;
+    }
+    else
+    {
+        module = (RELAY_MODULE_HANDLE*)malloc(sizeof(RELAY_MODULE_HANDLE));
+        if (module == NULL)
+        {
+            LogError("Could not allocate memory for module handle");
+        }
+        else
+        {
+            module->broker = broker;
+        }
+    }
+    return (MODULE_HANDLE)module;
+}
+
+static void RelayModule_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    if (moduleHandle != NULL && messageHandle != NULL)
+    {
+        RELAY_MODULE_HANDLE * module = (RELAY_MODULE_HANDLE *)moduleHandle;
+        if (Broker_Publish(module->broker, moduleHandle, messageHandle) != BROKER_OK)
+        {
+            LogError("unable to relay message");
+        }
+    }
+}
+
+static void RelayModule_Destroy(MODULE_HANDLE moduleHandle)
+{
+    free(moduleHandle);
+}
+
+static const MODULE_API_1 RELAY_APIS_all =
+{
+    {MODULE_API_VERSION_1},
+
+    RelayModule_ParseConfigurationFromJson,
+    RelayModule_FreeConfiguration,
+    RelayModule_Create,
+    RelayModule_Destroy,
+    RelayModule_Receive,
+    NULL
+};
+
+#ifdef BUILD_MODULE_TYPE_STATIC
+MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(RELAY_MODULE)(MODULE_API_VERSION gateway_api_version)
+#else
+MODULE_EXPORT const MODULE_API* Module_GetApi(MODULE_API_VERSION gateway_api_version)
+#endif
+{
+    (void)gateway_api_version;
+    return reinterpret_cast< const MODULE_API *>(&RELAY_APIS_all);
+}
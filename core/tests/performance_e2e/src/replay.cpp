@@ -0,0 +1,408 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <parson.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "message.h"
+#include "module.h"
+#include "broker.h"
+
+#include "replay.h"
+#include "trace_file.h"
+
+using SteadyClock = std::chrono::steady_clock;
+using MicroSeconds = std::chrono::microseconds;
+
+/*longest single sleep, so Destroy is not held up by a large gap in the trace*/
+#define REPLAY_MAX_SLEEP_MS 100
+
+typedef struct REPLAY_MODULE_HANDLE_TAG
+{
+    BROKER_HANDLE broker;
+    char * filename;
+    char * source;
+    double speed;
+    size_t repeat;
+    bool thread_flag;
+    THREAD_HANDLE main_thread;
+    long long messages_published;
+    long long records_skipped;
+} REPLAY_MODULE_HANDLE;
+
+
+static void* ReplayModule_ParseConfigurationFromJson(const char* configuration)
+{
+    REPLAY_MODULE_CONFIG * result;
+    if (configuration == NULL)
+    {
+        LogError("Replay module expects configuration");
+        result = NULL;
+    }
+    else
+    {
+        JSON_Value* json = json_parse_string((const char*)configuration);
+        if (json == NULL)
+        {
+            LogError("unable to json_parse_string");
+            result = NULL;
+        }
+        else
+        {
+            JSON_Object* obj = json_value_get_object(json);
+            if (obj == NULL)
+            {
+                LogError("unable to json_value_get_object");
+                result = NULL;
+            }
+            else
+            {
+                const char* filenameValue = json_object_get_string(obj, "filename");
+                const char* sourceValue = json_object_get_string(obj, "source");
+                double speedValue = (json_object_has_value(obj, "speed") != 0) ? json_object_get_number(obj, "speed") : 1.0;
+                double repeatValue = (json_object_has_value(obj, "repeat") != 0) ? json_object_get_number(obj, "repeat") : 1.0;
+                if (filenameValue == NULL)
+                {
+                    LogError("filename is a required field in configuration");
+                    result = NULL;
+                }
+                else if (speedValue < 0.0 || repeatValue < 1.0)
+                {
+                    LogError("speed must be >= 0 and repeat must be >= 1");
+                    result = NULL;
+                }
+                else
+                {
+                    result = (REPLAY_MODULE_CONFIG *)malloc(sizeof(REPLAY_MODULE_CONFIG));
+                    if (result == NULL)
+                    {
+                        LogError("Could not allocated Module data");
+                    }
+                    else if (mallocAndStrcpy_s(&(result->filename), filenameValue) != 0)
+                    {
+                        LogError("could not allocate memory for filename string");
+                        free(result);
+                        result = NULL;
+                    }
+                    else
+                    {
+                        result->source = NULL;
+                        if (sourceValue != NULL && mallocAndStrcpy_s(&(result->source), sourceValue) != 0)
+                        {
+                            LogError("could not allocate memory for source string");
+                            free(result->filename);
+                            free(result);
+                            result = NULL;
+                        }
+                        else
+                        {
+                            result->speed = speedValue;
+                            result->repeat = (size_t)repeatValue;
+                        }
+                    }
+                }
+            }
+            json_value_free(json);
+        }
+    }
+    return result;
+}
+
+static void ReplayModule_FreeConfiguration(void* configuration)
+{
+    if (configuration != NULL)
+    {
+        REPLAY_MODULE_CONFIG * conf = (REPLAY_MODULE_CONFIG*)configuration;
+        free(conf->filename);
+        free(conf->source);
+        free(conf);
+    }
+}
+
+static MODULE_HANDLE ReplayModule_Create(BROKER_HANDLE broker, const void* configuration)
+{
+    REPLAY_MODULE_HANDLE * module;
+
+    if ((broker == NULL) ||
+        (configuration == NULL))
+    {
+        LogError("Replay had a null input. broker: [%p], configuration: [%p]", broker, configuration);
+        module = NULL;
+    }
+    else
+    {
+        REPLAY_MODULE_CONFIG * conf = (REPLAY_MODULE_CONFIG *)configuration;
+        module = (REPLAY_MODULE_HANDLE*)malloc(sizeof(REPLAY_MODULE_HANDLE));
+        if (module == NULL)
+        {
+            LogError("Could not allocate memory for module handle");
+        }
+        else if (mallocAndStrcpy_s(&(module->filename), conf->filename) != 0)
+        {
+            LogError("could not allocate memory for filename string");
+            free(module);
+            module = NULL;
+        }
+        else
+        {
+            module->source = NULL;
+            if (conf->source != NULL && mallocAndStrcpy_s(&(module->source), conf->source) != 0)
+            {
+                LogError("could not allocate memory for source string");
+                free(module->filename);
+                free(module);
+                module = NULL;
+            }
+            else
+            {
+                module->broker = broker;
+                module->speed = conf->speed;
+                module->repeat = conf->repeat;
+                module->thread_flag = false;
+                module->main_thread = NULL;
+                module->messages_published = 0;
+                module->records_skipped = 0;
+            }
+        }
+    }
+    return (MODULE_HANDLE)module;
+}
+
+/*waits until the given point in time, giving up early when the module is being destroyed*/
+static void ReplayModule_WaitUntil(REPLAY_MODULE_HANDLE * module, SteadyClock::time_point deadline)
+{
+    while (module->thread_flag)
+    {
+        SteadyClock::time_point now = SteadyClock::now();
+        if (now >= deadline)
+        {
+            break;
+        }
+        else
+        {
+            long long remaining_ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+            if (remaining_ms <= 0)
+            {
+                /*sub-millisecond remainder, yield instead of oversleeping*/
+                ThreadAPI_Sleep(0);
+            }
+            else
+            {
+                ThreadAPI_Sleep((unsigned int)((remaining_ms > REPLAY_MAX_SLEEP_MS) ? REPLAY_MAX_SLEEP_MS : remaining_ms));
+            }
+        }
+    }
+}
+
+/*replays the trace once, returns 0 when the whole file was consumed*/
+static int ReplayModule_PlayOnce(REPLAY_MODULE_HANDLE * module, FILE * fin)
+{
+    int result = 0;
+    size_t filter_length = (module->source == NULL) ? 0 : strlen(module->source);
+    unsigned char * message_buffer = NULL;
+    size_t message_buffer_size = 0;
+    char * source_buffer = (char*)malloc(TRACE_FILE_MAX_SOURCE_NAME + 1);
+    SteadyClock::time_point replay_start = SteadyClock::now();
+
+    if (source_buffer == NULL)
+    {
+        LogError("unable to allocate source name buffer");
+        result = -__LINE__;
+    }
+    else
+    {
+        while (module->thread_flag)
+        {
+            uint64_t timestamp;
+            uint64_t source_length;
+            uint64_t message_length;
+            if (!trace_read_uint(fin, &timestamp, 8))
+            {
+                /*clean end of trace*/
+                break;
+            }
+            else if (!trace_read_uint(fin, &source_length, 2) ||
+                (fread(source_buffer, 1, (size_t)source_length, fin) != (size_t)source_length) ||
+                !trace_read_uint(fin, &message_length, 4))
+            {
+                LogError("truncated trace record");
+                result = -__LINE__;
+                break;
+            }
+            else
+            {
+                if (message_length > message_buffer_size)
+                {
+                    unsigned char * new_buffer = (unsigned char*)realloc(message_buffer, (size_t)message_length);
+                    if (new_buffer == NULL)
+                    {
+                        LogError("unable to allocate message buffer");
+                        result = -__LINE__;
+                        break;
+                    }
+                    message_buffer = new_buffer;
+                    message_buffer_size = (size_t)message_length;
+                }
+
+                if (fread(message_buffer, 1, (size_t)message_length, fin) != (size_t)message_length)
+                {
+                    LogError("truncated trace record");
+                    result = -__LINE__;
+                    break;
+                }
+                else if (module->source != NULL &&
+                    ((source_length != filter_length) || (memcmp(source_buffer, module->source, filter_length) != 0)))
+                {
+                    module->records_skipped++;
+                }
+                else
+                {
+                    if (module->speed > 0.0)
+                    {
+                        MicroSeconds offset((long long)((double)timestamp / module->speed));
+                        ReplayModule_WaitUntil(module, replay_start + offset);
+                    }
+
+                    MESSAGE_HANDLE message = Message_CreateFromByteArray(message_buffer, (int32_t)message_length);
+                    if (message == NULL)
+                    {
+                        LogError("unable to deserialize trace message");
+                        module->records_skipped++;
+                    }
+                    else
+                    {
+                        if (Broker_Publish(module->broker, (MODULE_HANDLE)module, message) != BROKER_OK)
+                        {
+                            LogError("Unable to publish message");
+                            result = -__LINE__;
+                        }
+                        else
+                        {
+                            module->messages_published++;
+                        }
+                        Message_Destroy(message);
+                        if (result != 0)
+                        {
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        free(source_buffer);
+        free(message_buffer);
+    }
+    return result;
+}
+
+static int ReplayModule_thread(void * context)
+{
+    REPLAY_MODULE_HANDLE * module = (REPLAY_MODULE_HANDLE *)context;
+    int thread_result = 0;
+
+    for (size_t iteration = 0; (iteration < module->repeat) && module->thread_flag && (thread_result == 0); iteration++)
+    {
+        FILE * fin = fopen(module->filename, "rb");
+        if (fin == NULL)
+        {
+            LogError("unable to open trace file %s", module->filename);
+            thread_result = -__LINE__;
+        }
+        else
+        {
+            if (!trace_read_header(fin))
+            {
+                LogError("%s is not a trace file or has an unsupported version", module->filename);
+                thread_result = -__LINE__;
+            }
+            else
+            {
+                thread_result = ReplayModule_PlayOnce(module, fin);
+            }
+            (void)fclose(fin);
+        }
+    }
+    return thread_result;
+}
+
+static void ReplayModule_Start(MODULE_HANDLE moduleHandle)
+{
+    if (moduleHandle != NULL)
+    {
+        REPLAY_MODULE_HANDLE * module = (REPLAY_MODULE_HANDLE *)moduleHandle;
+
+        module->thread_flag = true;
+        if (ThreadAPI_Create(&(module->main_thread), ReplayModule_thread, module) != 0)
+        {
+            LogError("Thread Creation failed");
+            module->main_thread = NULL;
+        }
+    }
+}
+
+static void ReplayModule_Destroy(MODULE_HANDLE moduleHandle)
+{
+    if (moduleHandle == NULL)
+    {
+        LogError("Destroying a NULL module");
+    }
+    else
+    {
+        REPLAY_MODULE_HANDLE * module = (REPLAY_MODULE_HANDLE *)moduleHandle;
+        module->thread_flag = false;
+        if (module->main_thread != NULL)
+        {
+            int thread_result;
+            (void)ThreadAPI_Join(module->main_thread, &thread_result);
+            if (thread_result != 0)
+            {
+                LogInfo("Thread ended with non-zero result: %d", thread_result);
+            }
+        }
+        std::cout
+            << "Replay Metrics:" << std::endl
+            << "---------------" << std::endl
+            << "Messages published: " << module->messages_published << std::endl
+            << "Records skipped: " << module->records_skipped << std::endl;
+        free(module->filename);
+        free(module->source);
+        free(module);
+    }
+}
+
+static void ReplayModule_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    /*replay is a pure source, nothing to do with incoming messages*/
+    (void)moduleHandle;
+    (void)messageHandle;
+}
+
+static const MODULE_API_1 REPLAY_APIS_all =
+{
+    {MODULE_API_VERSION_1},
+
+    ReplayModule_ParseConfigurationFromJson,
+    ReplayModule_FreeConfiguration,
+    ReplayModule_Create,
+    ReplayModule_Destroy,
+    ReplayModule_Receive,
+    ReplayModule_Start
+};
+
+#ifdef BUILD_MODULE_TYPE_STATIC
+MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(REPLAY_MODULE)(MODULE_API_VERSION gateway_api_version)
+#else
+MODULE_EXPORT const MODULE_API* Module_GetApi(MODULE_API_VERSION gateway_api_version)
+#endif
+{
+    (void)gateway_api_version;
+    return reinterpret_cast< const MODULE_API *>(&REPLAY_APIS_all);
+}
@@ -291,57 +291,45 @@ static int SimulatorModule_thread(void * context)
         long long time_to_wait = module->message_delay * 1000;
 
         size_t messages_produced = 0;
+        MESSAGE_TYPED_PROPERTY typed_properties[2];
+        typed_properties[0].name = "timestamp";
+        typed_properties[0].type = MESSAGE_PROPERTY_INT64;
+        typed_properties[1].name = "sequence number";
+        typed_properties[1].type = MESSAGE_PROPERTY_INT64;
         thread_result = 0;
         while (module->thread_flag)
         {
             std::chrono::time_point<HrClock, MicroSeconds> t1 = std::chrono::time_point_cast<MicroSeconds>(HrClock::now());
             auto t1_as_int = t1.time_since_epoch().count();
-            std::string t1_as_string = std::to_string(t1_as_int);
             messages_produced++;
-            std::string messages_produced_as_string = std::to_string(messages_produced);
-            if (Map_AddOrUpdate(message_to_send.sourceProperties, "timestamp", t1_as_string.c_str()) != MAP_OK)
+            typed_properties[0].value.int64Value = (int64_t)t1_as_int;
+            typed_properties[1].value.int64Value = (int64_t)messages_produced;
+            MESSAGE_HANDLE next_message = Message_CreateWithTypedProperties(&message_to_send, typed_properties, 2);
+            if (next_message == NULL)
             {
-                LogError("Unable to update timestamp in message");
-                module->thread_flag = false;
-                thread_result = -__LINE__;
-                break;
-            }
-            else if (Map_AddOrUpdate(message_to_send.sourceProperties, "sequence number", messages_produced_as_string.c_str()) != MAP_OK)
-            {
-                LogError("Unable to update sequence number in message");
+                LogError("Unable to create next message");
                 module->thread_flag = false;
                 thread_result = -__LINE__;
                 break;
             }
             else
             {
-                MESSAGE_HANDLE next_message = Message_Create(&message_to_send);
-                if (next_message == NULL)
+                if (Broker_Publish(module->broker, module, next_message) != BROKER_OK)
                 {
-                    LogError("Unable to create next message");
+                    LogError("Unable to publish message");
                     module->thread_flag = false;
                     thread_result = -__LINE__;
                     break;
                 }
                 else
                 {
-                    if (Broker_Publish(module->broker, module, next_message) != BROKER_OK)
-                    {
-                        LogError("Unable to publish message");
-                        module->thread_flag = false;
-                        thread_result = -__LINE__;
-                        break;
-                    }
-                    else
+                    Message_Destroy(next_message);
+                    std::chrono::time_point<HrClock, MicroSeconds> t2 = std::chrono::time_point_cast<MicroSeconds>(HrClock::now());
+                    auto time_to_publish = t2.time_since_epoch().count() - t1_as_int;
+                    if (time_to_publish < time_to_wait)
                     {
-                        Message_Destroy(next_message);
-                        std::chrono::time_point<HrClock, MicroSeconds> t2 = std::chrono::time_point_cast<MicroSeconds>(HrClock::now());
-                        auto time_to_publish = t2.time_since_epoch().count() - t1_as_int;
-                        if (time_to_publish < time_to_wait)
-                        {
-                            unsigned int remaining_time = static_cast<unsigned int>((time_to_wait - time_to_publish)/1000);
-                            ThreadAPI_Sleep(remaining_time);
-                        }
+                        unsigned int remaining_time = static_cast<unsigned int>((time_to_wait - time_to_publish)/1000);
+                        ThreadAPI_Sleep(remaining_time);
                     }
                 }
             }
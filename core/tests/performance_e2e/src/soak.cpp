@@ -0,0 +1,349 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#include "azure_c_shared_utility/threadapi.h"
+#include "dynamic_library.h"
+
+#include "metrics.h"
+#include "soak.h"
+
+extern "C" size_t gballoc_getMaximumMemoryUsed(void);
+extern "C" size_t gballoc_getCurrentMemoryUsed(void);
+
+using SteadyClock = std::chrono::steady_clock;
+
+/*samples taken before the gateway settles are not used for drift detection*/
+#define SOAK_WARMUP_PERCENT 10
+#define SOAK_MIN_SAMPLES 8
+
+#ifdef _WIN32
+
+static long long soak_get_rss(void)
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    long long result;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == 0)
+    {
+        result = -1;
+    }
+    else
+    {
+        result = (long long)counters.WorkingSetSize;
+    }
+    return result;
+}
+
+static long long soak_get_thread_count(void)
+{
+    long long result = -1;
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snapshot != INVALID_HANDLE_VALUE)
+    {
+        THREADENTRY32 entry;
+        DWORD pid = GetCurrentProcessId();
+        entry.dwSize = sizeof(entry);
+        result = 0;
+        if (Thread32First(snapshot, &entry))
+        {
+            do
+            {
+                if (entry.th32OwnerProcessID == pid)
+                {
+                    result++;
+                }
+            } while (Thread32Next(snapshot, &entry));
+        }
+        (void)CloseHandle(snapshot);
+    }
+    return result;
+}
+
+static long long soak_get_socket_count(void)
+{
+    /*no cheap way to enumerate the sockets of a process on Windows*/
+    return -1;
+}
+
+#else
+
+/*reads a "Name:   value" line from /proc/self/status*/
+static long long soak_read_proc_status(const char * field)
+{
+    long long result = -1;
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t field_length = strlen(field);
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, field_length, field) == 0)
+        {
+            result = std::stoll(line.substr(field_length));
+            break;
+        }
+    }
+    return result;
+}
+
+static long long soak_get_rss(void)
+{
+    long long rss_kb = soak_read_proc_status("VmRSS:");
+    return (rss_kb < 0) ? -1 : rss_kb * 1024;
+}
+
+static long long soak_get_thread_count(void)
+{
+    return soak_read_proc_status("Threads:");
+}
+
+static long long soak_get_socket_count(void)
+{
+    long long result = -1;
+    DIR * fd_dir = opendir("/proc/self/fd");
+    if (fd_dir != NULL)
+    {
+        struct dirent * entry;
+        result = 0;
+        while ((entry = readdir(fd_dir)) != NULL)
+        {
+            char path[64];
+            char target[64];
+            ssize_t length;
+            (void)snprintf(path, sizeof(path), "/proc/self/fd/%s", entry->d_name);
+            length = readlink(path, target, sizeof(target) - 1);
+            if (length > 0)
+            {
+                target[length] = '\0';
+                if (strncmp(target, "socket:", 7) == 0)
+                {
+                    result++;
+                }
+            }
+        }
+        (void)closedir(fd_dir);
+    }
+    return result;
+}
+
+#endif
+
+static double soak_mean(const std::vector<double>& values, size_t begin, size_t end)
+{
+    double sum = 0;
+    for (size_t i = begin; i < end; i++)
+    {
+        sum += values[i];
+    }
+    return (end > begin) ? sum / (end - begin) : 0;
+}
+
+/*least squares slope of values over time, in units per second*/
+static double soak_slope(const std::vector<double>& times, const std::vector<double>& values, size_t begin, size_t end)
+{
+    double mean_t = soak_mean(times, begin, end);
+    double mean_v = soak_mean(values, begin, end);
+    double numerator = 0;
+    double denominator = 0;
+    for (size_t i = begin; i < end; i++)
+    {
+        numerator += (times[i] - mean_t) * (values[i] - mean_v);
+        denominator += (times[i] - mean_t) * (times[i] - mean_t);
+    }
+    return (denominator > 0) ? numerator / denominator : 0;
+}
+
+/*
+ * Flags a memory series as leaking when its trend over the run exceeds the
+ * allowed growth and the last quarter of the run sits above the first quarter,
+ * so that a single late spike or a sawtooth pattern does not fail the run.
+ */
+static bool soak_check_memory(const char * name, const std::vector<double>& times, const std::vector<double>& values, size_t begin, double max_growth_kb_per_hour)
+{
+    size_t end = values.size();
+    size_t quarter = (end - begin) / 4;
+    double growth_kb_per_hour = soak_slope(times, values, begin, end) * 3600.0 / 1024.0;
+    double early = soak_mean(values, begin, begin + quarter);
+    double late = soak_mean(values, end - quarter, end);
+    bool passed = !((growth_kb_per_hour > max_growth_kb_per_hour) && (late > early));
+
+    std::cout
+        << name << " growth: " << growth_kb_per_hour << " KB/hour"
+        << " (first quarter mean " << (long long)early << ", last quarter mean " << (long long)late << ")"
+        << (passed ? " PASS" : " FAIL") << std::endl;
+    return passed;
+}
+
+static bool soak_check_throughput(const std::vector<double>& rates, size_t begin, double max_decay)
+{
+    size_t end = rates.size();
+    size_t quarter = (end - begin) / 4;
+    double early = soak_mean(rates, begin, begin + quarter);
+    double late = soak_mean(rates, end - quarter, end);
+    double decay = (early > 0) ? (early - late) * 100.0 / early : 0;
+    bool passed = (decay <= max_decay);
+
+    std::cout
+        << "Throughput decay: " << decay << "%"
+        << " (first quarter " << early << " msg/s, last quarter " << late << " msg/s)"
+        << (passed ? " PASS" : " FAIL") << std::endl;
+    return passed;
+}
+
+static void soak_write_csv_header(std::ofstream& csv)
+{
+    csv << "elapsed_s,rss_bytes,gballoc_current_bytes,gballoc_maximum_bytes,threads,sockets,messages_received,interval_msg_per_s" << std::endl;
+}
+
+static void soak_write_csv_row(std::ofstream& csv, const SOAK_SAMPLE& sample)
+{
+    csv
+        << sample.elapsed << ','
+        << sample.rss << ','
+        << sample.gballoc_current << ','
+        << sample.gballoc_maximum << ','
+        << sample.thread_count << ','
+        << sample.socket_count << ','
+        << sample.messages_received << ','
+        << sample.interval_throughput << std::endl;
+}
+
+int Soak_Run(const SOAK_CONFIG * config)
+{
+    int result;
+    DYNAMIC_LIBRARY_HANDLE metrics_library = NULL;
+    pfMetricsModule_GetTotalMessagesReceived get_messages_received = NULL;
+    std::ofstream csv;
+
+    if (config->metrics_library != NULL)
+    {
+        metrics_library = DynamicLibrary_LoadLibrary(config->metrics_library);
+        if (metrics_library == NULL)
+        {
+            std::cout << "unable to load " << config->metrics_library << ", throughput will not be measured" << std::endl;
+        }
+        else
+        {
+            get_messages_received = (pfMetricsModule_GetTotalMessagesReceived)DynamicLibrary_FindSymbol(metrics_library, METRICS_GET_TOTAL_MESSAGES_RECEIVED_NAME);
+            if (get_messages_received == NULL)
+            {
+                std::cout << config->metrics_library << " does not export " METRICS_GET_TOTAL_MESSAGES_RECEIVED_NAME ", throughput will not be measured" << std::endl;
+            }
+        }
+    }
+
+    if (config->csv_filename != NULL)
+    {
+        csv.open(config->csv_filename);
+        if (!csv.is_open())
+        {
+            std::cout << "unable to open " << config->csv_filename << ", time series will not be written" << std::endl;
+        }
+        else
+        {
+            soak_write_csv_header(csv);
+        }
+    }
+
+    std::vector<double> times;
+    std::vector<double> rss;
+    std::vector<double> gballoc_current;
+    std::vector<double> rates;
+    SteadyClock::time_point start = SteadyClock::now();
+    SteadyClock::time_point last_time = start;
+    long long last_messages = (get_messages_received == NULL) ? -1 : get_messages_received();
+    unsigned int samples_to_take = (config->interval == 0) ? 0 : config->duration / config->interval;
+
+    for (unsigned int i = 0; i < samples_to_take; i++)
+    {
+        SteadyClock::time_point deadline = start + std::chrono::seconds((long long)(i + 1) * config->interval);
+        SteadyClock::time_point now = SteadyClock::now();
+        if (deadline > now)
+        {
+            ThreadAPI_Sleep((unsigned int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+        }
+
+        SOAK_SAMPLE sample;
+        now = SteadyClock::now();
+        sample.elapsed = std::chrono::duration<double>(now - start).count();
+        sample.rss = soak_get_rss();
+        sample.gballoc_current = (long long)gballoc_getCurrentMemoryUsed();
+        sample.gballoc_maximum = (long long)gballoc_getMaximumMemoryUsed();
+        sample.thread_count = soak_get_thread_count();
+        sample.socket_count = soak_get_socket_count();
+        if (get_messages_received == NULL)
+        {
+            sample.messages_received = -1;
+            sample.interval_throughput = -1;
+        }
+        else
+        {
+            double interval = std::chrono::duration<double>(now - last_time).count();
+            sample.messages_received = get_messages_received();
+            sample.interval_throughput = (interval > 0) ? (sample.messages_received - last_messages) / interval : 0;
+            last_messages = sample.messages_received;
+        }
+        last_time = now;
+
+        if (csv.is_open())
+        {
+            soak_write_csv_row(csv, sample);
+        }
+
+        times.push_back(sample.elapsed);
+        rss.push_back((double)sample.rss);
+        gballoc_current.push_back((double)sample.gballoc_current);
+        rates.push_back(sample.interval_throughput);
+    }
+
+    std::cout
+        << "Soak Summary:" << std::endl
+        << "-------------" << std::endl
+        << "Samples: " << times.size() << std::endl;
+
+    size_t warmup = (times.size() * SOAK_WARMUP_PERCENT) / 100;
+    if (times.size() - warmup < SOAK_MIN_SAMPLES)
+    {
+        std::cout << "Not enough samples for drift detection, need at least " << SOAK_MIN_SAMPLES << " after warmup. INCONCLUSIVE" << std::endl;
+        result = 0;
+    }
+    else
+    {
+        bool passed = true;
+        if (rss.back() >= 0)
+        {
+            passed = soak_check_memory("RSS", times, rss, warmup, config->max_growth_kb_per_hour) && passed;
+        }
+        if (gballoc_current.back() > 0)
+        {
+            passed = soak_check_memory("gballoc", times, gballoc_current, warmup, config->max_growth_kb_per_hour) && passed;
+        }
+        if (get_messages_received != NULL)
+        {
+            passed = soak_check_throughput(rates, warmup, config->max_throughput_decay) && passed;
+        }
+        std::cout << "Soak result: " << (passed ? "PASS" : "FAIL") << std::endl;
+        result = passed ? 0 : 1;
+    }
+
+    if (metrics_library != NULL)
+    {
+        DynamicLibrary_UnloadLibrary(metrics_library);
+    }
+    return result;
+}
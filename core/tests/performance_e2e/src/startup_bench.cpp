@@ -0,0 +1,757 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures how long the gateway takes to start, from reading its JSON
+// configuration to the first message delivered end to end. For each module
+// count it writes a configuration with a chain of relay modules between a
+// source and a sink, source -> relay0 -> ... -> relayN-1 -> sink. The source
+// publishes one message when it is started and the sink records when it
+// arrives.
+//
+// Each configuration is started twice. The first run takes the steps
+// Gateway_CreateFromJson and Gateway_Start take, one layer down, and times
+// each phase on its own. The second run calls Gateway_CreateFromJson and
+// gives the total the phases should add up to.
+//
+// The relays are loaded with the static loader by default. --native,
+// --outprocess and --module load them like a deployment would, with the
+// native loader, out of process, or with any loader described in a JSON file.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <parson.h>
+
+#include "azure_c_shared_utility/map.h"
+
+#include "broker.h"
+#include "gateway.h"
+#include "message.h"
+#include "module.h"
+#include "module_access.h"
+#include "module_loader.h"
+#include "module_loaders/static_loader.h"
+#ifdef OUTPROCESS_ENABLED
+#include "module_loaders/outprocess_loader.h"
+#endif
+
+#include "relay.h"
+
+using SteadyClock = std::chrono::steady_clock;
+
+#define STARTUP_BENCH_TIMEOUT std::chrono::seconds(30)
+#define STARTUP_BENCH_CONFIG "startup_bench.json"
+
+static const size_t default_module_counts[] = { 1, 10, 50, 100, 250, 500 };
+
+typedef enum STARTUP_PHASE_TAG
+{
+    PHASE_JSON_PARSE,
+    PHASE_LOADER_INIT,
+    PHASE_BROKER_CREATE,
+    PHASE_MODULE_LOAD,
+    PHASE_MODULE_CREATE,
+    PHASE_BROKER_ADD_MODULE,
+    PHASE_LINKS,
+    PHASE_START,
+    PHASE_FIRST_DELIVERY,
+    PHASE_COUNT
+} STARTUP_PHASE;
+
+static const char* phase_names[PHASE_COUNT] =
+{
+    "json parse",
+    "loader init",
+    "Broker_Create",
+    "module load",
+    "Module_Create",
+    "Broker_AddModule",
+    "link setup",
+    "Gateway_Start",
+    "first delivery"
+};
+
+typedef struct STARTUP_TIMES_TAG
+{
+    double total_ms[PHASE_COUNT];
+    /** The slowest single call in the phase, for the per-module phases */
+    double max_ms[PHASE_COUNT];
+    double create_from_json_ms;
+    double create_from_json_delivery_ms;
+} STARTUP_TIMES;
+
+typedef enum RELAY_KIND_TAG
+{
+    RELAY_STATIC,
+    RELAY_NATIVE,
+    RELAY_OUTPROCESS,
+    RELAY_CUSTOM
+} RELAY_KIND;
+
+typedef struct BENCH_OPTIONS_TAG
+{
+    RELAY_KIND kind;
+    const char* relay_path;
+    const char* host_path;
+    JSON_Value* custom_module;
+    const char* csv_path;
+    std::vector<size_t> module_counts;
+} BENCH_OPTIONS;
+
+/*a module the benchmark loads through the module loader, as the gateway would*/
+typedef struct BENCH_MODULE_TAG
+{
+    const MODULE_LOADER* loader;
+    void* entrypoint;
+    char* args;
+    MODULE_LIBRARY_HANDLE library;
+    MODULE module;
+} BENCH_MODULE;
+
+static std::atomic<bool> delivered(false);
+static SteadyClock::time_point delivered_at;
+
+typedef struct ENDPOINT_MODULE_HANDLE_TAG
+{
+    BROKER_HANDLE broker;
+} ENDPOINT_MODULE_HANDLE;
+
+static void* Endpoint_ParseConfigurationFromJson(const char* configuration)
+{
+    (void)configuration;
+    return NULL;
+}
+
+static void Endpoint_FreeConfiguration(void* configuration)
+{
+    (void)configuration;
+}
+
+static MODULE_HANDLE Endpoint_Create(BROKER_HANDLE broker, const void* configuration)
+{
+    (void)configuration;
+    ENDPOINT_MODULE_HANDLE* module = (ENDPOINT_MODULE_HANDLE*)malloc(sizeof(ENDPOINT_MODULE_HANDLE));
+    if (module != NULL)
+    {
+        module->broker = broker;
+    }
+    return (MODULE_HANDLE)module;
+}
+
+static void Endpoint_Destroy(MODULE_HANDLE moduleHandle)
+{
+    free(moduleHandle);
+}
+
+static void Source_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    (void)moduleHandle;
+    (void)messageHandle;
+}
+
+/*the source is the first module, so it publishes before the relays are started*/
+static void Source_Start(MODULE_HANDLE moduleHandle)
+{
+    ENDPOINT_MODULE_HANDLE* module = (ENDPOINT_MODULE_HANDLE*)moduleHandle;
+    unsigned char content[] = "startup_bench";
+    MAP_HANDLE properties = Map_Create(NULL);
+    MESSAGE_CONFIG message_config = { sizeof(content), content, properties };
+    MESSAGE_HANDLE message = (properties == NULL) ? NULL : Message_Create(&message_config);
+    if (message == NULL)
+    {
+        printf("unable to create the first message\n");
+    }
+    else
+    {
+        (void)Broker_Publish(module->broker, moduleHandle, message);
+        Message_Destroy(message);
+    }
+    Map_Destroy(properties);
+}
+
+static void Sink_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    (void)moduleHandle;
+    (void)messageHandle;
+    if (!delivered.load())
+    {
+        delivered_at = SteadyClock::now();
+        delivered = true;
+    }
+}
+
+static MODULE_API_1 source_module_api =
+{
+    { MODULE_API_VERSION_1 },
+    Endpoint_ParseConfigurationFromJson,
+    Endpoint_FreeConfiguration,
+    Endpoint_Create,
+    Endpoint_Destroy,
+    Source_Receive,
+    Source_Start
+};
+
+static MODULE_API_1 sink_module_api =
+{
+    { MODULE_API_VERSION_1 },
+    Endpoint_ParseConfigurationFromJson,
+    Endpoint_FreeConfiguration,
+    Endpoint_Create,
+    Endpoint_Destroy,
+    Sink_Receive,
+    NULL
+};
+
+static const MODULE_API* Source_GetApi(MODULE_API_VERSION gateway_api_version)
+{
+    (void)gateway_api_version;
+    return (const MODULE_API*)&source_module_api;
+}
+
+static const MODULE_API* Sink_GetApi(MODULE_API_VERSION gateway_api_version)
+{
+    (void)gateway_api_version;
+    return (const MODULE_API*)&sink_module_api;
+}
+
+static const STATIC_LOADER_MODULE bench_modules[] =
+{
+    { "startup_source", Source_GetApi },
+    { "startup_sink", Sink_GetApi },
+    STATIC_LOADER_MODULE_ENTRY("relay", RELAY_MODULE)
+};
+
+static double elapsed_ms(SteadyClock::time_point start, SteadyClock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void add_time(STARTUP_TIMES* times, STARTUP_PHASE phase, SteadyClock::time_point start, SteadyClock::time_point end)
+{
+    double ms = elapsed_ms(start, end);
+    times->total_ms[phase] += ms;
+    if (ms > times->max_ms[phase])
+    {
+        times->max_ms[phase] = ms;
+    }
+}
+
+/*waits for the sink, and returns the time from `from` to the delivery, or a negative number*/
+static double wait_for_delivery(SteadyClock::time_point from)
+{
+    double result = -1.0;
+    SteadyClock::time_point deadline = SteadyClock::now() + STARTUP_BENCH_TIMEOUT;
+    while (!delivered.load() && SteadyClock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    if (delivered.load())
+    {
+        /*the message may arrive while the later modules are still being started*/
+        result = (delivered_at < from) ? 0.0 : elapsed_ms(from, delivered_at);
+    }
+    return result;
+}
+
+static JSON_Value* make_loader(const char* name, JSON_Value* entrypoint)
+{
+    JSON_Value* loader = json_value_init_object();
+    (void)json_object_set_string(json_value_get_object(loader), "name", name);
+    (void)json_object_set_value(json_value_get_object(loader), "entrypoint", entrypoint);
+    return loader;
+}
+
+static JSON_Value* make_static_loader(const char* module_name)
+{
+    JSON_Value* entrypoint = json_value_init_object();
+    (void)json_object_set_string(json_value_get_object(entrypoint), "module.name", module_name);
+    return make_loader(STATIC_LOADER_NAME, entrypoint);
+}
+
+static JSON_Value* make_native_loader(const char* module_path)
+{
+    JSON_Value* entrypoint = json_value_init_object();
+    (void)json_object_set_string(json_value_get_object(entrypoint), "module.path", module_path);
+    return make_loader("native", entrypoint);
+}
+
+static void add_module(JSON_Array* modules, const char* name, JSON_Value* loader, JSON_Value* args)
+{
+    JSON_Value* module = json_value_init_object();
+    (void)json_object_set_string(json_value_get_object(module), "name", name);
+    (void)json_object_set_value(json_value_get_object(module), "loader", loader);
+    (void)json_object_set_value(json_value_get_object(module), "args", (args == NULL) ? json_value_init_null() : args);
+    (void)json_array_append_value(modules, module);
+}
+
+static void add_relay(JSON_Array* modules, const BENCH_OPTIONS* options, size_t index)
+{
+    std::string name = "relay" + std::to_string(index);
+    switch (options->kind)
+    {
+    case RELAY_NATIVE:
+        add_module(modules, name.c_str(), make_native_loader(options->relay_path), NULL);
+        break;
+    case RELAY_OUTPROCESS:
+    {
+        /*every relay runs in its own host process, which hosts it with the native loader*/
+        std::string control_id = "startup_bench_" + std::to_string(index);
+        JSON_Value* entrypoint = json_value_init_object();
+        JSON_Value* launch = json_value_init_object();
+        JSON_Value* launch_args = json_value_init_array();
+        JSON_Value* args = json_value_init_object();
+        (void)json_array_append_string(json_value_get_array(launch_args), control_id.c_str());
+        (void)json_object_set_string(json_value_get_object(launch), "path", options->host_path);
+        (void)json_object_set_value(json_value_get_object(launch), "args", launch_args);
+        (void)json_object_set_string(json_value_get_object(entrypoint), "activation.type", "launch");
+        (void)json_object_set_string(json_value_get_object(entrypoint), "control.id", control_id.c_str());
+        (void)json_object_set_value(json_value_get_object(entrypoint), "launch", launch);
+        (void)json_object_set_value(json_value_get_object(args), "outprocess.loader", make_native_loader(options->relay_path));
+        (void)json_object_set_value(json_value_get_object(args), "module.args", json_value_init_null());
+        add_module(modules, name.c_str(), make_loader("outprocess", entrypoint), args);
+        break;
+    }
+    case RELAY_CUSTOM:
+    {
+        JSON_Object* custom = json_value_get_object(options->custom_module);
+        const JSON_Value* args = json_object_get_value(custom, "args");
+        add_module(modules, name.c_str(),
+            json_value_deep_copy(json_object_get_value(custom, "loader")),
+            (args == NULL) ? NULL : json_value_deep_copy(args));
+        break;
+    }
+    default:
+        add_module(modules, name.c_str(), make_static_loader("relay"), NULL);
+        break;
+    }
+}
+
+static void add_link(JSON_Array* links, const std::string& source, const std::string& sink)
+{
+    JSON_Value* link = json_value_init_object();
+    (void)json_object_set_string(json_value_get_object(link), "source", source.c_str());
+    (void)json_object_set_string(json_value_get_object(link), "sink", sink.c_str());
+    (void)json_array_append_value(links, link);
+}
+
+static bool write_config(const BENCH_OPTIONS* options, size_t relays)
+{
+    JSON_Value* root = json_value_init_object();
+    JSON_Value* modules = json_value_init_array();
+    JSON_Value* links = json_value_init_array();
+    std::string previous = "source";
+
+    add_module(json_value_get_array(modules), "source", make_static_loader("startup_source"), NULL);
+    for (size_t i = 0; i < relays; i++)
+    {
+        std::string name = "relay" + std::to_string(i);
+        add_relay(json_value_get_array(modules), options, i);
+        add_link(json_value_get_array(links), previous, name);
+        previous = name;
+    }
+    add_module(json_value_get_array(modules), "sink", make_static_loader("startup_sink"), NULL);
+    add_link(json_value_get_array(links), previous, "sink");
+
+    (void)json_object_set_value(json_value_get_object(root), "modules", modules);
+    (void)json_object_set_value(json_value_get_object(root), "links", links);
+    bool result = (json_serialize_to_file_pretty(root, STARTUP_BENCH_CONFIG) == JSONSuccess);
+    json_value_free(root);
+    return result;
+}
+
+static void destroy_modules(BROKER_HANDLE broker, std::vector<BENCH_MODULE>& modules)
+{
+    for (std::vector<BENCH_MODULE>::reverse_iterator it = modules.rbegin(); it != modules.rend(); ++it)
+    {
+        if (it->module.module_handle != NULL)
+        {
+            (void)Broker_RemoveModule(broker, &it->module);
+            MODULE_DESTROY(it->module.module_apis)(it->module.module_handle);
+        }
+        if (it->library != NULL)
+        {
+            it->loader->api->Unload(it->loader, it->library);
+        }
+        if (it->entrypoint != NULL)
+        {
+            it->loader->api->FreeEntrypoint(it->loader, it->entrypoint);
+        }
+        json_free_serialized_string(it->args);
+    }
+    modules.clear();
+#ifdef OUTPROCESS_ENABLED
+    OutprocessLoader_JoinChildProcesses();
+#endif
+}
+
+/*reads the module entries of the configuration, the part of parsing that needs the loaders*/
+static bool parse_modules(JSON_Array* json_modules, std::vector<BENCH_MODULE>& modules)
+{
+    bool result = true;
+    for (size_t i = 0; i < json_array_get_count(json_modules) && result; i++)
+    {
+        JSON_Object* json_module = json_array_get_object(json_modules, i);
+        JSON_Object* json_loader = json_object_get_object(json_module, "loader");
+        BENCH_MODULE module = { NULL, NULL, NULL, NULL, { NULL, NULL } };
+        module.loader = ModuleLoader_FindByName(json_object_get_string(json_loader, "name"));
+        if (module.loader == NULL)
+        {
+            printf("unknown loader %s\n", json_object_get_string(json_loader, "name"));
+            result = false;
+        }
+        else
+        {
+            module.entrypoint = module.loader->api->ParseEntrypointFromJson(module.loader, json_object_get_value(json_loader, "entrypoint"));
+            module.args = json_serialize_to_string(json_object_get_value(json_module, "args"));
+            modules.push_back(module);
+            result = (module.entrypoint != NULL && module.args != NULL);
+        }
+    }
+    return result;
+}
+
+/*starts the gateway the way Gateway_CreateFromJson does, one layer down, and times each phase*/
+static bool run_phases(STARTUP_TIMES* times)
+{
+    bool result = false;
+    std::vector<BENCH_MODULE> modules;
+    BROKER_HANDLE broker = NULL;
+    delivered = false;
+
+    SteadyClock::time_point start = SteadyClock::now();
+    JSON_Value* root = json_parse_file(STARTUP_BENCH_CONFIG);
+    SteadyClock::time_point end = SteadyClock::now();
+    add_time(times, PHASE_JSON_PARSE, start, end);
+
+    start = SteadyClock::now();
+    bool loaders_initialized = (root != NULL &&
+        ModuleLoader_Initialize() == MODULE_LOADER_SUCCESS &&
+        ModuleLoader_InitializeFromJson(json_object_get_value(json_value_get_object(root), "loaders")) == MODULE_LOADER_SUCCESS);
+    end = SteadyClock::now();
+    add_time(times, PHASE_LOADER_INIT, start, end);
+
+    if (!loaders_initialized)
+    {
+        printf("unable to read %s\n", STARTUP_BENCH_CONFIG);
+    }
+    else
+    {
+        JSON_Object* json_root = json_value_get_object(root);
+        JSON_Array* json_links = json_object_get_array(json_root, "links");
+
+        start = SteadyClock::now();
+        bool parsed = parse_modules(json_object_get_array(json_root, "modules"), modules);
+        end = SteadyClock::now();
+        add_time(times, PHASE_JSON_PARSE, start, end);
+
+        start = SteadyClock::now();
+        broker = Broker_Create();
+        end = SteadyClock::now();
+        add_time(times, PHASE_BROKER_CREATE, start, end);
+
+        bool added = parsed && (broker != NULL);
+        for (size_t i = 0; i < modules.size() && added; i++)
+        {
+            BENCH_MODULE* module = &modules[i];
+
+            start = SteadyClock::now();
+            module->library = module->loader->api->Load(module->loader, module->entrypoint);
+            const MODULE_API* module_apis = (module->library == NULL) ? NULL : module->loader->api->GetApi(module->loader, module->library);
+            const void* module_configuration = (module_apis == NULL) ? NULL : MODULE_PARSE_CONFIGURATION_FROM_JSON(module_apis)(module->args);
+            void* transformed_configuration = (module_apis == NULL) ? NULL : module->loader->api->BuildModuleConfiguration(module->loader, module->entrypoint, module_configuration);
+            end = SteadyClock::now();
+            add_time(times, PHASE_MODULE_LOAD, start, end);
+
+            if (module_apis == NULL)
+            {
+                printf("unable to load module %zu\n", i);
+                added = false;
+            }
+            else
+            {
+                start = SteadyClock::now();
+                MODULE_HANDLE module_handle = MODULE_CREATE(module_apis)(broker, transformed_configuration);
+                end = SteadyClock::now();
+                add_time(times, PHASE_MODULE_CREATE, start, end);
+
+                MODULE_FREE_CONFIGURATION(module_apis)((void*)module_configuration);
+                module->loader->api->FreeModuleConfiguration(module->loader, transformed_configuration);
+
+                if (module_handle == NULL)
+                {
+                    printf("Module_Create failed for module %zu\n", i);
+                    added = false;
+                }
+                else
+                {
+                    MODULE attached = { module_apis, module_handle };
+                    start = SteadyClock::now();
+                    added = (Broker_AddModule(broker, &attached) == BROKER_OK);
+                    end = SteadyClock::now();
+                    add_time(times, PHASE_BROKER_ADD_MODULE, start, end);
+
+                    if (!added)
+                    {
+                        printf("unable to attach module %zu to the broker\n", i);
+                        MODULE_DESTROY(module_apis)(module_handle);
+                    }
+                    else
+                    {
+                        module->module = attached;
+                    }
+                }
+            }
+        }
+
+        /*the chain is linked in module order, so link i is modules[i] -> modules[i + 1]*/
+        start = SteadyClock::now();
+        for (size_t i = 0; added && i < json_array_get_count(json_links); i++)
+        {
+            BROKER_LINK_DATA link = { modules[i].module.module_handle, modules[i + 1].module.module_handle };
+            added = (Broker_AddLink(broker, &link) == BROKER_OK);
+        }
+        end = SteadyClock::now();
+        add_time(times, PHASE_LINKS, start, end);
+
+        if (!added)
+        {
+            printf("unable to set up %zu modules\n", modules.size());
+        }
+        else
+        {
+            start = SteadyClock::now();
+            for (size_t i = 0; i < modules.size(); i++)
+            {
+                pfModule_Start pfStart = MODULE_START(modules[i].module.module_apis);
+                if (pfStart != NULL)
+                {
+                    (pfStart)(modules[i].module.module_handle);
+                }
+            }
+            end = SteadyClock::now();
+            add_time(times, PHASE_START, start, end);
+
+            double delivery_ms = wait_for_delivery(end);
+            if (delivery_ms < 0.0)
+            {
+                printf("the first message did not reach the sink\n");
+            }
+            else
+            {
+                times->total_ms[PHASE_FIRST_DELIVERY] = delivery_ms;
+                result = true;
+            }
+        }
+
+        destroy_modules(broker, modules);
+    }
+
+    if (broker != NULL)
+    {
+        Broker_Destroy(broker);
+    }
+    if (loaders_initialized)
+    {
+        ModuleLoader_Destroy();
+    }
+    if (root != NULL)
+    {
+        json_value_free(root);
+    }
+    return result;
+}
+
+/*starts the same configuration with Gateway_CreateFromJson*/
+static bool run_gateway(STARTUP_TIMES* times)
+{
+    bool result = false;
+    delivered = false;
+
+    SteadyClock::time_point start = SteadyClock::now();
+    GATEWAY_HANDLE gateway = Gateway_CreateFromJson(STARTUP_BENCH_CONFIG);
+    SteadyClock::time_point end = SteadyClock::now();
+    if (gateway == NULL)
+    {
+        printf("Gateway_CreateFromJson failed\n");
+    }
+    else
+    {
+        double delivery_ms = wait_for_delivery(end);
+        if (delivery_ms < 0.0)
+        {
+            printf("the first message did not reach the sink\n");
+        }
+        else
+        {
+            times->create_from_json_ms = elapsed_ms(start, end);
+            times->create_from_json_delivery_ms = elapsed_ms(start, end) + delivery_ms;
+            result = true;
+        }
+        Gateway_Destroy(gateway);
+    }
+    return result;
+}
+
+static void print_times(size_t relays, const STARTUP_TIMES* times)
+{
+    /*the per-module phases are also reported per module and for the slowest call*/
+    size_t modules = relays + 2;
+    double sum_ms = 0.0;
+    printf("%zu relays (%zu modules)\n", relays, modules);
+    printf("  %-18s %12s %14s %12s\n", "phase", "total ms", "per module us", "max us");
+    for (size_t i = 0; i < PHASE_COUNT; i++)
+    {
+        sum_ms += times->total_ms[i];
+        if (i == PHASE_MODULE_LOAD || i == PHASE_MODULE_CREATE || i == PHASE_BROKER_ADD_MODULE)
+        {
+            printf("  %-18s %12.3f %14.1f %12.1f\n", phase_names[i], times->total_ms[i], times->total_ms[i] * 1000.0 / modules, times->max_ms[i] * 1000.0);
+        }
+        else
+        {
+            printf("  %-18s %12.3f\n", phase_names[i], times->total_ms[i]);
+        }
+    }
+    printf("  %-18s %12.3f\n", "sum of phases", sum_ms);
+    printf("  Gateway_CreateFromJson %8.3f ms, first delivery after %.3f ms\n", times->create_from_json_ms, times->create_from_json_delivery_ms);
+}
+
+static void append_csv(FILE* csv, size_t relays, const STARTUP_TIMES* times)
+{
+    fprintf(csv, "%zu", relays);
+    for (size_t i = 0; i < PHASE_COUNT; i++)
+    {
+        fprintf(csv, ",%.3f", times->total_ms[i]);
+    }
+    fprintf(csv, ",%.3f,%.3f\n", times->create_from_json_ms, times->create_from_json_delivery_ms);
+}
+
+static void print_usage(const char* program)
+{
+    printf("usage: %s [--modules n,n,...] [--native <relay library>] [--outprocess <relay library> <host>] [--module <module json>] [--csv <file>]\n", program);
+}
+
+static bool parse_options(int argc, char** argv, BENCH_OPTIONS* options)
+{
+    bool result = true;
+    for (int i = 1; i < argc && result; i++)
+    {
+        if (strcmp(argv[i], "--modules") == 0 && i + 1 < argc)
+        {
+            char* next = argv[++i];
+            while (*next != '\0' && result)
+            {
+                char* end;
+                unsigned long count = strtoul(next, &end, 10);
+                result = (end != next && count > 0 && (*end == ',' || *end == '\0'));
+                options->module_counts.push_back((size_t)count);
+                next = (*end == ',') ? end + 1 : end;
+            }
+        }
+        else if (strcmp(argv[i], "--native") == 0 && i + 1 < argc)
+        {
+            options->kind = RELAY_NATIVE;
+            options->relay_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--outprocess") == 0 && i + 2 < argc)
+        {
+            options->kind = RELAY_OUTPROCESS;
+            options->relay_path = argv[++i];
+            options->host_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--module") == 0 && i + 1 < argc)
+        {
+            options->kind = RELAY_CUSTOM;
+            options->custom_module = json_parse_file(argv[++i]);
+            result = (json_value_get_object(options->custom_module) != NULL &&
+                json_object_get_object(json_value_get_object(options->custom_module), "loader") != NULL);
+        }
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+        {
+            options->csv_path = argv[++i];
+        }
+        else
+        {
+            result = false;
+        }
+    }
+    if (options->module_counts.empty())
+    {
+        options->module_counts.assign(default_module_counts, default_module_counts + sizeof(default_module_counts) / sizeof(default_module_counts[0]));
+    }
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    BENCH_OPTIONS options = { RELAY_STATIC, NULL, NULL, NULL, NULL, std::vector<size_t>() };
+    if (!parse_options(argc, argv, &options))
+    {
+        print_usage(argv[0]);
+        json_value_free(options.custom_module);
+        return 1;
+    }
+
+    int result = 0;
+    FILE* csv = NULL;
+    if (StaticLoader_SetRegistry(bench_modules, sizeof(bench_modules) / sizeof(bench_modules[0])) != 0)
+    {
+        printf("unable to register the benchmark modules\n");
+        result = 1;
+    }
+    else if (options.csv_path != NULL && (csv = fopen(options.csv_path, "a")) == NULL)
+    {
+        printf("unable to open %s\n", options.csv_path);
+        result = 1;
+    }
+    else
+    {
+        if (csv != NULL && fseek(csv, 0, SEEK_END) == 0 && ftell(csv) == 0)
+        {
+            fprintf(csv, "relays");
+            for (size_t i = 0; i < PHASE_COUNT; i++)
+            {
+                fprintf(csv, ",%s_ms", phase_names[i]);
+            }
+            fprintf(csv, ",create_from_json_ms,create_from_json_delivery_ms\n");
+        }
+
+        for (size_t i = 0; i < options.module_counts.size() && result == 0; i++)
+        {
+            STARTUP_TIMES times;
+            memset(&times, 0, sizeof(times));
+            if (!write_config(&options, options.module_counts[i]))
+            {
+                printf("unable to write %s\n", STARTUP_BENCH_CONFIG);
+                result = 1;
+            }
+            else if (!run_phases(&times) || !run_gateway(&times))
+            {
+                printf("unable to start %zu relays\n", options.module_counts[i]);
+                result = 1;
+            }
+            else
+            {
+                print_times(options.module_counts[i], &times);
+                if (csv != NULL)
+                {
+                    append_csv(csv, options.module_counts[i], &times);
+                }
+            }
+        }
+
+        (void)remove(STARTUP_BENCH_CONFIG);
+        if (csv != NULL)
+        {
+            (void)fclose(csv);
+        }
+    }
+
+    json_value_free(options.custom_module);
+    return result;
+}
@@ -0,0 +1,680 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+static bool malloc_will_fail = false;
+static size_t malloc_fail_count = 0;
+static size_t malloc_count = 0;
+
+void* my_gballoc_malloc(size_t size)
+{
+    ++malloc_count;
+
+    void* result;
+    if (malloc_will_fail == true && malloc_count == malloc_fail_count)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = malloc(size);
+    }
+
+    return result;
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+
+#include "real_strings.h"
+
+#define ENABLE_MOCKS
+
+#define GATEWAY_EXPORT_H
+#define GATEWAY_EXPORT
+
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/gballoc.h"
+
+#include "parson.h"
+#include "module_loader.h"
+
+#undef ENABLE_MOCKS
+
+#include "module_loaders/static_loader.h"
+
+static pfModuleLoader_Load StaticModuleLoader_Load = NULL;
+static pfModuleLoader_Unload StaticModuleLoader_Unload = NULL;
+static pfModuleLoader_GetApi StaticModuleLoader_GetModuleApi = NULL;
+static pfModuleLoader_ParseEntrypointFromJson StaticModuleLoader_ParseEntrypointFromJson = NULL;
+static pfModuleLoader_FreeEntrypoint StaticModuleLoader_FreeEntrypoint = NULL;
+static pfModuleLoader_ParseConfigurationFromJson StaticModuleLoader_ParseConfigurationFromJson = NULL;
+static pfModuleLoader_FreeConfiguration StaticModuleLoader_FreeConfiguration = NULL;
+static pfModuleLoader_BuildModuleConfiguration StaticModuleLoader_BuildModuleConfiguration = NULL;
+static pfModuleLoader_FreeModuleConfiguration StaticModuleLoader_FreeModuleConfiguration = NULL;
+
+MOCKABLE_FUNCTION(, JSON_Value*, json_parse_string, const char*, string);
+MOCKABLE_FUNCTION(, JSON_Object*, json_value_get_object, const JSON_Value*, value);
+MOCKABLE_FUNCTION(, void, json_free_serialized_string, char*, string);
+MOCKABLE_FUNCTION(, void, json_value_free, JSON_Value*, value);
+MOCKABLE_FUNCTION(, const char*, json_object_get_string, const JSON_Object*, object, const char*, name);
+MOCKABLE_FUNCTION(, char*, json_serialize_to_string, const JSON_Value*, value);
+MOCKABLE_FUNCTION(, JSON_Object*, json_object_get_object, const JSON_Object*, object, const char*, name);
+MOCKABLE_FUNCTION(, double, json_object_get_number, const JSON_Object*, object, const char*, name);
+MOCKABLE_FUNCTION(, int, json_object_get_boolean, const JSON_Object*, object, const char*, name);
+MOCKABLE_FUNCTION(, JSON_Array*, json_object_get_array, const JSON_Object*, object, const char*, name);
+MOCKABLE_FUNCTION(, JSON_Value*, json_object_get_value, const JSON_Object*, object, const char*, name);
+MOCKABLE_FUNCTION(, size_t, json_array_get_count, const JSON_Array*, arr);
+MOCKABLE_FUNCTION(, const char*, json_array_get_string, const JSON_Array*, arr, size_t, index);
+MOCKABLE_FUNCTION(, JSON_Array*, json_value_get_array, const JSON_Value *, value);
+MOCKABLE_FUNCTION(, JSON_Value*, json_array_get_value, const JSON_Array*, arr, size_t, index);
+MOCKABLE_FUNCTION(, JSON_Value_Type, json_value_get_type, const JSON_Value*, value);
+
+//=============================================================================
+//Globals
+//=============================================================================
+
+#ifdef WIN32
+static TEST_MUTEX_HANDLE g_dllByDll;
+#endif
+static TEST_MUTEX_HANDLE g_testByTest;
+
+void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+MOCK_FUNCTION_WITH_CODE(, const MODULE_API*, Fake_GetAPI, MODULE_API_VERSION, gateway_api_version)
+const MODULE_API* val = (const MODULE_API*)0x42;
+MOCK_FUNCTION_END(val)
+
+//parson mocks
+MOCK_FUNCTION_WITH_CODE(, JSON_Object*, json_value_get_object, const JSON_Value*, value)
+    JSON_Object* obj = NULL;
+    if (value != NULL)
+    {
+        obj = (JSON_Object*)0x42;
+    }
+MOCK_FUNCTION_END(obj)
+
+MOCK_FUNCTION_WITH_CODE(, const char*, json_object_get_string, const JSON_Object*, object, const char*, name)
+    const char* str = NULL;
+    if (object != NULL && name != NULL)
+    {
+        str = "hello_world";
+    }
+MOCK_FUNCTION_END(str)
+
+MOCK_FUNCTION_WITH_CODE(, JSON_Value*, json_object_get_value, const JSON_Object*, object, const char*, name)
+    JSON_Value* value = NULL;
+    if (object != NULL && name != NULL)
+    {
+        value = (JSON_Value*)0x42;
+    }
+MOCK_FUNCTION_END(value)
+
+MOCK_FUNCTION_WITH_CODE(, size_t, json_array_get_count, const JSON_Array*, arr)
+    size_t num = -1;
+    if (arr != NULL)
+    {
+        num = 1;
+    }
+MOCK_FUNCTION_END(num)
+
+MOCK_FUNCTION_WITH_CODE(, JSON_Array*, json_value_get_array, const JSON_Value *, value)
+    JSON_Array* arr = NULL;
+    if (value != NULL)
+    {
+        arr = (JSON_Array*)value;
+    }
+MOCK_FUNCTION_END(arr)
+
+MOCK_FUNCTION_WITH_CODE(, JSON_Value*, json_array_get_value, const JSON_Array*, arr, size_t, index)
+    JSON_Value* val = NULL;
+    if (arr != NULL && index != 0)
+    {
+        val = (JSON_Value*)0x42;
+    }
+MOCK_FUNCTION_END(val)
+
+MOCK_FUNCTION_WITH_CODE(, JSON_Value_Type, json_value_get_type, const JSON_Value*, value)
+    JSON_Value_Type val = JSONError;
+    if (value != NULL)
+    {
+        val = JSONString;
+    }
+MOCK_FUNCTION_END(val)
+
+#undef ENABLE_MOCKS
+
+TEST_DEFINE_ENUM_TYPE(MODULE_LOADER_TYPE, MODULE_LOADER_TYPE_VALUES);
+
+BEGIN_TEST_SUITE(StaticLoader_UnitTests)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_stdint_register_types();
+
+    REGISTER_UMOCK_ALIAS_TYPE(MODULE_LOADER_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MODULE_LOADER_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MODULE_LIBRARY_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(JSON_Value_Type, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MODULE_API_VERSION, int);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_get_object, NULL);
+
+    // malloc/free hooks
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    // Strings hooks
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, real_STRING_construct);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_clone, real_STRING_clone);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, real_STRING_delete);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_c_str, real_STRING_c_str);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_clone, NULL);
+
+    const MODULE_LOADER* loader = StaticLoader_Get();
+    StaticModuleLoader_Load = loader->api->Load;
+    StaticModuleLoader_Unload = loader->api->Unload;
+    StaticModuleLoader_GetModuleApi = loader->api->GetApi;
+    StaticModuleLoader_ParseEntrypointFromJson = loader->api->ParseEntrypointFromJson;
+    StaticModuleLoader_FreeEntrypoint = loader->api->FreeEntrypoint;
+    StaticModuleLoader_ParseConfigurationFromJson = loader->api->ParseConfigurationFromJson;
+    StaticModuleLoader_FreeConfiguration = loader->api->FreeConfiguration;
+    StaticModuleLoader_BuildModuleConfiguration = loader->api->BuildModuleConfiguration;
+    StaticModuleLoader_FreeModuleConfiguration = loader->api->FreeModuleConfiguration;
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    malloc_will_fail = false;
+    malloc_fail_count = 0;
+    malloc_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    (void)StaticLoader_SetRegistry(NULL, 0);
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+static MODULE_API_1 g_valid_api =
+{
+    {
+        MODULE_API_VERSION_1
+    },
+    NULL,
+    NULL,
+    (pfModule_Create)0x42,
+    (pfModule_Destroy)0x42,
+    (pfModule_Receive)0x42,
+    NULL
+};
+
+static const STATIC_LOADER_MODULE g_registry[] =
+{
+    { "other", NULL },
+    { "boo", Fake_GetAPI }
+};
+
+static MODULE_LOADER g_static_loader =
+{
+    STATIC,
+    NULL, NULL, NULL
+};
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_001: [ StaticLoader_SetRegistry shall fail and return a non-zero value if modules is NULL and count is not 0. ]
+TEST_FUNCTION(StaticLoader_SetRegistry_fails_when_modules_is_NULL_and_count_is_not_0)
+{
+    // act
+    int result = StaticLoader_SetRegistry(NULL, 1);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_002: [ StaticLoader_SetRegistry shall replace the registry with modules and return 0. ]
+TEST_FUNCTION(StaticLoader_SetRegistry_succeeds)
+{
+    // act
+    int result1 = StaticLoader_SetRegistry(g_registry, sizeof(g_registry) / sizeof(g_registry[0]));
+    int result2 = StaticLoader_SetRegistry(NULL, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_003: [ StaticModuleLoader_Load shall return NULL if loader is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_loader_is_NULL)
+{
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(NULL, (void*)0x42);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_004: [ StaticModuleLoader_Load shall return NULL if entrypoint is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_entrypoint_is_NULL)
+{
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_005: [ StaticModuleLoader_Load shall return NULL if loader->type is not STATIC. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_loader_type_is_not_STATIC)
+{
+    // arrange
+    MODULE_LOADER loader =
+    {
+        NATIVE,
+        NULL, NULL, NULL
+    };
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&loader, (void*)0x42);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_006: [ StaticModuleLoader_Load shall return NULL if entrypoint->moduleName is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_moduleName_is_NULL)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { NULL };
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_007: [ StaticModuleLoader_Load shall look up entrypoint->moduleName in the registry set by StaticLoader_SetRegistry. ]
+//Tests_SRS_STATIC_MODULE_LOADER_26_008: [ StaticModuleLoader_Load shall return NULL if the module is not in the registry. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_module_is_not_registered)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("missing") };
+    ASSERT_ARE_EQUAL(int, 0, StaticLoader_SetRegistry(g_registry, sizeof(g_registry) / sizeof(g_registry[0])));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleName));
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_008: [ StaticModuleLoader_Load shall return NULL if the module is not in the registry. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_registry_entry_has_no_GetApi)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("other") };
+    ASSERT_ARE_EQUAL(int, 0, StaticLoader_SetRegistry(g_registry, sizeof(g_registry) / sizeof(g_registry[0])));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleName));
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_009: [ StaticModuleLoader_Load shall return NULL if an underlying platform call fails. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_malloc_fails)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("boo") };
+    ASSERT_ARE_EQUAL(int, 0, StaticLoader_SetRegistry(g_registry, sizeof(g_registry) / sizeof(g_registry[0])));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleName));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(NULL);
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_010: [ StaticModuleLoader_Load shall call the module's MODULE_STATIC_GETAPI function to acquire the module API table. ]
+//Tests_SRS_STATIC_MODULE_LOADER_26_011: [ StaticModuleLoader_Load shall return NULL if the MODULE_API pointer returned by the module is NULL, its version is greater than Module_ApiGatewayVersion, or Module_Create, Module_Destroy or Module_Receive is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_GetAPI_returns_invalid_api)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("boo") };
+    MODULE_API_1 api_inputs[] =
+    {
+        { { (MODULE_API_VERSION)(Module_ApiGatewayVersion + 1) }, NULL, NULL, (pfModule_Create)0x42, (pfModule_Destroy)0x42, (pfModule_Receive)0x42, NULL },
+        { { MODULE_API_VERSION_1 }, NULL, NULL, NULL, (pfModule_Destroy)0x42, (pfModule_Receive)0x42, NULL },
+        { { MODULE_API_VERSION_1 }, NULL, NULL, (pfModule_Create)0x42, NULL, (pfModule_Receive)0x42, NULL },
+        { { MODULE_API_VERSION_1 }, NULL, NULL, (pfModule_Create)0x42, (pfModule_Destroy)0x42, NULL, NULL }
+    };
+    ASSERT_ARE_EQUAL(int, 0, StaticLoader_SetRegistry(g_registry, sizeof(g_registry) / sizeof(g_registry[0])));
+
+    for (size_t i = 0; i <= sizeof(api_inputs) / sizeof(api_inputs[0]); i++)
+    {
+        // arrange
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleName));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Fake_GetAPI((MODULE_API_VERSION)IGNORED_NUM_ARG))
+            .IgnoreArgument(1)
+            .SetReturn(i == 0 ? NULL : (const MODULE_API*)&api_inputs[i - 1]);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        // act
+        MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+        // assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    // cleanup
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_010: [ StaticModuleLoader_Load shall call the module's MODULE_STATIC_GETAPI function to acquire the module API table. ]
+//Tests_SRS_STATIC_MODULE_LOADER_26_012: [ StaticModuleLoader_Load shall return a non-NULL pointer of type MODULE_LIBRARY_HANDLE when successful. ]
+//Tests_SRS_STATIC_MODULE_LOADER_26_014: [ StaticModuleLoader_GetModuleApi shall return a valid pointer to MODULE_API on success. ]
+TEST_FUNCTION(StaticModuleLoader_Load_succeeds)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("boo") };
+    ASSERT_ARE_EQUAL(int, 0, StaticLoader_SetRegistry(g_registry, sizeof(g_registry) / sizeof(g_registry[0])));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleName));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Fake_GetAPI(Module_ApiGatewayVersion))
+        .SetReturn((const MODULE_API*)&g_valid_api);
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)&g_valid_api, (void*)StaticModuleLoader_GetModuleApi(&g_static_loader, result));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    StaticModuleLoader_Unload(&g_static_loader, result);
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_013: [ StaticModuleLoader_GetModuleApi shall return NULL if moduleLibraryHandle is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_GetModuleApi_returns_NULL_when_moduleLibraryHandle_is_NULL)
+{
+    // act
+    const MODULE_API* result = StaticModuleLoader_GetModuleApi(NULL, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_016: [ StaticModuleLoader_Unload shall do nothing if moduleLibraryHandle is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_Unload_does_nothing_when_moduleLibraryHandle_is_NULL)
+{
+    // act
+    StaticModuleLoader_Unload(NULL, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_015: [ StaticModuleLoader_Unload shall deallocate memory for the structure MODULE_LIBRARY_HANDLE. ]
+TEST_FUNCTION(StaticModuleLoader_Unload_frees_things)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("boo") };
+    ASSERT_ARE_EQUAL(int, 0, StaticLoader_SetRegistry(g_registry, sizeof(g_registry) / sizeof(g_registry[0])));
+    STRICT_EXPECTED_CALL(Fake_GetAPI((MODULE_API_VERSION)IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn((const MODULE_API*)&g_valid_api);
+    MODULE_LIBRARY_HANDLE module = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+    ASSERT_IS_NOT_NULL(module);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(module));
+
+    // act
+    StaticModuleLoader_Unload(&g_static_loader, module);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_017: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if json is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_ParseEntrypointFromJson_returns_NULL_when_json_is_NULL)
+{
+    // act
+    void* result = StaticModuleLoader_ParseEntrypointFromJson(NULL, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_018: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if the root json entity is not an object. ]
+TEST_FUNCTION(StaticModuleLoader_ParseEntrypointFromJson_returns_NULL_when_json_is_not_an_object)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(json_value_get_type((const JSON_Value*)0x42))
+        .SetReturn(JSONArray);
+
+    // act
+    void* result = StaticModuleLoader_ParseEntrypointFromJson(NULL, (const JSON_Value*)0x42);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_020: [ StaticModuleLoader_ParseEntrypointFromJson shall retrieve the name of the module by reading the value of the attribute module.name. ]
+//Tests_SRS_STATIC_MODULE_LOADER_26_021: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if module.name does not exist. ]
+TEST_FUNCTION(StaticModuleLoader_ParseEntrypointFromJson_returns_NULL_when_module_name_is_missing)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(json_value_get_type((const JSON_Value*)0x42))
+        .SetReturn(JSONObject);
+    STRICT_EXPECTED_CALL(json_value_get_object((const JSON_Value*)0x42))
+        .SetReturn((JSON_Object*)0x43);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x43, "module.name"))
+        .SetReturn(NULL);
+
+    // act
+    void* result = StaticModuleLoader_ParseEntrypointFromJson(NULL, (const JSON_Value*)0x42);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_019: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if an underlying platform call fails. ]
+TEST_FUNCTION(StaticModuleLoader_ParseEntrypointFromJson_returns_NULL_when_things_fail)
+{
+    // arrange
+    int result = 0;
+    result = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    STRICT_EXPECTED_CALL(json_value_get_type((const JSON_Value*)0x42))
+        .SetReturn(JSONObject);
+    STRICT_EXPECTED_CALL(json_value_get_object((const JSON_Value*)0x42))
+        .SetReturn((JSON_Object*)0x43)
+        .SetFailReturn(NULL);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x43, "module.name"))
+        .SetReturn("logger")
+        .SetFailReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(STATIC_LOADER_ENTRYPOINT)))
+        .SetFailReturn(NULL);
+    STRICT_EXPECTED_CALL(STRING_construct("logger"))
+        .SetFailReturn(NULL);
+
+    umock_c_negative_tests_snapshot();
+
+    // NOTE:
+    //  We start the negative testing from *1* instead of 0 because
+    //  json_value_get_type has no failure value.
+    for (size_t i = 1; i < umock_c_negative_tests_call_count(); i++)
+    {
+        // arrange
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        void* entrypoint = StaticModuleLoader_ParseEntrypointFromJson(NULL, (const JSON_Value*)0x42);
+
+        // assert
+        ASSERT_IS_NULL(entrypoint);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_022: [ StaticModuleLoader_ParseEntrypointFromJson shall return a non-NULL pointer to the parsed representation of the entrypoint when successful. ]
+//Tests_SRS_STATIC_MODULE_LOADER_26_023: [ StaticModuleLoader_FreeEntrypoint shall free resources allocated during StaticModuleLoader_ParseEntrypointFromJson. ]
+TEST_FUNCTION(StaticModuleLoader_ParseEntrypointFromJson_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(json_value_get_type((const JSON_Value*)0x42))
+        .SetReturn(JSONObject);
+    STRICT_EXPECTED_CALL(json_value_get_object((const JSON_Value*)0x42))
+        .SetReturn((JSON_Object*)0x43);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x43, "module.name"))
+        .SetReturn("logger");
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(STATIC_LOADER_ENTRYPOINT)));
+    STRICT_EXPECTED_CALL(STRING_construct("logger"));
+
+    // act
+    STATIC_LOADER_ENTRYPOINT* result = (STATIC_LOADER_ENTRYPOINT*)StaticModuleLoader_ParseEntrypointFromJson(NULL, (const JSON_Value*)0x42);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, "logger", STRING_c_str(result->moduleName));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    StaticModuleLoader_FreeEntrypoint(NULL, result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_024: [ StaticModuleLoader_FreeEntrypoint shall do nothing if entrypoint is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_FreeEntrypoint_does_nothing_when_entrypoint_is_NULL)
+{
+    // act
+    StaticModuleLoader_FreeEntrypoint(NULL, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_025: [ StaticModuleLoader_ParseConfigurationFromJson shall return NULL. ]
+//Tests_SRS_STATIC_MODULE_LOADER_26_026: [ StaticModuleLoader_FreeConfiguration shall do nothing. ]
+TEST_FUNCTION(StaticModuleLoader_configuration_is_not_used)
+{
+    // act
+    MODULE_LOADER_BASE_CONFIGURATION* result = StaticModuleLoader_ParseConfigurationFromJson(NULL, (const JSON_Value*)0x42);
+    StaticModuleLoader_FreeConfiguration(NULL, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_027: [ StaticModuleLoader_BuildModuleConfiguration shall return module_configuration. ]
+//Tests_SRS_STATIC_MODULE_LOADER_26_028: [ StaticModuleLoader_FreeModuleConfiguration shall do nothing. ]
+TEST_FUNCTION(StaticModuleLoader_BuildModuleConfiguration_returns_module_configuration)
+{
+    // act
+    void* result = StaticModuleLoader_BuildModuleConfiguration(NULL, NULL, (void*)0x42);
+    StaticModuleLoader_FreeModuleConfiguration(NULL, result);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, result, (void*)0x42);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_26_029: [ StaticLoader_Get shall return a non-NULL pointer to a MODULE_LOADER struct. ]
+//Tests_SRS_STATIC_MODULE_LOADER_26_030: [ MODULE_LOADER::type shall be STATIC. ]
+//Tests_SRS_STATIC_MODULE_LOADER_26_031: [ MODULE_LOADER::name shall be the string static. ]
+TEST_FUNCTION(StaticLoader_Get_succeeds)
+{
+    // act
+    const MODULE_LOADER* loader = StaticLoader_Get();
+
+    // assert
+    ASSERT_IS_NOT_NULL(loader);
+    ASSERT_ARE_EQUAL(MODULE_LOADER_TYPE, loader->type, STATIC);
+    ASSERT_IS_TRUE(strcmp(loader->name, "static") == 0);
+}
+
+END_TEST_SUITE(StaticLoader_UnitTests);
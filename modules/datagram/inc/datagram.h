@@ -0,0 +1,53 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef DATAGRAM_H
+#define DATAGRAM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "module.h"
+
+typedef enum DATAGRAM_TRANSPORT_TAG
+{
+    DATAGRAM_UDP,
+    DATAGRAM_UNIX
+} DATAGRAM_TRANSPORT;
+
+/*maps a sender to the properties the module adds to its datagrams*/
+typedef struct DATAGRAM_SOURCE_TAG
+{
+    const char* address; /*"ip" or "ip:port" for UDP, the sender's bound socket path for Unix*/
+    const char* deviceName;
+    const char* macAddress;
+} DATAGRAM_SOURCE;
+
+typedef struct DATAGRAM_CONFIG_TAG
+{
+    DATAGRAM_TRANSPORT transport;
+    const char* address; /*IPv4 address to bind for UDP, the socket path for Unix*/
+    unsigned short port;
+    size_t batchSize;
+    size_t maxDatagramSize;
+    size_t threads;
+    bool dropUnknown;
+    size_t sourceCount;
+    DATAGRAM_SOURCE* sources;
+} DATAGRAM_CONFIG; /*this needs to be passed to the Module_Create function*/
+
+#define DATAGRAM_DEFAULT_BATCH_SIZE 64
+#define DATAGRAM_DEFAULT_MAX_DATAGRAM_SIZE 2048
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(DATAGRAM_MODULE)(MODULE_API_VERSION gateway_api_version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*DATAGRAM_H*/
@@ -0,0 +1,1075 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /*recvmmsg*/
+#endif
+#define DATAGRAM_HAVE_RECVMMSG
+#endif
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "messageproperties.h"
+#include "message.h"
+#include "broker.h"
+#include "datagram.h"
+
+#include <parson.h>
+
+/*how long a receive thread blocks before it checks whether the module is being destroyed*/
+#define DATAGRAM_STOP_POLL_MS 100
+
+#define DATAGRAM_MAX_DATAGRAM_SIZE 65535
+
+typedef struct DATAGRAM_ROUTE_TAG
+{
+    uint32_t ip;
+    uint16_t port; /*0 matches any port*/
+    char* path;
+    MAP_HANDLE properties;
+} DATAGRAM_ROUTE;
+
+struct DATAGRAM_MODULE_DATA_TAG;
+
+typedef struct DATAGRAM_RECEIVER_TAG
+{
+    struct DATAGRAM_MODULE_DATA_TAG* module;
+    int fd;
+    bool owns_fd;
+    bool started;
+    THREAD_HANDLE thread;
+    unsigned char* buffers;
+    struct sockaddr_storage* addresses;
+    socklen_t* address_lengths;
+    size_t* lengths;
+    bool* truncated;
+#ifdef DATAGRAM_HAVE_RECVMMSG
+    struct mmsghdr* headers;
+    struct iovec* iovecs;
+#endif
+    MESSAGE_HANDLE* messages;
+} DATAGRAM_RECEIVER;
+
+typedef struct DATAGRAM_MODULE_DATA_TAG
+{
+    BROKER_HANDLE broker;
+    DATAGRAM_TRANSPORT transport;
+    char* address;
+    size_t batch_size;
+    size_t max_datagram_size;
+    bool drop_unknown;
+    MAP_HANDLE unknown_properties;
+    size_t route_count;
+    DATAGRAM_ROUTE* routes;
+    size_t receiver_count;
+    DATAGRAM_RECEIVER* receivers;
+    volatile bool stop;
+} DATAGRAM_MODULE_DATA;
+
+/*
+ * Configuration
+ */
+
+static void free_sources(DATAGRAM_SOURCE* sources, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        free((void*)sources[i].address);
+        free((void*)sources[i].deviceName);
+        free((void*)sources[i].macAddress);
+    }
+    free(sources);
+}
+
+static int copy_optional_string(const char** destination, const char* source)
+{
+    int result;
+    char* copy = NULL;
+    if (source != NULL && mallocAndStrcpy_s(&copy, source) != 0)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        *destination = copy;
+        result = 0;
+    }
+    return result;
+}
+
+/*reads an optional whole number between minimum and maximum, or leaves *value as it is*/
+static bool get_optional_count(JSON_Object* root, const char* name, size_t minimum, size_t maximum, size_t* value)
+{
+    bool result;
+    JSON_Value* json_value = json_object_get_value(root, name);
+    if (json_value == NULL)
+    {
+        result = true;
+    }
+    else if (json_value_get_type(json_value) != JSONNumber)
+    {
+        LogError("\"%s\" is not a number", name);
+        result = false;
+    }
+    else
+    {
+        double number = json_value_get_number(json_value);
+        if (number < (double)minimum || number > (double)maximum || number != (double)(size_t)number)
+        {
+            LogError("\"%s\" must be a whole number from %zu to %zu", name, minimum, maximum);
+            result = false;
+        }
+        else
+        {
+            *value = (size_t)number;
+            result = true;
+        }
+    }
+    return result;
+}
+
+static bool parse_sources(JSON_Object* root, DATAGRAM_CONFIG* config)
+{
+    bool result;
+    JSON_Value* json_value = json_object_get_value(root, "sources");
+    if (json_value == NULL)
+    {
+        result = true;
+    }
+    else
+    {
+        JSON_Array* array = json_value_get_array(json_value);
+        if (array == NULL)
+        {
+            /*Codes_SRS_DATAGRAM_26_007: [ DatagramModule_ParseConfigurationFromJson shall return NULL if "sources" is present and is not an array of objects that each have an "address" string and optional "deviceName" and "macAddress" strings. ]*/
+            LogError("\"sources\" is not an array");
+            result = false;
+        }
+        else
+        {
+            size_t count = json_array_get_count(array);
+            config->sources = (count == 0) ? NULL : (DATAGRAM_SOURCE*)malloc(count * sizeof(DATAGRAM_SOURCE));
+            if (count > 0 && config->sources == NULL)
+            {
+                LogError("unable to allocate %zu sources", count);
+                result = false;
+            }
+            else
+            {
+                size_t i;
+                result = true;
+                for (i = 0; i < count; i++)
+                {
+                    JSON_Object* source = json_array_get_object(array, i);
+                    const char* address = (source == NULL) ? NULL : json_object_get_string(source, "address");
+                    if (address == NULL)
+                    {
+                        /*Codes_SRS_DATAGRAM_26_007: [ DatagramModule_ParseConfigurationFromJson shall return NULL if "sources" is present and is not an array of objects that each have an "address" string and optional "deviceName" and "macAddress" strings. ]*/
+                        LogError("source %zu has no \"address\"", i);
+                        result = false;
+                    }
+                    else
+                    {
+                        DATAGRAM_SOURCE* entry = &config->sources[i];
+                        entry->address = NULL;
+                        entry->deviceName = NULL;
+                        entry->macAddress = NULL;
+                        if (copy_optional_string(&entry->address, address) != 0 ||
+                            copy_optional_string(&entry->deviceName, json_object_get_string(source, GW_DEVICENAME_PROPERTY)) != 0 ||
+                            copy_optional_string(&entry->macAddress, json_object_get_string(source, GW_MAC_ADDRESS_PROPERTY)) != 0)
+                        {
+                            LogError("unable to copy source %zu", i);
+                            free((void*)entry->address);
+                            free((void*)entry->deviceName);
+                            result = false;
+                        }
+                    }
+
+                    if (!result)
+                    {
+                        free_sources(config->sources, i);
+                        config->sources = NULL;
+                        break;
+                    }
+                }
+                config->sourceCount = result ? count : 0;
+            }
+        }
+    }
+    return result;
+}
+
+static void* DatagramModule_ParseConfigurationFromJson(const char* configuration)
+{
+    DATAGRAM_CONFIG* result;
+    JSON_Value* json = (configuration == NULL) ? NULL : json_parse_string(configuration);
+    JSON_Object* root = (json == NULL) ? NULL : json_value_get_object(json);
+    if (root == NULL)
+    {
+        /*Codes_SRS_DATAGRAM_26_002: [ DatagramModule_ParseConfigurationFromJson shall return NULL if configuration is NULL or is not a JSON object. ]*/
+        LogError("invalid module args.");
+        result = NULL;
+    }
+    else
+    {
+        DATAGRAM_CONFIG config;
+        const char* transport = json_object_get_string(root, "transport");
+        const char* address;
+        size_t port = 0;
+        int drop_unknown;
+
+        memset(&config, 0, sizeof(config));
+        config.batchSize = DATAGRAM_DEFAULT_BATCH_SIZE;
+        config.maxDatagramSize = DATAGRAM_DEFAULT_MAX_DATAGRAM_SIZE;
+        config.threads = 1;
+
+        /*Codes_SRS_DATAGRAM_26_003: [ DatagramModule_ParseConfigurationFromJson shall read "transport" as "udp", the default, or "unix", and return NULL for any other value. ]*/
+        if (transport == NULL || strcmp(transport, "udp") == 0)
+        {
+            config.transport = DATAGRAM_UDP;
+            /*Codes_SRS_DATAGRAM_26_004: [ For "udp", DatagramModule_ParseConfigurationFromJson shall read the "address" to bind, "0.0.0.0" by default, and the "port", a whole number from 0 to 65535, and return NULL if "port" is missing or invalid. ]*/
+            address = json_object_get_string(root, "address");
+            if (address == NULL)
+            {
+                address = "0.0.0.0";
+            }
+        }
+        else if (strcmp(transport, "unix") == 0)
+        {
+            config.transport = DATAGRAM_UNIX;
+            /*Codes_SRS_DATAGRAM_26_018: [ For "unix", DatagramModule_ParseConfigurationFromJson shall read the socket "path", and return NULL if it is missing. ]*/
+            address = json_object_get_string(root, "path");
+        }
+        else
+        {
+            LogError("unknown transport \"%s\"", transport);
+            address = NULL;
+        }
+
+        drop_unknown = json_object_get_boolean(root, "dropUnknown");
+
+        if (address == NULL)
+        {
+            LogError("the module needs a transport and an address or path");
+            result = NULL;
+        }
+        else if (config.transport == DATAGRAM_UDP &&
+            (json_object_get_value(root, "port") == NULL || !get_optional_count(root, "port", 0, 65535, &port)))
+        {
+            LogError("the udp transport needs a \"port\" from 0 to 65535");
+            result = NULL;
+        }
+        /*Codes_SRS_DATAGRAM_26_005: [ DatagramModule_ParseConfigurationFromJson shall read the optional "batchSize", "maxDatagramSize" and "threads" whole numbers, 64, 2048 and 1 by default, and return NULL if any is 0, or "maxDatagramSize" is above 65535. ]*/
+        else if (!get_optional_count(root, "batchSize", 1, 1024, &config.batchSize) ||
+            !get_optional_count(root, "maxDatagramSize", 1, DATAGRAM_MAX_DATAGRAM_SIZE, &config.maxDatagramSize) ||
+            !get_optional_count(root, "threads", 1, 64, &config.threads))
+        {
+            result = NULL;
+        }
+        else if (!parse_sources(root, &config))
+        {
+            result = NULL;
+        }
+        else if (mallocAndStrcpy_s((char**)&config.address, address) != 0)
+        {
+            LogError("unable to copy the address");
+            free_sources(config.sources, config.sourceCount);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_DATAGRAM_26_006: [ DatagramModule_ParseConfigurationFromJson shall read the optional "dropUnknown" boolean, false by default. ]*/
+            config.dropUnknown = (drop_unknown == 1);
+            config.port = (unsigned short)port;
+            result = (DATAGRAM_CONFIG*)malloc(sizeof(DATAGRAM_CONFIG));
+            if (result == NULL)
+            {
+                LogError("allocation of configuration failed");
+                free((void*)config.address);
+                free_sources(config.sources, config.sourceCount);
+            }
+            else
+            {
+                *result = config;
+            }
+        }
+    }
+    if (json != NULL)
+    {
+        json_value_free(json);
+    }
+    return result;
+}
+
+static void DatagramModule_FreeConfiguration(void* configuration)
+{
+    /*Codes_SRS_DATAGRAM_26_008: [ DatagramModule_FreeConfiguration shall free the configuration, and do nothing if it is NULL. ]*/
+    if (configuration != NULL)
+    {
+        DATAGRAM_CONFIG* config = (DATAGRAM_CONFIG*)configuration;
+        free((void*)config->address);
+        free_sources(config->sources, config->sourceCount);
+        free(config);
+    }
+}
+
+/*
+ * Routing table
+ */
+
+static int route_compare(const void* a, const void* b)
+{
+    const DATAGRAM_ROUTE* route_a = (const DATAGRAM_ROUTE*)a;
+    const DATAGRAM_ROUTE* route_b = (const DATAGRAM_ROUTE*)b;
+    int result;
+    if (route_a->path != NULL || route_b->path != NULL)
+    {
+        result = strcmp(route_a->path, route_b->path);
+    }
+    else if (route_a->ip != route_b->ip)
+    {
+        result = (route_a->ip < route_b->ip) ? -1 : 1;
+    }
+    else
+    {
+        result = (int)route_a->port - (int)route_b->port;
+    }
+    return result;
+}
+
+/*parses "ip" or "ip:port" into network order*/
+static int parse_udp_address(const char* address, uint32_t* ip, uint16_t* port)
+{
+    int result;
+    char host[INET_ADDRSTRLEN];
+    const char* colon = strchr(address, ':');
+    size_t host_length = (colon == NULL) ? strlen(address) : (size_t)(colon - address);
+    struct in_addr parsed;
+    if (host_length >= sizeof(host))
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        memcpy(host, address, host_length);
+        host[host_length] = '\0';
+        if (inet_pton(AF_INET, host, &parsed) != 1)
+        {
+            result = __LINE__;
+        }
+        else if (colon == NULL)
+        {
+            *ip = parsed.s_addr;
+            *port = 0;
+            result = 0;
+        }
+        else
+        {
+            char* end;
+            unsigned long number = strtoul(colon + 1, &end, 10);
+            if (*(colon + 1) == '\0' || *end != '\0' || number == 0 || number > 65535)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                *ip = parsed.s_addr;
+                *port = htons((uint16_t)number);
+                result = 0;
+            }
+        }
+    }
+    return result;
+}
+
+static MAP_HANDLE create_properties(const DATAGRAM_SOURCE* source)
+{
+    MAP_HANDLE result = Map_Create(NULL);
+    if (result == NULL)
+    {
+        LogError("unable to create the properties of a source");
+    }
+    else if ((source != NULL && source->deviceName != NULL && Map_AddOrUpdate(result, GW_DEVICENAME_PROPERTY, source->deviceName) != MAP_OK) ||
+        (source != NULL && source->macAddress != NULL && Map_AddOrUpdate(result, GW_MAC_ADDRESS_PROPERTY, source->macAddress) != MAP_OK))
+    {
+        LogError("unable to set the properties of source %s", source->address);
+        Map_Destroy(result);
+        result = NULL;
+    }
+    return result;
+}
+
+static void destroy_routes(DATAGRAM_MODULE_DATA* module)
+{
+    size_t i;
+    for (i = 0; i < module->route_count; i++)
+    {
+        free(module->routes[i].path);
+        Map_Destroy(module->routes[i].properties);
+    }
+    free(module->routes);
+    module->routes = NULL;
+    module->route_count = 0;
+}
+
+static int create_routes(DATAGRAM_MODULE_DATA* module, const DATAGRAM_CONFIG* config)
+{
+    int result;
+    module->route_count = 0;
+    module->routes = (config->sourceCount == 0) ? NULL : (DATAGRAM_ROUTE*)malloc(config->sourceCount * sizeof(DATAGRAM_ROUTE));
+    if (config->sourceCount > 0 && module->routes == NULL)
+    {
+        LogError("unable to allocate the routing table");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t i;
+        result = 0;
+        for (i = 0; i < config->sourceCount && result == 0; i++)
+        {
+            const DATAGRAM_SOURCE* source = &config->sources[i];
+            DATAGRAM_ROUTE* route = &module->routes[i];
+            route->ip = 0;
+            route->port = 0;
+            route->path = NULL;
+            if (source->address == NULL)
+            {
+                LogError("source %zu has no address", i);
+                result = __LINE__;
+            }
+            else if (config->transport == DATAGRAM_UDP && parse_udp_address(source->address, &route->ip, &route->port) != 0)
+            {
+                LogError("source address %s is not \"ip\" or \"ip:port\"", source->address);
+                result = __LINE__;
+            }
+            else if (config->transport == DATAGRAM_UNIX && mallocAndStrcpy_s(&route->path, source->address) != 0)
+            {
+                LogError("unable to copy source address %s", source->address);
+                result = __LINE__;
+            }
+            /*Codes_SRS_DATAGRAM_26_010: [ DatagramModule_Create shall build the properties of each source once, a deviceName and a macAddress property for those it has, and return NULL if a source address cannot be parsed. ]*/
+            else if ((route->properties = create_properties(source)) == NULL)
+            {
+                free(route->path);
+                result = __LINE__;
+            }
+            else
+            {
+                module->route_count++;
+            }
+        }
+
+        if (result != 0)
+        {
+            destroy_routes(module);
+        }
+        else if (module->route_count > 1)
+        {
+            qsort(module->routes, module->route_count, sizeof(DATAGRAM_ROUTE), route_compare);
+        }
+    }
+    return result;
+}
+
+/*returns the properties for a sender, or NULL to drop its datagram*/
+static MAP_HANDLE find_properties(const DATAGRAM_MODULE_DATA* module, const struct sockaddr_storage* address, socklen_t address_length)
+{
+    const DATAGRAM_ROUTE* found = NULL;
+    DATAGRAM_ROUTE key;
+    char path[sizeof(((struct sockaddr_un*)0)->sun_path) + 1];
+    key.ip = 0;
+    key.port = 0;
+    key.path = NULL;
+
+    if (module->route_count == 0)
+    {
+        /*nothing to look up*/
+    }
+    else if (module->transport == DATAGRAM_UDP)
+    {
+        if (address->ss_family == AF_INET && address_length >= (socklen_t)sizeof(struct sockaddr_in))
+        {
+            const struct sockaddr_in* sender = (const struct sockaddr_in*)address;
+            key.ip = sender->sin_addr.s_addr;
+            key.port = sender->sin_port;
+            found = (const DATAGRAM_ROUTE*)bsearch(&key, module->routes, module->route_count, sizeof(DATAGRAM_ROUTE), route_compare);
+            if (found == NULL)
+            {
+                key.port = 0;
+                found = (const DATAGRAM_ROUTE*)bsearch(&key, module->routes, module->route_count, sizeof(DATAGRAM_ROUTE), route_compare);
+            }
+        }
+    }
+    else
+    {
+        /*unbound and abstract senders have no path to match*/
+        size_t path_length = (address_length > (socklen_t)offsetof(struct sockaddr_un, sun_path)) ?
+            (size_t)address_length - offsetof(struct sockaddr_un, sun_path) : 0;
+        const struct sockaddr_un* sender = (const struct sockaddr_un*)address;
+        if (path_length > 0 && path_length < sizeof(path) && sender->sun_path[0] != '\0')
+        {
+            memcpy(path, sender->sun_path, path_length);
+            path[path_length] = '\0';
+            key.path = path;
+            found = (const DATAGRAM_ROUTE*)bsearch(&key, module->routes, module->route_count, sizeof(DATAGRAM_ROUTE), route_compare);
+        }
+    }
+
+    return (found != NULL) ? found->properties : (module->drop_unknown ? NULL : module->unknown_properties);
+}
+
+/*
+ * Sockets
+ */
+
+static int open_socket(const DATAGRAM_MODULE_DATA* module, const DATAGRAM_CONFIG* config, bool reuse_port, unsigned short* port)
+{
+    int result;
+    int fd = socket((config->transport == DATAGRAM_UDP) ? AF_INET : AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        LogError("unable to create a socket, errno %d", errno);
+        result = -1;
+    }
+    else
+    {
+        struct timeval timeout;
+#ifdef SO_REUSEPORT
+        int enable = 1;
+#endif
+        int status;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = DATAGRAM_STOP_POLL_MS * 1000;
+
+        if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0)
+        {
+            LogError("unable to set the receive timeout, errno %d", errno);
+            status = __LINE__;
+        }
+#ifdef SO_REUSEPORT
+        else if (reuse_port && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) != 0)
+        {
+            LogError("unable to set SO_REUSEPORT, errno %d", errno);
+            status = __LINE__;
+        }
+#endif
+        else if (config->transport == DATAGRAM_UDP)
+        {
+            struct sockaddr_in address;
+            socklen_t address_length = sizeof(address);
+            memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_port = htons(*port);
+            if (inet_pton(AF_INET, config->address, &address.sin_addr) != 1)
+            {
+                LogError("%s is not an IPv4 address", config->address);
+                status = __LINE__;
+            }
+            else if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0)
+            {
+                LogError("unable to bind %s:%hu, errno %d", config->address, *port, errno);
+                status = __LINE__;
+            }
+            /*the next sockets bind to the port picked for this one*/
+            else if (getsockname(fd, (struct sockaddr*)&address, &address_length) != 0)
+            {
+                LogError("unable to read the bound port, errno %d", errno);
+                status = __LINE__;
+            }
+            else
+            {
+                *port = ntohs(address.sin_port);
+                status = 0;
+            }
+        }
+        else
+        {
+            struct sockaddr_un address;
+            memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            if (strlen(module->address) >= sizeof(address.sun_path))
+            {
+                LogError("socket path %s is too long", module->address);
+                status = __LINE__;
+            }
+            else
+            {
+                struct stat path_status;
+                bool path_exists = (lstat(module->address, &path_status) == 0);
+                strcpy(address.sun_path, module->address);
+                if (path_exists && !S_ISSOCK(path_status.st_mode))
+                {
+                    /*Codes_SRS_DATAGRAM_26_019: [ DatagramModule_Create shall return NULL, and leave the path alone, if the path of a Unix socket module exists and is not a socket. ]*/
+                    LogError("%s exists and is not a socket", module->address);
+                    status = __LINE__;
+                }
+                else if (path_exists && unlink(module->address) != 0)
+                {
+                    /*a socket left behind by an earlier run would make bind fail*/
+                    LogError("unable to remove the socket %s left behind, errno %d", module->address, errno);
+                    status = __LINE__;
+                }
+                else if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0)
+                {
+                    LogError("unable to bind %s, errno %d", module->address, errno);
+                    status = __LINE__;
+                }
+                else
+                {
+                    status = 0;
+                }
+            }
+        }
+
+        if (status != 0)
+        {
+            (void)close(fd);
+            result = -1;
+        }
+        else
+        {
+            result = fd;
+        }
+    }
+    return result;
+}
+
+static void free_receiver_buffers(DATAGRAM_RECEIVER* receiver)
+{
+    free(receiver->buffers);
+    free(receiver->addresses);
+    free(receiver->address_lengths);
+    free(receiver->lengths);
+    free(receiver->truncated);
+#ifdef DATAGRAM_HAVE_RECVMMSG
+    free(receiver->headers);
+    free(receiver->iovecs);
+#endif
+    free(receiver->messages);
+}
+
+static int init_receiver(DATAGRAM_MODULE_DATA* module, DATAGRAM_RECEIVER* receiver)
+{
+    int result;
+    size_t batch_size = module->batch_size;
+    receiver->module = module;
+    receiver->fd = -1;
+    receiver->owns_fd = false;
+    receiver->started = false;
+    receiver->buffers = (unsigned char*)malloc(batch_size * module->max_datagram_size);
+    receiver->addresses = (struct sockaddr_storage*)malloc(batch_size * sizeof(struct sockaddr_storage));
+    receiver->address_lengths = (socklen_t*)malloc(batch_size * sizeof(socklen_t));
+    receiver->lengths = (size_t*)malloc(batch_size * sizeof(size_t));
+    receiver->truncated = (bool*)malloc(batch_size * sizeof(bool));
+    receiver->messages = (MESSAGE_HANDLE*)malloc(batch_size * sizeof(MESSAGE_HANDLE));
+#ifdef DATAGRAM_HAVE_RECVMMSG
+    receiver->headers = (struct mmsghdr*)malloc(batch_size * sizeof(struct mmsghdr));
+    receiver->iovecs = (struct iovec*)malloc(batch_size * sizeof(struct iovec));
+#endif
+    if (receiver->buffers == NULL || receiver->addresses == NULL || receiver->address_lengths == NULL ||
+        receiver->lengths == NULL || receiver->truncated == NULL || receiver->messages == NULL
+#ifdef DATAGRAM_HAVE_RECVMMSG
+        || receiver->headers == NULL || receiver->iovecs == NULL
+#endif
+        )
+    {
+        LogError("unable to allocate the receive buffers");
+        free_receiver_buffers(receiver);
+        result = __LINE__;
+    }
+    else
+    {
+#ifdef DATAGRAM_HAVE_RECVMMSG
+        /*each slot of the batch reads into its own part of buffers*/
+        size_t i;
+        memset(receiver->headers, 0, batch_size * sizeof(struct mmsghdr));
+        for (i = 0; i < batch_size; i++)
+        {
+            receiver->iovecs[i].iov_base = receiver->buffers + (i * module->max_datagram_size);
+            receiver->iovecs[i].iov_len = module->max_datagram_size;
+            receiver->headers[i].msg_hdr.msg_iov = &receiver->iovecs[i];
+            receiver->headers[i].msg_hdr.msg_iovlen = 1;
+            receiver->headers[i].msg_hdr.msg_name = &receiver->addresses[i];
+        }
+#endif
+        result = 0;
+    }
+    return result;
+}
+
+static void close_receivers(DATAGRAM_MODULE_DATA* module)
+{
+    size_t i;
+    for (i = 0; i < module->receiver_count; i++)
+    {
+        if (module->receivers[i].owns_fd)
+        {
+            (void)close(module->receivers[i].fd);
+        }
+        free_receiver_buffers(&module->receivers[i]);
+    }
+    free(module->receivers);
+    module->receivers = NULL;
+    module->receiver_count = 0;
+}
+
+static int open_receivers(DATAGRAM_MODULE_DATA* module, const DATAGRAM_CONFIG* config)
+{
+    int result;
+    module->receiver_count = 0;
+    module->receivers = (DATAGRAM_RECEIVER*)malloc(config->threads * sizeof(DATAGRAM_RECEIVER));
+    if (module->receivers == NULL)
+    {
+        LogError("unable to allocate %zu receivers", config->threads);
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_DATAGRAM_26_011: [ DatagramModule_Create shall bind one socket per thread with SO_REUSEPORT for a UDP module with more than 1 thread, and one socket the threads share otherwise, removing a Unix socket left behind at its path first, and return NULL if it cannot. ]*/
+        bool socket_per_thread = false;
+        unsigned short port = config->port;
+        size_t i;
+#ifdef SO_REUSEPORT
+        socket_per_thread = (config->transport == DATAGRAM_UDP && config->threads > 1);
+#endif
+        result = 0;
+        for (i = 0; i < config->threads && result == 0; i++)
+        {
+            DATAGRAM_RECEIVER* receiver = &module->receivers[i];
+            if (init_receiver(module, receiver) != 0)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                if (i == 0 || socket_per_thread)
+                {
+                    receiver->fd = open_socket(module, config, socket_per_thread, &port);
+                    receiver->owns_fd = true;
+                }
+                else
+                {
+                    receiver->fd = module->receivers[0].fd;
+                }
+
+                if (receiver->fd < 0)
+                {
+                    free_receiver_buffers(receiver);
+                    result = __LINE__;
+                }
+                else
+                {
+                    module->receiver_count++;
+                }
+            }
+        }
+
+        if (result != 0)
+        {
+            close_receivers(module);
+        }
+    }
+    return result;
+}
+
+/*
+ * Receive threads
+ */
+
+/*blocks until the first datagram arrives and takes whatever else is queued, up to the batch size*/
+static int receive_batch(DATAGRAM_RECEIVER* receiver)
+{
+    int result;
+    size_t batch_size = receiver->module->batch_size;
+    size_t i;
+#ifdef DATAGRAM_HAVE_RECVMMSG
+    /*Codes_SRS_DATAGRAM_26_013: [ Each receive thread shall read up to batchSize datagrams at a time with recvmmsg, or recvfrom where recvmmsg is not available, blocking only until the first one arrives. ]*/
+    for (i = 0; i < batch_size; i++)
+    {
+        receiver->headers[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+        receiver->headers[i].msg_hdr.msg_flags = 0;
+    }
+    result = recvmmsg(receiver->fd, receiver->headers, (unsigned int)batch_size, MSG_WAITFORONE, NULL);
+    for (i = 0; result > 0 && i < (size_t)result; i++)
+    {
+        receiver->lengths[i] = receiver->headers[i].msg_len;
+        receiver->address_lengths[i] = receiver->headers[i].msg_hdr.msg_namelen;
+        receiver->truncated[i] = (receiver->headers[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+    }
+#else
+    /*Codes_SRS_DATAGRAM_26_013: [ Each receive thread shall read up to batchSize datagrams at a time with recvmmsg, or recvfrom where recvmmsg is not available, blocking only until the first one arrives. ]*/
+    result = 0;
+    for (i = 0; i < batch_size; i++)
+    {
+        ssize_t length;
+        receiver->address_lengths[i] = sizeof(struct sockaddr_storage);
+        length = recvfrom(receiver->fd, receiver->buffers + (i * receiver->module->max_datagram_size), receiver->module->max_datagram_size,
+            (i == 0) ? 0 : MSG_DONTWAIT, (struct sockaddr*)&receiver->addresses[i], &receiver->address_lengths[i]);
+        if (length < 0)
+        {
+            result = (i == 0) ? -1 : (int)i;
+            break;
+        }
+        receiver->lengths[i] = (size_t)length;
+        receiver->truncated[i] = false;
+        result = (int)(i + 1);
+    }
+#endif
+    return result;
+}
+
+static void publish_batch(DATAGRAM_RECEIVER* receiver, size_t received)
+{
+    DATAGRAM_MODULE_DATA* module = receiver->module;
+    size_t count = 0;
+    size_t truncated = 0;
+    size_t i;
+    for (i = 0; i < received; i++)
+    {
+        MAP_HANDLE properties;
+        if (receiver->truncated[i])
+        {
+            truncated++;
+        }
+        /*Codes_SRS_DATAGRAM_26_014: [ For each datagram, the receive thread shall create a message with the datagram as its content and the properties of the source whose "ip:port", or else "ip" or path, matches the sender, no properties if none matches, and shall drop the datagram if none matches and dropUnknown is true, or it was truncated. ]*/
+        else if ((properties = find_properties(module, &receiver->addresses[i], receiver->address_lengths[i])) != NULL)
+        {
+            MESSAGE_CONFIG config;
+            config.size = receiver->lengths[i];
+            config.source = receiver->buffers + (i * module->max_datagram_size);
+            config.sourceProperties = properties;
+            receiver->messages[count] = Message_Create(&config);
+            if (receiver->messages[count] == NULL)
+            {
+                LogError("unable to create a message from a datagram");
+            }
+            else
+            {
+                count++;
+            }
+        }
+    }
+
+    if (truncated > 0)
+    {
+        LogError("dropped %zu datagram(s) larger than maxDatagramSize (%zu)", truncated, module->max_datagram_size);
+    }
+
+    if (count > 0)
+    {
+        /*Codes_SRS_DATAGRAM_26_015: [ The receive thread shall publish the messages of a batch with one call to Broker_PublishBatch, and destroy them. ]*/
+        if (Broker_PublishBatch(module->broker, (MODULE_HANDLE)module, receiver->messages, count) != BROKER_OK)
+        {
+            LogError("unable to publish %zu datagram(s)", count);
+        }
+        for (i = 0; i < count; i++)
+        {
+            Message_Destroy(receiver->messages[i]);
+        }
+    }
+}
+
+static int datagram_receive(void* context)
+{
+    DATAGRAM_RECEIVER* receiver = (DATAGRAM_RECEIVER*)context;
+    while (!receiver->module->stop)
+    {
+        int received = receive_batch(receiver);
+        if (received > 0)
+        {
+            publish_batch(receiver, (size_t)received);
+        }
+        else if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            LogError("receive failed, errno %d; the receive thread stops", errno);
+            break;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Module API
+ */
+
+static void DatagramModule_Destroy(MODULE_HANDLE moduleHandle)
+{
+    if (moduleHandle == NULL)
+    {
+        LogError("Attempt to destroy NULL module");
+    }
+    else
+    {
+        DATAGRAM_MODULE_DATA* module = (DATAGRAM_MODULE_DATA*)moduleHandle;
+        size_t i;
+        /*Codes_SRS_DATAGRAM_26_017: [ DatagramModule_Destroy shall stop and join the receive threads, close the sockets, remove the Unix socket path and free the module. ]*/
+        module->stop = true;
+        for (i = 0; i < module->receiver_count; i++)
+        {
+            int thread_result;
+            if (module->receivers[i].started && ThreadAPI_Join(module->receivers[i].thread, &thread_result) != THREADAPI_OK)
+            {
+                LogError("unable to join receive thread %zu", i);
+            }
+        }
+        close_receivers(module);
+        if (module->transport == DATAGRAM_UNIX)
+        {
+            (void)unlink(module->address);
+        }
+        destroy_routes(module);
+        Map_Destroy(module->unknown_properties);
+        free(module->address);
+        free(module);
+    }
+}
+
+static MODULE_HANDLE DatagramModule_Create(BROKER_HANDLE broker, const void* configuration)
+{
+    DATAGRAM_MODULE_DATA* result;
+    const DATAGRAM_CONFIG* config = (const DATAGRAM_CONFIG*)configuration;
+    /*Codes_SRS_DATAGRAM_26_009: [ DatagramModule_Create shall return NULL if broker or configuration is NULL, the address is NULL, or batchSize, maxDatagramSize or threads is 0 or maxDatagramSize is above 65535. ]*/
+    if (broker == NULL || config == NULL || config->address == NULL ||
+        config->batchSize == 0 || config->maxDatagramSize == 0 || config->maxDatagramSize > DATAGRAM_MAX_DATAGRAM_SIZE ||
+        config->threads == 0 || (config->sourceCount > 0 && config->sources == NULL))
+    {
+        LogError("invalid DATAGRAM module args.");
+        result = NULL;
+    }
+    else
+    {
+        result = (DATAGRAM_MODULE_DATA*)malloc(sizeof(DATAGRAM_MODULE_DATA));
+        if (result == NULL)
+        {
+            LogError("couldn't allocate memory for the datagram module");
+        }
+        else
+        {
+            result->broker = broker;
+            result->transport = config->transport;
+            result->batch_size = config->batchSize;
+            result->max_datagram_size = config->maxDatagramSize;
+            result->drop_unknown = config->dropUnknown;
+            result->receiver_count = 0;
+            result->receivers = NULL;
+            result->stop = false;
+
+            if (mallocAndStrcpy_s(&result->address, config->address) != 0)
+            {
+                LogError("unable to copy the address");
+                free(result);
+                result = NULL;
+            }
+            else if ((result->unknown_properties = create_properties(NULL)) == NULL)
+            {
+                free(result->address);
+                free(result);
+                result = NULL;
+            }
+            else if (create_routes(result, config) != 0)
+            {
+                Map_Destroy(result->unknown_properties);
+                free(result->address);
+                free(result);
+                result = NULL;
+            }
+            else if (open_receivers(result, config) != 0)
+            {
+                destroy_routes(result);
+                Map_Destroy(result->unknown_properties);
+                free(result->address);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*the sockets are bound; datagrams queue until the module starts*/
+            }
+        }
+    }
+    return (MODULE_HANDLE)result;
+}
+
+static void DatagramModule_Start(MODULE_HANDLE moduleHandle)
+{
+    if (moduleHandle == NULL)
+    {
+        LogError("Attempt to start NULL module");
+    }
+    else
+    {
+        DATAGRAM_MODULE_DATA* module = (DATAGRAM_MODULE_DATA*)moduleHandle;
+        size_t i;
+        /*Codes_SRS_DATAGRAM_26_012: [ DatagramModule_Start shall start one receive thread per configured thread. ]*/
+        for (i = 0; i < module->receiver_count; i++)
+        {
+            DATAGRAM_RECEIVER* receiver = &module->receivers[i];
+            if (!receiver->started)
+            {
+                if (ThreadAPI_Create(&receiver->thread, datagram_receive, receiver) != THREADAPI_OK)
+                {
+                    LogError("unable to start receive thread %zu", i);
+                }
+                else
+                {
+                    receiver->started = true;
+                }
+            }
+        }
+    }
+}
+
+static void DatagramModule_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    /*Codes_SRS_DATAGRAM_26_016: [ DatagramModule_Receive shall ignore the message. ]*/
+    (void)moduleHandle;
+    (void)messageHandle;
+}
+
+/*
+ *    Required for all modules:  the public API and the designated implementation functions.
+ */
+static const MODULE_API_1 DatagramModule_APIS_all =
+{
+    {MODULE_API_VERSION_1},
+
+    DatagramModule_ParseConfigurationFromJson,
+    DatagramModule_FreeConfiguration,
+    DatagramModule_Create,
+    DatagramModule_Destroy,
+    DatagramModule_Receive,
+    DatagramModule_Start
+};
+
+/*Codes_SRS_DATAGRAM_26_001: [ Module_GetApi shall return a MODULE_API with every function set. ]*/
+#ifdef BUILD_MODULE_TYPE_STATIC
+MODULE_EXPORT const MODULE_API* MODULE_STATIC_GETAPI(DATAGRAM_MODULE)(MODULE_API_VERSION gateway_api_version)
+#else
+MODULE_EXPORT const MODULE_API* Module_GetApi(MODULE_API_VERSION gateway_api_version)
+#endif
+{
+    (void)gateway_api_version;
+    return (const MODULE_API *)&DatagramModule_APIS_all;
+}
@@ -0,0 +1,702 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define GATEWAY_EXPORT_H
+#define GATEWAY_EXPORT
+
+#include "broker.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/map.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "message.h"
+
+MOCKABLE_FUNCTION(, BROKER_RESULT, Broker_PublishBatch, BROKER_HANDLE, broker, MODULE_HANDLE, source, const MESSAGE_HANDLE*, messages, size_t, count);
+#undef ENABLE_MOCKS
+
+#include "module.h"
+#include "messageproperties.h"
+#include "datagram.h"
+
+#define TEST_BROKER ((BROKER_HANDLE)0x11)
+#define TEST_UNIX_PATH "/tmp/datagram_ut.sock"
+#define TEST_UNIX_SENDER_PATH "/tmp/datagram_ut_sender.sock"
+#define TEST_MAX_PUBLISHED 32
+
+#ifdef WIN32
+static TEST_MUTEX_HANDLE g_dllByDll;
+#endif
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+/*the properties maps are real enough to read back what the module put in them*/
+typedef struct TEST_MAP_TAG
+{
+    char deviceName[32];
+    char macAddress[32];
+} TEST_MAP;
+
+typedef struct TEST_MESSAGE_TAG
+{
+    char content[32];
+    MAP_HANDLE properties;
+} TEST_MESSAGE;
+
+typedef struct TEST_PUBLISHED_TAG
+{
+    char content[32];
+    char deviceName[32];
+    char macAddress[32];
+} TEST_PUBLISHED;
+
+/*written by the receive thread, read by the test*/
+static pthread_mutex_t g_published_lock = PTHREAD_MUTEX_INITIALIZER;
+static TEST_PUBLISHED g_published[TEST_MAX_PUBLISHED];
+static size_t g_published_count;
+static size_t g_batch_count;
+
+/*when false, ThreadAPI_Create records the thread without starting it*/
+static bool g_run_threads;
+
+static MAP_HANDLE my_Map_Create(MAP_FILTER_CALLBACK mapFilterFunc)
+{
+    (void)mapFilterFunc;
+    return (MAP_HANDLE)calloc(1, sizeof(TEST_MAP));
+}
+
+static MAP_RESULT my_Map_AddOrUpdate(MAP_HANDLE handle, const char* key, const char* value)
+{
+    TEST_MAP* map = (TEST_MAP*)handle;
+    if (strcmp(key, GW_DEVICENAME_PROPERTY) == 0)
+    {
+        (void)snprintf(map->deviceName, sizeof(map->deviceName), "%s", value);
+    }
+    else if (strcmp(key, GW_MAC_ADDRESS_PROPERTY) == 0)
+    {
+        (void)snprintf(map->macAddress, sizeof(map->macAddress), "%s", value);
+    }
+    return MAP_OK;
+}
+
+static void my_Map_Destroy(MAP_HANDLE handle)
+{
+    free(handle);
+}
+
+static MESSAGE_HANDLE my_Message_Create(const MESSAGE_CONFIG* cfg)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)calloc(1, sizeof(TEST_MESSAGE));
+    memcpy(message->content, cfg->source, (cfg->size < sizeof(message->content)) ? cfg->size : sizeof(message->content) - 1);
+    message->properties = cfg->sourceProperties;
+    return (MESSAGE_HANDLE)message;
+}
+
+static void my_Message_Destroy(MESSAGE_HANDLE message)
+{
+    free(message);
+}
+
+static BROKER_RESULT my_Broker_PublishBatch(BROKER_HANDLE broker, MODULE_HANDLE source, const MESSAGE_HANDLE* messages, size_t count)
+{
+    size_t i;
+    (void)broker;
+    (void)source;
+    (void)pthread_mutex_lock(&g_published_lock);
+    for (i = 0; i < count && g_published_count < TEST_MAX_PUBLISHED; i++)
+    {
+        const TEST_MESSAGE* message = (const TEST_MESSAGE*)messages[i];
+        const TEST_MAP* map = (const TEST_MAP*)message->properties;
+        TEST_PUBLISHED* published = &g_published[g_published_count++];
+        (void)strcpy(published->content, message->content);
+        (void)strcpy(published->deviceName, map->deviceName);
+        (void)strcpy(published->macAddress, map->macAddress);
+    }
+    g_batch_count++;
+    (void)pthread_mutex_unlock(&g_published_lock);
+    return BROKER_OK;
+}
+
+static int my_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    *destination = (char*)malloc(strlen(source) + 1);
+    (void)strcpy(*destination, source);
+    return 0;
+}
+
+typedef struct TEST_THREAD_TAG
+{
+    pthread_t thread;
+    THREAD_START_FUNC func;
+    void* arg;
+    bool running;
+} TEST_THREAD;
+
+static void* test_thread_main(void* context)
+{
+    TEST_THREAD* thread = (TEST_THREAD*)context;
+    (void)thread->func(thread->arg);
+    return NULL;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    TEST_THREAD* thread = (TEST_THREAD*)calloc(1, sizeof(TEST_THREAD));
+    thread->func = func;
+    thread->arg = arg;
+    thread->running = g_run_threads && (pthread_create(&thread->thread, NULL, test_thread_main, thread) == 0);
+    *threadHandle = thread;
+    return THREADAPI_OK;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int* res)
+{
+    TEST_THREAD* thread = (TEST_THREAD*)threadHandle;
+    if (thread->running)
+    {
+        (void)pthread_join(thread->thread, NULL);
+    }
+    free(thread);
+    *res = 0;
+    return THREADAPI_OK;
+}
+
+static const MODULE_API_1* get_api(void)
+{
+    return (const MODULE_API_1*)MODULE_STATIC_GETAPI(DATAGRAM_MODULE)(MODULE_API_VERSION_1);
+}
+
+static size_t wait_for_published(size_t expected)
+{
+    size_t result;
+    int waited_ms;
+    for (waited_ms = 0; ; waited_ms += 10)
+    {
+        (void)pthread_mutex_lock(&g_published_lock);
+        result = g_published_count;
+        (void)pthread_mutex_unlock(&g_published_lock);
+        if (result >= expected || waited_ms >= 2000)
+        {
+            break;
+        }
+        (void)usleep(10 * 1000);
+    }
+    return result;
+}
+
+/*binds a UDP socket to ip and an ephemeral port, and returns the port*/
+static int bind_udp(const char* ip, unsigned short* port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in address;
+    socklen_t address_length = sizeof(address);
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    (void)inet_pton(AF_INET, ip, &address.sin_addr);
+    ASSERT_ARE_EQUAL(int, 0, bind(fd, (struct sockaddr*)&address, sizeof(address)));
+    ASSERT_ARE_EQUAL(int, 0, getsockname(fd, (struct sockaddr*)&address, &address_length));
+    *port = ntohs(address.sin_port);
+    return fd;
+}
+
+static unsigned short free_udp_port(void)
+{
+    unsigned short port;
+    (void)close(bind_udp("127.0.0.1", &port));
+    return port;
+}
+
+static void send_udp(int fd, unsigned short port, const char* content)
+{
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    (void)inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    ASSERT_ARE_EQUAL(int, (int)strlen(content), (int)sendto(fd, content, strlen(content), 0, (struct sockaddr*)&address, sizeof(address)));
+}
+
+static DATAGRAM_CONFIG make_udp_config(unsigned short port, DATAGRAM_SOURCE* sources, size_t source_count)
+{
+    DATAGRAM_CONFIG config;
+    memset(&config, 0, sizeof(config));
+    config.transport = DATAGRAM_UDP;
+    config.address = "127.0.0.1";
+    config.port = port;
+    config.batchSize = 8;
+    config.maxDatagramSize = 64;
+    config.threads = 1;
+    config.dropUnknown = false;
+    config.sourceCount = source_count;
+    config.sources = sources;
+    return config;
+}
+
+BEGIN_TEST_SUITE(datagram_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_bool_register_types();
+    umocktypes_stdint_register_types();
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_Create, my_Map_Create);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_AddOrUpdate, my_Map_AddOrUpdate);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_Destroy, my_Map_Destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(Message_Create, my_Message_Create);
+    REGISTER_GLOBAL_MOCK_HOOK(Message_Destroy, my_Message_Destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(Broker_PublishBatch, my_Broker_PublishBatch);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
+
+    REGISTER_UMOCK_ALIAS_TYPE(BROKER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(BROKER_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MODULE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const MESSAGE_HANDLE*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_FILTER_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    g_published_count = 0;
+    g_batch_count = 0;
+    g_run_threads = true;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_DATAGRAM_26_001: [ Module_GetApi shall return a MODULE_API with every function set. ]*/
+TEST_FUNCTION(DatagramModule_GetApi_returns_every_function)
+{
+    ///act
+    const MODULE_API* apis = MODULE_STATIC_GETAPI(DATAGRAM_MODULE)(MODULE_API_VERSION_1);
+
+    ///assert
+    ASSERT_IS_TRUE(MODULE_PARSE_CONFIGURATION_FROM_JSON(apis) != NULL);
+    ASSERT_IS_TRUE(MODULE_FREE_CONFIGURATION(apis) != NULL);
+    ASSERT_IS_TRUE(MODULE_CREATE(apis) != NULL);
+    ASSERT_IS_TRUE(MODULE_DESTROY(apis) != NULL);
+    ASSERT_IS_TRUE(MODULE_RECEIVE(apis) != NULL);
+    ASSERT_IS_TRUE(MODULE_START(apis) != NULL);
+}
+
+/*Tests_SRS_DATAGRAM_26_002: [ DatagramModule_ParseConfigurationFromJson shall return NULL if configuration is NULL or is not a JSON object. ]*/
+TEST_FUNCTION(DatagramModule_ParseConfigurationFromJson_returns_NULL_for_NULL_or_non_object)
+{
+    ///act
+    void* result1 = get_api()->Module_ParseConfigurationFromJson(NULL);
+    void* result2 = get_api()->Module_ParseConfigurationFromJson("[ 1, 2 ]");
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+}
+
+/*Tests_SRS_DATAGRAM_26_003: [ DatagramModule_ParseConfigurationFromJson shall read "transport" as "udp", the default, or "unix", and return NULL for any other value. ]*/
+/*Tests_SRS_DATAGRAM_26_004: [ For "udp", DatagramModule_ParseConfigurationFromJson shall read the "address" to bind, "0.0.0.0" by default, and the "port", a whole number from 0 to 65535, and return NULL if "port" is missing or invalid. ]*/
+/*Tests_SRS_DATAGRAM_26_005: [ DatagramModule_ParseConfigurationFromJson shall read the optional "batchSize", "maxDatagramSize" and "threads" whole numbers, 64, 2048 and 1 by default, and return NULL if any is 0, or "maxDatagramSize" is above 65535. ]*/
+/*Tests_SRS_DATAGRAM_26_006: [ DatagramModule_ParseConfigurationFromJson shall read the optional "dropUnknown" boolean, false by default. ]*/
+/*Tests_SRS_DATAGRAM_26_007: [ DatagramModule_ParseConfigurationFromJson shall return NULL if "sources" is present and is not an array of objects that each have an "address" string and optional "deviceName" and "macAddress" strings. ]*/
+/*Tests_SRS_DATAGRAM_26_008: [ DatagramModule_FreeConfiguration shall free the configuration, and do nothing if it is NULL. ]*/
+TEST_FUNCTION(DatagramModule_ParseConfigurationFromJson_reads_a_udp_configuration)
+{
+    ///arrange
+    const char* json =
+        "{ \"port\": 5000, \"batchSize\": 16, \"threads\": 4, \"dropUnknown\": true,"
+        "  \"sources\": [ { \"address\": \"10.0.0.5:7000\", \"deviceName\": \"sensor\", \"macAddress\": \"AA:BB:CC:DD:EE:FF\" },"
+        "                 { \"address\": \"10.0.0.6\" } ] }";
+
+    ///act
+    DATAGRAM_CONFIG* config = (DATAGRAM_CONFIG*)get_api()->Module_ParseConfigurationFromJson(json);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(config);
+    ASSERT_ARE_EQUAL(int, DATAGRAM_UDP, config->transport);
+    ASSERT_ARE_EQUAL(char_ptr, "0.0.0.0", config->address);
+    ASSERT_ARE_EQUAL(int, 5000, (int)config->port);
+    ASSERT_ARE_EQUAL(size_t, 16, config->batchSize);
+    ASSERT_ARE_EQUAL(size_t, DATAGRAM_DEFAULT_MAX_DATAGRAM_SIZE, config->maxDatagramSize);
+    ASSERT_ARE_EQUAL(size_t, 4, config->threads);
+    ASSERT_IS_TRUE(config->dropUnknown);
+    ASSERT_ARE_EQUAL(size_t, 2, config->sourceCount);
+    ASSERT_ARE_EQUAL(char_ptr, "10.0.0.5:7000", config->sources[0].address);
+    ASSERT_ARE_EQUAL(char_ptr, "sensor", config->sources[0].deviceName);
+    ASSERT_ARE_EQUAL(char_ptr, "AA:BB:CC:DD:EE:FF", config->sources[0].macAddress);
+    ASSERT_ARE_EQUAL(char_ptr, "10.0.0.6", config->sources[1].address);
+    ASSERT_IS_NULL(config->sources[1].deviceName);
+    ASSERT_IS_NULL(config->sources[1].macAddress);
+
+    ///cleanup
+    get_api()->Module_FreeConfiguration(config);
+    get_api()->Module_FreeConfiguration(NULL);
+}
+
+/*Tests_SRS_DATAGRAM_26_018: [ For "unix", DatagramModule_ParseConfigurationFromJson shall read the socket "path", and return NULL if it is missing. ]*/
+/*Tests_SRS_DATAGRAM_26_005: [ DatagramModule_ParseConfigurationFromJson shall read the optional "batchSize", "maxDatagramSize" and "threads" whole numbers, 64, 2048 and 1 by default, and return NULL if any is 0, or "maxDatagramSize" is above 65535. ]*/
+/*Tests_SRS_DATAGRAM_26_006: [ DatagramModule_ParseConfigurationFromJson shall read the optional "dropUnknown" boolean, false by default. ]*/
+TEST_FUNCTION(DatagramModule_ParseConfigurationFromJson_reads_a_unix_configuration_with_defaults)
+{
+    ///act
+    DATAGRAM_CONFIG* config = (DATAGRAM_CONFIG*)get_api()->Module_ParseConfigurationFromJson("{ \"transport\": \"unix\", \"path\": \"/run/gw.sock\" }");
+
+    ///assert
+    ASSERT_IS_NOT_NULL(config);
+    ASSERT_ARE_EQUAL(int, DATAGRAM_UNIX, config->transport);
+    ASSERT_ARE_EQUAL(char_ptr, "/run/gw.sock", config->address);
+    ASSERT_ARE_EQUAL(size_t, DATAGRAM_DEFAULT_BATCH_SIZE, config->batchSize);
+    ASSERT_ARE_EQUAL(size_t, DATAGRAM_DEFAULT_MAX_DATAGRAM_SIZE, config->maxDatagramSize);
+    ASSERT_ARE_EQUAL(size_t, 1, config->threads);
+    ASSERT_IS_FALSE(config->dropUnknown);
+    ASSERT_ARE_EQUAL(size_t, 0, config->sourceCount);
+
+    ///cleanup
+    get_api()->Module_FreeConfiguration(config);
+}
+
+/*Tests_SRS_DATAGRAM_26_003: [ DatagramModule_ParseConfigurationFromJson shall read "transport" as "udp", the default, or "unix", and return NULL for any other value. ]*/
+/*Tests_SRS_DATAGRAM_26_004: [ For "udp", DatagramModule_ParseConfigurationFromJson shall read the "address" to bind, "0.0.0.0" by default, and the "port", a whole number from 0 to 65535, and return NULL if "port" is missing or invalid. ]*/
+/*Tests_SRS_DATAGRAM_26_005: [ DatagramModule_ParseConfigurationFromJson shall read the optional "batchSize", "maxDatagramSize" and "threads" whole numbers, 64, 2048 and 1 by default, and return NULL if any is 0, or "maxDatagramSize" is above 65535. ]*/
+/*Tests_SRS_DATAGRAM_26_007: [ DatagramModule_ParseConfigurationFromJson shall return NULL if "sources" is present and is not an array of objects that each have an "address" string and optional "deviceName" and "macAddress" strings. ]*/
+/*Tests_SRS_DATAGRAM_26_018: [ For "unix", DatagramModule_ParseConfigurationFromJson shall read the socket "path", and return NULL if it is missing. ]*/
+TEST_FUNCTION(DatagramModule_ParseConfigurationFromJson_returns_NULL_for_invalid_values)
+{
+    ///arrange
+    const char* invalid[] =
+    {
+        "{ \"transport\": \"tcp\", \"port\": 5000 }",
+        "{ \"transport\": \"unix\" }",
+        "{ \"address\": \"127.0.0.1\" }",
+        "{ \"port\": 70000 }",
+        "{ \"port\": 5000, \"batchSize\": 0 }",
+        "{ \"port\": 5000, \"threads\": 1.5 }",
+        "{ \"port\": 5000, \"maxDatagramSize\": 65536 }",
+        "{ \"port\": 5000, \"sources\": {} }",
+        "{ \"port\": 5000, \"sources\": [ { \"deviceName\": \"sensor\" } ] }"
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        ///act
+        void* config = get_api()->Module_ParseConfigurationFromJson(invalid[i]);
+
+        ///assert
+        ASSERT_IS_NULL(config);
+    }
+}
+
+/*Tests_SRS_DATAGRAM_26_009: [ DatagramModule_Create shall return NULL if broker or configuration is NULL, the address is NULL, or batchSize, maxDatagramSize or threads is 0 or maxDatagramSize is above 65535. ]*/
+TEST_FUNCTION(DatagramModule_Create_returns_NULL_for_invalid_arguments)
+{
+    ///arrange
+    DATAGRAM_CONFIG config = make_udp_config(0, NULL, 0);
+    DATAGRAM_CONFIG no_batch = config;
+    DATAGRAM_CONFIG no_threads = config;
+    DATAGRAM_CONFIG too_large = config;
+    no_batch.batchSize = 0;
+    no_threads.threads = 0;
+    too_large.maxDatagramSize = 65536;
+
+    ///act
+    MODULE_HANDLE result1 = get_api()->Module_Create(NULL, &config);
+    MODULE_HANDLE result2 = get_api()->Module_Create(TEST_BROKER, NULL);
+    MODULE_HANDLE result3 = get_api()->Module_Create(TEST_BROKER, &no_batch);
+    MODULE_HANDLE result4 = get_api()->Module_Create(TEST_BROKER, &no_threads);
+    MODULE_HANDLE result5 = get_api()->Module_Create(TEST_BROKER, &too_large);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_IS_NULL(result4);
+    ASSERT_IS_NULL(result5);
+}
+
+/*Tests_SRS_DATAGRAM_26_010: [ DatagramModule_Create shall build the properties of each source once, a deviceName and a macAddress property for those it has, and return NULL if a source address cannot be parsed. ]*/
+TEST_FUNCTION(DatagramModule_Create_returns_NULL_for_an_invalid_source_address)
+{
+    ///arrange
+    DATAGRAM_SOURCE sources[] = { { "127.0.0.1:notaport", "sensor", NULL } };
+    DATAGRAM_CONFIG config = make_udp_config(0, sources, 1);
+
+    ///act
+    MODULE_HANDLE module = get_api()->Module_Create(TEST_BROKER, &config);
+
+    ///assert
+    ASSERT_IS_NULL(module);
+}
+
+/*Tests_SRS_DATAGRAM_26_011: [ DatagramModule_Create shall bind one socket per thread with SO_REUSEPORT for a UDP module with more than 1 thread, and one socket the threads share otherwise, removing a Unix socket left behind at its path first, and return NULL if it cannot. ]*/
+/*Tests_SRS_DATAGRAM_26_012: [ DatagramModule_Start shall start one receive thread per configured thread. ]*/
+/*Tests_SRS_DATAGRAM_26_017: [ DatagramModule_Destroy shall stop and join the receive threads, close the sockets, remove the Unix socket path and free the module. ]*/
+TEST_FUNCTION(DatagramModule_Start_starts_one_thread_per_configured_thread)
+{
+    ///arrange
+    DATAGRAM_CONFIG config = make_udp_config(free_udp_port(), NULL, 0);
+    MODULE_HANDLE module;
+    config.threads = 3;
+    g_run_threads = false;
+    module = get_api()->Module_Create(TEST_BROKER, &config);
+    ASSERT_IS_NOT_NULL(module);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    ///act
+    get_api()->Module_Start(module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    get_api()->Module_Destroy(module);
+}
+
+/*Tests_SRS_DATAGRAM_26_013: [ Each receive thread shall read up to batchSize datagrams at a time with recvmmsg, or recvfrom where recvmmsg is not available, blocking only until the first one arrives. ]*/
+/*Tests_SRS_DATAGRAM_26_014: [ For each datagram, the receive thread shall create a message with the datagram as its content and the properties of the source whose "ip:port", or else "ip" or path, matches the sender, no properties if none matches, and shall drop the datagram if none matches and dropUnknown is true, or it was truncated. ]*/
+/*Tests_SRS_DATAGRAM_26_015: [ The receive thread shall publish the messages of a batch with one call to Broker_PublishBatch, and destroy them. ]*/
+TEST_FUNCTION(DatagramModule_publishes_queued_udp_datagrams_as_one_batch_with_the_source_properties)
+{
+    ///arrange
+    unsigned short sensor_port;
+    unsigned short other_port;
+    int sensor = bind_udp("127.0.0.1", &sensor_port);
+    int other = bind_udp("127.0.0.1", &other_port);
+    int unknown = bind_udp("127.0.0.3", &other_port);
+    char sensor_address[32];
+    DATAGRAM_SOURCE sources[2] = { { sensor_address, "sensor", "AA:BB:CC:DD:EE:FF" }, { "127.0.0.1", "loopback", NULL } };
+    unsigned short port = free_udp_port();
+    DATAGRAM_CONFIG config = make_udp_config(port, sources, 2);
+    MODULE_HANDLE module;
+    (void)snprintf(sensor_address, sizeof(sensor_address), "127.0.0.1:%hu", sensor_port);
+    module = get_api()->Module_Create(TEST_BROKER, &config);
+    ASSERT_IS_NOT_NULL(module);
+
+    /*queued before the module starts, so the first receive finds all of them*/
+    send_udp(sensor, port, "one");
+    send_udp(sensor, port, "two");
+    send_udp(other, port, "three");
+    send_udp(unknown, port, "four");
+
+    ///act
+    get_api()->Module_Start(module);
+    size_t published = wait_for_published(4);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 4, published);
+    ASSERT_ARE_EQUAL(size_t, 1, g_batch_count);
+    ASSERT_ARE_EQUAL(char_ptr, "one", g_published[0].content);
+    ASSERT_ARE_EQUAL(char_ptr, "sensor", g_published[0].deviceName);
+    ASSERT_ARE_EQUAL(char_ptr, "AA:BB:CC:DD:EE:FF", g_published[0].macAddress);
+    ASSERT_ARE_EQUAL(char_ptr, "two", g_published[1].content);
+    ASSERT_ARE_EQUAL(char_ptr, "sensor", g_published[1].deviceName);
+    ASSERT_ARE_EQUAL(char_ptr, "three", g_published[2].content);
+    ASSERT_ARE_EQUAL(char_ptr, "loopback", g_published[2].deviceName);
+    ASSERT_ARE_EQUAL(char_ptr, "", g_published[2].macAddress);
+    ASSERT_ARE_EQUAL(char_ptr, "four", g_published[3].content);
+    ASSERT_ARE_EQUAL(char_ptr, "", g_published[3].deviceName);
+
+    ///cleanup
+    get_api()->Module_Destroy(module);
+    (void)close(sensor);
+    (void)close(other);
+    (void)close(unknown);
+}
+
+/*Tests_SRS_DATAGRAM_26_014: [ For each datagram, the receive thread shall create a message with the datagram as its content and the properties of the source whose "ip:port", or else "ip" or path, matches the sender, no properties if none matches, and shall drop the datagram if none matches and dropUnknown is true, or it was truncated. ]*/
+TEST_FUNCTION(DatagramModule_drops_unknown_senders_and_truncated_datagrams)
+{
+    ///arrange
+    unsigned short sender_port;
+    int sender = bind_udp("127.0.0.1", &sender_port);
+    int unknown = bind_udp("127.0.0.3", &sender_port);
+    DATAGRAM_SOURCE sources[1] = { { "127.0.0.1", "sensor", NULL } };
+    unsigned short port = free_udp_port();
+    DATAGRAM_CONFIG config = make_udp_config(port, sources, 1);
+    MODULE_HANDLE module;
+    config.dropUnknown = true;
+    config.maxDatagramSize = 4;
+    module = get_api()->Module_Create(TEST_BROKER, &config);
+    ASSERT_IS_NOT_NULL(module);
+
+    send_udp(unknown, port, "who");
+    send_udp(sender, port, "toolong");
+    send_udp(sender, port, "ok");
+
+    ///act
+    get_api()->Module_Start(module);
+    size_t published = wait_for_published(1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, published);
+    ASSERT_ARE_EQUAL(char_ptr, "ok", g_published[0].content);
+    ASSERT_ARE_EQUAL(char_ptr, "sensor", g_published[0].deviceName);
+
+    ///cleanup
+    get_api()->Module_Destroy(module);
+    (void)close(sender);
+    (void)close(unknown);
+}
+
+/*Tests_SRS_DATAGRAM_26_011: [ DatagramModule_Create shall bind one socket per thread with SO_REUSEPORT for a UDP module with more than 1 thread, and one socket the threads share otherwise, removing a Unix socket left behind at its path first, and return NULL if it cannot. ]*/
+/*Tests_SRS_DATAGRAM_26_014: [ For each datagram, the receive thread shall create a message with the datagram as its content and the properties of the source whose "ip:port", or else "ip" or path, matches the sender, no properties if none matches, and shall drop the datagram if none matches and dropUnknown is true, or it was truncated. ]*/
+/*Tests_SRS_DATAGRAM_26_017: [ DatagramModule_Destroy shall stop and join the receive threads, close the sockets, remove the Unix socket path and free the module. ]*/
+TEST_FUNCTION(DatagramModule_maps_unix_senders_by_path_and_removes_its_path)
+{
+    ///arrange
+    DATAGRAM_SOURCE sources[1] = { { TEST_UNIX_SENDER_PATH, "unix-sensor", "01:02:03:04:05:06" } };
+    DATAGRAM_CONFIG config = make_udp_config(0, sources, 1);
+    struct sockaddr_un address;
+    int sender = socket(AF_UNIX, SOCK_DGRAM, 0);
+    int unbound = socket(AF_UNIX, SOCK_DGRAM, 0);
+    MODULE_HANDLE module;
+    config.transport = DATAGRAM_UNIX;
+    config.address = TEST_UNIX_PATH;
+
+    /*a path left behind does not stop the module from binding*/
+    {
+        int stale = socket(AF_UNIX, SOCK_DGRAM, 0);
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        (void)strcpy(address.sun_path, TEST_UNIX_PATH);
+        (void)unlink(TEST_UNIX_PATH);
+        (void)bind(stale, (struct sockaddr*)&address, sizeof(address));
+        (void)close(stale);
+    }
+    module = get_api()->Module_Create(TEST_BROKER, &config);
+    ASSERT_IS_NOT_NULL(module);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    (void)strcpy(address.sun_path, TEST_UNIX_SENDER_PATH);
+    (void)unlink(TEST_UNIX_SENDER_PATH);
+    ASSERT_ARE_EQUAL(int, 0, bind(sender, (struct sockaddr*)&address, sizeof(address)));
+    (void)strcpy(address.sun_path, TEST_UNIX_PATH);
+    ASSERT_ARE_EQUAL(int, 5, (int)sendto(sender, "hello", 5, 0, (struct sockaddr*)&address, sizeof(address)));
+    ASSERT_ARE_EQUAL(int, 4, (int)sendto(unbound, "anon", 4, 0, (struct sockaddr*)&address, sizeof(address)));
+
+    ///act
+    get_api()->Module_Start(module);
+    size_t published = wait_for_published(2);
+    get_api()->Module_Destroy(module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, published);
+    ASSERT_ARE_EQUAL(char_ptr, "hello", g_published[0].content);
+    ASSERT_ARE_EQUAL(char_ptr, "unix-sensor", g_published[0].deviceName);
+    ASSERT_ARE_EQUAL(char_ptr, "01:02:03:04:05:06", g_published[0].macAddress);
+    ASSERT_ARE_EQUAL(char_ptr, "anon", g_published[1].content);
+    ASSERT_ARE_EQUAL(char_ptr, "", g_published[1].deviceName);
+    ASSERT_ARE_NOT_EQUAL(int, 0, access(TEST_UNIX_PATH, F_OK));
+
+    ///cleanup
+    (void)close(sender);
+    (void)close(unbound);
+    (void)unlink(TEST_UNIX_SENDER_PATH);
+}
+
+/*Tests_SRS_DATAGRAM_26_019: [ DatagramModule_Create shall return NULL, and leave the path alone, if the path of a Unix socket module exists and is not a socket. ]*/
+TEST_FUNCTION(DatagramModule_Create_fails_when_the_unix_path_is_not_a_socket)
+{
+    ///arrange
+    DATAGRAM_CONFIG config = make_udp_config(0, NULL, 0);
+    FILE* file;
+    config.transport = DATAGRAM_UNIX;
+    config.address = TEST_UNIX_PATH;
+    (void)unlink(TEST_UNIX_PATH);
+    file = fopen(TEST_UNIX_PATH, "w");
+    ASSERT_IS_NOT_NULL(file);
+    (void)fclose(file);
+
+    ///act
+    MODULE_HANDLE module = get_api()->Module_Create(TEST_BROKER, &config);
+
+    ///assert
+    ASSERT_IS_NULL(module);
+    ASSERT_ARE_EQUAL(int, 0, access(TEST_UNIX_PATH, F_OK));
+
+    ///cleanup
+    (void)unlink(TEST_UNIX_PATH);
+}
+
+/*Tests_SRS_DATAGRAM_26_016: [ DatagramModule_Receive shall ignore the message. ]*/
+TEST_FUNCTION(DatagramModule_Receive_ignores_the_message)
+{
+    ///act
+    get_api()->Module_Receive((MODULE_HANDLE)0x42, (MESSAGE_HANDLE)0x43);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(datagram_ut)
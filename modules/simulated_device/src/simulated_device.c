@@ -4,23 +4,24 @@
 #include <stdlib.h>
 
 #include "simulated_device.h"
-#include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "messageproperties.h"
 #include "message.h"
 #include "module.h"
 #include "broker.h"
+#include "gateway_timer.h"
 
 #include <parson.h>
 
 typedef struct SIMULATEDDEVICE_DATA_TAG
 {
-    BROKER_HANDLE       broker;
-    THREAD_HANDLE       simulatedDeviceThread;
-    const char *        fakeMacAddress;
-    unsigned int        messagePeriod;
-    unsigned int        simulatedDeviceRunning : 1;
+    BROKER_HANDLE           broker;
+    GATEWAY_TIMER_HANDLE    simulatedDeviceTimer;
+    const char *            fakeMacAddress;
+    unsigned int            messagePeriod;
+    double                  avgTemperature;
+    double                  additionalTemp;
 } SIMULATEDDEVICE_DATA;
 
 typedef struct SIMULATEDDEVICE_CONFIG_TAG
@@ -83,94 +84,89 @@ static void SimulatedDevice_Destroy(MODULE_HANDLE moduleHandle)
     else
     {
         SIMULATEDDEVICE_DATA* module_data = (SIMULATEDDEVICE_DATA*)moduleHandle;
-        int result;
 
-        /* Tell thread to stop */
-        module_data->simulatedDeviceRunning = 0;
-        /* join the thread */
-        ThreadAPI_Join(module_data->simulatedDeviceThread, &result);
+        /* stop the timer; this waits for a message that is being published */
+        if (module_data->simulatedDeviceTimer != NULL)
+        {
+            GatewayTimer_Cancel(module_data->simulatedDeviceTimer);
+        }
+        GatewayTimer_Deinit();
         /* free module data */
         free((void*)module_data->fakeMacAddress);
         free(module_data);
     }
 }
 
-static int simulated_device_worker(void * user_data)
+/* called by the gateway timer service every messagePeriod milliseconds */
+static bool simulated_device_publish(void * user_data)
 {
     SIMULATEDDEVICE_DATA* module_data = (SIMULATEDDEVICE_DATA*)user_data;
-    double avgTemperature = 10.0;
-    double additionalTemp = 0.0;
     double maxSpeed = 40.0;
 
     if (user_data != NULL)
     {
+        MESSAGE_CONFIG newMessageCfg;
+        MAP_HANDLE newProperties = Map_Create(NULL);
+        if (newProperties == NULL)
+        {
+            LogError("Failed to create message properties");
+        }
 
-        while (module_data->simulatedDeviceRunning)
+        else
         {
-            MESSAGE_CONFIG newMessageCfg;
-            MAP_HANDLE newProperties = Map_Create(NULL);
-            if (newProperties == NULL)
+            if (Map_Add(newProperties, GW_SOURCE_PROPERTY, GW_SOURCE_BLE_TELEMETRY) != MAP_OK)
             {
-                LogError("Failed to create message properties");
+                LogError("Failed to set source property");
+            }
+            else if (Map_Add(newProperties, GW_MAC_ADDRESS_PROPERTY, module_data->fakeMacAddress) != MAP_OK)
+            {
+                LogError("Failed to set source property");
             }
-
             else
             {
-                if (Map_Add(newProperties, GW_SOURCE_PROPERTY, GW_SOURCE_BLE_TELEMETRY) != MAP_OK)
-                {
-                    LogError("Failed to set source property");
-                }
-                else if (Map_Add(newProperties, GW_MAC_ADDRESS_PROPERTY, module_data->fakeMacAddress) != MAP_OK)
+                char msgText[128];
+
+                newMessageCfg.sourceProperties = newProperties;
+                if ((module_data->avgTemperature + module_data->additionalTemp) > maxSpeed)
+                    module_data->additionalTemp = 0.0;
+
+                if (sprintf_s(msgText, sizeof(msgText), "{\"temperature\": %.2f}", module_data->avgTemperature + module_data->additionalTemp) < 0)
                 {
-                    LogError("Failed to set source property");
+                    LogError("Failed to set message text");
                 }
                 else
                 {
-                    char msgText[128];
+                    (void)printf("Device: %s, Temperature: %.2f\r\n",
+                        module_data->fakeMacAddress,
+                        module_data->avgTemperature + module_data->additionalTemp
+                        );
+                    (void)fflush(stdout);
 
-                    newMessageCfg.sourceProperties = newProperties;
-                    if ((avgTemperature + additionalTemp) > maxSpeed)
-                        additionalTemp = 0.0;
+                    newMessageCfg.size = strlen(msgText);
+                    newMessageCfg.source = (const unsigned char*)msgText;
 
-                    if (sprintf_s(msgText, sizeof(msgText), "{\"temperature\": %.2f}", avgTemperature + additionalTemp) < 0)
+                    MESSAGE_HANDLE newMessage = Message_Create(&newMessageCfg);
+                    if (newMessage == NULL)
                     {
-                        LogError("Failed to set message text");
+                        LogError("Failed to create new message");
                     }
                     else
                     {
-                        (void)printf("Device: %s, Temperature: %.2f\r\n",
-                            module_data->fakeMacAddress,
-                            avgTemperature + additionalTemp
-                            );
-                        (void)fflush(stdout);
-
-                        newMessageCfg.size = strlen(msgText);
-                        newMessageCfg.source = (const unsigned char*)msgText;
-
-                        MESSAGE_HANDLE newMessage = Message_Create(&newMessageCfg);
-                        if (newMessage == NULL)
+                        if (Broker_Publish(module_data->broker, (MODULE_HANDLE)module_data, newMessage) != BROKER_OK)
                         {
                             LogError("Failed to create new message");
                         }
-                        else
-                        {
-                            if (Broker_Publish(module_data->broker, (MODULE_HANDLE)module_data, newMessage) != BROKER_OK)
-                            {
-                                LogError("Failed to create new message");
-                            }
 
-                            additionalTemp += 1.0;
-                            Message_Destroy(newMessage);
-                        }
+                        module_data->additionalTemp += 1.0;
+                        Message_Destroy(newMessage);
                     }
                 }
-                Map_Destroy(newProperties);
             }
-            ThreadAPI_Sleep(module_data -> messagePeriod);
+            Map_Destroy(newProperties);
         }
     }
 
-    return 0;
+    return true;
 }
 
 static void SimulatedDevice_Start(MODULE_HANDLE moduleHandle)
@@ -183,18 +179,19 @@ static void SimulatedDevice_Start(MODULE_HANDLE moduleHandle)
     {
         SIMULATEDDEVICE_DATA* module_data = (SIMULATEDDEVICE_DATA*)moduleHandle;
         /* OK to start */
-        /* Create a fake data thread.  */
-        if (ThreadAPI_Create(
-            &(module_data->simulatedDeviceThread),
-            simulated_device_worker,
-            (void*)module_data) != THREADAPI_OK)
+        /* Publish a fake reading every period, from the gateway timer thread. */
+        module_data->simulatedDeviceTimer = GatewayTimer_Schedule(
+            module_data->messagePeriod,
+            module_data->messagePeriod,
+            simulated_device_publish,
+            (void*)module_data);
+        if (module_data->simulatedDeviceTimer == NULL)
         {
-            LogError("ThreadAPI_Create failed");
-            module_data->simulatedDeviceThread = NULL;
+            LogError("GatewayTimer_Schedule failed");
         }
         else
         {
-            /* Thread started, module created, all complete.*/
+            /* Timer scheduled, module created, all complete.*/
         }
     }
 }
@@ -220,8 +217,6 @@ static MODULE_HANDLE SimulatedDevice_Create(BROKER_HANDLE broker, const void* co
         {
             /* save the message broker */
             result->broker = broker;
-            /* set module is running to true */
-            result->simulatedDeviceRunning = 1;
             /* save fake MacAddress */
             char * newFakeAddress;
             int status = mallocAndStrcpy_s(&newFakeAddress, config -> macAddress);
@@ -229,13 +224,23 @@ static MODULE_HANDLE SimulatedDevice_Create(BROKER_HANDLE broker, const void* co
             if (status != 0)
             {
                 LogError("MacAddress did not copy");
+                free(result);
+                result = NULL;
+            }
+            else if (GatewayTimer_Init() != 0)
+            {
+                LogError("GatewayTimer_Init failed");
+                free(newFakeAddress);
+                free(result);
+                result = NULL;
             }
             else
             {
                 result->fakeMacAddress = newFakeAddress;
                 result -> messagePeriod = config -> messagePeriod;
-                result->simulatedDeviceThread = NULL;
-
+                result->simulatedDeviceTimer = NULL;
+                result->avgTemperature = 10.0;
+                result->additionalTemp = 0.0;
             }
 
         }
@@ -32,7 +32,9 @@ class CommunicationDataStrategy implements CommunicationStrategy {
 	 */
 	@Override
     public RemoteMessage deserializeMessage(ByteBuffer messageBuffer, byte version) throws MessageDeserializationException {
-		return new DataMessage(messageBuffer.array());
+		byte[] content = new byte[messageBuffer.remaining()];
+		messageBuffer.get(content);
+		return new DataMessage(content);
 	}
 
 	/**
@@ -34,6 +34,18 @@ interface CommunicationEndpoint {
      */
     RemoteMessage receiveMessage() throws ConnectionException, MessageDeserializationException;
 
+    /**
+     * Waits up to {@code timeoutMillis} for a message.
+     *
+     * @return Deserialized message, or {@code null} if none arrived in time
+     *
+     * @throws ConnectionException
+     *             If there is any error receiving the message from the Gateway
+     * @throws MessageDeserializationException
+     *             If the message is not in the expected format.
+     */
+    RemoteMessage receiveMessage(int timeoutMillis) throws ConnectionException, MessageDeserializationException;
+
     void disconnect();
 
     void sendMessage(byte[] message) throws ConnectionException;
@@ -104,21 +104,20 @@ class MessageDeserializer {
         return new ControlMessage(RemoteMessageType.START);
     }
 
-    private static String readNullTerminatedString(ByteBuffer bis, int size) throws MessageDeserializationException {
-        byte[] result = new byte[size - 1];
-        int index = 0;
-        byte b = bis.get();
+    private static String readNullTerminatedString(ByteBuffer buffer, int size) throws MessageDeserializationException {
+        // check the terminator in place, then copy the string out in one bulk get
+        if (size < 1 || size > buffer.remaining() || buffer.get(buffer.position() + size - 1) != '\0')
+            throw new MessageDeserializationException("Can not deserialize string arguments.");
 
-        while (b != '\0' && b != -1 && index < size - 1) {
-            result[index] = b;
-            index++;
-            b = bis.get();
-        }
+        byte[] result = new byte[size - 1];
+        buffer.get(result);
+        buffer.get();
 
-        if (b != '\0' || index != size - 1)
+        String value = new String(result);
+        if (value.indexOf('\0') >= 0)
             throw new MessageDeserializationException("Can not deserialize string arguments.");
 
-        return new String(result);
+        return value;
     }
 
 }
@@ -61,12 +61,15 @@ class NanomsgCommunicationEndpoint implements CommunicationEndpoint {
      */
     @Override
     public RemoteMessage receiveMessage() throws ConnectionException, MessageDeserializationException {
+        return this.deserializeMessage(this.nano.receiveMessageNoWait(this.socket));
+    }
 
-        byte[] messageBuffer = this.nano.receiveMessageNoWait(this.socket);
-        if (messageBuffer == null) {
-            return null;
-        }
-        return this.communicationStrategy.deserializeMessage(ByteBuffer.wrap(messageBuffer), version);
+    /* (non-Javadoc)
+     * @see com.microsoft.azure.gateway.remote.CommunicationEndpoint#receiveMessage(int)
+     */
+    @Override
+    public RemoteMessage receiveMessage(int timeoutMillis) throws ConnectionException, MessageDeserializationException {
+        return this.deserializeMessage(this.nano.receiveMessage(this.socket, timeoutMillis));
     }
 
     /* (non-Javadoc)
@@ -94,6 +97,14 @@ class NanomsgCommunicationEndpoint implements CommunicationEndpoint {
         return this.nano.sendMessageAsync(this.socket, message);
     }
 
+    private RemoteMessage deserializeMessage(ByteBuffer messageBuffer) throws MessageDeserializationException {
+        if (messageBuffer == null) {
+            return null;
+        }
+        // the buffer is reused by the next receive, so the strategy copies out what it keeps
+        return this.communicationStrategy.deserializeMessage(messageBuffer, version);
+    }
+
     private void createSocket() throws ConnectionException {
         this.socket = this.nano.createSocket(this.communicationStrategy.getEndpointType());
     }
@@ -4,6 +4,7 @@
  */
 package com.microsoft.azure.gateway.remote;
 
+import java.nio.ByteBuffer;
 import java.util.Map;
 
 class NanomsgLibrary {
@@ -14,6 +15,30 @@ class NanomsgLibrary {
     private static final int NN_DONTWAIT;
     private static final int EAGAIN;
     private static final int AF_SP;
+    private static final int NN_SOL_SOCKET;
+    private static final int NN_RCVTIMEO;
+    private static final int ETIMEDOUT;
+
+    /**
+     * Initial size of the buffer messages are received into. It grows to fit
+     * the largest message received so far.
+     */
+    private static final int RECEIVE_BUFFER_SIZE = 64 * 1024;
+
+    /**
+     * Direct buffer every message is received into, so that receiving does not
+     * allocate. The buffer returned by the receive methods is this one.
+     */
+    private ByteBuffer receiveBuffer = ByteBuffer.allocateDirect(RECEIVE_BUFFER_SIZE);
+
+    /**
+     * Set by nn_recv_direct when a message does not fit {@code receiveBuffer}:
+     * a direct buffer over nanomsg's copy of the message, which must be
+     * released with nn_freemsg_direct.
+     */
+    private ByteBuffer oversizedMessage;
+
+    private int receiveTimeout = -1;
 
     static {
         loadNativeLibrary();
@@ -23,6 +48,9 @@ class NanomsgLibrary {
         NN_DONTWAIT = symbols.get("NN_DONTWAIT") != null ? symbols.get("NN_DONTWAIT") : 1;
         EAGAIN = symbols.get("EAGAIN") != null ? symbols.get("EAGAIN") : 11;
         AF_SP = symbols.get("AF_SP") != null ? symbols.get("AF_SP") : 1;
+        NN_SOL_SOCKET = symbols.get("NN_SOL_SOCKET") != null ? symbols.get("NN_SOL_SOCKET") : 0;
+        NN_RCVTIMEO = symbols.get("NN_RCVTIMEO") != null ? symbols.get("NN_RCVTIMEO") : 5;
+        ETIMEDOUT = symbols.get("ETIMEDOUT") != null ? symbols.get("ETIMEDOUT") : 110;
     }
 
     static void loadNativeLibrary() {
@@ -44,7 +72,11 @@ class NanomsgLibrary {
 
     private native int nn_send(int socket, byte[] buffer, int flags);
 
-    private native byte[] nn_recv(int socket, int flags);
+    private native int nn_recv_direct(int socket, ByteBuffer buffer, int flags);
+
+    private native int nn_freemsg_direct(ByteBuffer message);
+
+    private native int nn_setsockopt(int socket, int level, int option, int value);
 
     private static native Map<String, Integer> getSymbols();
 
@@ -53,6 +85,7 @@ class NanomsgLibrary {
         if (socket < 0) {
             throw new ConnectionException(String.format("Error in nn_socket: %s\n", this.nn_strerror(this.nn_errno())));
         }
+        this.receiveTimeout = -1;
 
         return socket;
     }
@@ -89,18 +122,65 @@ class NanomsgLibrary {
         return true;
     }
 
-    public byte[] receiveMessageNoWait(int socket) throws ConnectionException {
-        byte[] messageBuffer = nn_recv(socket, NN_DONTWAIT);
+    /**
+     * Receives a message if one is available.
+     *
+     * @return The message, in a buffer that is reused by the next receive, or
+     *         {@code null} if no message is available.
+     */
+    public ByteBuffer receiveMessageNoWait(int socket) throws ConnectionException {
+        return this.receive(socket, NN_DONTWAIT);
+    }
+
+    /**
+     * Waits up to {@code timeoutMillis} for a message.
+     *
+     * @return The message, in a buffer that is reused by the next receive, or
+     *         {@code null} if none arrived in time.
+     */
+    public ByteBuffer receiveMessage(int socket, int timeoutMillis) throws ConnectionException {
+        if (timeoutMillis != this.receiveTimeout) {
+            if (this.nn_setsockopt(socket, NN_SOL_SOCKET, NN_RCVTIMEO, timeoutMillis) < 0) {
+                int errn = this.nn_errno();
+                throw new ConnectionException(String.format("Error: %d - %s\n", errn, this.nn_strerror(errn)));
+            }
+            this.receiveTimeout = timeoutMillis;
+        }
+        return this.receive(socket, 0);
+    }
+
+    private ByteBuffer receive(int socket, int flags) throws ConnectionException {
+        int size = this.nn_recv_direct(socket, this.receiveBuffer, flags);
 
-        if (messageBuffer == null) {
+        if (size < 0) {
             int errn = this.nn_errno();
-            if (errn == EAGAIN) {
+            if (errn == EAGAIN || errn == ETIMEDOUT) {
                 return null;
             } else {
                 throw new ConnectionException(String.format("Error: %d - %s\n", errn, this.nn_strerror(errn)));
             }
         }
-        return messageBuffer;
+
+        if (size > this.receiveBuffer.capacity()) {
+            this.growReceiveBuffer(size);
+        }
+
+        this.receiveBuffer.clear();
+        this.receiveBuffer.limit(size);
+        return this.receiveBuffer;
+    }
+
+    private void growReceiveBuffer(int size) {
+        ByteBuffer message = this.oversizedMessage;
+        this.oversizedMessage = null;
+
+        int capacity = this.receiveBuffer.capacity();
+        while (capacity < size && capacity <= Integer.MAX_VALUE / 2) {
+            capacity *= 2;
+        }
+        this.receiveBuffer = ByteBuffer.allocateDirect(Math.max(capacity, size));
+        this.receiveBuffer.put(message);
+        this.nn_freemsg_direct(message);
     }
 
     public void shutdown(int socket, int endpointId) {
@@ -6,8 +6,8 @@ package com.microsoft.azure.gateway.remote;
 
 import java.lang.reflect.Constructor;
 import java.lang.reflect.InvocationTargetException;
+import java.util.concurrent.ExecutorService;
 import java.util.concurrent.Executors;
-import java.util.concurrent.ScheduledExecutorService;
 import java.util.concurrent.TimeUnit;
 
 import org.slf4j.Logger;
@@ -63,11 +63,23 @@ import com.microsoft.azure.gateway.core.IGatewayModule;
  */
 public class ProxyGateway {
 
-    private static final int DEFAULT_DELAY_MILLIS = 10;
+    /**
+     * How long the receive thread blocks waiting for a message before it checks
+     * whether it has been asked to stop, and, while the message channel is
+     * idle, how long a control message can wait to be processed.
+     */
+    private static final int RECEIVE_TIMEOUT_MILLIS = 100;
+
+    /**
+     * Most data messages forwarded per wake before the control channel is
+     * checked again.
+     */
+    private static final int MAX_DATA_MESSAGES_PER_WAKE = 1024;
+
     private final ModuleConfiguration config;
     private final Object lock = new Object();
     private boolean isAttached;
-    private ScheduledExecutorService executor;
+    private ExecutorService executor;
     private MessageListener receiveMessageListener;
 
     public ProxyGateway(ModuleConfiguration configuration) {
@@ -93,9 +105,9 @@ public class ProxyGateway {
             if (!this.isAttached) {
                 //Codes_SRS_JAVA_PROXY_GATEWAY_24_004: [ The function shall instantiate the messages listener task. ]
                 this.receiveMessageListener = new MessageListener(config);
-                //Codes_SRS_JAVA_PROXY_GATEWAY_24_005: [ It shall instantiate a single-threaded executor that can schedule the task to execute periodically. ]
-                this.executor = Executors.newSingleThreadScheduledExecutor();
-                //Codes_SRS_JAVA_PROXY_GATEWAY_24_006: [ It shall start executing the periodic task of listening for messages from the Gateway. ]
+                //Codes_SRS_JAVA_PROXY_GATEWAY_24_005: [ It shall instantiate a single-threaded executor to run the receive loop. ]
+                this.executor = Executors.newSingleThreadExecutor();
+                //Codes_SRS_JAVA_PROXY_GATEWAY_24_006: [ It shall start the receive loop listening for messages from the Gateway on the executor's thread. ]
                 this.startListening();
                 this.isAttached = true;
             }
@@ -113,7 +125,12 @@ public class ProxyGateway {
     }
 
     void startListening() {
-        this.executor.scheduleWithFixedDelay(receiveMessageListener, 0, DEFAULT_DELAY_MILLIS, TimeUnit.MILLISECONDS);
+        this.executor.execute(new Runnable() {
+            @Override
+            public void run() {
+                receiveMessageListener.listen();
+            }
+        });
     }
 
     boolean isAttached() {
@@ -124,7 +141,7 @@ public class ProxyGateway {
         return this.receiveMessageListener;
     }
 
-    ScheduledExecutorService getExecutor() {
+    ExecutorService getExecutor() {
         return this.executor;
     }
 
@@ -164,12 +181,33 @@ public class ProxyGateway {
             this.controlEndpoint.connect();
         }
 
+        /**
+         * The receive loop. Each pass blocks until a message arrives, on the
+         * message channel once it exists and on the control channel before
+         * that, then drains whatever else is already queued on both.
+         */
+        void listen() {
+            while (!Thread.currentThread().isInterrupted()) {
+                this.awaitMessage();
+                this.run();
+            }
+        }
+
         @Override
         public void run() {
             this.executeControlMessage();
             this.executeDataMessage();
         }
 
+        void awaitMessage() {
+            // Codes_SRS_JAVA_PROXY_GATEWAY_26_001: [ *Message Listener task* - It shall block for up to 100 milliseconds waiting for a message on the message channel, or on the control channel while there is no message channel, and process the message received. ]
+            if (this.dataEndpoint != null) {
+                this.receiveDataMessage(RECEIVE_TIMEOUT_MILLIS);
+            } else {
+                this.receiveControlMessage(RECEIVE_TIMEOUT_MILLIS);
+            }
+        }
+
         public void detach(boolean sendDetachToGateway) {
             if (this.module != null)
                 // Codes_SRS_JAVA_PROXY_GATEWAY_24_023: [ *Message Listener task - Destroy message* - If message type is DESTROY, it shall call module `destroy` method. ]
@@ -204,10 +242,15 @@ public class ProxyGateway {
         }
 
         void executeControlMessage() {
+            this.receiveControlMessage(0);
+        }
+
+        private void receiveControlMessage(int timeoutMillis) {
             RemoteMessage message = null;
             try {
                 // Codes_SRS_JAVA_PROXY_GATEWAY_24_010: [ *Message Listener task* - It shall poll the gateway control channel for new messages. ]
-                message = this.controlEndpoint.receiveMessage();
+                message = timeoutMillis > 0 ? this.controlEndpoint.receiveMessage(timeoutMillis)
+                        : this.controlEndpoint.receiveMessage();
             } catch (MessageDeserializationException e) {
                 logger.error(e.toString());
                 // Codes_SRS_JAVA_PROXY_GATEWAY_24_012: [ *Message Listener task* - If a control message is received and deserialization fails it shall send an error message to the Gateway. ]
@@ -255,14 +298,28 @@ public class ProxyGateway {
         }
 
         void executeDataMessage() {
+            // Codes_SRS_JAVA_PROXY_GATEWAY_26_002: [ *Message Listener task - Data message* - It shall forward every data message already received, up to 1024, before checking the control channel again. ]
+            for (int i = 0; i < MAX_DATA_MESSAGES_PER_WAKE; i++) {
+                if (!this.receiveDataMessage(0))
+                    break;
+            }
+        }
+
+        private boolean receiveDataMessage(int timeoutMillis) {
+            boolean received = false;
             try {
                 // Codes_SRS_JAVA_PROXY_GATEWAY_24_025: [ *Message Listener task - Data message* - It shall not check for messages, if the message channel is not available. ]
                 if (this.dataEndpoint != null) {
-                    RemoteMessage dataMessage = this.dataEndpoint.receiveMessage();
+                    RemoteMessage dataMessage = timeoutMillis > 0 ? this.dataEndpoint.receiveMessage(timeoutMillis)
+                            : this.dataEndpoint.receiveMessage();
                     // Codes_SRS_JAVA_PROXY_GATEWAY_24_027: [ *Message Listener task - Data message* - If no data message is received or if an error occurs, it shall do nothing. ]
                     if (dataMessage != null) {
-                        // Codes_SRS_JAVA_PROXY_GATEWAY_24_026: [ *Message Listener task - Data message* - If data message is received, it shall forward it to the module by calling `receive` method. ]
-                        this.module.receive(((DataMessage) dataMessage).getContent());
+                        received = true;
+                        // a module that failed to instantiate leaves the message channel connected
+                        if (this.module != null) {
+                            // Codes_SRS_JAVA_PROXY_GATEWAY_24_026: [ *Message Listener task - Data message* - If data message is received, it shall forward it to the module by calling `receive` method. ]
+                            this.module.receive(((DataMessage) dataMessage).getContent());
+                        }
                     }
                 }
             } catch (ConnectionException e) {
@@ -270,6 +327,7 @@ public class ProxyGateway {
             } catch (MessageDeserializationException e) {
                 logger.error(e.toString());
             }
+            return received;
         }
 
         private void processDestroyMessage() {
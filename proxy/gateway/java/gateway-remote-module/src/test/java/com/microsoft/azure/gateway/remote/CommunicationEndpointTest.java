@@ -5,6 +5,7 @@
 package com.microsoft.azure.gateway.remote;
 
 import static org.junit.Assert.assertFalse;
+import static org.junit.Assert.assertNull;
 import static org.junit.Assert.assertTrue;
 
 import java.nio.ByteBuffer;
@@ -81,8 +82,18 @@ public class CommunicationEndpointTest {
             }
             
             @Mock
-            public byte[] nn_recv(int socket, int flags) {
-                return messageBuffer;
+            int nn_recv_direct(int socket, ByteBuffer buffer, int flags) {
+                if (messageBuffer == null) {
+                    return -1;
+                }
+                buffer.clear();
+                buffer.put(messageBuffer);
+                return messageBuffer.length;
+            }
+
+            @Mock
+            int nn_setsockopt(int socket, int level, int option, int value) {
+                return 0;
             }
 
             @Mock
@@ -153,6 +164,35 @@ public class CommunicationEndpointTest {
         };
     }
 
+    @Test
+    public void receiveMessageWithTimeoutSuccess() throws ConnectionException, MessageDeserializationException {
+        final String identifier = "test";
+
+        messageBuffer = new byte[] { 1, 2, 3 };
+        CommunicationEndpoint endpoint = new NanomsgCommunicationEndpoint(identifier, strategy);
+        endpoint.receiveMessage(100);
+
+        new Verifications() {
+            {
+                strategy.deserializeMessage(ByteBuffer.wrap(messageBuffer), anyByte);
+                times = 1;
+            }
+        };
+    }
+
+    @Test
+    public void receiveMessageWithTimeoutReturnsNullOnTimeout()
+            throws ConnectionException, MessageDeserializationException {
+        final String identifier = "test";
+
+        messageBuffer = null;
+        errorNo = 110;
+        CommunicationEndpoint endpoint = new NanomsgCommunicationEndpoint(identifier, strategy);
+        RemoteMessage message = endpoint.receiveMessage(100);
+
+        assertNull(message);
+    }
+
     @Test
     public void receiveMessageSuccessWithControlChannelNoMessage()
             throws ConnectionException, MessageDeserializationException {
@@ -105,7 +105,7 @@ public class ProxyGatewayTest {
         assertTrue(proxy.isAttached());
     }
     
-    // Tests_SRS_JAVA_PROXY_GATEWAY_24_005: [ It shall instantiate a single-threaded executor that can schedule the task to execute periodically. ]
+    // Tests_SRS_JAVA_PROXY_GATEWAY_24_005: [ It shall instantiate a single-threaded executor to run the receive loop. ]
     @Test
     public void attachShouldInstantiateExecutor(@Mocked final NanomsgCommunicationEndpoint controlEndpoint)
             throws ConnectionException, MessageDeserializationException {
@@ -136,7 +136,7 @@ public class ProxyGatewayTest {
         assertTrue(proxy.isAttached());
     }
     
-    // Tests_SRS_JAVA_PROXY_GATEWAY_24_006: [ It shall start executing the periodic task of listening for messages from the Gateway. ]
+    // Tests_SRS_JAVA_PROXY_GATEWAY_24_006: [ It shall start the receive loop listening for messages from the Gateway on the executor's thread. ]
     @Test
     public void attachShouldCallStartListening(@Mocked final NanomsgCommunicationEndpoint controlEndpoint)
             throws ConnectionException, MessageDeserializationException {
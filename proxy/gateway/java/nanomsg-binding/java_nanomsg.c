@@ -1,6 +1,7 @@
 #include "java_nanomsg.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <nn.h>
 #include <jni.h>
 
@@ -85,38 +86,85 @@ JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn
 }
 
 
-JNIEXPORT jbyteArray JNICALL Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv
-(JNIEnv *env, jobject obj, jint socket, jint flags)
+/*
+ * Receives into the direct ByteBuffer the Java side reuses for every message.
+ * A message that does not fit is handed over in the 'oversizedMessage' field
+ * instead, as a direct ByteBuffer over nanomsg's own copy, which Java releases
+ * with nn_freemsg_direct.
+ */
+JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_1direct
+(JNIEnv *env, jobject obj, jint socket, jobject buffer, jint flags)
 {
-    (void)obj;
     void *buf = NULL;
+    jint result;
     int nbytes = nn_recv(socket, &buf, NN_MSG, flags);
-    jbyteArray result = 0;
-    if (nbytes <= 0) {
-        result = 0;
+    if (nbytes < 0) {
+        result = -1;
     }
     else {
-        result = (*env)->NewByteArray(env, nbytes);
-
-        if (result == NULL) {
-            result = 0;
+        void* address = (*env)->GetDirectBufferAddress(env, buffer);
+        jlong capacity = (*env)->GetDirectBufferCapacity(env, buffer);
+        if (address != NULL && (jlong)nbytes <= capacity) {
+            (void)memcpy(address, buf, nbytes);
+            nn_freemsg(buf);
+            result = nbytes;
         }
         else {
-            (*env)->SetByteArrayRegion(env, result, 0, nbytes, (const jbyte*)buf);
+            jobject message = (*env)->NewDirectByteBuffer(env, buf, nbytes);
             jthrowable exception = (*env)->ExceptionOccurred(env);
-            if (exception) {
-                result = 0;
+            if (message == NULL || exception) {
                 (*env)->ExceptionDescribe(env);
                 (*env)->ExceptionClear(env);
+                nn_freemsg(buf);
+                result = -1;
+            }
+            else {
+                jclass clazz = (*env)->GetObjectClass(env, obj);
+                jfieldID field = (*env)->GetFieldID(env, clazz, "oversizedMessage", "Ljava/nio/ByteBuffer;");
+                exception = (*env)->ExceptionOccurred(env);
+                if (field == NULL || exception) {
+                    (*env)->ExceptionDescribe(env);
+                    (*env)->ExceptionClear(env);
+                    nn_freemsg(buf);
+                    result = -1;
+                }
+                else {
+                    (*env)->SetObjectField(env, obj, field, message);
+                    result = nbytes;
+                }
             }
         }
+    }
+
+    return result;
+}
 
-        nn_freemsg(buf);
+JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1freemsg_1direct
+(JNIEnv *env, jobject obj, jobject message)
+{
+    (void)obj;
+    jint result;
+    void* address = (*env)->GetDirectBufferAddress(env, message);
+    if (address == NULL) {
+        result = -1;
+    }
+    else {
+        result = nn_freemsg(address);
     }
 
     return result;
 }
 
+JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1setsockopt
+(JNIEnv *env, jobject obj, jint socket, jint level, jint option, jint value)
+{
+    (void)env;
+    (void)obj;
+    int optval = value;
+
+    return nn_setsockopt(socket, level, option, &optval, sizeof(optval));
+}
+
 JNIEXPORT jobject JNICALL Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_getSymbols
 (JNIEnv *env, jclass clazz) {
     (void)clazz;
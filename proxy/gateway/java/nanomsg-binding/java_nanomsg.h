@@ -65,11 +65,27 @@ JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn
 
 /*
  * Class:     com_microsoft_azure_gateway_remote_NanomsgLibrary
- * Method:    nn_recv
- * Signature: (II)[B
+ * Method:    nn_recv_direct
+ * Signature: (ILjava/nio/ByteBuffer;I)I
  */
-JNIEXPORT jbyteArray JNICALL Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv
-  (JNIEnv *, jobject, jint, jint);
+JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_1direct
+  (JNIEnv *, jobject, jint, jobject, jint);
+
+/*
+ * Class:     com_microsoft_azure_gateway_remote_NanomsgLibrary
+ * Method:    nn_freemsg_direct
+ * Signature: (Ljava/nio/ByteBuffer;)I
+ */
+JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1freemsg_1direct
+  (JNIEnv *, jobject, jobject);
+
+/*
+ * Class:     com_microsoft_azure_gateway_remote_NanomsgLibrary
+ * Method:    nn_setsockopt
+ * Signature: (IIII)I
+ */
+JNIEXPORT jint JNICALL Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1setsockopt
+  (JNIEnv *, jobject, jint, jint, jint, jint);
 
 /*
  * Class:     com_microsoft_azure_gateway_remote_NanomsgLibrary
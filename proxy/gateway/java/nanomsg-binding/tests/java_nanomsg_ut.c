@@ -113,6 +113,25 @@ void my_DeleteLocalRef(JNIEnv* env, jobject obj)
     free((void*)obj);
 }
 
+MOCK_FUNCTION_WITH_CODE(JNICALL, jfieldID, GetFieldID, JNIEnv*, env, jclass, clazz, const char*, name, const char*, sig);
+jfieldID fieldID = (jfieldID)0x42;
+MOCK_FUNCTION_END(fieldID)
+
+MOCK_FUNCTION_WITH_CODE(JNICALL, void, SetObjectField, JNIEnv*, env, jobject, obj, jfieldID, fieldID, jobject, val);
+MOCK_FUNCTION_END()
+
+MOCK_FUNCTION_WITH_CODE(JNICALL, jobject, NewDirectByteBuffer, JNIEnv*, env, void*, address, jlong, capacity);
+jobject buffer = (jobject)0x42;
+MOCK_FUNCTION_END(buffer)
+
+MOCK_FUNCTION_WITH_CODE(JNICALL, void*, GetDirectBufferAddress, JNIEnv*, env, jobject, buf);
+void* address = (void*)0x42;
+MOCK_FUNCTION_END(address)
+
+MOCK_FUNCTION_WITH_CODE(JNICALL, jlong, GetDirectBufferCapacity, JNIEnv*, env, jobject, buf);
+jlong capacity = 0;
+MOCK_FUNCTION_END(capacity)
+
 MOCK_FUNCTION_WITH_CODE(JNICALL, jthrowable, ExceptionOccurred, JNIEnv*, env);
 MOCK_FUNCTION_END(NULL)
 
@@ -128,15 +147,15 @@ struct JNINativeInterface_ env = {
 
     NULL, NULL, FindClass, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
     NULL, ExceptionOccurred, ExceptionDescribe, ExceptionClear, NULL, NULL, NULL, NULL, NULL, NULL,
-    NULL, NULL, NULL, NULL, NewObject, NULL, NULL, NULL, NULL, GetMethodID,
+    NULL, NULL, NULL, NULL, NewObject, NULL, NULL, GetObjectClass, NULL, GetMethodID,
     CallObjectMethod, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
     NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
     NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
     NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
     NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
     NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    GetFieldID, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+    SetObjectField, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
     NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
     NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
     NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -148,7 +167,7 @@ struct JNINativeInterface_ env = {
     NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
     NULL, NULL, NULL, NULL, SetByteArrayRegion, NULL, NULL, NULL, NULL, NULL,
     NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-    NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+    NULL, NULL, NULL, NULL, NULL, NewDirectByteBuffer, GetDirectBufferAddress, GetDirectBufferCapacity, NULL
 };
 
 #undef ENABLE_MOCKS
@@ -172,6 +191,9 @@ MOCK_FUNCTION_END(len)
 MOCK_FUNCTION_WITH_CODE(, int, nn_send, int, s, const void *, buf, size_t, len, int, flags)
 MOCK_FUNCTION_END(len)
 
+MOCK_FUNCTION_WITH_CODE(, int, nn_setsockopt, int, s, int, level, int, option, const void *, optval, size_t, optvallen)
+MOCK_FUNCTION_END(0)
+
 MOCK_FUNCTION_WITH_CODE(, int, nn_shutdown, int, s, int, how)
 MOCK_FUNCTION_END(0)
 
@@ -212,6 +234,8 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(jint, int32_t);
     REGISTER_UMOCK_ALIAS_TYPE(jclass, void*);
     REGISTER_UMOCK_ALIAS_TYPE(jmethodID, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(jfieldID, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(jlong, int64_t);
     REGISTER_UMOCK_ALIAS_TYPE(jobject, void*);
     REGISTER_UMOCK_ALIAS_TYPE(jstring, void*);
     REGISTER_UMOCK_ALIAS_TYPE(jsize, int);
@@ -500,99 +524,189 @@ TEST_FUNCTION(Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1send_no
     ASSERT_ARE_EQUAL(int32_t, expectedResult, result);
 }
 
-TEST_FUNCTION(Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_success)
+TEST_FUNCTION(Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_1direct_copies_message_into_buffer)
 {
     //Arrange
     umock_c_reset_all_calls();
 
     jobject jObject = (jobject)0x42;
+    jobject jBuffer = (jobject)0x43;
     jint socket = (jint)1;
     jint flags = (jint)1;
-    int expectedResult = 4;
-    void *buf = NULL;
-    STRICT_EXPECTED_CALL(nn_recv(socket, buf, NN_MSG, flags))
-        .SetReturn(expectedResult);
-    STRICT_EXPECTED_CALL(NewByteArray(IGNORED_PTR_ARG, expectedResult))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(SetByteArrayRegion(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0, expectedResult, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(ExceptionOccurred(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    char message[4] = "abc";
+    void* message_ptr = message;
+    char target[8] = { 0 };
+
+    STRICT_EXPECTED_CALL(nn_recv(socket, IGNORED_PTR_ARG, NN_MSG, flags))
+        .CopyOutArgumentBuffer(2, &message_ptr, sizeof(message_ptr))
+        .SetReturn(sizeof(message));
+    STRICT_EXPECTED_CALL(GetDirectBufferAddress(IGNORED_PTR_ARG, jBuffer))
+        .IgnoreArgument(1)
+        .SetReturn(target);
+    STRICT_EXPECTED_CALL(GetDirectBufferCapacity(IGNORED_PTR_ARG, jBuffer))
+        .IgnoreArgument(1)
+        .SetReturn(sizeof(target));
+    STRICT_EXPECTED_CALL(nn_freemsg(message_ptr));
 
     //Act
-    (void)Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv(global_env, jObject, socket, flags);
+    jint result = Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_1direct(global_env, jObject, socket, jBuffer, flags);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int32_t, sizeof(message), result);
+    ASSERT_ARE_EQUAL(char_ptr, message, target);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-TEST_FUNCTION(Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_return_null_if_no_message)
+TEST_FUNCTION(Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_1direct_returns_error_if_no_message)
 {
     //Arrange
     umock_c_reset_all_calls();
 
     jobject jObject = (jobject)0x42;
+    jobject jBuffer = (jobject)0x43;
     jint socket = (jint)1;
     jint flags = (jint)1;
 
-    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
-        .IgnoreAllArguments()
+    STRICT_EXPECTED_CALL(nn_recv(socket, IGNORED_PTR_ARG, NN_MSG, flags))
         .SetReturn(-1);
 
     //Act
-    jbyteArray result = Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv(global_env, jObject, socket, flags);
+    jint result = Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_1direct(global_env, jObject, socket, jBuffer, flags);
 
     //Assert
-    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(int32_t, -1, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-TEST_FUNCTION(Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_return_null_if_bytearray_fails)
+TEST_FUNCTION(Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_1direct_hands_over_oversized_message)
 {
     //Arrange
     umock_c_reset_all_calls();
 
     jobject jObject = (jobject)0x42;
+    jobject jBuffer = (jobject)0x43;
+    jobject jMessage = (jobject)0x44;
     jint socket = (jint)1;
     jint flags = (jint)1;
-    int expectedResult = 4;
-
-    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
-        .IgnoreAllArguments()
-        .SetReturn(expectedResult);
-    STRICT_EXPECTED_CALL(NewByteArray(IGNORED_PTR_ARG, expectedResult))
-        .IgnoreAllArguments()
-        .SetReturn(NULL);
+    char message[4] = "abc";
+    void* message_ptr = message;
+    char target[2] = { 0 };
+
+    STRICT_EXPECTED_CALL(nn_recv(socket, IGNORED_PTR_ARG, NN_MSG, flags))
+        .CopyOutArgumentBuffer(2, &message_ptr, sizeof(message_ptr))
+        .SetReturn(sizeof(message));
+    STRICT_EXPECTED_CALL(GetDirectBufferAddress(IGNORED_PTR_ARG, jBuffer))
+        .IgnoreArgument(1)
+        .SetReturn(target);
+    STRICT_EXPECTED_CALL(GetDirectBufferCapacity(IGNORED_PTR_ARG, jBuffer))
+        .IgnoreArgument(1)
+        .SetReturn(sizeof(target));
+    STRICT_EXPECTED_CALL(NewDirectByteBuffer(IGNORED_PTR_ARG, message_ptr, sizeof(message)))
+        .IgnoreArgument(1)
+        .SetReturn(jMessage);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(GetObjectClass(IGNORED_PTR_ARG, jObject))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(GetFieldID(IGNORED_PTR_ARG, IGNORED_PTR_ARG, "oversizedMessage", "Ljava/nio/ByteBuffer;"))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(ExceptionOccurred(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(SetObjectField(IGNORED_PTR_ARG, jObject, IGNORED_PTR_ARG, jMessage))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3);
 
     //Act
-    jbyteArray result = Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv(global_env, jObject, socket, flags);
+    jint result = Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_1direct(global_env, jObject, socket, jBuffer, flags);
 
     //Assert
-    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(int32_t, sizeof(message), result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-TEST_FUNCTION(Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_return_null_if_setbytearray_fails)
+TEST_FUNCTION(Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_1direct_frees_oversized_message_if_wrapping_fails)
 {
     //Arrange
     umock_c_reset_all_calls();
 
     jobject jObject = (jobject)0x42;
+    jobject jBuffer = (jobject)0x43;
     jint socket = (jint)1;
     jint flags = (jint)1;
-    int expectedResult = 4;
-    jthrowable exception = (jthrowable)0x42;
-
-    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
-        .IgnoreAllArguments()
-        .SetReturn(expectedResult);
-    STRICT_EXPECTED_CALL(NewByteArray(IGNORED_PTR_ARG, expectedResult))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(SetByteArrayRegion(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0, expectedResult, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
+    char message[4] = "abc";
+    void* message_ptr = message;
+    char target[2] = { 0 };
+
+    STRICT_EXPECTED_CALL(nn_recv(socket, IGNORED_PTR_ARG, NN_MSG, flags))
+        .CopyOutArgumentBuffer(2, &message_ptr, sizeof(message_ptr))
+        .SetReturn(sizeof(message));
+    STRICT_EXPECTED_CALL(GetDirectBufferAddress(IGNORED_PTR_ARG, jBuffer))
+        .IgnoreArgument(1)
+        .SetReturn(target);
+    STRICT_EXPECTED_CALL(GetDirectBufferCapacity(IGNORED_PTR_ARG, jBuffer))
+        .IgnoreArgument(1)
+        .SetReturn(sizeof(target));
+    STRICT_EXPECTED_CALL(NewDirectByteBuffer(IGNORED_PTR_ARG, message_ptr, sizeof(message)))
+        .IgnoreArgument(1)
+        .SetReturn(NULL);
     STRICT_EXPECTED_CALL(ExceptionOccurred(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(ExceptionDescribe(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(ExceptionClear(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(nn_freemsg(message_ptr));
+
+    //Act
+    jint result = Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv_1direct(global_env, jObject, socket, jBuffer, flags);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int32_t, -1, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1freemsg_1direct_success)
+{
+    //Arrange
+    umock_c_reset_all_calls();
+
+    jobject jObject = (jobject)0x42;
+    jobject jMessage = (jobject)0x44;
+    void* message_ptr = (void*)0x45;
+
+    STRICT_EXPECTED_CALL(GetDirectBufferAddress(IGNORED_PTR_ARG, jMessage))
         .IgnoreArgument(1)
-        .SetReturn(exception);
+        .SetReturn(message_ptr);
+    STRICT_EXPECTED_CALL(nn_freemsg(message_ptr));
+
+    //Act
+    jint result = Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1freemsg_1direct(global_env, jObject, jMessage);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int32_t, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1setsockopt_success)
+{
+    //Arrange
+    umock_c_reset_all_calls();
+
+    jobject jObject = (jobject)0x42;
+    jint socket = (jint)1;
+    jint level = (jint)0;
+    jint option = (jint)5;
+    jint value = (jint)100;
+
+    STRICT_EXPECTED_CALL(nn_setsockopt(socket, level, option, IGNORED_PTR_ARG, sizeof(int)));
 
     //Act
-    jbyteArray result = Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1recv(global_env, jObject, socket, flags);
+    jint result = Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_nn_1setsockopt(global_env, jObject, socket, level, option, value);
 
     //Assert
-    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(int32_t, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
 TEST_FUNCTION(Java_com_microsoft_azure_gateway_remote_NanomsgLibrary_getSymbols_success)
@@ -4,6 +4,8 @@
 #ifndef REMOTE_MODULE_H
 #define REMOTE_MODULE_H
 
+#include <stdbool.h>
+
 #include "azure_c_shared_utility/macro_utils.h"
 
 #include "gateway_export.h"
@@ -15,6 +17,17 @@
 
 typedef struct REMOTE_MODULE_TAG * REMOTE_MODULE_HANDLE;
 
+/*!
+ * \brief Routes messages published inside the remote process
+ *
+ * \param context [in] The context given to `ProxyGateway_SetPublishRouter`
+ * \param source [in] The module that published the message
+ * \param message [in] The published message
+ *
+ * \return `true` if the message shall also be sent to the Azure IoT Gateway
+ */
+typedef bool (*PROXY_GATEWAY_PUBLISH_ROUTER)(void * context, MODULE_HANDLE source, MESSAGE_HANDLE message);
+
 #include "azure_c_shared_utility/umock_c_prod.h"
 
 /*!
@@ -100,6 +113,26 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, ProxyGateway_HaltWorkerThread, REMOTE_MO
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, ProxyGateway_StartWorkerThread, REMOTE_MODULE_HANDLE, remote_module);
 
+/*!
+ * \brief Route messages published by modules inside the remote process
+ *
+ * `ProxyGateway_SetPublishRouter` lets a module host that runs several modules
+ * in one process deliver messages between them without a round trip through
+ * the Azure IoT Gateway. Once a router is set, every `Broker_Publish` on the
+ * given broker is first handed to the router, and the message is only sent to
+ * the Azure IoT Gateway when the router returns `true`.
+ *
+ * \param broker [in] The broker handle given to the remote module's `Module_Create`
+ * \param router [in] The router, or `NULL` to send every message to the gateway
+ * \param context [in] A value passed to each call of `router`
+ *
+ * \return A result value. 0 indicating success or failure otherwise
+ *
+ * \note The router is called on the publishing thread and must be removed before
+ *       the context it uses is destroyed.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, ProxyGateway_SetPublishRouter, BROKER_HANDLE, broker, PROXY_GATEWAY_PUBLISH_ROUTER, router, void *, context);
+
 #ifdef __cplusplus
   }
 #endif
@@ -18,6 +18,7 @@
 
 #include "control_message.h"
 #include "gateway.h"
+#include "gateway_probes.h"
 #include "message.h"
 
 typedef enum REMOTE_MODULE_RESULT_TAG {
@@ -76,6 +77,8 @@ typedef struct REMOTE_MODULE_TAG {
     int message_socket;
     MESSAGE_THREAD_HANDLE message_thread;
     MODULE module;
+    PROXY_GATEWAY_PUBLISH_ROUTER publish_router;
+    void * publish_router_context;
 } REMOTE_MODULE;
 
 static size_t strnlen_(const char* s, size_t max)
@@ -223,6 +226,7 @@ void
 ProxyGateway_DoWork (
     REMOTE_MODULE_HANDLE remote_module
 ) {
+    GATEWAY_PROBE1(proxy_dowork_entry, remote_module);
     if (NULL == remote_module) {
         /* Codes_SRS_PROXY_GATEWAY_027_026: [Prerequisite Check - If the `remote_module` parameter is `NULL`, then `ProxyGateway_DoWork` shall do nothing] */
         LogError("%s: NULL parameter - remote_module!", __FUNCTION__);
@@ -301,7 +305,9 @@ ProxyGateway_DoWork (
                     LogError("%s: Unable to parse control message!", __FUNCTION__);
                 } else {
                     /* Codes_SRS_PROXY_GATEWAY_027_042: [Message Channel - `ProxyGateway_DoWork` shall pass the structured message to the module by calling `void Module_Receive(MODULE_HANDLE moduleHandle)` using the parsed message as `moduleHandle`] */
+                    GATEWAY_PROBE3(module_receive_start, remote_module->module.module_handle, structured_module_message, bytes_received);
                     ((MODULE_API_1 *)remote_module->module.module_apis)->Module_Receive(remote_module->module.module_handle, structured_module_message);
+                    GATEWAY_PROBE2(module_receive_end, remote_module->module.module_handle, structured_module_message);
                     /* Codes_SRS_PROXY_GATEWAY_027_043: [Message Channel - `ProxyGateway_DoWork` shall free the resources held by the parsed module message by calling `void Message_Destroy(MESSAGE_HANDLE * message)` using the parsed module message as `message`] */
                     Message_Destroy(structured_module_message);
                 }
@@ -311,6 +317,7 @@ ProxyGateway_DoWork (
         }
     }
 
+    GATEWAY_PROBE1(proxy_dowork_return, remote_module);
     return;
 }
 
@@ -415,6 +422,31 @@ ProxyGateway_StartWorkerThread (
 }
 
 
+int
+ProxyGateway_SetPublishRouter (
+    BROKER_HANDLE broker,
+    PROXY_GATEWAY_PUBLISH_ROUTER router,
+    void * context
+) {
+    int result;
+
+    if (NULL == broker) {
+        /* Codes_SRS_PROXY_GATEWAY_027_067: [Prerequisite Check - If the `broker` parameter is `NULL`, then `ProxyGateway_SetPublishRouter` shall do nothing and return a non-zero value] */
+        LogError("%s: NULL parameter - broker!", __FUNCTION__);
+        result = __LINE__;
+    } else {
+        REMOTE_MODULE_HANDLE remote_module = (REMOTE_MODULE_HANDLE)broker;
+
+        /* Codes_SRS_PROXY_GATEWAY_027_068: [`ProxyGateway_SetPublishRouter` shall store `router` and `context`, replacing any previous router, and return zero] */
+        remote_module->publish_router = router;
+        remote_module->publish_router_context = context;
+        result = 0;
+    }
+
+    return result;
+}
+
+
 /* Codes_SRS_BROKER_17_022: [ N/A - Broker_Publish shall Lock the modules lock. ] */
 /* Codes_SRS_BROKER_17_023: [ N/A - Broker_Publish shall Unlock the modules lock. ] */
 /* Codes_SRS_BROKER_17_026: [ N/A - Broker_Publish shall copy source into the beginning of the nanomsg buffer. ] */
@@ -424,7 +456,6 @@ Broker_Publish (
     MODULE_HANDLE source,
     MESSAGE_HANDLE message
 ) {
-    (void)source;
     REMOTE_MODULE_HANDLE remote_module = (REMOTE_MODULE_HANDLE)broker;
     BROKER_RESULT result;
 
@@ -434,6 +465,12 @@ Broker_Publish (
         result = BROKER_INVALIDARG;
         LogError("Broker handle and/or message handle is NULL");
     }
+    /* Codes_SRS_PROXY_GATEWAY_027_069: [If a publish router is set, `Broker_Publish` shall call it with the router context, `source` and `message`] */
+    else if (NULL != remote_module->publish_router && !remote_module->publish_router(remote_module->publish_router_context, source, message))
+    {
+        /* Codes_SRS_PROXY_GATEWAY_027_070: [If the publish router returns `false`, `Broker_Publish` shall not send the message to the gateway and shall return BROKER_OK] */
+        result = BROKER_OK;
+    }
     else
     {
         // Send message_ to nanomsg
@@ -433,6 +433,9 @@ MOCK_FUNCTION_END()
 MOCK_FUNCTION_WITH_CODE(, void, mock_start, MODULE_HANDLE, moduleHandle)
 MOCK_FUNCTION_END()
 
+MOCK_FUNCTION_WITH_CODE(, bool, mock_publish_router, void *, context, MODULE_HANDLE, source, MESSAGE_HANDLE, message)
+MOCK_FUNCTION_END(false)
+
 
 static const MODULE_API_1 MOCK_MODULE_APIS = {
     { MODULE_API_VERSION_1 },
@@ -2570,6 +2573,88 @@ TEST_FUNCTION(publish_SCENARIO_create_message_success)
     ProxyGateway_Detach(remote_module);
 }
 
+/* Tests_SRS_PROXY_GATEWAY_027_067: [Prerequisite Check - If the `broker` parameter is `NULL`, then `ProxyGateway_SetPublishRouter` shall do nothing and return a non-zero value] */
+TEST_FUNCTION(ProxyGateway_SetPublishRouter_SCENARIO_NULL_broker)
+{
+    // Arrange
+    int result;
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+
+    // Act
+    result = ProxyGateway_SetPublishRouter(NULL, mock_publish_router, NULL);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // Cleanup
+}
+
+/* Tests_SRS_PROXY_GATEWAY_027_068: [`ProxyGateway_SetPublishRouter` shall store `router` and `context`, replacing any previous router, and return zero] */
+/* Tests_SRS_PROXY_GATEWAY_027_069: [If a publish router is set, `Broker_Publish` shall call it with the router context, `source` and `message`] */
+/* Tests_SRS_PROXY_GATEWAY_027_070: [If the publish router returns `false`, `Broker_Publish` shall not send the message to the gateway and shall return BROKER_OK] */
+TEST_FUNCTION(Broker_Publish_SCENARIO_router_keeps_message_local)
+{
+    // Arrange
+    int result;
+    BROKER_RESULT publish_result;
+    void * ROUTER_CONTEXT = (void *)0x1234;
+    MESSAGE_HANDLE MESSAGE = (MESSAGE_HANDLE)0x5678;
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+    result = ProxyGateway_SetPublishRouter((BROKER_HANDLE)remote_module, mock_publish_router, ROUTER_CONTEXT);
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(mock_publish_router(ROUTER_CONTEXT, MOCK_MODULE, MESSAGE))
+        .SetReturn(false);
+
+    // Act
+    publish_result = Broker_Publish((BROKER_HANDLE)remote_module, MOCK_MODULE, MESSAGE);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, BROKER_OK, publish_result);
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
+/* Tests_SRS_PROXY_GATEWAY_027_069: [If a publish router is set, `Broker_Publish` shall call it with the router context, `source` and `message`] */
+TEST_FUNCTION(Broker_Publish_SCENARIO_router_forwards_message)
+{
+    // Arrange
+    int result;
+    void * ROUTER_CONTEXT = (void *)0x1234;
+    MESSAGE_HANDLE MESSAGE = (MESSAGE_HANDLE)0x5678;
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+    result = ProxyGateway_SetPublishRouter((BROKER_HANDLE)remote_module, mock_publish_router, ROUTER_CONTEXT);
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(mock_publish_router(ROUTER_CONTEXT, MOCK_MODULE, MESSAGE))
+        .SetReturn(true);
+    STRICT_EXPECTED_CALL(Message_Clone(MESSAGE))
+        .SetReturn(MESSAGE);
+    STRICT_EXPECTED_CALL(Message_ToByteArray(MESSAGE, NULL, 0))
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(Message_Destroy(MESSAGE));
+
+    // Act
+    (void)Broker_Publish((BROKER_HANDLE)remote_module, MOCK_MODULE, MESSAGE);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
 
 /* SRS_PROXY_GATEWAY_027_0xx: [`worker_thread` shall obtain the thread mutex in order to initialize the thread by calling `LOCK_RESULT Lock(LOCK_HANDLE handle)`] */
 /* SRS_PROXY_GATEWAY_027_0xx: [If unable to obtain the mutex, then `worker_thread` shall return a non-zero value] */
@@ -0,0 +1,87 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       local_broker.h
+ *  @brief      In-process message routing for modules co-hosted by the native
+ *              module host.
+ *
+ *  @details    The local broker delivers messages between the modules of a
+ *              sub-graph that run in the same remote process. Links are added
+ *              between module handles; a @c NULL source stands for messages
+ *              arriving from the gateway and a @c NULL sink for messages that
+ *              must be sent back to the gateway. All local deliveries run on a
+ *              single dispatch thread, so each hosted module sees its
+ *              messages in publish order and never concurrently.
+ */
+
+#ifndef LOCAL_BROKER_H
+#define LOCAL_BROKER_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#include "module.h"
+#include "message.h"
+
+#ifdef __cplusplus
+#include <cstdbool>
+extern "C"
+{
+#else
+#include <stdbool.h>
+#endif
+
+typedef struct LOCAL_BROKER_TAG* LOCAL_BROKER_HANDLE;
+
+/** @brief      Creates a local broker with no links.
+ *
+ *  @return     A valid #LOCAL_BROKER_HANDLE on success, @c NULL otherwise.
+ */
+MOCKABLE_FUNCTION(, LOCAL_BROKER_HANDLE, LocalBroker_Create);
+
+/** @brief      Stops the dispatch thread, if running, and frees the broker
+ *              along with any messages still waiting for delivery.
+ */
+MOCKABLE_FUNCTION(, void, LocalBroker_Destroy, LOCAL_BROKER_HANDLE, broker);
+
+/** @brief      Routes messages published by @c source to @c sink.
+ *
+ *  @param      broker      The local broker.
+ *  @param      source      The publishing module, or @c NULL for messages
+ *                          received from the gateway.
+ *  @param      sink        The receiving module, copied by the broker, or
+ *                          @c NULL to send the messages to the gateway.
+ *
+ *  @return     0 on success, non-zero if both ends are the gateway, on
+ *              allocation failure or once the broker has been started.
+ */
+MOCKABLE_FUNCTION(, int, LocalBroker_AddLink, LOCAL_BROKER_HANDLE, broker, MODULE_HANDLE, source, const MODULE*, sink);
+
+/** @brief      Starts the dispatch thread. Messages published before the
+ *              broker is started are delivered once it starts.
+ *
+ *  @return     0 on success, non-zero otherwise.
+ */
+MOCKABLE_FUNCTION(, int, LocalBroker_Start, LOCAL_BROKER_HANDLE, broker);
+
+/** @brief      Stops the dispatch thread and waits for it to exit. Messages
+ *              published after this call are dropped.
+ */
+MOCKABLE_FUNCTION(, void, LocalBroker_Stop, LOCAL_BROKER_HANDLE, broker);
+
+/** @brief      Queues @c message for every module linked from @c source.
+ *
+ *  @param      broker      The local broker.
+ *  @param      source      The publishing module, or @c NULL for messages
+ *                          received from the gateway.
+ *  @param      message     The message; the broker keeps its own clone.
+ *
+ *  @return     @c true if @c source is also linked to the gateway and the
+ *              caller must send the message there, @c false otherwise.
+ */
+MOCKABLE_FUNCTION(, bool, LocalBroker_Publish, LOCAL_BROKER_HANDLE, broker, MODULE_HANDLE, source, MESSAGE_HANDLE, message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOCAL_BROKER_H */
@@ -8,6 +8,9 @@
 #define OOP_MODULE_LOADERS_ARRAY_KEY "outprocess.loaders"
 #define OOP_MODULE_LOADER_KEY "outprocess.loader"
 #define OOP_MODULE_ARGS_KEY "module.args"
+#define OOP_MODULE_MODULES_ARRAY_KEY "outprocess.modules"
+#define OOP_MODULE_LINKS_ARRAY_KEY "outprocess.links"
+#define OOP_MODULE_GATEWAY_LINK_ENDPOINT "$gateway"
 
 #ifdef __cplusplus
 extern "C"
@@ -0,0 +1,353 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+
+#include "module.h"
+#include "module_access.h"
+#include "message.h"
+#include "local_broker.h"
+
+typedef struct LOCAL_LINK_TAG
+{
+    MODULE_HANDLE source;
+    /* a NULL module handle means the sink is the gateway */
+    MODULE_DISPATCH sink;
+} LOCAL_LINK;
+
+typedef struct LOCAL_DELIVERY_TAG
+{
+    MODULE_HANDLE source;
+    MESSAGE_HANDLE message;
+    struct LOCAL_DELIVERY_TAG* next;
+} LOCAL_DELIVERY;
+
+typedef struct LOCAL_BROKER_TAG
+{
+    LOCK_HANDLE lock;
+    COND_HANDLE queue_condition;
+    LOCAL_LINK* links;
+    size_t link_count;
+    LOCAL_DELIVERY* queue_head;
+    LOCAL_DELIVERY* queue_tail;
+    THREAD_HANDLE dispatch_thread;
+    bool started;
+    bool stopping;
+} LOCAL_BROKER;
+
+static void destroy_queue(LOCAL_BROKER* broker)
+{
+    while (broker->queue_head != NULL)
+    {
+        LOCAL_DELIVERY* delivery = broker->queue_head;
+        broker->queue_head = delivery->next;
+        Message_Destroy(delivery->message);
+        free(delivery);
+    }
+    broker->queue_tail = NULL;
+}
+
+static LOCAL_DELIVERY* get_next_delivery(LOCAL_BROKER* broker)
+{
+    LOCAL_DELIVERY* result;
+    if (Lock(broker->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the local broker");
+        result = NULL;
+    }
+    else
+    {
+        while (broker->queue_head == NULL && !broker->stopping)
+        {
+            (void)Condition_Wait(broker->queue_condition, broker->lock, 0);
+        }
+
+        if (broker->stopping)
+        {
+            result = NULL;
+        }
+        else
+        {
+            result = broker->queue_head;
+            broker->queue_head = result->next;
+            if (broker->queue_head == NULL)
+            {
+                broker->queue_tail = NULL;
+            }
+        }
+        (void)Unlock(broker->lock);
+    }
+    return result;
+}
+
+static int dispatch_thread(void* param)
+{
+    LOCAL_BROKER* broker = (LOCAL_BROKER*)param;
+    LOCAL_DELIVERY* delivery;
+
+    /*Codes_SRS_LOCAL_BROKER_26_016: [ The dispatch thread shall wait for queued messages until the broker is stopped. ]*/
+    while ((delivery = get_next_delivery(broker)) != NULL)
+    {
+        /* links are fixed once the broker is started, so they are read without the lock */
+        for (size_t i = 0; i < broker->link_count; i++)
+        {
+            LOCAL_LINK* link = &broker->links[i];
+            if (link->source == delivery->source && link->sink.module_handle != NULL && link->sink.receive != NULL)
+            {
+                /*Codes_SRS_LOCAL_BROKER_26_017: [ The dispatch thread shall deliver each message to every module linked from its source, in link order, by calling the module's Module_Receive. ]*/
+                MODULE_DISPATCH_RECEIVE(link->sink, delivery->message);
+            }
+        }
+        /*Codes_SRS_LOCAL_BROKER_26_018: [ The dispatch thread shall destroy each message once it has been delivered. ]*/
+        Message_Destroy(delivery->message);
+        free(delivery);
+    }
+
+    return 0;
+}
+
+LOCAL_BROKER_HANDLE LocalBroker_Create(void)
+{
+    /*Codes_SRS_LOCAL_BROKER_26_001: [ LocalBroker_Create shall allocate a local broker with no links and an empty queue. ]*/
+    LOCAL_BROKER* result = (LOCAL_BROKER*)malloc(sizeof(LOCAL_BROKER));
+    if (result == NULL)
+    {
+        /*Codes_SRS_LOCAL_BROKER_26_002: [ LocalBroker_Create shall return NULL if any underlying call fails. ]*/
+        LogError("unable to allocate the local broker");
+    }
+    else
+    {
+        result->links = NULL;
+        result->link_count = 0;
+        result->queue_head = NULL;
+        result->queue_tail = NULL;
+        result->dispatch_thread = NULL;
+        result->started = false;
+        result->stopping = false;
+
+        /*Codes_SRS_LOCAL_BROKER_26_003: [ LocalBroker_Create shall create a lock and a condition to guard the queue. ]*/
+        result->lock = Lock_Init();
+        if (result->lock == NULL)
+        {
+            /*Codes_SRS_LOCAL_BROKER_26_002: [ LocalBroker_Create shall return NULL if any underlying call fails. ]*/
+            LogError("unable to create the local broker lock");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->queue_condition = Condition_Init();
+            if (result->queue_condition == NULL)
+            {
+                /*Codes_SRS_LOCAL_BROKER_26_002: [ LocalBroker_Create shall return NULL if any underlying call fails. ]*/
+                LogError("unable to create the local broker condition");
+                (void)Lock_Deinit(result->lock);
+                free(result);
+                result = NULL;
+            }
+        }
+    }
+    return result;
+}
+
+void LocalBroker_Destroy(LOCAL_BROKER_HANDLE broker)
+{
+    /*Codes_SRS_LOCAL_BROKER_26_004: [ LocalBroker_Destroy shall do nothing if broker is NULL. ]*/
+    if (broker != NULL)
+    {
+        /*Codes_SRS_LOCAL_BROKER_26_005: [ LocalBroker_Destroy shall stop the dispatch thread if it is running. ]*/
+        LocalBroker_Stop(broker);
+        /*Codes_SRS_LOCAL_BROKER_26_006: [ LocalBroker_Destroy shall destroy every message still queued and free all resources. ]*/
+        destroy_queue(broker);
+        Condition_Deinit(broker->queue_condition);
+        (void)Lock_Deinit(broker->lock);
+        free(broker->links);
+        free(broker);
+    }
+}
+
+int LocalBroker_AddLink(LOCAL_BROKER_HANDLE broker, MODULE_HANDLE source, const MODULE* sink)
+{
+    int result;
+    if (broker == NULL || (source == NULL && (sink == NULL || sink->module_handle == NULL)))
+    {
+        /*Codes_SRS_LOCAL_BROKER_26_007: [ LocalBroker_AddLink shall fail if broker is NULL or if both source and sink are the gateway. ]*/
+        LogError("invalid arguments broker=[%p], source=[%p], sink=[%p]", broker, source, sink);
+        result = __LINE__;
+    }
+    else if (sink != NULL && sink->module_handle != NULL && sink->module_apis == NULL)
+    {
+        /*Codes_SRS_LOCAL_BROKER_26_008: [ LocalBroker_AddLink shall fail if sink has no MODULE_API. ]*/
+        LogError("sink module [%p] has no module API", sink->module_handle);
+        result = __LINE__;
+    }
+    else if (broker->started)
+    {
+        /*Codes_SRS_LOCAL_BROKER_26_009: [ LocalBroker_AddLink shall fail once the broker has been started. ]*/
+        LogError("links cannot be added to a started local broker");
+        result = __LINE__;
+    }
+    else if (Lock(broker->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the local broker");
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_LOCAL_BROKER_26_010: [ LocalBroker_AddLink shall append a copy of the link to the broker's links. ]*/
+        LOCAL_LINK* links = (LOCAL_LINK*)realloc(broker->links, (broker->link_count + 1) * sizeof(LOCAL_LINK));
+        if (links == NULL)
+        {
+            LogError("unable to grow the local broker links");
+            result = __LINE__;
+        }
+        else
+        {
+            LOCAL_LINK* link = &links[broker->link_count];
+            link->source = source;
+            if (sink == NULL)
+            {
+                link->sink.receive = NULL;
+                link->sink.module_handle = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_LOCAL_BROKER_26_023: [ LocalBroker_AddLink shall resolve the sink's Module_Receive function once, when the link is added. ]*/
+                MODULE_DISPATCH_INIT(link->sink, sink->module_apis, sink->module_handle);
+            }
+            broker->links = links;
+            broker->link_count++;
+            result = 0;
+        }
+        (void)Unlock(broker->lock);
+    }
+    return result;
+}
+
+int LocalBroker_Start(LOCAL_BROKER_HANDLE broker)
+{
+    int result;
+    if (broker == NULL)
+    {
+        /*Codes_SRS_LOCAL_BROKER_26_011: [ LocalBroker_Start shall fail if broker is NULL. ]*/
+        LogError("broker is NULL");
+        result = __LINE__;
+    }
+    else if (broker->started)
+    {
+        /*Codes_SRS_LOCAL_BROKER_26_012: [ LocalBroker_Start shall do nothing and succeed if the broker is already started. ]*/
+        result = 0;
+    }
+    /*Codes_SRS_LOCAL_BROKER_26_013: [ LocalBroker_Start shall start the dispatch thread. ]*/
+    else if (ThreadAPI_Create(&broker->dispatch_thread, dispatch_thread, broker) != THREADAPI_OK)
+    {
+        LogError("unable to start the local broker dispatch thread");
+        broker->dispatch_thread = NULL;
+        result = __LINE__;
+    }
+    else
+    {
+        broker->started = true;
+        result = 0;
+    }
+    return result;
+}
+
+void LocalBroker_Stop(LOCAL_BROKER_HANDLE broker)
+{
+    if (broker == NULL)
+    {
+        LogError("broker is NULL");
+    }
+    else if (Lock(broker->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the local broker");
+    }
+    else
+    {
+        /*Codes_SRS_LOCAL_BROKER_26_014: [ LocalBroker_Stop shall signal the dispatch thread to stop and wait for it to exit. ]*/
+        broker->stopping = true;
+        (void)Condition_Post(broker->queue_condition);
+        (void)Unlock(broker->lock);
+
+        if (broker->dispatch_thread != NULL)
+        {
+            int thread_result;
+            (void)ThreadAPI_Join(broker->dispatch_thread, &thread_result);
+            broker->dispatch_thread = NULL;
+        }
+    }
+}
+
+bool LocalBroker_Publish(LOCAL_BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE message)
+{
+    bool forward = false;
+    if (broker == NULL || message == NULL)
+    {
+        /*Codes_SRS_LOCAL_BROKER_26_019: [ LocalBroker_Publish shall return false if broker or message is NULL. ]*/
+        LogError("invalid arguments broker=[%p], message=[%p]", broker, message);
+    }
+    else if (Lock(broker->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the local broker");
+    }
+    else
+    {
+        bool deliver_locally = false;
+        for (size_t i = 0; i < broker->link_count; i++)
+        {
+            if (broker->links[i].source == source)
+            {
+                if (broker->links[i].sink.module_handle == NULL)
+                {
+                    /*Codes_SRS_LOCAL_BROKER_26_020: [ LocalBroker_Publish shall return true if source is linked to the gateway. ]*/
+                    forward = true;
+                }
+                else
+                {
+                    deliver_locally = true;
+                }
+            }
+        }
+
+        /*Codes_SRS_LOCAL_BROKER_26_021: [ LocalBroker_Publish shall drop messages published after the broker has been stopped. ]*/
+        if (deliver_locally && !broker->stopping)
+        {
+            /*Codes_SRS_LOCAL_BROKER_26_022: [ If source is linked to any hosted module, LocalBroker_Publish shall queue a clone of message once and signal the dispatch thread. ]*/
+            LOCAL_DELIVERY* delivery = (LOCAL_DELIVERY*)malloc(sizeof(LOCAL_DELIVERY));
+            if (delivery == NULL)
+            {
+                LogError("unable to allocate a local delivery");
+            }
+            else if ((delivery->message = Message_Clone(message)) == NULL)
+            {
+                LogError("unable to clone message [%p]", message);
+                free(delivery);
+            }
+            else
+            {
+                delivery->source = source;
+                delivery->next = NULL;
+                if (broker->queue_tail == NULL)
+                {
+                    broker->queue_head = delivery;
+                }
+                else
+                {
+                    broker->queue_tail->next = delivery;
+                }
+                broker->queue_tail = delivery;
+                (void)Condition_Post(broker->queue_condition);
+            }
+        }
+        (void)Unlock(broker->lock);
+    }
+    return forward;
+}
@@ -1,10 +1,13 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
 
 #include "gateway.h"
 #include "broker.h"
@@ -15,12 +18,20 @@
 #include "module_access.h"
 #include "module_loaders/dynamic_loader.h"
 #include "native_module_host.h"
+#include "local_broker.h"
+#include "proxy_gateway.h"
 #include "parson.h"
 
 
 #define LOADER_NAME_KEY "name"
 #define LOADER_ENTRYPOINT_KEY "entrypoint"
+#define HOSTED_MODULE_NAME_KEY "name"
+#define HOSTED_MODULE_LOADER_KEY "loader"
+#define HOSTED_MODULE_ARGS_KEY "args"
+#define HOSTED_LINK_SOURCE_KEY "source"
+#define HOSTED_LINK_SINK_KEY "sink"
 
+typedef struct HOSTED_MODULE_TAG HOSTED_MODULE;
 
 typedef struct MODULE_HOST_TAG
 {
@@ -28,8 +39,22 @@ typedef struct MODULE_HOST_TAG
     const MODULE_LOADER* module_loader;
     MODULE_HANDLE module;
     BROKER_HANDLE module_host_broker;
+    /* resolved once in module_create so Receive does not go through the loader */
+    MODULE_DISPATCH dispatch;
+
+    /* set when the host runs a sub-graph of modules instead of a single module */
+    HOSTED_MODULE* hosted_modules;
+    size_t hosted_module_count;
+    LOCAL_BROKER_HANDLE local_broker;
 } MODULE_HOST;
 
+struct HOSTED_MODULE_TAG
+{
+    char* name;
+    MODULE_HOST host;
+    MODULE module;
+};
+
 static void* NativeModuleHost_ParseConfigurationFromJson(const char* configuration)
 {
     char* config_str;
@@ -170,7 +195,9 @@ static int module_create(MODULE_HOST * module_host, BROKER_HANDLE broker, GATEWA
                     /*Codes_SRS_NATIVEMODULEHOST_17_025: [ NativeModuleHost_Create shall return a non-null pointer to a MODULE_HANDLE on success. ]*/
                     module_host->module_loader = gw_loader_info->loader;
                     module_host->module_host_broker = broker;
-                        
+                    /*Codes_SRS_NATIVEMODULEHOST_26_018: [ NativeModuleHost_Create shall cache the module's _Receive function and handle in a dispatch record. ]*/
+                    MODULE_DISPATCH_INIT(module_host->dispatch, module_apis, module_host->module);
+
                     result = 0;
                 }
                 /*Codes_SRS_NATIVEMODULEHOST_17_024: [ NativeModuleHost_Create shall free all resources used during module loading. ]*/
@@ -182,6 +209,202 @@ static int module_create(MODULE_HOST * module_host, BROKER_HANDLE broker, GATEWA
     return result;
 }
 
+// forward definitions
+static void module_graph_destroy(MODULE_HOST * module_host);
+
+static HOSTED_MODULE* find_hosted_module(MODULE_HOST * module_host, const char * name)
+{
+    HOSTED_MODULE* result = NULL;
+    for (size_t i = 0; i < module_host->hosted_module_count; i++)
+    {
+        if (strcmp(module_host->hosted_modules[i].name, name) == 0)
+        {
+            result = &module_host->hosted_modules[i];
+            break;
+        }
+    }
+    return result;
+}
+
+static int hosted_module_create(HOSTED_MODULE * hosted_module, BROKER_HANDLE broker, JSON_Object * module_json)
+{
+    int result;
+
+    /*Codes_SRS_NATIVEMODULEHOST_26_003: [ For each entry of "outprocess.modules", NativeModuleHost_Create shall get the "name" string and "loader" object. ]*/
+    const char* module_name = json_object_get_string(module_json, HOSTED_MODULE_NAME_KEY);
+    JSON_Object* loader_json = json_object_get_object(module_json, HOSTED_MODULE_LOADER_KEY);
+    if (module_name == NULL || loader_json == NULL)
+    {
+        /*Codes_SRS_NATIVEMODULEHOST_26_014: [ If any step above fails, then NativeModuleHost_Create shall destroy every hosted module created so far, free all resources allocated and return NULL. ]*/
+        LogError("hosted module entry is missing a 'name' or 'loader'");
+        result = __LINE__;
+    }
+    else if (mallocAndStrcpy_s(&hosted_module->name, module_name) != 0)
+    {
+        LogError("unable to copy hosted module name %s", module_name);
+        result = __LINE__;
+    }
+    else
+    {
+        GATEWAY_MODULE_LOADER_INFO loader_info;
+        /*Codes_SRS_NATIVEMODULEHOST_26_004: [ NativeModuleHost_Create shall load each hosted module the same way as a single module, using its "loader" object and its "args" value as the module arguments. ]*/
+        if (parse_loader(loader_json, &loader_info) != 0)
+        {
+            LogError("unable to parse the loader of hosted module %s", module_name);
+            free(hosted_module->name);
+            result = __LINE__;
+        }
+        else
+        {
+            JSON_Value * module_args = json_object_get_value(module_json, HOSTED_MODULE_ARGS_KEY);
+            char * module_args_string = json_serialize_to_string(module_args);
+            if (module_create(&hosted_module->host, broker, &loader_info, module_args_string) != 0)
+            {
+                LogError("unable to create hosted module %s", module_name);
+                free(hosted_module->name);
+                result = __LINE__;
+            }
+            else
+            {
+                hosted_module->module.module_apis = loader_info.loader->api->GetApi(loader_info.loader, hosted_module->host.module_library_handle);
+                hosted_module->module.module_handle = hosted_module->host.module;
+                result = 0;
+            }
+            json_free_serialized_string(module_args_string);
+            loader_info.loader->api->FreeEntrypoint(loader_info.loader, loader_info.entrypoint);
+        }
+    }
+    return result;
+}
+
+static int link_endpoint(MODULE_HOST * module_host, const char * name, HOSTED_MODULE ** hosted_module)
+{
+    int result;
+    if (name == NULL)
+    {
+        LogError("hosted link is missing a 'source' or 'sink'");
+        result = __LINE__;
+    }
+    else if (strcmp(name, OOP_MODULE_GATEWAY_LINK_ENDPOINT) == 0)
+    {
+        *hosted_module = NULL;
+        result = 0;
+    }
+    else if ((*hosted_module = find_hosted_module(module_host, name)) == NULL)
+    {
+        /*Codes_SRS_NATIVEMODULEHOST_26_013: [ NativeModuleHost_Create shall fail if a link refers to a module that is not in "outprocess.modules". ]*/
+        LogError("hosted link refers to unknown module %s", name);
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+static int hosted_link_add(MODULE_HOST * module_host, JSON_Object * link_json)
+{
+    int result;
+    HOSTED_MODULE* source;
+    HOSTED_MODULE* sink;
+
+    /*Codes_SRS_NATIVEMODULEHOST_26_005: [ For each entry of "outprocess.links", NativeModuleHost_Create shall resolve "source" and "sink" to hosted modules by name, where "$gateway" stands for the gateway side of the IPC channel. ]*/
+    if (link_endpoint(module_host, json_object_get_string(link_json, HOSTED_LINK_SOURCE_KEY), &source) != 0 ||
+        link_endpoint(module_host, json_object_get_string(link_json, HOSTED_LINK_SINK_KEY), &sink) != 0)
+    {
+        result = __LINE__;
+    }
+    /*Codes_SRS_NATIVEMODULEHOST_26_006: [ NativeModuleHost_Create shall add each link to the local broker. ]*/
+    else if (LocalBroker_AddLink(module_host->local_broker,
+        (source == NULL) ? NULL : source->module.module_handle,
+        (sink == NULL) ? NULL : &sink->module) != 0)
+    {
+        LogError("unable to add a hosted link");
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+static bool route_published_message(void * context, MODULE_HANDLE source, MESSAGE_HANDLE message)
+{
+    MODULE_HOST* module_host = (MODULE_HOST*)context;
+    /*Codes_SRS_NATIVEMODULEHOST_26_010: [ Messages published by hosted modules shall be routed by the local broker, and only sent to the gateway when the publishing module is linked to "$gateway". ]*/
+    return LocalBroker_Publish(module_host->local_broker, source, message);
+}
+
+static int module_graph_create(MODULE_HOST * module_host, BROKER_HANDLE broker, JSON_Object * module_host_args, JSON_Array * modules_array)
+{
+    int result;
+
+    /*Codes_SRS_NATIVEMODULEHOST_26_002: [ In graph mode, NativeModuleHost_Create shall get the "outprocess.links" array from the configuration JSON. ]*/
+    JSON_Array* links_array = json_object_get_array(module_host_args, OOP_MODULE_LINKS_ARRAY_KEY);
+    size_t module_count = json_array_get_count(modules_array);
+    if (links_array == NULL || module_count == 0)
+    {
+        /*Codes_SRS_NATIVEMODULEHOST_26_014: [ If any step above fails, then NativeModuleHost_Create shall destroy every hosted module created so far, free all resources allocated and return NULL. ]*/
+        LogError("module graph needs at least one module and an 'outprocess.links' array");
+        result = __LINE__;
+    }
+    /*Codes_SRS_NATIVEMODULEHOST_26_007: [ NativeModuleHost_Create shall create a local broker for the hosted modules. ]*/
+    else if ((module_host->local_broker = LocalBroker_Create()) == NULL)
+    {
+        LogError("unable to create the local broker");
+        result = __LINE__;
+    }
+    else if ((module_host->hosted_modules = (HOSTED_MODULE*)malloc(module_count * sizeof(HOSTED_MODULE))) == NULL)
+    {
+        LogError("unable to allocate hosted modules");
+        LocalBroker_Destroy(module_host->local_broker);
+        module_host->local_broker = NULL;
+        result = __LINE__;
+    }
+    else
+    {
+        memset(module_host->hosted_modules, 0, module_count * sizeof(HOSTED_MODULE));
+        result = 0;
+
+        for (size_t i = 0; i < module_count && result == 0; i++)
+        {
+            if (hosted_module_create(&module_host->hosted_modules[i], broker, json_array_get_object(modules_array, i)) != 0)
+            {
+                result = __LINE__;
+            }
+            else
+            {
+                module_host->hosted_module_count++;
+            }
+        }
+
+        size_t link_count = json_array_get_count(links_array);
+        for (size_t i = 0; i < link_count && result == 0; i++)
+        {
+            if (hosted_link_add(module_host, json_array_get_object(links_array, i)) != 0)
+            {
+                result = __LINE__;
+            }
+        }
+
+        /*Codes_SRS_NATIVEMODULEHOST_26_008: [ NativeModuleHost_Create shall set the proxy gateway publish router so that messages published by hosted modules go to the local broker. ]*/
+        if (result == 0 && ProxyGateway_SetPublishRouter(broker, route_published_message, module_host) != 0)
+        {
+            LogError("unable to set the publish router");
+            result = __LINE__;
+        }
+
+        if (result != 0)
+        {
+            /*Codes_SRS_NATIVEMODULEHOST_26_014: [ If any step above fails, then NativeModuleHost_Create shall destroy every hosted module created so far, free all resources allocated and return NULL. ]*/
+            module_graph_destroy(module_host);
+        }
+    }
+    return result;
+}
+
 static MODULE_HANDLE NativeModuleHost_Create(BROKER_HANDLE broker, const void* configuration)
 {
     MODULE_HOST * result;
@@ -231,10 +454,37 @@ static MODULE_HANDLE NativeModuleHost_Create(BROKER_HANDLE broker, const void* c
                 {
                     /*Codes_SRS_NATIVEMODULEHOST_17_012: [ NativeModuleHost_Create shall get the "outprocess.loader" object from the configuration JSON. ]*/
                     JSON_Object * loader_args = json_object_get_object(module_host_args, OOP_MODULE_LOADER_KEY);
+                    JSON_Array * modules_array;
                     if (loader_args == NULL)
                     {
-                        LogError("NativeModuleHost_Create could not get loader arguments.");
-                        result = NULL;
+                        /*Codes_SRS_NATIVEMODULEHOST_26_001: [ If there is no "outprocess.loader" object, NativeModuleHost_Create shall get the "outprocess.modules" array and host the module graph it describes. ]*/
+                        if ((modules_array = json_object_get_array(module_host_args, OOP_MODULE_MODULES_ARRAY_KEY)) == NULL)
+                        {
+                            LogError("NativeModuleHost_Create could not get loader arguments.");
+                            result = NULL;
+                        }
+                        else if ((result = (MODULE_HOST*)malloc(sizeof(MODULE_HOST))) == NULL)
+                        {
+                            LogError("NativeModuleHost_Create could not allocate module.");
+                        }
+                        else
+                        {
+                            result->module_library_handle = NULL;
+                            result->module_loader = NULL;
+                            result->module = NULL;
+                            result->module_host_broker = broker;
+                            result->dispatch.receive = NULL;
+                            result->dispatch.module_handle = NULL;
+                            result->hosted_modules = NULL;
+                            result->hosted_module_count = 0;
+                            result->local_broker = NULL;
+                            if (module_graph_create(result, broker, module_host_args, modules_array) != 0)
+                            {
+                                LogError("NativeModuleHost_Create could not create the module graph.");
+                                free(result);
+                                result = NULL;
+                            }
+                        }
                     }
                     else
                     {
@@ -256,6 +506,9 @@ static MODULE_HANDLE NativeModuleHost_Create(BROKER_HANDLE broker, const void* c
 							}
 							else
 							{
+								result->hosted_modules = NULL;
+								result->hosted_module_count = 0;
+								result->local_broker = NULL;
 								/*Codes_SRS_NATIVEMODULEHOST_17_018: [ NativeModuleHost_Create shall get the "module.args" object from the configuration JSON. ]*/
 								JSON_Value * module_args = json_object_get_value(module_host_args, OOP_MODULE_ARGS_KEY);
 								char * module_args_string = json_serialize_to_string(module_args);
@@ -287,34 +540,67 @@ static MODULE_HANDLE NativeModuleHost_Create(BROKER_HANDLE broker, const void* c
     return result;
 }
 
+static void module_destroy(MODULE_HOST * module_host)
+{
+    const MODULE_LOADER* module_loader = module_host->module_loader;
+    MODULE_LIBRARY_HANDLE module_library = module_host->module_library_handle;
+
+    if (module_loader != NULL)
+    {
+        MODULE_LOADER_API * loader_api = module_loader->api;
+        if ((module_library != NULL) && (loader_api != NULL))
+        {
+            const MODULE_API* module_apis = loader_api->GetApi(module_loader, module_library);
+            if (MODULE_DESTROY(module_apis) != NULL)
+            {
+                /*Codes_SRS_NATIVEMODULEHOST_17_028: [ NativeModuleHost_Destroy shall free all remaining allocated resources if moduleHandle is not NULL. ]*/
+                MODULE_DESTROY(module_apis)(module_host->module);
+            }
+
+            loader_api->Unload(module_loader, module_library);
+        }
+    }
+    module_host->module = NULL;
+    module_host->module_library_handle = NULL;
+    module_host->module_host_broker = NULL;
+    module_host->dispatch.receive = NULL;
+    module_host->dispatch.module_handle = NULL;
+}
+
+static void module_graph_destroy(MODULE_HOST * module_host)
+{
+    /*Codes_SRS_NATIVEMODULEHOST_26_015: [ NativeModuleHost_Destroy shall stop the local broker before destroying the hosted modules. ]*/
+    LocalBroker_Stop(module_host->local_broker);
+
+    /*Codes_SRS_NATIVEMODULEHOST_26_016: [ NativeModuleHost_Destroy shall destroy the hosted modules in reverse order of creation. ]*/
+    while (module_host->hosted_module_count > 0)
+    {
+        HOSTED_MODULE* hosted_module = &module_host->hosted_modules[--module_host->hosted_module_count];
+        module_destroy(&hosted_module->host);
+        free(hosted_module->name);
+    }
+    free(module_host->hosted_modules);
+    module_host->hosted_modules = NULL;
+
+    /*Codes_SRS_NATIVEMODULEHOST_26_017: [ NativeModuleHost_Destroy shall remove the publish router and destroy the local broker. ]*/
+    (void)ProxyGateway_SetPublishRouter(module_host->module_host_broker, NULL, NULL);
+    LocalBroker_Destroy(module_host->local_broker);
+    module_host->local_broker = NULL;
+}
+
 static void NativeModuleHost_Destroy(MODULE_HANDLE moduleHandle)
 {
     if (moduleHandle != NULL)
     {
         MODULE_HOST* module_host = (MODULE_HOST*)moduleHandle;
-        if (module_host->module != NULL)
+        if (module_host->local_broker != NULL)
         {
-            const MODULE_LOADER* module_loader = module_host->module_loader;
-            MODULE_LIBRARY_HANDLE module_library = module_host->module_library_handle;
-
-            if (module_loader != NULL)
-            {
-                MODULE_LOADER_API * loader_api = module_loader->api;
-                if ((module_library != NULL) && (loader_api != NULL))
-                {
-                    const MODULE_API* module_apis = loader_api->GetApi(module_loader, module_library);
-                    if (MODULE_DESTROY(module_apis) != NULL)
-                    {
-                        /*Codes_SRS_NATIVEMODULEHOST_17_028: [ NativeModuleHost_Destroy shall free all remaining allocated resources if moduleHandle is not NULL. ]*/
-                        MODULE_DESTROY(module_apis)(module_host->module);
-                    }
-
-                    loader_api->Unload(module_loader, module_library);
-                }
-            }
-            module_host->module = NULL;
-            module_host->module_library_handle = NULL;
-            module_host->module_host_broker = NULL;
+            module_graph_destroy(module_host);
+            free(module_host);
+        }
+        else if (module_host->module != NULL)
+        {
+            module_destroy(module_host);
             free(module_host);
         }
     }
@@ -324,27 +610,23 @@ static void NativeModuleHost_Destroy(MODULE_HANDLE moduleHandle)
 
 static void NativeModuleHost_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
 {
-    if (moduleHandle != NULL)
+    if (moduleHandle != NULL && ((MODULE_HOST*)moduleHandle)->local_broker != NULL)
+    {
+        /*Codes_SRS_NATIVEMODULEHOST_26_009: [ In graph mode, NativeModuleHost_Receive shall hand the message to the local broker as coming from "$gateway". ]*/
+        (void)LocalBroker_Publish(((MODULE_HOST*)moduleHandle)->local_broker, NULL, messageHandle);
+    }
+    else if (moduleHandle != NULL)
     {
         MODULE_HOST* module_host = (MODULE_HOST*)moduleHandle;
-        /*Codes_SRS_NATIVEMODULEHOST_17_030: [ NativeModuleHost_Receive shall get the loaded module's MODULE_API pointer. ]*/
-        const MODULE_API* module_apis = module_host->module_loader->api->GetApi(module_host->module_loader, module_host->module_library_handle);
-        if (module_apis != NULL)
+        /*Codes_SRS_NATIVEMODULEHOST_26_019: [ NativeModuleHost_Receive shall use the dispatch record cached at create time and shall not call the module loader. ]*/
+        if (module_host->dispatch.receive != NULL)
         {
-            pfModule_Receive pfReceive = MODULE_RECEIVE(module_apis);
-            if (pfReceive != NULL)
-            {
-                /*Codes_SRS_NATIVEMODULEHOST_17_031: [ NativeModuleHost_Receive shall call the loaded module's _Receive function, passing the messageHandle along. ]*/
-                (pfReceive)(module_host->module, messageHandle);
-            }
-            else
-            {
-                LogError("Module API did not have a Receive function");
-            }
+            /*Codes_SRS_NATIVEMODULEHOST_17_031: [ NativeModuleHost_Receive shall call the loaded module's _Receive function, passing the messageHandle along. ]*/
+            MODULE_DISPATCH_RECEIVE(module_host->dispatch, messageHandle);
         }
         else
         {
-            LogError("Module API not found");
+            LogError("Module API did not have a Receive function");
         }
     }
     else
@@ -356,7 +638,28 @@ static void NativeModuleHost_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE
 
 static void NativeModuleHost_Start(MODULE_HANDLE moduleHandle)
 {
-    if (moduleHandle != NULL)
+    if (moduleHandle != NULL && ((MODULE_HOST*)moduleHandle)->local_broker != NULL)
+    {
+        MODULE_HOST* module_host = (MODULE_HOST*)moduleHandle;
+        /*Codes_SRS_NATIVEMODULEHOST_26_011: [ In graph mode, NativeModuleHost_Start shall start the local broker. ]*/
+        if (LocalBroker_Start(module_host->local_broker) != 0)
+        {
+            LogError("unable to start the local broker");
+        }
+        else
+        {
+            for (size_t i = 0; i < module_host->hosted_module_count; i++)
+            {
+                pfModule_Start pfStart = MODULE_START(module_host->hosted_modules[i].module.module_apis);
+                if (pfStart != NULL)
+                {
+                    /*Codes_SRS_NATIVEMODULEHOST_26_012: [ In graph mode, NativeModuleHost_Start shall call _Start, if defined, on every hosted module in creation order. ]*/
+                    (pfStart)(module_host->hosted_modules[i].module.module_handle);
+                }
+            }
+        }
+    }
+    else if (moduleHandle != NULL)
     {
         MODULE_HOST* module_host = (MODULE_HOST*)moduleHandle;
         /*Codes_SRS_NATIVEMODULEHOST_17_033: [ NativeModuleHost_Start shall get the loaded module's MODULE_API pointer. ]*/
@@ -0,0 +1,418 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdbool>
+#else
+#include <stdlib.h>
+#include <stdbool.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "azure_c_shared_utility/macro_utils.h"
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#define ENABLE_MOCKS
+#define GATEWAY_EXPORT_H
+#define GATEWAY_EXPORT
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "message.h"
+#include "module.h"
+
+MOCKABLE_FUNCTION(, void, mock_Module_Receive, MODULE_HANDLE, moduleHandle, MESSAGE_HANDLE, messageHandle);
+#undef ENABLE_MOCKS
+
+#include "local_broker.h"
+
+#define TEST_LOCK ((LOCK_HANDLE)0x11)
+#define TEST_CONDITION ((COND_HANDLE)0x12)
+#define TEST_MESSAGE ((MESSAGE_HANDLE)0x21)
+#define TEST_MESSAGE_CLONE ((MESSAGE_HANDLE)0x22)
+#define TEST_SOURCE ((MODULE_HANDLE)0x31)
+#define TEST_SINK ((MODULE_HANDLE)0x32)
+
+static MODULE_API_1 test_sink_apis =
+{
+    { MODULE_API_VERSION_1 },
+
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    mock_Module_Receive,
+    NULL
+};
+
+static MODULE test_sink = { (const MODULE_API*)&test_sink_apis, TEST_SINK };
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+BEGIN_TEST_SUITE(local_broker_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_stdint_register_types();
+    umocktypes_bool_register_types();
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_CONDITION);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Create, THREADAPI_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Message_Clone, TEST_MESSAGE_CLONE);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MODULE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_LOCAL_BROKER_26_001: [ LocalBroker_Create shall allocate a local broker with no links and an empty queue. ]*/
+/*Tests_SRS_LOCAL_BROKER_26_003: [ LocalBroker_Create shall create a lock and a condition to guard the queue. ]*/
+TEST_FUNCTION(LocalBroker_Create_success)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+
+    ///act
+    LOCAL_BROKER_HANDLE broker = LocalBroker_Create();
+
+    ///assert
+    ASSERT_IS_NOT_NULL(broker);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LocalBroker_Destroy(broker);
+}
+
+/*Tests_SRS_LOCAL_BROKER_26_002: [ LocalBroker_Create shall return NULL if any underlying call fails. ]*/
+TEST_FUNCTION(LocalBroker_Create_returns_NULL_when_condition_fails)
+{
+    ///arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init())
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    LOCAL_BROKER_HANDLE broker = LocalBroker_Create();
+
+    ///assert
+    ASSERT_IS_NULL(broker);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_LOCAL_BROKER_26_004: [ LocalBroker_Destroy shall do nothing if broker is NULL. ]*/
+TEST_FUNCTION(LocalBroker_Destroy_does_nothing_with_NULL)
+{
+    ///act
+    LocalBroker_Destroy(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_LOCAL_BROKER_26_007: [ LocalBroker_AddLink shall fail if broker is NULL or if both source and sink are the gateway. ]*/
+TEST_FUNCTION(LocalBroker_AddLink_fails_for_gateway_to_gateway)
+{
+    ///arrange
+    LOCAL_BROKER_HANDLE broker = LocalBroker_Create();
+    umock_c_reset_all_calls();
+
+    ///act
+    int result = LocalBroker_AddLink(broker, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LocalBroker_Destroy(broker);
+}
+
+/*Tests_SRS_LOCAL_BROKER_26_009: [ LocalBroker_AddLink shall fail once the broker has been started. ]*/
+TEST_FUNCTION(LocalBroker_AddLink_fails_after_start)
+{
+    ///arrange
+    LOCAL_BROKER_HANDLE broker = LocalBroker_Create();
+    (void)LocalBroker_Start(broker);
+    umock_c_reset_all_calls();
+
+    ///act
+    int result = LocalBroker_AddLink(broker, NULL, &test_sink);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LocalBroker_Destroy(broker);
+}
+
+/*Tests_SRS_LOCAL_BROKER_26_010: [ LocalBroker_AddLink shall append a copy of the link to the broker's links. ]*/
+/*Tests_SRS_LOCAL_BROKER_26_023: [ LocalBroker_AddLink shall resolve the sink's Module_Receive function once, when the link is added. ]*/
+TEST_FUNCTION(LocalBroker_AddLink_success)
+{
+    ///arrange
+    LOCAL_BROKER_HANDLE broker = LocalBroker_Create();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+
+    ///act
+    int result = LocalBroker_AddLink(broker, TEST_SOURCE, &test_sink);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LocalBroker_Destroy(broker);
+}
+
+/*Tests_SRS_LOCAL_BROKER_26_013: [ LocalBroker_Start shall start the dispatch thread. ]*/
+TEST_FUNCTION(LocalBroker_Start_starts_the_dispatch_thread)
+{
+    ///arrange
+    LOCAL_BROKER_HANDLE broker = LocalBroker_Create();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, broker));
+
+    ///act
+    int result = LocalBroker_Start(broker);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LocalBroker_Destroy(broker);
+}
+
+/*Tests_SRS_LOCAL_BROKER_26_014: [ LocalBroker_Stop shall signal the dispatch thread to stop and wait for it to exit. ]*/
+TEST_FUNCTION(LocalBroker_Stop_joins_the_dispatch_thread)
+{
+    ///arrange
+    LOCAL_BROKER_HANDLE broker = LocalBroker_Create();
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, broker))
+        .CopyOutArgumentBuffer(1, &broker, sizeof(THREAD_HANDLE));
+    (void)LocalBroker_Start(broker);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_CONDITION));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join((THREAD_HANDLE)broker, IGNORED_PTR_ARG));
+
+    ///act
+    LocalBroker_Stop(broker);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LocalBroker_Destroy(broker);
+}
+
+/*Tests_SRS_LOCAL_BROKER_26_019: [ LocalBroker_Publish shall return false if broker or message is NULL. ]*/
+TEST_FUNCTION(LocalBroker_Publish_returns_false_for_NULL_message)
+{
+    ///arrange
+    LOCAL_BROKER_HANDLE broker = LocalBroker_Create();
+    umock_c_reset_all_calls();
+
+    ///act
+    bool forward = LocalBroker_Publish(broker, NULL, NULL);
+
+    ///assert
+    ASSERT_IS_FALSE(forward);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LocalBroker_Destroy(broker);
+}
+
+/*Tests_SRS_LOCAL_BROKER_26_020: [ LocalBroker_Publish shall return true if source is linked to the gateway. ]*/
+TEST_FUNCTION(LocalBroker_Publish_forwards_to_gateway_without_queueing)
+{
+    ///arrange
+    LOCAL_BROKER_HANDLE broker = LocalBroker_Create();
+    (void)LocalBroker_AddLink(broker, TEST_SOURCE, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+
+    ///act
+    bool forward = LocalBroker_Publish(broker, TEST_SOURCE, TEST_MESSAGE);
+
+    ///assert
+    ASSERT_IS_TRUE(forward);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LocalBroker_Destroy(broker);
+}
+
+/*Tests_SRS_LOCAL_BROKER_26_022: [ If source is linked to any hosted module, LocalBroker_Publish shall queue a clone of message once and signal the dispatch thread. ]*/
+TEST_FUNCTION(LocalBroker_Publish_queues_one_clone_for_local_sinks)
+{
+    ///arrange
+    LOCAL_BROKER_HANDLE broker = LocalBroker_Create();
+    (void)LocalBroker_AddLink(broker, NULL, &test_sink);
+    (void)LocalBroker_AddLink(broker, NULL, &test_sink);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Message_Clone(TEST_MESSAGE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_CONDITION));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+
+    ///act
+    bool forward = LocalBroker_Publish(broker, NULL, TEST_MESSAGE);
+
+    ///assert
+    ASSERT_IS_FALSE(forward);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LocalBroker_Destroy(broker);
+}
+
+/*Tests_SRS_LOCAL_BROKER_26_021: [ LocalBroker_Publish shall drop messages published after the broker has been stopped. ]*/
+TEST_FUNCTION(LocalBroker_Publish_drops_messages_after_stop)
+{
+    ///arrange
+    LOCAL_BROKER_HANDLE broker = LocalBroker_Create();
+    (void)LocalBroker_AddLink(broker, NULL, &test_sink);
+    LocalBroker_Stop(broker);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+
+    ///act
+    bool forward = LocalBroker_Publish(broker, NULL, TEST_MESSAGE);
+
+    ///assert
+    ASSERT_IS_FALSE(forward);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    LocalBroker_Destroy(broker);
+}
+
+/*Tests_SRS_LOCAL_BROKER_26_005: [ LocalBroker_Destroy shall stop the dispatch thread if it is running. ]*/
+/*Tests_SRS_LOCAL_BROKER_26_006: [ LocalBroker_Destroy shall destroy every message still queued and free all resources. ]*/
+TEST_FUNCTION(LocalBroker_Destroy_destroys_queued_messages)
+{
+    ///arrange
+    LOCAL_BROKER_HANDLE broker = LocalBroker_Create();
+    (void)LocalBroker_AddLink(broker, NULL, &test_sink);
+    (void)LocalBroker_Publish(broker, NULL, TEST_MESSAGE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_CONDITION));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK));
+    STRICT_EXPECTED_CALL(Message_Destroy(TEST_MESSAGE_CLONE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_CONDITION));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    LocalBroker_Destroy(broker);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(local_broker_ut)
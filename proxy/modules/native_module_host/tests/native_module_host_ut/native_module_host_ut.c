@@ -12,6 +12,7 @@
 #include "umock_c_negative_tests.h"
 #include "umocktypes_charptr.h"
 #include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
 #include "azure_c_shared_utility/macro_utils.h"
 
 
@@ -81,6 +82,8 @@ int my_mallocAndStrcpy_s( char** destination, const char* source)
 #include "module_access.h"
 #include "module_loaders/dynamic_loader.h"
 #include "native_module_host.h"
+#include "local_broker.h"
+#include "proxy_gateway.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
@@ -94,6 +97,9 @@ MOCKABLE_FUNCTION(, JSON_Value*, json_parse_string, const char *, string);
 MOCKABLE_FUNCTION(, const char*, json_object_get_string, const JSON_Object *, object, const char *, name);
 MOCKABLE_FUNCTION(, void, json_value_free, JSON_Value *, value);
 MOCKABLE_FUNCTION(, JSON_Object*, json_value_get_object, const JSON_Value *, value);
+MOCKABLE_FUNCTION(, JSON_Array*, json_object_get_array, const JSON_Object *, object, const char *, name);
+MOCKABLE_FUNCTION(, size_t, json_array_get_count, const JSON_Array *, array);
+MOCKABLE_FUNCTION(, JSON_Object*, json_array_get_object, const JSON_Array *, array, size_t, index);
 
 MOCKABLE_FUNCTION(, void*, mock_Module_ParseConfigurationFromJson, const char*, configuration);
 MOCKABLE_FUNCTION(, void, mock_Module_FreeConfiguration, void*, configuration);
@@ -258,6 +264,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     umock_c_init(on_umock_c_error);
 	umocktypes_charptr_register_types();
 	umocktypes_stdint_register_types();
+	umocktypes_bool_register_types();
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -291,6 +298,8 @@ TEST_SUITE_INITIALIZE(suite_init)
 	REGISTER_UMOCK_ALIAS_TYPE(BROKER_RESULT, int);
 	REGISTER_UMOCK_ALIAS_TYPE(MODULE_LIBRARY_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(MODULE_LOADER_RESULT, int);
+	REGISTER_UMOCK_ALIAS_TYPE(LOCAL_BROKER_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(PROXY_GATEWAY_PUBLISH_ROUTER, void*);
 
 
 }
@@ -932,7 +941,8 @@ TEST_FUNCTION(NativeModuleHost_Create_fails_loader_key_not_found_fails)
 		.SetReturn(MODULE_LOADER_SUCCESS);
 	STRICT_EXPECTED_CALL(json_object_get_object((JSON_Object*)0x44, IGNORED_PTR_ARG))
 		.IgnoreArgument(2).SetReturn(NULL);
-
+	STRICT_EXPECTED_CALL(json_object_get_array((JSON_Object*)0x44, IGNORED_PTR_ARG))
+		.IgnoreArgument(2).SetReturn(NULL);
 
 	STRICT_EXPECTED_CALL(json_value_free((JSON_Value*)0x43));
 	STRICT_EXPECTED_CALL(ModuleLoader_Destroy());
@@ -1052,7 +1062,7 @@ TEST_FUNCTION(NativeModuleHost_Destroy_destroys_loader_with_nothing)
 	///ablution
 }
 
-static MODULE_HANDLE create_a_module(const MODULE_API* apis)
+static MODULE_HANDLE create_a_module_with_api(const MODULE_API* apis, const MODULE_API_1* module_api)
 {
 	BROKER_HANDLE b = (BROKER_HANDLE)0x42;
 	char * config = "Assume this is a valid config";
@@ -1084,7 +1094,7 @@ static MODULE_HANDLE create_a_module(const MODULE_API* apis)
 	STRICT_EXPECTED_CALL(mock_ModuleLoader_Load(&dummyModuleLoader, IGNORED_PTR_ARG))
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(mock_ModuleLoader_GetApi(&dummyModuleLoader, IGNORED_PTR_ARG))
-		.IgnoreArgument(2).SetReturn((const MODULE_API*)&dummyAPIs);
+		.IgnoreArgument(2).SetReturn((const MODULE_API*)module_api);
 	STRICT_EXPECTED_CALL(mock_Module_ParseConfigurationFromJson(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mock_ModuleLoader_BuildModuleConfiguration(&dummyModuleLoader, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -1108,6 +1118,11 @@ static MODULE_HANDLE create_a_module(const MODULE_API* apis)
 	return m;
 }
 
+static MODULE_HANDLE create_a_module(const MODULE_API* apis)
+{
+	return create_a_module_with_api(apis, &dummyAPIs);
+}
+
 /*Tests_SRS_NATIVEMODULEHOST_17_028: [ NativeModuleHost_Destroy shall free all remaining allocated resources if moduleHandle is not NULL. ]*/
 TEST_FUNCTION(NativeModuleHost_Destroy_success)
 {
@@ -1147,7 +1162,8 @@ TEST_FUNCTION(NativeModuleHost_Receive_does_nothing_with_nothing)
 	///ablution
 }
 
-/*Tests_SRS_NATIVEMODULEHOST_17_030: [ NativeModuleHost_Receive shall get the loaded module's MODULE_API pointer. ]*/
+/*Tests_SRS_NATIVEMODULEHOST_26_018: [ NativeModuleHost_Create shall cache the module's _Receive function and handle in a dispatch record. ]*/
+/*Tests_SRS_NATIVEMODULEHOST_26_019: [ NativeModuleHost_Receive shall use the dispatch record cached at create time and shall not call the module loader. ]*/
 /*Tests_SRS_NATIVEMODULEHOST_17_031: [ NativeModuleHost_Receive shall call the loaded module's _Receive function, passing the messageHandle along. ]*/
 TEST_FUNCTION(NativeModuleHost_Receive_success)
 {
@@ -1156,14 +1172,15 @@ TEST_FUNCTION(NativeModuleHost_Receive_success)
 	MESSAGE_HANDLE TEST_MSG = (MESSAGE_HANDLE)0x42;
 	MODULE_HANDLE m = create_a_module(apis);
 
-	STRICT_EXPECTED_CALL(mock_ModuleLoader_GetApi(&dummyModuleLoader, IGNORED_PTR_ARG))
-		.IgnoreArgument(2).SetReturn((const MODULE_API*)&dummyAPIs);
 	STRICT_EXPECTED_CALL(mock_Module_Receive(IGNORED_PTR_ARG, TEST_MSG))
 		.IgnoreArgument(1);
 
 	///act
 	MODULE_RECEIVE(apis)(m, TEST_MSG);
 
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
 	///ablution
 	umock_c_reset_all_calls();
 	EXPECTED_CALL(mock_ModuleLoader_GetApi(&dummyModuleLoader, IGNORED_PTR_ARG))
@@ -1171,13 +1188,12 @@ TEST_FUNCTION(NativeModuleHost_Receive_success)
 	MODULE_DESTROY(apis)(m);
 }
 
-/*Tests_SRS_NATIVEMODULEHOST_17_030: [ NativeModuleHost_Receive shall get the loaded module's MODULE_API pointer. ]*/
+/*Tests_SRS_NATIVEMODULEHOST_26_019: [ NativeModuleHost_Receive shall use the dispatch record cached at create time and shall not call the module loader. ]*/
 TEST_FUNCTION(NativeModuleHost_Receive_no_receive_in_api)
 {
 	///arrange
 	const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
 	MESSAGE_HANDLE TEST_MSG = (MESSAGE_HANDLE)0x42;
-	MODULE_HANDLE m = create_a_module(apis);
 	static MODULE_API_1 dummyAPIs_no_recv =
 	{
 		{ MODULE_API_VERSION_1 },
@@ -1189,33 +1205,13 @@ TEST_FUNCTION(NativeModuleHost_Receive_no_receive_in_api)
 		NULL,
 		mock_Module_Start
 	};
-
-	STRICT_EXPECTED_CALL(mock_ModuleLoader_GetApi(&dummyModuleLoader, IGNORED_PTR_ARG))
-		.IgnoreArgument(2).SetReturn((const MODULE_API*)&dummyAPIs_no_recv);
+	MODULE_HANDLE m = create_a_module_with_api(apis, &dummyAPIs_no_recv);
 
 	///act
 	MODULE_RECEIVE(apis)(m, TEST_MSG);
 
-	///ablution
-	umock_c_reset_all_calls();
-	EXPECTED_CALL(mock_ModuleLoader_GetApi(&dummyModuleLoader, IGNORED_PTR_ARG))
-		.IgnoreArgument(2).SetReturn((const MODULE_API*)&dummyAPIs);
-	MODULE_DESTROY(apis)(m);
-}
-
-/*Tests_SRS_NATIVEMODULEHOST_17_030: [ NativeModuleHost_Receive shall get the loaded module's MODULE_API pointer. ]*/
-TEST_FUNCTION(NativeModuleHost_Receive_get_api_fails)
-{
-	///arrange
-	const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
-	MESSAGE_HANDLE TEST_MSG = (MESSAGE_HANDLE)0x42;
-	MODULE_HANDLE m = create_a_module(apis);
-
-	STRICT_EXPECTED_CALL(mock_ModuleLoader_GetApi(&dummyModuleLoader, IGNORED_PTR_ARG))
-		.IgnoreArgument(2).SetReturn(NULL);
-
-	///act
-	MODULE_RECEIVE(apis)(m, TEST_MSG);
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	///ablution
 	umock_c_reset_all_calls();
@@ -1313,4 +1309,234 @@ TEST_FUNCTION(NativeModuleHost_Start_get_api_fails)
 }
 
 
+static void setup_graph_create_calls(BROKER_HANDLE b, JSON_Array* links_array)
+{
+	char * config = "Assume this is a valid graph config";
+	STRICT_EXPECTED_CALL(ModuleLoader_Initialize());
+	STRICT_EXPECTED_CALL(json_parse_string(config))
+		.SetReturn((JSON_Value*)0x43);
+	STRICT_EXPECTED_CALL(json_value_get_object((JSON_Value*)0x43))
+		.SetReturn((JSON_Object*)0x44);
+	STRICT_EXPECTED_CALL(json_object_get_value((JSON_Object*)0x44, IGNORED_PTR_ARG))
+		.IgnoreArgument(2).SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_object((JSON_Object*)0x44, IGNORED_PTR_ARG))
+		.IgnoreArgument(2).SetReturn(NULL);
+	STRICT_EXPECTED_CALL(json_object_get_array((JSON_Object*)0x44, IGNORED_PTR_ARG))
+		.IgnoreArgument(2).SetReturn((JSON_Array*)0x60);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(json_object_get_array((JSON_Object*)0x44, IGNORED_PTR_ARG))
+		.IgnoreArgument(2).SetReturn(links_array);
+	STRICT_EXPECTED_CALL(json_array_get_count((JSON_Array*)0x60))
+		.SetReturn(1);
+	if (links_array != NULL)
+	{
+		STRICT_EXPECTED_CALL(LocalBroker_Create())
+			.SetReturn((LOCAL_BROKER_HANDLE)0x70);
+		STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(json_array_get_object((JSON_Array*)0x60, 0))
+			.SetReturn((JSON_Object*)0x62);
+		//hosted_module_create
+		STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x62, IGNORED_PTR_ARG))
+			.IgnoreArgument(2).SetReturn("hosted");
+		STRICT_EXPECTED_CALL(json_object_get_object((JSON_Object*)0x62, IGNORED_PTR_ARG))
+			.IgnoreArgument(2).SetReturn((JSON_Object*)0x45);
+		STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, "hosted"))
+			.IgnoreArgument(1);
+		//parse_loader
+		STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x45, IGNORED_PTR_ARG))
+			.IgnoreArgument(2).SetReturn(NULL);
+		STRICT_EXPECTED_CALL(ModuleLoader_FindByName(IGNORED_PTR_ARG))
+			.IgnoreArgument(1).SetReturn(&dummyModuleLoader);
+		STRICT_EXPECTED_CALL(json_object_get_value((JSON_Object*)0x45, IGNORED_PTR_ARG))
+			.IgnoreArgument(2).SetReturn((JSON_Value*)0x46);
+		STRICT_EXPECTED_CALL(mock_ModuleLoader_ParseEntrypointFromJson(&dummyModuleLoader, (JSON_Value*)0x46));
+		//end parse_loader
+		STRICT_EXPECTED_CALL(json_object_get_value((JSON_Object*)0x62, IGNORED_PTR_ARG))
+			.IgnoreArgument(2).SetReturn((JSON_Value*)0x47);
+		STRICT_EXPECTED_CALL(json_serialize_to_string((JSON_Value*)0x47))
+			.SetReturn("a string");
+		//module_create
+		STRICT_EXPECTED_CALL(mock_ModuleLoader_Load(&dummyModuleLoader, IGNORED_PTR_ARG))
+			.IgnoreArgument(2);
+		STRICT_EXPECTED_CALL(mock_ModuleLoader_GetApi(&dummyModuleLoader, IGNORED_PTR_ARG))
+			.IgnoreArgument(2).SetReturn((const MODULE_API*)&dummyAPIs);
+		STRICT_EXPECTED_CALL(mock_Module_ParseConfigurationFromJson(IGNORED_PTR_ARG))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mock_ModuleLoader_BuildModuleConfiguration(&dummyModuleLoader, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+			.IgnoreArgument(2).IgnoreArgument(3);
+		STRICT_EXPECTED_CALL(mock_Module_Create(b, IGNORED_PTR_ARG))
+			.IgnoreArgument(2);
+		STRICT_EXPECTED_CALL(mock_Module_FreeConfiguration(IGNORED_PTR_ARG))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mock_ModuleLoader_FreeModuleConfiguration(&dummyModuleLoader, IGNORED_PTR_ARG))
+			.IgnoreArgument(2);
+		//end module_create
+		STRICT_EXPECTED_CALL(mock_ModuleLoader_GetApi(&dummyModuleLoader, IGNORED_PTR_ARG))
+			.IgnoreArgument(2).SetReturn((const MODULE_API*)&dummyAPIs);
+		STRICT_EXPECTED_CALL(json_free_serialized_string(IGNORED_PTR_ARG))
+			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mock_ModuleLoader_FreeEntrypoint(&dummyModuleLoader, IGNORED_PTR_ARG))
+			.IgnoreArgument(2);
+		//end hosted_module_create
+		STRICT_EXPECTED_CALL(json_array_get_count(links_array))
+			.SetReturn(1);
+		STRICT_EXPECTED_CALL(json_array_get_object(links_array, 0))
+			.SetReturn((JSON_Object*)0x63);
+		STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x63, IGNORED_PTR_ARG))
+			.IgnoreArgument(2).SetReturn(OOP_MODULE_GATEWAY_LINK_ENDPOINT);
+		STRICT_EXPECTED_CALL(json_object_get_string((JSON_Object*)0x63, IGNORED_PTR_ARG))
+			.IgnoreArgument(2).SetReturn("hosted");
+		STRICT_EXPECTED_CALL(LocalBroker_AddLink((LOCAL_BROKER_HANDLE)0x70, NULL, IGNORED_PTR_ARG))
+			.IgnoreArgument(3);
+		STRICT_EXPECTED_CALL(ProxyGateway_SetPublishRouter(b, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+			.IgnoreArgument(2).IgnoreArgument(3);
+	}
+	else
+	{
+		STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+			.IgnoreArgument(1);
+	}
+	STRICT_EXPECTED_CALL(json_value_free((JSON_Value*)0x43));
+	if (links_array == NULL)
+	{
+		STRICT_EXPECTED_CALL(ModuleLoader_Destroy());
+	}
+}
+
+static MODULE_HANDLE create_a_graph(const MODULE_API* apis)
+{
+	BROKER_HANDLE b = (BROKER_HANDLE)0x42;
+	setup_graph_create_calls(b, (JSON_Array*)0x61);
+
+	MODULE_HANDLE m = MODULE_CREATE(apis)(b, "Assume this is a valid graph config");
+	ASSERT_IS_NOT_NULL(m);
+	umock_c_reset_all_calls();
+	return m;
+}
+
+static void destroy_a_graph(const MODULE_API* apis, MODULE_HANDLE m)
+{
+	umock_c_reset_all_calls();
+	EXPECTED_CALL(mock_ModuleLoader_GetApi(&dummyModuleLoader, IGNORED_PTR_ARG))
+		.IgnoreArgument(2).SetReturn((const MODULE_API*)&dummyAPIs);
+	MODULE_DESTROY(apis)(m);
+}
+
+/*Tests_SRS_NATIVEMODULEHOST_26_001: [ If there is no "outprocess.loader" object, NativeModuleHost_Create shall get the "outprocess.modules" array and host the module graph it describes. ]*/
+/*Tests_SRS_NATIVEMODULEHOST_26_002: [ In graph mode, NativeModuleHost_Create shall get the "outprocess.links" array from the configuration JSON. ]*/
+/*Tests_SRS_NATIVEMODULEHOST_26_003: [ For each entry of "outprocess.modules", NativeModuleHost_Create shall get the "name" string and "loader" object. ]*/
+/*Tests_SRS_NATIVEMODULEHOST_26_004: [ NativeModuleHost_Create shall load each hosted module the same way as a single module, using its "loader" object and its "args" value as the module arguments. ]*/
+/*Tests_SRS_NATIVEMODULEHOST_26_005: [ For each entry of "outprocess.links", NativeModuleHost_Create shall resolve "source" and "sink" to hosted modules by name, where "$gateway" stands for the gateway side of the IPC channel. ]*/
+/*Tests_SRS_NATIVEMODULEHOST_26_006: [ NativeModuleHost_Create shall add each link to the local broker. ]*/
+/*Tests_SRS_NATIVEMODULEHOST_26_007: [ NativeModuleHost_Create shall create a local broker for the hosted modules. ]*/
+/*Tests_SRS_NATIVEMODULEHOST_26_008: [ NativeModuleHost_Create shall set the proxy gateway publish router so that messages published by hosted modules go to the local broker. ]*/
+TEST_FUNCTION(NativeModuleHost_Create_graph_success)
+{
+	///arrange
+	const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
+	BROKER_HANDLE b = (BROKER_HANDLE)0x42;
+	setup_graph_create_calls(b, (JSON_Array*)0x61);
+
+	///act
+	MODULE_HANDLE m = MODULE_CREATE(apis)(b, "Assume this is a valid graph config");
+
+	///assert
+	ASSERT_IS_NOT_NULL(m);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	///ablution
+	destroy_a_graph(apis, m);
+}
+
+/*Tests_SRS_NATIVEMODULEHOST_26_014: [ If any step above fails, then NativeModuleHost_Create shall destroy every hosted module created so far, free all resources allocated and return NULL. ]*/
+TEST_FUNCTION(NativeModuleHost_Create_graph_fails_without_links)
+{
+	///arrange
+	const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
+	BROKER_HANDLE b = (BROKER_HANDLE)0x42;
+	setup_graph_create_calls(b, NULL);
+
+	///act
+	MODULE_HANDLE m = MODULE_CREATE(apis)(b, "Assume this is a valid graph config");
+
+	///assert
+	ASSERT_IS_NULL(m);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	///ablution
+}
+
+/*Tests_SRS_NATIVEMODULEHOST_26_009: [ In graph mode, NativeModuleHost_Receive shall hand the message to the local broker as coming from "$gateway". ]*/
+TEST_FUNCTION(NativeModuleHost_Receive_graph_publishes_to_local_broker)
+{
+	///arrange
+	const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
+	MESSAGE_HANDLE TEST_MSG = (MESSAGE_HANDLE)0x42;
+	MODULE_HANDLE m = create_a_graph(apis);
+
+	STRICT_EXPECTED_CALL(LocalBroker_Publish((LOCAL_BROKER_HANDLE)0x70, NULL, TEST_MSG));
+
+	///act
+	MODULE_RECEIVE(apis)(m, TEST_MSG);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	///ablution
+	destroy_a_graph(apis, m);
+}
+
+/*Tests_SRS_NATIVEMODULEHOST_26_011: [ In graph mode, NativeModuleHost_Start shall start the local broker. ]*/
+/*Tests_SRS_NATIVEMODULEHOST_26_012: [ In graph mode, NativeModuleHost_Start shall call _Start, if defined, on every hosted module in creation order. ]*/
+TEST_FUNCTION(NativeModuleHost_Start_graph_starts_local_broker_and_modules)
+{
+	///arrange
+	const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
+	MODULE_HANDLE m = create_a_graph(apis);
+
+	STRICT_EXPECTED_CALL(LocalBroker_Start((LOCAL_BROKER_HANDLE)0x70));
+	STRICT_EXPECTED_CALL(mock_Module_Start(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	MODULE_START(apis)(m);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	///ablution
+	destroy_a_graph(apis, m);
+}
+
+/*Tests_SRS_NATIVEMODULEHOST_26_015: [ NativeModuleHost_Destroy shall stop the local broker before destroying the hosted modules. ]*/
+/*Tests_SRS_NATIVEMODULEHOST_26_016: [ NativeModuleHost_Destroy shall destroy the hosted modules in reverse order of creation. ]*/
+/*Tests_SRS_NATIVEMODULEHOST_26_017: [ NativeModuleHost_Destroy shall remove the publish router and destroy the local broker. ]*/
+TEST_FUNCTION(NativeModuleHost_Destroy_graph_success)
+{
+	///arrange
+	const MODULE_API* apis = Module_GetApi(MODULE_API_VERSION_1);
+	MODULE_HANDLE m = create_a_graph(apis);
+
+	STRICT_EXPECTED_CALL(LocalBroker_Stop((LOCAL_BROKER_HANDLE)0x70));
+	STRICT_EXPECTED_CALL(mock_ModuleLoader_GetApi(&dummyModuleLoader, IGNORED_PTR_ARG))
+		.IgnoreArgument(2).SetReturn((const MODULE_API*)&dummyAPIs);
+	STRICT_EXPECTED_CALL(mock_Module_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mock_ModuleLoader_Unload(&dummyModuleLoader, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ProxyGateway_SetPublishRouter((BROKER_HANDLE)0x42, NULL, NULL));
+	STRICT_EXPECTED_CALL(LocalBroker_Destroy((LOCAL_BROKER_HANDLE)0x70));
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(ModuleLoader_Destroy());
+
+	///act
+	MODULE_DESTROY(apis)(m);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	///ablution
+}
+
 END_TEST_SUITE(native_module_host_ut)
@@ -10,13 +10,16 @@
 #include "module.h"
 #include "message.h"
 #include "message_queue.h"
+#include "gateway_probes.h"
 #include "control_message.h"
+#include "gateway_timer.h"
 #include "module_loaders/outprocess_module.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "lock_profile.h"
 
 typedef struct THREAD_CONTROL_TAG
 {
@@ -27,12 +30,15 @@ typedef struct THREAD_CONTROL_TAG
 
 #define THREAD_FLAG_STOP 1
 
+#define OUTPROCESS_CONTROL_POLL_MS 250
+
 typedef struct OUTPROCESS_HANDLE_DATA_TAG
 {
 	LOCK_HANDLE handle_lock;
 	int message_socket;
 	int control_socket;
 	MESSAGE_QUEUE_HANDLE outgoing_messages;
+	size_t outgoing_depth;
 	STRING_HANDLE control_uri;
 	STRING_HANDLE message_uri;
 	STRING_HANDLE module_args;
@@ -44,6 +50,9 @@ typedef struct OUTPROCESS_HANDLE_DATA_TAG
 	THREAD_CONTROL message_send_thread;
 	THREAD_CONTROL async_create_thread;
 	THREAD_CONTROL control_thread;
+	GATEWAY_TIMER_HANDLE control_timer;
+	int needs_to_attach;
+	int reattaching;
 } OUTPROCESS_HANDLE_DATA;
 
 // forward definitions
@@ -113,6 +122,7 @@ int outprocessIncomingMessageThread(void *param)
 			{
 				/*Codes_SRS_OUTPROCESS_MODULE_17_039: [ Upon successful receiving a gateway message, this function shall deserialize the message. ]*/
 				const unsigned char*buf_bytes = (const unsigned char*)buf;
+				GATEWAY_PROBE2(outprocess_recv, handleData, nbytes);
 				MESSAGE_HANDLE msg = Message_CreateFromByteArray(buf_bytes, nbytes);
 				if (msg != NULL)
 				{
@@ -183,6 +193,8 @@ static int outprocessOutgoingMessagesThread(void * param)
 					should_continue = 0;
 					break;
 				}
+				handleData->outgoing_depth--;
+				GATEWAY_PROBE3(outprocess_dequeue, handleData, messageHandle, handleData->outgoing_depth);
 			}
 			if (Unlock(handleData->handle_lock) != LOCK_OK)
 			{
@@ -212,6 +224,7 @@ static int outprocessOutgoingMessagesThread(void * param)
 						Message_ToByteArray(messageHandle, nn_msg_bytes, msg_size);
 						/*Codes_SRS_OUTPROCESS_MODULE_17_024: [ This function shall send the message on the message channel. ]*/
 						int nbytes = nn_send(handleData->message_socket, &result, NN_MSG, 0);
+						GATEWAY_PROBE3(outprocess_send, handleData, msg_size, nbytes);
 						if (nbytes != msg_size)
 						{
 							LogError("unable to send buffer to remote for message [%p]", messageHandle);
@@ -351,81 +364,71 @@ static int outprocessCreate(void *param)
 	return thread_return;
 }
 
-int outprocessControlThread(void *param)
+static int outprocessReattachThread(void *param)
 {
 	OUTPROCESS_HANDLE_DATA * handleData = (OUTPROCESS_HANDLE_DATA*)param;
-	if (handleData == NULL)
+	int attached;
+
+	/*Codes_SRS_OUTPROCESS_MODULE_17_060: [ Once the control channel has been restarted, it shall follow the same process in Outprocess_Create to send a Create Message to the module host. ]*/
+	if (outprocessCreate(handleData) < 0)
 	{
-		LogError("outprocessCreate thread: parameter is NULL");
+		LogError("attempting to reattach to remote failed");
+		attached = 0;
 	}
 	else
 	{
-		int should_continue = 1;
-		int needs_to_attach = 0;
+		/*Codes_SRS_OUTPROCESS_MODULE_24_061: [ Once the control channel has been restarted and Create Message was sent, it shall send a Start Message to the module host. ]*/
+		send_start_message(handleData);
+		attached = 1;
+	}
 
-		while (should_continue)
+	/*Codes_SRS_OUTPROCESS_MODULE_17_063: [ Once the reattach attempt completes, the next poll shall join the reattach thread, and shall start a new attempt if the previous one failed. ]*/
+	if (Lock(handleData->control_thread.thread_lock) != LOCK_OK)
+	{
+		LogError("unable to Lock");
+	}
+	else
+	{
+		if (attached)
 		{
-			/*Codes_SRS_OUTPROCESS_MODULE_17_056: [ This thread shall ensure thread safety on the module data. ]*/
-			if (Lock(handleData->control_thread.thread_lock) != LOCK_OK)
-			{
-				LogError("unable to Lock");
-				should_continue = 0;
-				break;
-			}
-			if (handleData->control_thread.thread_flag == THREAD_FLAG_STOP)
-			{
-				should_continue = 0;
-				(void)Unlock(handleData->control_thread.thread_lock);
-				break;
-			}
-			if (Unlock(handleData->control_thread.thread_lock) != LOCK_OK)
-			{
-				should_continue = 0;
-				break;
-			}
-
-			if (needs_to_attach)
-			{
-				// our remote has detached.  Attempt to reattach.
-				/*Codes_SRS_OUTPROCESS_MODULE_17_059: [ If a Module Reply message has been received, and the status indicates the module has failed or has been terminated, this thread shall attempt to restart communications with module host process. ]*/
-
-				/*Codes_SRS_OUTPROCESS_MODULE_17_060: [ Once the control channel has been restarted, it shall follow the same process in Outprocess_Create to send a Create Message to the module host. ]*/
-				if (outprocessCreate(handleData) < 0)
-				{
-					LogError("attempting to reattach to remote failed");
-				}
-				else
-				{
-                    /*Codes_SRS_OUTPROCESS_MODULE_24_061: [ Once the control channel has been restarted and Create Message was sent, it shall send a Start Message to the module host. ]*/
-                    send_start_message(handleData);
-					needs_to_attach = 0;
-				}
-			}
-
-			/*Codes_SRS_OUTPROCESS_MODULE_17_056: [ This thread shall ensure thread safety on the module data. ]*/
-			if (Lock(handleData->handle_lock) != LOCK_OK)
-			{
-				LogError("unable to Lock handle data");
-				should_continue = 0;
-				break;
-			}
-			int nn_fd = handleData->control_socket;
-			if (Unlock(handleData->handle_lock) != LOCK_OK)
-			{
-				should_continue = 0;
-				break;
-			}
+			handleData->needs_to_attach = 0;
+		}
+		handleData->reattaching = 0;
+		(void)Unlock(handleData->control_thread.thread_lock);
+	}
+	return 0;
+}
 
+static bool receive_control_message(OUTPROCESS_HANDLE_DATA * handleData)
+{
+	bool should_continue;
+	/*Codes_SRS_OUTPROCESS_MODULE_17_056: [ This thread shall ensure thread safety on the module data. ]*/
+	if (Lock(handleData->handle_lock) != LOCK_OK)
+	{
+		LogError("unable to Lock handle data");
+		should_continue = false;
+	}
+	else
+	{
+		int nn_fd = handleData->control_socket;
+		if (Unlock(handleData->handle_lock) != LOCK_OK)
+		{
+			should_continue = false;
+		}
+		else
+		{
 			int nbytes;
 			unsigned char *buf = NULL;
 			errno = 0;
+			should_continue = true;
 			/*Codes_SRS_OUTPROCESS_MODULE_17_057: [ This thread shall periodically attempt to receive a meesage from the module host process. ]*/
 			nbytes = nn_recv(nn_fd, (void *)&buf, NN_MSG, NN_DONTWAIT);
 			if (nbytes < 0)
 			{
 				int receive_error = nn_errno();
+				/*Codes_SRS_OUTPROCESS_MODULE_17_064: [ Once the control thread has been signalled to close, or the control channel receive fails, the poll shall not run again. ]*/
 				if (receive_error != EAGAIN)
-					should_continue = 0;
+					should_continue = false;
 			}
 			else
 			{
@@ -440,16 +443,96 @@ int outprocessControlThread(void *param)
 						if (resp_msg->status != 0)
 						{
 							/*Codes_SRS_OUTPROCESS_MODULE_17_059: [ If a Module Reply message has been received, and the status indicates the module has failed or has been terminated, this thread shall attempt to restart communications with module host process. ]*/
-							needs_to_attach = 1;
+							if (Lock(handleData->control_thread.thread_lock) != LOCK_OK)
+							{
+								LogError("unable to Lock");
+								should_continue = false;
+							}
+							else
+							{
+								handleData->needs_to_attach = 1;
+								(void)Unlock(handleData->control_thread.thread_lock);
+							}
 						}
 					}
 					ControlMessage_Destroy(msg);
 				}
 			}
-			ThreadAPI_Sleep(250);
 		}
 	}
-	return 0;
+	return should_continue;
+}
+
+static bool outprocessControlPoll(void *param)
+{
+	bool should_continue;
+	OUTPROCESS_HANDLE_DATA * handleData = (OUTPROCESS_HANDLE_DATA*)param;
+	if (handleData == NULL)
+	{
+		LogError("outprocessControlPoll: parameter is NULL");
+		should_continue = false;
+	}
+	/*Codes_SRS_OUTPROCESS_MODULE_17_056: [ This thread shall ensure thread safety on the module data. ]*/
+	else if (Lock(handleData->control_thread.thread_lock) != LOCK_OK)
+	{
+		LogError("unable to Lock");
+		should_continue = false;
+	}
+	else
+	{
+		int skip_receive = 0;
+		should_continue = true;
+		if (handleData->control_thread.thread_flag == THREAD_FLAG_STOP)
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_064: [ Once the control thread has been signalled to close, or the control channel receive fails, the poll shall not run again. ]*/
+			should_continue = false;
+		}
+		else if (handleData->reattaching)
+		{
+			/* a reattach is still waiting on the module host, skip this poll */
+			skip_receive = 1;
+		}
+		else
+		{
+			if (handleData->control_thread.thread_handle != NULL)
+			{
+				int notUsed;
+				/*Codes_SRS_OUTPROCESS_MODULE_17_063: [ Once the reattach attempt completes, the next poll shall join the reattach thread, and shall start a new attempt if the previous one failed. ]*/
+				if (ThreadAPI_Join(handleData->control_thread.thread_handle, &notUsed) != THREADAPI_OK)
+				{
+					LogError("unable to ThreadAPI_Join reattach thread");
+				}
+				handleData->control_thread.thread_handle = NULL;
+			}
+
+			if (handleData->needs_to_attach)
+			{
+				// our remote has detached.  Attempt to reattach.
+				/*Codes_SRS_OUTPROCESS_MODULE_17_059: [ If a Module Reply message has been received, and the status indicates the module has failed or has been terminated, this thread shall attempt to restart communications with module host process. ]*/
+				/*Codes_SRS_OUTPROCESS_MODULE_17_062: [ The reattach shall run on a thread of its own, so that waiting on the module host does not hold up the gateway timer service. ]*/
+				skip_receive = 1;
+				if (ThreadAPI_Create(&(handleData->control_thread.thread_handle), outprocessReattachThread, handleData) != THREADAPI_OK)
+				{
+					LogError("failed to spawn reattach thread");
+					handleData->control_thread.thread_handle = NULL;
+				}
+				else
+				{
+					handleData->reattaching = 1;
+				}
+			}
+		}
+
+		if (Unlock(handleData->control_thread.thread_lock) != LOCK_OK)
+		{
+			should_continue = false;
+		}
+		else if (should_continue && !skip_receive)
+		{
+			should_continue = receive_control_message(handleData);
+		}
+	}
+	return should_continue;
 }
 
 /* Connection related functions
@@ -732,6 +815,7 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 			{
 				/*Codes_SRS_OUTPROCESS_MODULE_17_042: [ This function shall initialize a queue for outgoing gateway messages. ]*/
 				module->outgoing_messages = MESSAGE_QUEUE_create();
+				module->outgoing_depth = 0;
 				if (module->outgoing_messages == NULL)
 				{
 					LogError("unable to create outgoing message queue");
@@ -765,6 +849,9 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 						module->message_send_thread = default_thread;
 						module->control_thread = default_thread;
 						module->async_create_thread = default_thread;
+						module->control_timer = NULL;
+						module->needs_to_attach = 0;
+						module->reattaching = 0;
 						module->lifecyle_model = config->lifecycle_model;
 
 						/*Codes_SRS_OUTPROCESS_MODULE_17_041: [ This function shall intitialize a lock for each thread for thread management. ]*/
@@ -910,7 +997,7 @@ static void shutdown_a_thread(THREAD_CONTROL * theThreadControl)
 
 	/*Codes_SRS_OUTPROCESS_MODULE_17_033: [ This function shall wait for the messaging thread to complete. ]*/
 	/*Codes_SRS_OUTPROCESS_MODULE_17_051: [ This function shall wait for the outgoing gateway message thread to complete. ]*/
-	/*Codes_SRS_OUTPROCESS_MODULE_17_052: [ This function shall wait for the control thread to complete. ]*/
+	/*Codes_SRS_OUTPROCESS_MODULE_17_052: [ This function shall wait for any reattach thread of the control poll to complete. ]*/
 	if (theCurrentThread != NULL &&
 		ThreadAPI_Join(theCurrentThread, &notUsed) != THREADAPI_OK)
 	{
@@ -971,6 +1058,12 @@ static void Outprocess_Destroy(MODULE_HANDLE moduleHandle)
 		/*Codes_SRS_OUTPROCESS_MODULE_17_049: [ This function shall signal the outgoing gateway message thread to close. ]*/
 		shutdown_a_thread(&(handleData->message_send_thread));
 		/*Codes_SRS_OUTPROCESS_MODULE_17_050: [ This function shall signal the control thread to close. ]*/
+		if (handleData->control_timer != NULL)
+		{
+			/*Codes_SRS_OUTPROCESS_MODULE_17_065: [ This function shall cancel the control poll timer and release the gateway timer service before waiting for any reattach thread. ]*/
+			GatewayTimer_Cancel(handleData->control_timer);
+			GatewayTimer_Deinit();
+		}
 		shutdown_a_thread(&(handleData->control_thread));
 		shutdown_a_thread(&(handleData->async_create_thread));
 
@@ -1010,6 +1103,11 @@ static void Outprocess_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messag
 					LogError("unable to queue the message");
 					Message_Destroy(queued_message);
 				}
+				else
+				{
+					handleData->outgoing_depth++;
+					GATEWAY_PROBE3(outprocess_enqueue, handleData, queued_message, handleData->outgoing_depth);
+				}
 				(void)Unlock(handleData->handle_lock);
 			}
 		}
@@ -1035,11 +1133,15 @@ static void Outprocess_Start(MODULE_HANDLE moduleHandle)
 			LogError("failed to spawn outgoing message thread");
 			handleData->control_thread.thread_handle = NULL;
 		}
-		/*Codes_SRS_OUTPROCESS_MODULE_17_044: [ This function shall create a thread to handle receiving messages from module host. ]*/
-		else if (ThreadAPI_Create(&(handleData->control_thread.thread_handle), outprocessControlThread, handleData) != THREADAPI_OK)
+		/*Codes_SRS_OUTPROCESS_MODULE_17_044: [ This function shall schedule a poll of the control channel every 250 ms on the gateway timer service. ]*/
+		else if (GatewayTimer_Init() != 0)
 		{
-			LogError("failed to spawn control handling thread");
-			handleData->control_thread.thread_handle = NULL;
+			LogError("failed to start the gateway timer service");
+		}
+		else if ((handleData->control_timer = GatewayTimer_Schedule(OUTPROCESS_CONTROL_POLL_MS, OUTPROCESS_CONTROL_POLL_MS, outprocessControlPoll, handleData)) == NULL)
+		{
+			LogError("failed to schedule the control poll");
+			GatewayTimer_Deinit();
 		}
 		else
 		{
@@ -22,6 +22,7 @@ enable_ble_module=ON
 dependency_install_prefix="-Ddependency_install_prefix=$local_install"
 build_config=Debug
 use_xplat_uuid=OFF
+enable_trace_probes=OFF
 
 usage ()
 {
@@ -34,6 +35,8 @@ usage ()
     echo " --enable-dotnet-core-binding   Build the .NET Core binding"
     echo " --enable-java-binding          Build Java binding"
     echo "                                (JAVA_HOME must be defined in your environment)"
+    echo " --enable-trace-probes          Compile USDT tracepoints into the gateway"
+    echo "                                (sys/sdt.h must be installed)"
     echo " --enable-nodejs-binding        Build Node.js binding"
     echo "                                (NODE_INCLUDE, NODE_LIB must be defined)"
     echo " --disable-native-remote-modules Do not build the infrastructure"
@@ -93,6 +96,7 @@ process_args ()
               "--system-deps-path" ) dependency_install_prefix=;;
               "-f" | "--config" ) save_next_arg=3;;
               "--use-xplat-uuid" ) use_xplat_uuid=ON;;
+              "--enable-trace-probes" ) enable_trace_probes=ON;;
               * ) usage;;
           esac
       fi
@@ -183,6 +187,7 @@ cmake $toolchainfile \
       -Dbuild_cores=$CORES \
       -Drebuild_deps:BOOL=$rebuild_deps \
       -Duse_xplat_uuid:BOOL=$use_xplat_uuid \
+      -Denable_trace_probes:BOOL=$enable_trace_probes \
       "$build_root"
 
 make --jobs=$CORES